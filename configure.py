@@ -1477,6 +1477,7 @@ def main():
     environ_cp['TF_DOWNLOAD_CLANG'] = '0'
     environ_cp['TF_ENABLE_XLA'] = '0'
     environ_cp['TF_NEED_GDR'] = '0'
+    environ_cp['TF_NEED_SHM'] = '0'
     environ_cp['TF_NEED_VERBS'] = '0'
     environ_cp['TF_NEED_MPI'] = '0'
     environ_cp['TF_SET_ANDROID_WORKSPACE'] = '0'
@@ -1484,6 +1485,7 @@ def main():
   if is_macos():
     environ_cp['TF_NEED_JEMALLOC'] = '0'
     environ_cp['TF_NEED_TENSORRT'] = '0'
+    environ_cp['TF_NEED_SHM'] = '0'
 
   # The numpy package on ppc64le uses OpenBLAS which has multi-threading
   # issues that lead to incorrect answers.  Set OMP_NUM_THREADS=1 at
@@ -1508,6 +1510,8 @@ def main():
                 False, 'gdr')
   set_build_var(environ_cp, 'TF_NEED_VERBS', 'VERBS', 'with_verbs_support',
                 False, 'verbs')
+  set_build_var(environ_cp, 'TF_NEED_SHM', 'shared-memory transport',
+                'with_shm_support', False, 'shm')
   set_build_var(environ_cp, 'TF_NEED_NGRAPH', 'nGraph',
                 'with_ngraph_support', False, 'ngraph')
 
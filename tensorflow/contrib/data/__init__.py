@@ -48,6 +48,7 @@ See [Importing Data](https://tensorflow.org/guide/datasets) for an overview.
 @@make_saveable_from_iterator
 
 @@map_and_batch
+@@model
 @@padded_batch_and_drop_remainder
 @@parallel_interleave
 @@parse_example_dataset
@@ -58,6 +59,7 @@ See [Importing Data](https://tensorflow.org/guide/datasets) for an overview.
 @@sample_from_datasets
 @@scan
 @@shuffle_and_repeat
+@@shuffle_with_spilling
 @@sliding_window_batch
 @@sloppy_interleave
 @@unbatch
@@ -91,6 +93,7 @@ from tensorflow.contrib.data.python.ops.interleave_ops import sample_from_datase
 from tensorflow.contrib.data.python.ops.interleave_ops import sloppy_interleave
 from tensorflow.contrib.data.python.ops.iterator_ops import CheckpointInputPipelineHook
 from tensorflow.contrib.data.python.ops.iterator_ops import make_saveable_from_iterator
+from tensorflow.contrib.data.python.ops.optimization import model
 from tensorflow.contrib.data.python.ops.parsing_ops import parse_example_dataset
 from tensorflow.contrib.data.python.ops.prefetching_ops import copy_to_device
 from tensorflow.contrib.data.python.ops.prefetching_ops import prefetch_to_device
@@ -104,6 +107,7 @@ from tensorflow.contrib.data.python.ops.readers import SqlDataset
 from tensorflow.contrib.data.python.ops.resampling import rejection_resample
 from tensorflow.contrib.data.python.ops.scan_ops import scan
 from tensorflow.contrib.data.python.ops.shuffle_ops import shuffle_and_repeat
+from tensorflow.contrib.data.python.ops.shuffle_ops import shuffle_with_spilling
 from tensorflow.contrib.data.python.ops.sliding import sliding_window_batch
 from tensorflow.contrib.data.python.ops.unique import unique
 from tensorflow.contrib.data.python.ops.writers import TFRecordWriter
@@ -112,5 +116,6 @@ from tensorflow.contrib.data.python.ops.writers import TFRecordWriter
 from tensorflow.python.util.all_util import remove_undocumented
 remove_undocumented(__name__)
 
-# A constant that can be used to enable auto-tuning.
+# A constant that can be used to enable auto-tuning. Parameters set to it are
+# only tuned in pipelines that apply `tf.contrib.data.model()`.
 AUTOTUNE = -1
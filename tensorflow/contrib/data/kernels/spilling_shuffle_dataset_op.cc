@@ -0,0 +1,499 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <deque>
+#include <vector>
+
+#include "tensorflow/core/framework/dataset.h"
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/random/random_distributions.h"
+
+namespace tensorflow {
+
+namespace {
+
+// The size of the read buffer of each spill file.
+constexpr int64 kSpillReadBufferSize = 32 << 10;
+
+// See documentation in ../ops/dataset_ops.cc for a high-level
+// description of the following op.
+
+class SpillingShuffleDatasetOp : public UnaryDatasetOpKernel {
+ public:
+  explicit SpillingShuffleDatasetOp(OpKernelConstruction* ctx)
+      : UnaryDatasetOpKernel(ctx) {}
+
+  void MakeDataset(OpKernelContext* ctx, DatasetBase* input,
+                   DatasetBase** output) override {
+    int64 buffer_size;
+    OP_REQUIRES_OK(
+        ctx, ParseScalarArgument<int64>(ctx, "buffer_size", &buffer_size));
+    OP_REQUIRES(
+        ctx, buffer_size > 0,
+        errors::InvalidArgument("buffer_size must be greater than zero."));
+
+    int64 memory_limit;
+    OP_REQUIRES_OK(
+        ctx, ParseScalarArgument<int64>(ctx, "memory_limit", &memory_limit));
+    OP_REQUIRES(
+        ctx, memory_limit > 0,
+        errors::InvalidArgument("memory_limit must be greater than zero."));
+
+    string spill_directory;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<string>(ctx, "spill_directory",
+                                                    &spill_directory));
+    if (spill_directory.empty()) {
+      std::vector<string> directories;
+      ctx->env()->GetLocalTempDirectories(&directories);
+      OP_REQUIRES(ctx, !directories.empty(),
+                  errors::NotFound("No local temporary directory for the "
+                                   "spill files of the shuffle buffer."));
+      spill_directory = directories[0];
+    }
+
+    int64 seed;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, "seed", &seed));
+
+    int64 seed2;
+    OP_REQUIRES_OK(ctx, ParseScalarArgument<int64>(ctx, "seed2", &seed2));
+
+    // By TensorFlow convention, passing 0 for both seeds indicates
+    // that the shuffling should be seeded non-deterministically.
+    if (seed == 0 && seed2 == 0) {
+      seed = random::New64();
+      seed2 = random::New64();
+    }
+
+    *output = new Dataset(ctx, input, buffer_size, memory_limit,
+                          spill_directory, seed, seed2);
+  }
+
+ private:
+  class Dataset : public DatasetBase {
+   public:
+    Dataset(OpKernelContext* ctx, const DatasetBase* input, int64 buffer_size,
+            int64 memory_limit, const string& spill_directory, int64 seed,
+            int64 seed2)
+        : DatasetBase(DatasetContext(ctx)),
+          input_(input),
+          buffer_size_(buffer_size),
+          memory_limit_(memory_limit),
+          spill_directory_(spill_directory),
+          seed_(seed),
+          seed2_(seed2),
+          env_(ctx->env()) {
+      input_->Ref();
+    }
+
+    ~Dataset() override { input_->Unref(); }
+
+    std::unique_ptr<IteratorBase> MakeIteratorInternal(
+        const string& prefix) const override {
+      return std::unique_ptr<IteratorBase>(new Iterator(
+          {this, strings::StrCat(prefix, "::SpillingShuffle")}));
+    }
+
+    const DataTypeVector& output_dtypes() const override {
+      return input_->output_dtypes();
+    }
+
+    const std::vector<PartialTensorShape>& output_shapes() const override {
+      return input_->output_shapes();
+    }
+
+    string DebugString() const override {
+      return strings::StrCat("SpillingShuffleDatasetOp(", buffer_size_, ", ",
+                             memory_limit_, ", ", seed_, ", ", seed2_,
+                             ")::Dataset");
+    }
+
+   protected:
+    Status AsGraphDefInternal(SerializationContext* ctx,
+                              DatasetGraphDefBuilder* b,
+                              Node** output) const override {
+      Node* input_graph_node = nullptr;
+      TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_graph_node));
+      Node* buffer_size = nullptr;
+      Node* memory_limit = nullptr;
+      Node* spill_directory = nullptr;
+      Node* seed = nullptr;
+      Node* seed2 = nullptr;
+      TF_RETURN_IF_ERROR(b->AddScalar(buffer_size_, &buffer_size));
+      TF_RETURN_IF_ERROR(b->AddScalar(memory_limit_, &memory_limit));
+      TF_RETURN_IF_ERROR(b->AddScalar(spill_directory_, &spill_directory));
+      TF_RETURN_IF_ERROR(b->AddScalar(seed_, &seed));
+      TF_RETURN_IF_ERROR(b->AddScalar(seed2_, &seed2));
+      TF_RETURN_IF_ERROR(b->AddDataset(
+          this,
+          {input_graph_node, buffer_size, memory_limit, spill_directory, seed,
+           seed2},
+          output));
+      return Status::OK();
+    }
+
+   private:
+    // The buffer of the iterator is an in-memory window, which holds at most
+    // `memory_limit_` bytes, plus spill files. When the window is full, it is
+    // shuffled and written to a new spill file, called a run.
+    //
+    // Each output element is drawn uniformly at random from the whole buffer:
+    // the iterator picks the window or a run with a probability proportional
+    // to the number of elements it holds, and then a random element of the
+    // window, or the next element of the run. Because a run is shuffled, its
+    // next element is a uniformly random one of its remaining elements.
+    class Iterator : public DatasetIterator<Dataset> {
+     public:
+      explicit Iterator(const Params& params)
+          : DatasetIterator<Dataset>(params),
+            spill_prefix_(io::JoinPath(
+                params.dataset->spill_directory_,
+                strings::StrCat("tf_data_shuffle_spill_", random::New64()))),
+            parent_generator_(params.dataset->seed_, params.dataset->seed2_),
+            generator_(&parent_generator_) {}
+
+      ~Iterator() override {
+        mutex_lock l(mu_);
+        DeleteRunsLocked();
+      }
+
+      Status Initialize(IteratorContext* ctx) override {
+        return dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_);
+      }
+
+      Status GetNextInternal(IteratorContext* ctx,
+                             std::vector<Tensor>* out_tensors,
+                             bool* end_of_sequence) override {
+        mutex_lock l(mu_);
+        while (input_impl_ && num_elements_ < dataset()->buffer_size_) {
+          std::vector<Tensor> input_element;
+          bool end_of_input_sequence = false;
+          TF_RETURN_IF_ERROR(input_impl_->GetNext(ctx, &input_element,
+                                                  &end_of_input_sequence));
+          if (end_of_input_sequence) {
+            input_impl_.reset();
+            break;
+          }
+          memory_bytes_ += TotalBytes(input_element);
+          memory_.push_back(std::move(input_element));
+          ++num_elements_;
+          if (memory_bytes_ > dataset()->memory_limit_) {
+            TF_RETURN_IF_ERROR(SpillLocked());
+          }
+        }
+
+        if (num_elements_ == 0) {
+          *end_of_sequence = true;
+          return Status::OK();
+        }
+        *end_of_sequence = false;
+        int64 index = Random() % num_elements_;
+        if (index < static_cast<int64>(memory_.size())) {
+          memory_bytes_ -= TotalBytes(memory_[index]);
+          *out_tensors = std::move(memory_[index]);
+          std::swap(memory_[index], memory_.back());
+          memory_.pop_back();
+        } else {
+          index -= memory_.size();
+          auto run = runs_.begin();
+          while (index >= (*run)->num_elements) {
+            index -= (*run)->num_elements;
+            ++run;
+          }
+          TF_RETURN_IF_ERROR(ReadElement(ctx, (*run)->reader.get(),
+                                         out_tensors));
+          if (--(*run)->num_elements == 0) {
+            TF_RETURN_IF_ERROR(DeleteRun(run->get()));
+            runs_.erase(run);
+          }
+        }
+        --num_elements_;
+        return Status::OK();
+      }
+
+     protected:
+      Status SaveInternal(IteratorStateWriter* writer) override {
+        mutex_lock l(mu_);
+        // Save state needed to restore the random number generator.
+        TF_RETURN_IF_ERROR(writer->WriteScalar(full_name("num_random_samples"),
+                                               num_random_samples_));
+
+        if (input_impl_) {
+          TF_RETURN_IF_ERROR(SaveInput(writer, input_impl_));
+        } else {
+          TF_RETURN_IF_ERROR(
+              writer->WriteScalar(full_name("end_of_input_sequence"), ""));
+        }
+
+        // Save the in-memory window.
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name("memory_size"), memory_.size()));
+        for (size_t i = 0; i < memory_.size(); ++i) {
+          for (size_t j = 0; j < memory_[i].size(); ++j) {
+            TF_RETURN_IF_ERROR(writer->WriteTensor(
+                full_name(strings::StrCat("memory_", i, "_", j)),
+                memory_[i][j]));
+          }
+        }
+
+        // Save the remaining records of the runs, read through another
+        // reader so that the runs are not advanced.
+        TF_RETURN_IF_ERROR(
+            writer->WriteScalar(full_name("runs_size"), runs_.size()));
+        const size_t num_components = dataset()->output_dtypes().size();
+        for (size_t i = 0; i < runs_.size(); ++i) {
+          const Run& run = *runs_[i];
+          TF_RETURN_IF_ERROR(writer->WriteScalar(
+              full_name(strings::StrCat("run_", i, "_size")),
+              run.num_elements));
+          std::unique_ptr<RandomAccessFile> file;
+          TF_RETURN_IF_ERROR(
+              dataset()->env_->NewRandomAccessFile(run.filename, &file));
+          io::SequentialRecordReader reader(file.get());
+          TF_RETURN_IF_ERROR(reader.SeekOffset(run.reader->TellOffset()));
+          string record;
+          for (int64 j = 0; j < run.num_elements * num_components; ++j) {
+            TF_RETURN_IF_ERROR(reader.ReadRecord(&record));
+            TF_RETURN_IF_ERROR(writer->WriteScalar(
+                full_name(strings::StrCat("run_", i, "_", j)), record));
+          }
+        }
+        return Status::OK();
+      }
+
+      Status RestoreInternal(IteratorContext* ctx,
+                             IteratorStateReader* reader) override {
+        mutex_lock l(mu_);
+        // Restore the random number generator.
+        TF_RETURN_IF_ERROR(reader->ReadScalar(full_name("num_random_samples"),
+                                              &num_random_samples_));
+        ResetRngs();
+
+        // Restore the input iterator if it wasn't already exhausted.
+        if (!reader->Contains(full_name("end_of_input_sequence"))) {
+          if (!input_impl_) {
+            TF_RETURN_IF_ERROR(
+                dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_));
+          }
+          TF_RETURN_IF_ERROR(RestoreInput(ctx, reader, input_impl_));
+        } else {
+          input_impl_.reset();
+        }
+
+        DeleteRunsLocked();
+        const size_t num_components = dataset()->output_dtypes().size();
+        int64 memory_size;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name("memory_size"), &memory_size));
+        memory_.clear();
+        memory_bytes_ = 0;
+        for (int64 i = 0; i < memory_size; ++i) {
+          std::vector<Tensor> element(num_components);
+          for (size_t j = 0; j < num_components; ++j) {
+            TF_RETURN_IF_ERROR(reader->ReadTensor(
+                full_name(strings::StrCat("memory_", i, "_", j)),
+                &element[j]));
+          }
+          memory_bytes_ += TotalBytes(element);
+          memory_.push_back(std::move(element));
+        }
+        num_elements_ = memory_.size();
+
+        // Write the runs to new spill files.
+        int64 runs_size;
+        TF_RETURN_IF_ERROR(
+            reader->ReadScalar(full_name("runs_size"), &runs_size));
+        for (int64 i = 0; i < runs_size; ++i) {
+          int64 run_size;
+          TF_RETURN_IF_ERROR(reader->ReadScalar(
+              full_name(strings::StrCat("run_", i, "_size")), &run_size));
+          std::unique_ptr<WritableFile> file;
+          const string filename = NextRunFilename();
+          TF_RETURN_IF_ERROR(dataset()->env_->NewWritableFile(filename, &file));
+          io::RecordWriter writer(file.get());
+          string record;
+          for (int64 j = 0; j < run_size * num_components; ++j) {
+            TF_RETURN_IF_ERROR(reader->ReadScalar(
+                full_name(strings::StrCat("run_", i, "_", j)), &record));
+            TF_RETURN_IF_ERROR(writer.WriteRecord(record));
+          }
+          TF_RETURN_IF_ERROR(writer.Close());
+          TF_RETURN_IF_ERROR(file->Close());
+          TF_RETURN_IF_ERROR(AddRunLocked(filename, run_size));
+        }
+        return Status::OK();
+      }
+
+     private:
+      // A spill file, and a reader positioned at its next element. Every
+      // component of an element is a record holding a `TensorProto`.
+      struct Run {
+        string filename;
+        int64 num_elements;
+        std::unique_ptr<RandomAccessFile> file;
+        // Reads `file`, so it is declared after it.
+        std::unique_ptr<io::SequentialRecordReader> reader;
+      };
+
+      static int64 TotalBytes(const std::vector<Tensor>& element) {
+        int64 bytes = 0;
+        for (const Tensor& t : element) {
+          bytes += t.TotalBytes();
+        }
+        return bytes;
+      }
+
+      string NextRunFilename() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        return strings::StrCat(spill_prefix_, "_", next_run_id_++);
+      }
+
+      // Shuffles the in-memory window and writes it to a new run.
+      Status SpillLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        for (size_t i = memory_.size(); i > 1; --i) {
+          std::swap(memory_[i - 1], memory_[Random() % i]);
+        }
+        const string filename = NextRunFilename();
+        std::unique_ptr<WritableFile> file;
+        TF_RETURN_IF_ERROR(dataset()->env_->NewWritableFile(filename, &file));
+        io::RecordWriter writer(file.get());
+        string record;
+        for (const std::vector<Tensor>& element : memory_) {
+          for (const Tensor& t : element) {
+            TensorProto proto;
+            t.AsProtoTensorContent(&proto);
+            if (!proto.SerializeToString(&record)) {
+              return errors::Internal(
+                  "Failed to serialize an element of the shuffle buffer.");
+            }
+            TF_RETURN_IF_ERROR(writer.WriteRecord(record));
+          }
+        }
+        TF_RETURN_IF_ERROR(writer.Close());
+        TF_RETURN_IF_ERROR(file->Close());
+        // The spilled elements are already counted in `num_elements_`, and
+        // AddRunLocked() counts them again.
+        num_elements_ -= memory_.size();
+        TF_RETURN_IF_ERROR(AddRunLocked(filename, memory_.size()));
+        memory_.clear();
+        memory_bytes_ = 0;
+        return Status::OK();
+      }
+
+      Status AddRunLocked(const string& filename, int64 num_elements)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        std::unique_ptr<Run> run(new Run);
+        run->filename = filename;
+        run->num_elements = num_elements;
+        TF_RETURN_IF_ERROR(
+            dataset()->env_->NewRandomAccessFile(filename, &run->file));
+        io::RecordReaderOptions options;
+        options.buffer_size = kSpillReadBufferSize;
+        run->reader.reset(
+            new io::SequentialRecordReader(run->file.get(), options));
+        runs_.push_back(std::move(run));
+        num_elements_ += num_elements;
+        return Status::OK();
+      }
+
+      Status ReadElement(IteratorContext* ctx,
+                         io::SequentialRecordReader* reader,
+                         std::vector<Tensor>* element) {
+        const size_t num_components = dataset()->output_dtypes().size();
+        element->clear();
+        element->reserve(num_components);
+        string record;
+        for (size_t i = 0; i < num_components; ++i) {
+          TF_RETURN_IF_ERROR(reader->ReadRecord(&record));
+          TensorProto proto;
+          Tensor t;
+          if (!proto.ParseFromString(record) ||
+              !t.FromProto(ctx->allocator({}), proto)) {
+            return errors::DataLoss(
+                "Corrupted element in a spill file of the shuffle buffer.");
+          }
+          element->push_back(std::move(t));
+        }
+        return Status::OK();
+      }
+
+      Status DeleteRun(Run* run) {
+        run->reader.reset();
+        run->file.reset();
+        return dataset()->env_->DeleteFile(run->filename);
+      }
+
+      void DeleteRunsLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        for (auto& run : runs_) {
+          num_elements_ -= run->num_elements;
+          Status s = DeleteRun(run.get());
+          if (!s.ok()) {
+            LOG(WARNING) << "Failed to delete spill file " << run->filename
+                         << ": " << s;
+          }
+        }
+        runs_.clear();
+      }
+
+      random::SingleSampleAdapter<random::PhiloxRandom>::ResultType Random()
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        num_random_samples_++;
+        return generator_();
+      }
+
+      void ResetRngs() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        parent_generator_ =
+            random::PhiloxRandom(dataset()->seed_, dataset()->seed2_);
+        generator_ = random::SingleSampleAdapter<random::PhiloxRandom>(
+            &parent_generator_);
+        generator_.Skip(num_random_samples_);
+      }
+
+      const string spill_prefix_;
+      mutex mu_;
+      std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(mu_);
+      // The in-memory window, and the bytes of its tensors.
+      std::vector<std::vector<Tensor>> memory_ GUARDED_BY(mu_);
+      int64 memory_bytes_ GUARDED_BY(mu_) = 0;
+      std::deque<std::unique_ptr<Run>> runs_ GUARDED_BY(mu_);
+      int64 next_run_id_ GUARDED_BY(mu_) = 0;
+      // The number of elements in the window and in the runs.
+      int64 num_elements_ GUARDED_BY(mu_) = 0;
+      random::PhiloxRandom parent_generator_ GUARDED_BY(mu_);
+      random::SingleSampleAdapter<random::PhiloxRandom> generator_
+          GUARDED_BY(mu_);
+      int64 num_random_samples_ GUARDED_BY(mu_) = 0;
+    };
+
+    const DatasetBase* const input_;
+    const int64 buffer_size_;
+    const int64 memory_limit_;
+    const string spill_directory_;
+    const int64 seed_;
+    const int64 seed2_;
+    Env* const env_;
+  };
+};
+
+REGISTER_KERNEL_BUILDER(Name("SpillingShuffleDataset").Device(DEVICE_CPU),
+                        SpillingShuffleDatasetOp);
+
+}  // namespace
+
+}  // namespace tensorflow
@@ -90,6 +90,45 @@ REGISTER_OP("UniqueDataset")
 Creates a dataset that contains the unique elements of `input_dataset`.
 )doc");
 
+REGISTER_OP("SpillingShuffleDataset")
+    .Input("input_dataset: variant")
+    .Input("buffer_size: int64")
+    .Input("memory_limit: int64")
+    .Input("spill_directory: string")
+    .Input("seed: int64")
+    .Input("seed2: int64")
+    .Output("handle: variant")
+    .Attr("output_types: list(type) >= 1")
+    .Attr("output_shapes: list(shape) >= 1")
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      shape_inference::ShapeHandle unused;
+      // buffer_size, memory_limit, spill_directory, seed, and seed2 should be
+      // scalars.
+      for (int i = 1; i <= 5; ++i) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 0, &unused));
+      }
+      return shape_inference::ScalarShape(c);
+    })
+    .Doc(R"doc(
+Creates a dataset that shuffles elements from `input_dataset` pseudorandomly,
+keeping at most `memory_limit` bytes of its buffer in memory.
+
+The rest of the buffer is spilled to files in `spill_directory`. Every
+element is still drawn uniformly at random from all `buffer_size` buffered
+elements.
+
+buffer_size: The number of output elements to buffer in an iterator over
+  this dataset. Compare with the `min_after_dequeue` attr when creating a
+  `RandomShuffleQueue`.
+memory_limit: The number of bytes of the buffer to keep in memory.
+spill_directory: The directory of the spill files. If empty, a local
+  temporary directory is used.
+seed: A scalar seed for the random number generator. If either `seed` or
+  `seed2` is set to be non-zero, the random number generator is seeded
+  by the given seed.  Otherwise, a random seed is used.
+seed2: A second scalar seed to avoid seed collision.
+)doc");
+
 REGISTER_OP("IteratorGetDevice")
     .Input("resource: resource")
     .Output("device: string")
@@ -266,6 +305,22 @@ REGISTER_OP("AssertNextDataset")
       return shape_inference::ScalarShape(c);
     });
 
+REGISTER_OP("ModelDataset")
+    .Input("input_dataset: variant")
+    .Output("handle: variant")
+    .Attr("output_types: list(type) >= 1")
+    .Attr("output_shapes: list(shape) >= 1")
+    .SetShapeFn(shape_inference::ScalarShape)
+    .Doc(R"doc(
+Identity transformation that models the performance of its input pipeline.
+
+The iterators of `input_dataset` record how long they take to produce their
+elements, and the parameters set to `tf.contrib.data.AUTOTUNE`, such as
+`num_parallel_calls`, are tuned in the background based on the model.
+
+input_dataset: A variant tensor representing the input dataset.
+)doc");
+
 REGISTER_OP("LMDBDataset")
     .Input("filenames: string")
     .Output("handle: variant")
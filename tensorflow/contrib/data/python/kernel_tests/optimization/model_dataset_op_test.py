@@ -0,0 +1,60 @@
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the ModelDataset transformation."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+from tensorflow.contrib.data.python.ops import batching
+from tensorflow.contrib.data.python.ops import optimization
+from tensorflow.python.data.ops import dataset_ops
+from tensorflow.python.framework import errors
+from tensorflow.python.platform import test
+
+
+class ModelDatasetTest(test.TestCase):
+
+  def _assertProducesRange(self, dataset, n):
+    iterator = dataset.make_initializable_iterator()
+    get_next = iterator.get_next()
+
+    with self.test_session() as sess:
+      sess.run(iterator.initializer)
+      for i in range(n):
+        self.assertEqual(i * i, sess.run(get_next))
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(get_next)
+
+  def testAutotuneParallelMap(self):
+    dataset = dataset_ops.Dataset.range(100).map(
+        lambda x: x * x, num_parallel_calls=-1).prefetch(-1).apply(
+            optimization.model())
+    self._assertProducesRange(dataset, 100)
+
+  def testAutotuneMapAndBatch(self):
+    dataset = dataset_ops.Dataset.range(100).apply(
+        batching.map_and_batch(
+            lambda x: x * x, batch_size=1, num_parallel_calls=-1)).apply(
+                batching.unbatch()).apply(optimization.model())
+    self._assertProducesRange(dataset, 100)
+
+  def testAutotuneWithoutModel(self):
+    dataset = dataset_ops.Dataset.range(100).map(
+        lambda x: x * x, num_parallel_calls=-1).prefetch(-1)
+    self._assertProducesRange(dataset, 100)
+
+
+if __name__ == "__main__":
+  test.main()
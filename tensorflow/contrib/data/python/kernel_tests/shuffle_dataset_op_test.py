@@ -110,5 +110,82 @@ class ShuffleAndRepeatTest(test.TestCase):
         sess.run(get_next_op)
 
 
+class ShuffleWithSpillingTest(test.TestCase):
+
+  def _build_ds(self, seed, buffer_size=10, memory_limit=24, num_elements=50):
+    # Each element is 8 bytes, so the in-memory window spills every 4
+    # elements.
+    return dataset_ops.Dataset.range(num_elements).apply(
+        shuffle_ops.shuffle_with_spilling(
+            buffer_size=buffer_size,
+            memory_limit=memory_limit,
+            spill_directory=self.get_temp_dir(),
+            seed=seed))
+
+  def _gen_outputs(self, ds_fn):
+    get_next = ds_fn().make_one_shot_iterator().get_next()
+    outputs = []
+    with self.test_session() as sess:
+      while True:
+        try:
+          outputs.append(sess.run(get_next))
+        except errors.OutOfRangeError:
+          break
+    return outputs
+
+  def testCorrectOutput(self):
+    output = self._gen_outputs(lambda: self._build_ds(10))
+    self.assertSequenceEqual(sorted(output), range(50))
+    self.assertNotEqual(output, list(range(50)))
+
+  def testEveryElementOnceAfterManySpills(self):
+    # The window spills every 2 elements, so most of the buffer is on disk
+    # by the time the input ends.
+    output = self._gen_outputs(
+        lambda: self._build_ds(10, buffer_size=100, memory_limit=8,
+                               num_elements=37))
+    self.assertEqual(37, len(output))
+    self.assertEqual(list(range(37)), sorted(output))
+
+  def testSameOrderForSameSeeds(self):
+    output1 = self._gen_outputs(lambda: self._build_ds(10))
+    output2 = self._gen_outputs(lambda: self._build_ds(10))
+    self.assertEqual(output1, output2)
+
+  def testDifferentOrderForDifferentSeeds(self):
+    output1 = self._gen_outputs(lambda: self._build_ds(10))
+    output2 = self._gen_outputs(lambda: self._build_ds(20))
+    self.assertNotEqual(output1, output2)
+    self.assertEqual(sorted(output1), sorted(output2))
+
+  def testBufferBoundsDisplacement(self):
+    # An element cannot be produced before the buffer is filled up to it.
+    output = self._gen_outputs(lambda: self._build_ds(10, buffer_size=5))
+    for i, x in enumerate(output):
+      self.assertLess(x, i + 5)
+
+  def testUniformSampling(self):
+    # With a buffer as large as the input, the first output is uniformly
+    # distributed over the input, whether it is in memory or spilled.
+    def first_output(seed):
+      return self._gen_outputs(
+          lambda: self._build_ds(seed, num_elements=10).take(1))[0]
+
+    counts = np.zeros(10)
+    for seed in range(1, 201):
+      counts[first_output(seed)] += 1
+    self.assertGreater(counts.min(), 5)
+    self.assertLess(counts.max(), 45)
+
+  def testNoSpilling(self):
+    output = self._gen_outputs(
+        lambda: self._build_ds(10, memory_limit=1 << 20))
+    self.assertSequenceEqual(sorted(output), range(50))
+
+  def testEmpty(self):
+    self.assertEqual([], self._gen_outputs(
+        lambda: self._build_ds(10, num_elements=0)))
+
+
 if __name__ == "__main__":
   test.main()
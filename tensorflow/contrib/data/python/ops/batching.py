@@ -769,7 +769,10 @@ def map_and_batch(map_func,
     num_parallel_calls: (Optional.) A `tf.int32` scalar `tf.Tensor`,
         representing the number of elements to process in parallel. If not
         specified, `batch_size * num_parallel_batches` elements will be
-        processed in parallel.
+        processed in parallel. If the value `tf.contrib.data.AUTOTUNE` is
+        used, then the number of parallel calls is tuned dynamically when the
+        pipeline is followed by `tf.contrib.data.optimization.model()`, and
+        set based on available CPU otherwise.
 
   Returns:
     A `Dataset` transformation function, which can be passed to
@@ -17,6 +17,8 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+from tensorflow.contrib.data.python.ops import contrib_op_loader  # pylint: disable=unused-import
+from tensorflow.contrib.data.python.ops import gen_dataset_ops as contrib_gen_dataset_ops
 from tensorflow.python.data.ops import dataset_ops
 from tensorflow.python.data.util import random_seed
 from tensorflow.python.framework import constant_op
@@ -103,3 +105,93 @@ def shuffle_and_repeat(buffer_size, count=None, seed=None):
     return _ShuffleAndRepeatDataset(dataset, buffer_size, count, seed)
 
   return _apply_fn
+
+
+class _SpillingShuffleDataset(dataset_ops.Dataset):
+  """A `Dataset` that shuffles with a buffer that is partly on disk."""
+
+  def __init__(self,
+               input_dataset,
+               buffer_size,
+               memory_limit,
+               spill_directory=None,
+               seed=None):
+    """See `shuffle_with_spilling()` for details."""
+    super(_SpillingShuffleDataset, self).__init__()
+    self._input_dataset = input_dataset
+    self._buffer_size = ops.convert_to_tensor(
+        buffer_size, dtype=dtypes.int64, name="buffer_size")
+    self._memory_limit = ops.convert_to_tensor(
+        memory_limit, dtype=dtypes.int64, name="memory_limit")
+    self._spill_directory = ops.convert_to_tensor(
+        spill_directory if spill_directory is not None else "",
+        dtype=dtypes.string,
+        name="spill_directory")
+    self._seed, self._seed2 = random_seed.get_seed(seed)
+
+  def _as_variant_tensor(self):
+    # pylint: disable=protected-access
+    input_resource = self._input_dataset._as_variant_tensor()
+    return contrib_gen_dataset_ops.spilling_shuffle_dataset(
+        input_resource,
+        buffer_size=self._buffer_size,
+        memory_limit=self._memory_limit,
+        spill_directory=self._spill_directory,
+        seed=self._seed,
+        seed2=self._seed2,
+        **dataset_ops.flat_structure(self))
+    # pylint: enable=protected-access
+
+  @property
+  def output_classes(self):
+    return self._input_dataset.output_classes
+
+  @property
+  def output_shapes(self):
+    return self._input_dataset.output_shapes
+
+  @property
+  def output_types(self):
+    return self._input_dataset.output_types
+
+
+def shuffle_with_spilling(buffer_size,
+                          memory_limit,
+                          spill_directory=None,
+                          seed=None):
+  """Shuffles a Dataset with a buffer that does not have to fit in memory.
+
+  `dataset.apply(tf.contrib.data.shuffle_with_spilling(buffer_size, limit))`
+
+  produces the elements of `dataset` in the same distribution as
+  `dataset.shuffle(buffer_size)`: every element is drawn uniformly at random
+  from the `buffer_size` buffered elements. However, at most `memory_limit`
+  bytes of the buffer are kept in memory. The rest is written to spill files
+  in `spill_directory`, which are read back as their elements are drawn.
+
+  Use it for buffers of large elements, e.g. images, that would not fit in
+  memory. The spill files should be on a fast local disk. Each iterator
+  shuffles in the same order, as with `reshuffle_each_iteration=False`.
+
+  Args:
+    buffer_size: A `tf.int64` scalar `tf.Tensor`, representing the number of
+      elements from this dataset from which the new dataset will sample.
+    memory_limit: A `tf.int64` scalar `tf.Tensor`, representing the number of
+      bytes of the buffer to keep in memory.
+    spill_directory: (Optional.) A `tf.string` scalar `tf.Tensor`,
+      representing the directory of the spill files. Defaults to a local
+      temporary directory.
+    seed: (Optional.) A `tf.int64` scalar `tf.Tensor`, representing the
+      random seed that will be used to create the distribution. See
+      `tf.set_random_seed` for behavior.
+
+  Returns:
+    A `Dataset` transformation function, which can be passed to
+    `tf.data.Dataset.apply`.
+  """
+
+  def _apply_fn(dataset):  # pylint: disable=missing-docstring
+    return _SpillingShuffleDataset(dataset, buffer_size, memory_limit,
+                                   spill_directory, seed)
+
+  return _apply_fn
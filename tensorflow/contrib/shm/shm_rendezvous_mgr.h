@@ -0,0 +1,53 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CONTRIB_SHM_SHM_RENDEZVOUS_MGR_H_
+#define TENSORFLOW_CONTRIB_SHM_SHM_RENDEZVOUS_MGR_H_
+
+#include "tensorflow/contrib/shm/shm_transport.h"
+#include "tensorflow/core/distributed_runtime/base_rendezvous_mgr.h"
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
+#include "tensorflow/core/distributed_runtime/worker_env.h"
+#include "tensorflow/core/platform/macros.h"
+
+namespace tensorflow {
+
+// Receives tensors from co-located tasks through shared memory, and from
+// all other tasks over gRPC, requesting compression from the latter as
+// "compression_policy" says.
+class ShmRendezvousMgr : public BaseRendezvousMgr {
+ public:
+  ShmRendezvousMgr(const WorkerEnv* env, ShmTransport* shm_transport,
+                   const TensorCompressionPolicy& compression_policy);
+
+  // Also revokes the shared memory of the tensors this task sent in the
+  // step that no peer received.
+  void Cleanup(int64 step_id) override;
+  void CleanupAll() override;
+
+ protected:
+  BaseRemoteRendezvous* Create(int64 step_id,
+                               const WorkerEnv* worker_env) override;
+
+ private:
+  ShmTransport* shm_transport_;  // Not owned
+  const TensorCompressionPolicy compression_policy_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ShmRendezvousMgr);
+};
+
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CONTRIB_SHM_SHM_RENDEZVOUS_MGR_H_
@@ -0,0 +1,266 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/shm/shm_segment.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+const uint64 kMagic = 0x7466736867656d31ull;  // "tfshgem1"
+
+// Slots and their contents are aligned like any other tensor buffer.
+const uint64 kAlignment = Allocator::kAllocatorAlignment;
+
+struct SegmentHeader {
+  uint64 magic;
+  uint64 capacity;
+};
+
+enum SlotState : uint64 {
+  // Allocated by the producer and not yet claimed by a consumer.
+  kSlotInUse = 1,
+  // Claimed by the consumer that is copying the content out.
+  kSlotReading = 2,
+  kSlotReleased = 3,
+  // Marks the unused space at the end of the ring before it wraps around.
+  kSlotWrap = 4,
+};
+
+// The state of a slot shares one word with its sequence number, so that a
+// consumer claims a slot, and the producer revokes it, only if it still
+// holds the allocation they expect.
+const int kStateBits = 3;
+const uint64 kStateMask = (1 << kStateBits) - 1;
+
+uint64 Tag(uint64 sequence, SlotState state) {
+  return (sequence << kStateBits) | state;
+}
+
+struct SlotHeader {
+  std::atomic<uint64> tag;
+  // Bytes from the start of this slot to the start of the next.
+  uint64 span;
+  uint64 size;
+};
+
+static_assert(sizeof(SegmentHeader) <= kAlignment, "SegmentHeader too big");
+static_assert(sizeof(SlotHeader) <= kAlignment, "SlotHeader too big");
+
+uint64 RoundUp(uint64 n) {
+  return (n + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+}  // namespace
+
+ShmSegment::ShmSegment(const string& name, bool owner, char* base,
+                       size_t capacity)
+    : name_(name),
+      owner_(owner),
+      base_(base),
+      capacity_(capacity),
+      head_(kAlignment),
+      tail_(kAlignment),
+      used_(0),
+      next_sequence_(1) {}
+
+ShmSegment::~ShmSegment() {
+  munmap(base_, capacity_);
+  if (owner_) {
+    shm_unlink(name_.c_str());
+  }
+}
+
+/* static */
+Status ShmSegment::Create(const string& name, size_t capacity,
+                          std::unique_ptr<ShmSegment>* out) {
+  capacity = capacity / kAlignment * kAlignment;
+  if (capacity < 2 * kAlignment) {
+    return errors::InvalidArgument("Shared memory segment capacity ", capacity,
+                                   " is too small");
+  }
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    return errors::Unavailable("shm_open(", name, ") failed: ",
+                               strerror(errno));
+  }
+  if (ftruncate(fd, capacity) != 0) {
+    Status s =
+        errors::Unavailable("ftruncate(", name, ") failed: ", strerror(errno));
+    close(fd);
+    shm_unlink(name.c_str());
+    return s;
+  }
+  void* base =
+      mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return errors::Unavailable("mmap(", name, ") failed: ", strerror(errno));
+  }
+  SegmentHeader* header = reinterpret_cast<SegmentHeader*>(base);
+  header->magic = kMagic;
+  header->capacity = capacity;
+  out->reset(
+      new ShmSegment(name, true /*owner*/, static_cast<char*>(base), capacity));
+  return Status::OK();
+}
+
+/* static */
+Status ShmSegment::Open(const string& name, std::unique_ptr<ShmSegment>* out) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return errors::Unavailable("shm_open(", name, ") failed: ",
+                               strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 2 * kAlignment) {
+    close(fd);
+    return errors::Unavailable("Shared memory segment ", name,
+                               " has no valid size");
+  }
+  const size_t capacity = st.st_size;
+  void* base =
+      mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return errors::Unavailable("mmap(", name, ") failed: ", strerror(errno));
+  }
+  const SegmentHeader* header = reinterpret_cast<SegmentHeader*>(base);
+  if (header->magic != kMagic || header->capacity != capacity) {
+    munmap(base, capacity);
+    return errors::Unavailable(name, " is not a shared memory segment");
+  }
+  out->reset(new ShmSegment(name, false /*owner*/, static_cast<char*>(base),
+                            capacity));
+  return Status::OK();
+}
+
+void ShmSegment::Reclaim() {
+  while (used_ > 0) {
+    if (tail_ == capacity_) {
+      tail_ = kAlignment;
+      continue;
+    }
+    SlotHeader* slot = reinterpret_cast<SlotHeader*>(base_ + tail_);
+    const uint64 state = slot->tag.load(std::memory_order_acquire) & kStateMask;
+    if (state == kSlotInUse || state == kSlotReading) break;
+    used_ -= slot->span;
+    tail_ += slot->span;
+  }
+  if (used_ == 0) {
+    head_ = kAlignment;
+    tail_ = kAlignment;
+  }
+}
+
+bool ShmSegment::Allocate(size_t size, uint64* offset, uint64* sequence,
+                          void** data) {
+  const uint64 span = kAlignment + RoundUp(size);
+  mutex_lock l(mu_);
+  Reclaim();
+  if (used_ > 0 && head_ == tail_) return false;  // Full.
+  if (head_ >= tail_) {
+    // Free space is [head_, capacity_) followed by [kAlignment, tail_).
+    if (capacity_ - head_ < span) {
+      if (tail_ - kAlignment < span) return false;
+      const uint64 waste = capacity_ - head_;
+      if (waste > 0) {
+        SlotHeader* wrap = reinterpret_cast<SlotHeader*>(base_ + head_);
+        wrap->span = waste;
+        wrap->tag.store(Tag(0, kSlotWrap), std::memory_order_relaxed);
+        used_ += waste;
+      }
+      head_ = kAlignment;
+    }
+  } else if (tail_ - head_ < span) {
+    return false;
+  }
+  SlotHeader* slot = reinterpret_cast<SlotHeader*>(base_ + head_);
+  slot->span = span;
+  slot->size = size;
+  *sequence = next_sequence_++;
+  slot->tag.store(Tag(*sequence, kSlotInUse), std::memory_order_release);
+  *offset = head_;
+  *data = base_ + head_ + kAlignment;
+  head_ += span;
+  used_ += span;
+  return true;
+}
+
+bool ShmSegment::Revoke(uint64 offset, uint64 sequence) {
+  mutex_lock l(mu_);
+  Reclaim();
+  // Slots are reclaimed in sequence order, so the slot is gone, and
+  // "offset" may now point into another one, iff its sequence is older
+  // than that of the oldest slot left.
+  if (used_ == 0) return false;
+  SlotHeader* oldest = reinterpret_cast<SlotHeader*>(base_ + tail_);
+  if (sequence < (oldest->tag.load(std::memory_order_acquire) >> kStateBits)) {
+    return false;
+  }
+  SlotHeader* slot = reinterpret_cast<SlotHeader*>(base_ + offset);
+  uint64 expected = Tag(sequence, kSlotInUse);
+  return slot->tag.compare_exchange_strong(expected,
+                                           Tag(sequence, kSlotReleased),
+                                           std::memory_order_acq_rel);
+}
+
+Status ShmSegment::Acquire(uint64 offset, uint64 sequence, uint64 size,
+                           const void** data) {
+  if (offset % kAlignment != 0 || offset < kAlignment ||
+      offset + kAlignment + size > capacity_) {
+    return errors::Internal("Invalid region [", offset, ", +", size,
+                            ") of shared memory segment ", name_);
+  }
+  SlotHeader* slot = reinterpret_cast<SlotHeader*>(base_ + offset);
+  uint64 expected = Tag(sequence, kSlotInUse);
+  if (!slot->tag.compare_exchange_strong(expected,
+                                         Tag(sequence, kSlotReading),
+                                         std::memory_order_acq_rel)) {
+    return errors::Internal("Stale region at offset ", offset,
+                            " of shared memory segment ", name_);
+  }
+  if (slot->size != size) {
+    // No consumer can claim the slot correctly, so do not leave it behind.
+    slot->tag.store(Tag(sequence, kSlotReleased), std::memory_order_release);
+    return errors::Internal("Region at offset ", offset,
+                            " of shared memory segment ", name_, " holds ",
+                            slot->size, " bytes, not ", size);
+  }
+  *data = base_ + offset + kAlignment;
+  return Status::OK();
+}
+
+void ShmSegment::Release(uint64 offset, uint64 sequence) {
+  SlotHeader* slot = reinterpret_cast<SlotHeader*>(base_ + offset);
+  slot->tag.store(Tag(sequence, kSlotReleased), std::memory_order_release);
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,100 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CONTRIB_SHM_SHM_SEGMENT_H_
+#define TENSORFLOW_CONTRIB_SHM_SHM_SEGMENT_H_
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A POSIX shared-memory object used as a ring buffer of slots.
+//
+// Exactly one process, the producer, creates the segment and allocates
+// slots from it.  Any number of consumer processes open it by name, claim
+// a slot, read its content and release it.  Slots are reclaimed by the
+// producer in allocation order, so a slot that is never released stops
+// reclamation and Allocate() eventually fails; callers are expected to
+// fall back to another transport in that case, and to Revoke() slots that
+// no consumer will claim.
+class ShmSegment {
+ public:
+  ~ShmSegment();
+
+  // Creates and maps a new segment called "name" with room for "capacity"
+  // bytes, including headers.  The segment is unlinked when the returned
+  // object is destroyed.
+  static Status Create(const string& name, size_t capacity,
+                       std::unique_ptr<ShmSegment>* out);
+
+  // Maps the existing segment called "name".
+  static Status Open(const string& name, std::unique_ptr<ShmSegment>* out);
+
+  const string& name() const { return name_; }
+
+  // Producer only.  Reserves a slot for "size" bytes of content.  On
+  // success returns true and sets *offset and *sequence, which identify
+  // the slot to consumers, and *data, which points to the content.
+  // Returns false if the ring has no room for the slot.
+  bool Allocate(size_t size, uint64* offset, uint64* sequence, void** data);
+
+  // Producer only.  Releases the slot allocated at "offset" with
+  // "sequence" unless a consumer has claimed it.  Returns true iff the
+  // slot was released by this call.
+  bool Revoke(uint64 offset, uint64 sequence);
+
+  // Claims the slot at "offset" and sets *data to its content, checking
+  // that it was allocated with "sequence" and "size" and has been neither
+  // claimed nor revoked.  Called by consumers, or by the producer to resend
+  // the content of a slot that no consumer could read.
+  Status Acquire(uint64 offset, uint64 sequence, uint64 size,
+                 const void** data);
+
+  // Returns the slot claimed by Acquire() to the producer.
+  // The content must not be accessed afterwards.
+  void Release(uint64 offset, uint64 sequence);
+
+ private:
+  ShmSegment(const string& name, bool owner, char* base, size_t capacity);
+
+  // Advances tail_ past released slots.
+  void Reclaim() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const string name_;
+  const bool owner_;
+  char* const base_;
+  const size_t capacity_;
+
+  // Producer-side ring state.  Only the producer moves head_ and tail_, so
+  // they need not live in the shared segment.
+  mutex mu_;
+  uint64 head_ GUARDED_BY(mu_);
+  uint64 tail_ GUARDED_BY(mu_);
+  uint64 used_ GUARDED_BY(mu_);
+  uint64 next_sequence_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ShmSegment);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CONTRIB_SHM_SHM_SEGMENT_H_
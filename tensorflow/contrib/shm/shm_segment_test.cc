@@ -0,0 +1,189 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/shm/shm_segment.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+const size_t kCapacity = 64 << 10;
+
+string SegmentName(const string& test) {
+  return strings::StrCat("/tensorflow_shm_segment_test_", test, "_",
+                         getpid());
+}
+
+struct Region {
+  uint64 offset;
+  uint64 sequence;
+  uint64 size;
+};
+
+// Allocates a slot of "size" bytes filled with "fill".
+Region AllocateFilled(ShmSegment* segment, size_t size, char fill) {
+  Region region;
+  void* data;
+  EXPECT_TRUE(
+      segment->Allocate(size, &region.offset, &region.sequence, &data));
+  memset(data, fill, size);
+  region.size = size;
+  return region;
+}
+
+TEST(ShmSegmentTest, OpenMissing) {
+  std::unique_ptr<ShmSegment> segment;
+  EXPECT_FALSE(ShmSegment::Open(SegmentName("missing"), &segment).ok());
+}
+
+TEST(ShmSegmentTest, CrossProcess) {
+  const string name = SegmentName("cross_process");
+  std::unique_ptr<ShmSegment> producer;
+  TF_ASSERT_OK(ShmSegment::Create(name, kCapacity, &producer));
+
+  std::vector<Region> regions;
+  for (int i = 0; i < 8; ++i) {
+    regions.push_back(AllocateFilled(producer.get(), 1000 + i, 'a' + i));
+  }
+
+  // A separate process reads every slot back and releases it.
+  pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    std::unique_ptr<ShmSegment> consumer;
+    if (!ShmSegment::Open(name, &consumer).ok()) _exit(1);
+    // Release in reverse order; the producer reclaims them in order anyway.
+    for (int i = regions.size() - 1; i >= 0; --i) {
+      const Region& r = regions[i];
+      const void* data;
+      if (!consumer->Acquire(r.offset, r.sequence, r.size, &data).ok()) {
+        _exit(2);
+      }
+      const char* bytes = static_cast<const char*>(data);
+      for (uint64 j = 0; j < r.size; ++j) {
+        if (bytes[j] != 'a' + i) _exit(3);
+      }
+      consumer->Release(r.offset, r.sequence);
+    }
+    _exit(0);
+  }
+  int status;
+  ASSERT_EQ(child, waitpid(child, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+
+  // Every slot was released, so the whole ring is free again.
+  AllocateFilled(producer.get(), kCapacity / 2, 'z');
+}
+
+TEST(ShmSegmentTest, FullUntilReleased) {
+  const string name = SegmentName("full");
+  std::unique_ptr<ShmSegment> producer;
+  TF_ASSERT_OK(ShmSegment::Create(name, kCapacity, &producer));
+  std::unique_ptr<ShmSegment> consumer;
+  TF_ASSERT_OK(ShmSegment::Open(name, &consumer));
+
+  std::vector<Region> regions;
+  uint64 offset;
+  uint64 sequence;
+  void* data;
+  while (producer->Allocate(4096, &offset, &sequence, &data)) {
+    regions.push_back({offset, sequence, 4096});
+  }
+  ASSERT_GT(regions.size(), 1);
+
+  // Releasing a later slot does not free space while the oldest is in use.
+  const void* content;
+  const Region& last = regions.back();
+  TF_ASSERT_OK(consumer->Acquire(last.offset, last.sequence, last.size,
+                                 &content));
+  consumer->Release(last.offset, last.sequence);
+  EXPECT_FALSE(producer->Allocate(4096, &offset, &sequence, &data));
+
+  const Region& first = regions.front();
+  TF_ASSERT_OK(consumer->Acquire(first.offset, first.sequence, first.size,
+                                 &content));
+  consumer->Release(first.offset, first.sequence);
+  EXPECT_TRUE(producer->Allocate(4096, &offset, &sequence, &data));
+}
+
+TEST(ShmSegmentTest, StaleRegion) {
+  const string name = SegmentName("stale");
+  std::unique_ptr<ShmSegment> producer;
+  TF_ASSERT_OK(ShmSegment::Create(name, kCapacity, &producer));
+  std::unique_ptr<ShmSegment> consumer;
+  TF_ASSERT_OK(ShmSegment::Open(name, &consumer));
+
+  Region r = AllocateFilled(producer.get(), 100, 'x');
+  const void* data;
+  EXPECT_FALSE(
+      consumer->Acquire(r.offset, r.sequence + 1, r.size, &data).ok());
+  EXPECT_FALSE(consumer->Acquire(kCapacity, r.sequence, 1, &data).ok());
+  TF_EXPECT_OK(consumer->Acquire(r.offset, r.sequence, r.size, &data));
+  // A slot can only be claimed once.
+  EXPECT_FALSE(consumer->Acquire(r.offset, r.sequence, r.size, &data).ok());
+  consumer->Release(r.offset, r.sequence);
+  EXPECT_FALSE(consumer->Acquire(r.offset, r.sequence, r.size, &data).ok());
+
+  // A claim with the wrong size fails and gives the slot up.
+  Region s = AllocateFilled(producer.get(), 100, 'y');
+  EXPECT_FALSE(consumer->Acquire(s.offset, s.sequence, 200, &data).ok());
+  EXPECT_FALSE(consumer->Acquire(s.offset, s.sequence, s.size, &data).ok());
+}
+
+TEST(ShmSegmentTest, Revoke) {
+  const string name = SegmentName("revoke");
+  std::unique_ptr<ShmSegment> producer;
+  TF_ASSERT_OK(ShmSegment::Create(name, kCapacity, &producer));
+  std::unique_ptr<ShmSegment> consumer;
+  TF_ASSERT_OK(ShmSegment::Open(name, &consumer));
+
+  // An unclaimed slot is revoked, and can no longer be claimed.
+  Region unclaimed = AllocateFilled(producer.get(), 100, 'a');
+  EXPECT_TRUE(producer->Revoke(unclaimed.offset, unclaimed.sequence));
+  const void* data;
+  EXPECT_FALSE(consumer
+                   ->Acquire(unclaimed.offset, unclaimed.sequence,
+                             unclaimed.size, &data)
+                   .ok());
+
+  // A claimed slot is left to its consumer.
+  Region claimed = AllocateFilled(producer.get(), 100, 'b');
+  TF_ASSERT_OK(
+      consumer->Acquire(claimed.offset, claimed.sequence, claimed.size, &data));
+  EXPECT_FALSE(producer->Revoke(claimed.offset, claimed.sequence));
+  consumer->Release(claimed.offset, claimed.sequence);
+
+  // Revoking a slot that was already reclaimed, and whose space was reused,
+  // does not touch the new slot.
+  Region reused = AllocateFilled(producer.get(), 100, 'c');
+  EXPECT_EQ(unclaimed.offset, reused.offset);
+  EXPECT_FALSE(producer->Revoke(unclaimed.offset, unclaimed.sequence));
+  TF_EXPECT_OK(
+      consumer->Acquire(reused.offset, reused.sequence, reused.size, &data));
+}
+
+}  // namespace
+}  // namespace tensorflow
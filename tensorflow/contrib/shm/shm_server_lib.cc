@@ -0,0 +1,109 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/shm/shm_server_lib.h"
+
+#include "grpc/support/alloc.h"
+#include "tensorflow/contrib/shm/shm_rendezvous_mgr.h"
+#include "tensorflow/contrib/shm/shm_worker.h"
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Default capacity of the segment each task sends through.
+const int64 kDefaultSegmentBytes = 64LL << 20;
+
+}  // namespace
+
+ShmServer::ShmServer(const ServerDef& server_def, Env* env)
+    : GrpcServer(server_def, env), server_def_(server_def) {}
+
+ShmServer::~ShmServer() {}
+
+Status ShmServer::Init() {
+  int64 segment_bytes;
+  TF_RETURN_IF_ERROR(ReadInt64FromEnvVar(
+      "TF_SHM_SEGMENT_BYTES", kDefaultSegmentBytes, &segment_bytes));
+  shm_transport_.reset(new ShmTransport(server_def_, segment_bytes));
+  TensorCompressionPolicy compression_policy;
+  TF_RETURN_IF_ERROR(TensorCompressionPolicy::FromOptions(
+      server_def_.default_session_config().rpc_options(),
+      &compression_policy));
+
+  RendezvousMgrCreationFunction rendezvous_mgr_func =
+      [this, compression_policy](const WorkerEnv* env) {
+        return new ShmRendezvousMgr(env, shm_transport_.get(),
+                                    compression_policy);
+      };
+  WorkerCreationFunction worker_func = [this](WorkerEnv* env) {
+    return std::unique_ptr<ShmWorker>(
+        new ShmWorker(env, shm_transport_.get()));
+  };
+  TF_RETURN_IF_ERROR(
+      GrpcServer::Init(nullptr, rendezvous_mgr_func, nullptr, worker_func));
+
+  // Without a segment every tensor is sent over gRPC, so this is not fatal.
+  Status s = shm_transport_->Init();
+  if (!s.ok()) {
+    LOG(WARNING) << "Falling back to gRPC for all tensors: " << s;
+  }
+  return Status::OK();
+}
+
+/* static */
+Status ShmServer::Create(const ServerDef& server_def, Env* env,
+                         std::unique_ptr<ServerInterface>* out_server) {
+  std::unique_ptr<ShmServer> ret(
+      new ShmServer(server_def, env == nullptr ? Env::Default() : env));
+  TF_RETURN_IF_ERROR(ret->Init());
+  *out_server = std::move(ret);
+  return Status::OK();
+}
+
+namespace {
+
+class ShmServerFactory : public ServerFactory {
+ public:
+  bool AcceptsOptions(const ServerDef& server_def) override {
+    return server_def.protocol() == "grpc+shm";
+  }
+
+  Status NewServer(const ServerDef& server_def,
+                   std::unique_ptr<ServerInterface>* out_server) override {
+    return ShmServer::Create(server_def, Env::Default(), out_server);
+  }
+};
+
+// Registers a `ServerFactory` for `ShmServer` instances.
+class ShmServerRegistrar {
+ public:
+  ShmServerRegistrar() {
+    gpr_allocation_functions alloc_fns;
+    memset(&alloc_fns, 0, sizeof(alloc_fns));
+    alloc_fns.malloc_fn = port::Malloc;
+    alloc_fns.realloc_fn = port::Realloc;
+    alloc_fns.free_fn = port::Free;
+    gpr_set_allocation_functions(alloc_fns);
+    ServerFactory::Register("SHM_SERVER", new ShmServerFactory());
+  }
+};
+static ShmServerRegistrar registrar;
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,120 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/distributed_runtime/rpc/grpc_testlib.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+const char kServerBinary[] = "contrib/shm/shm_testlib_server";
+
+// Starts two co-located tasks that use the grpc+shm protocol.
+void MakeShmTestCluster(std::unique_ptr<test::TestCluster>* cluster) {
+  SessionOptions options;
+  (*options.config.mutable_device_count())["CPU"] = 1;
+  (*options.config.mutable_device_count())["GPU"] = 0;
+  TF_ASSERT_OK(test::TestCluster::MakeTestCluster(kServerBinary, "grpc+shm",
+                                                  options, 2, cluster));
+}
+
+// Builds y = -(-x), where x and y are on the first task and -x is on the
+// second one, so that tensors are sent both ways.
+void MakeRoundTripGraph(const test::TestCluster& cluster, const Tensor& x,
+                        GraphDef* graph_def, string* fetch) {
+  Graph graph(OpRegistry::Global());
+  const string& dev_a = cluster.devices()[0].name();
+  const string& dev_b = cluster.devices()[1].name();
+  Node* a = test::graph::Constant(&graph, x);
+  a->set_assigned_device_name(dev_a);
+  Node* b = test::graph::Unary(&graph, "Neg", a);
+  b->set_assigned_device_name(dev_b);
+  Node* c = test::graph::Unary(&graph, "Neg", b);
+  c->set_assigned_device_name(dev_a);
+  *fetch = strings::StrCat(c->name(), ":0");
+  test::graph::ToGraphDef(&graph, graph_def);
+}
+
+void RunRoundTrip(const test::TestCluster& cluster, int num_steps) {
+  Tensor x(DT_FLOAT, TensorShape({64, 16}));
+  test::FillIota<float>(&x, 1.0f);
+  GraphDef graph_def;
+  string fetch;
+  MakeRoundTripGraph(cluster, x, &graph_def, &fetch);
+
+  SessionOptions options;
+  options.target = strings::StrCat("grpc://", cluster.targets()[0]);
+  options.config.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_opt_level(OptimizerOptions::L0);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(graph_def));
+  for (int step = 0; step < num_steps; ++step) {
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({}, {fetch}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    test::ExpectTensorEqual<float>(x, outputs[0]);
+  }
+  TF_ASSERT_OK(session->Close());
+}
+
+TEST(ShmServerTest, SendsTensorsBetweenColocatedTasks) {
+  std::unique_ptr<test::TestCluster> cluster;
+  MakeShmTestCluster(&cluster);
+  RunRoundTrip(*cluster, 10);
+}
+
+TEST(ShmServerTest, FallsBackToGrpcWhenPeerSegmentCannotBeMapped) {
+  std::unique_ptr<test::TestCluster> cluster;
+  MakeShmTestCluster(&cluster);
+
+  // Unlink the segments of the tasks, as if they ran in different IPC
+  // namespaces: each task can still write to its own segment, but its peer
+  // cannot map it.
+  Env* env = Env::Default();
+  const string shm_dir = "/dev/shm";
+  std::vector<string> names;
+  TF_ASSERT_OK(env->GetChildren(shm_dir, &names));
+  int num_unlinked = 0;
+  for (const string& name : names) {
+    if (str_util::StartsWith(name, "tensorflow_shm_localhost_")) {
+      TF_ASSERT_OK(env->DeleteFile(strings::StrCat(shm_dir, "/", name)));
+      ++num_unlinked;
+    }
+  }
+  ASSERT_EQ(2, num_unlinked);
+
+  // The first tensor from each peer is resent over gRPC, the next ones are
+  // sent over gRPC directly.
+  RunRoundTrip(*cluster, 3);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,228 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/shm/shm_transport.h"
+
+#include <unistd.h>
+
+#include <cstring>
+
+#include "tensorflow/contrib/shm/shm.pb.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Returns the host part of a "host:port" address.
+string HostOf(const string& address) {
+  const size_t colon = address.rfind(':');
+  string host = (colon == string::npos) ? address : address.substr(0, colon);
+  // All loopback addresses name this host.
+  if (host == "127.0.0.1" || host == "[::1]") host = "localhost";
+  return host;
+}
+
+}  // namespace
+
+ShmTransport::ShmTransport(const ServerDef& server_def, size_t segment_bytes)
+    : segment_bytes_(segment_bytes) {
+  segment_name_ =
+      strings::StrCat("/tensorflow_shm_", server_def.job_name(), "_",
+                      server_def.task_index(), "_", getpid());
+  string host;
+  for (const auto& job : server_def.cluster().job()) {
+    if (job.name() == server_def.job_name()) {
+      auto iter = job.tasks().find(server_def.task_index());
+      if (iter != job.tasks().end()) {
+        host = HostOf(iter->second);
+      }
+    }
+  }
+  if (host.empty()) return;
+  for (const auto& job : server_def.cluster().job()) {
+    for (const auto& task : job.tasks()) {
+      if (job.name() == server_def.job_name() &&
+          task.first == server_def.task_index()) {
+        continue;
+      }
+      if (HostOf(task.second) == host) {
+        local_peers_.insert(strings::StrCat("/job:", job.name(),
+                                            "/replica:0/task:", task.first));
+      }
+    }
+  }
+}
+
+Status ShmTransport::Init() {
+  Status s = ShmSegment::Create(segment_name_, segment_bytes_, &segment_);
+  if (s.ok()) {
+    VLOG(1) << "Created shared memory segment " << segment_name_ << " for "
+            << local_peers_.size() << " co-located peers";
+  }
+  return s;
+}
+
+bool ShmTransport::IsLocalPeer(const string& worker_name) const {
+  mutex_lock l(mu_);
+  return local_peers_.find(worker_name) != local_peers_.end();
+}
+
+void ShmTransport::RemoveLocalPeer(const string& worker_name) {
+  mutex_lock l(mu_);
+  if (local_peers_.erase(worker_name) > 0) {
+    LOG(WARNING) << "Falling back to gRPC for all tensors from "
+                 << worker_name;
+  }
+}
+
+bool ShmTransport::TransportOptionsFromTensor(
+    int64 step_id, const Tensor& tensor,
+    ::google::protobuf::Any* mutable_transport_options) {
+  if (!segment_ || !DMAHelper::CanUseDMA(&tensor)) return false;
+  const size_t size = tensor.TotalBytes();
+  uint64 offset;
+  uint64 sequence;
+  void* data;
+  if (!segment_->Allocate(size, &offset, &sequence, &data)) {
+    VLOG(2) << "No room for " << size << " bytes in " << segment_name_;
+    return false;
+  }
+  std::memcpy(data, DMAHelper::base(&tensor), size);
+  {
+    mutex_lock l(mu_);
+    step_slots_[step_id].emplace_back(offset, sequence);
+  }
+  ShmTensorRegion region;
+  region.set_segment_name(segment_name_);
+  region.set_offset(offset);
+  region.set_size(size);
+  region.set_sequence(sequence);
+  mutable_transport_options->PackFrom(region);
+  return true;
+}
+
+Status ShmTransport::TensorFromTransportOptions(
+    const ::google::protobuf::Any& transport_options, Tensor* tensor) {
+  ShmTensorRegion region;
+  if (!transport_options.UnpackTo(&region)) {
+    return errors::Internal("Transport options are not a ShmTensorRegion");
+  }
+  if (region.size() != tensor->TotalBytes()) {
+    return errors::Internal("Shared memory region of ", region.size(),
+                            " bytes for a tensor of ", tensor->TotalBytes(),
+                            " bytes");
+  }
+  ShmSegment* segment;
+  TF_RETURN_IF_ERROR(GetPeerSegment(region.segment_name(), &segment));
+  const void* data;
+  TF_RETURN_IF_ERROR(segment->Acquire(region.offset(), region.sequence(),
+                                      region.size(), &data));
+  std::memcpy(DMAHelper::base(tensor), data, region.size());
+  segment->Release(region.offset(), region.sequence());
+  return Status::OK();
+}
+
+/* static */
+void ShmTransport::ResendRequestFromTransportOptions(
+    const ::google::protobuf::Any& transport_options, const Tensor& tensor,
+    ::google::protobuf::Any* request_transport_options) {
+  ShmResendRequest request;
+  transport_options.UnpackTo(request.mutable_region());
+  request.set_dtype(tensor.dtype());
+  tensor.shape().AsProto(request.mutable_tensor_shape());
+  request_transport_options->PackFrom(request);
+}
+
+/* static */
+bool ShmTransport::IsResendRequest(
+    const ::google::protobuf::Any& request_transport_options) {
+  return request_transport_options.Is<ShmResendRequest>();
+}
+
+Status ShmTransport::TensorFromResendRequest(
+    const ::google::protobuf::Any& request_transport_options,
+    Tensor* tensor) {
+  ShmResendRequest request;
+  if (!request_transport_options.UnpackTo(&request)) {
+    return errors::Internal("Transport options are not a ShmResendRequest");
+  }
+  const ShmTensorRegion& region = request.region();
+  if (!segment_ || region.segment_name() != segment_name_) {
+    return errors::Internal("Shared memory segment ", region.segment_name(),
+                            " does not belong to this task");
+  }
+  if (!TensorShape::IsValid(request.tensor_shape())) {
+    return errors::InvalidArgument("Invalid shape in a ShmResendRequest");
+  }
+  Tensor copy(cpu_allocator(), request.dtype(),
+              TensorShape(request.tensor_shape()));
+  if (region.size() != copy.TotalBytes()) {
+    return errors::Internal("Shared memory region of ", region.size(),
+                            " bytes for a tensor of ", copy.TotalBytes(),
+                            " bytes");
+  }
+  const void* data;
+  TF_RETURN_IF_ERROR(segment_->Acquire(region.offset(), region.sequence(),
+                                       region.size(), &data));
+  std::memcpy(DMAHelper::base(&copy), data, region.size());
+  segment_->Release(region.offset(), region.sequence());
+  *tensor = std::move(copy);
+  return Status::OK();
+}
+
+void ShmTransport::CleanupStep(int64 step_id) {
+  std::vector<SlotId> slots;
+  {
+    mutex_lock l(mu_);
+    auto iter = step_slots_.find(step_id);
+    if (iter == step_slots_.end()) return;
+    slots.swap(iter->second);
+    step_slots_.erase(iter);
+  }
+  for (const SlotId& slot : slots) {
+    if (segment_->Revoke(slot.first, slot.second)) {
+      VLOG(2) << "Revoked a slot of step " << step_id << " that was never "
+              << "received";
+    }
+  }
+}
+
+void ShmTransport::CleanupAllSteps() {
+  std::vector<int64> step_ids;
+  {
+    mutex_lock l(mu_);
+    for (const auto& step : step_slots_) step_ids.push_back(step.first);
+  }
+  for (int64 step_id : step_ids) CleanupStep(step_id);
+}
+
+Status ShmTransport::GetPeerSegment(const string& name, ShmSegment** segment) {
+  mutex_lock l(mu_);
+  auto iter = peer_segments_.find(name);
+  if (iter == peer_segments_.end()) {
+    std::unique_ptr<ShmSegment> peer_segment;
+    TF_RETURN_IF_ERROR(ShmSegment::Open(name, &peer_segment));
+    iter = peer_segments_.emplace(name, std::move(peer_segment)).first;
+  }
+  *segment = iter->second.get();
+  return Status::OK();
+}
+
+}  // namespace tensorflow
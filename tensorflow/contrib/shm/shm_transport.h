@@ -0,0 +1,130 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CONTRIB_SHM_SHM_TRANSPORT_H_
+#define TENSORFLOW_CONTRIB_SHM_SHM_TRANSPORT_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/any.pb.h"
+#include "tensorflow/contrib/shm/shm_segment.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/protobuf/tensorflow_server.pb.h"
+
+namespace tensorflow {
+
+// Moves the content of host tensors between tasks on the same host through
+// POSIX shared memory.
+//
+// Each task owns one ShmSegment into which it copies the tensors it sends.
+// The location of a tensor is passed to the receiving task in the
+// transport_options of the RecvTensorResponse, which still travels over
+// gRPC, and the receiver copies the content out and releases the slot.
+// Slots that are never received, e.g. because the RecvTensor call was
+// aborted, are revoked by the sender when the step is cleaned up.
+//
+// A receiver that cannot map the segment of a peer, e.g. because it runs
+// in another IPC namespace or as another user, asks the sender to resend
+// the content of the slot over gRPC and stops treating it as co-located.
+class ShmTransport {
+ public:
+  // "server_def" describes this task and the cluster; tasks whose address
+  // names the same host as this task's are treated as co-located.
+  // "segment_bytes" is the capacity of the segment of this task.
+  ShmTransport(const ServerDef& server_def, size_t segment_bytes);
+
+  // Creates the segment of this task.
+  Status Init();
+
+  // Returns true if the worker called "worker_name", e.g.
+  // "/job:worker/replica:0/task:1", runs on the same host as this task.
+  bool IsLocalPeer(const string& worker_name) const;
+
+  // Stops passing tensors from the worker called "worker_name" through
+  // shared memory.
+  void RemoveLocalPeer(const string& worker_name);
+
+  // Copies the content of "tensor", sent in step "step_id", into the
+  // segment of this task and describes its location in
+  // *transport_options.  Returns false if the segment has no room, in
+  // which case the tensor must be sent some other way.
+  bool TransportOptionsFromTensor(
+      int64 step_id, const Tensor& tensor,
+      ::google::protobuf::Any* mutable_transport_options);
+
+  // Copies the content described by "transport_options" into "tensor",
+  // which must already be allocated on the host with the right size, and
+  // releases it in the segment of the sending task.
+  Status TensorFromTransportOptions(
+      const ::google::protobuf::Any& transport_options, Tensor* tensor);
+
+  // Fills *request_transport_options, to be sent in a RecvTensorRequest,
+  // with a request to resend over gRPC the content that
+  // "transport_options" placed in shared memory for "tensor".
+  static void ResendRequestFromTransportOptions(
+      const ::google::protobuf::Any& transport_options, const Tensor& tensor,
+      ::google::protobuf::Any* request_transport_options);
+
+  // Returns true if "request_transport_options", received in a
+  // RecvTensorRequest, asks to resend content over gRPC.
+  static bool IsResendRequest(
+      const ::google::protobuf::Any& request_transport_options);
+
+  // Sets *tensor to a new host tensor holding the content that the resend
+  // request "request_transport_options" names in the segment of this task,
+  // and releases it.
+  Status TensorFromResendRequest(
+      const ::google::protobuf::Any& request_transport_options,
+      Tensor* tensor);
+
+  // Revokes the slots of the tensors sent in step "step_id" that have not
+  // been received.
+  void CleanupStep(int64 step_id);
+
+  // Revokes the slots of all tensors that have not been received.
+  void CleanupAllSteps();
+
+ private:
+  // (offset, sequence) of a slot of the segment of this task.
+  typedef std::pair<uint64, uint64> SlotId;
+
+  // Sets *segment to the segment called "name" of a peer, mapping it on
+  // first use.
+  Status GetPeerSegment(const string& name, ShmSegment** segment);
+
+  const size_t segment_bytes_;
+  string segment_name_;
+  std::unique_ptr<ShmSegment> segment_;
+
+  mutable mutex mu_;
+  std::unordered_set<string> local_peers_ GUARDED_BY(mu_);
+  std::unordered_map<string, std::unique_ptr<ShmSegment>> peer_segments_
+      GUARDED_BY(mu_);
+  std::unordered_map<int64, std::vector<SlotId>> step_slots_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ShmTransport);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CONTRIB_SHM_SHM_TRANSPORT_H_
@@ -0,0 +1,117 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/shm/shm_transport.h"
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+const size_t kSegmentBytes = 1 << 20;
+
+ServerDef MakeServerDef(int task_index) {
+  ServerDef server_def;
+  server_def.set_job_name("worker");
+  server_def.set_task_index(task_index);
+  auto* job = server_def.mutable_cluster()->add_job();
+  job->set_name("worker");
+  (*job->mutable_tasks())[0] = "localhost:2222";
+  (*job->mutable_tasks())[1] = "127.0.0.1:2223";
+  (*job->mutable_tasks())[2] = "otherhost:2222";
+  return server_def;
+}
+
+TEST(ShmTransportTest, LocalPeers) {
+  ShmTransport transport(MakeServerDef(0), kSegmentBytes);
+  EXPECT_FALSE(transport.IsLocalPeer("/job:worker/replica:0/task:0"));
+  EXPECT_TRUE(transport.IsLocalPeer("/job:worker/replica:0/task:1"));
+  EXPECT_FALSE(transport.IsLocalPeer("/job:worker/replica:0/task:2"));
+}
+
+TEST(ShmTransportTest, SendAndReceive) {
+  ShmTransport sender(MakeServerDef(0), kSegmentBytes);
+  TF_ASSERT_OK(sender.Init());
+  ShmTransport receiver(MakeServerDef(1), kSegmentBytes);
+  TF_ASSERT_OK(receiver.Init());
+
+  Tensor value = test::AsTensor<float>({1, 2, 3, 4, 5, 6}, {2, 3});
+  ::google::protobuf::Any transport_options;
+  ASSERT_TRUE(
+      sender.TransportOptionsFromTensor(1, value, &transport_options));
+
+  Tensor received(DT_FLOAT, TensorShape({2, 3}));
+  TF_ASSERT_OK(
+      receiver.TensorFromTransportOptions(transport_options, &received));
+  test::ExpectTensorEqual<float>(value, received);
+
+  // The region was released, so receiving it again fails.
+  EXPECT_FALSE(
+      receiver.TensorFromTransportOptions(transport_options, &received).ok());
+}
+
+TEST(ShmTransportTest, FallsBackWhenFull) {
+  ShmTransport sender(MakeServerDef(0), kSegmentBytes);
+  TF_ASSERT_OK(sender.Init());
+
+  Tensor too_big(DT_FLOAT, TensorShape({kSegmentBytes / sizeof(float)}));
+  ::google::protobuf::Any transport_options;
+  EXPECT_FALSE(
+      sender.TransportOptionsFromTensor(1, too_big, &transport_options));
+
+  Tensor value = test::AsTensor<float>({1, 2});
+  EXPECT_TRUE(sender.TransportOptionsFromTensor(1, value, &transport_options));
+}
+
+TEST(ShmTransportTest, CleanupRevokesAbortedTransfers) {
+  ShmTransport sender(MakeServerDef(0), kSegmentBytes);
+  TF_ASSERT_OK(sender.Init());
+  ShmTransport receiver(MakeServerDef(1), kSegmentBytes);
+  TF_ASSERT_OK(receiver.Init());
+
+  // Three of these fill the segment.
+  Tensor value(DT_FLOAT, TensorShape({kSegmentBytes / 16}));
+  value.flat<float>().setConstant(1);
+  Tensor received(DT_FLOAT, value.shape());
+
+  // The RecvTensor call of this one is aborted after the sender filled
+  // the slot, so the receiver never releases it.
+  ::google::protobuf::Any aborted;
+  ASSERT_TRUE(sender.TransportOptionsFromTensor(1, value, &aborted));
+
+  for (int i = 0; i < 2; ++i) {
+    ::google::protobuf::Any transport_options;
+    ASSERT_TRUE(
+        sender.TransportOptionsFromTensor(2, value, &transport_options));
+    TF_ASSERT_OK(
+        receiver.TensorFromTransportOptions(transport_options, &received));
+  }
+  // The slot of step 1 holds up the reuse of the slots after it.
+  ::google::protobuf::Any transport_options;
+  EXPECT_FALSE(sender.TransportOptionsFromTensor(2, value, &transport_options));
+
+  sender.CleanupStep(1);
+  ASSERT_TRUE(sender.TransportOptionsFromTensor(3, value, &transport_options));
+  TF_ASSERT_OK(
+      receiver.TensorFromTransportOptions(transport_options, &received));
+  test::ExpectTensorEqual<float>(value, received);
+  // A late receiver of the revoked slot gets an error, not other data.
+  EXPECT_FALSE(receiver.TensorFromTransportOptions(aborted, &received).ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
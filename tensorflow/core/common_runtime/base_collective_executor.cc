@@ -132,6 +132,13 @@ class CollectiveAdapterImpl : public CollectiveAdapter {
                           : output_.Slice(0, 0);
   }
 
+  Tensor ChunkRangeAlias(int i, int n) override {
+    DCHECK_LE(i + n, num_chunks_);
+    int64 start = std::min(total_elts_, chunk_elts_ * i);
+    int64 end = std::min(total_elts_, chunk_elts_ * (i + n));
+    return (end > start) ? output_.Slice(start, end) : output_.Slice(0, 0);
+  }
+
   Tensor TempChunk(int i) const override {
     AllocationAttributes empty;
     return Tensor(allocator_, dt_, {ChunkElts(i)}, empty);
@@ -226,9 +233,8 @@ void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
   };
 
   Tensor* output = ctx->mutable_output(0);
-  const Tensor* input = (col_params.instance.type == REDUCTION_COLLECTIVE ||
-                         (col_params.instance.type == BROADCAST_COLLECTIVE &&
-                          col_params.is_source))
+  const Tensor* input = (col_params.instance.type != BROADCAST_COLLECTIVE ||
+                         col_params.is_source)
                             ? &ctx->input(0)
                             : nullptr;
   CollectiveImplementationInterface* col_impl = nullptr;
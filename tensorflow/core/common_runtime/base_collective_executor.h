@@ -44,6 +44,10 @@ class CollectiveAdapter {
   // Returns tensor for chunk i which aliases the backing buffer.
   virtual Tensor ChunkAlias(int i) = 0;
 
+  // Returns tensor for the n consecutive chunks starting at chunk i,
+  // which aliases the backing buffer.
+  virtual Tensor ChunkRangeAlias(int i, int n) = 0;
+
   // Returns tensor allocated on the same device but with its own
   // separate backing buffer.  Will have same type and size as
   // chunk i.
@@ -380,6 +380,40 @@ void BFCAllocator::DeallocateRaw(void* ptr) {
   retry_helper_.NotifyDealloc();
 }
 
+int BFCAllocator::AllocateRawBatch(size_t unused_alignment, size_t num_bytes,
+                                   int n, void** ptrs) {
+  if (num_bytes == 0) {
+    LOG(ERROR) << "tried to allocate 0 bytes";
+    return 0;
+  }
+  size_t rounded_bytes = RoundedBytes(num_bytes);
+  BinNum bin_num = BinNumForSize(rounded_bytes);
+
+  mutex_lock l(lock_);
+  int i = 0;
+  for (; i < n; ++i) {
+    void* ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes);
+    if (ptr == nullptr && Extend(unused_alignment, rounded_bytes)) {
+      ptr = FindChunkPtr(bin_num, rounded_bytes, num_bytes);
+    }
+    if (ptr == nullptr) break;
+    ptrs[i] = ptr;
+  }
+  return i;
+}
+
+void BFCAllocator::DeallocateRawBatch(void* const* ptrs, int n) {
+  {
+    mutex_lock l(lock_);
+    for (int i = 0; i < n; ++i) {
+      BFCAllocator::ChunkHandle h = region_manager_.get_handle(ptrs[i]);
+      CHECK(h != kInvalidChunkHandle);
+      FreeAndMaybeCoalesce(h);
+    }
+  }
+  retry_helper_.NotifyDealloc();
+}
+
 void BFCAllocator::DeallocateRawInternal(void* ptr) {
 //  cout << "DeallocateRawInternal \n";
   if (ptr == nullptr) {
@@ -55,6 +55,15 @@ class BFCAllocator : public VisitableAllocator {
                     const AllocationAttributes& allocation_attr) override;
   void DeallocateRaw(void* ptr) override;
 
+  // Allocates up to 'n' chunks of at least 'num_bytes' bytes each while
+  // holding the allocator lock once, and stores them in 'ptrs[0, n)'. Returns
+  // the number of chunks allocated, which is less than 'n' if the allocator
+  // ran out of memory. Does not retry on failure.
+  int AllocateRawBatch(size_t alignment, size_t num_bytes, int n, void** ptrs);
+
+  // Deallocates 'ptrs[0, n)' while holding the allocator lock once.
+  void DeallocateRawBatch(void* const* ptrs, int n);
+
   void AddAllocVisitor(Visitor visitor) override;
 
   // Does nothing, because memory is never freed.
@@ -30,6 +30,29 @@ limitations under the License.
 #include "tensorflow/core/util/device_name_utils.h"
 
 namespace tensorflow {
+namespace {
+// All-reduces of at most this many bytes are dominated by per-step latency
+// rather than by bandwidth.
+const int64 kSmallReductionBytes = 1 << 20;
+
+// Returns the name of the all-reduce implementation best suited to the size
+// of the reduced tensor and the topology of the group.  RingReduce has the
+// best bandwidth but takes 2 * (group_size - 1) steps, which hurts small
+// tensors in large groups.
+string ReductionImplementationName(const CollectiveParams& cp) {
+  const int64 num_bytes = cp.instance.shape.num_elements() *
+                          DataTypeSize(cp.instance.data_type);
+  if (num_bytes > kSmallReductionBytes || cp.group.group_size <= 2) {
+    return "RingReduce";
+  }
+  if (cp.group.num_tasks > 1 && cp.group.group_size > cp.group.num_tasks) {
+    // Reduce within each task before communicating across tasks.
+    return "HierarchicalReduce";
+  }
+  return "HalvingDoublingReduce";
+}
+
+}  // namespace
 
 void CollectiveParamResolverLocal::InstanceRec::WaitForOutMu(mutex_lock& lock) {
   while (!out_mu_available) out_cv.wait(lock);
@@ -610,12 +633,22 @@ void CollectiveParamResolverLocal::CompleteInstanceFromInitializedIRec(
   // Populate the fields common across task, also default_rank.
   SetDefaultRank(device, cp);
   CompleteTaskIsLocal(task_name_, cp);
-  // TODO(b/113171733): we need a better way to pick the collective
-  // implementation.  The ideal way would depend upon the topology and link
-  // strength before picking a particular implementation.
-  cp->instance.impl_details.collective_name =
-      (cp->instance.type == BROADCAST_COLLECTIVE) ? "HierarchicalTreeBroadcast"
-                                                  : "RingReduce";
+  // TODO(b/113171733): the choice of reduction implementation should also
+  // depend upon the link strength between devices.
+  switch (cp->instance.type) {
+    case BROADCAST_COLLECTIVE:
+      cp->instance.impl_details.collective_name = "HierarchicalTreeBroadcast";
+      break;
+    case GATHER_COLLECTIVE:
+      cp->instance.impl_details.collective_name = "RingGather";
+      break;
+    case REDUCE_SCATTER_COLLECTIVE:
+      cp->instance.impl_details.collective_name = "RingReduceScatter";
+      break;
+    default:
+      cp->instance.impl_details.collective_name =
+          ReductionImplementationName(*cp);
+  }
   CollectiveImplementationInterface* col_impl;
   Status lookup_status = CollectiveRegistry::LookupParamResolverInstance(
       cp->instance.impl_details.collective_name, &col_impl);
@@ -93,6 +93,9 @@ TEST_F(CollectiveParamResolverLocalTest, CompleteParamsReduction1Task) {
     EXPECT_FALSE(cps[i].is_source);
     EXPECT_EQ(cps[i].default_rank, i);
     EXPECT_TRUE(cps[i].instance.same_num_devices_per_task);
+    // A small tensor on more than two devices uses fewer steps than a ring.
+    EXPECT_EQ("HalvingDoublingReduce",
+              cps[i].instance.impl_details.collective_name);
   }
 }
 
@@ -55,6 +55,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/gtl/stl_util.h"
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
@@ -137,6 +138,30 @@ string GetRendezvousKey(const string& tensor_name,
                          frame_iter.frame_id, ":", frame_iter.iter_id);
 }
 
+// Hashes the signature of a Run() call, respecting the order of `inputs`,
+// `outputs` and `target_nodes`.
+uint64 RunSignatureHash(gtl::ArraySlice<string> inputs,
+                        gtl::ArraySlice<string> outputs,
+                        gtl::ArraySlice<string> target_nodes,
+                        bool is_partial_run,
+                        const string& debug_tensor_watches_summary) {
+  uint64 hash = Hash64(debug_tensor_watches_summary);
+  hash = Hash64Combine(hash, is_partial_run ? 1 : 0);
+  // Mixing in the size of each list keeps e.g. the feed "a" with fetch "b"
+  // apart from the feeds "a" and "b" without fetches.
+  for (gtl::ArraySlice<string> names : {inputs, outputs, target_nodes}) {
+    hash = Hash64Combine(hash, names.size());
+    for (const string& name : names) {
+      hash = Hash64Combine(hash, Hash64(name));
+    }
+  }
+  return hash;
+}
+
+bool SameNames(const std::vector<string>& a, gtl::ArraySlice<string> b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
 }  // namespace
 
 class DirectSessionFactory : public SessionFactory {
@@ -312,6 +337,10 @@ DirectSession::~DirectSession() {
   for (auto& it : executors_) {
     it.second.reset();
   }
+  for (ExecutorsCacheShard& shard : executors_cache_) {
+    mutex_lock l(shard.mu);
+    shard.entries.clear();
+  }
   callables_.clear();
   for (auto d : device_mgr_->ListDevices()) {
     d->op_segment()->RemoveHold(session_handle_);
@@ -1246,6 +1275,8 @@ Status DirectSession::CreateExecutors(
     item->graph = partition_graph.get();
     item->executor = nullptr;
     item->device = device;
+    params.use_step_temp_arena =
+        options_.config.experimental().use_step_temp_arena();
     auto executor_type = options_.config.experimental().executor_type();
     TF_RETURN_IF_ERROR(NewExecutor(
         executor_type, params, std::move(partition_graph), &item->executor));
@@ -1304,16 +1335,32 @@ Status DirectSession::GetOrCreateExecutors(
         run_state_args->debug_options.debug_tensor_watch_opts());
   }
 
-  // Fast lookup path, no sorting.
+  // Fast lookup path, no sorting and no string keys.
+  const bool is_partial_run = run_state_args->is_partial_run;
+  const uint64 signature_hash =
+      RunSignatureHash(inputs, outputs, target_nodes, is_partial_run,
+                       debug_tensor_watches_summary);
+  ExecutorsAndKeys* cached = LookupCachedExecutors(
+      signature_hash, inputs, outputs, target_nodes, is_partial_run,
+      debug_tensor_watches_summary);
+  if (cached != nullptr && handle_name_counter_value < 0) {
+    *executors_and_keys = cached;
+    return Status::OK();
+  }
+
   const string key = strings::StrCat(
       str_util::Join(inputs, ","), "->", str_util::Join(outputs, ","), "/",
-      str_util::Join(target_nodes, ","), "/", run_state_args->is_partial_run,
-      "/", debug_tensor_watches_summary);
+      str_util::Join(target_nodes, ","), "/", is_partial_run, "/",
+      debug_tensor_watches_summary);
   // Set the handle, if it's needed to log memory or for partial run.
   if (handle_name_counter_value >= 0) {
     run_state_args->handle =
         strings::StrCat(key, ";", handle_name_counter_value);
   }
+  if (cached != nullptr) {
+    *executors_and_keys = cached;
+    return Status::OK();
+  }
 
   // See if we already have the executors for this run.
   {
@@ -1321,6 +1368,9 @@ Status DirectSession::GetOrCreateExecutors(
     auto it = executors_.find(key);
     if (it != executors_.end()) {
       *executors_and_keys = it->second.get();
+      InsertCachedExecutors(signature_hash, inputs, outputs, target_nodes,
+                            is_partial_run, debug_tensor_watches_summary,
+                            it->second);
       return Status::OK();
     }
   }
@@ -1356,6 +1406,9 @@ Status DirectSession::GetOrCreateExecutors(
       *executors_and_keys = it->second.get();
       // Insert this under the original key.
       executors_.emplace(key, it->second);
+      InsertCachedExecutors(signature_hash, inputs, outputs, target_nodes,
+                            is_partial_run, debug_tensor_watches_summary,
+                            it->second);
       return Status::OK();
     }
   }
@@ -1394,11 +1447,67 @@ Status DirectSession::GetOrCreateExecutors(
   // Insert the value under the original key, so the fast path lookup will work
   // if the user uses the same order of inputs, outputs, and targets again.
   executors_.emplace(key, insert_result.first->second);
+  InsertCachedExecutors(signature_hash, inputs, outputs, target_nodes,
+                        is_partial_run, debug_tensor_watches_summary,
+                        insert_result.first->second);
   *executors_and_keys = insert_result.first->second.get();
 
   return Status::OK();
 }
 
+DirectSession::ExecutorsAndKeys* DirectSession::LookupCachedExecutors(
+    uint64 hash, gtl::ArraySlice<string> inputs,
+    gtl::ArraySlice<string> outputs, gtl::ArraySlice<string> target_nodes,
+    bool is_partial_run, const string& debug_tensor_watches_summary) {
+  ExecutorsCacheShard& shard =
+      executors_cache_[hash % kNumExecutorsCacheShards];
+  tf_shared_lock l(shard.mu);
+  auto range = shard.entries.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.Matches(inputs, outputs, target_nodes, is_partial_run,
+                           debug_tensor_watches_summary)) {
+      return it->second.executors_and_keys.get();
+    }
+  }
+  return nullptr;
+}
+
+void DirectSession::InsertCachedExecutors(
+    uint64 hash, gtl::ArraySlice<string> inputs,
+    gtl::ArraySlice<string> outputs, gtl::ArraySlice<string> target_nodes,
+    bool is_partial_run, const string& debug_tensor_watches_summary,
+    std::shared_ptr<ExecutorsAndKeys> executors_and_keys) {
+  ExecutorsCacheEntry entry;
+  entry.inputs.assign(inputs.begin(), inputs.end());
+  entry.outputs.assign(outputs.begin(), outputs.end());
+  entry.target_nodes.assign(target_nodes.begin(), target_nodes.end());
+  entry.is_partial_run = is_partial_run;
+  entry.debug_tensor_watches_summary = debug_tensor_watches_summary;
+  entry.executors_and_keys = std::move(executors_and_keys);
+
+  ExecutorsCacheShard& shard =
+      executors_cache_[hash % kNumExecutorsCacheShards];
+  mutex_lock l(shard.mu);
+  auto range = shard.entries.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.Matches(inputs, outputs, target_nodes, is_partial_run,
+                           debug_tensor_watches_summary)) {
+      return;
+    }
+  }
+  shard.entries.emplace(hash, std::move(entry));
+}
+
+bool DirectSession::ExecutorsCacheEntry::Matches(
+    gtl::ArraySlice<string> inputs, gtl::ArraySlice<string> outputs,
+    gtl::ArraySlice<string> target_nodes, bool is_partial_run,
+    const string& debug_tensor_watches_summary) const {
+  return this->is_partial_run == is_partial_run &&
+         SameNames(this->inputs, inputs) && SameNames(this->outputs, outputs) &&
+         SameNames(this->target_nodes, target_nodes) &&
+         this->debug_tensor_watches_summary == debug_tensor_watches_summary;
+}
+
 Status DirectSession::CreateGraphs(
     const BuildGraphOptions& subgraph_options,
     std::unordered_map<string, std::unique_ptr<Graph>>* outputs,
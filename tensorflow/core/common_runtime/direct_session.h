@@ -224,6 +224,22 @@ class DirectSession : public Session {
       gtl::ArraySlice<string> target_nodes,
       ExecutorsAndKeys** executors_and_keys, RunStateArgs* run_state_args);
 
+  // Looks up the executors cached for the signature of a Run() call in
+  // `executors_cache_`, without taking `executor_lock_`. `hash` must be
+  // RunSignatureHash() of the remaining arguments. Returns nullptr on a miss.
+  ExecutorsAndKeys* LookupCachedExecutors(
+      uint64 hash, gtl::ArraySlice<string> inputs,
+      gtl::ArraySlice<string> outputs, gtl::ArraySlice<string> target_nodes,
+      bool is_partial_run, const string& debug_tensor_watches_summary);
+
+  // Adds `executors_and_keys` to `executors_cache_` under the given
+  // signature, unless an entry for it already exists.
+  void InsertCachedExecutors(
+      uint64 hash, gtl::ArraySlice<string> inputs,
+      gtl::ArraySlice<string> outputs, gtl::ArraySlice<string> target_nodes,
+      bool is_partial_run, const string& debug_tensor_watches_summary,
+      std::shared_ptr<ExecutorsAndKeys> executors_and_keys);
+
   // Creates a set of executors to run the subgraph defined by
   // `callable_options`.
   ::tensorflow::Status CreateExecutors(
@@ -341,6 +357,35 @@ class DirectSession : public Session {
   std::unordered_map<string, std::shared_ptr<ExecutorsAndKeys>> executors_
       GUARDED_BY(executor_lock_);
 
+  // Fast-path cache for GetOrCreateExecutors(), keyed by a hash of the
+  // signature of a Run() call in the order given by the caller. The cache
+  // is split into shards that are selected by the hash and locked
+  // independently (in shared mode for lookups), so concurrent Run() calls
+  // neither serialize on `executor_lock_` nor build a string key. Colliding
+  // hashes are disambiguated by comparing the stored signature.
+  struct ExecutorsCacheEntry {
+    std::vector<string> inputs;
+    std::vector<string> outputs;
+    std::vector<string> target_nodes;
+    bool is_partial_run;
+    string debug_tensor_watches_summary;
+    std::shared_ptr<ExecutorsAndKeys> executors_and_keys;
+
+    bool Matches(gtl::ArraySlice<string> inputs,
+                 gtl::ArraySlice<string> outputs,
+                 gtl::ArraySlice<string> target_nodes, bool is_partial_run,
+                 const string& debug_tensor_watches_summary) const;
+  };
+  struct ExecutorsCacheShard {
+    mutex mu;
+    std::unordered_multimap<uint64, ExecutorsCacheEntry> entries
+        GUARDED_BY(mu);
+    // Keeps the mutexes of neighbouring shards on separate cache lines.
+    char padding[64];
+  };
+  static constexpr int kNumExecutorsCacheShards = 16;
+  ExecutorsCacheShard executors_cache_[kNumExecutorsCacheShards];
+
   class RunCallableCallFrame;
   struct Callable {
     std::shared_ptr<ExecutorsAndKeys> executors_and_keys;
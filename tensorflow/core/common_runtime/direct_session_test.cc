@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/direct_session.h"
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <string>
@@ -36,11 +37,13 @@ limitations under the License.
 #include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
@@ -142,6 +145,118 @@ TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork) {
   EXPECT_FLOAT_EQ(5.0, mat(0, 0));
 }
 
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetworkWithStaticPlanExecutor) {
+  Initialize({3, 2, -1, 0});
+  SessionOptions options;
+  (*options.config.mutable_device_count())["CPU"] = 2;
+  options.config.mutable_experimental()->set_executor_type("STATIC_PLAN");
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+  std::vector<std::pair<string, Tensor>> inputs;
+
+  std::vector<string> output_names = {y_ + ":0", y_neg_ + ":0"};
+  std::vector<Tensor> outputs;
+  for (int i = 0; i < 3; ++i) {
+    TF_ASSERT_OK(session->Run(inputs, output_names, {}, &outputs));
+    ASSERT_EQ(2, outputs.size());
+    EXPECT_FLOAT_EQ(5.0, outputs[0].matrix<float>()(0, 0));
+    EXPECT_FLOAT_EQ(-5.0, outputs[1].matrix<float>()(0, 0));
+  }
+}
+
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetworkWithStepTempArena) {
+  Initialize({3, 2, -1, 0});
+  SessionOptions options;
+  (*options.config.mutable_device_count())["CPU"] = 2;
+  options.config.mutable_experimental()->set_use_step_temp_arena(true);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+  std::vector<std::pair<string, Tensor>> inputs;
+
+  std::vector<string> output_names = {y_ + ":0", y_neg_ + ":0"};
+  // The outputs of earlier steps stay valid while later steps reuse the
+  // arena.
+  std::vector<std::vector<Tensor>> outputs(3);
+  for (int i = 0; i < 3; ++i) {
+    TF_ASSERT_OK(session->Run(inputs, output_names, {}, &outputs[i]));
+    ASSERT_EQ(2, outputs[i].size());
+  }
+  for (const auto& step_outputs : outputs) {
+    EXPECT_FLOAT_EQ(5.0, step_outputs[0].matrix<float>()(0, 0));
+    EXPECT_FLOAT_EQ(-5.0, step_outputs[1].matrix<float>()(0, 0));
+  }
+}
+
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetworkWithNumaAffinity) {
+  Initialize({3, 2, -1, 0});
+  SessionOptions options;
+  options.config.mutable_experimental()->set_use_numa_affinity(true);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+
+  // CPU:0 without affinity, then one CPU device per NUMA node.
+  std::vector<DeviceAttributes> devices;
+  TF_ASSERT_OK(session->ListDevices(&devices));
+  std::vector<int> numa_nodes;
+  for (const DeviceAttributes& d : devices) {
+    if (d.device_type() != DEVICE_CPU) continue;
+    if (str_util::EndsWith(d.name(), "/device:CPU:0")) {
+      EXPECT_EQ(port::kNUMANoAffinity, d.locality().numa_node());
+    } else {
+      numa_nodes.push_back(d.locality().numa_node());
+    }
+  }
+  std::sort(numa_nodes.begin(), numa_nodes.end());
+  ASSERT_EQ(port::NUMANumNodes(), numa_nodes.size());
+  for (int i = 0; i < numa_nodes.size(); ++i) {
+    EXPECT_EQ(i, numa_nodes[i]);
+  }
+
+  std::vector<string> output_names = {y_ + ":0", y_neg_ + ":0"};
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run({}, output_names, {}, &outputs));
+  ASSERT_EQ(2, outputs.size());
+  EXPECT_FLOAT_EQ(5.0, outputs[0].matrix<float>()(0, 0));
+  EXPECT_FLOAT_EQ(-5.0, outputs[1].matrix<float>()(0, 0));
+}
+
+TEST_F(DirectSessionMinusAXTest, ConcurrentRunsWithReorderedFetches) {
+  Initialize({3, 2, -1, 0});
+  auto session = CreateSession();
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+
+  // The two signatures only differ in the order of their fetches, so they
+  // share executors but must still return their outputs in order.
+  const std::vector<string> y_first = {y_ + ":0", y_neg_ + ":0"};
+  const std::vector<string> y_neg_first = {y_neg_ + ":0", y_ + ":0"};
+  const int kNumThreads = 8;
+  const int kRunsPerThread = 20;
+  thread::ThreadPool tp(Env::Default(), "clients", kNumThreads);
+  {
+    BlockingCounter done(kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      const std::vector<string>* fetches = t % 2 ? &y_first : &y_neg_first;
+      const float expected = t % 2 ? 5.0 : -5.0;
+      tp.Schedule([&session, &done, fetches, expected]() {
+        for (int i = 0; i < kRunsPerThread; ++i) {
+          std::vector<Tensor> outputs;
+          Status s = session->Run({}, *fetches, {}, &outputs);
+          TF_EXPECT_OK(s);
+          if (!s.ok()) continue;
+          EXPECT_FLOAT_EQ(expected, outputs[0].matrix<float>()(0, 0));
+          EXPECT_FLOAT_EQ(-expected, outputs[1].matrix<float>()(0, 0));
+        }
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+  }
+}
+
 TEST_F(DirectSessionMinusAXTest, RunSimpleNetwork_Callable) {
   Initialize({3, 2, -1, 0});
   auto session = CreateSession();
@@ -2217,6 +2332,65 @@ void BM_FeedFetchCallable(int iters, int num_feeds) {
 BENCHMARK(BM_FeedFetch)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
 BENCHMARK(BM_FeedFetchCallable)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
 
+// Measures how `DirectSession::Run()` scales when `num_threads` clients
+// concurrently issue calls with the same signature, which exercises the
+// executor lookup fast path.
+void BM_ConcurrentRun(int iters, int num_threads) {
+  testing::StopTiming();
+
+  Tensor value(DT_FLOAT, TensorShape());
+  value.flat<float>()(0) = 37.0;
+
+  Graph g(OpRegistry::Global());
+  Node* placeholder;
+  TF_CHECK_OK(NodeBuilder(g.NewName("Placeholder"), "Placeholder")
+                  .Attr("shape", TensorShape())
+                  .Attr("dtype", DT_FLOAT)
+                  .Device("/cpu:0")
+                  .Finalize(&g, &placeholder));
+  Node* identity;
+  TF_CHECK_OK(NodeBuilder(g.NewName("Identity"), "Identity")
+                  .Input(placeholder)
+                  .Attr("T", DT_FLOAT)
+                  .Device("/cpu:0")
+                  .Finalize(&g, &identity));
+  const std::vector<std::pair<string, Tensor>> inputs = {
+      {placeholder->name() + ":0", value}};
+  const std::vector<string> outputs = {identity->name() + ":0"};
+  GraphDef gd;
+  g.ToGraphDef(&gd);
+
+  SessionOptions opts;
+  opts.config.set_inter_op_parallelism_threads(num_threads);
+  std::unique_ptr<Session> session(NewSession(opts));
+  TF_CHECK_OK(session->Create(gd));
+  {
+    // Ignore the first run, which creates the executors.
+    std::vector<Tensor> output_values;
+    TF_CHECK_OK(session->Run(inputs, outputs, {}, &output_values));
+  }
+
+  thread::ThreadPool clients(Env::Default(), "clients", num_threads);
+  testing::StartTiming();
+  {
+    BlockingCounter done(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+      const int runs = iters / num_threads + (t < iters % num_threads ? 1 : 0);
+      clients.Schedule([&session, &inputs, &outputs, &done, runs]() {
+        for (int i = 0; i < runs; ++i) {
+          std::vector<Tensor> output_values;
+          TF_CHECK_OK(session->Run(inputs, outputs, {}, &output_values));
+        }
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+  }
+  testing::StopTiming();
+}
+
+BENCHMARK(BM_ConcurrentRun)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16);
+
 }  // namespace
 
 class DirectSessionCollectiveTest : public ::testing::Test {
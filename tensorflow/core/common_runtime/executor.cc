@@ -25,7 +25,9 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/costmodel_manager.h"
 #include "tensorflow/core/common_runtime/executor_factory.h"
 #include "tensorflow/core/common_runtime/pending_counts.h"
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/common_runtime/work_stealing_queue.h"
 #include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/cancellation.h"
@@ -54,6 +56,7 @@ limitations under the License.
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -61,6 +64,7 @@ limitations under the License.
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace {
@@ -117,6 +121,12 @@ void SetReferencedTensors(NodeExecStatsWrapper* stats,
   stats->SetReferencedTensors(tensors);
 }
 
+void SetSharding(NodeExecStatsWrapper* stats,
+                 const ShardingContext& sharding) {
+  if (!stats) return;
+  stats->SetSharding(sharding);
+}
+
 // Sets the timeline_label field of *stats, using data from *node.
 // Returns true iff the node is a transfer node.
 bool SetTimelineLabel(const Node* node, NodeExecStatsWrapper* stats) {
@@ -281,8 +291,23 @@ class GraphView {
 
 class ExecutorImpl : public Executor {
  public:
-  ExecutorImpl(const LocalExecutorParams& p, std::unique_ptr<const Graph> g)
-      : params_(p), graph_(std::move(g)), gview_() {
+  // How ready nodes that are not run inline are handed to other threads.
+  enum class SchedulingMode {
+    // Every dispatched node becomes a separate closure on Args::runner.
+    kClosurePerNode,
+    // Dispatched nodes are pushed onto per-worker deques. At most one
+    // long-running closure per deque drains its own deque and steals from
+    // the others, so successors tend to stay on the thread (and core) that
+    // produced their inputs.
+    kWorkStealing,
+  };
+
+  ExecutorImpl(const LocalExecutorParams& p, std::unique_ptr<const Graph> g,
+               SchedulingMode scheduling_mode = SchedulingMode::kClosurePerNode)
+      : params_(p),
+        graph_(std::move(g)),
+        gview_(),
+        scheduling_mode_(scheduling_mode) {
     CHECK(p.create_kernel != nullptr);
     CHECK(p.delete_kernel != nullptr);
   }
@@ -297,6 +322,9 @@ class ExecutorImpl : public Executor {
     for (auto fiter : frame_info_) {
       delete fiter.second;
     }
+    for (StepArenaAllocator* arena : free_step_arenas_) {
+      arena->Unref();
+    }
   }
 
   Status Initialize();
@@ -363,6 +391,23 @@ class ExecutorImpl : public Executor {
   std::unique_ptr<const Graph> graph_;
   GraphView gview_;
 
+  const SchedulingMode scheduling_mode_;
+
+  // Number of work-stealing lanes per step. Only used in kWorkStealing mode.
+  int num_work_stealing_lanes_ = 1;
+
+  // Returns an arena for the temporaries of one step, or nullptr if the
+  // executor does not use step arenas. Concurrent steps use separate
+  // arenas. The arena is handed back with ReleaseStepArena() at the end of
+  // the step, and keeps its size for the next step that acquires it.
+  StepArenaAllocator* AcquireStepArena() const;
+  void ReleaseStepArena(StepArenaAllocator* arena) const;
+
+  bool use_step_temp_arena_ = false;
+  mutable mutex step_arenas_mu_;
+  mutable std::vector<StepArenaAllocator*> free_step_arenas_
+      GUARDED_BY(step_arenas_mu_);
+
   // A cached value of params_
   bool device_record_tensor_accesses_ = false;
 
@@ -377,15 +422,6 @@ class ExecutorImpl : public Executor {
   TF_DISALLOW_COPY_AND_ASSIGN(ExecutorImpl);
 };
 
-// Infer memory allocation attributes of a node n's output,
-// based on its use node dst.  Note that dst might not be directly
-// connected to n by a single edge, but might be a downstream
-// consumer of n's output by reference.  *attr is updated with any
-// necessary attributes.
-Status InferAllocAttr(const Node* n, const Node* dst,
-                      const DeviceNameUtils::ParsedName& local_dev_name,
-                      AllocatorAttributes* attr);
-
 GraphView::~GraphView() {
   static_assert(std::is_trivially_destructible<AllocatorAttributes>::value,
                 "Update code if AllocatorAttributes gains a destructor");
@@ -601,6 +637,18 @@ Status ExecutorImpl::Initialize() {
   device_record_tensor_accesses_ =
       params_.device->RequiresRecordingAccessedTensors();
 
+  if (scheduling_mode_ == SchedulingMode::kWorkStealing) {
+    // There is no point in having more concurrent workers than cores: the
+    // extra lanes would only add stealing traffic.
+    num_work_stealing_lanes_ = std::max(1, port::NumSchedulableCPUs());
+  }
+
+  // Only host memory can be handed out of an arena, and only the CPU device
+  // serves allocate_temp() from host memory.
+  use_step_temp_arena_ =
+      params_.use_step_temp_arena &&
+      params_.device->attributes().device_type() == DEVICE_CPU;
+
   for (auto& it : cf_info.unique_frame_names) {
     EnsureFrameInfo(it)->nodes = new std::vector<const Node*>;
   }
@@ -766,6 +814,8 @@ Status GraphView::SetAllocAttrs(const Graph* g, const Device* device) {
   return s;
 }
 
+}  // namespace
+
 Status InferAllocAttr(const Node* n, const Node* dst,
                       const DeviceNameUtils::ParsedName& local_dev_name,
                       AllocatorAttributes* attr) {
@@ -832,6 +882,8 @@ Status InferAllocAttr(const Node* n, const Node* dst,
   return s;
 }
 
+namespace {
+
 // The state associated with one invocation of ExecutorImpl::Run.
 // ExecutorState dispatches nodes when they become ready and keeps
 // track of how many predecessors of a node have not done (pending_).
@@ -1240,6 +1292,8 @@ class ExecutorState {
   // QUESTION: Make it a checkpoint::TensorSliceReaderCacheWrapper
   // instead of a pointer?  (avoids having to delete).
   checkpoint::TensorSliceReaderCacheWrapper* slice_reader_cache_;
+  // Serves the temporaries of the kernels of this step, if not nullptr.
+  StepArenaAllocator* step_arena_;
   CallFrameInterface* call_frame_;
   const ExecutorImpl* impl_;
   CancellationManager* cancellation_manager_;
@@ -1260,6 +1314,35 @@ class ExecutorState {
 
   std::atomic_int_fast32_t num_outstanding_ops_;
 
+  // A node handed to the work-stealing lanes, along with the time it was
+  // scheduled for step stats.
+  struct ScheduledNode {
+    ScheduledNode() : tagged_node(nullptr, nullptr, -1, false) {}
+    ScheduledNode(const TaggedNode& node, int64 nsec)
+        : tagged_node(node), scheduled_nsec(nsec) {}
+
+    TaggedNode tagged_node;
+    int64 scheduled_nsec = 0;
+  };
+
+  // Per-worker deques of dispatched nodes. Non-null iff the executor runs in
+  // SchedulingMode::kWorkStealing.
+  std::unique_ptr<WorkStealingQueues<ScheduledNode>> work_queues_;
+
+  // Number of workers currently draining 'work_queues_'. Each worker also
+  // holds a count in 'num_outstanding_ops_', so that the step cannot
+  // finish (and delete this state) while a worker is still running.
+  std::atomic<int> num_workers_{0};
+
+  // lane_active_[i] is true while a worker owns lane 'i'. A worker is only
+  // started on a lane it claimed by flipping the flag from false to true,
+  // so that no two workers ever pop from the bottom of the same lane.
+  std::unique_ptr<std::atomic<bool>[]> lane_active_;
+
+  // Used to spread nodes dispatched from non-worker threads (for example
+  // the root nodes, or completions of asynchronous kernels) over the lanes.
+  std::atomic<uint32> next_lane_{0};
+
   mutex mu_;
   Status status_ GUARDED_BY(mu_);
 
@@ -1320,6 +1403,18 @@ class ExecutorState {
   void ScheduleReady(const TaggedNodeSeq& ready,
                      TaggedNodeReadyQueue* inline_ready);
 
+  // Runs 'tagged_node' on another thread: either as its own closure on
+  // 'runner_', or through the work-stealing lanes.
+  void Dispatch(const TaggedNode& tagged_node, int64 scheduled_nsec);
+
+  // Starts another work-stealing worker if there is more queued work than
+  // running workers and a lane is free.
+  void MaybeStartWorker();
+
+  // Body of a work-stealing worker owning 'lane'. Runs queued nodes until
+  // all lanes are empty.
+  void RunWorker(int lane);
+
   // For debugging/logging only.
   inline void MaybeMarkCompleted(FrameState* frame, int64 iter, int64 id);
 
@@ -1360,12 +1455,22 @@ ExecutorState::ExecutorState(const Executor::Args& args, ExecutorImpl* impl)
       step_container_(args.step_container),
       stats_collector_(args.stats_collector),
       slice_reader_cache_(new checkpoint::TensorSliceReaderCacheWrapper),
+      step_arena_(impl->AcquireStepArena()),
       call_frame_(args.call_frame),
       impl_(impl),
       cancellation_manager_(args.cancellation_manager),
       runner_(args.runner),
       sync_on_finish_(args.sync_on_finish),
       num_outstanding_ops_(0) {
+  if (impl_->scheduling_mode_ == ExecutorImpl::SchedulingMode::kWorkStealing) {
+    work_queues_.reset(new WorkStealingQueues<ScheduledNode>(
+        impl_->num_work_stealing_lanes_));
+    lane_active_.reset(
+        new std::atomic<bool>[impl_->num_work_stealing_lanes_]);
+    for (int i = 0; i < impl_->num_work_stealing_lanes_; ++i) {
+      lane_active_[i].store(false, std::memory_order_relaxed);
+    }
+  }
   // We start the entire execution in iteration 0 of the root frame
   // so let us create the root frame and the state for iteration 0.
   // We assume root_frame_->frame_name.empty().
@@ -1389,6 +1494,32 @@ ExecutorState::~ExecutorState() {
     it->Unref();
   }
   delete slice_reader_cache_;
+  // All kernels of the step have completed, so the arena only holds the
+  // temporaries that outlive the step.
+  if (step_arena_ != nullptr) impl_->ReleaseStepArena(step_arena_);
+}
+
+StepArenaAllocator* ExecutorImpl::AcquireStepArena() const {
+  if (!use_step_temp_arena_) return nullptr;
+  {
+    mutex_lock l(step_arenas_mu_);
+    if (!free_step_arenas_.empty()) {
+      StepArenaAllocator* arena = free_step_arenas_.back();
+      free_step_arenas_.pop_back();
+      return arena;
+    }
+  }
+  // The arena grows to the peak usage of the step after the first one.
+  static constexpr size_t kMinStepArenaBlockBytes = 1 << 20;
+  return new StepArenaAllocator(
+      params_.device->GetAllocator(AllocatorAttributes()),
+      kMinStepArenaBlockBytes);
+}
+
+void ExecutorImpl::ReleaseStepArena(StepArenaAllocator* arena) const {
+  arena->EndStep();
+  mutex_lock l(step_arenas_mu_);
+  free_step_arenas_.push_back(arena);
 }
 
 Status ExecutorImpl::BuildControlFlowInfo(const Graph* g,
@@ -1576,6 +1707,7 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
   params.resource_manager = device->resource_manager();
   params.step_container = step_container_;
   params.slice_reader_cache = slice_reader_cache_;
+  params.step_temp_allocator = step_arena_;
   params.inputs = &inputs;
   params.input_device_contexts = &input_device_contexts;
   params.input_alloc_attrs = &input_alloc_attrs;
@@ -1726,9 +1858,19 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_nsec) {
 
         // Synchronous computes.
         OpKernelContext ctx(&params, item.num_outputs);
+        // The Shard() calls of the kernel are measured to report them and to
+        // calibrate adaptive sharding.
+        ShardingContext sharding;
+        sharding.label = &op_kernel->type_string();
         nodestats::SetOpStart(stats);
-        device->Compute(CHECK_NOTNULL(op_kernel), &ctx);
+        {
+          ScopedShardingContext scoped_sharding(
+              stats != nullptr || AdaptiveShardingEnabled() ? &sharding
+                                                            : nullptr);
+          device->Compute(CHECK_NOTNULL(op_kernel), &ctx);
+        }
         nodestats::SetOpEnd(stats);
+        nodestats::SetSharding(stats, sharding);
         s = ProcessOutputs(item, &ctx, &outputs, stats);
         if (s.ok() && impl_->device_record_tensor_accesses_) {
           // Get the list of all tensors accessed during the execution
@@ -2147,7 +2289,7 @@ void ExecutorState::ScheduleReady(const TaggedNodeSeq& ready,
   if (inline_ready == nullptr) {
     // Schedule to run all the ready ops in thread pool.
     for (auto& tagged_node : ready) {
-      runner_([=]() { Process(tagged_node, scheduled_nsec); });
+      Dispatch(tagged_node, scheduled_nsec);
     }
     return;
   }
@@ -2162,8 +2304,7 @@ void ExecutorState::ScheduleReady(const TaggedNodeSeq& ready,
       if (curr_expensive_node) {
         // Dispatch to another thread since there is plenty of work to
         // do for this thread.
-        runner_(std::bind(&ExecutorState::Process, this, *curr_expensive_node,
-                          scheduled_nsec));
+        Dispatch(*curr_expensive_node, scheduled_nsec);
       }
       curr_expensive_node = &tagged_node;
     }
@@ -2175,12 +2316,85 @@ void ExecutorState::ScheduleReady(const TaggedNodeSeq& ready,
     } else {
       // There are inline nodes to run already. We dispatch this expensive
       // node to other thread.
-      runner_(std::bind(&ExecutorState::Process, this, *curr_expensive_node,
-                        scheduled_nsec));
+      Dispatch(*curr_expensive_node, scheduled_nsec);
+    }
+  }
+}
+
+// The work-stealing lane owned by the current thread, if the thread is
+// running ExecutorState::RunWorker() for 'current_worker_state'.
+thread_local const void* current_worker_state = nullptr;
+thread_local int current_worker_lane = -1;
+
+void ExecutorState::Dispatch(const TaggedNode& tagged_node,
+                             int64 scheduled_nsec) {
+  if (work_queues_ == nullptr) {
+    runner_(std::bind(&ExecutorState::Process, this, tagged_node,
+                      scheduled_nsec));
+    return;
+  }
+  // Successors produced by a worker go to the bottom of its own lane, so
+  // that the same thread picks them up next while their inputs are hot.
+  int lane;
+  if (current_worker_state == this) {
+    lane = current_worker_lane;
+  } else {
+    lane = next_lane_.fetch_add(1, std::memory_order_relaxed) %
+           work_queues_->num_lanes();
+  }
+  work_queues_->Push(lane, ScheduledNode(tagged_node, scheduled_nsec));
+  MaybeStartWorker();
+}
+
+void ExecutorState::MaybeStartWorker() {
+  const int num_lanes = work_queues_->num_lanes();
+  if (work_queues_->Size() <= num_workers_.load()) return;
+  for (int lane = 0; lane < num_lanes; ++lane) {
+    bool active = false;
+    if (lane_active_[lane].compare_exchange_strong(active, true)) {
+      num_workers_.fetch_add(1);
+      // The worker counts as an outstanding op until it exits.
+      num_outstanding_ops_.fetch_add(1, std::memory_order_relaxed);
+      runner_([this, lane]() { RunWorker(lane); });
+      return;
     }
   }
 }
 
+void ExecutorState::RunWorker(int lane) {
+  // Nested executors (e.g. function calls) may run a worker loop of their
+  // own on this thread, so restore the previous owner on the way out.
+  const void* const saved_state = current_worker_state;
+  const int saved_lane = current_worker_lane;
+  current_worker_state = this;
+  current_worker_lane = lane;
+
+  ScheduledNode next;
+  while (true) {
+    while (work_queues_->PopOrSteal(lane, &next)) {
+      // Process() cannot finish the step here: this worker still holds a
+      // count in num_outstanding_ops_.
+      Process(next.tagged_node, next.scheduled_nsec);
+    }
+    // Give up the lane before the worker count, so that a thread which sees
+    // the lower count also finds the lane free.
+    lane_active_[lane].store(false);
+    num_workers_.fetch_sub(1);
+    // A node may have been pushed after the last PopOrSteal() by a thread
+    // that saw this worker as running and so did not start a new one.
+    if (work_queues_->Empty()) break;
+    // If another thread claimed the lane in the meantime, its worker runs
+    // the remaining nodes.
+    bool active = false;
+    if (!lane_active_[lane].compare_exchange_strong(active, true)) break;
+    num_workers_.fetch_add(1);
+  }
+
+  current_worker_state = saved_state;
+  current_worker_lane = saved_lane;
+  if (num_outstanding_ops_.fetch_sub(1) == 1) Finish();
+}
+
 inline void ExecutorState::MaybeMarkCompleted(FrameState* frame, int64 iter,
                                               int64 node_id) {
   // TODO(misard) Replace with a finer-grain enabling flag once we
@@ -2661,10 +2875,14 @@ void ExecutorImpl::RunAsync(const Args& args, DoneCallback done) {
 
 }  // namespace
 
-Status NewLocalExecutor(const LocalExecutorParams& params,
-                        std::unique_ptr<const Graph> graph,
-                        Executor** executor) {
-  ExecutorImpl* impl = new ExecutorImpl(params, std::move(graph));
+namespace {
+
+Status NewLocalExecutorWithMode(const LocalExecutorParams& params,
+                                std::unique_ptr<const Graph> graph,
+                                ExecutorImpl::SchedulingMode scheduling_mode,
+                                Executor** executor) {
+  ExecutorImpl* impl =
+      new ExecutorImpl(params, std::move(graph), scheduling_mode);
   const Status s = impl->Initialize();
   if (s.ok()) {
     *executor = impl;
@@ -2674,6 +2892,16 @@ Status NewLocalExecutor(const LocalExecutorParams& params,
   return s;
 }
 
+}  // namespace
+
+Status NewLocalExecutor(const LocalExecutorParams& params,
+                        std::unique_ptr<const Graph> graph,
+                        Executor** executor) {
+  return NewLocalExecutorWithMode(
+      params, std::move(graph),
+      ExecutorImpl::SchedulingMode::kClosurePerNode, executor);
+}
+
 Status CreateNonCachedKernel(Device* device, FunctionLibraryRuntime* flib,
                              const NodeDef& ndef, int graph_def_version,
                              OpKernel** kernel) {
@@ -2709,6 +2937,30 @@ class DefaultExecutorRegistrar {
 };
 static DefaultExecutorRegistrar registrar;
 
+// Registers the work-stealing variant of the default executor. Select it
+// with ConfigProto.experimental.executor_type = "WORK_STEALING".
+class WorkStealingExecutorRegistrar {
+ public:
+  WorkStealingExecutorRegistrar() {
+    ExecutorFactory::Register("WORK_STEALING", new Factory);
+  }
+
+ private:
+  class Factory : public ExecutorFactory {
+    Status NewExecutor(const LocalExecutorParams& params,
+                       std::unique_ptr<const Graph> graph,
+                       std::unique_ptr<Executor>* out_executor) override {
+      Executor* ret = nullptr;
+      TF_RETURN_IF_ERROR(NewLocalExecutorWithMode(
+          params, std::move(graph),
+          ExecutorImpl::SchedulingMode::kWorkStealing, &ret));
+      out_executor->reset(ret);
+      return Status::OK();
+    }
+  };
+};
+static WorkStealingExecutorRegistrar work_stealing_registrar;
+
 }  // namespace
 
 }  // namespace tensorflow
@@ -18,6 +18,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
@@ -56,8 +57,10 @@ class ExecutorTest : public ::testing::Test {
     delete device_;
   }
 
-  // Resets executor_ with a new executor based on a graph 'gdef'.
-  void Create(std::unique_ptr<const Graph> graph) {
+  // Resets executor_ with a new executor based on a graph 'gdef'. The
+  // executor is created by the factory registered for 'executor_type'.
+  void Create(std::unique_ptr<const Graph> graph,
+              const string& executor_type = "") {
     const int version = graph->versions().producer();
     LocalExecutorParams params;
     params.device = device_;
@@ -69,7 +72,9 @@ class ExecutorTest : public ::testing::Test {
       DeleteNonCachedKernel(kernel);
     };
     delete exec_;
-    TF_CHECK_OK(NewLocalExecutor(params, std::move(graph), &exec_));
+    std::unique_ptr<Executor> exec;
+    TF_CHECK_OK(NewExecutor(executor_type, params, std::move(graph), &exec));
+    exec_ = exec.release();
     runner_ = [this](std::function<void()> fn) { thread_pool_->Schedule(fn); };
     rendez_ = NewLocalRendezvous();
   }
@@ -243,6 +248,45 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+TEST_F(ExecutorTest, RandomTreeWorkStealing) {
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  BuildTree(4096, g.get());
+  Create(std::move(g), "WORK_STEALING");
+  Rendezvous::Args args;
+  TF_ASSERT_OK(
+      rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0), false));
+  TF_ASSERT_OK(Run(rendez_));
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out, &is_dead));
+  EXPECT_EQ(4096.0, V(out));
+}
+
+TEST_F(ExecutorTest, SelfAddWorkStealingRepeated) {
+  // Same graph as SelfAdd, run many times on one executor to exercise the
+  // start/stop of work-stealing workers across steps.
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  auto v = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  const int N = 10;
+  for (int i = 1; i <= N; ++i) {
+    v = test::graph::Add(g.get(), v, v);
+  }
+  test::graph::Send(g.get(), v, "b", BOB, 1, ALICE);
+  Create(std::move(g), "WORK_STEALING");
+  Rendezvous::Args args;
+  for (int step = 0; step < 100; ++step) {
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(1024.0, V(out));
+  }
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -461,6 +505,89 @@ BENCHMARK(BM_executor)->ArgPair(8192, 32);
 // Tall fat graph
 BENCHMARK(BM_executor)->ArgPair(1024, 1024);
 
+// A chain of 'length' scalar adds: every node depends on its predecessor, so
+// the graph has no parallelism and measures per-node scheduling overhead.
+static Graph* ChainGraph(int length) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor one(DT_FLOAT, TensorShape({}));
+  one.scalar<float>()() = 1.0;
+  Node* c = test::graph::Constant(g, one);
+  Node* v = c;
+  for (int i = 0; i < length; ++i) {
+    v = test::graph::Add(g, v, c);
+  }
+  return g;
+}
+
+// 'width' independent chains of 'depth' scalar adds that hang off a common
+// source and are summed up at the end.
+static Graph* FanOutGraph(int width, int depth) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor one(DT_FLOAT, TensorShape({}));
+  one.scalar<float>()() = 1.0;
+  Node* c = test::graph::Constant(g, one);
+  std::vector<Node*> tails;
+  for (int i = 0; i < width; ++i) {
+    Node* v = c;
+    for (int j = 0; j < depth; ++j) {
+      v = test::graph::Add(g, v, c);
+    }
+    tails.push_back(v);
+  }
+  while (tails.size() > 1) {
+    Node* sum = test::graph::Add(g, tails[tails.size() - 2], tails.back());
+    tails.pop_back();
+    tails.back() = sum;
+  }
+  return g;
+}
+
+static void BM_ExecutorChain(int iters, int length,
+                             const char* executor_type) {
+#ifdef PLATFORM_GOOGLE
+  BenchmarkUseRealTime();
+  SetBenchmarkItemsProcessed(static_cast<int64>(length) * iters);
+#endif  // PLATFORM_GOOGLE
+  test::Benchmark("cpu", ChainGraph(length), nullptr, nullptr, nullptr,
+                  executor_type)
+      .Run(iters);
+}
+
+static void BM_ExecutorFanOut(int iters, int width, int depth,
+                              const char* executor_type) {
+#ifdef PLATFORM_GOOGLE
+  BenchmarkUseRealTime();
+  SetBenchmarkItemsProcessed(static_cast<int64>(width) * depth * iters);
+#endif  // PLATFORM_GOOGLE
+  test::Benchmark("cpu", FanOutGraph(width, depth), nullptr, nullptr, nullptr,
+                  executor_type)
+      .Run(iters);
+}
+
+static void BM_ExecutorChainDefault(int iters, int length) {
+  BM_ExecutorChain(iters, length, "DEFAULT");
+}
+static void BM_ExecutorChainWorkStealing(int iters, int length) {
+  BM_ExecutorChain(iters, length, "WORK_STEALING");
+}
+BENCHMARK(BM_ExecutorChainDefault)->Arg(16)->Arg(1024);
+BENCHMARK(BM_ExecutorChainWorkStealing)->Arg(16)->Arg(1024);
+
+static void BM_ExecutorFanOutDefault(int iters, int width, int depth) {
+  BM_ExecutorFanOut(iters, width, depth, "DEFAULT");
+}
+static void BM_ExecutorFanOutWorkStealing(int iters, int width, int depth) {
+  BM_ExecutorFanOut(iters, width, depth, "WORK_STEALING");
+}
+BENCHMARK(BM_ExecutorFanOutDefault)
+    ->ArgPair(64, 4)
+    ->ArgPair(1024, 4)
+    ->ArgPair(64, 64);
+BENCHMARK(BM_ExecutorFanOutWorkStealing)
+    ->ArgPair(64, 4)
+    ->ArgPair(1024, 4)
+    ->ArgPair(64, 64);
+
 static void BM_FeedInputFetchOutput(int iters) {
   Graph* g = new Graph(OpRegistry::Global());
   // z = x + y: x and y are provided as benchmark inputs.  z is the
@@ -114,6 +114,9 @@ class GPUCompatibleCPUDeviceFactory : public DeviceFactory {
     if (iter != options.config.device_count().end()) {
       n = iter->second;
     }
+    if (options.config.experimental().use_host_allocator_thread_cache()) {
+      ProcessState::singleton()->EnableBFCThreadCache();
+    }
     for (int i = 0; i < n; i++) {
       string name = strings::StrCat(name_prefix, "/device:CPU:", i);
       devices->push_back(new GPUCompatibleCPUDevice(
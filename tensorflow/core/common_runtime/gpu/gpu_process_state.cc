@@ -27,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/gpu/gpu_id_utils.h"
 #include "tensorflow/core/common_runtime/gpu/gpu_init.h"
 #include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/common_runtime/thread_caching_bfc_allocator.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/log_memory.h"
 #include "tensorflow/core/framework/tracking_allocator.h"
@@ -208,9 +209,23 @@ Allocator* GPUProcessState::GetCUDAHostAllocator(int numa_node) {
       LOG(ERROR) << "GetCUDAHostAllocator: " << status.error_message();
     }
     int64 cuda_host_mem_limit = cuda_host_mem_limit_in_mb * (1LL << 20);
-    VisitableAllocator* allocator =
-        new BFCAllocator(new CUDAHostAllocator(se), cuda_host_mem_limit,
-                         true /*allow_growth*/, "cuda_host_bfc" /*name*/);
+    bool use_thread_cache = false;
+    status = ReadBoolFromEnvVar("TF_CUDA_HOST_BFC_USE_THREAD_CACHE",
+                                process_state_->bfc_thread_cache_enabled_,
+                                &use_thread_cache);
+    if (!status.ok()) {
+      LOG(ERROR) << "GetCUDAHostAllocator: " << status.error_message();
+    }
+    VisitableAllocator* allocator;
+    if (use_thread_cache) {
+      allocator = new ThreadCachingBFCAllocator(
+          new CUDAHostAllocator(se), cuda_host_mem_limit,
+          true /*allow_growth*/, "cuda_host_bfc" /*name*/);
+    } else {
+      allocator =
+          new BFCAllocator(new CUDAHostAllocator(se), cuda_host_mem_limit,
+                           true /*allow_growth*/, "cuda_host_bfc" /*name*/);
+    }
 
     if (LogMemory::IsEnabled()) {
       // Wrap the allocator to track allocation ids for better logging
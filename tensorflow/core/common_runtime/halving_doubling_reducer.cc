@@ -0,0 +1,334 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/halving_doubling_reducer.h"
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <utility>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace {
+// Each CollectiveOp implementation is free to define its own
+// BufRendezvous key format.  This function produces the key used by
+// HalvingDoublingReducer and HierarchicalReducer.  Both source and
+// destination are needed because a device may send the same step to
+// several peers.
+string HalvingDoublingBufKey(const string& exec_key, const string& phase,
+                             int step, int source_dev, int dest_dev) {
+  return strings::StrCat(exec_key, ":", phase, ":", step, ":", source_dev, ":",
+                         dest_dev);
+}
+
+// Largest power of two not greater than n, for n > 0.
+int LowerPowerOfTwo(int n) {
+  int p = 1;
+  while (p * 2 <= n) p *= 2;
+  return p;
+}
+
+}  // namespace
+
+HalvingDoublingReducer::HalvingDoublingReducer()
+    : col_ctx_(nullptr), col_params_(nullptr) {}
+
+Status HalvingDoublingReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  CHECK_EQ(col_params->instance.type, REDUCTION_COLLECTIVE);
+  return Status::OK();
+}
+
+Status HalvingDoublingReducer::InitializeCollectiveContext(
+    CollectiveContext* col_ctx) {
+  CHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = &col_ctx->col_params;
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+void HalvingDoublingReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  Status s = CopyInputToOutput();
+  if (s.ok()) {
+    std::vector<int> devices(col_params_->group.group_size);
+    std::iota(devices.begin(), devices.end(), 0);
+    s = AllReduce(devices);
+  }
+  done(s);
+}
+
+Status HalvingDoublingReducer::CopyInputToOutput() {
+  if ((col_ctx_->input == col_ctx_->output) ||
+      (DMAHelper::base(col_ctx_->input) == DMAHelper::base(col_ctx_->output))) {
+    return Status::OK();
+  }
+  // We are running in a blockable thread and the callback can't block so
+  // just wait here on the copy.
+  Notification note;
+  Status status;
+  CollectiveRemoteAccessLocal::MemCpyAsync(
+      col_ctx_->op_ctx->input_device_context(0),
+      col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+      col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+      col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input,
+      col_ctx_->output, 0 /*dev_to_dev_stream_index*/,
+      [&note, &status](const Status& s) {
+        status.Update(s);
+        note.Notify();
+      });
+  note.WaitForNotification();
+  return status;
+}
+
+Status HalvingDoublingReducer::AllReduce(const std::vector<int>& devices) {
+  // Split the value into one chunk per device taking part in the halving and
+  // doubling steps.
+  AllocatorAttributes attr = col_ctx_->op_ctx->output_alloc_attr(0);
+  std::unique_ptr<CollectiveAdapter> ca(MakeCollectiveAdapter(
+      col_ctx_->output, LowerPowerOfTwo(devices.size()),
+      col_ctx_->device->GetAllocator(attr)));
+  Status s = AllReduceChunks(devices, ca.get());
+  // Recover the output from the adaptor.
+  ca->ConsumeFinalValue(col_ctx_->output);
+  return s;
+}
+
+Status HalvingDoublingReducer::AllReduceChunks(const std::vector<int>& devices,
+                                               CollectiveAdapter* ca) {
+  const int num_devices = devices.size();
+  const int rank =
+      std::find(devices.begin(), devices.end(), col_params_->default_rank) -
+      devices.begin();
+  CHECK_LT(rank, num_devices);
+  const int num_chunks = LowerPowerOfTwo(num_devices);
+  // The first 2 * num_surplus ranks pair up: each even one folds its value
+  // into the next odd one, which stands in for both of them.
+  const int num_surplus = num_devices - num_chunks;
+  const bool folded = rank < 2 * num_surplus;
+  const int vrank = folded ? rank / 2 : rank - num_surplus;
+  auto peer = [&devices, num_surplus](int peer_vrank) {
+    return devices[peer_vrank < num_surplus ? 2 * peer_vrank + 1
+                                            : peer_vrank + num_surplus];
+  };
+  VLOG(1) << "HalvingDoublingReducer::Run for device "
+          << col_ctx_->device_name << " rank " << rank << " of "
+          << num_devices << " vrank " << vrank;
+
+  Tensor value = ca->ChunkRangeAlias(0, num_chunks);
+  Tensor tmp(col_ctx_->device->GetAllocator(
+                 col_ctx_->op_ctx->output_alloc_attr(0)),
+             value.dtype(), value.shape());
+  const DeviceBase::GpuDeviceInfo* gpu_info =
+      col_ctx_->device->tensorflow_gpu_device_info();
+  if (gpu_info) {
+    // Wait for all currently queued events on the CPU compute stream to
+    // complete before proceeding.  The temp buffer allocated above is not
+    // guaranteed to be valid (e.g. for RDMA write) unless we do.
+    Notification note;
+    Status s = gpu_info->default_context->ThenExecute(
+        col_ctx_->device, gpu_info->stream, [&note]() { note.Notify(); });
+    if (!s.ok()) {
+      return StartAbort(errors::Internal(
+          "Failed to dispatch ThenExecute in HalvingDoublingReducer"));
+    }
+    note.WaitForNotification();
+  }
+
+  Tensor empty = ca->ChunkRangeAlias(0, 0);
+  if (folded) {
+    if (rank % 2 == 0) {
+      // Hand the value to the partner, then wait for the result.
+      TF_RETURN_IF_ERROR(
+          Exchange(devices[rank + 1], "fold", 0, &value, &empty));
+      return Exchange(devices[rank + 1], "unfold", 0, &empty, &value);
+    }
+    TF_RETURN_IF_ERROR(Exchange(devices[rank - 1], "fold", 0, &empty, &tmp));
+    TF_RETURN_IF_ERROR(Merge(&value, &tmp));
+  }
+
+  // Reduce-scatter by recursive halving: at each step keep the half of the
+  // current chunk range selected by one bit of vrank and send the other half
+  // to the peer that differs in that bit.  This leaves chunk vrank fully
+  // reduced.
+  int lo = 0;
+  int n = num_chunks;
+  for (int d = num_chunks / 2; d >= 1; d /= 2) {
+    n /= 2;
+    const bool upper = (vrank & d) != 0;
+    const int keep_lo = upper ? lo + n : lo;
+    Tensor send = ca->ChunkRangeAlias(upper ? lo : lo + n, n);
+    Tensor keep = ca->ChunkRangeAlias(keep_lo, n);
+    Tensor recv = tmp.Slice(0, keep.NumElements());
+    TF_RETURN_IF_ERROR(Exchange(peer(vrank ^ d), "halve", d, &send, &recv));
+    if (keep.NumElements() > 0) {
+      TF_RETURN_IF_ERROR(Merge(&keep, &recv));
+    }
+    lo = keep_lo;
+  }
+  DCHECK_EQ(lo, vrank);
+  Tensor chunk = ca->ChunkRangeAlias(vrank, 1);
+  TF_RETURN_IF_ERROR(Finalize(ca, &chunk));
+
+  // All-gather by recursive doubling, in the reverse order.
+  for (int d = 1; d < num_chunks; d *= 2) {
+    const int peer_lo = (vrank & d) ? lo - n : lo + n;
+    Tensor send = ca->ChunkRangeAlias(lo, n);
+    Tensor recv = ca->ChunkRangeAlias(peer_lo, n);
+    TF_RETURN_IF_ERROR(Exchange(peer(vrank ^ d), "double", d, &send, &recv));
+    lo = std::min(lo, peer_lo);
+    n *= 2;
+  }
+
+  if (folded) {
+    TF_RETURN_IF_ERROR(
+        Exchange(devices[rank - 1], "unfold", 0, &value, &empty));
+  }
+  return status();
+}
+
+void HalvingDoublingReducer::PostTo(int dev_idx, const string& phase, int step,
+                                    const Tensor* tensor,
+                                    const StatusCallback& done) {
+  string key = HalvingDoublingBufKey(col_ctx_->exec_key, phase, step,
+                                     col_params_->default_rank, dev_idx);
+  VLOG(3) << "PostTo rank=" << col_params_->default_rank << " key " << key;
+  col_ctx_->col_exec->PostToPeer(
+      col_params_->instance.device_names[dev_idx],
+      col_params_->instance.task_names[dev_idx], key, col_ctx_->device,
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), tensor,
+      col_ctx_->device_locality, done);
+}
+
+void HalvingDoublingReducer::RecvFrom(int dev_idx, const string& phase,
+                                      int step, Tensor* tensor,
+                                      const StatusCallback& done) {
+  string key = HalvingDoublingBufKey(col_ctx_->exec_key, phase, step, dev_idx,
+                                     col_params_->default_rank);
+  VLOG(3) << "RecvFrom rank=" << col_params_->default_rank << " key " << key;
+  col_ctx_->col_exec->RecvFromPeer(
+      col_params_->instance.device_names[dev_idx],
+      col_params_->instance.task_names[dev_idx],
+      col_params_->task.is_local[dev_idx], key, col_ctx_->device,
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), tensor,
+      col_ctx_->device_locality, 0 /*dev_to_dev_stream_index*/, done);
+}
+
+StatusCallback HalvingDoublingReducer::Pending(BlockingCounter* pending) {
+  return [this, pending](const Status& s) {
+    if (!s.ok()) {
+      StartAbort(s);
+    }
+    pending->DecrementCount();
+  };
+}
+
+Status HalvingDoublingReducer::Exchange(int dev_idx, const string& phase,
+                                        int step, const Tensor* send,
+                                        Tensor* recv) {
+  // Both sides agree on which tensors are empty, since they're slices of
+  // identically chunked values.
+  const bool do_send = send->NumElements() > 0;
+  const bool do_recv = recv->NumElements() > 0;
+  BlockingCounter pending(do_send + do_recv);
+  if (do_send) PostTo(dev_idx, phase, step, send, Pending(&pending));
+  if (do_recv) RecvFrom(dev_idx, phase, step, recv, Pending(&pending));
+  pending.Wait();
+  return status();
+}
+
+Status HalvingDoublingReducer::Merge(Tensor* output, Tensor* input) {
+  Status s = collective_util::ComputeBinOp(
+      col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+      col_params_->merge_op.get(), output, input);
+  return s.ok() ? s : StartAbort(s);
+}
+
+Status HalvingDoublingReducer::Finalize(CollectiveAdapter* ca, Tensor* value) {
+  if (!col_params_->final_op || value->NumElements() == 0) {
+    return Status::OK();
+  }
+  // The final_op divides by the size of the whole group, which may be
+  // larger than the number of devices taking part in AllReduce.
+  Tensor group_size = ca->Scalar(col_params_->group.group_size);
+  if (col_params_->group.device_type != "CPU") {
+    Tensor group_size_on_device = ca->Scalar(col_ctx_->device->GetAllocator(
+        col_ctx_->op_ctx->input_alloc_attr(0)));
+    Notification note;
+    Status status;
+    col_ctx_->op_ctx->op_device_context()->CopyCPUTensorToDevice(
+        &group_size, col_ctx_->device, &group_size_on_device,
+        [&note, &status](const Status& s) {
+          status = s;
+          note.Notify();
+        });
+    note.WaitForNotification();
+    if (!status.ok()) return StartAbort(status);
+    group_size = group_size_on_device;
+  }
+  Status s = collective_util::ComputeBinOp(
+      col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+      col_params_->final_op.get(), value, &group_size);
+  return s.ok() ? s : StartAbort(s);
+}
+
+Status HalvingDoublingReducer::StartAbort(const Status& s) {
+  // If this is the initial entry to abort mode then invoke StartAbort
+  // on the CollectiveExecutor that invoked us.  That should start
+  // cancellation on all of the outstanding CollectiveRemoteAccess
+  // actions, including those our peers are waiting on.
+  bool abort_started = false;
+  Status first_status;
+  {
+    mutex_lock l(status_mu_);
+    if (status_.ok()) {
+      LOG(ERROR) << "Aborting HalvingDoublingReduce with " << s;
+      abort_started = true;
+      status_.Update(s);
+    }
+    first_status = status_;
+  }
+  if (abort_started) {
+    col_ctx_->col_exec->StartAbort(s);
+  }
+  return first_status;
+}
+
+Status HalvingDoublingReducer::status() {
+  mutex_lock l(status_mu_);
+  return status_;
+}
+
+REGISTER_COLLECTIVE(HalvingDoublingReduce, HalvingDoublingReducer);
+
+}  // namespace tensorflow
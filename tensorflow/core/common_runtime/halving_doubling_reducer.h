@@ -0,0 +1,103 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HALVING_DOUBLING_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HALVING_DOUBLING_REDUCER_H_
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+
+namespace tensorflow {
+class Device;
+
+// Recursive halving-doubling implementation of collective all-reduce.
+//
+// A reduce-scatter by recursive halving is followed by an all-gather by
+// recursive doubling, for 2*log2(group_size) steps in total instead of the
+// 2*(group_size-1) steps of RingReducer.  That makes it the better choice
+// for small tensors in large groups, where latency rather than bandwidth
+// dominates.  If the group size is not a power of two, the surplus devices
+// first fold their values into a partner, and receive the final value from
+// it at the end.
+class HalvingDoublingReducer : public CollectiveImplementationInterface {
+ public:
+  HalvingDoublingReducer();
+  ~HalvingDoublingReducer() override {}
+
+  // No subdivision permutations are needed, so this only checks that
+  // col_params describes a reduction.
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object.
+  Status InitializeCollectiveContext(CollectiveContext* col_ctx) override;
+
+  // Begins execution of the halving-doubling reduce algorithm.
+  // Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+ protected:
+  // Copies the input to the output unless we're computing in-place on the
+  // input tensor.
+  Status CopyInputToOutput();
+
+  // All-reduces the output among the devices in "devices", given as indices
+  // into instance.device_names, and applies final_op to the result.  This
+  // device must be one of them.  Blocks until done.
+  Status AllReduce(const std::vector<int>& devices);
+
+  // Starts sending "tensor" to, or receiving "tensor" from, the device with
+  // index "dev_idx".  Data moves only if the key generated from "phase" and
+  // "step" matches on both sides.
+  void PostTo(int dev_idx, const string& phase, int step, const Tensor* tensor,
+              const StatusCallback& done);
+  void RecvFrom(int dev_idx, const string& phase, int step, Tensor* tensor,
+                const StatusCallback& done);
+
+  // Returns a callback for PostTo or RecvFrom that aborts the collective on
+  // error, then decrements "pending".
+  StatusCallback Pending(BlockingCounter* pending);
+
+  // Computes merge_op in place on "output" and "input".
+  Status Merge(Tensor* output, Tensor* input);
+
+  // Called when a bad status is received that implies we should terminate
+  // execution and return a bad status.  Returns the first such status.
+  Status StartAbort(const Status& s);
+
+  // Returns the status of the collective so far.
+  Status status();
+
+  CollectiveContext* col_ctx_;          // Not owned
+  const CollectiveParams* col_params_;  // Not owned
+
+ private:
+  Status AllReduceChunks(const std::vector<int>& devices,
+                         CollectiveAdapter* ca);
+  // Sends "send" to and receives "recv" from the device with index
+  // "dev_idx" at the same time.  Empty tensors are skipped.
+  Status Exchange(int dev_idx, const string& phase, int step,
+                  const Tensor* send, Tensor* recv);
+  Status Finalize(CollectiveAdapter* ca, Tensor* value);
+
+  mutex status_mu_;
+  Status status_ GUARDED_BY(status_mu_);
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HALVING_DOUBLING_REDUCER_H_
@@ -0,0 +1,113 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+
+void HierarchicalReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  Status s = CopyInputToOutput();
+  if (!s.ok()) {
+    done(s);
+    return;
+  }
+  // Precondition: device_names must be sorted so that all devices in
+  // the same task are adjacent.  The first one of each task leads it.
+  const std::vector<string>& task_names = col_params_->instance.task_names;
+  const int rank = col_params_->default_rank;
+  int first_dev = rank;
+  while (first_dev > 0 && task_names[first_dev - 1] == task_names[rank]) {
+    --first_dev;
+  }
+  int end_dev = rank + 1;
+  while (end_dev < col_params_->group.group_size &&
+         task_names[end_dev] == task_names[rank]) {
+    ++end_dev;
+  }
+  VLOG(1) << "HierarchicalReducer::Run for device " << col_ctx_->device_name
+          << " rank " << rank << " task leader " << first_dev;
+
+  if (rank == first_dev) {
+    s = RunLeader(first_dev, end_dev);
+  } else {
+    BlockingCounter pending(1);
+    PostTo(first_dev, "gather", 0, col_ctx_->output, Pending(&pending));
+    pending.Wait();
+    s = status();
+    if (s.ok()) {
+      BlockingCounter result_pending(1);
+      RecvFrom(first_dev, "bcast", 0, col_ctx_->output,
+               Pending(&result_pending));
+      result_pending.Wait();
+      s = status();
+    }
+  }
+  done(s);
+}
+
+Status HierarchicalReducer::RunLeader(int first_dev, int end_dev) {
+  // Gather the values of the other devices in this task concurrently, then
+  // merge them in a fixed order.
+  const int num_members = end_dev - first_dev - 1;
+  Allocator* allocator =
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0));
+  std::vector<Tensor> values;
+  values.reserve(num_members);
+  for (int i = 0; i < num_members; ++i) {
+    values.emplace_back(allocator, col_ctx_->output->dtype(),
+                        col_ctx_->output->shape());
+  }
+  {
+    BlockingCounter pending(num_members);
+    for (int i = 0; i < num_members; ++i) {
+      RecvFrom(first_dev + 1 + i, "gather", 0, &values[i], Pending(&pending));
+    }
+    pending.Wait();
+  }
+  TF_RETURN_IF_ERROR(status());
+  for (Tensor& value : values) {
+    TF_RETURN_IF_ERROR(Merge(col_ctx_->output, &value));
+  }
+  values.clear();
+
+  std::vector<int> leaders;
+  const std::vector<string>& task_names = col_params_->instance.task_names;
+  for (int di = 0; di < col_params_->group.group_size; ++di) {
+    if (di == 0 || task_names[di] != task_names[di - 1]) {
+      leaders.push_back(di);
+    }
+  }
+  TF_RETURN_IF_ERROR(AllReduce(leaders));
+
+  BlockingCounter pending(num_members);
+  for (int di = first_dev + 1; di < end_dev; ++di) {
+    PostTo(di, "bcast", 0, col_ctx_->output, Pending(&pending));
+  }
+  pending.Wait();
+  return status();
+}
+
+REGISTER_COLLECTIVE(HierarchicalReduce, HierarchicalReducer);
+
+}  // namespace tensorflow
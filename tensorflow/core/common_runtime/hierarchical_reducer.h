@@ -0,0 +1,44 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+
+#include "tensorflow/core/common_runtime/halving_doubling_reducer.h"
+
+namespace tensorflow {
+
+// Two-level implementation of collective all-reduce.
+//
+// The first device of each task gathers and merges the values of the other
+// devices in its task, the task leaders then all-reduce among themselves by
+// recursive halving-doubling, and each leader finally broadcasts the result
+// within its task.  Only one device per task sends data between tasks, so
+// the number of inter-task messages depends on the number of tasks rather
+// than on the group size.
+class HierarchicalReducer : public HalvingDoublingReducer {
+ public:
+  HierarchicalReducer() {}
+  ~HierarchicalReducer() override {}
+
+  // Begins execution of the hierarchical reduce algorithm.
+  // Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+ private:
+  Status RunLeader(int first_dev, int end_dev);
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
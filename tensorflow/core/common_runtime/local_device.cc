@@ -16,13 +16,22 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 
 #include "tensorflow/core/common_runtime/local_device.h"
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/common_runtime/eigen_thread_pool.h"
+#include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/byte_order.h"
 #include "tensorflow/core/platform/cpu_feature_guard.h"
 #include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/public/session_options.h"
 
@@ -31,30 +40,116 @@ namespace tensorflow {
 /* static */
 bool LocalDevice::use_global_threadpool_ = true;
 
+namespace {
+
+// Key of the thread pool that spans the pools of all NUMA nodes in the map
+// of global thread pools, which is keyed by NUMA node otherwise.
+constexpr int kAllNUMANodes = port::kNUMANoAffinity - 1;
+
+// An Eigen thread pool made of the thread pools of the NUMA nodes. Work
+// scheduled from a thread of one of the pools stays in that pool; other
+// work is spread over the pools round-robin.
+class NUMASpanningThreadPool : public Eigen::ThreadPoolInterface {
+ public:
+  explicit NUMASpanningThreadPool(const std::vector<thread::ThreadPool*>& pools)
+      : pools_(pools), next_pool_(0) {
+    int num_threads = 0;
+    for (thread::ThreadPool* pool : pools_) {
+      first_thread_ids_.push_back(num_threads);
+      num_threads += pool->NumThreads();
+    }
+    num_threads_ = num_threads;
+  }
+
+  void Schedule(std::function<void()> fn) override {
+    for (thread::ThreadPool* pool : pools_) {
+      if (pool->CurrentThreadId() >= 0) {
+        pool->Schedule(std::move(fn));
+        return;
+      }
+    }
+    const uint32 i = next_pool_.fetch_add(1, std::memory_order_relaxed);
+    pools_[i % pools_.size()]->Schedule(std::move(fn));
+  }
+
+  int NumThreads() const override { return num_threads_; }
+
+  int CurrentThreadId() const override {
+    for (size_t i = 0; i < pools_.size(); ++i) {
+      const int id = pools_[i]->CurrentThreadId();
+      if (id >= 0) return first_thread_ids_[i] + id;
+    }
+    return -1;
+  }
+
+ private:
+  const std::vector<thread::ThreadPool*> pools_;
+  std::vector<int> first_thread_ids_;
+  int num_threads_;
+  std::atomic<uint32> next_pool_;
+};
+
+}  // namespace
+
 struct LocalDevice::EigenThreadPoolInfo {
-  explicit EigenThreadPoolInfo(const SessionOptions& options) {
+  // If 'numa_node' is not port::kNUMANoAffinity, the threads are bound to
+  // that NUMA node and get one node's share of the threads, so that the
+  // pools of all nodes together have as many threads as one pool without
+  // affinity.
+  EigenThreadPoolInfo(const SessionOptions& options, int numa_node) {
     int32 intra_op_parallelism_threads =
         options.config.intra_op_parallelism_threads();
     if (intra_op_parallelism_threads == 0) {
       intra_op_parallelism_threads = port::NumSchedulableCPUs();
     }
+    if (numa_node != port::kNUMANoAffinity) {
+      intra_op_parallelism_threads =
+          std::max(1, intra_op_parallelism_threads / port::NUMANumNodes());
+    }
     VLOG(1) << "Local device intra op parallelism threads: "
-            << intra_op_parallelism_threads;
+            << intra_op_parallelism_threads << " numa_node: " << numa_node;
+    ThreadOptions thread_options;
+    thread_options.numa_node = numa_node;
     eigen_worker_threads_.num_threads = intra_op_parallelism_threads;
     eigen_worker_threads_.workers = new thread::ThreadPool(
-        options.env, "Eigen", intra_op_parallelism_threads);
+        options.env, thread_options, "Eigen", intra_op_parallelism_threads);
     eigen_threadpool_wrapper_.reset(
         new EigenThreadPoolWrapper(eigen_worker_threads_.workers));
     eigen_device_.reset(new Eigen::ThreadPoolDevice(
         eigen_threadpool_wrapper_.get(), eigen_worker_threads_.num_threads));
   }
 
+  // Runs on the threads of the pools of 'node_infos', one per NUMA node,
+  // instead of threads of its own, so that a device that is not bound to a
+  // node does not add to the threads of the devices that are. Eigen
+  // computations use the threads of all nodes. Shard() and
+  // ParallelFor() take a single thread::ThreadPool, so they use the threads
+  // of node 0.
+  explicit EigenThreadPoolInfo(
+      const std::vector<EigenThreadPoolInfo*>& node_infos) {
+    std::vector<thread::ThreadPool*> pools;
+    for (const EigenThreadPoolInfo* info : node_infos) {
+      pools.push_back(info->eigen_worker_threads_.workers);
+    }
+    eigen_worker_threads_ = node_infos[0]->eigen_worker_threads_;
+    owns_workers_ = false;
+    eigen_threadpool_wrapper_.reset(new NUMASpanningThreadPool(pools));
+    eigen_device_.reset(
+        new Eigen::ThreadPoolDevice(eigen_threadpool_wrapper_.get(),
+                                    eigen_threadpool_wrapper_->NumThreads()));
+    VLOG(1) << "Local device spanning " << pools.size()
+            << " NUMA nodes with " << eigen_threadpool_wrapper_->NumThreads()
+            << " intra op parallelism threads";
+  }
+
   ~EigenThreadPoolInfo() {
     eigen_threadpool_wrapper_.reset();
     eigen_device_.reset();
-    delete eigen_worker_threads_.workers;
+    if (owns_workers_) delete eigen_worker_threads_.workers;
   }
 
+  bool owns_workers_ = true;
+
   DeviceBase::CpuWorkerThreads eigen_worker_threads_;
   std::unique_ptr<Eigen::ThreadPoolInterface> eigen_threadpool_wrapper_;
   std::unique_ptr<Eigen::ThreadPoolDevice> eigen_device_;
@@ -67,16 +162,49 @@ LocalDevice::LocalDevice(const SessionOptions& options,
   // could speed up performance and are available on the current CPU.
   port::InfoAboutUnusedCPUFeatures();
   LocalDevice::EigenThreadPoolInfo* tp_info;
+  // CPU devices with NUMA affinity get threads bound to their node.
+  int numa_node = port::kNUMANoAffinity;
+  bool spans_numa_nodes = false;
+  if (options.config.experimental().use_numa_affinity() &&
+      attributes.device_type() == DEVICE_CPU) {
+    numa_node = attributes.locality().numa_node();
+    DCHECK_LT(numa_node, port::NUMANumNodes());
+    spans_numa_nodes = numa_node == port::kNUMANoAffinity;
+  }
   if (use_global_threadpool_) {
-    // All ThreadPoolDevices in the process will use this single fixed
-    // sized threadpool for numerical computations.
-    static LocalDevice::EigenThreadPoolInfo* global_tp_info =
-        new LocalDevice::EigenThreadPoolInfo(options);
-    tp_info = global_tp_info;
+    // All ThreadPoolDevices in the process (or, with NUMA affinity, all
+    // those of one NUMA node) will use this single fixed sized threadpool
+    // for numerical computations. With NUMA affinity, the CPU device that
+    // is not bound to a node shares the threads of all nodes.
+    static mutex* global_tp_mu = new mutex;
+    static auto* global_tp_info =
+        new std::unordered_map<int, LocalDevice::EigenThreadPoolInfo*>;
+    mutex_lock l(*global_tp_mu);
+    auto get_tp_info = [&options](int node) {
+      auto& slot = (*global_tp_info)[node];
+      if (slot == nullptr) {
+        slot = new LocalDevice::EigenThreadPoolInfo(options, node);
+      }
+      return slot;
+    };
+    if (spans_numa_nodes) {
+      auto& slot = (*global_tp_info)[kAllNUMANodes];
+      if (slot == nullptr) {
+        std::vector<LocalDevice::EigenThreadPoolInfo*> node_infos;
+        for (int node = 0; node < port::NUMANumNodes(); ++node) {
+          node_infos.push_back(get_tp_info(node));
+        }
+        slot = new LocalDevice::EigenThreadPoolInfo(node_infos);
+      }
+      tp_info = slot;
+    } else {
+      tp_info = get_tp_info(numa_node);
+    }
   } else {
     // Each LocalDevice owns a separate ThreadPoolDevice for numerical
     // computations.
-    owned_tp_info_.reset(new LocalDevice::EigenThreadPoolInfo(options));
+    owned_tp_info_.reset(
+        new LocalDevice::EigenThreadPoolInfo(options, numa_node));
     tp_info = owned_tp_info_.get();
   }
   set_tensorflow_cpu_worker_threads(&tp_info->eigen_worker_threads_);
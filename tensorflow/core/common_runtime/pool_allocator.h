@@ -165,7 +165,8 @@ class Pow2Rounder : public RoundUpInterface {
 
 class BasicCPUAllocator : public SubAllocator {
  public:
-  // Argument numa_node is currently ignored.
+  // If numa_node is not port::kNUMANoAffinity, memory is allocated on that
+  // NUMA node when the platform supports it.
   explicit BasicCPUAllocator(int numa_node) : numa_node_(numa_node) {}
 
   ~BasicCPUAllocator() override {}
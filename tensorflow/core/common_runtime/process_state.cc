@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/bfc_allocator.h"
 #include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/common_runtime/thread_caching_bfc_allocator.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/log_memory.h"
 #include "tensorflow/core/framework/tracking_allocator.h"
@@ -42,7 +43,8 @@ ProcessState* ProcessState::instance_ = nullptr;
   return instance_;
 }
 
-ProcessState::ProcessState() : numa_enabled_(false) {
+ProcessState::ProcessState()
+    : numa_enabled_(false), bfc_thread_cache_enabled_(false) {
   CHECK(instance_ == nullptr);
 }
 
@@ -95,11 +97,27 @@ VisitableAllocator* ProcessState::GetCPUAllocator(int numa_node) {
         LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
       }
       int64 cpu_mem_limit = cpu_mem_limit_in_mb * (1LL << 20);
-      allocator = new BFCAllocator(
-          new BasicCPUAllocator(numa_enabled_ ? numa_node : -1), cpu_mem_limit,
-          true /*allow_growth*/, "bfc_cpu_allocator_for_gpu" /*name*/);
+      bool use_thread_cache = false;
+      status = ReadBoolFromEnvVar("TF_CPU_BFC_USE_THREAD_CACHE",
+                                  bfc_thread_cache_enabled_,
+                                  &use_thread_cache);
+      if (!status.ok()) {
+        LOG(ERROR) << "GetCPUAllocator: " << status.error_message();
+      }
+      if (use_thread_cache) {
+        allocator = new ThreadCachingBFCAllocator(
+            new BasicCPUAllocator(numa_enabled_ ? numa_node : -1),
+            cpu_mem_limit, true /*allow_growth*/,
+            "bfc_cpu_allocator_for_gpu" /*name*/);
+      } else {
+        allocator = new BFCAllocator(
+            new BasicCPUAllocator(numa_enabled_ ? numa_node : -1),
+            cpu_mem_limit, true /*allow_growth*/,
+            "bfc_cpu_allocator_for_gpu" /*name*/);
+      }
       VLOG(2) << "Using BFCAllocator with memory limit of "
-              << cpu_mem_limit_in_mb << " MB for ProcessState CPU allocator";
+              << cpu_mem_limit_in_mb << " MB for ProcessState CPU allocator"
+              << (use_thread_cache ? " and a thread cache" : "");
     } else {
       allocator = new PoolAllocator(
           100 /*pool_size_limit*/, true /*auto_resize*/,
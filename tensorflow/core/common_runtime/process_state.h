@@ -59,12 +59,16 @@ class ProcessState {
   // Allocator accessor.
   void EnableNUMA() { numa_enabled_ = true; }
 
+  // If the host BFC allocators should have a per-thread cache of small
+  // blocks, call this before calling any Allocator accessor.
+  void EnableBFCThreadCache() { bfc_thread_cache_enabled_ = true; }
+
   // Returns what we know about the memory at ptr.
   // If we know nothing, it's called CPU 0 with no other attributes.
   MemDesc PtrType(const void* ptr);
 
-  // Returns the one CPUAllocator used for the given numa_node.
-  // TEMPORARY: ignores numa_node.
+  // Returns the one CPUAllocator used for the given numa_node. Unless NUMA
+  // is enabled, the same allocator is returned for every node.
   VisitableAllocator* GetCPUAllocator(int numa_node);
 
   typedef std::unordered_map<const void*, MemDesc> MDMap;
@@ -84,6 +88,7 @@ class ProcessState {
 
   static ProcessState* instance_;
   bool numa_enabled_;
+  bool bfc_thread_cache_enabled_;
 
   mutex mu_;
 
@@ -0,0 +1,169 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/ring_gatherer.h"
+
+#include <utility>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace {
+// Each CollectiveOp implementation is free to define its own
+// BufRendezvous key format.  This function produces the key used by
+// RingGatherer.
+string RingGatherBufKey(const string& exec_key, int step, int source_rank) {
+  return strings::StrCat(exec_key, ":gather:", step, ":", source_rank);
+}
+
+}  // namespace
+
+RingGatherer::RingGatherer() : col_ctx_(nullptr), col_params_(nullptr) {}
+
+Status RingGatherer::InitializeCollectiveParams(CollectiveParams* col_params) {
+  CHECK_EQ(col_params->instance.type, GATHER_COLLECTIVE);
+  CHECK_EQ(col_params->instance.impl_details.collective_name, "RingGather");
+  return Status::OK();
+}
+
+Status RingGatherer::InitializeCollectiveContext(CollectiveContext* col_ctx) {
+  CHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = &col_ctx->col_params;
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+void RingGatherer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  Status s = RunRing();
+  done(s);
+}
+
+Status RingGatherer::RunRing() {
+  const int group_size = col_params_->group.group_size;
+  const int rank = col_params_->default_rank;
+  const int64 chunk_elts = col_ctx_->input->NumElements();
+  if (col_ctx_->output->NumElements() != chunk_elts * group_size) {
+    return errors::Internal("RingGatherer output has ",
+                            col_ctx_->output->NumElements(),
+                            " elements, expected ", chunk_elts * group_size);
+  }
+  // View the output as a vector in which chunk i holds the input of the
+  // device with rank i.  The transfers are plain copies, so the chunks
+  // needn't be aligned.
+  Tensor output;
+  CHECK(output.CopyFrom(*col_ctx_->output,
+                        TensorShape({chunk_elts * group_size})));
+  auto chunk = [&output, chunk_elts](int i) {
+    return output.Slice(i * chunk_elts, (i + 1) * chunk_elts);
+  };
+  VLOG(1) << "RingGatherer::Run for device " << col_ctx_->device_name
+          << " rank " << rank << " chunk_elts " << chunk_elts;
+
+  // Start by copying the input into this device's chunk of the output.
+  // We are running in a blockable thread and the callback can't block so
+  // just wait here on the copy.
+  Tensor own_chunk = chunk(rank);
+  Notification note;
+  Status status;
+  CollectiveRemoteAccessLocal::MemCpyAsync(
+      col_ctx_->op_ctx->input_device_context(0),
+      col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+      col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+      col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input, &own_chunk,
+      0 /*dev_to_dev_stream_index*/, [&note, &status](const Status& s) {
+        status.Update(s);
+        note.Notify();
+      });
+  note.WaitForNotification();
+  TF_RETURN_IF_ERROR(status);
+  if (chunk_elts == 0) return Status::OK();
+
+  // At each step pass on the chunk received in the previous step, starting
+  // with this device's own chunk.
+  for (int step = 0; step < group_size - 1; ++step) {
+    Tensor send = chunk((rank - step + group_size) % group_size);
+    Tensor recv = chunk((rank - step - 1 + group_size) % group_size);
+    TF_RETURN_IF_ERROR(Step(step, &send, &recv));
+  }
+  return Status::OK();
+}
+
+Status RingGatherer::Step(int step, const Tensor* send, Tensor* recv) {
+  const int group_size = col_params_->group.group_size;
+  const int rank = col_params_->default_rank;
+  const int send_to_rank = (rank + 1) % group_size;
+  const int recv_from_rank = (rank + group_size - 1) % group_size;
+  BlockingCounter pending(2);
+  auto done = [this, &pending](const Status& s) {
+    if (!s.ok()) {
+      StartAbort(s);
+    }
+    pending.DecrementCount();
+  };
+  col_ctx_->col_exec->PostToPeer(
+      col_params_->instance.device_names[send_to_rank],
+      col_params_->instance.task_names[send_to_rank],
+      RingGatherBufKey(col_ctx_->exec_key, step, rank), col_ctx_->device,
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), send,
+      col_ctx_->device_locality, done);
+  col_ctx_->col_exec->RecvFromPeer(
+      col_params_->instance.device_names[recv_from_rank],
+      col_params_->instance.task_names[recv_from_rank],
+      col_params_->task.is_local[recv_from_rank],
+      RingGatherBufKey(col_ctx_->exec_key, step, recv_from_rank),
+      col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), recv, col_ctx_->device_locality,
+      0 /*dev_to_dev_stream_index*/, done);
+  pending.Wait();
+  mutex_lock l(status_mu_);
+  return status_;
+}
+
+void RingGatherer::StartAbort(const Status& s) {
+  // If this is the initial entry to abort mode then invoke StartAbort
+  // on the CollectiveExecutor that invoked us.  That should start
+  // cancellation on all of the outstanding CollectiveRemoteAccess
+  // actions.
+  bool abort_started = false;
+  {
+    mutex_lock l(status_mu_);
+    if (status_.ok()) {
+      LOG(ERROR) << "Aborting RingGather with " << s;
+      abort_started = true;
+      status_.Update(s);
+    }
+  }
+  if (abort_started) {
+    col_ctx_->col_exec->StartAbort(s);
+  }
+}
+
+REGISTER_COLLECTIVE(RingGather, RingGatherer);
+
+}  // namespace tensorflow
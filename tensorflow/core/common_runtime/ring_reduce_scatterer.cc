@@ -0,0 +1,231 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/ring_reduce_scatterer.h"
+
+#include <memory>
+#include <utility>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace {
+// Each CollectiveOp implementation is free to define its own
+// BufRendezvous key format.  This function produces the key used by
+// RingReduceScatterer.
+string RingReduceScatterBufKey(const string& exec_key, int step,
+                               int source_rank) {
+  return strings::StrCat(exec_key, ":rscatter:", step, ":", source_rank);
+}
+
+}  // namespace
+
+RingReduceScatterer::RingReduceScatterer()
+    : col_ctx_(nullptr), col_params_(nullptr) {}
+
+Status RingReduceScatterer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  CHECK_EQ(col_params->instance.type, REDUCE_SCATTER_COLLECTIVE);
+  CHECK_EQ(col_params->instance.impl_details.collective_name,
+           "RingReduceScatter");
+  return Status::OK();
+}
+
+Status RingReduceScatterer::InitializeCollectiveContext(
+    CollectiveContext* col_ctx) {
+  CHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = &col_ctx->col_params;
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+void RingReduceScatterer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  Status s = RunRing();
+  done(s);
+}
+
+Status RingReduceScatterer::RunRing() {
+  const int group_size = col_params_->group.group_size;
+  const int rank = col_params_->default_rank;
+  const int64 chunk_elts = col_ctx_->output->NumElements();
+  const DataType dtype = col_ctx_->output->dtype();
+  if (col_ctx_->input->NumElements() != chunk_elts * group_size) {
+    return errors::Internal("RingReduceScatterer input has ",
+                            col_ctx_->input->NumElements(),
+                            " elements, expected ", chunk_elts * group_size);
+  }
+  VLOG(1) << "RingReduceScatterer::Run for device " << col_ctx_->device_name
+          << " rank " << rank << " chunk_elts " << chunk_elts;
+  if (chunk_elts == 0) return Status::OK();
+
+  // The merge_op needs aligned chunks, so copy the input into a working
+  // buffer in which every chunk starts at an aligned offset.
+  const int64 chunk_stride =
+      CollectiveAdapter::AlignedChunkElts(DataTypeSize(dtype), chunk_elts, 1);
+  Allocator* allocator =
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0));
+  Tensor work(allocator, dtype, TensorShape({chunk_stride * group_size}));
+  Tensor tmp(allocator, dtype, TensorShape({chunk_elts}));
+  auto chunk = [&work, chunk_stride, chunk_elts](int i) {
+    return work.Slice(i * chunk_stride, i * chunk_stride + chunk_elts);
+  };
+  Tensor input;
+  CHECK(input.CopyFrom(*col_ctx_->input,
+                       TensorShape({chunk_elts * group_size})));
+  for (int i = 0; i < group_size; ++i) {
+    const Tensor input_chunk =
+        input.Slice(i * chunk_elts, (i + 1) * chunk_elts);
+    Tensor work_chunk = chunk(i);
+    TF_RETURN_IF_ERROR(Copy(&input_chunk, &work_chunk));
+  }
+
+  // Chunk c starts at rank c + 1 and accumulates one more device's value at
+  // each step, until it arrives complete at rank c.
+  for (int step = 0; step < group_size - 1; ++step) {
+    Tensor send = chunk((rank - step - 1 + 2 * group_size) % group_size);
+    Tensor merged = chunk((rank - step - 2 + 2 * group_size) % group_size);
+    TF_RETURN_IF_ERROR(Step(step, &send, &tmp));
+    Status s = collective_util::ComputeBinOp(
+        col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+        col_params_->merge_op.get(), &merged, &tmp);
+    if (!s.ok()) return StartAbort(s);
+  }
+  Tensor result = chunk(rank);
+  TF_RETURN_IF_ERROR(Finalize(&result));
+
+  Tensor output;
+  CHECK(output.CopyFrom(*col_ctx_->output, TensorShape({chunk_elts})));
+  return Copy(&result, &output);
+}
+
+Status RingReduceScatterer::Copy(const Tensor* src, Tensor* dst) {
+  // We are running in a blockable thread and the callback can't block so
+  // just wait here on the copy.
+  Notification note;
+  Status status;
+  CollectiveRemoteAccessLocal::MemCpyAsync(
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+      col_ctx_->device, col_ctx_->op_ctx->output_alloc_attr(0),
+      col_ctx_->op_ctx->output_alloc_attr(0), src, dst,
+      0 /*dev_to_dev_stream_index*/, [&note, &status](const Status& s) {
+        status.Update(s);
+        note.Notify();
+      });
+  note.WaitForNotification();
+  return status;
+}
+
+Status RingReduceScatterer::Step(int step, const Tensor* send, Tensor* recv) {
+  const int group_size = col_params_->group.group_size;
+  const int rank = col_params_->default_rank;
+  const int send_to_rank = (rank + 1) % group_size;
+  const int recv_from_rank = (rank + group_size - 1) % group_size;
+  BlockingCounter pending(2);
+  auto done = [this, &pending](const Status& s) {
+    if (!s.ok()) {
+      StartAbort(s);
+    }
+    pending.DecrementCount();
+  };
+  col_ctx_->col_exec->PostToPeer(
+      col_params_->instance.device_names[send_to_rank],
+      col_params_->instance.task_names[send_to_rank],
+      RingReduceScatterBufKey(col_ctx_->exec_key, step, rank),
+      col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), send,
+      col_ctx_->device_locality, done);
+  col_ctx_->col_exec->RecvFromPeer(
+      col_params_->instance.device_names[recv_from_rank],
+      col_params_->instance.task_names[recv_from_rank],
+      col_params_->task.is_local[recv_from_rank],
+      RingReduceScatterBufKey(col_ctx_->exec_key, step, recv_from_rank),
+      col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), recv, col_ctx_->device_locality,
+      0 /*dev_to_dev_stream_index*/, done);
+  pending.Wait();
+  mutex_lock l(status_mu_);
+  return status_;
+}
+
+Status RingReduceScatterer::Finalize(Tensor* value) {
+  if (!col_params_->final_op) return Status::OK();
+  // The adapter is only used to make a scalar of the right type.
+  Tensor value_alias = *value;
+  std::unique_ptr<CollectiveAdapter> ca(
+      MakeCollectiveAdapter(&value_alias, 1, nullptr /*allocator*/));
+  Tensor group_size = ca->Scalar(col_params_->group.group_size);
+  if (col_params_->group.device_type != "CPU") {
+    Tensor group_size_on_device = ca->Scalar(col_ctx_->device->GetAllocator(
+        col_ctx_->op_ctx->input_alloc_attr(0)));
+    Notification note;
+    Status status;
+    col_ctx_->op_ctx->op_device_context()->CopyCPUTensorToDevice(
+        &group_size, col_ctx_->device, &group_size_on_device,
+        [&note, &status](const Status& s) {
+          status = s;
+          note.Notify();
+        });
+    note.WaitForNotification();
+    if (!status.ok()) return StartAbort(status);
+    group_size = group_size_on_device;
+  }
+  Status s = collective_util::ComputeBinOp(
+      col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+      col_params_->final_op.get(), value, &group_size);
+  return s.ok() ? s : StartAbort(s);
+}
+
+Status RingReduceScatterer::StartAbort(const Status& s) {
+  // If this is the initial entry to abort mode then invoke StartAbort
+  // on the CollectiveExecutor that invoked us.  That should start
+  // cancellation on all of the outstanding CollectiveRemoteAccess
+  // actions.
+  bool abort_started = false;
+  Status first_status;
+  {
+    mutex_lock l(status_mu_);
+    if (status_.ok()) {
+      LOG(ERROR) << "Aborting RingReduceScatter with " << s;
+      abort_started = true;
+      status_.Update(s);
+    }
+    first_status = status_;
+  }
+  if (abort_started) {
+    col_ctx_->col_exec->StartAbort(s);
+  }
+  return first_status;
+}
+
+REGISTER_COLLECTIVE(RingReduceScatter, RingReduceScatterer);
+
+}  // namespace tensorflow
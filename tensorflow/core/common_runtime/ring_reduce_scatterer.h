@@ -0,0 +1,70 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_RING_REDUCE_SCATTERER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_RING_REDUCE_SCATTERER_H_
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+
+namespace tensorflow {
+class Device;
+
+// Ring-algorithm implementation of collective reduce-scatter.
+//
+// Each input is split into group_size equal chunks, and the device with
+// rank i outputs the reduction of chunk i over all devices.  This is the
+// first pass of RingReducer: in each of group_size - 1 steps every device
+// merges the partial reduction received from the previous device in the
+// ring into its own value of that chunk, and passes it on.
+class RingReduceScatterer : public CollectiveImplementationInterface {
+ public:
+  RingReduceScatterer();
+  ~RingReduceScatterer() override {}
+
+  // No subdivision permutations are needed, so this only checks that
+  // col_params describes a reduce-scatter.
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object.
+  Status InitializeCollectiveContext(CollectiveContext* col_ctx) override;
+
+  // Begins execution of the ring reduce-scatter algorithm.
+  // Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+ private:
+  Status RunRing();
+  // Copies "src" to "dst" on this device, blocking until done.
+  Status Copy(const Tensor* src, Tensor* dst);
+  // Sends "send" to the next device in the ring while receiving "recv"
+  // from the previous one.
+  Status Step(int step, const Tensor* send, Tensor* recv);
+  Status Finalize(Tensor* value);
+  // Called when a bad status is received that implies we should terminate
+  // execution and return a bad status.  Returns the first such status.
+  Status StartAbort(const Status& s);
+
+  CollectiveContext* col_ctx_;          // Not owned
+  const CollectiveParams* col_params_;  // Not owned
+  mutex status_mu_;
+  Status status_ GUARDED_BY(status_mu_);
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_RING_REDUCE_SCATTERER_H_
@@ -0,0 +1,959 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_plan_executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+#include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/log_memory.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/tensor_slice_reader_cache.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace {
+
+// 0-element tensor fed to transfer nodes whose input is dead.
+static const Tensor* const kEmptyTensor = new Tensor;
+
+typedef gtl::InlinedVector<TensorValue, 4> TensorValueVec;
+typedef gtl::InlinedVector<DeviceContext*, 4> DeviceContextVec;
+typedef gtl::InlinedVector<AllocatorAttributes, 4> AllocatorAttributeVec;
+
+// Static information about one node, computed once by Initialize().
+struct PlanNode {
+  const Node* node = nullptr;
+  OpKernel* kernel = nullptr;
+  bool kernel_is_async = false;
+  bool kernel_is_expensive = false;
+  bool is_transfer = false;
+  bool is_control_trigger = false;
+  bool is_initialization_op = false;
+
+  int num_inputs = 0;
+  int num_outputs = 0;
+
+  // Index of the slot holding input 0 of this node in StepState::slots.
+  int input_start = 0;
+
+  // Ids of all nodes this node has an in-edge (data or control) from.
+  std::vector<int> in_nodes;
+
+  // Ids of all nodes this node has an out-edge (data or control) to, one
+  // entry per edge, matching the entries of their 'in_nodes'.
+  std::vector<int> out_nodes;
+
+  // For each data out-edge: the output produced and the slot it goes to.
+  // Edges of the same output are adjacent, so the last one can take the
+  // tensor by move.
+  struct OutEdge {
+    int output;
+    int dst_slot;
+    bool is_last;
+  };
+  std::vector<OutEdge> out_edges;
+
+  std::vector<AllocatorAttributes> output_attrs;
+};
+
+// One input of a node. Either a tensor (pass-by-value) or a pointer to a
+// tensor guarded by a mutex (pass-by-reference).
+struct Slot {
+  Tensor val;
+  Tensor* ref = nullptr;
+  mutex* ref_mu = nullptr;
+  AllocatorAttributes alloc_attr;
+  DeviceContext* device_context = nullptr;
+
+  void Clear() {
+    val = Tensor();
+    ref = nullptr;
+    ref_mu = nullptr;
+  }
+};
+
+// FIFO of the ids of the nodes that are ready to run on one thread, stored in
+// a ring buffer. A node is pushed at most once per step, so the ring never
+// holds more than all the nodes of the graph. The ring only grows when it is
+// full and keeps its storage when drained, and queues are recycled with their
+// step, so steps after the first do not allocate when pushing nodes.
+class ReadyQueue {
+ public:
+  explicit ReadyQueue(int max_size)
+      : max_size_(std::max(max_size, 1)),
+        ids_(std::min(max_size_, kInitialCapacity)) {}
+
+  bool empty() const { return size_ == 0; }
+
+  void push_back(int id) {
+    if (size_ == ids_.size()) Grow();
+    size_t tail = head_ + size_;
+    if (tail >= ids_.size()) tail -= ids_.size();
+    ids_[tail] = id;
+    ++size_;
+  }
+
+  int pop_front() {
+    DCHECK_GT(size_, 0);
+    const int id = ids_[head_];
+    if (++head_ == ids_.size()) head_ = 0;
+    --size_;
+    return id;
+  }
+
+ private:
+  static constexpr size_t kInitialCapacity = 64;
+
+  void Grow() {
+    CHECK_LT(ids_.size(), max_size_);
+    std::vector<int> ids(std::min(2 * ids_.size(), max_size_));
+    for (size_t i = 0; i < size_; ++i) {
+      ids[i] = at(i);
+    }
+    ids_.swap(ids);
+    head_ = 0;
+  }
+
+  // Returns the i-th oldest id of the queue.
+  int at(size_t i) const {
+    size_t pos = head_ + i;
+    if (pos >= ids_.size()) pos -= ids_.size();
+    return ids_[pos];
+  }
+
+  const size_t max_size_;
+  std::vector<int> ids_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ReadyQueue);
+};
+
+class StaticPlanExecutor : public Executor {
+ public:
+  StaticPlanExecutor(const LocalExecutorParams& p,
+                     std::unique_ptr<const Graph> g)
+      : params_(p), graph_(std::move(g)) {
+    CHECK(p.create_kernel != nullptr);
+    CHECK(p.delete_kernel != nullptr);
+  }
+
+  ~StaticPlanExecutor() override {
+    for (PlanNode& n : nodes_) {
+      if (n.kernel != nullptr) params_.delete_kernel(n.kernel);
+    }
+    for (StepState* step : free_steps_) {
+      delete step;
+    }
+  }
+
+  // Computes the plan. The graph must pass ValidateStaticPlanGraph().
+  Status Initialize();
+
+  void RunAsync(const Args& args, DoneCallback done) override;
+
+ private:
+  // Per-step state. Allocated once and recycled across steps.
+  struct StepState {
+    explicit StepState(int num_slots, int num_nodes)
+        : slots(num_slots),
+          is_dead(num_nodes),
+          pending_counts(new std::atomic<int>[num_nodes]) {}
+
+    ~StepState() {
+      if (step_arena != nullptr) step_arena->Unref();
+    }
+
+    std::vector<Slot> slots;
+    // is_dead[id] is set iff node id produced dead outputs in this step.
+    // One byte per node, since independent nodes set theirs concurrently.
+    std::vector<uint8> is_dead;
+    // pending_counts[id] is the number of in-edges of node id whose source
+    // has not finished in this step. Reset from
+    // StaticPlanExecutor::initial_pending_counts_ at the start of a step.
+    std::unique_ptr<std::atomic<int>[]> pending_counts;
+
+    Args args;
+    DoneCallback done;
+    DeviceContextMap device_context_map;
+    checkpoint::TensorSliceReaderCacheWrapper slice_reader_cache;
+    // Serves the temporaries of the kernels of the step, if not nullptr.
+    // Recycled along with the StepState, so it keeps its size.
+    StepArenaAllocator* step_arena = nullptr;
+
+    // Number of nodes that are ready or running. The step is done when it
+    // drops to zero.
+    std::atomic<int> num_outstanding{0};
+    std::atomic<bool> aborted{false};
+
+    mutex mu;
+    Status status GUARDED_BY(mu);
+
+    // Ready queues of the threads that are done running nodes of the step.
+    mutex ready_queues_mu;
+    std::vector<std::unique_ptr<ReadyQueue>> free_ready_queues
+        GUARDED_BY(ready_queues_mu);
+  };
+
+  StepState* AllocateStep();
+  void ReleaseStep(StepState* step);
+
+  // Returns an empty ready queue of 'step', reusing one released by an
+  // earlier Process() if possible.
+  ReadyQueue* AcquireReadyQueue(StepState* step);
+
+  // Runs the nodes of 'inline_ready', and the nodes they make ready that
+  // are not handed to other threads, until 'inline_ready' is empty. Then
+  // releases 'inline_ready', which must come from AcquireReadyQueue(step).
+  void Process(StepState* step, ReadyQueue* inline_ready);
+
+  // Runs Process() for node 'id' on another thread.
+  void ProcessOnRunner(StepState* step, int id);
+
+  // Runs node 'id' in 'step'. Returns true iff the node finished
+  // synchronously and was the last outstanding node of the step.
+  bool RunNode(StepState* step, int id, ReadyQueue* inline_ready);
+
+  // Called after node 'id' has computed (or was skipped). Forwards outputs
+  // to the consumer slots, records errors and stats, and schedules the
+  // consumers that became ready: inexpensive ones on 'inline_ready' if it
+  // is non-null, all others on the runner. Returns true iff this was the
+  // last outstanding node of the step.
+  bool NodeDone(StepState* step, int id, const Status& s, OpKernelContext* ctx,
+                NodeExecStatsWrapper* stats, ReadyQueue* inline_ready);
+
+  void ScheduleReady(StepState* step, const gtl::InlinedVector<int, 8>& ready,
+                     ReadyQueue* inline_ready);
+
+  Status PrepareInputs(StepState* step, const PlanNode& item, bool is_dead,
+                       TensorValueVec* inputs,
+                       DeviceContextVec* input_device_contexts,
+                       AllocatorAttributeVec* input_alloc_attrs,
+                       gtl::InlinedVector<Tensor, 4>* derefs,
+                       bool* is_input_dead);
+
+  Status ProcessOutputs(StepState* step, const PlanNode& item,
+                        OpKernelContext* ctx, NodeExecStatsWrapper* stats);
+
+  void Finish(StepState* step);
+
+  // State kept alive while an asynchronous kernel runs.
+  struct AsyncState;
+
+  LocalExecutorParams params_;
+  std::unique_ptr<const Graph> graph_;
+
+  // Indexed by node id.
+  std::vector<PlanNode> nodes_;
+  int num_slots_ = 0;
+
+  // Number of in-edges of every node, indexed by node id.
+  std::vector<int> initial_pending_counts_;
+  // Ids of the nodes without in-edges.
+  gtl::InlinedVector<int, 8> root_nodes_;
+
+  mutex free_steps_mu_;
+  std::vector<StepState*> free_steps_ GUARDED_BY(free_steps_mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StaticPlanExecutor);
+};
+
+struct StaticPlanExecutor::AsyncState {
+  AsyncState(const OpKernelContext::Params& p, const TensorValueVec& in,
+             const DeviceContextVec& in_contexts,
+             const AllocatorAttributeVec& in_attrs,
+             const gtl::InlinedVector<Tensor, 4>& in_derefs, int num_outputs)
+      : inputs(in),
+        input_device_contexts(in_contexts),
+        input_alloc_attrs(in_attrs),
+        derefs(in_derefs),
+        params(p),
+        ctx(ParamsWithSavedInputs(&params), num_outputs) {
+    // Inputs that were dereferenced into 'in_derefs' must point into the
+    // copy owned by this state.
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      if (i < in_derefs.size() && inputs[i].tensor == &in_derefs[i]) {
+        inputs[i].tensor = &derefs[i];
+      }
+    }
+  }
+
+  TensorValueVec inputs;
+  DeviceContextVec input_device_contexts;
+  AllocatorAttributeVec input_alloc_attrs;
+  gtl::InlinedVector<Tensor, 4> derefs;
+  OpKernelContext::Params params;
+  OpKernelContext ctx;
+
+ private:
+  OpKernelContext::Params* ParamsWithSavedInputs(OpKernelContext::Params* p) {
+    p->inputs = &inputs;
+    p->input_device_contexts = &input_device_contexts;
+    p->input_alloc_attrs = &input_alloc_attrs;
+    // Ensure OpKernelContext constructor will make a new eigen GPU device if
+    // necessary.
+    p->eigen_gpu_device = nullptr;
+    return p;
+  }
+};
+
+Status StaticPlanExecutor::Initialize() {
+  if (params_.device->RequiresRecordingAccessedTensors()) {
+    return errors::Unimplemented(
+        "The static plan executor does not support devices that record "
+        "accessed tensors: ",
+        params_.device->name());
+  }
+
+  const int num_ids = graph_->num_node_ids();
+  nodes_.resize(num_ids);
+
+  // Assign input slots and create the kernels.
+  for (const Node* n : graph_->nodes()) {
+    PlanNode* item = &nodes_[n->id()];
+    item->node = n;
+    item->num_inputs = n->num_inputs();
+    item->num_outputs = n->num_outputs();
+    item->input_start = num_slots_;
+    num_slots_ += n->num_inputs();
+
+    Status s = params_.create_kernel(n->def(), &item->kernel);
+    if (!s.ok()) {
+      item->kernel = nullptr;
+      s = AttachDef(s, *n);
+      LOG(ERROR) << "Executor failed to create kernel. " << s;
+      return s;
+    }
+    item->kernel_is_async = (item->kernel->AsAsync() != nullptr);
+    item->kernel_is_expensive = item->kernel->IsExpensive();
+    item->is_transfer = IsTransferNode(n);
+    item->is_control_trigger = IsControlTrigger(n);
+    item->is_initialization_op = n->op_def().allows_uninitialized_input();
+  }
+
+  // Wire the edges and infer output allocation attributes.
+  const DeviceNameUtils::ParsedName& local_dev_name =
+      params_.device->parsed_name();
+  for (const Node* n : graph_->nodes()) {
+    PlanNode* item = &nodes_[n->id()];
+    item->output_attrs.resize(item->num_outputs);
+    for (const Edge* e : n->in_edges()) {
+      item->in_nodes.push_back(e->src()->id());
+    }
+    for (const Edge* e : n->out_edges()) {
+      item->out_nodes.push_back(e->dst()->id());
+    }
+    std::vector<PlanNode::OutEdge> out_edges;
+    for (const Edge* e : n->out_edges()) {
+      if (e->IsControlEdge()) continue;
+      const PlanNode& dst = nodes_[e->dst()->id()];
+      out_edges.push_back(
+          {e->src_output(), dst.input_start + e->dst_input(), false});
+      AllocatorAttributes attr;
+      TF_RETURN_IF_ERROR(InferAllocAttr(n, e->dst(), local_dev_name, &attr));
+      if (attr.value != 0) {
+        item->output_attrs[e->src_output()].Merge(attr);
+      }
+    }
+    std::stable_sort(out_edges.begin(), out_edges.end(),
+                     [](const PlanNode::OutEdge& a,
+                        const PlanNode::OutEdge& b) {
+                       return a.output < b.output;
+                     });
+    for (size_t i = 0; i < out_edges.size(); ++i) {
+      out_edges[i].is_last = (i + 1 == out_edges.size() ||
+                              out_edges[i + 1].output != out_edges[i].output);
+    }
+    item->out_edges = std::move(out_edges);
+    for (int out = 0; out < item->num_outputs; ++out) {
+      if (item->kernel->output_memory_types()[out] == HOST_MEMORY) {
+        AllocatorAttributes h;
+        h.set_on_host(true);
+        item->output_attrs[out].Merge(h);
+      }
+    }
+  }
+
+  // Nodes run as soon as all of their producers are done, like in the
+  // default executor, so that a Recv waiting for a peer partition only
+  // holds up its own consumers.
+  initial_pending_counts_.resize(num_ids, 0);
+  for (const Node* n : graph_->nodes()) {
+    const int num_in_nodes = static_cast<int>(nodes_[n->id()].in_nodes.size());
+    initial_pending_counts_[n->id()] = num_in_nodes;
+    if (num_in_nodes == 0) root_nodes_.push_back(n->id());
+  }
+  return Status::OK();
+}
+
+StaticPlanExecutor::StepState* StaticPlanExecutor::AllocateStep() {
+  {
+    mutex_lock l(free_steps_mu_);
+    if (!free_steps_.empty()) {
+      StepState* step = free_steps_.back();
+      free_steps_.pop_back();
+      return step;
+    }
+  }
+  StepState* step = new StepState(num_slots_, static_cast<int>(nodes_.size()));
+  // Only host memory can be handed out of an arena, and only the CPU device
+  // serves allocate_temp() from host memory.
+  if (params_.use_step_temp_arena &&
+      params_.device->attributes().device_type() == DEVICE_CPU) {
+    // The arena grows to the peak usage of the step after the first one.
+    static constexpr size_t kMinStepArenaBlockBytes = 1 << 20;
+    step->step_arena = new StepArenaAllocator(
+        params_.device->GetAllocator(AllocatorAttributes()),
+        kMinStepArenaBlockBytes);
+  }
+  return step;
+}
+
+void StaticPlanExecutor::ReleaseStep(StepState* step) {
+  // Slots are normally cleared by their consumer, but an aborted step may
+  // leave values behind.
+  if (step->aborted) {
+    for (Slot& slot : step->slots) {
+      slot.Clear();
+    }
+  }
+  std::fill(step->is_dead.begin(), step->is_dead.end(), 0);
+  for (DeviceContext* dc : step->device_context_map) {
+    if (dc != nullptr) dc->Unref();
+  }
+  step->device_context_map.clear();
+  // All kernels of the step have completed, so the arena only holds the
+  // temporaries that outlive the step.
+  if (step->step_arena != nullptr) step->step_arena->EndStep();
+  step->args = Args();
+  step->done = nullptr;
+  step->aborted = false;
+  {
+    mutex_lock l(step->mu);
+    step->status = Status::OK();
+  }
+  mutex_lock l(free_steps_mu_);
+  free_steps_.push_back(step);
+}
+
+void StaticPlanExecutor::RunAsync(const Args& args, DoneCallback done) {
+  StepState* step = AllocateStep();
+  const Status fill_status = params_.device->FillContextMap(
+      graph_.get(), &step->device_context_map);
+  if (!fill_status.ok()) {
+    ReleaseStep(step);
+    done(fill_status);
+    return;
+  }
+  step->args = args;
+  step->done = std::move(done);
+  for (size_t id = 0; id < nodes_.size(); ++id) {
+    step->pending_counts[id].store(initial_pending_counts_[id],
+                                   std::memory_order_relaxed);
+  }
+  step->num_outstanding.store(static_cast<int>(root_nodes_.size()));
+  ReadyQueue* inline_ready = AcquireReadyQueue(step);
+  ScheduleReady(step, root_nodes_, inline_ready);
+  Process(step, inline_ready);
+}
+
+ReadyQueue* StaticPlanExecutor::AcquireReadyQueue(StepState* step) {
+  {
+    mutex_lock l(step->ready_queues_mu);
+    if (!step->free_ready_queues.empty()) {
+      ReadyQueue* queue = step->free_ready_queues.back().release();
+      step->free_ready_queues.pop_back();
+      return queue;
+    }
+  }
+  return new ReadyQueue(static_cast<int>(nodes_.size()));
+}
+
+void StaticPlanExecutor::Process(StepState* step, ReadyQueue* inline_ready) {
+  bool step_done = false;
+  while (!inline_ready->empty() && !step_done) {
+    step_done = RunNode(step, inline_ready->pop_front(), inline_ready);
+  }
+  // The queue is empty: a node that is still queued would be outstanding.
+  // Give it back before Finish() recycles the step.
+  {
+    mutex_lock l(step->ready_queues_mu);
+    step->free_ready_queues.emplace_back(inline_ready);
+  }
+  if (step_done) Finish(step);
+}
+
+void StaticPlanExecutor::ProcessOnRunner(StepState* step, int id) {
+  step->args.runner([this, step, id]() {
+    ReadyQueue* inline_ready = AcquireReadyQueue(step);
+    inline_ready->push_back(id);
+    Process(step, inline_ready);
+  });
+}
+
+void StaticPlanExecutor::ScheduleReady(StepState* step,
+                                       const gtl::InlinedVector<int, 8>& ready,
+                                       ReadyQueue* inline_ready) {
+  if (ready.empty()) return;
+  if (inline_ready == nullptr) {
+    // Not on an executor thread, e.g. in the callback of an asynchronous
+    // kernel: hand everything to the runner.
+    for (int id : ready) {
+      ProcessOnRunner(step, id);
+    }
+    return;
+  }
+  // Run inexpensive nodes on this thread, and all but possibly one of the
+  // expensive nodes on other threads.
+  int curr_expensive_node = -1;
+  for (int id : ready) {
+    const PlanNode& item = nodes_[id];
+    if (!item.kernel_is_expensive || item.kernel_is_async) {
+      inline_ready->push_back(id);
+    } else {
+      if (curr_expensive_node >= 0) {
+        ProcessOnRunner(step, curr_expensive_node);
+      }
+      curr_expensive_node = id;
+    }
+  }
+  if (curr_expensive_node >= 0) {
+    if (inline_ready->empty()) {
+      inline_ready->push_back(curr_expensive_node);
+    } else {
+      ProcessOnRunner(step, curr_expensive_node);
+    }
+  }
+}
+
+bool StaticPlanExecutor::RunNode(StepState* step, int id,
+                                 ReadyQueue* inline_ready) {
+  const PlanNode& item = nodes_[id];
+  const Node* node = item.node;
+  Device* device = params_.device;
+  const Args& args = step->args;
+
+  NodeExecStatsWrapper* stats = nullptr;
+  if (args.stats_collector) {
+    stats = new NodeExecStatsWrapper(node->name());
+    stats->SetScheduled(Env::Default()->NowNanos());
+    stats->RecordExecutorStarted();
+  }
+
+  // A node is dead iff one of its producers is, unless it is a
+  // ControlTrigger. There are no Merge nodes in a static plan.
+  bool is_dead = false;
+  if (!item.is_control_trigger) {
+    for (int src : item.in_nodes) {
+      if (step->is_dead[src]) {
+        is_dead = true;
+        break;
+      }
+    }
+  }
+  if (is_dead && !item.is_transfer) {
+    for (int i = 0; i < item.num_inputs; ++i) {
+      step->slots[item.input_start + i].Clear();
+    }
+    step->is_dead[id] = 1;
+    return NodeDone(step, id, Status::OK(), nullptr, stats, inline_ready);
+  }
+
+  TensorValueVec inputs;
+  DeviceContextVec input_device_contexts;
+  AllocatorAttributeVec input_alloc_attrs;
+  gtl::InlinedVector<Tensor, 4> derefs;
+  bool is_input_dead = false;
+  Status s = PrepareInputs(step, item, is_dead, &inputs, &input_device_contexts,
+                           &input_alloc_attrs, &derefs, &is_input_dead);
+  if (!s.ok()) {
+    for (int i = 0; i < item.num_inputs; ++i) {
+      step->slots[item.input_start + i].Clear();
+    }
+    return NodeDone(step, id, AttachDef(s, *node), nullptr, stats,
+                    inline_ready);
+  }
+
+  OpKernelContext::Params params;
+  params.step_id = args.step_id;
+  params.device = device;
+  params.log_memory = LogMemory::IsEnabled();
+  params.rendezvous = args.rendezvous;
+  params.collective_executor = args.collective_executor;
+  params.session_state = args.session_state;
+  params.tensor_store = args.tensor_store;
+  params.cancellation_manager = args.cancellation_manager;
+  params.call_frame = args.call_frame;
+  params.function_library = params_.function_library;
+  params.resource_manager = device->resource_manager();
+  params.step_container = args.step_container;
+  params.slice_reader_cache = &step->slice_reader_cache;
+  params.step_temp_allocator = step->step_arena;
+  params.inputs = &inputs;
+  params.input_device_contexts = &input_device_contexts;
+  params.input_alloc_attrs = &input_alloc_attrs;
+  params.runner = &step->args.runner;
+  params.stats_collector = args.stats_collector;
+  params.track_allocations = (stats != nullptr);
+  params.op_kernel = item.kernel;
+  params.frame_iter = FrameAndIter(0, 0);
+  params.is_input_dead = is_input_dead;
+  params.output_attr_array = item.output_attrs.data();
+  if (id < step->device_context_map.size()) {
+    params.op_device_context = step->device_context_map[id];
+  }
+
+  if (item.kernel_is_async) {
+    AsyncState* state =
+        new AsyncState(params, inputs, input_device_contexts,
+                       input_alloc_attrs, derefs, item.num_outputs);
+    auto done = [this, step, state, stats, id]() {
+      if (stats) stats->RecordComputeEnded();
+      const bool step_done =
+          NodeDone(step, id, Status::OK(), &state->ctx, stats, nullptr);
+      delete state;
+      if (step_done) Finish(step);
+    };
+    if (stats) stats->RecordComputeStarted();
+    device->ComputeAsync(item.kernel->AsAsync(), &state->ctx, done);
+    return false;
+  }
+
+  OpKernelContext ctx(&params, item.num_outputs);
+  ShardingContext sharding;
+  sharding.label = &item.kernel->type_string();
+  if (stats) stats->RecordComputeStarted();
+  {
+    ScopedShardingContext scoped_sharding(
+        stats != nullptr || AdaptiveShardingEnabled() ? &sharding : nullptr);
+    device->Compute(CHECK_NOTNULL(item.kernel), &ctx);
+  }
+  if (stats) {
+    stats->RecordComputeEnded();
+    stats->SetSharding(sharding);
+  }
+  return NodeDone(step, id, Status::OK(), &ctx, stats, inline_ready);
+}
+
+Status StaticPlanExecutor::PrepareInputs(
+    StepState* step, const PlanNode& item, bool is_dead, TensorValueVec* inputs,
+    DeviceContextVec* input_device_contexts,
+    AllocatorAttributeVec* input_alloc_attrs,
+    gtl::InlinedVector<Tensor, 4>* derefs, bool* is_input_dead) {
+  inputs->resize(item.num_inputs);
+  input_device_contexts->resize(item.num_inputs);
+  input_alloc_attrs->resize(item.num_inputs);
+  derefs->resize(item.num_inputs);
+  *is_input_dead = is_dead;
+
+  for (int i = 0; i < item.num_inputs; ++i) {
+    Slot* slot = &step->slots[item.input_start + i];
+    (*input_device_contexts)[i] = slot->device_context;
+    (*input_alloc_attrs)[i] = slot->alloc_attr;
+    TensorValue* inp = &(*inputs)[i];
+    const bool expect_ref = IsRefType(item.kernel->input_type(i));
+
+    if (is_dead) {
+      // Only a transfer node runs with dead inputs, to propagate the dead
+      // bit to the other side.
+      (*derefs)[i] = *kEmptyTensor;
+      inp->tensor = &(*derefs)[i];
+      continue;
+    }
+    if (slot->ref == nullptr) {
+      if (expect_ref) {
+        return errors::InvalidArgument(i, "-th input expects a ref type");
+      }
+      inp->tensor = &slot->val;
+      continue;
+    }
+
+    {
+      mutex_lock ml(*slot->ref_mu);
+      if (!slot->ref->IsInitialized() && !item.is_initialization_op) {
+        return errors::FailedPrecondition(
+            "Attempting to use uninitialized value ",
+            item.kernel->requested_input(i));
+      }
+    }
+    if (expect_ref) {
+      inp->mutex_if_ref = slot->ref_mu;
+      inp->tensor = slot->ref;
+    } else {
+      // Automatically deref the tensor ref when the op expects a tensor but
+      // is given a ref to a tensor.
+      {
+        mutex_lock l(*slot->ref_mu);
+        (*derefs)[i] = *slot->ref;
+      }
+      inp->tensor = &(*derefs)[i];
+      if (item.kernel->input_type(i) != inp->tensor->dtype()) {
+        return errors::InvalidArgument(
+            i, "-th input expects type ",
+            DataTypeString(item.kernel->input_type(i)),
+            " but automatically dereferenced input tensor has type ",
+            DataTypeString(inp->tensor->dtype()));
+      }
+    }
+  }
+  return Status::OK();
+}
+
+Status StaticPlanExecutor::ProcessOutputs(StepState* step,
+                                          const PlanNode& item,
+                                          OpKernelContext* ctx,
+                                          NodeExecStatsWrapper* stats) {
+  const Node* node = item.node;
+  Status s = ctx->status();
+  if (!s.ok()) return AttachDef(s, *node);
+
+  DeviceContext* device_context = nullptr;
+  if (node->id() < step->device_context_map.size()) {
+    device_context = step->device_context_map[node->id()];
+  }
+
+  // Fetch all outputs first, then distribute them over the consumer slots.
+  gtl::InlinedVector<TensorValue, 4> outputs(item.num_outputs);
+  for (int i = 0; i < item.num_outputs; ++i) {
+    const TensorValue val = ctx->release_output(i);
+    outputs[i] = val;
+    if (val.tensor == nullptr) {
+      if (IsRecv(node)) {
+        // A Recv leaves its output unset iff the value is dead. That is the
+        // only source of dead values in a graph without Switch nodes.
+        step->is_dead[node->id()] = 1;
+      } else {
+        s.Update(errors::Internal("Missing ", i, "-th output from ",
+                                  SummarizeNode(*node)));
+      }
+      continue;
+    }
+    DataType dtype;
+    if (val.is_ref()) {
+      mutex_lock ml(*val.mutex_if_ref);
+      dtype = MakeRefType(val->dtype());
+    } else {
+      dtype = val->dtype();
+    }
+    if (dtype != item.kernel->output_type(i)) {
+      s.Update(errors::Internal("Output ", i, " of type ",
+                                DataTypeString(dtype),
+                                " does not match declared output type ",
+                                DataTypeString(item.kernel->output_type(i)),
+                                " for node ", SummarizeNode(*node)));
+    } else if (stats && val.tensor->IsInitialized()) {
+      stats->SetOutput(i, val.tensor);
+    }
+  }
+
+  if (s.ok()) {
+    for (const PlanNode::OutEdge& e : item.out_edges) {
+      const TensorValue& val = outputs[e.output];
+      if (val.tensor == nullptr) continue;
+      Slot* slot = &step->slots[e.dst_slot];
+      slot->device_context = device_context;
+      slot->alloc_attr = ctx->output_alloc_attr(e.output);
+      if (val.is_ref()) {
+        slot->ref = val.tensor;
+        slot->ref_mu = val.mutex_if_ref;
+      } else if (e.is_last) {
+        slot->val = std::move(*val.tensor);
+      } else {
+        slot->val = *val.tensor;
+      }
+    }
+    if (LogMemory::IsEnabled()) {
+      for (int i = 0; i < item.num_outputs; ++i) {
+        const TensorValue& val = outputs[i];
+        if (val.tensor == nullptr || val.is_ref()) continue;
+        LogMemory::RecordTensorOutput(ctx->op_kernel().name(), ctx->step_id(),
+                                      i, *val.tensor);
+      }
+    }
+  }
+  for (const TensorValue& val : outputs) {
+    if (!val.is_ref()) delete val.tensor;
+  }
+  return s;
+}
+
+bool StaticPlanExecutor::NodeDone(StepState* step, int id, const Status& in_s,
+                                  OpKernelContext* ctx,
+                                  NodeExecStatsWrapper* stats,
+                                  ReadyQueue* inline_ready) {
+  const PlanNode& item = nodes_[id];
+  Status s = in_s;
+  if (s.ok() && ctx != nullptr) {
+    s = ProcessOutputs(step, item, ctx, stats);
+    if (stats) stats->SetMemory(ctx);
+  }
+  // The inputs are no longer needed.
+  for (int i = 0; i < item.num_inputs; ++i) {
+    step->slots[item.input_start + i].Clear();
+  }
+
+  if (stats) {
+    stats->RecordExecutorEnded();
+    if (!stats->SetTimelineLabel(item.node)) {
+      // Only record non-transfer nodes. Transfers ownership of 'stats'.
+      step->args.stats_collector->Save(params_.device->name(), stats);
+    } else {
+      delete stats;
+    }
+  }
+
+  if (!s.ok()) {
+    bool abort_run = false;
+    {
+      mutex_lock l(step->mu);
+      if (step->status.ok()) {
+        abort_run = true;
+        step->status = s;
+      }
+    }
+    if (abort_run) {
+      step->aborted = true;
+      if (step->args.rendezvous) step->args.rendezvous->StartAbort(s);
+      if (step->args.collective_executor) {
+        step->args.collective_executor->StartAbort(s);
+      }
+      if (step->args.cancellation_manager) {
+        step->args.cancellation_manager->StartCancel();
+      }
+    }
+  }
+  // Consumers of an aborted step are never run, so the step drains once
+  // the nodes already running are done.
+  gtl::InlinedVector<int, 8> ready;
+  if (!step->aborted) {
+    for (int dst : item.out_nodes) {
+      if (step->pending_counts[dst].fetch_sub(1) == 1) ready.push_back(dst);
+    }
+  }
+  // Count the newly ready nodes before any of them can finish.
+  const int delta = static_cast<int>(ready.size()) - 1;
+  const bool step_done =
+      delta != 0 && step->num_outstanding.fetch_add(delta) + delta == 0;
+  ScheduleReady(step, ready, inline_ready);
+  return step_done;
+}
+
+void StaticPlanExecutor::Finish(StepState* step) {
+  Status status;
+  {
+    mutex_lock l(step->mu);
+    status = step->status;
+  }
+  if (step->args.sync_on_finish && status.ok()) {
+    // Block until the device has finished all queued operations.
+    status = params_.device->Sync();
+  }
+  DoneCallback done = std::move(step->done);
+  Args::Runner runner = step->args.runner;
+  ReleaseStep(step);
+  runner([done, status]() { done(status); });
+}
+
+// Same as NewStaticPlanExecutor(), for a graph that has already passed
+// ValidateStaticPlanGraph().
+Status NewValidatedStaticPlanExecutor(const LocalExecutorParams& params,
+                                      std::unique_ptr<const Graph> graph,
+                                      Executor** executor) {
+  StaticPlanExecutor* impl = new StaticPlanExecutor(params, std::move(graph));
+  const Status s = impl->Initialize();
+  if (s.ok()) {
+    *executor = impl;
+  } else {
+    delete impl;
+  }
+  return s;
+}
+
+}  // namespace
+
+Status ValidateStaticPlanGraph(const Graph& graph) {
+  for (const Node* n : graph.nodes()) {
+    if (n->IsSwitch() || n->IsMerge() || n->IsEnter() || n->IsExit() ||
+        n->IsNextIteration()) {
+      return errors::InvalidArgument(
+          "Graphs with control flow cannot be run with a static plan: ",
+          n->name(), " is a ", n->type_string(), " node.");
+    }
+    if (n->IsScopedAllocator()) {
+      return errors::InvalidArgument(
+          "Graphs with scoped allocators cannot be run with a static plan: ",
+          n->name());
+    }
+  }
+  return Status::OK();
+}
+
+Status NewStaticPlanExecutor(const LocalExecutorParams& params,
+                             std::unique_ptr<const Graph> graph,
+                             Executor** executor) {
+  TF_RETURN_IF_ERROR(ValidateStaticPlanGraph(*graph));
+  return NewValidatedStaticPlanExecutor(params, std::move(graph), executor);
+}
+
+namespace {
+
+class StaticPlanExecutorRegistrar {
+ public:
+  StaticPlanExecutorRegistrar() {
+    ExecutorFactory::Register("STATIC_PLAN", new Factory);
+  }
+
+ private:
+  class Factory : public ExecutorFactory {
+    Status NewExecutor(const LocalExecutorParams& params,
+                       std::unique_ptr<const Graph> graph,
+                       std::unique_ptr<Executor>* out_executor) override {
+      Executor* ret = nullptr;
+      if (ValidateStaticPlanGraph(*graph).ok() &&
+          !params.device->RequiresRecordingAccessedTensors()) {
+        TF_RETURN_IF_ERROR(
+            NewValidatedStaticPlanExecutor(params, std::move(graph), &ret));
+      } else {
+        VLOG(1) << "Graph cannot be run with a static plan; falling back to "
+                   "the default executor.";
+        TF_RETURN_IF_ERROR(NewLocalExecutor(params, std::move(graph), &ret));
+      }
+      out_executor->reset(ret);
+      return Status::OK();
+    }
+  };
+};
+static StaticPlanExecutorRegistrar registrar;
+
+}  // namespace
+
+}  // namespace tensorflow
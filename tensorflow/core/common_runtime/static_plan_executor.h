@@ -0,0 +1,54 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_PLAN_EXECUTOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_PLAN_EXECUTOR_H_
+
+#include <memory>
+
+#include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+
+// Returns OK iff "graph" can be run by an executor created with
+// NewStaticPlanExecutor(). That is the case for feed-forward graphs: graphs
+// without control-flow primitives (Switch, Merge, Enter, Exit,
+// NextIteration) and without scoped allocators.
+Status ValidateStaticPlanGraph(const Graph& graph);
+
+// Creates an Executor that computes "graph" along a schedule computed once
+// at construction time.
+//
+// The in-degree of every node and the input slot of every edge are computed
+// once. A step copies the in-degrees into per-node pending counts and runs
+// each node as soon as all of its producers are done. Tensors are passed
+// through a flat array of input slots that is reused across steps, so the
+// executor does no per-node bookkeeping (frames, iterations, input/output
+// maps) beyond one atomic pending count per node.
+//
+// Returns an error if ValidateStaticPlanGraph(*graph) fails.
+//
+// The executor is also registered with the ExecutorFactory under the type
+// "STATIC_PLAN". That factory falls back to the default executor for
+// graphs that fail ValidateStaticPlanGraph().
+Status NewStaticPlanExecutor(const LocalExecutorParams& params,
+                             std::unique_ptr<const Graph> graph,
+                             Executor** executor);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STATIC_PLAN_EXECUTOR_H_
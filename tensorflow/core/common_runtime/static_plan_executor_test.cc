@@ -0,0 +1,364 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/static_plan_executor.h"
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/executor_factory.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+#define ALICE "/job:j/replica:0/task:0/cpu:0"
+#define BOB "/job:j/replica:0/task:0/device:GPU:0"
+
+const uint64 kIncarnation = 1;
+
+Tensor V(const float val) {
+  Tensor tensor(DT_FLOAT, TensorShape({}));
+  tensor.scalar<float>()() = val;
+  return tensor;
+}
+
+Tensor VB(const bool val) {
+  Tensor tensor(DT_BOOL, TensorShape({}));
+  tensor.scalar<bool>()() = val;
+  return tensor;
+}
+
+float V(const Tensor& tensor) {
+  CHECK_EQ(tensor.dtype(), DT_FLOAT);
+  CHECK(TensorShapeUtils::IsScalar(tensor.shape()));
+  return tensor.scalar<float>()();
+}
+
+Rendezvous::ParsedKey Key(const string& sender, const uint64 incarnation,
+                          const string& receiver, const string& name) {
+  Rendezvous::ParsedKey result;
+  TF_CHECK_OK(
+      Rendezvous::ParseKey(Rendezvous::CreateKey(sender, incarnation, receiver,
+                                                 name, FrameAndIter(0, 0)),
+                           &result));
+  return result;
+}
+
+class StaticPlanExecutorTest : public ::testing::Test {
+ protected:
+  StaticPlanExecutorTest()
+      : device_(DeviceFactory::NewDevice("CPU", {},
+                                         "/job:localhost/replica:0/task:0")),
+        step_stats_collector_(&step_stats_) {
+    SessionOptions options;
+    thread_pool_ = ComputePool(options);
+    runner_ = [this](std::function<void()> fn) { thread_pool_->Schedule(fn); };
+    rendez_ = NewLocalRendezvous();
+  }
+
+  ~StaticPlanExecutorTest() override {
+    CHECK(rendez_->Unref());
+    delete exec_;
+    delete device_;
+  }
+
+  LocalExecutorParams Params(int version) {
+    LocalExecutorParams params;
+    params.device = device_;
+    params.create_kernel = [this, version](const NodeDef& ndef,
+                                           OpKernel** kernel) {
+      return CreateNonCachedKernel(device_, nullptr, ndef, version, kernel);
+    };
+    params.delete_kernel = [](OpKernel* kernel) {
+      DeleteNonCachedKernel(kernel);
+    };
+    return params;
+  }
+
+  Status Create(std::unique_ptr<const Graph> graph) {
+    const int version = graph->versions().producer();
+    delete exec_;
+    exec_ = nullptr;
+    return NewStaticPlanExecutor(Params(version), std::move(graph), &exec_);
+  }
+
+  Status Run(Rendezvous* rendez) {
+    Executor::Args args;
+    args.rendezvous = rendez;
+    args.stats_collector = &step_stats_collector_;
+    args.runner = runner_;
+    return exec_->Run(args);
+  }
+
+  thread::ThreadPool* thread_pool_ = nullptr;
+  Device* device_ = nullptr;
+  Executor* exec_ = nullptr;
+  StepStats step_stats_;
+  StepStatsCollector step_stats_collector_;
+  Executor::Args::Runner runner_;
+  Rendezvous* rendez_ = nullptr;
+};
+
+TEST_F(StaticPlanExecutorTest, SimpleAdd) {
+  // c = a + b
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto in1 = test::graph::Recv(g.get(), "b", "float", ALICE, 1, BOB);
+  auto tmp = test::graph::Add(g.get(), in0, in1);
+  test::graph::Send(g.get(), tmp, "c", BOB, 1, ALICE);
+  TF_ASSERT_OK(Create(std::move(g)));
+  Rendezvous::Args args;
+  TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0),
+                             false));
+  TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "b"), args, V(1.0),
+                             false));
+  TF_ASSERT_OK(Run(rendez_));
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &out, &is_dead));
+  EXPECT_EQ(2.0, V(out));
+  EXPECT_FALSE(is_dead);
+}
+
+TEST_F(StaticPlanExecutorTest, RepeatedSteps) {
+  // b = a * 2^10, run many times so that step state gets recycled.
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  auto v = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  for (int i = 1; i <= 10; ++i) {
+    v = test::graph::Add(g.get(), v, v);
+  }
+  test::graph::Send(g.get(), v, "b", BOB, 1, ALICE);
+  TF_ASSERT_OK(Create(std::move(g)));
+  Rendezvous::Args args;
+  for (int step = 0; step < 100; ++step) {
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(step), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(1024.0 * step, V(out));
+  }
+}
+
+TEST_F(StaticPlanExecutorTest, RandomTree) {
+  // Sums N identities of "a" along a randomly shaped tree of adds.
+  const int N = 4096;
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  auto in = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  std::vector<Node*> nodes;
+  for (int i = 0; i < N; ++i) {
+    nodes.push_back(test::graph::Identity(g.get(), in, 0));
+  }
+  random::PhiloxRandom philox(testing::RandomSeed(), 17);
+  random::SimplePhilox rnd(&philox);
+  while (nodes.size() > 1) {
+    int x = rnd.Uniform(nodes.size());
+    auto in0 = nodes[x];
+    nodes[x] = nodes.back();
+    nodes.resize(nodes.size() - 1);
+    x = rnd.Uniform(nodes.size());
+    auto in1 = nodes[x];
+    nodes[x] = test::graph::Add(g.get(), in0, in1);
+  }
+  test::graph::Send(g.get(), nodes.back(), "b", BOB, 1, ALICE);
+  TF_ASSERT_OK(Create(std::move(g)));
+  Rendezvous::Args args;
+  TF_ASSERT_OK(
+      rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0), false));
+  TF_ASSERT_OK(Run(rendez_));
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out, &is_dead));
+  EXPECT_EQ(static_cast<float>(N), V(out));
+}
+
+TEST_F(StaticPlanExecutorTest, RefInputs) {
+  // var = 1.0; out = var + 1.0, where "out" reads the variable by value.
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  auto one = test::graph::Constant(g.get(), V(1.0));
+  auto var = test::graph::Var(g.get(), DT_FLOAT, TensorShape({}));
+  auto init = test::graph::Assign(g.get(), var, one);
+  auto add = test::graph::Add(g.get(), var, one);
+  g->AddControlEdge(init, add);
+  test::graph::Send(g.get(), add, "out", ALICE, kIncarnation, BOB);
+  TF_ASSERT_OK(Create(std::move(g)));
+  TF_ASSERT_OK(Run(rendez_));
+  Rendezvous::Args args;
+  Tensor out;
+  bool is_dead = false;
+  TF_ASSERT_OK(rendez_->Recv(Key(ALICE, kIncarnation, BOB, "out"), args, &out,
+                             &is_dead));
+  EXPECT_EQ(2.0, V(out));
+}
+
+TEST_F(StaticPlanExecutorTest, DeadRecvPropagates) {
+  // A dead value received from another partition flows through to the Send.
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto tmp = test::graph::Identity(g.get(), in0, 0);
+  test::graph::Send(g.get(), tmp, "c", BOB, 1, ALICE);
+  TF_ASSERT_OK(Create(std::move(g)));
+  Rendezvous::Args args;
+  TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args, Tensor(),
+                             true /* is_dead */));
+  TF_ASSERT_OK(Run(rendez_));
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &out, &is_dead));
+  EXPECT_TRUE(is_dead);
+}
+
+TEST_F(StaticPlanExecutorTest, ErrorAbortsStep) {
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto err = test::graph::Error(g.get(), in0, "Testing abort");
+  auto tmp = test::graph::Add(g.get(), err, in0);
+  test::graph::Send(g.get(), tmp, "c", BOB, 1, ALICE);
+  TF_ASSERT_OK(Create(std::move(g)));
+  Rendezvous::Args args;
+  Rendezvous* rendez = NewLocalRendezvous();
+  TF_ASSERT_OK(rendez->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0),
+                            false));
+  const Status s = Run(rendez);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  EXPECT_TRUE(str_util::StrContains(s.error_message(), "Testing abort"));
+  rendez->Unref();
+}
+
+TEST_F(StaticPlanExecutorTest, SendRecvRoundTrip) {
+  // Partition A sends "x" to partition B and receives its echo "y". The
+  // Recv of "y" sits early in A's graph, and must not keep the deeper Send
+  // of "x" from running.
+  std::unique_ptr<Graph> a(new Graph(OpRegistry::Global()));
+  auto x = test::graph::Identity(a.get(), test::graph::Constant(a.get(), V(3)));
+  test::graph::Send(a.get(), x, "x", ALICE, 1, BOB);
+  auto y = test::graph::Recv(a.get(), "y", "float", BOB, 1, ALICE);
+  test::graph::Send(a.get(), y, "out", ALICE, 1, BOB);
+  const int version = a->versions().producer();
+  TF_ASSERT_OK(Create(std::move(a)));
+
+  std::unique_ptr<Graph> b(new Graph(OpRegistry::Global()));
+  auto echo = test::graph::Recv(b.get(), "x", "float", ALICE, 1, BOB);
+  test::graph::Send(b.get(), echo, "y", BOB, 1, ALICE);
+  Executor* exec_b = nullptr;
+  TF_ASSERT_OK(NewStaticPlanExecutor(Params(version), std::move(b), &exec_b));
+  std::unique_ptr<Executor> exec_b_owner(exec_b);
+
+  Executor::Args args_b;
+  args_b.rendezvous = rendez_;
+  args_b.runner = runner_;
+  Notification b_done;
+  Status b_status;
+  exec_b->RunAsync(args_b, [&b_done, &b_status](const Status& s) {
+    b_status = s;
+    b_done.Notify();
+  });
+  TF_ASSERT_OK(Run(rendez_));
+  b_done.WaitForNotification();
+  TF_ASSERT_OK(b_status);
+
+  Rendezvous::Args args;
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(rendez_->Recv(Key(ALICE, kIncarnation, BOB, "out"), args, &out,
+                             &is_dead));
+  EXPECT_EQ(3.0, V(out));
+}
+
+TEST_F(StaticPlanExecutorTest, RejectsControlFlow) {
+  std::unique_ptr<Graph> g(new Graph(OpRegistry::Global()));
+  auto in0 = test::graph::Recv(g.get(), "a", "float", ALICE, 1, BOB);
+  auto in1 = test::graph::Constant(g.get(), VB(false));
+  auto tmp = test::graph::Switch(g.get(), in0, in1);
+  test::graph::Send(g.get(), tmp, "c", BOB, 1, ALICE);
+  EXPECT_TRUE(errors::IsInvalidArgument(ValidateStaticPlanGraph(*g)));
+  const int version = g->versions().producer();
+
+  // Constructing the executor directly fails...
+  std::unique_ptr<Graph> copy(new Graph(OpRegistry::Global()));
+  CopyGraph(*g, copy.get());
+  EXPECT_TRUE(errors::IsInvalidArgument(Create(std::move(copy))));
+
+  // ... but the registered factory falls back to the default executor.
+  std::unique_ptr<Executor> fallback;
+  TF_ASSERT_OK(
+      NewExecutor("STATIC_PLAN", Params(version), std::move(g), &fallback));
+  Rendezvous::Args args;
+  TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0),
+                             false));
+  Executor::Args exec_args;
+  exec_args.rendezvous = rendez_;
+  exec_args.runner = runner_;
+  TF_ASSERT_OK(fallback->Run(exec_args));
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "c"), args, &out, &is_dead));
+  EXPECT_EQ(1.0, V(out));
+}
+
+// A chain of 'length' scalar adds, measuring per-node executor overhead.
+static Graph* ChainGraph(int length) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Node* c = test::graph::Constant(g, V(1.0));
+  Node* v = c;
+  for (int i = 0; i < length; ++i) {
+    v = test::graph::Add(g, v, c);
+  }
+  return g;
+}
+
+static void BM_Chain(int iters, int length, const char* executor_type) {
+#ifdef PLATFORM_GOOGLE
+  BenchmarkUseRealTime();
+  SetBenchmarkItemsProcessed(static_cast<int64>(length) * iters);
+#endif  // PLATFORM_GOOGLE
+  test::Benchmark("cpu", ChainGraph(length), nullptr, nullptr, nullptr,
+                  executor_type)
+      .Run(iters);
+}
+
+static void BM_ChainDefault(int iters, int length) {
+  BM_Chain(iters, length, "DEFAULT");
+}
+static void BM_ChainStaticPlan(int iters, int length) {
+  BM_Chain(iters, length, "STATIC_PLAN");
+}
+BENCHMARK(BM_ChainDefault)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK(BM_ChainStaticPlan)->Arg(1)->Arg(16)->Arg(256);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,249 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Every allocation is preceded by a header of this many bytes.
+constexpr size_t kHeaderBytes = Allocator::kAllocatorAlignment;
+
+// Block sizes are rounded up to a multiple of this.
+constexpr size_t kBlockGranularity = 64 << 10;
+
+// Blocks stop doubling in size once they reach this size.
+constexpr size_t kMaxBlockGrowthBytes = 256 << 20;
+
+size_t RoundUp(size_t n, size_t multiple) {
+  return (n + multiple - 1) / multiple * multiple;
+}
+
+}  // namespace
+
+constexpr size_t StepArenaAllocator::kMaxArenaAllocationBytes;
+
+struct StepArenaAllocator::Block {
+  char* data = nullptr;
+  size_t size = 0;
+  // Offset of the first free byte. Guarded by the allocator's 'mu_'.
+  size_t used = 0;
+  // One reference for each live allocation, plus one held by the allocator
+  // while the block is in 'blocks_'.
+  std::atomic<int64> refs{1};
+};
+
+struct StepArenaAllocator::Header {
+  // The block holding the allocation, or nullptr if it came from the base
+  // allocator.
+  Block* block;
+  size_t num_bytes;
+  // For allocations from the base allocator, the offset of the returned
+  // pointer from the one returned by the base allocator.
+  size_t base_offset;
+};
+
+StepArenaAllocator::StepArenaAllocator(Allocator* base, size_t min_block_bytes)
+    : base_(base),
+      min_block_bytes_(RoundUp(std::max<size_t>(min_block_bytes, 1),
+                               kBlockGranularity)),
+      target_block_bytes_(min_block_bytes_) {
+  static_assert(sizeof(Header) <= kHeaderBytes,
+                "Header does not fit in front of the allocation");
+}
+
+StepArenaAllocator::~StepArenaAllocator() {
+  for (Block* block : blocks_) {
+    DCHECK_EQ(1, block->refs.load());
+    FreeBlock(block);
+  }
+}
+
+void* StepArenaAllocator::AllocateRaw(size_t alignment, size_t num_bytes) {
+  const size_t align = std::max(alignment, kHeaderBytes);
+  num_bytes = std::max<size_t>(num_bytes, 1);
+
+  Block* block = nullptr;
+  char* ptr = nullptr;
+  size_t base_offset = 0;
+  if (num_bytes > kMaxArenaAllocationBytes || forwards_to_base()) {
+    char* raw =
+        static_cast<char*>(base_->AllocateRaw(align, num_bytes + align));
+    if (raw == nullptr) return nullptr;
+    ptr = raw + align;
+    base_offset = align;
+  }
+
+  mutex_lock l(mu_);
+  if (ptr == nullptr) {
+    block = BlockWithRoom(align, num_bytes);
+    if (block == nullptr) return nullptr;
+    const uintptr_t start =
+        reinterpret_cast<uintptr_t>(block->data) + block->used;
+    ptr = reinterpret_cast<char*>(RoundUp(start + kHeaderBytes, align));
+    const size_t end = ptr + num_bytes - block->data;
+    arena_bytes_ += end - block->used;
+    peak_arena_bytes_ = std::max(peak_arena_bytes_, arena_bytes_);
+    block->used = end;
+    block->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Header* header = reinterpret_cast<Header*>(ptr - kHeaderBytes);
+  header->block = block;
+  header->num_bytes = num_bytes;
+  header->base_offset = base_offset;
+
+  ++num_allocs_;
+  const int64 in_use =
+      bytes_in_use_.fetch_add(num_bytes, std::memory_order_relaxed) +
+      num_bytes;
+  max_bytes_in_use_ = std::max(max_bytes_in_use_, in_use);
+  max_alloc_size_ = std::max<int64>(max_alloc_size_, num_bytes);
+
+  // Released in DeallocateRaw().
+  Ref();
+  return ptr;
+}
+
+StepArenaAllocator::Block* StepArenaAllocator::BlockWithRoom(
+    size_t alignment, size_t num_bytes) {
+  // Enough for the allocation, its header, and padding for the alignment.
+  const size_t needed = num_bytes + kHeaderBytes + alignment;
+
+  // Prefer the current block. A block without live allocations, i.e. with
+  // only the allocator's reference, is rewound first. Its reference count
+  // cannot grow concurrently, because allocations hold 'mu_'.
+  for (int i = static_cast<int>(blocks_.size()) - 1; i >= 0; --i) {
+    Block* block = blocks_[i];
+    if (block->refs.load(std::memory_order_acquire) == 1) {
+      arena_bytes_ -= block->used;
+      block->used = 0;
+    }
+    if (block->size - block->used >= needed) {
+      // Make it the current block.
+      std::swap(blocks_[i], blocks_.back());
+      return block;
+    }
+  }
+
+  size_t size = target_block_bytes_;
+  if (!blocks_.empty()) {
+    size = std::max(size, std::min(2 * blocks_.back()->size,
+                                   kMaxBlockGrowthBytes));
+  }
+  size = RoundUp(std::max(size, needed), kBlockGranularity);
+  void* data = base_->AllocateRaw(Allocator::kAllocatorAlignment, size);
+  if (data == nullptr) return nullptr;
+  Block* block = new Block;
+  block->data = static_cast<char*>(data);
+  block->size = size;
+  blocks_.push_back(block);
+  return block;
+}
+
+void StepArenaAllocator::DeallocateRaw(void* ptr) {
+  const Header* header =
+      reinterpret_cast<const Header*>(static_cast<char*>(ptr) - kHeaderBytes);
+  bytes_in_use_.fetch_sub(header->num_bytes, std::memory_order_relaxed);
+  Block* block = header->block;
+  if (block == nullptr) {
+    base_->DeallocateRaw(static_cast<char*>(ptr) - header->base_offset);
+  } else if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    // The block was handed over by EndStep(), and this was its last
+    // allocation.
+    escaped_block_bytes_.fetch_sub(block->size, std::memory_order_relaxed);
+    FreeBlock(block);
+  }
+  Unref();
+}
+
+void StepArenaAllocator::FreeBlock(Block* block) {
+  base_->DeallocateRaw(block->data);
+  delete block;
+}
+
+void StepArenaAllocator::EndStep() {
+  mutex_lock l(mu_);
+  last_step_peak_bytes_ = peak_arena_bytes_;
+  target_block_bytes_ = std::max(
+      min_block_bytes_, RoundUp(peak_arena_bytes_, kBlockGranularity));
+
+  // Keep one idle block that fits the next step without being much too
+  // large. Every other block is released, either now or, if it still holds
+  // live allocations, when the last of them is freed.
+  Block* kept = nullptr;
+  for (Block* block : blocks_) {
+    if (kept == nullptr && block->refs.load(std::memory_order_acquire) == 1 &&
+        block->size >= target_block_bytes_ &&
+        block->size <= 2 * target_block_bytes_) {
+      block->used = 0;
+      kept = block;
+      continue;
+    }
+    // Count the block as escaped before dropping the allocator's reference,
+    // after which its last allocation may free it at any time.
+    escaped_block_bytes_.fetch_add(block->size, std::memory_order_relaxed);
+    if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      escaped_block_bytes_.fetch_sub(block->size, std::memory_order_relaxed);
+      FreeBlock(block);
+    }
+  }
+  blocks_.clear();
+
+  // Escaped temporaries only affect the steps during which their blocks
+  // pin more memory than the arena of a step needs.
+  const bool forward =
+      escaped_block_bytes_.load(std::memory_order_relaxed) >
+      static_cast<int64>(target_block_bytes_);
+  if (forward != forwards_to_base()) {
+    VLOG(1) << (forward ? "Forwarding" : "No longer forwarding")
+            << " the allocations of the step arena to " << base_->Name()
+            << ": escaped temporaries pin "
+            << escaped_block_bytes_.load(std::memory_order_relaxed)
+            << " bytes";
+    forward_to_base_.store(forward, std::memory_order_relaxed);
+  }
+  if (kept != nullptr) {
+    if (forward) {
+      FreeBlock(kept);
+    } else {
+      blocks_.push_back(kept);
+    }
+  }
+  arena_bytes_ = 0;
+  peak_arena_bytes_ = 0;
+}
+
+int64 StepArenaAllocator::last_step_peak_bytes() const {
+  mutex_lock l(mu_);
+  return last_step_peak_bytes_;
+}
+
+void StepArenaAllocator::GetStats(AllocatorStats* stats) {
+  mutex_lock l(mu_);
+  stats->Clear();
+  stats->num_allocs = num_allocs_;
+  stats->bytes_in_use = bytes_in_use_.load(std::memory_order_relaxed);
+  stats->max_bytes_in_use = max_bytes_in_use_;
+  stats->max_alloc_size = max_alloc_size_;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,128 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A bump-pointer allocator for the temporary tensors of one step at a time.
+//
+// Allocations are carved out of a few large blocks obtained from a base
+// allocator, so serving and freeing a temporary does not touch the base
+// allocator. A block whose allocations have all been freed is rewound and
+// reused, and EndStep() recycles all blocks at once.
+//
+// At the end of a step the allocator records the peak number of bytes the
+// step needed, and the next step starts with a single block of that size.
+//
+// A temporary may outlive its step, for example when a kernel outputs or
+// caches it. The block holding it is then handed over to its remaining
+// allocations and returned to the base allocator when the last of them is
+// freed, so only the blocks of escaped temporaries stay alive. Since every
+// escape pins a whole block, the arena forwards the allocations of a step
+// to the base allocator while the escaped blocks of earlier steps hold more
+// than a step's worth of memory, and serves them again once enough of those
+// blocks have been freed. Each allocation holds a reference on the
+// StepArenaAllocator, so the allocator stays alive as long as any tensor
+// allocated from it.
+//
+// AllocateRaw() may be called concurrently. EndStep() must not be called
+// concurrently with AllocateRaw().
+class StepArenaAllocator : public Allocator, public core::RefCounted {
+ public:
+  // 'base' provides the memory of the blocks and serves requests larger
+  // than kMaxArenaAllocationBytes. Not owned; must outlive this allocator.
+  // Blocks are at least 'min_block_bytes' large.
+  StepArenaAllocator(Allocator* base, size_t min_block_bytes);
+
+  string Name() override { return "step_arena"; }
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override;
+  void DeallocateRaw(void* ptr) override;
+  void GetStats(AllocatorStats* stats) override;
+
+  // Ends the current step and prepares the arena for the next one.
+  void EndStep();
+
+  // Returns the peak number of arena bytes in use during the last step that
+  // ended.
+  int64 last_step_peak_bytes() const;
+
+  // Returns true if the requests of the current step are forwarded to the
+  // base allocator, because escaped temporaries pin too many blocks.
+  bool forwards_to_base() const {
+    return forward_to_base_.load(std::memory_order_relaxed);
+  }
+
+  // Requests larger than this are forwarded to the base allocator.
+  static constexpr size_t kMaxArenaAllocationBytes = 64 << 20;
+
+ private:
+  struct Block;
+  struct Header;
+
+  ~StepArenaAllocator() override;
+
+  // Returns a block with at least 'num_bytes' bytes available, allocating
+  // one if needed. Returns nullptr if the base allocator is out of memory.
+  Block* BlockWithRoom(size_t alignment, size_t num_bytes)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void FreeBlock(Block* block);
+
+  Allocator* const base_;
+  const size_t min_block_bytes_;
+
+  mutable mutex mu_;
+  // Blocks owned by the current step. The last one is the one being
+  // bumped.
+  std::vector<Block*> blocks_ GUARDED_BY(mu_);
+  // Size of the first block allocated by the next step.
+  size_t target_block_bytes_ GUARDED_BY(mu_);
+  // Bytes of the blocks that are bumped past, and their peak in this and
+  // the last completed step.
+  int64 arena_bytes_ GUARDED_BY(mu_) = 0;
+  int64 peak_arena_bytes_ GUARDED_BY(mu_) = 0;
+  int64 last_step_peak_bytes_ GUARDED_BY(mu_) = 0;
+
+  // Bytes of the blocks handed over to escaped temporaries that are still
+  // alive. Decremented without holding 'mu_'.
+  std::atomic<int64> escaped_block_bytes_{0};
+  // Set by EndStep() for the next step if 'escaped_block_bytes_' exceeds the
+  // size of the arena of a step.
+  std::atomic<bool> forward_to_base_{false};
+
+  // Stats. 'bytes_in_use_' is decremented without holding 'mu_'.
+  int64 num_allocs_ GUARDED_BY(mu_) = 0;
+  std::atomic<int64> bytes_in_use_{0};
+  int64 max_bytes_in_use_ GUARDED_BY(mu_) = 0;
+  int64 max_alloc_size_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepArenaAllocator);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STEP_ARENA_ALLOCATOR_H_
@@ -0,0 +1,217 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_arena_allocator.h"
+
+#include <cstring>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(StepArenaAllocatorTest, ReusesMemoryAcrossSteps) {
+  StepArenaAllocator* arena = new StepArenaAllocator(cpu_allocator(), 1 << 20);
+  void* first = nullptr;
+  for (int step = 0; step < 3; ++step) {
+    std::vector<void*> ptrs;
+    for (int i = 0; i < 10; ++i) {
+      void* ptr = arena->AllocateRaw(Allocator::kAllocatorAlignment, 1000);
+      ASSERT_NE(nullptr, ptr);
+      EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ptr) %
+                       Allocator::kAllocatorAlignment);
+      memset(ptr, step, 1000);
+      ptrs.push_back(ptr);
+    }
+    if (step == 0) first = ptrs[0];
+    EXPECT_EQ(first, ptrs[0]);
+    for (void* ptr : ptrs) arena->DeallocateRaw(ptr);
+    arena->EndStep();
+  }
+  arena->Unref();
+}
+
+TEST(StepArenaAllocatorTest, RewindsIdleBlocksWithinAStep) {
+  StepArenaAllocator* arena = new StepArenaAllocator(cpu_allocator(), 1 << 16);
+  void* first = arena->AllocateRaw(Allocator::kAllocatorAlignment, 1000);
+  arena->DeallocateRaw(first);
+  // The block has no live allocations left, so it is reused from the start.
+  void* second = arena->AllocateRaw(Allocator::kAllocatorAlignment, 2000);
+  EXPECT_EQ(first, second);
+  arena->DeallocateRaw(second);
+  arena->EndStep();
+  arena->Unref();
+}
+
+TEST(StepArenaAllocatorTest, PresizesFromPeakUsage) {
+  StepArenaAllocator* arena = new StepArenaAllocator(cpu_allocator(), 1 << 16);
+  const size_t kBytes = 100 << 10;
+  const int kNum = 10;
+  for (int step = 0; step < 2; ++step) {
+    std::vector<char*> ptrs;
+    for (int i = 0; i < kNum; ++i) {
+      ptrs.push_back(static_cast<char*>(
+          arena->AllocateRaw(Allocator::kAllocatorAlignment, kBytes)));
+    }
+    if (step == 1) {
+      // All allocations of the second step fit in one block, back to back.
+      for (int i = 1; i < kNum; ++i) {
+        EXPECT_GT(ptrs[i], ptrs[i - 1]);
+        EXPECT_LE(ptrs[i] - ptrs[i - 1], kBytes + 2 * 64);
+      }
+    }
+    for (char* ptr : ptrs) arena->DeallocateRaw(ptr);
+    arena->EndStep();
+    EXPECT_GE(arena->last_step_peak_bytes(), kNum * kBytes);
+  }
+  arena->Unref();
+}
+
+TEST(StepArenaAllocatorTest, TemporaryOutlivesStepAndAllocator) {
+  StepArenaAllocator* arena = new StepArenaAllocator(cpu_allocator(), 1 << 16);
+  Tensor escaped(arena, DT_FLOAT, TensorShape({1000}));
+  escaped.flat<float>().setConstant(1.0f);
+  arena->EndStep();
+
+  // The next step does not reuse the block of the escaped tensor.
+  Tensor next(arena, DT_FLOAT, TensorShape({1000}));
+  next.flat<float>().setConstant(2.0f);
+  EXPECT_EQ(1.0f, escaped.flat<float>()(999));
+  next = Tensor();
+  arena->EndStep();
+
+  // The tensor keeps the allocator alive after its owner lets go.
+  arena->Unref();
+  EXPECT_EQ(1.0f, escaped.flat<float>()(0));
+  escaped = Tensor();
+}
+
+TEST(StepArenaAllocatorTest, KeepsServingAfterEscape) {
+  StepArenaAllocator* arena = new StepArenaAllocator(cpu_allocator(), 1 << 16);
+  Tensor escaped(arena, DT_FLOAT, TensorShape({1000}));
+  arena->EndStep();
+  // One escaped block does not pin more than the arena of a step.
+  EXPECT_FALSE(arena->forwards_to_base());
+  {
+    Tensor t(arena, DT_FLOAT, TensorShape({1000}));
+    t.flat<float>().setConstant(1.0f);
+  }
+  arena->EndStep();
+  EXPECT_LT(0, arena->last_step_peak_bytes());
+  escaped = Tensor();
+  arena->Unref();
+}
+
+TEST(StepArenaAllocatorTest, ForwardsToBaseWhileEscapesPinTooMuch) {
+  StepArenaAllocator* arena = new StepArenaAllocator(cpu_allocator(), 1 << 16);
+  // Every step lets a temporary escape, each pinning a block of its own.
+  std::vector<Tensor> escaped;
+  for (int step = 0; step < 2; ++step) {
+    escaped.emplace_back(arena, DT_FLOAT, TensorShape({1000}));
+    arena->EndStep();
+  }
+  EXPECT_TRUE(arena->forwards_to_base());
+
+  // The next step does not carve new blocks that a temporary could pin.
+  escaped.emplace_back(arena, DT_FLOAT, TensorShape({1000}));
+  escaped.back().flat<float>().setConstant(1.0f);
+  arena->EndStep();
+  EXPECT_EQ(0, arena->last_step_peak_bytes());
+  AllocatorStats stats;
+  arena->GetStats(&stats);
+  EXPECT_EQ(3 * 1000 * sizeof(float), stats.bytes_in_use);
+
+  // Once the escaped temporaries are freed, the arena serves steps again.
+  escaped.clear();
+  arena->EndStep();
+  EXPECT_FALSE(arena->forwards_to_base());
+  {
+    Tensor t(arena, DT_FLOAT, TensorShape({1000}));
+    t.flat<float>().setConstant(1.0f);
+  }
+  arena->EndStep();
+  EXPECT_LT(0, arena->last_step_peak_bytes());
+  arena->Unref();
+}
+
+TEST(StepArenaAllocatorTest, LargeAllocationsBypassArena) {
+  StepArenaAllocator* arena = new StepArenaAllocator(cpu_allocator(), 1 << 16);
+  const size_t kBytes = StepArenaAllocator::kMaxArenaAllocationBytes + 1;
+  char* ptr = static_cast<char*>(
+      arena->AllocateRaw(Allocator::kAllocatorAlignment, kBytes));
+  ASSERT_NE(nullptr, ptr);
+  ptr[0] = 1;
+  ptr[kBytes - 1] = 1;
+  arena->DeallocateRaw(ptr);
+  arena->EndStep();
+  EXPECT_EQ(0, arena->last_step_peak_bytes());
+  arena->Unref();
+}
+
+TEST(StepArenaAllocatorTest, Stats) {
+  StepArenaAllocator* arena = new StepArenaAllocator(cpu_allocator(), 1 << 16);
+  void* a = arena->AllocateRaw(Allocator::kAllocatorAlignment, 100);
+  void* b = arena->AllocateRaw(Allocator::kAllocatorAlignment, 300);
+  arena->DeallocateRaw(a);
+  void* c = arena->AllocateRaw(Allocator::kAllocatorAlignment, 50);
+  AllocatorStats stats;
+  arena->GetStats(&stats);
+  EXPECT_EQ(3, stats.num_allocs);
+  EXPECT_EQ(350, stats.bytes_in_use);
+  EXPECT_EQ(400, stats.max_bytes_in_use);
+  EXPECT_EQ(300, stats.max_alloc_size);
+  arena->DeallocateRaw(b);
+  arena->DeallocateRaw(c);
+  arena->GetStats(&stats);
+  EXPECT_EQ(0, stats.bytes_in_use);
+  arena->EndStep();
+  arena->Unref();
+}
+
+TEST(StepArenaAllocatorTest, ConcurrentAllocations) {
+  StepArenaAllocator* arena = new StepArenaAllocator(cpu_allocator(), 1 << 16);
+  const int kNumThreads = 8;
+  for (int step = 0; step < 5; ++step) {
+    {
+      thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+      for (int t = 0; t < kNumThreads; ++t) {
+        pool.Schedule([arena, t]() {
+          for (int i = 0; i < 200; ++i) {
+            const size_t size = 1 + (i * 37 + t * 101) % 20000;
+            char* ptr = static_cast<char*>(
+                arena->AllocateRaw(Allocator::kAllocatorAlignment, size));
+            ASSERT_NE(nullptr, ptr);
+            memset(ptr, t, size);
+            for (size_t j = 0; j < size; j += 512) ASSERT_EQ(t, ptr[j]);
+            arena->DeallocateRaw(ptr);
+          }
+        });
+      }
+    }
+    arena->EndStep();
+  }
+  AllocatorStats stats;
+  arena->GetStats(&stats);
+  EXPECT_EQ(5 * kNumThreads * 200, stats.num_allocs);
+  EXPECT_EQ(0, stats.bytes_in_use);
+  arena->Unref();
+}
+
+}  // namespace
+}  // namespace tensorflow
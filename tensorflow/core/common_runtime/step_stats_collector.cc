@@ -27,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/scanner.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace {
@@ -76,6 +77,15 @@ void NodeExecStatsWrapper::SetReferencedTensors(
   }
 }
 
+void NodeExecStatsWrapper::SetSharding(const ShardingContext& sharding) {
+  if (sharding.num_calls == 0) return;
+  ShardingStats* stats = stats_->mutable_sharding_stats();
+  stats->set_num_calls(sharding.num_calls);
+  stats->set_num_units(sharding.num_units);
+  stats->set_num_shards(sharding.num_shards);
+  stats->set_work_nanos(sharding.work_nanos);
+}
+
 // TODO(tucker): merge with the DetailText function in session.cc
 // in a common location.
 bool NodeExecStatsWrapper::SetTimelineLabel(const Node* node) {
@@ -36,6 +36,7 @@ class Node;
 class NodeExecStats;
 class OpKernelContext;
 class StepStats;
+struct ShardingContext;
 class Tensor;
 class TrackingAllocator;
 
@@ -108,6 +109,9 @@ class NodeExecStatsWrapper {
   // execution of this node.
   void SetReferencedTensors(const TensorReferenceVector& tensors);
 
+  // Records the intra-op sharding done during the execution of this node.
+  void SetSharding(const ShardingContext& sharding);
+
   // Sets the timeline_label field of the wrapped NodeExecStats, using data
   // from *node. Returns true iff the node is a transfer node.
   bool SetTimelineLabel(const Node* node);
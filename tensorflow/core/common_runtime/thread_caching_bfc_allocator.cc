@@ -0,0 +1,279 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/thread_caching_bfc_allocator.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Every allocation is preceded by a header of this many bytes, which keeps
+// the returned pointers aligned like the underlying chunks.
+constexpr size_t kHeaderBytes = Allocator::kAllocatorAlignment;
+
+// Upper bound on the bytes a shard caches per size class. An overfull size
+// class returns half of its blocks to the BFCAllocator.
+constexpr size_t kMaxCachedBytesPerClass = 64 << 10;
+
+size_t BlockBytes(int size_class) {
+  return (size_class + 1) * ThreadCachingBFCAllocator::kSizeClassBytes;
+}
+
+// The number of blocks of 'size_class' a shard holds before it returns
+// some of them.
+int MaxCachedBlocks(int size_class) {
+  return std::max<int>(4, kMaxCachedBytesPerClass / BlockBytes(size_class));
+}
+
+void UpdateMax(std::atomic<int64>* max, int64 value) {
+  int64 current = max->load(std::memory_order_relaxed);
+  while (value > current &&
+         !max->compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace
+
+constexpr size_t ThreadCachingBFCAllocator::kSizeClassBytes;
+constexpr int ThreadCachingBFCAllocator::kNumSizeClasses;
+
+struct ThreadCachingBFCAllocator::Header {
+  int64 allocation_id;
+  size_t requested_bytes;
+  // Size of the block, including this header.
+  size_t block_bytes;
+  // Offset of the allocation from the start of the block. kHeaderBytes,
+  // unless the allocation is aligned more strictly than the header.
+  size_t block_offset;
+  // -1 if the block is returned directly to the BFCAllocator when freed.
+  int size_class;
+};
+
+struct ThreadCachingBFCAllocator::Shard {
+  mutex mu;
+  // Free blocks of each size class, most recently freed last.
+  std::vector<void*> blocks[kNumSizeClasses] GUARDED_BY(mu);
+  // Keeps the mutexes of neighbouring shards on separate cache lines.
+  char padding[64];
+};
+
+ThreadCachingBFCAllocator::ThreadCachingBFCAllocator(
+    SubAllocator* sub_allocator, size_t total_memory, bool allow_growth,
+    const string& name)
+    : bfc_(sub_allocator, total_memory, allow_growth, name),
+      next_allocation_id_(1),
+      num_allocs_(0),
+      bytes_in_use_(0),
+      max_bytes_in_use_(0),
+      max_alloc_size_(0) {
+  static_assert(sizeof(Header) <= kHeaderBytes,
+                "Header does not fit in front of the allocation");
+  const int num_shards = std::max(1, port::NumSchedulableCPUs());
+  shards_.reserve(num_shards);
+  for (int i = 0; i < num_shards; ++i) {
+    shards_.emplace_back(new Shard);
+  }
+}
+
+ThreadCachingBFCAllocator::~ThreadCachingBFCAllocator() { Flush(); }
+
+void* ThreadCachingBFCAllocator::AllocateRaw(size_t alignment,
+                                             size_t num_bytes) {
+  return AllocateRawInternal(alignment, num_bytes, nullptr);
+}
+
+void* ThreadCachingBFCAllocator::AllocateRaw(
+    size_t alignment, size_t num_bytes,
+    const AllocationAttributes& allocation_attr) {
+  return AllocateRawInternal(alignment, num_bytes, &allocation_attr);
+}
+
+void* ThreadCachingBFCAllocator::AllocateRawInternal(
+    size_t alignment, size_t num_bytes,
+    const AllocationAttributes* allocation_attr) {
+  if (num_bytes == 0) {
+    LOG(ERROR) << "tried to allocate 0 bytes";
+    return nullptr;
+  }
+  // Cached blocks are only aligned for the header. Allocations that need
+  // a stricter alignment go to the BFCAllocator, with room to align them.
+  const bool over_aligned = alignment > kHeaderBytes;
+  const size_t padding_bytes = over_aligned ? alignment : 0;
+  const size_t block_bytes =
+      (num_bytes + kHeaderBytes + padding_bytes + kSizeClassBytes - 1) /
+      kSizeClassBytes * kSizeClassBytes;
+  const int size_class =
+      !over_aligned && block_bytes <= kNumSizeClasses * kSizeClassBytes
+          ? static_cast<int>(block_bytes / kSizeClassBytes) - 1
+          : -1;
+
+  void* block = nullptr;
+  if (size_class >= 0) {
+    block = AllocateFromShard(alignment, size_class);
+  } else if (bfc_.AllocateRawBatch(alignment, block_bytes, 1, &block) == 0) {
+    block = nullptr;
+  }
+  if (block == nullptr) {
+    // Out of memory. Return the cached blocks so that the BFCAllocator can
+    // coalesce them, and let it retry or report the failure.
+    Flush();
+    block = allocation_attr != nullptr
+                ? bfc_.AllocateRaw(alignment, block_bytes, *allocation_attr)
+                : bfc_.AllocateRaw(alignment, block_bytes);
+    if (block == nullptr) return nullptr;
+  }
+
+  char* ptr = static_cast<char*>(block) + kHeaderBytes;
+  if (over_aligned) {
+    const uintptr_t misalignment = reinterpret_cast<uintptr_t>(ptr) % alignment;
+    if (misalignment != 0) ptr += alignment - misalignment;
+  }
+  Header* header = reinterpret_cast<Header*>(ptr - kHeaderBytes);
+  header->allocation_id =
+      next_allocation_id_.fetch_add(1, std::memory_order_relaxed);
+  header->requested_bytes = num_bytes;
+  header->block_bytes = block_bytes;
+  header->block_offset = ptr - static_cast<char*>(block);
+  header->size_class = size_class;
+  RecordAllocation(block_bytes - header->block_offset);
+  return ptr;
+}
+
+void* ThreadCachingBFCAllocator::AllocateFromShard(size_t alignment,
+                                                   int size_class) {
+  Shard* shard = CurrentShard();
+  mutex_lock l(shard->mu);
+  std::vector<void*>& blocks = shard->blocks[size_class];
+  if (blocks.empty()) {
+    // Refill with half of the capacity, so that the next few frees do not
+    // immediately drain the size class again.
+    const int n = std::max(1, MaxCachedBlocks(size_class) / 2);
+    blocks.resize(n);
+    blocks.resize(bfc_.AllocateRawBatch(alignment, BlockBytes(size_class), n,
+                                        blocks.data()));
+    if (blocks.empty()) return nullptr;
+  }
+  void* block = blocks.back();
+  blocks.pop_back();
+  return block;
+}
+
+void ThreadCachingBFCAllocator::DeallocateRaw(void* ptr) {
+  if (ptr == nullptr) {
+    LOG(ERROR) << "tried to deallocate nullptr";
+    return;
+  }
+  const Header* header =
+      reinterpret_cast<const Header*>(static_cast<char*>(ptr) - kHeaderBytes);
+  void* block = static_cast<char*>(ptr) - header->block_offset;
+  bytes_in_use_.fetch_sub(header->block_bytes - header->block_offset,
+                          std::memory_order_relaxed);
+  if (header->size_class >= 0) {
+    DeallocateToShard(block, header->size_class);
+  } else {
+    bfc_.DeallocateRaw(block);
+  }
+}
+
+void ThreadCachingBFCAllocator::DeallocateToShard(void* block,
+                                                  int size_class) {
+  Shard* shard = CurrentShard();
+  mutex_lock l(shard->mu);
+  std::vector<void*>& blocks = shard->blocks[size_class];
+  blocks.push_back(block);
+  if (blocks.size() > static_cast<size_t>(MaxCachedBlocks(size_class))) {
+    // Keep the most recently freed half, which is the most likely to still
+    // be in the CPU caches.
+    const int n = blocks.size() / 2;
+    bfc_.DeallocateRawBatch(blocks.data(), n);
+    blocks.erase(blocks.begin(), blocks.begin() + n);
+  }
+}
+
+void ThreadCachingBFCAllocator::Flush() {
+  for (auto& shard : shards_) {
+    mutex_lock l(shard->mu);
+    for (std::vector<void*>& blocks : shard->blocks) {
+      if (blocks.empty()) continue;
+      bfc_.DeallocateRawBatch(blocks.data(), blocks.size());
+      blocks.clear();
+    }
+  }
+}
+
+ThreadCachingBFCAllocator::Shard* ThreadCachingBFCAllocator::CurrentShard() {
+  static std::atomic<int> next_thread_index(0);
+  static thread_local int thread_index =
+      next_thread_index.fetch_add(1, std::memory_order_relaxed);
+  return shards_[thread_index % shards_.size()].get();
+}
+
+void ThreadCachingBFCAllocator::RecordAllocation(int64 allocated_bytes) {
+  num_allocs_.fetch_add(1, std::memory_order_relaxed);
+  const int64 in_use =
+      bytes_in_use_.fetch_add(allocated_bytes, std::memory_order_relaxed) +
+      allocated_bytes;
+  UpdateMax(&max_bytes_in_use_, in_use);
+  UpdateMax(&max_alloc_size_, allocated_bytes);
+}
+
+void ThreadCachingBFCAllocator::AddAllocVisitor(Visitor visitor) {
+  bfc_.AddAllocVisitor(std::move(visitor));
+}
+
+size_t ThreadCachingBFCAllocator::RequestedSize(const void* ptr) {
+  CHECK(ptr != nullptr);
+  return reinterpret_cast<const Header*>(static_cast<const char*>(ptr) -
+                                         kHeaderBytes)
+      ->requested_bytes;
+}
+
+size_t ThreadCachingBFCAllocator::AllocatedSize(const void* ptr) {
+  CHECK(ptr != nullptr);
+  const Header* header = reinterpret_cast<const Header*>(
+      static_cast<const char*>(ptr) - kHeaderBytes);
+  return header->block_bytes - header->block_offset;
+}
+
+int64 ThreadCachingBFCAllocator::AllocationId(const void* ptr) {
+  CHECK(ptr != nullptr);
+  return reinterpret_cast<const Header*>(static_cast<const char*>(ptr) -
+                                         kHeaderBytes)
+      ->allocation_id;
+}
+
+void ThreadCachingBFCAllocator::GetStats(AllocatorStats* stats) {
+  bfc_.GetStats(stats);
+  stats->num_allocs = num_allocs_.load(std::memory_order_relaxed);
+  stats->bytes_in_use = bytes_in_use_.load(std::memory_order_relaxed);
+  stats->max_bytes_in_use = max_bytes_in_use_.load(std::memory_order_relaxed);
+  stats->max_alloc_size = max_alloc_size_.load(std::memory_order_relaxed);
+}
+
+void ThreadCachingBFCAllocator::ClearStats() {
+  bfc_.ClearStats();
+  num_allocs_.store(0, std::memory_order_relaxed);
+  max_bytes_in_use_.store(bytes_in_use_.load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+  max_alloc_size_.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace tensorflow
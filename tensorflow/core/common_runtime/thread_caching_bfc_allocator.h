@@ -0,0 +1,117 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_THREAD_CACHING_BFC_ALLOCATOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_THREAD_CACHING_BFC_ALLOCATOR_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/bfc_allocator.h"
+#include "tensorflow/core/common_runtime/visitable_allocator.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A BFCAllocator with a tcmalloc-style cache of small blocks in front of it.
+//
+// Small requests are rounded up to one of kNumSizeClasses size classes and
+// served from a per-CPU cache shard. Each thread sticks to one shard, so in
+// the common case a shard's mutex is uncontended. An empty shard is refilled,
+// and an overfull one drained, by moving a batch of blocks from or to the
+// BFCAllocator bins under a single acquisition of the BFCAllocator lock.
+// Large requests, and requests aligned more strictly than
+// Allocator::kAllocatorAlignment, go straight to the BFCAllocator.
+//
+// Every allocation is preceded by a small header recording its size class,
+// sizes and id, so the memory must be addressable by the host (CPU memory
+// or CUDA host memory, not GPU memory).
+//
+// GetStats() reports exact counts from the perspective of the users of this
+// allocator: blocks sitting in a cache are not in use. Sizes are the
+// AllocatedSize() of each allocation.
+class ThreadCachingBFCAllocator : public VisitableAllocator {
+ public:
+  // Takes ownership of sub_allocator. The arguments are passed on to the
+  // underlying BFCAllocator.
+  ThreadCachingBFCAllocator(SubAllocator* sub_allocator, size_t total_memory,
+                            bool allow_growth, const string& name);
+  ~ThreadCachingBFCAllocator() override;
+
+  string Name() override { return bfc_.Name(); }
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override;
+  void* AllocateRaw(size_t alignment, size_t num_bytes,
+                    const AllocationAttributes& allocation_attr) override;
+  void DeallocateRaw(void* ptr) override;
+
+  void AddAllocVisitor(Visitor visitor) override;
+
+  // Does nothing, because memory is never freed.
+  void AddFreeVisitor(Visitor visitor) override {}
+
+  bool TracksAllocationSizes() override { return true; }
+
+  size_t RequestedSize(const void* ptr) override;
+
+  size_t AllocatedSize(const void* ptr) override;
+
+  int64 AllocationId(const void* ptr) override;
+
+  void GetStats(AllocatorStats* stats) override;
+
+  void ClearStats() override;
+
+  // Returns all cached blocks to the underlying BFCAllocator.
+  void Flush();
+
+  // Size classes are multiples of kSizeClassBytes up to
+  // kNumSizeClasses * kSizeClassBytes, header included.
+  static constexpr size_t kSizeClassBytes = 256;
+  static constexpr int kNumSizeClasses = 64;
+
+ private:
+  struct Header;
+  struct Shard;
+
+  void* AllocateRawInternal(size_t alignment, size_t num_bytes,
+                            const AllocationAttributes* allocation_attr);
+  void* AllocateFromShard(size_t alignment, int size_class);
+  void DeallocateToShard(void* block, int size_class);
+  void RecordAllocation(int64 allocated_bytes);
+
+  // Returns the shard of the calling thread.
+  Shard* CurrentShard();
+
+  BFCAllocator bfc_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // Stats, kept in atomics so that cache hits do not need a shared lock.
+  std::atomic<int64> next_allocation_id_;
+  std::atomic<int64> num_allocs_;
+  std::atomic<int64> bytes_in_use_;
+  std::atomic<int64> max_bytes_in_use_;
+  std::atomic<int64> max_alloc_size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ThreadCachingBFCAllocator);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_THREAD_CACHING_BFC_ALLOCATOR_H_
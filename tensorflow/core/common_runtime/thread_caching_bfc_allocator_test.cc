@@ -0,0 +1,227 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/thread_caching_bfc_allocator.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/pool_allocator.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace {
+
+static void CheckStats(Allocator* a, int64 num_allocs, int64 bytes_in_use,
+                       int64 max_bytes_in_use, int64 max_alloc_size) {
+  AllocatorStats stats;
+  a->GetStats(&stats);
+  EXPECT_EQ(stats.bytes_in_use, bytes_in_use);
+  EXPECT_EQ(stats.max_bytes_in_use, max_bytes_in_use);
+  EXPECT_EQ(stats.num_allocs, num_allocs);
+  EXPECT_EQ(stats.max_alloc_size, max_alloc_size);
+}
+
+TEST(ThreadCachingBFCAllocatorTest, NoDupsAndExactStats) {
+  ThreadCachingBFCAllocator a(new BasicCPUAllocator(-1), 1 << 30,
+                              true /*allow_growth*/, "cpu_bfc");
+  CheckStats(&a, 0, 0, 0, 0);
+
+  std::vector<void*> ptrs;
+  int64 bytes_in_use = 0;
+  int64 max_alloc_size = 0;
+  for (int s = 1; s < 20000; s += 7) {
+    void* raw = a.AllocateRaw(Allocator::kAllocatorAlignment, s);
+    ASSERT_NE(nullptr, raw);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(raw) %
+                     Allocator::kAllocatorAlignment);
+    EXPECT_EQ(s, a.RequestedSize(raw));
+    EXPECT_GE(a.AllocatedSize(raw), s);
+    bytes_in_use += a.AllocatedSize(raw);
+    max_alloc_size = std::max<int64>(max_alloc_size, a.AllocatedSize(raw));
+    ptrs.push_back(raw);
+  }
+  CheckStats(&a, ptrs.size(), bytes_in_use, bytes_in_use, max_alloc_size);
+
+  std::sort(ptrs.begin(), ptrs.end());
+  for (size_t i = 1; i < ptrs.size(); i++) {
+    ASSERT_NE(ptrs[i], ptrs[i - 1]);  // No dups
+    ASSERT_GE(static_cast<char*>(ptrs[i]) - static_cast<char*>(ptrs[i - 1]),
+              a.AllocatedSize(ptrs[i - 1]));
+  }
+
+  for (void* ptr : ptrs) {
+    a.DeallocateRaw(ptr);
+  }
+  // Cached blocks do not count as in use.
+  CheckStats(&a, ptrs.size(), 0, bytes_in_use, max_alloc_size);
+
+  a.ClearStats();
+  CheckStats(&a, 0, 0, 0, 0);
+}
+
+TEST(ThreadCachingBFCAllocatorTest, LargeAlignment) {
+  ThreadCachingBFCAllocator a(new BasicCPUAllocator(-1), 1 << 30,
+                              true /*allow_growth*/, "cpu_bfc");
+  std::vector<void*> ptrs;
+  for (size_t alignment : {128, 256, 4096}) {
+    for (int s : {1, 100, 1000, 20000}) {
+      void* raw = a.AllocateRaw(alignment, s);
+      ASSERT_NE(nullptr, raw);
+      EXPECT_EQ(0, reinterpret_cast<uintptr_t>(raw) % alignment);
+      EXPECT_EQ(s, a.RequestedSize(raw));
+      EXPECT_GE(a.AllocatedSize(raw), s);
+      ptrs.push_back(raw);
+    }
+  }
+  for (void* ptr : ptrs) {
+    a.DeallocateRaw(ptr);
+  }
+  AllocatorStats stats;
+  a.GetStats(&stats);
+  EXPECT_EQ(0, stats.bytes_in_use);
+}
+
+TEST(ThreadCachingBFCAllocatorTest, ReusesCachedBlocks) {
+  ThreadCachingBFCAllocator a(new BasicCPUAllocator(-1), 1 << 30,
+                              true /*allow_growth*/, "cpu_bfc");
+  void* first = a.AllocateRaw(Allocator::kAllocatorAlignment, 100);
+  const int64 first_id = a.AllocationId(first);
+  a.DeallocateRaw(first);
+  // The most recently freed block of a size class is handed out first.
+  void* second = a.AllocateRaw(Allocator::kAllocatorAlignment, 120);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(120, a.RequestedSize(second));
+  EXPECT_GT(a.AllocationId(second), first_id);
+  a.DeallocateRaw(second);
+}
+
+TEST(ThreadCachingBFCAllocatorTest, FlushesCacheWhenOutOfMemory) {
+  const size_t kMemory = 1 << 20;
+  ThreadCachingBFCAllocator a(new BasicCPUAllocator(-1), kMemory,
+                              false /*allow_growth*/, "cpu_bfc");
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 200; ++i) {
+    ptrs.push_back(a.AllocateRaw(Allocator::kAllocatorAlignment, 1000));
+    ASSERT_NE(nullptr, ptrs.back());
+  }
+  for (void* ptr : ptrs) {
+    a.DeallocateRaw(ptr);
+  }
+  // Cached small blocks fragment the only region. A request for all of it
+  // only succeeds once they are returned to the BFCAllocator.
+  void* large = a.AllocateRaw(Allocator::kAllocatorAlignment,
+                              kMemory - Allocator::kAllocatorAlignment);
+  ASSERT_NE(nullptr, large);
+  a.DeallocateRaw(large);
+}
+
+TEST(ThreadCachingBFCAllocatorTest, ConcurrentAllocations) {
+  ThreadCachingBFCAllocator a(new BasicCPUAllocator(-1), 1 << 30,
+                              true /*allow_growth*/, "cpu_bfc");
+  const int kNumThreads = 8;
+  const int kAllocsPerThread = 2000;
+  // Each thread frees the allocations of its neighbour, so blocks migrate
+  // between cache shards.
+  std::vector<std::vector<void*>> ptrs(kNumThreads);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&a, &ptrs, t]() {
+        random::PhiloxRandom philox(t, 17);
+        random::SimplePhilox rand(&philox);
+        for (int i = 0; i < kAllocsPerThread; ++i) {
+          const size_t size = 1 + rand.Uniform(i % 10 == 0 ? 100000 : 4000);
+          void* raw = a.AllocateRaw(Allocator::kAllocatorAlignment, size);
+          ASSERT_NE(nullptr, raw);
+          memset(raw, t, size);
+          ptrs[t].push_back(raw);
+        }
+      });
+    }
+  }
+  AllocatorStats stats;
+  a.GetStats(&stats);
+  EXPECT_EQ(kNumThreads * kAllocsPerThread, stats.num_allocs);
+  int64 bytes_in_use = 0;
+  for (const auto& thread_ptrs : ptrs) {
+    for (void* ptr : thread_ptrs) bytes_in_use += a.AllocatedSize(ptr);
+  }
+  EXPECT_EQ(bytes_in_use, stats.bytes_in_use);
+  EXPECT_EQ(bytes_in_use, stats.max_bytes_in_use);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&a, &ptrs, t]() {
+        for (void* ptr : ptrs[(t + 1) % kNumThreads]) {
+          a.DeallocateRaw(ptr);
+        }
+      });
+    }
+  }
+  a.GetStats(&stats);
+  EXPECT_EQ(0, stats.bytes_in_use);
+}
+
+template <typename AllocatorType>
+void BM_ConcurrentSmallAllocations(int iters, int num_threads) {
+  testing::StopTiming();
+  AllocatorType a(new BasicCPUAllocator(-1), 1 << 30, true /*allow_growth*/,
+                  "cpu_bfc");
+  thread::ThreadPool pool(Env::Default(), "bench", num_threads);
+  testing::StartTiming();
+  {
+    BlockingCounter done(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+      const int n = iters / num_threads + (t < iters % num_threads ? 1 : 0);
+      pool.Schedule([&a, &done, n]() {
+        void* ptrs[8];
+        for (int i = 0; i < n; ++i) {
+          for (int j = 0; j < 8; ++j) {
+            ptrs[j] = a.AllocateRaw(Allocator::kAllocatorAlignment,
+                                    64 * (j + 1));
+          }
+          for (int j = 0; j < 8; ++j) {
+            a.DeallocateRaw(ptrs[j]);
+          }
+        }
+        done.DecrementCount();
+      });
+    }
+    done.Wait();
+  }
+  testing::StopTiming();
+}
+
+void BM_BFCAllocator(int iters, int num_threads) {
+  BM_ConcurrentSmallAllocations<BFCAllocator>(iters, num_threads);
+}
+void BM_ThreadCachingBFCAllocator(int iters, int num_threads) {
+  BM_ConcurrentSmallAllocations<ThreadCachingBFCAllocator>(iters,
+                                                          num_threads);
+}
+
+BENCHMARK(BM_BFCAllocator)->Arg(1)->Arg(4)->Arg(16);
+BENCHMARK(BM_ThreadCachingBFCAllocator)->Arg(1)->Arg(4)->Arg(16);
+
+}  // namespace
+}  // namespace tensorflow
@@ -18,7 +18,10 @@ limitations under the License.
 
 #include <vector>
 #include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/process_state.h"
+#include "tensorflow/core/common_runtime/visitable_allocator.h"
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/public/session_options.h"
 
 namespace tensorflow {
@@ -28,17 +31,41 @@ class ThreadPoolDeviceFactory : public DeviceFactory {
  public:
   Status CreateDevices(const SessionOptions& options, const string& name_prefix,
                        std::vector<Device*>* devices) override {
-    // TODO(zhifengc/tucker): Figure out the number of available CPUs
-    // and/or NUMA configuration.
-    int n = 1;
+    // TODO(zhifengc/tucker): Figure out the number of available CPUs.
+    const bool use_numa_affinity =
+        options.config.experimental().use_numa_affinity();
+    const int num_numa_nodes = port::NUMANumNodes();
+    // With NUMA affinity, CPU:0 is followed by one device per NUMA node.
+    int n = use_numa_affinity ? 1 + num_numa_nodes : 1;
     auto iter = options.config.device_count().find("CPU");
     if (iter != options.config.device_count().end()) {
       n = iter->second;
     }
+    if (use_numa_affinity) {
+      ProcessState::singleton()->EnableNUMA();
+    }
+    if (options.config.experimental().use_host_allocator_thread_cache()) {
+      ProcessState::singleton()->EnableBFCThreadCache();
+    }
     for (int i = 0; i < n; i++) {
       string name = strings::StrCat(name_prefix, "/device:CPU:", i);
-      devices->push_back(new ThreadPoolDevice(
-          options, name, Bytes(256 << 20), DeviceLocality(), cpu_allocator()));
+      if (use_numa_affinity && i > 0) {
+        // CPU:0, where unconstrained ops are placed, spans all nodes like
+        // the device created without NUMA affinity. The other devices are
+        // assigned to the nodes round-robin, and each uses memory of its
+        // own node.
+        const int numa_node = (i - 1) % num_numa_nodes;
+        DeviceLocality locality;
+        locality.set_numa_node(numa_node);
+        devices->push_back(new ThreadPoolDevice(
+            options, name, Bytes(256 << 20), locality,
+            ProcessState::singleton()->GetCPUAllocator(numa_node)));
+      } else {
+        DeviceLocality locality;
+        if (use_numa_affinity) locality.set_numa_node(port::kNUMANoAffinity);
+        devices->push_back(new ThreadPoolDevice(
+            options, name, Bytes(256 << 20), locality, cpu_allocator()));
+      }
     }
 
     return Status::OK();
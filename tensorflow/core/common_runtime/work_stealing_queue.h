@@ -0,0 +1,123 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_WORK_STEALING_QUEUE_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_WORK_STEALING_QUEUE_H_
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A set of per-worker deques ("lanes") with work stealing.
+//
+// Each worker owns one lane. The owner pushes and pops at the bottom of its
+// lane (LIFO), so the item it produced most recently -- typically a consumer
+// of data that is still hot in its cache -- is the next one it runs. Idle
+// workers steal from the top (FIFO end) of other lanes, which takes the
+// oldest, and usually largest, pieces of outstanding work.
+//
+// Every lane is protected by its own mutex, so contention is limited to an
+// owner and the occasional thief rather than every thread in the process.
+//
+// Example:
+//   WorkStealingQueues<Task> queues(num_workers);
+//   // Worker 'w':
+//   queues.Push(w, task);
+//   Task t;
+//   while (queues.PopOrSteal(w, &t)) Run(t);
+template <typename T>
+class WorkStealingQueues {
+ public:
+  explicit WorkStealingQueues(int num_lanes) : size_(0) {
+    CHECK_GT(num_lanes, 0);
+    lanes_.reserve(num_lanes);
+    for (int i = 0; i < num_lanes; ++i) {
+      lanes_.emplace_back(new Lane);
+    }
+  }
+
+  int num_lanes() const { return static_cast<int>(lanes_.size()); }
+
+  // Returns the total number of queued items across all lanes. The value
+  // may be stale by the time the caller looks at it.
+  int64 Size() const { return size_.load(std::memory_order_seq_cst); }
+
+  bool Empty() const { return Size() == 0; }
+
+  // Pushes 'item' at the bottom of 'lane'.
+  void Push(int lane, const T& item) {
+    Lane* l = lanes_[lane].get();
+    mutex_lock guard(l->mu);
+    l->items.push_back(item);
+    size_.fetch_add(1, std::memory_order_seq_cst);
+  }
+
+  // Pops the most recently pushed item of 'lane' into '*item'. If 'lane' is
+  // empty, steals the oldest item of the first non-empty lane, scanning
+  // from 'lane + 1' onwards. Returns false iff no item was found.
+  bool PopOrSteal(int lane, T* item) {
+    if (Size() == 0) return false;
+    if (PopBottom(lanes_[lane].get(), item)) return true;
+    const int n = num_lanes();
+    for (int i = 1; i < n; ++i) {
+      if (PopTop(lanes_[(lane + i) % n].get(), item)) return true;
+    }
+    return false;
+  }
+
+ private:
+  // Each lane lives on its own cache line so that owners do not false-share.
+  struct Lane {
+    mutex mu;
+    std::deque<T> items GUARDED_BY(mu);
+    char padding[64];
+  };
+
+  bool PopBottom(Lane* l, T* item) {
+    mutex_lock guard(l->mu);
+    if (l->items.empty()) return false;
+    *item = std::move(l->items.back());
+    l->items.pop_back();
+    size_.fetch_sub(1, std::memory_order_seq_cst);
+    return true;
+  }
+
+  bool PopTop(Lane* l, T* item) {
+    mutex_lock guard(l->mu);
+    if (l->items.empty()) return false;
+    *item = std::move(l->items.front());
+    l->items.pop_front();
+    size_.fetch_sub(1, std::memory_order_seq_cst);
+    return true;
+  }
+
+  std::vector<std::unique_ptr<Lane>> lanes_;
+  std::atomic<int64> size_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(WorkStealingQueues);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_WORK_STEALING_QUEUE_H_
@@ -0,0 +1,92 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/work_stealing_queue.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(WorkStealingQueuesTest, OwnerPopsLifo) {
+  WorkStealingQueues<int> queues(2);
+  queues.Push(0, 1);
+  queues.Push(0, 2);
+  queues.Push(0, 3);
+  EXPECT_EQ(3, queues.Size());
+  int item = -1;
+  ASSERT_TRUE(queues.PopOrSteal(0, &item));
+  EXPECT_EQ(3, item);
+  ASSERT_TRUE(queues.PopOrSteal(0, &item));
+  EXPECT_EQ(2, item);
+  ASSERT_TRUE(queues.PopOrSteal(0, &item));
+  EXPECT_EQ(1, item);
+  EXPECT_FALSE(queues.PopOrSteal(0, &item));
+  EXPECT_TRUE(queues.Empty());
+}
+
+TEST(WorkStealingQueuesTest, ThiefStealsOldest) {
+  WorkStealingQueues<int> queues(3);
+  queues.Push(0, 1);
+  queues.Push(0, 2);
+  int item = -1;
+  // Lane 1 is empty, so it steals the oldest item of lane 0.
+  ASSERT_TRUE(queues.PopOrSteal(1, &item));
+  EXPECT_EQ(1, item);
+  ASSERT_TRUE(queues.PopOrSteal(2, &item));
+  EXPECT_EQ(2, item);
+  EXPECT_FALSE(queues.PopOrSteal(1, &item));
+}
+
+TEST(WorkStealingQueuesTest, ConcurrentPushAndSteal) {
+  const int kLanes = 4;
+  const int kItemsPerLane = 10000;
+  WorkStealingQueues<int> queues(kLanes);
+  std::atomic<int64> sum(0);
+  std::atomic<int> count(0);
+  {
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int lane = 0; lane < kLanes; ++lane) {
+      threads.emplace_back(Env::Default()->StartThread(
+          ThreadOptions(), "worker", [lane, &queues, &sum, &count]() {
+            for (int i = 1; i <= kItemsPerLane; ++i) {
+              queues.Push(lane, i);
+              int item;
+              if (i % 2 == 0 && queues.PopOrSteal(lane, &item)) {
+                sum += item;
+                ++count;
+              }
+            }
+          }));
+    }
+  }
+  int item;
+  while (queues.PopOrSteal(0, &item)) {
+    sum += item;
+    ++count;
+  }
+  EXPECT_EQ(kLanes * kItemsPerLane, count);
+  EXPECT_EQ(static_cast<int64>(kLanes) * kItemsPerLane * (kItemsPerLane + 1) / 2,
+            sum);
+  EXPECT_TRUE(queues.Empty());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,152 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Runs collective ops across several local server processes, so that data
+// moves through CollectiveRemoteAccessDistributed.
+
+#include "tensorflow/core/distributed_runtime/rpc/grpc_session.h"
+#include "tensorflow/core/distributed_runtime/rpc/grpc_testlib.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+const int kNumTasks = 3;
+const int kShardElts = 4;
+const char kGroupLeader[] = "/job:localhost/replica:0/task:0";
+
+string TaskDevice(int task) {
+  return strings::StrCat("/job:localhost/replica:0/task:", task, "/cpu:0");
+}
+
+class GrpcCollectiveTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SessionOptions options;
+    (*options.config.mutable_device_count())["CPU"] = 1;
+    options.config.mutable_experimental()->set_collective_group_leader(
+        kGroupLeader);
+    TF_ASSERT_OK(
+        test::TestCluster::MakeTestCluster(options, kNumTasks, &cluster_));
+  }
+
+  // Adds to "graph" a Const holding "value" and a collective "op" consuming
+  // it, both placed on "task".  Returns the collective node.
+  Node* AddCollective(Graph* graph, const string& op, int task,
+                      const Tensor& value) {
+    Node* input = test::graph::Constant(graph, value);
+    input->set_requested_device(TaskDevice(task));
+    NodeBuilder builder(graph->NewName("collective"), op);
+    builder.Input(input)
+        .Attr("group_size", kNumTasks)
+        .Attr("group_key", 1)
+        .Attr("instance_key", 1)
+        .Device(TaskDevice(task));
+    if (op == "CollectiveReduceScatter") {
+      builder.Attr("merge_op", "Add").Attr("final_op", "Id");
+    }
+    Node* ret;
+    TF_CHECK_OK(builder.Finalize(graph, &ret));
+    return ret;
+  }
+
+  // Runs the fetches "nodes" of "graph" in one step.
+  void Run(Graph* graph, const std::vector<Node*>& nodes,
+           std::vector<Tensor>* outputs) {
+    GraphDef def;
+    test::graph::ToGraphDef(graph, &def);
+    SessionOptions options;
+    options.target = strings::StrCat("grpc://", cluster_->targets()[0]);
+    options.config.mutable_graph_options()
+        ->mutable_optimizer_options()
+        ->set_opt_level(OptimizerOptions::L0);
+    std::unique_ptr<Session> session(NewSession(options));
+    ASSERT_TRUE(session != nullptr);
+    TF_ASSERT_OK(session->Create(def));
+    std::vector<string> fetches;
+    for (Node* n : nodes) fetches.push_back(n->name());
+    RunOptions run_options;
+    run_options.mutable_experimental()->set_collective_graph_key(1);
+    RunMetadata run_metadata;
+    TF_ASSERT_OK(session->Run(run_options, {}, fetches, {}, outputs,
+                              &run_metadata));
+    TF_ASSERT_OK(session->Close());
+  }
+
+  std::unique_ptr<test::TestCluster> cluster_;
+};
+
+TEST_F(GrpcCollectiveTest, AllGather) {
+  Graph graph(OpRegistry::Global());
+  std::vector<Node*> nodes;
+  for (int t = 0; t < kNumTasks; ++t) {
+    Tensor value(DT_FLOAT, TensorShape({kShardElts}));
+    for (int i = 0; i < kShardElts; ++i) {
+      value.flat<float>()(i) = t * kShardElts + i;
+    }
+    nodes.push_back(AddCollective(&graph, "CollectiveAllGather", t, value));
+  }
+  std::vector<Tensor> outputs;
+  Run(&graph, nodes, &outputs);
+
+  Tensor expected(DT_FLOAT, TensorShape({kNumTasks * kShardElts}));
+  for (int i = 0; i < kNumTasks * kShardElts; ++i) {
+    expected.flat<float>()(i) = i;
+  }
+  ASSERT_EQ(kNumTasks, outputs.size());
+  for (const Tensor& output : outputs) {
+    test::ExpectTensorEqual<float>(expected, output);
+  }
+}
+
+TEST_F(GrpcCollectiveTest, ReduceScatter) {
+  Graph graph(OpRegistry::Global());
+  std::vector<Node*> nodes;
+  for (int t = 0; t < kNumTasks; ++t) {
+    Tensor value(DT_FLOAT, TensorShape({kNumTasks * kShardElts}));
+    for (int i = 0; i < kNumTasks * kShardElts; ++i) {
+      value.flat<float>()(i) = t + i;
+    }
+    nodes.push_back(
+        AddCollective(&graph, "CollectiveReduceScatter", t, value));
+  }
+  std::vector<Tensor> outputs;
+  Run(&graph, nodes, &outputs);
+
+  // Task t gets the sum of shard t over all tasks.
+  const float task_sum = kNumTasks * (kNumTasks - 1) / 2;
+  ASSERT_EQ(kNumTasks, outputs.size());
+  for (int t = 0; t < kNumTasks; ++t) {
+    Tensor expected(DT_FLOAT, TensorShape({kShardElts}));
+    for (int i = 0; i < kShardElts; ++i) {
+      expected.flat<float>()(i) =
+          kNumTasks * (t * kShardElts + i) + task_sum;
+    }
+    test::ExpectTensorEqual<float>(expected, outputs[t]);
+  }
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_remote_worker.h"
 
+#include <algorithm>
 #include <utility>
 
 #include "grpcpp/generic/generic_stub.h"
@@ -31,6 +32,8 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
@@ -185,6 +188,24 @@ class GrpcRemoteWorker : public WorkerInterface {
           std::vector<string> key_parts = str_util::Split(key, ';');
           if (key_parts.size() != 5) {
             LOG(WARNING) << "Bad key: " << key;
+          } else if (response->metadata().has_compressed_content()) {
+            const CompressedTensorContent& compressed =
+                response->metadata().compressed_content();
+            string details = strings::StrCat(
+                "[", bytes, "B as ", compressed.compressed_bytes(), "B ",
+                TensorCompression::Codec_Name(compressed.codec()),
+                strings::Printf(
+                    " ratio %.2f",
+                    static_cast<double>(compressed.uncompressed_bytes()) /
+                        std::max<int64>(1, compressed.compressed_bytes())),
+                " compress ", compressed.compress_micros(), "us uncompress ",
+                compressed.uncompress_micros(), "us] ", key_parts[3], " from ",
+                key_parts[0], " to ", key_parts[2]);
+            logger_->RecordDataTransfer(step_id, send_start_usec, end_usec,
+                                        key_parts[3],  // tensor name
+                                        key_parts[0],  // src_device
+                                        key_parts[2],  // dst_device
+                                        bytes, details, "RecvTensor");
           } else {
             logger_->RecordRecvTensor(step_id, send_start_usec, end_usec,
                                       key_parts[3],  // tensor name
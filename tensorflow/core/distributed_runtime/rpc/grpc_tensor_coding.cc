@@ -17,6 +17,7 @@ limitations under the License.
 #include "grpcpp/support/byte_buffer.h"
 #include "grpcpp/support/slice.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_reference.h"
@@ -242,5 +243,25 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
   }
 }
 
+void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
+                              const TensorCompression& compression,
+                              ::grpc::ByteBuffer* result) {
+  if (!is_dead && (compression.codec() != TensorCompression::NONE ||
+                   compression.float_codec() != TensorCompression::NONE)) {
+    // The compressed contents are a copy anyway, so there is no point in
+    // hand-encoding the response to share the tensor buffer.
+    RecvTensorResponse response;
+    response.set_send_start_micros(Env::Default()->NowMicros());
+    if (CompressTensorContent(compression, val,
+                              response.mutable_compressed_content())) {
+      response.mutable_tensor()->set_dtype(val.dtype());
+      val.shape().AsProto(response.mutable_tensor()->mutable_tensor_shape());
+      EncodeRecvTensorResponseToByteBuffer(response, result);
+      return;
+    }
+  }
+  EncodeTensorToByteBuffer(is_dead, val, result);
+}
+
 }  // namespace grpc
 }  // namespace tensorflow
@@ -22,6 +22,7 @@ class ByteBuffer;
 
 namespace tensorflow {
 class Tensor;
+class TensorCompression;
 class RecvTensorResponse;
 
 // TODO(jeff,sanjay): this should not be grpc specific.  Instead of
@@ -51,6 +52,14 @@ void EncodeRecvTensorResponseToByteBuffer(const RecvTensorResponse& proto,
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
                               ::grpc::ByteBuffer* result);
 
+// Like the above, but compresses the contents of "val" as requested by
+// "compression" when that makes them smaller. The result is then parseable
+// as a RecvTensorResponse holding the dtype and shape of "val" in "tensor"
+// and its compressed contents in "compressed_content".
+void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
+                              const TensorCompression& compression,
+                              ::grpc::ByteBuffer* result);
+
 }  // namespace grpc
 }  // namespace tensorflow
 
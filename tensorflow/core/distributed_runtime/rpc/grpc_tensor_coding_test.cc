@@ -17,8 +17,10 @@ limitations under the License.
 
 #include "grpcpp/support/byte_buffer.h"
 #include "grpcpp/support/slice.h"
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
@@ -100,4 +102,46 @@ TEST_F(GrpcTensorCodingTest, Simple) {
 
 TEST_F(GrpcTensorCodingTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(GrpcTensorCodingTest, CompressedTensor) {
+  Tensor t(DT_FLOAT, TensorShape({10, 100}));
+  test::FillFn<float>(&t, [](int i) -> float { return (i % 7) * 0.5f; });
+  TensorCompression compression;
+  compression.set_float_codec(TensorCompression::BFLOAT16);
+
+  ::grpc::ByteBuffer buf;
+  grpc::EncodeTensorToByteBuffer(false, t, compression, &buf);
+  std::vector<::grpc::Slice> slices;
+  (void)buf.Dump(&slices);
+  string tmp;
+  for (const auto& s : slices) {
+    tmp.append(reinterpret_cast<const char*>(s.begin()), s.size());
+  }
+  RecvTensorResponse response;
+  ASSERT_TRUE(response.ParseFromString(tmp));
+  EXPECT_FALSE(response.is_dead());
+  EXPECT_EQ(TensorCompression::BFLOAT16,
+            response.compressed_content().codec());
+  EXPECT_TRUE(response.tensor().tensor_content().empty());
+
+  TensorProto* proto = response.mutable_tensor();
+  TF_ASSERT_OK(UncompressTensorContent(response.compressed_content(), proto));
+  Tensor result;
+  ASSERT_TRUE(result.FromProto(*proto));
+  test::ExpectTensorEqual<float>(t, result);
+
+  // Tensors below the size threshold are sent as is.
+  compression.set_min_bytes(t.TotalBytes() + 1);
+  grpc::EncodeTensorToByteBuffer(false, t, compression, &buf);
+  slices.clear();
+  (void)buf.Dump(&slices);
+  tmp.clear();
+  for (const auto& s : slices) {
+    tmp.append(reinterpret_cast<const char*>(s.begin()), s.size());
+  }
+  ASSERT_TRUE(response.ParseFromString(tmp));
+  EXPECT_FALSE(response.has_compressed_content());
+  ASSERT_TRUE(result.FromProto(response.tensor()));
+  test::ExpectTensorEqual<float>(t, result);
+}
+
 }  // namespace tensorflow
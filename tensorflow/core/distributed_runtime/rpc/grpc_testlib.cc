@@ -25,6 +25,14 @@ namespace test {
 
 Status TestCluster::MakeTestCluster(const SessionOptions& options, int n,
                                     std::unique_ptr<TestCluster>* out_cluster) {
+  return MakeTestCluster("core/distributed_runtime/rpc/grpc_testlib_server",
+                         "grpc", options, n, out_cluster);
+}
+
+Status TestCluster::MakeTestCluster(const string& binary_path,
+                                    const string& protocol,
+                                    const SessionOptions& options, int n,
+                                    std::unique_ptr<TestCluster>* out_cluster) {
   CHECK_GE(n, 1);
   std::unique_ptr<TestCluster> ret(new TestCluster);
 
@@ -52,17 +60,22 @@ Status TestCluster::MakeTestCluster(const SessionOptions& options, int n,
 
   for (int i = 0; i < n; ++i) {
     string server_file =
-        strings::StrCat(testing::TensorFlowSrcRoot(),
-                        "/core/distributed_runtime/rpc/grpc_testlib_server");
+        strings::StrCat(testing::TensorFlowSrcRoot(), "/", binary_path);
     if (!options.env->FileExists(server_file).ok()) {
-      return errors::Internal("Could not find grpc_testlib_server");
+      return errors::Internal("Could not find ", binary_path);
     }
-    const std::vector<string> argv(
+    std::vector<string> argv(
         {server_file,
          /* see grpc_testlib_server.cc for flags */
          tf_jobs, "--tf_job=localhost", strings::StrCat("--tf_task=", i),
          strings::StrCat("--num_cpus=", num_cpus),
-         strings::StrCat("--num_gpus=", num_gpus)});
+         strings::StrCat("--num_gpus=", num_gpus),
+         strings::StrCat("--tf_protocol=", protocol)});
+    const string& leader =
+        options.config.experimental().collective_group_leader();
+    if (!leader.empty()) {
+      argv.push_back(strings::StrCat("--collective_group_leader=", leader));
+    }
     ret->subprocesses_.emplace_back(CreateSubProcess(argv));
     bool success = ret->subprocesses_[i]->Start();
     if (!success) {
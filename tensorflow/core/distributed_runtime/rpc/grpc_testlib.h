@@ -49,6 +49,14 @@ class TestCluster {
   // returned.
   static Status MakeTestCluster(const SessionOptions& options, int n,
                                 std::unique_ptr<TestCluster>* out_cluster);
+  // Same as above, but runs the servers with "binary_path", a server that
+  // accepts the flags of grpc_testlib_server, relative to the TensorFlow
+  // source root, e.g. "contrib/shm/shm_testlib_server". The servers use
+  // the RPC protocol "protocol", e.g. "grpc+shm".
+  static Status MakeTestCluster(const string& binary_path,
+                                const string& protocol,
+                                const SessionOptions& options, int n,
+                                std::unique_ptr<TestCluster>* out_cluster);
   ~TestCluster();
 
   // Returns a vector of string "<hostname>:<port>" pairs that may be
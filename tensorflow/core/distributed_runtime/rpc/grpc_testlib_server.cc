@@ -36,9 +36,10 @@ namespace tensorflow {
 namespace {
 
 Status FillServerDef(const string& job_spec, const string& job_name,
-                     int num_cpus, int num_gpus, int task_index,
+                     const string& protocol, int num_cpus, int num_gpus,
+                     int task_index, const string& collective_group_leader,
                      ServerDef* options) {
-  options->set_protocol("grpc");
+  options->set_protocol(protocol);
   options->set_job_name(job_name);
   options->set_task_index(task_index);
 
@@ -69,6 +70,10 @@ Status FillServerDef(const string& job_spec, const string& job_name,
   ConfigProto* config = options->mutable_default_session_config();
   (*config->mutable_device_count())["CPU"] = num_cpus;
   (*config->mutable_device_count())["GPU"] = num_gpus;
+  if (!collective_group_leader.empty()) {
+    config->mutable_experimental()->set_collective_group_leader(
+        collective_group_leader);
+  }
   return Status::OK();
 }
 
@@ -79,15 +84,21 @@ int main(int argc, char* argv[]) {
   tensorflow::port::InitMain(argv[0], &argc, &argv);
   tensorflow::string job_spec;
   tensorflow::string job_name;
+  tensorflow::string protocol = "grpc";
   int num_cpus = 1;
   int num_gpus = 0;
   int task_index = 0;
+  tensorflow::string collective_group_leader;
   std::vector<tensorflow::Flag> flag_list = {
       tensorflow::Flag("tf_jobs", &job_spec, "job specification"),
       tensorflow::Flag("tf_job", &job_name, "job name"),
       tensorflow::Flag("tf_task", &task_index, "task index"),
+      tensorflow::Flag("tf_protocol", &protocol,
+                       "RPC protocol of the server, e.g. grpc+shm"),
       tensorflow::Flag("num_cpus", &num_cpus, "number of CPUs"),
       tensorflow::Flag("num_gpus", &num_gpus, "number of GPUs"),
+      tensorflow::Flag("collective_group_leader", &collective_group_leader,
+                       "task name of the collective group leader"),
   };
   tensorflow::string usage = tensorflow::Flags::Usage(argv[0], flag_list);
   const bool parse_result = tensorflow::Flags::Parse(&argc, argv, flag_list);
@@ -97,8 +108,10 @@ int main(int argc, char* argv[]) {
   }
 
   tensorflow::ServerDef def;
-  tensorflow::Status s = tensorflow::FillServerDef(job_spec, job_name, num_cpus,
-                                                   num_gpus, task_index, &def);
+  tensorflow::Status s =
+      tensorflow::FillServerDef(job_spec, job_name, protocol, num_cpus,
+                                num_gpus, task_index, collective_group_leader,
+                                &def);
   if (!s.ok()) {
     LOG(ERROR) << "Could not parse job spec: " << s.error_message() << "\n"
                << usage;
@@ -39,8 +39,10 @@ namespace {
 
 class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  public:
-  RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id)
-      : BaseRemoteRendezvous(env, step_id) {}
+  RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id,
+                      const TensorCompressionPolicy& compression_policy)
+      : BaseRemoteRendezvous(env, step_id),
+        compression_policy_(compression_policy) {}
 
  protected:
   void RecvFromRemoteAsync(const Rendezvous::ParsedKey& parsed,
@@ -50,6 +52,8 @@ class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  private:
   ~RpcRemoteRendezvous() override {}
 
+  const TensorCompressionPolicy compression_policy_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRemoteRendezvous);
 };
 
@@ -240,6 +244,10 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
 
   call->Init(rwi, step_id_, parsed.FullKey(), recv_args.alloc_attrs, dst_device,
              recv_args, std::move(done));
+  if (compression_policy_.enabled()) {
+    compression_policy_.Get(parsed.edge_name,
+                            call->req_.mutable_compression());
+  }
 
   // Record "call" in active_ so that it can be aborted cleanly.
   RegisterCall(call);
@@ -265,9 +273,13 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
 RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env)
     : BaseRendezvousMgr(env) {}
 
+RpcRendezvousMgr::RpcRendezvousMgr(
+    const WorkerEnv* env, const TensorCompressionPolicy& compression_policy)
+    : BaseRendezvousMgr(env), compression_policy_(compression_policy) {}
+
 BaseRemoteRendezvous* RpcRendezvousMgr::Create(int64 step_id,
                                                const WorkerEnv* worker_env) {
-  return new RpcRemoteRendezvous(worker_env, step_id);
+  return new RpcRemoteRendezvous(worker_env, step_id, compression_policy_);
 }
 
 }  // end namespace tensorflow
@@ -18,8 +18,10 @@ limitations under the License.
 #include "google/protobuf/any.pb.h"
 
 #include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace tensorflow {
 
@@ -53,6 +55,7 @@ void TensorResponse::InitAlloc(DeviceBase* d, const AllocatorAttributes& aa) {
 Status TensorResponse::InitFrom(RecvTensorResponse* response) {
   Status s;
   meta_.Swap(response);
+  TF_RETURN_IF_ERROR(UncompressContent());
   if (on_host_) {
     if (!tensor_.FromProto(allocator_, meta_.tensor())) {
       s = errors::InvalidArgument("Cannot parse tensor from response");
@@ -87,6 +90,7 @@ Status TensorResponse::ParseFrom(Source* source) {
     if (!meta_.ParseFromCodedStream(&input) || !input.ConsumedEntireMessage()) {
       return errors::InvalidArgument("Cannot parse tensor from response");
     }
+    TF_RETURN_IF_ERROR(UncompressContent());
     Status s =
         device_->MakeTensorFromProto(meta_.tensor(), alloc_attrs_, &tensor_);
     // Reduce memory usage for big tensors.
@@ -101,10 +105,37 @@ Status TensorResponse::ParseFrom(Source* source) {
     ClearTensor();
   }
   already_used_ = true;
-  if (ParseFast(source)) return Status::OK();
+  if (ParseFast(source)) return UncompressIntoTensor();
   meta_.Clear();
-  if (ParseSlow(source)) return Status::OK();
-  return errors::InvalidArgument("Cannot parse tensor from response");
+  return ParseSlow(source);
+}
+
+Status TensorResponse::UncompressContent() {
+  if (!meta_.has_compressed_content()) {
+    return Status::OK();
+  }
+  const uint64 start_micros = Env::Default()->NowMicros();
+  CompressedTensorContent* compressed = meta_.mutable_compressed_content();
+  TF_RETURN_IF_ERROR(
+      UncompressTensorContent(*compressed, meta_.mutable_tensor()));
+  // Keep the metadata about the compression, but not the data.
+  string().swap(*compressed->mutable_data());
+  compressed->set_uncompress_micros(Env::Default()->NowMicros() -
+                                    start_micros);
+  return Status::OK();
+}
+
+Status TensorResponse::UncompressIntoTensor() {
+  if (!meta_.has_compressed_content()) {
+    return Status::OK();
+  }
+  const uint64 start_micros = Env::Default()->NowMicros();
+  CompressedTensorContent* compressed = meta_.mutable_compressed_content();
+  TF_RETURN_IF_ERROR(UncompressTensorContent(*compressed, &tensor_));
+  string().swap(*compressed->mutable_data());
+  compressed->set_uncompress_micros(Env::Default()->NowMicros() -
+                                    start_micros);
+  return Status::OK();
 }
 
 // Define some helper routines for decoding protocol buffer wire format data
@@ -260,6 +291,15 @@ bool TensorResponse::ParseFast(Source* source) {
           return false;
         break;
       }
+      case RecvTensorResponse::kCompressedContentFieldNumber: {
+        // The tensor submessage then has no content, so tensor_ is
+        // allocated uninitialized and the content is decoded straight into
+        // it by ParseFrom().
+        if ((wt != WIRETYPE_LENGTH_DELIMITED) ||
+            !ReadNestedMessage(&input, meta_.mutable_compressed_content()))
+          return false;
+        break;
+      }
       default: {
         // Unknown tag, so don't handle we can't handle on the fast path
         return false;
@@ -270,16 +310,28 @@ bool TensorResponse::ParseFast(Source* source) {
   return false;
 }
 
-bool TensorResponse::ParseSlow(Source* source) {
+Status TensorResponse::ParseSlow(Source* source) {
   if (!meta_.ParseFromZeroCopyStream(source->contents())) {
-    return false;
+    return errors::InvalidArgument("Cannot parse tensor from response");
   }
 
-  Tensor parsed(meta_.tensor().dtype());
-  if (!parsed.FromProto(allocator_, meta_.tensor())) {
-    return false;
+  if (meta_.has_compressed_content()) {
+    const TensorProto& proto = meta_.tensor();
+    TF_RETURN_IF_ERROR(TensorShape::IsValidShape(proto.tensor_shape()));
+    if (!DataTypeCanUseMemcpy(proto.dtype())) {
+      return errors::InvalidArgument("Cannot uncompress a tensor of type ",
+                                     DataTypeString(proto.dtype()));
+    }
+    tensor_ = Tensor(allocator_, proto.dtype(),
+                     TensorShape(proto.tensor_shape()));
+    TF_RETURN_IF_ERROR(UncompressIntoTensor());
+  } else {
+    Tensor parsed(meta_.tensor().dtype());
+    if (!parsed.FromProto(allocator_, meta_.tensor())) {
+      return errors::InvalidArgument("Cannot parse tensor from response");
+    }
+    tensor_ = std::move(parsed);
   }
-  tensor_ = std::move(parsed);
 
   // Reduce memory usage for big tensors.
   {
@@ -288,7 +340,7 @@ bool TensorResponse::ParseSlow(Source* source) {
   }
   meta_.clear_tensor();
 
-  return true;
+  return Status::OK();
 }
 
 }  // namespace tensorflow
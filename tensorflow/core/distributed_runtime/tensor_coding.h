@@ -94,7 +94,14 @@ class TensorResponse {
   bool ParseTensorSubmessage(protobuf::io::CodedInputStream* input,
                              TensorProto* tensor_meta);
   bool ParseFast(Source* source);
-  bool ParseSlow(Source* source);
+  Status ParseSlow(Source* source);
+
+  // Decodes meta_.compressed_content(), if any, into meta_.tensor().
+  Status UncompressContent();
+
+  // Decodes meta_.compressed_content(), if any, into tensor_, which must
+  // already be allocated with the dtype and shape of the tensor.
+  Status UncompressIntoTensor();
 
   bool on_host_ = false;
   DeviceBase* device_ = nullptr;
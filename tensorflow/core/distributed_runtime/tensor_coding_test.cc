@@ -15,10 +15,13 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
 
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
 #include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
@@ -156,6 +159,60 @@ TEST_F(TensorResponseTest, Simple) {
 
 TEST_F(TensorResponseTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(TensorResponseTest, CompressedContent) {
+  Tensor src(DT_FLOAT, TensorShape({10, 100}));
+  test::FillFn<float>(&src, [](int i) -> float { return (i % 7) * 0.5f; });
+  TensorCompression compression;
+  compression.set_float_codec(TensorCompression::FLOAT16);
+  RecvTensorResponse proto;
+  proto.set_send_start_micros(123456);
+  ASSERT_TRUE(CompressTensorContent(compression, src,
+                                    proto.mutable_compressed_content()));
+  proto.mutable_tensor()->set_dtype(src.dtype());
+  src.shape().AsProto(proto.mutable_tensor()->mutable_tensor_shape());
+  string encoded;
+  proto.AppendToString(&encoded);
+
+  StringSource source(&encoded, 1024);
+  TensorResponse response;
+  DummyDevice cpu_device(Env::Default());
+  response.InitAlloc(&cpu_device, AllocatorAttributes());
+  TF_ASSERT_OK(response.ParseFrom(&source));
+  EXPECT_EQ(123456, response.metadata().send_start_micros());
+  test::ExpectTensorEqual<float>(src, response.tensor());
+
+  // The compression is still described, but its data has been released.
+  const CompressedTensorContent& compressed =
+      response.metadata().compressed_content();
+  EXPECT_EQ(TensorCompression::FLOAT16, compressed.codec());
+  EXPECT_EQ(2000, compressed.compressed_bytes());
+  EXPECT_EQ(4000, compressed.uncompressed_bytes());
+  EXPECT_TRUE(compressed.data().empty());
+}
+
+TEST_F(TensorResponseTest, CorruptCompressedContent) {
+  Tensor src(DT_FLOAT, TensorShape({10, 100}));
+  test::FillFn<float>(&src, [](int i) -> float { return i * 0.5f; });
+  TensorCompression compression;
+  compression.set_float_codec(TensorCompression::FLOAT16);
+  RecvTensorResponse proto;
+  ASSERT_TRUE(CompressTensorContent(compression, src,
+                                    proto.mutable_compressed_content()));
+  // Truncate the encoded values.
+  proto.mutable_compressed_content()->mutable_data()->resize(100);
+  proto.mutable_tensor()->set_dtype(src.dtype());
+  src.shape().AsProto(proto.mutable_tensor()->mutable_tensor_shape());
+  string encoded;
+  proto.AppendToString(&encoded);
+
+  StringSource source(&encoded, 1024);
+  TensorResponse response;
+  DummyDevice cpu_device(Env::Default());
+  response.InitAlloc(&cpu_device, AllocatorAttributes());
+  const Status s = response.ParseFrom(&source);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+}
+
 string MakeFloatTensorTestCase(int num_elems) {
   std::vector<int8> v(num_elems);
   for (int i = 0; i < num_elems; i++) {
@@ -0,0 +1,338 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/snappy.h"
+
+namespace tensorflow {
+
+namespace {
+
+const char kDefaultGradientNamePattern[] = "gradients";
+const int64 kDefaultMinBytes = 4096;
+
+bool IsLossy(TensorCompression::Codec codec) {
+  return codec == TensorCompression::FLOAT16 ||
+         codec == TensorCompression::BFLOAT16 ||
+         codec == TensorCompression::TOP_K;
+}
+
+void EncodeFloat16(const Tensor& val, string* data) {
+  const auto flat = val.flat<float>();
+  data->resize(flat.size() * sizeof(Eigen::half));
+  Eigen::half* out = reinterpret_cast<Eigen::half*>(&(*data)[0]);
+  for (int64 i = 0; i < flat.size(); ++i) {
+    out[i] = Eigen::half(flat(i));
+  }
+}
+
+void EncodeBFloat16(const Tensor& val, string* data) {
+  const auto flat = val.flat<float>();
+  data->resize(flat.size() * sizeof(bfloat16));
+  FloatToBFloat16(flat.data(), reinterpret_cast<bfloat16*>(&(*data)[0]),
+                  flat.size());
+}
+
+// Encodes the number of values sent, the varint deltas between their
+// increasing indices, and then the values themselves.
+bool EncodeTopK(const Tensor& val, float fraction, string* data) {
+  const auto flat = val.flat<float>();
+  const int64 n = flat.size();
+  if (n > kint32max || fraction <= 0 || fraction >= 1) {
+    return false;
+  }
+  const int64 k = std::max<int64>(1, static_cast<int64>(fraction * n));
+  std::vector<int32> indices(n);
+  std::iota(indices.begin(), indices.end(), 0);
+  std::nth_element(indices.begin(), indices.begin() + k - 1, indices.end(),
+                   [&flat](int32 a, int32 b) {
+                     return std::abs(flat(a)) > std::abs(flat(b));
+                   });
+  indices.resize(k);
+  std::sort(indices.begin(), indices.end());
+
+  data->clear();
+  core::PutVarint32(data, k);
+  int32 previous = 0;
+  for (int32 index : indices) {
+    core::PutVarint32(data, index - previous);
+    previous = index;
+  }
+  for (int32 index : indices) {
+    const float value = flat(index);
+    data->append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+  return true;
+}
+
+Status DecodeTopK(StringPiece data, int64 n, float* out) {
+  std::fill(out, out + n, 0.0f);
+  const char* p = data.data();
+  const char* limit = data.data() + data.size();
+  uint32 k;
+  p = core::GetVarint32Ptr(p, limit, &k);
+  if (p == nullptr || k > n) {
+    return errors::DataLoss("Corrupt top-k tensor contents");
+  }
+  std::vector<int64> indices(k);
+  int64 index = 0;
+  for (uint32 i = 0; i < k; ++i) {
+    uint32 delta;
+    p = core::GetVarint32Ptr(p, limit, &delta);
+    if (p == nullptr || (i > 0 && delta == 0) || index + delta >= n) {
+      return errors::DataLoss("Corrupt top-k tensor contents");
+    }
+    index += delta;
+    indices[i] = index;
+  }
+  if (static_cast<size_t>(limit - p) != k * sizeof(float)) {
+    return errors::DataLoss("Corrupt top-k tensor contents");
+  }
+  for (int64 i : indices) {
+    memcpy(&out[i], p, sizeof(float));
+    p += sizeof(float);
+  }
+  return Status::OK();
+}
+
+Status ParseCodec(const string& name, bool allow_lossy,
+                  TensorCompression::Codec* codec) {
+  if (name.empty()) {
+    *codec = TensorCompression::NONE;
+  } else if (name == "snappy") {
+    *codec = TensorCompression::SNAPPY;
+  } else if (name == "float16") {
+    *codec = TensorCompression::FLOAT16;
+  } else if (name == "bfloat16") {
+    *codec = TensorCompression::BFLOAT16;
+  } else if (name == "top_k") {
+    *codec = TensorCompression::TOP_K;
+  } else {
+    return errors::InvalidArgument("Unknown tensor compression algorithm \"",
+                                   name, "\"");
+  }
+  if (!allow_lossy && IsLossy(*codec)) {
+    return errors::InvalidArgument("Lossy tensor compression algorithm \"",
+                                   name, "\" can only be used for gradients");
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+bool CompressTensorContent(const TensorCompression& compression,
+                           const Tensor& val,
+                           CompressedTensorContent* compressed) {
+  if (!DataTypeCanUseMemcpy(val.dtype())) {
+    return false;
+  }
+  const StringPiece content = val.tensor_data();
+  if (content.empty() ||
+      static_cast<int64>(content.size()) < compression.min_bytes()) {
+    return false;
+  }
+  TensorCompression::Codec codec = compression.codec();
+  if (val.dtype() == DT_FLOAT &&
+      compression.float_codec() != TensorCompression::NONE) {
+    codec = compression.float_codec();
+  }
+  if (IsLossy(codec) && val.dtype() != DT_FLOAT) {
+    return false;
+  }
+
+  const uint64 start_micros = Env::Default()->NowMicros();
+  string* data = compressed->mutable_data();
+  data->clear();
+  bool ok = true;
+  switch (codec) {
+    case TensorCompression::SNAPPY:
+      ok = port::Snappy_Compress(content.data(), content.size(), data);
+      break;
+    case TensorCompression::FLOAT16:
+      EncodeFloat16(val, data);
+      break;
+    case TensorCompression::BFLOAT16:
+      EncodeBFloat16(val, data);
+      break;
+    case TensorCompression::TOP_K:
+      ok = EncodeTopK(val, compression.top_k_fraction(), data);
+      break;
+    default:
+      ok = false;
+      break;
+  }
+  if (!ok || data->size() >= content.size()) {
+    return false;
+  }
+  compressed->set_codec(codec);
+  compressed->set_compressed_bytes(data->size());
+  compressed->set_uncompressed_bytes(content.size());
+  compressed->set_compress_micros(Env::Default()->NowMicros() - start_micros);
+  return true;
+}
+
+namespace {
+
+// Decodes "compressed" into the "num_bytes" bytes at "out", which hold "n"
+// values of type "dtype".
+Status UncompressTo(const CompressedTensorContent& compressed, DataType dtype,
+                    int64 n, int64 num_bytes, char* out) {
+  if (compressed.uncompressed_bytes() != num_bytes) {
+    return errors::DataLoss("Compressed tensor holds ",
+                            compressed.uncompressed_bytes(),
+                            " bytes instead of ", num_bytes);
+  }
+  if (IsLossy(compressed.codec()) && dtype != DT_FLOAT) {
+    return errors::InvalidArgument("Cannot uncompress a tensor of type ",
+                                   DataTypeString(dtype), " with codec ",
+                                   compressed.codec());
+  }
+
+  const string& data = compressed.data();
+  float* out_floats = reinterpret_cast<float*>(out);
+  switch (compressed.codec()) {
+    case TensorCompression::SNAPPY: {
+      size_t length;
+      if (!port::Snappy_GetUncompressedLength(data.data(), data.size(),
+                                              &length) ||
+          static_cast<int64>(length) != num_bytes ||
+          !port::Snappy_Uncompress(data.data(), data.size(), out)) {
+        return errors::DataLoss("Corrupt snappy tensor contents");
+      }
+      return Status::OK();
+    }
+    case TensorCompression::FLOAT16: {
+      if (data.size() != n * sizeof(Eigen::half)) {
+        return errors::DataLoss("Corrupt float16 tensor contents");
+      }
+      const Eigen::half* in = reinterpret_cast<const Eigen::half*>(data.data());
+      for (int64 i = 0; i < n; ++i) {
+        out_floats[i] = static_cast<float>(in[i]);
+      }
+      return Status::OK();
+    }
+    case TensorCompression::BFLOAT16: {
+      if (data.size() != n * sizeof(bfloat16)) {
+        return errors::DataLoss("Corrupt bfloat16 tensor contents");
+      }
+      BFloat16ToFloat(reinterpret_cast<const bfloat16*>(data.data()),
+                      out_floats, n);
+      return Status::OK();
+    }
+    case TensorCompression::TOP_K:
+      return DecodeTopK(data, n, out_floats);
+    default:
+      return errors::InvalidArgument("Unknown tensor compression codec ",
+                                     compressed.codec());
+  }
+}
+
+}  // namespace
+
+Status UncompressTensorContent(const CompressedTensorContent& compressed,
+                               TensorProto* tensor) {
+  const DataType dtype = tensor->dtype();
+  if (!DataTypeCanUseMemcpy(dtype)) {
+    return errors::InvalidArgument("Cannot uncompress a tensor of type ",
+                                   DataTypeString(dtype));
+  }
+  TF_RETURN_IF_ERROR(TensorShape::IsValidShape(tensor->tensor_shape()));
+  const int64 n = TensorShape(tensor->tensor_shape()).num_elements();
+  const int64 num_bytes = n * DataTypeSize(dtype);
+  string* content = tensor->mutable_tensor_content();
+  content->resize(num_bytes);
+  return UncompressTo(compressed, dtype, n, num_bytes, &(*content)[0]);
+}
+
+Status UncompressTensorContent(const CompressedTensorContent& compressed,
+                               Tensor* tensor) {
+  const DataType dtype = tensor->dtype();
+  if (!DataTypeCanUseMemcpy(dtype)) {
+    return errors::InvalidArgument("Cannot uncompress a tensor of type ",
+                                   DataTypeString(dtype));
+  }
+  const StringPiece content = tensor->tensor_data();
+  return UncompressTo(compressed, dtype, tensor->NumElements(),
+                      content.size(), const_cast<char*>(content.data()));
+}
+
+/* static */
+Status TensorCompressionPolicy::FromOptions(const RPCOptions& options,
+                                            TensorCompressionPolicy* policy) {
+  TensorCompressionPolicy result;
+  TF_RETURN_IF_ERROR(ParseCodec(options.compression_algorithm(),
+                                /*allow_lossy=*/false, &result.codec_));
+  TF_RETURN_IF_ERROR(ParseCodec(options.gradient_compression_algorithm(),
+                                /*allow_lossy=*/true, &result.gradient_codec_));
+  // Top-k drops the other values for good, so how much to keep is not
+  // defaulted.
+  result.top_k_fraction_ = options.gradient_top_k_fraction();
+  if (result.gradient_codec_ == TensorCompression::TOP_K &&
+      (result.top_k_fraction_ <= 0 || result.top_k_fraction_ >= 1)) {
+    return errors::InvalidArgument(
+        "The top_k gradient compression requires gradient_top_k_fraction in "
+        "(0, 1), got ",
+        options.gradient_top_k_fraction());
+  }
+  result.gradient_name_pattern_ = options.gradient_name_pattern().empty()
+                                      ? kDefaultGradientNamePattern
+                                      : options.gradient_name_pattern();
+  result.min_bytes_ = options.compression_min_bytes() == 0
+                          ? kDefaultMinBytes
+                          : options.compression_min_bytes();
+  if (result.min_bytes_ < 0) {
+    return errors::InvalidArgument(
+        "compression_min_bytes must not be negative, got ",
+        options.compression_min_bytes());
+  }
+  *policy = result;
+  return Status::OK();
+}
+
+void TensorCompressionPolicy::Get(StringPiece tensor_name,
+                                  TensorCompression* compression) const {
+  compression->Clear();
+  if (!enabled()) {
+    return;
+  }
+  compression->set_codec(codec_);
+  compression->set_min_bytes(min_bytes_);
+  if (gradient_codec_ != TensorCompression::NONE &&
+      str_util::StrContains(tensor_name, gradient_name_pattern_)) {
+    if (IsLossy(gradient_codec_)) {
+      compression->set_float_codec(gradient_codec_);
+      if (gradient_codec_ == TensorCompression::TOP_K) {
+        compression->set_top_k_fraction(top_k_fraction_);
+      }
+    } else {
+      compression->set_codec(gradient_codec_);
+    }
+  }
+}
+
+}  // namespace tensorflow
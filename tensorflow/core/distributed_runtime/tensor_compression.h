@@ -0,0 +1,77 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_COMPRESSION_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_COMPRESSION_H_
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+
+class TensorProto;
+
+// Compresses the contents of "val" as requested by "compression" into
+// "*compressed". Returns false if the requested codec doesn't apply to
+// "val", or doesn't make its contents smaller, in which case "val" should
+// be sent uncompressed.
+bool CompressTensorContent(const TensorCompression& compression,
+                           const Tensor& val,
+                           CompressedTensorContent* compressed);
+
+// Decodes "compressed" into the tensor_content of "*tensor", which must
+// already hold the dtype and shape of the tensor.
+Status UncompressTensorContent(const CompressedTensorContent& compressed,
+                               TensorProto* tensor);
+
+// Decodes "compressed" into the buffer of "*tensor", which must already be
+// allocated in host memory with the dtype and shape of the tensor.
+Status UncompressTensorContent(const CompressedTensorContent& compressed,
+                               Tensor* tensor);
+
+// Chooses the compression a task requests for the tensors it receives from
+// other tasks, following the RPCOptions of its default session config.
+class TensorCompressionPolicy {
+ public:
+  // A policy that never requests compression.
+  TensorCompressionPolicy() {}
+
+  // Parses the policy described by "options" into "*policy".
+  static Status FromOptions(const RPCOptions& options,
+                            TensorCompressionPolicy* policy);
+
+  // Returns true if any tensor may be compressed.
+  bool enabled() const {
+    return codec_ != TensorCompression::NONE ||
+           gradient_codec_ != TensorCompression::NONE;
+  }
+
+  // Fills "*compression" for receiving the tensor "tensor_name".
+  void Get(StringPiece tensor_name, TensorCompression* compression) const;
+
+ private:
+  TensorCompression::Codec codec_ = TensorCompression::NONE;
+  TensorCompression::Codec gradient_codec_ = TensorCompression::NONE;
+  float top_k_fraction_ = 0;
+  string gradient_name_pattern_;
+  int64 min_bytes_ = 0;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_COMPRESSION_H_
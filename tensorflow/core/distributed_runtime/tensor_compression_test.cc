@@ -0,0 +1,206 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/tensor_compression.h"
+
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/snappy.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+bool SnappyAvailable() {
+  string unused;
+  return port::Snappy_Compress("x", 1, &unused);
+}
+
+TensorCompression Compression(TensorCompression::Codec codec,
+                              TensorCompression::Codec float_codec) {
+  TensorCompression compression;
+  compression.set_codec(codec);
+  compression.set_float_codec(float_codec);
+  compression.set_top_k_fraction(0.1);
+  return compression;
+}
+
+// Compresses "val" with "compression" and returns the decoded tensor.
+Tensor RoundTrip(const TensorCompression& compression, const Tensor& val) {
+  CompressedTensorContent compressed;
+  EXPECT_TRUE(CompressTensorContent(compression, val, &compressed));
+  EXPECT_EQ(compressed.data().size(), compressed.compressed_bytes());
+  EXPECT_EQ(val.TotalBytes(), compressed.uncompressed_bytes());
+  EXPECT_LT(compressed.compressed_bytes(), compressed.uncompressed_bytes());
+
+  TensorProto proto;
+  proto.set_dtype(val.dtype());
+  val.shape().AsProto(proto.mutable_tensor_shape());
+  TF_EXPECT_OK(UncompressTensorContent(compressed, &proto));
+  Tensor result;
+  EXPECT_TRUE(result.FromProto(proto));
+  return result;
+}
+
+Tensor Ramp(int n) {
+  Tensor val(DT_FLOAT, TensorShape({n}));
+  auto flat = val.flat<float>();
+  for (int i = 0; i < n; ++i) {
+    flat(i) = (i % 2 == 0 ? 1 : -1) * (i % 100) * 0.25f;
+  }
+  return val;
+}
+
+TEST(TensorCompressionTest, Snappy) {
+  if (!SnappyAvailable()) return;
+  Tensor val(DT_INT32, TensorShape({100, 10}));
+  val.flat<int32>().setConstant(7);
+  const Tensor result = RoundTrip(
+      Compression(TensorCompression::SNAPPY, TensorCompression::NONE), val);
+  test::ExpectTensorEqual<int32>(val, result);
+}
+
+TEST(TensorCompressionTest, Float16) {
+  const Tensor val = Ramp(1000);
+  const Tensor result = RoundTrip(
+      Compression(TensorCompression::NONE, TensorCompression::FLOAT16), val);
+  // Quarters up to 25 are exactly representable in half precision.
+  test::ExpectTensorEqual<float>(val, result);
+}
+
+TEST(TensorCompressionTest, BFloat16) {
+  Tensor val = Ramp(1000);
+  val.flat<float>()(1) = 1.001f;
+  const Tensor result = RoundTrip(
+      Compression(TensorCompression::NONE, TensorCompression::BFLOAT16), val);
+  EXPECT_EQ(1.0f, result.flat<float>()(1));
+  val.flat<float>()(1) = 1.0f;
+  test::ExpectTensorEqual<float>(val, result);
+}
+
+TEST(TensorCompressionTest, TopK) {
+  Tensor val(DT_FLOAT, TensorShape({10, 100}));
+  auto flat = val.flat<float>();
+  flat.setConstant(0.5);
+  Tensor expected(DT_FLOAT, val.shape());
+  auto expected_flat = expected.flat<float>();
+  expected_flat.setZero();
+  // The 10% of the values with the largest magnitude.
+  for (int i = 0; i < 100; ++i) {
+    flat(i * 10 + 3) = (i % 2 == 0 ? 1 : -1) * (i + 1.0f);
+    expected_flat(i * 10 + 3) = flat(i * 10 + 3);
+  }
+  const Tensor result = RoundTrip(
+      Compression(TensorCompression::NONE, TensorCompression::TOP_K), val);
+  test::ExpectTensorEqual<float>(expected, result);
+}
+
+TEST(TensorCompressionTest, SendsUncompressedWhenNotApplicable) {
+  CompressedTensorContent compressed;
+  const TensorCompression lossy =
+      Compression(TensorCompression::NONE, TensorCompression::FLOAT16);
+  // Lossy codecs only apply to float tensors.
+  Tensor ints(DT_INT32, TensorShape({1000}));
+  ints.flat<int32>().setZero();
+  EXPECT_FALSE(CompressTensorContent(lossy, ints, &compressed));
+  // Small tensors are sent as is.
+  TensorCompression large_only = lossy;
+  large_only.set_min_bytes(8000);
+  EXPECT_FALSE(CompressTensorContent(large_only, Ramp(1000), &compressed));
+  EXPECT_TRUE(CompressTensorContent(large_only, Ramp(2000), &compressed));
+  // Top-k of a large fraction doesn't make the contents smaller.
+  TensorCompression top_k =
+      Compression(TensorCompression::NONE, TensorCompression::TOP_K);
+  top_k.set_top_k_fraction(0.9);
+  EXPECT_FALSE(CompressTensorContent(top_k, Ramp(1000), &compressed));
+  // Neither do lossless codecs on random-looking data.
+  if (SnappyAvailable()) {
+    Tensor noise(DT_INT64, TensorShape({1000}));
+    random::PhiloxRandom philox(301, 17);
+    random::SimplePhilox rnd(&philox);
+    auto flat = noise.flat<int64>();
+    for (int i = 0; i < flat.size(); ++i) {
+      flat(i) = rnd.Rand64();
+    }
+    EXPECT_FALSE(CompressTensorContent(
+        Compression(TensorCompression::SNAPPY, TensorCompression::NONE), noise,
+        &compressed));
+  }
+}
+
+TEST(TensorCompressionTest, RejectsCorruptContents) {
+  CompressedTensorContent compressed;
+  ASSERT_TRUE(CompressTensorContent(
+      Compression(TensorCompression::NONE, TensorCompression::TOP_K),
+      Ramp(1000), &compressed));
+  TensorProto proto;
+  proto.set_dtype(DT_FLOAT);
+  TensorShape({1000}).AsProto(proto.mutable_tensor_shape());
+
+  CompressedTensorContent truncated = compressed;
+  truncated.mutable_data()->resize(compressed.data().size() - 1);
+  EXPECT_FALSE(UncompressTensorContent(truncated, &proto).ok());
+
+  TensorProto wrong_shape = proto;
+  TensorShape({999}).AsProto(wrong_shape.mutable_tensor_shape());
+  EXPECT_FALSE(UncompressTensorContent(compressed, &wrong_shape).ok());
+
+  TensorProto wrong_type = proto;
+  wrong_type.set_dtype(DT_INT32);
+  EXPECT_FALSE(UncompressTensorContent(compressed, &wrong_type).ok());
+
+  TF_EXPECT_OK(UncompressTensorContent(compressed, &proto));
+}
+
+TEST(TensorCompressionTest, Policy) {
+  TensorCompressionPolicy policy;
+  EXPECT_FALSE(policy.enabled());
+  TF_ASSERT_OK(TensorCompressionPolicy::FromOptions(RPCOptions(), &policy));
+  EXPECT_FALSE(policy.enabled());
+
+  RPCOptions options;
+  options.set_compression_algorithm("snappy");
+  options.set_gradient_compression_algorithm("top_k");
+  // The fraction of top-k is required.
+  EXPECT_FALSE(TensorCompressionPolicy::FromOptions(options, &policy).ok());
+  options.set_gradient_top_k_fraction(0.01);
+  TF_ASSERT_OK(TensorCompressionPolicy::FromOptions(options, &policy));
+  EXPECT_TRUE(policy.enabled());
+
+  TensorCompression compression;
+  policy.Get("edge_5_weights/read", &compression);
+  EXPECT_EQ(TensorCompression::SNAPPY, compression.codec());
+  EXPECT_EQ(TensorCompression::NONE, compression.float_codec());
+  EXPECT_EQ(4096, compression.min_bytes());
+
+  policy.Get("edge_7_gradients/MatMul_grad/MatMul", &compression);
+  EXPECT_EQ(TensorCompression::SNAPPY, compression.codec());
+  EXPECT_EQ(TensorCompression::TOP_K, compression.float_codec());
+  EXPECT_FLOAT_EQ(0.01, compression.top_k_fraction());
+
+  options.set_compression_algorithm("bfloat16");
+  EXPECT_FALSE(TensorCompressionPolicy::FromOptions(options, &policy).ok());
+  options.set_compression_algorithm("lz4");
+  EXPECT_FALSE(TensorCompressionPolicy::FromOptions(options, &policy).ok());
+  options.set_compression_algorithm("");
+  options.set_gradient_top_k_fraction(1.5);
+  EXPECT_FALSE(TensorCompressionPolicy::FromOptions(options, &policy).ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
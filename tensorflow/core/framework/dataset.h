@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/framework/dataset_stateful_op_whitelist.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/model.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -274,6 +275,12 @@ class IteratorContext {
 
     // The Allocator to be used to allocate the output of an iterator.
     std::function<Allocator*(AllocatorAttributes)> allocator_getter = nullptr;
+
+    // The performance model of the input pipeline, which autotunes the
+    // iterators created with this context. It is only set for the inputs of
+    // a ModelDataset. If null, iterators are not modeled, and parameters set
+    // to `model::kAutoTune` get a default value.
+    std::shared_ptr<model::Model> model = nullptr;
   };
 
   explicit IteratorContext(Params params) : params_(std::move(params)) {}
@@ -325,6 +332,12 @@ class IteratorContext {
     return params_.stats_aggregator_getter;
   }
 
+  std::shared_ptr<model::Model> model() { return params_.model; }
+
+  void set_model(std::shared_ptr<model::Model> model) {
+    params_.model = std::move(model);
+  }
+
  private:
   Params params_;
 };
@@ -388,6 +401,11 @@ class IteratorBase {
   // in the outputs of this iterator.
   virtual const std::vector<PartialTensorShape>& output_shapes() const = 0;
 
+  // Performs the initialization that is common to a family of iterators,
+  // e.g. registering them with the performance model. Called before
+  // `Initialize()`.
+  virtual Status InitializeBase(IteratorContext* ctx) { return Status::OK(); }
+
   // Performs initialization that needs to happen outside of a constructor to
   // properly propagate errors.
   virtual Status Initialize(IteratorContext* ctx) { return Status::OK(); }
@@ -476,6 +494,7 @@ class DatasetBase : public core::RefCounted {
   Status MakeIterator(IteratorContext* ctx, const string& prefix,
                       std::unique_ptr<IteratorBase>* iterator) const {
     *iterator = MakeIteratorInternal(prefix);
+    TF_RETURN_IF_ERROR((*iterator)->InitializeBase(ctx));
     return (*iterator)->Initialize(ctx);
   }
 
@@ -553,10 +572,27 @@ class DatasetBaseIterator : public IteratorBase {
     return params_.dataset->output_shapes();
   }
 
+  Status InitializeBase(IteratorContext* ctx) final {
+    model_ = ctx->model();
+    if (model_) {
+      model_node_ = model_->AddNode(params_.prefix);
+    }
+    return Status::OK();
+  }
+
   Status GetNext(IteratorContext* ctx, std::vector<Tensor>* out_tensors,
                  bool* end_of_sequence) final {
     tracing::ScopedActivity activity(params_.prefix);
-    Status s = GetNextInternal(ctx, out_tensors, end_of_sequence);
+    Status s;
+    if (model_node_ != nullptr) {
+      model::ScopedProcessingTime processing_time(model_node_);
+      s = GetNextInternal(ctx, out_tensors, end_of_sequence);
+      if (s.ok() && !*end_of_sequence) {
+        model_node_->RecordElement(*out_tensors);
+      }
+    } else {
+      s = GetNextInternal(ctx, out_tensors, end_of_sequence);
+    }
     if (TF_PREDICT_FALSE(errors::IsOutOfRange(s) && !*end_of_sequence)) {
       s = errors::Internal(
           "Iterator \"", params_.prefix,
@@ -583,8 +619,15 @@ class DatasetBaseIterator : public IteratorBase {
     return strings::StrCat(params_.prefix, ":", name);
   }
 
+  // The node of this iterator in the performance model of the pipeline, or
+  // nullptr if the pipeline is not modeled. Set before `Initialize()`.
+  model::Node* model_node() const { return model_node_; }
+
  private:
   BaseParams params_;
+  // Keeps `model_node_` alive.
+  std::shared_ptr<model::Model> model_;
+  model::Node* model_node_ = nullptr;
 };
 
 // Represents an iterator that is associated with a particular dataset
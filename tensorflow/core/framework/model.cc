@@ -0,0 +1,428 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/framework/model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env_time.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mem.h"
+
+namespace tensorflow {
+namespace model {
+
+const char kParallelism[] = "parallelism";
+const char kBufferSize[] = "buffer_size";
+
+namespace {
+
+// The optimizer stops when an increment improves the output time by less
+// than this fraction.
+constexpr double kMinImprovement = 0.01;
+
+// Bounds of the interval between two optimizations, which doubles after each
+// optimization.
+constexpr int64 kMinOptimizationIntervalMs = 10;
+constexpr int64 kMaxOptimizationIntervalMs = 1000;
+
+/* ABSL_CONST_INIT */ thread_local ScopedProcessingTime*
+    current_processing_time = nullptr;
+
+// Replaces the indices of the elements of an interleave in `name`, e.g.
+// "Iterator::Interleave[3]::Map", with "[]".
+string CanonicalName(const string& name) {
+  string result;
+  result.reserve(name.size());
+  bool in_index = false;
+  for (char c : name) {
+    if (in_index) {
+      if (c == ']') {
+        result.push_back(c);
+        in_index = false;
+      }
+      continue;
+    }
+    result.push_back(c);
+    if (c == '[') in_index = true;
+  }
+  return result;
+}
+
+// Returns the expected time a consumer that asks for an element every
+// `consumer_time` nanoseconds waits for a producer that produces one every
+// `producer_time` nanoseconds, through a buffer of `buffer_size` elements.
+//
+// The buffer is modeled as an M/M/1/K queue whose arrivals are the produced
+// elements and whose departures are the consumed ones. The consumer waits
+// when it finds the buffer empty.
+double WaitTime(double producer_time, double consumer_time,
+                int64 buffer_size) {
+  if (producer_time <= 0) return 0;
+  if (consumer_time <= 0) return producer_time;
+  const double rho = consumer_time / producer_time;
+  const double k = std::max<int64>(buffer_size, 1);
+  double p_empty;
+  if (std::abs(rho - 1.0) < 1e-9) {
+    p_empty = 1.0 / (k + 1.0);
+  } else {
+    p_empty = (1.0 - rho) / (1.0 - std::pow(rho, k + 1.0));
+  }
+  return p_empty * producer_time;
+}
+
+}  // namespace
+
+void SharedState::Set(int64 value) {
+  mutex_lock l(mu_);
+  if (value_.exchange(value, std::memory_order_relaxed) != value &&
+      notify_) {
+    notify_();
+  }
+}
+
+void SharedState::Detach() {
+  mutex_lock l(mu_);
+  notify_ = nullptr;
+}
+
+bool SharedState::detached() {
+  mutex_lock l(mu_);
+  return notify_ == nullptr;
+}
+
+void Node::RecordElement(const std::vector<Tensor>& element) {
+  int64 bytes = 0;
+  for (const Tensor& t : element) {
+    bytes += t.TotalBytes();
+  }
+  num_elements_.fetch_add(1, std::memory_order_relaxed);
+  bytes_produced_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Node::AddParameter(const string& name, int64 value) {
+  mutex_lock l(model_->mu_);
+  Parameter& parameter = parameters_[name];
+  parameter.value = value;
+  parameter.min = value;
+  parameter.max = value;
+  parameter.states.clear();
+}
+
+void Node::AddTunableParameter(const string& name,
+                               std::shared_ptr<SharedState> state, int64 min,
+                               int64 max) {
+  int64 value;
+  {
+    mutex_lock l(model_->mu_);
+    auto it = parameters_.find(name);
+    if (it == parameters_.end() || it->second.states.empty()) {
+      Parameter& parameter = parameters_[name];
+      parameter.value = std::max(min, std::min(state->value(), max));
+      parameter.min = min;
+      parameter.max = max;
+      parameter.states.clear();
+      it = parameters_.find(name);
+    }
+    // Drop the states of iterators that are gone.
+    std::vector<std::shared_ptr<SharedState>>& states = it->second.states;
+    states.erase(std::remove_if(states.begin(), states.end(),
+                                [](const std::shared_ptr<SharedState>& s) {
+                                  return s->detached();
+                                }),
+                 states.end());
+    value = it->second.value;
+    states.push_back(state);
+  }
+  // Notifying the iterator may take its locks, so it happens without holding
+  // the lock of the model.
+  state->Set(value);
+  model_->StartOptimizationThread();
+}
+
+int64 Node::ParameterValue(const string& name, int64 default_value) {
+  auto it = parameters_.find(name);
+  return it == parameters_.end() ? default_value : it->second.value;
+}
+
+double Node::SelfTime() const {
+  const int64 n = num_elements();
+  return n == 0 ? 0 : static_cast<double>(processing_time()) / n;
+}
+
+double Node::BytesPerElement() const {
+  const int64 n = num_elements();
+  return n == 0
+             ? 0
+             : static_cast<double>(
+                   bytes_produced_.load(std::memory_order_relaxed)) /
+                   n;
+}
+
+double Node::OutputTime(double consumer_time) {
+  const int64 n = num_elements();
+  const double self = SelfTime();
+  // Returns the time the inputs take to produce the elements consumed for
+  // one element of this node, when they are asked for one such batch of
+  // elements every `interval` nanoseconds.
+  auto inputs_time = [this, n](double interval) {
+    double total = 0;
+    for (Node* input : inputs_) {
+      if (input->num_elements() == 0) continue;
+      const double ratio =
+          n == 0 ? 1.0 : static_cast<double>(input->num_elements()) / n;
+      total += ratio * input->OutputTime(interval / ratio);
+    }
+    return total;
+  };
+
+  switch (type()) {
+    case Type::kSync:
+      return self + inputs_time(consumer_time + self);
+    case Type::kAsync: {
+      // Calls run concurrently, but read their input elements one at a time.
+      const int64 parallelism = ParameterValue(kParallelism, 1);
+      const int64 buffer_size = ParameterValue(kBufferSize, parallelism);
+      const double call_time = self / parallelism;
+      const double producer_time =
+          std::max(call_time, inputs_time(call_time));
+      return WaitTime(producer_time, consumer_time, buffer_size);
+    }
+    case Type::kAsyncParallelInputs: {
+      const int64 parallelism = ParameterValue(kParallelism, 1);
+      const int64 buffer_size = ParameterValue(kBufferSize, 1);
+      const double producer_time =
+          (self + inputs_time(self)) / parallelism;
+      return WaitTime(producer_time, consumer_time,
+                      buffer_size * parallelism);
+    }
+  }
+  return self;
+}
+
+double Node::BufferedBytes() {
+  switch (type()) {
+    case Type::kSync:
+      return 0;
+    case Type::kAsync: {
+      const int64 parallelism = ParameterValue(kParallelism, 1);
+      return ParameterValue(kBufferSize, parallelism) * BytesPerElement();
+    }
+    case Type::kAsyncParallelInputs:
+      return ParameterValue(kBufferSize, 1) *
+             ParameterValue(kParallelism, 1) * BytesPerElement();
+  }
+  return 0;
+}
+
+Model::Model() : Model(0, 0) {}
+
+Model::Model(int64 cpu_budget, int64 ram_budget)
+    : cpu_budget_(cpu_budget > 0 ? cpu_budget : port::NumSchedulableCPUs()),
+      ram_budget_(ram_budget > 0 ? ram_budget : port::AvailableRam() / 2) {}
+
+Model::~Model() {
+  std::unique_ptr<Thread> thread;
+  {
+    mutex_lock l(mu_);
+    cancelled_ = true;
+    cond_var_.notify_all();
+    thread = std::move(optimization_thread_);
+  }
+  // Joins the thread.
+  thread.reset();
+}
+
+Node* Model::AddNode(const string& name) {
+  const string canonical_name = CanonicalName(name);
+  mutex_lock l(mu_);
+  std::unique_ptr<Node>& node = nodes_[canonical_name];
+  if (!node) node.reset(new Node(canonical_name, this));
+  return node.get();
+}
+
+Node* Model::LookupNode(const string& name) {
+  mutex_lock l(mu_);
+  auto it = nodes_.find(CanonicalName(name));
+  return it == nodes_.end() ? nullptr : it->second.get();
+}
+
+Node* Model::BuildTree() {
+  for (auto& entry : nodes_) {
+    entry.second->inputs_.clear();
+  }
+  Node* root = nullptr;
+  for (auto& entry : nodes_) {
+    const string& name = entry.first;
+    Node* node = entry.second.get();
+    // The consumer is the longest prefix of the name that ends right before
+    // a "::" or a "[".
+    Node* consumer = nullptr;
+    for (size_t i = name.size(); i-- > 1 && consumer == nullptr;) {
+      if (name[i] != '[' && name.compare(i - 1, 2, "::") != 0) continue;
+      const size_t end = name[i] == '[' ? i : i - 1;
+      auto it = nodes_.find(name.substr(0, end));
+      if (it != nodes_.end()) consumer = it->second.get();
+    }
+    if (consumer != nullptr) {
+      consumer->inputs_.push_back(node);
+    } else if (root == nullptr || name.size() < root->name().size()) {
+      root = node;
+    }
+  }
+  return root;
+}
+
+double Model::OutputTime() {
+  mutex_lock l(mu_);
+  Node* root = BuildTree();
+  return root == nullptr ? 0 : root->OutputTime(0);
+}
+
+void Model::Optimize() {
+  std::vector<std::pair<std::shared_ptr<SharedState>, int64>> updates;
+  {
+    mutex_lock l(mu_);
+    Node* root = BuildTree();
+    if (root == nullptr) return;
+
+    std::vector<Node::Parameter*> tunables;
+    for (auto& entry : nodes_) {
+      for (auto& parameter : entry.second->parameters_) {
+        if (parameter.second.states.empty()) continue;
+        tunables.push_back(&parameter.second);
+      }
+    }
+    if (tunables.empty()) return;
+
+    auto within_budget = [this]() {
+      int64 cpu = 0;
+      double ram = 0;
+      for (auto& entry : nodes_) {
+        Node* node = entry.second.get();
+        if (node->type() != Node::Type::kSync) {
+          cpu += node->ParameterValue(kParallelism, 1);
+        }
+        ram += node->BufferedBytes();
+      }
+      return cpu <= cpu_budget_ && ram <= ram_budget_;
+    };
+
+    // Each pass starts from the values of the previous one. If they exceed
+    // the budget, e.g. because the elements grew, decrement the parameter
+    // whose decrement increases the output time the least until they fit.
+    while (!within_budget()) {
+      Node::Parameter* best = nullptr;
+      double best_time = std::numeric_limits<double>::infinity();
+      for (Node::Parameter* parameter : tunables) {
+        if (parameter->value <= parameter->min) continue;
+        --parameter->value;
+        const double time = root->OutputTime(0);
+        if (best == nullptr || time < best_time) {
+          best = parameter;
+          best_time = time;
+        }
+        ++parameter->value;
+      }
+      if (best == nullptr) break;
+      --best->value;
+    }
+
+    // Hill climbing: increment the parameter that improves the output time
+    // the most, while it improves it enough.
+    double output_time = root->OutputTime(0);
+    while (true) {
+      Node::Parameter* best = nullptr;
+      double best_time = output_time;
+      for (Node::Parameter* parameter : tunables) {
+        if (parameter->value >= parameter->max) continue;
+        ++parameter->value;
+        if (within_budget()) {
+          const double time = root->OutputTime(0);
+          if (time < best_time) {
+            best = parameter;
+            best_time = time;
+          }
+        }
+        --parameter->value;
+      }
+      if (best == nullptr ||
+          output_time - best_time < kMinImprovement * output_time) {
+        break;
+      }
+      ++best->value;
+      output_time = best_time;
+    }
+
+    for (Node::Parameter* parameter : tunables) {
+      for (const auto& state : parameter->states) {
+        updates.emplace_back(state, parameter->value);
+      }
+    }
+    VLOG(2) << "Autotuned " << tunables.size()
+            << " parameters; estimated output time: " << output_time
+            << " ns";
+  }
+  // Notifying the iterators takes their locks, so it happens without
+  // holding `mu_`.
+  for (const auto& update : updates) {
+    update.first->Set(update.second);
+  }
+}
+
+void Model::StartOptimizationThread() {
+  mutex_lock l(mu_);
+  if (!optimization_thread_ && !cancelled_) {
+    optimization_thread_.reset(Env::Default()->StartThread(
+        {}, "tf_data_model", [this]() { OptimizationThread(); }));
+  }
+}
+
+void Model::OptimizationThread() {
+  int64 interval_ms = kMinOptimizationIntervalMs;
+  while (true) {
+    {
+      mutex_lock l(mu_);
+      if (!cancelled_) WaitForMilliseconds(&l, &cond_var_, interval_ms);
+      if (cancelled_) return;
+    }
+    Optimize();
+    interval_ms = std::min(2 * interval_ms, kMaxOptimizationIntervalMs);
+  }
+}
+
+ScopedProcessingTime::ScopedProcessingTime(Node* node)
+    : node_(node), outer_(current_processing_time) {
+  start_ = EnvTime::Default()->NowNanos();
+  if (outer_ != nullptr && outer_->node_->type() == Node::Type::kSync) {
+    outer_->node_->AddProcessingTime(start_ - outer_->start_);
+  }
+  current_processing_time = this;
+}
+
+ScopedProcessingTime::~ScopedProcessingTime() {
+  const uint64 now = EnvTime::Default()->NowNanos();
+  if (node_->type() == Node::Type::kSync) {
+    node_->AddProcessingTime(now - start_);
+  }
+  current_processing_time = outer_;
+  if (outer_ != nullptr) outer_->start_ = now;
+}
+
+}  // namespace model
+}  // namespace tensorflow
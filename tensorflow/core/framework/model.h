@@ -0,0 +1,253 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_FRAMEWORK_MODEL_H_
+#define TENSORFLOW_CORE_FRAMEWORK_MODEL_H_
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace model {
+
+// A performance model of an input pipeline, used to autotune the parallelism
+// and the buffer sizes of its iterators.
+//
+// Every iterator of the pipeline is a `Node` of the model, identified by the
+// prefix of the iterator. A node measures the time spent producing its
+// elements, excluding the time spent in its inputs, and the number and size
+// of the elements it produced. From these, the model estimates the time the
+// pipeline needs to produce an element for a given set of parameter values:
+//
+// * A synchronous node takes its own processing time plus the time its inputs
+//   take to produce the elements it consumes.
+// * An asynchronous node produces elements with `parallelism` calls in flight
+//   and hands them over through a buffer. The time its consumer waits for an
+//   element is modeled as an M/M/1/K queue, whose producer is the node and
+//   whose capacity is the buffer size.
+//
+// The optimizer repeatedly increments the tunable parameter that improves
+// the estimate the most, subject to a CPU budget (the sum of all parallelism)
+// and a RAM budget (the bytes held in all buffers), and hands the new values
+// to the iterators. Each optimization starts from the values of the previous
+// one, decrementing parameters first if they no longer fit the budgets.
+
+// Value of a parameter, e.g. `num_parallel_calls`, that requests autotuning.
+constexpr int64 kAutoTune = -1;
+
+// Names of the parameters of a node.
+extern const char kParallelism[];
+extern const char kBufferSize[];
+
+// The value of a tunable parameter, shared between an iterator and the model.
+//
+// The iterator reads the value on its own schedule. When the model changes
+// it, it calls `notify`, which typically wakes up the threads of the
+// iterator that wait for more room to run calls or buffer elements.
+class SharedState {
+ public:
+  SharedState(int64 value, std::function<void()> notify)
+      : value_(value), notify_(std::move(notify)) {}
+
+  int64 value() const { return value_.load(std::memory_order_relaxed); }
+
+  // Sets the value and notifies the iterator, unless it detached.
+  void Set(int64 value);
+
+  // Stops notifications. Must be called by the iterator before it destroys
+  // anything that `notify` refers to.
+  void Detach();
+
+  bool detached();
+
+ private:
+  std::atomic<int64> value_;
+  mutex mu_;
+  std::function<void()> notify_ GUARDED_BY(mu_);
+};
+
+class Model;
+
+class Node {
+ public:
+  enum class Type {
+    // Produces its elements on the thread calling GetNext().
+    kSync,
+    // Produces its elements on background threads, e.g. parallel map and
+    // prefetch. Its GetNext() time is spent waiting and is not recorded;
+    // the background threads record their work with AddProcessingTime().
+    // Input elements are read one at a time.
+    kAsync,
+    // A kAsync node whose inputs are read by `parallelism` threads at once,
+    // e.g. parallel interleave.
+    kAsyncParallelInputs,
+  };
+
+  Node(const string& name, Model* model) : name_(name), model_(model) {}
+
+  const string& name() const { return name_; }
+
+  void set_type(Type type) { type_.store(type, std::memory_order_relaxed); }
+  Type type() const { return type_.load(std::memory_order_relaxed); }
+
+  // Records `nanos` spent producing elements of this node.
+  void AddProcessingTime(int64 nanos) {
+    processing_time_.fetch_add(nanos, std::memory_order_relaxed);
+  }
+
+  // Records an element produced by this node.
+  void RecordElement(const std::vector<Tensor>& element);
+
+  // Adds a parameter with a fixed value, e.g. a user-specified parallelism.
+  void AddParameter(const string& name, int64 value);
+
+  // Adds a parameter whose value is chosen by the model between `min` and
+  // `max`. Several iterators may share the node, e.g. the iterators of the
+  // elements of an interleave, and they all get the same value.
+  void AddTunableParameter(const string& name,
+                           std::shared_ptr<SharedState> state, int64 min,
+                           int64 max);
+
+  int64 processing_time() const {
+    return processing_time_.load(std::memory_order_relaxed);
+  }
+  int64 num_elements() const {
+    return num_elements_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  friend class Model;
+
+  struct Parameter {
+    int64 value;
+    int64 min;
+    int64 max;
+    // Empty for a fixed parameter.
+    std::vector<std::shared_ptr<SharedState>> states;
+  };
+
+  // The following methods require the lock of the model.
+
+  // Returns the value of the parameter, or `default_value` if there is none.
+  int64 ParameterValue(const string& name, int64 default_value);
+
+  // Returns the average processing time and size of an element, or 0 if no
+  // element was produced yet.
+  double SelfTime() const;
+  double BytesPerElement() const;
+
+  // Returns the time the consumer of this node waits for an element, when
+  // it asks for one every `consumer_time` nanoseconds.
+  double OutputTime(double consumer_time);
+
+  // Returns the bytes this node buffers.
+  double BufferedBytes();
+
+  const string name_;
+  std::atomic<Type> type_{Type::kSync};
+  std::atomic<int64> processing_time_{0};
+  std::atomic<int64> num_elements_{0};
+  std::atomic<int64> bytes_produced_{0};
+
+  Model* const model_;  // Not owned.
+  // Guarded by the lock of the model.
+  std::map<string, Parameter> parameters_;
+  std::vector<Node*> inputs_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(Node);
+};
+
+class Model {
+ public:
+  // A budget of 0 defaults to the number of schedulable CPUs, and to half of
+  // the available RAM.
+  Model();
+  Model(int64 cpu_budget, int64 ram_budget);
+
+  // Stops the optimization thread.
+  ~Model();
+
+  // Returns the node of the iterator with prefix `name`, adding it if
+  // needed. The node lives as long as the model.
+  //
+  // The consumer of a node is the node with the longest name that is a
+  // prefix of its name. The iterators of the elements of an interleave, whose
+  // prefixes contain the index of the element, e.g. "[3]", share a node.
+  Node* AddNode(const string& name);
+
+  // Returns the node with the given name, or nullptr.
+  Node* LookupNode(const string& name);
+
+  // Picks the values of the tunable parameters and hands them to the
+  // iterators.
+  void Optimize();
+
+  // Returns the estimated time to produce an element of the pipeline.
+  double OutputTime();
+
+ private:
+  friend class Node;
+
+  // Starts optimizing the tunable parameters in the background, if it has
+  // not started yet.
+  void StartOptimizationThread();
+
+  // Links every node to its inputs, and returns the root of the pipeline.
+  Node* BuildTree() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  void OptimizationThread();
+
+  const int64 cpu_budget_;
+  const int64 ram_budget_;
+
+  mutex mu_;
+  // Keyed by canonical name.
+  std::map<string, std::unique_ptr<Node>> nodes_ GUARDED_BY(mu_);
+  std::unique_ptr<Thread> optimization_thread_ GUARDED_BY(mu_);
+  condition_variable cond_var_;
+  bool cancelled_ GUARDED_BY(mu_) = false;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(Model);
+};
+
+// Records the time the current thread spends in the GetNext() of the
+// iterator of `node`, excluding the time spent in the GetNext() of its
+// inputs on the same thread.
+class ScopedProcessingTime {
+ public:
+  explicit ScopedProcessingTime(Node* node);
+  ~ScopedProcessingTime();
+
+ private:
+  Node* const node_;
+  ScopedProcessingTime* const outer_;
+  uint64 start_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ScopedProcessingTime);
+};
+
+}  // namespace model
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_FRAMEWORK_MODEL_H_
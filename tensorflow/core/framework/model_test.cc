@@ -0,0 +1,188 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/model.h"
+
+#include <atomic>
+#include <memory>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace model {
+namespace {
+
+// Records `num_elements` elements of `bytes` bytes each, which took `nanos`
+// nanoseconds each to produce.
+void Produce(Node* node, int num_elements, int64 nanos, int64 bytes) {
+  Tensor element(DT_INT8, TensorShape({bytes}));
+  for (int i = 0; i < num_elements; ++i) {
+    node->AddProcessingTime(nanos);
+    node->RecordElement({element});
+  }
+}
+
+TEST(ModelTest, InterleavedIteratorsShareANode) {
+  Model model;
+  Node* node = model.AddNode("Iterator::Interleave[0]::Map");
+  EXPECT_EQ("Iterator::Interleave[]::Map", node->name());
+  EXPECT_EQ(node, model.AddNode("Iterator::Interleave[12]::Map"));
+  EXPECT_EQ(node, model.LookupNode("Iterator::Interleave[3]::Map"));
+  EXPECT_EQ(nullptr, model.LookupNode("Iterator::Interleave"));
+}
+
+TEST(ModelTest, SyncPipelineOutputTime) {
+  Model model;
+  Node* map = model.AddNode("Iterator::Map");
+  Node* range = model.AddNode("Iterator::Map::Range");
+  Produce(map, 10, 100, 4);
+  Produce(range, 10, 50, 4);
+  // The map waits for its input on every element.
+  EXPECT_DOUBLE_EQ(150, model.OutputTime());
+
+  // A filter that consumes two input elements per output element.
+  Node* filter = model.AddNode("Iterator::Map::Range::Filter");
+  Produce(filter, 20, 10, 4);
+  EXPECT_DOUBLE_EQ(150 + 2 * 10, model.OutputTime());
+}
+
+TEST(ModelTest, OptimizeParallelismWithinCpuBudget) {
+  Model model(/*cpu_budget=*/4, /*ram_budget=*/1 << 30);
+  Node* map = model.AddNode("Iterator::ParallelMap");
+  Node* range = model.AddNode("Iterator::ParallelMap::Range");
+  map->set_type(Node::Type::kAsync);
+  Produce(map, 100, 1000, 4);
+  Produce(range, 100, 10, 4);
+
+  std::atomic<int> notifications(0);
+  auto parallelism = std::make_shared<SharedState>(
+      kAutoTune, [&notifications]() { ++notifications; });
+  map->AddTunableParameter(kParallelism, parallelism, 1, 16);
+  EXPECT_EQ(1, parallelism->value());
+  const double sequential_time = model.OutputTime();
+
+  model.Optimize();
+  // The map is CPU bound, so it gets all the CPUs of the budget.
+  EXPECT_EQ(4, parallelism->value());
+  EXPECT_GE(notifications, 2);
+  EXPECT_DOUBLE_EQ(sequential_time / 4, model.OutputTime());
+  parallelism->Detach();
+}
+
+TEST(ModelTest, OptimizeBufferSizeWithinRamBudget) {
+  // Room for three buffered elements.
+  Model model(/*cpu_budget=*/4, /*ram_budget=*/3 * 1000);
+  Node* map = model.AddNode("Iterator::Map");
+  Node* prefetch = model.AddNode("Iterator::Map::Prefetch");
+  prefetch->set_type(Node::Type::kAsync);
+  Produce(map, 100, 1000, 1000);
+  Produce(prefetch, 100, 1000, 1000);
+
+  auto buffer_size = std::make_shared<SharedState>(kAutoTune, nullptr);
+  prefetch->AddParameter(kParallelism, 1);
+  prefetch->AddTunableParameter(kBufferSize, buffer_size, 1, 100);
+  model.Optimize();
+  EXPECT_EQ(3, buffer_size->value());
+}
+
+TEST(ModelTest, OptimizeStartsFromCurrentValues) {
+  Model model(/*cpu_budget=*/4, /*ram_budget=*/1 << 30);
+  Node* map = model.AddNode("Iterator::ParallelMap");
+  map->set_type(Node::Type::kAsync);
+
+  auto parallelism = std::make_shared<SharedState>(3, nullptr);
+  map->AddTunableParameter(kParallelism, parallelism, 1, 16);
+  // Without measurements, no change improves the output time, so the value
+  // is kept instead of being reset to the minimum.
+  model.Optimize();
+  EXPECT_EQ(3, parallelism->value());
+
+  Produce(map, 100, 1000, 4);
+  model.Optimize();
+  EXPECT_EQ(4, parallelism->value());
+  model.Optimize();
+  EXPECT_EQ(4, parallelism->value());
+  parallelism->Detach();
+}
+
+TEST(ModelTest, OptimizeShrinksValuesOverBudget) {
+  Model model(/*cpu_budget=*/4, /*ram_budget=*/1 << 30);
+  Node* map = model.AddNode("Iterator::ParallelMap");
+  map->set_type(Node::Type::kAsync);
+  Produce(map, 100, 1000, 4);
+
+  auto parallelism = std::make_shared<SharedState>(12, nullptr);
+  map->AddTunableParameter(kParallelism, parallelism, 1, 16);
+  model.Optimize();
+  EXPECT_EQ(4, parallelism->value());
+  parallelism->Detach();
+}
+
+TEST(ModelTest, DetachedStatesAreNotNotified) {
+  Model model(/*cpu_budget=*/8, /*ram_budget=*/1 << 30);
+  Node* map = model.AddNode("Iterator::ParallelMap");
+  map->set_type(Node::Type::kAsync);
+  Produce(map, 100, 1000, 4);
+
+  std::atomic<int> notifications(0);
+  auto first = std::make_shared<SharedState>(
+      1, [&notifications]() { ++notifications; });
+  map->AddTunableParameter(kParallelism, first, 1, 8);
+  first->Detach();
+  EXPECT_TRUE(first->detached());
+  model.Optimize();
+  EXPECT_EQ(0, notifications);
+
+  // A new iterator of the node starts from the tuned value.
+  auto second = std::make_shared<SharedState>(
+      1, [&notifications]() { ++notifications; });
+  map->AddTunableParameter(kParallelism, second, 1, 8);
+  EXPECT_EQ(8, second->value());
+  EXPECT_EQ(1, notifications);
+  second->Detach();
+}
+
+TEST(ModelTest, ScopedProcessingTimeExcludesInputs) {
+  Model model;
+  Node* map = model.AddNode("Iterator::Map");
+  Node* range = model.AddNode("Iterator::Map::Range");
+  {
+    ScopedProcessingTime outer(map);
+    Env::Default()->SleepForMicroseconds(10000);
+    {
+      ScopedProcessingTime inner(range);
+      Env::Default()->SleepForMicroseconds(20000);
+    }
+    Env::Default()->SleepForMicroseconds(10000);
+  }
+  EXPECT_GE(range->processing_time(), 20000000);
+  EXPECT_GE(map->processing_time(), 20000000);
+  EXPECT_LT(map->processing_time(), range->processing_time() + 20000000);
+
+  // The GetNext() time of an asynchronous node is spent waiting.
+  Node* prefetch = model.AddNode("Iterator::Prefetch");
+  prefetch->set_type(Node::Type::kAsync);
+  {
+    ScopedProcessingTime scope(prefetch);
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  EXPECT_EQ(0, prefetch->processing_time());
+}
+
+}  // namespace
+}  // namespace model
+}  // namespace tensorflow
@@ -672,9 +672,8 @@ Status OpKernelContext::allocate_output(StringPiece name,
 }
 
 Status OpKernelContext::allocate_tensor(
-    DataType type, const TensorShape& shape, Tensor* out_tensor,
-    AllocatorAttributes attr, const AllocationAttributes& allocation_attr) {
-  Allocator* a = get_allocator(attr);
+    Allocator* a, DataType type, const TensorShape& shape, Tensor* out_tensor,
+    const AllocationAttributes& allocation_attr) {
   AllocationAttributes logged_attr(allocation_attr);
   logged_attr.allocation_will_be_logged = true;
   Tensor new_tensor(a, type, shape, logged_attr);
@@ -715,6 +714,15 @@ Status OpKernelContext::allocate_temp(
     DataType type, const TensorShape& shape, Tensor* out_temp,
     AllocatorAttributes allocator_attr,
     const AllocationAttributes& allocation_attr) {
+  // Temporaries that may be accessed by devices other than the host are not
+  // served by the step allocator, and neither are tracked ones, whose sizes
+  // are recorded per allocator.
+  if (params_->step_temp_allocator != nullptr && !track_allocations() &&
+      allocator_attr.scope_id <= 0 && !allocator_attr.gpu_compatible() &&
+      !allocator_attr.nic_compatible()) {
+    return allocate_tensor(params_->step_temp_allocator, type, shape, out_temp,
+                           allocation_attr);
+  }
   Status s =
       allocate_tensor(type, shape, out_temp, allocator_attr, allocation_attr);
   if (track_allocations() && s.ok() && out_temp->TotalBytes() > 0) {
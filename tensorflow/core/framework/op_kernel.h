@@ -532,6 +532,11 @@ class OpKernelContext {
     // stored in this container..
     ScopedStepContainer* step_container = nullptr;
 
+    // If not nullptr, serves the temporaries allocated with allocate_temp()
+    // that only need host memory. The allocator is scoped to a step of the
+    // executor, see StepArenaAllocator. Not owned.
+    Allocator* step_temp_allocator = nullptr;
+
     // Mechanism used by this op kernel invocation to communicate with
     // computations running on other devices.
     Rendezvous* rendezvous = nullptr;
@@ -1118,6 +1123,13 @@ class OpKernelContext {
 
   Status allocate_tensor(DataType type, const TensorShape& shape,
                          Tensor* out_tensor, AllocatorAttributes allocator_attr,
+                         const AllocationAttributes& allocation_attr) {
+    return allocate_tensor(get_allocator(allocator_attr), type, shape,
+                           out_tensor, allocation_attr);
+  }
+
+  Status allocate_tensor(Allocator* a, DataType type, const TensorShape& shape,
+                         Tensor* out_tensor,
                          const AllocationAttributes& allocation_attr);
 
   // This is called by PersistentTensor::AccessTensor whenever the
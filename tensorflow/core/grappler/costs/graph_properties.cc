@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 
+#include <algorithm>
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
@@ -31,12 +32,25 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/grappler/utils/functions.h"
 #include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace tensorflow {
 namespace grappler {
 namespace {
 
+// Graphs with fewer nodes are inferred on the calling thread by default.
+constexpr int kMinNodesForParallelInference = 10000;
+// Incremental updates that would infer more than this fraction of the graph
+// infer the whole graph instead.
+constexpr double kMaxIncrementalUpdateFraction = 0.5;
+// Prefix of the placeholders standing for the fanins of the nodes inferred
+// during an incremental update.
+constexpr char kBoundaryNodePrefix[] = "GraphPropertiesBoundary/";
+
 using shape_inference::DimensionHandle;
 using shape_inference::InferenceContext;
 using shape_inference::ShapeAndType;
@@ -345,6 +359,91 @@ void VerboseLogUnknownDimensionSources(
   }
 }
 
+thread::ThreadPool* InferenceThreadPool() {
+  static thread::ThreadPool* thread_pool = new thread::ThreadPool(
+      Env::Default(), "graph_properties", port::NumSchedulableCPUs());
+  return thread_pool;
+}
+
+// Returns the smallest symbolic dimension in 'properties_map', or -1 if there
+// is none.
+int64 MinSymbolicDim(
+    const std::map<string, std::vector<OpInfo::TensorProperties>>&
+        properties_map) {
+  int64 min_dim = -1;
+  for (const auto& properties : properties_map) {
+    for (const auto& property : properties.second) {
+      for (const auto& dim : property.shape().dim()) {
+        min_dim = std::min(min_dim, dim.size());
+      }
+    }
+  }
+  return min_dim;
+}
+
+// Adds to 'library' the functions of 'graph' that 'nodes' call, directly or
+// from the body of another function, along with their gradients.
+void AddReachableFunctions(const GraphDef& graph, const std::vector<int>& nodes,
+                           FunctionDefLibrary* library) {
+  const FunctionDefLibrary& graph_library = graph.library();
+  if (graph_library.function_size() == 0) {
+    return;
+  }
+  std::unordered_map<string, const FunctionDef*> functions;
+  for (const FunctionDef& function : graph_library.function()) {
+    functions[function.signature().name()] = &function;
+  }
+  std::unordered_map<string, string> gradients;
+  for (const GradientDef& gradient : graph_library.gradient()) {
+    gradients[gradient.function_name()] = gradient.gradient_func();
+  }
+
+  std::unordered_set<string> reachable;
+  std::vector<const FunctionDef*> stack;
+  auto visit = [&functions, &reachable, &stack](const string& name) {
+    auto it = functions.find(name);
+    if (it != functions.end() && reachable.insert(name).second) {
+      stack.push_back(it->second);
+    }
+  };
+  auto visit_node = [&visit](const NodeDef& node) {
+    visit(node.op());
+    for (const auto& attr : node.attr()) {
+      if (attr.second.has_func()) {
+        visit(attr.second.func().name());
+      }
+      for (const auto& func : attr.second.list().func()) {
+        visit(func.name());
+      }
+    }
+  };
+  for (int node : nodes) {
+    visit_node(graph.node(node));
+  }
+  while (!stack.empty()) {
+    const FunctionDef* function = stack.back();
+    stack.pop_back();
+    auto it = gradients.find(function->signature().name());
+    if (it != gradients.end()) {
+      visit(it->second);
+    }
+    for (const NodeDef& node : function->node_def()) {
+      visit_node(node);
+    }
+  }
+
+  for (const FunctionDef& function : graph_library.function()) {
+    if (reachable.count(function.signature().name()) > 0) {
+      *library->add_function() = function;
+    }
+  }
+  for (const GradientDef& gradient : graph_library.gradient()) {
+    if (reachable.count(gradient.function_name()) > 0) {
+      *library->add_gradient() = gradient;
+    }
+  }
+}
+
 }  // namespace
 
 // Queue of nodes to process. Nodes can be enqueued in any order, but will be
@@ -367,6 +466,22 @@ class TopoQueue {
 
   bool empty() const { return queue_.empty(); }
   std::size_t size() const { return queue_.size(); }
+  bool contains(const NodeDef* n) const {
+    return queue_.find(NodeAndId(n, topo_order_.at(n))) != queue_.end();
+  }
+  const NodeDef* front() const {
+    CHECK(!empty());
+    return queue_.begin()->first;
+  }
+  // Returns the enqueued nodes in topological order.
+  std::vector<const NodeDef*> nodes() const {
+    std::vector<const NodeDef*> nodes;
+    nodes.reserve(queue_.size());
+    for (const NodeAndId& node : queue_) {
+      nodes.push_back(node.first);
+    }
+    return nodes;
+  }
 
  private:
   using NodeAndId = std::pair<const NodeDef*, int>;
@@ -424,6 +539,23 @@ class SymbolicShapeRefiner {
     return it->second.inference_context.get();
   }
 
+  // Returns true if 'node' calls a function of the library of the graph.
+  bool IsFunctionCall(const NodeDef* node) const {
+    return function_library_.Find(node->op()) != nullptr;
+  }
+
+  // Returns true if 'node' is a function call whose body hasn't been inferred
+  // for the current shapes of its inputs yet.
+  bool FunctionBodyPending(const NodeDef* node) {
+    if (!IsFunctionCall(node) || !AddFunction(node).ok()) {
+      return false;
+    }
+    std::vector<TensorShapeProto> input_shapes;
+    string key;
+    return GetFunctionInputShapes(node, &input_shapes, &key).ok() &&
+           function_outputs_.find(key) == function_outputs_.end();
+  }
+
   // Forward the shapes from the function input nodes to
   // the argument nodes (which are Placeholder nodes), then
   // perform shape inference on the function body.
@@ -434,96 +566,73 @@ class SymbolicShapeRefiner {
   // In the event of an error, UpdateNode will simply set `node`'s
   // output shape to be Unknown.
   Status UpdateFunction(const NodeDef* node) {
-    auto it = fun_to_grappler_function_item_.find(node->op());
-    if (it == fun_to_grappler_function_item_.end()) {
-      return errors::InvalidArgument(
-          node->op(), " was not previously added to SymbolicShapeRefiner.");
-    }
-
-    GrapplerFunctionItem& grappler_function_item = it->second;
-    GraphView gv(&grappler_function_item.graph);
-
-    // Forward shapes from function input nodes to argument nodes.
-    for (int i = 0; i < grappler_function_item.inputs().size(); ++i) {
-      auto& fun_input = grappler_function_item.input(i);
-      if (fun_input.placeholders.size() > 1) {
-        // TODO(jmdecker): Handle case with multiple input placeholders
-        return errors::Unimplemented(
-            "Input arguments with multiple placeholders are not yet "
-            "supported.");
-      }
-      NodeDef* fun_node = gv.GetNode(fun_input.input_name);
-      const string& input = node->input(i);
-      const string& node_name = NodeName(input);
-
-      if (IsControlInput(input)) {
-        return errors::FailedPrecondition(
-            "Function inputs should not contain control nodes.");
-      }
+    std::vector<TensorShapeProto> input_shapes;
+    string key;
+    TF_RETURN_IF_ERROR(GetFunctionInputShapes(node, &input_shapes, &key));
 
-      NodeDef* input_node = graph_.GetNode(node_name);
-      if (input_node == nullptr) {
-        return errors::FailedPrecondition(node_name,
-                                          " was not found in the graph.");
-      }
-
-      InferenceContext* input_inference_context = GetContext(input_node);
-      if (input_inference_context == nullptr) {
-        return errors::FailedPrecondition(
-            "Inference context has not been created for ", node_name);
-      }
-
-      int output_port_num = NodePosition(input);
-      AttrValue attr_output_shape;
-      TensorShapeProto proto;
-      const auto& handle = input_inference_context->output(output_port_num);
-      input_inference_context->ShapeHandleToProto(handle, &proto);
-      *attr_output_shape.mutable_shape() = proto;
-      (*fun_node->mutable_attr())["shape"] = attr_output_shape;
+    auto it = function_outputs_.find(key);
+    if (it == function_outputs_.end()) {
+      it = function_outputs_.emplace(key, FunctionOutputs()).first;
+      it->second.status = InferFunctionOutputs(
+          fun_to_grappler_function_item_.at(node->op()), input_shapes,
+          &it->second.shapes);
     }
-
-    // Perform inference on function body.
-    GraphProperties gp(grappler_function_item);
-    TF_RETURN_IF_ERROR(gp.InferStatically(true));
+    TF_RETURN_IF_ERROR(it->second.status);
 
     // Add return nodes for output shapes.
     auto ic = GetContext(node);
-    int output = 0;
-    for (auto const& out_arg : grappler_function_item.outputs()) {
-      if (out_arg.output_tensors.size() > 1) {
-        // TODO(jmdecker): Handle case of multiple output tensors
-        return errors::Unimplemented(
-            "Output arguments with multiple output tensors are not yet "
-            "supported.");
-      }
-
-      // It is guaranteed that output_tensors does not contain any control
-      // inputs, so port_id >= 0.
-      string out_tensor = out_arg.output_tensors[0];
-      int port_id;
-      string node_name = ParseNodeName(out_tensor, &port_id);
+    for (int output = 0; output < it->second.shapes.size(); ++output) {
+      ShapeHandle out;
+      TF_RETURN_IF_ERROR(
+          ic->MakeShapeFromShapeProto(it->second.shapes[output], &out));
+      ic->set_output(output, out);
+    }
+    return Status::OK();
+  }
 
-      const NodeDef* retnode = gv.GetNode(node_name);
-      if (retnode == nullptr) {
-        return errors::FailedPrecondition("Unable to find return node ",
-                                          node_name, " for ", node->name());
+  // Infers the bodies of the function calls in 'nodes' whose inputs are known
+  // on 'thread_pool', so that UpdateFunction() finds their output shapes.
+  // Calls with the same function and input shapes are only inferred once.
+  void InferFunctionsInParallel(const std::vector<const NodeDef*>& nodes,
+                                thread::ThreadPool* thread_pool) {
+    struct Call {
+      const GrapplerFunctionItem* item;
+      std::vector<TensorShapeProto> input_shapes;
+      string key;
+    };
+    std::vector<Call> calls;
+    std::unordered_set<string> keys;
+    for (const NodeDef* node : nodes) {
+      if (!AddFunction(node).ok()) {
+        continue;
       }
-
-      auto output_properties = gp.GetOutputProperties(retnode->name());
-      if (port_id >= output_properties.size()) {
-        return errors::InvalidArgument(
-            out_tensor, " has invalid position ", port_id,
-            " (output_properties.size() = ", output_properties.size(), ").");
+      Call call;
+      if (!GetFunctionInputShapes(node, &call.input_shapes, &call.key).ok() ||
+          function_outputs_.find(call.key) != function_outputs_.end() ||
+          !keys.insert(call.key).second) {
+        continue;
       }
-      auto const& outprop = output_properties[port_id];
-      const TensorShapeProto& shape = outprop.shape();
-      ShapeHandle out;
-      TF_RETURN_IF_ERROR(ic->MakeShapeFromShapeProto(shape, &out));
-      ic->set_output(output, out);
-      output++;
+      call.item = &fun_to_grappler_function_item_.at(node->op());
+      calls.push_back(std::move(call));
+    }
+    if (calls.size() < 2) {
+      return;
     }
 
-    return Status::OK();
+    std::vector<FunctionOutputs> outputs(calls.size());
+    BlockingCounter counter(calls.size());
+    for (int i = 0; i < calls.size(); ++i) {
+      thread_pool->Schedule([&calls, &outputs, &counter, i]() {
+        outputs[i].status = InferFunctionOutputs(
+            *calls[i].item, calls[i].input_shapes, &outputs[i].shapes);
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+    VLOG(2) << "Inferred " << calls.size() << " function calls in parallel";
+    for (int i = 0; i < calls.size(); ++i) {
+      function_outputs_[calls[i].key] = std::move(outputs[i]);
+    }
   }
 
   Status UpdateNode(const NodeDef* node, bool* refined) {
@@ -862,6 +971,114 @@ class SymbolicShapeRefiner {
   }
 
  private:
+  // The output shapes of a function for given input shapes.
+  struct FunctionOutputs {
+    Status status;
+    std::vector<TensorShapeProto> shapes;
+  };
+
+  // Collects the shapes of the inputs of the function call 'node', and a key
+  // identifying the function and these shapes.
+  Status GetFunctionInputShapes(const NodeDef* node,
+                                std::vector<TensorShapeProto>* input_shapes,
+                                string* key) {
+    auto it = fun_to_grappler_function_item_.find(node->op());
+    if (it == fun_to_grappler_function_item_.end()) {
+      return errors::InvalidArgument(
+          node->op(), " was not previously added to SymbolicShapeRefiner.");
+    }
+    const int num_inputs = it->second.inputs().size();
+    input_shapes->resize(num_inputs);
+    *key = node->op();
+    for (int i = 0; i < num_inputs; ++i) {
+      const string& input = node->input(i);
+      const string& node_name = NodeName(input);
+
+      if (IsControlInput(input)) {
+        return errors::FailedPrecondition(
+            "Function inputs should not contain control nodes.");
+      }
+
+      NodeDef* input_node = graph_.GetNode(node_name);
+      if (input_node == nullptr) {
+        return errors::FailedPrecondition(node_name,
+                                          " was not found in the graph.");
+      }
+
+      InferenceContext* input_inference_context = GetContext(input_node);
+      if (input_inference_context == nullptr) {
+        return errors::FailedPrecondition(
+            "Inference context has not been created for ", node_name);
+      }
+
+      int output_port_num = NodePosition(input);
+      const auto& handle = input_inference_context->output(output_port_num);
+      input_inference_context->ShapeHandleToProto(handle, &(*input_shapes)[i]);
+      strings::StrAppend(key, "|", (*input_shapes)[i].SerializeAsString());
+    }
+    return Status::OK();
+  }
+
+  // Infers the body of the function 'function_item' called with inputs of
+  // shapes 'input_shapes'. This may run on a thread of the inference thread
+  // pool, so it doesn't use the pool itself.
+  static Status InferFunctionOutputs(
+      const GrapplerFunctionItem& function_item,
+      const std::vector<TensorShapeProto>& input_shapes,
+      std::vector<TensorShapeProto>* output_shapes) {
+    GrapplerFunctionItem grappler_function_item = function_item;
+    GraphView gv(&grappler_function_item.graph);
+
+    // Forward shapes from function input nodes to argument nodes.
+    for (int i = 0; i < grappler_function_item.inputs().size(); ++i) {
+      auto& fun_input = grappler_function_item.input(i);
+      if (fun_input.placeholders.size() > 1) {
+        // TODO(jmdecker): Handle case with multiple input placeholders
+        return errors::Unimplemented(
+            "Input arguments with multiple placeholders are not yet "
+            "supported.");
+      }
+      NodeDef* fun_node = gv.GetNode(fun_input.input_name);
+      *(*fun_node->mutable_attr())["shape"].mutable_shape() = input_shapes[i];
+    }
+
+    // Perform inference on function body.
+    GraphProperties gp(grappler_function_item);
+    TF_RETURN_IF_ERROR(gp.InferStatically(true, nullptr));
+
+    output_shapes->clear();
+    for (auto const& out_arg : grappler_function_item.outputs()) {
+      if (out_arg.output_tensors.size() > 1) {
+        // TODO(jmdecker): Handle case of multiple output tensors
+        return errors::Unimplemented(
+            "Output arguments with multiple output tensors are not yet "
+            "supported.");
+      }
+
+      // It is guaranteed that output_tensors does not contain any control
+      // inputs, so port_id >= 0.
+      string out_tensor = out_arg.output_tensors[0];
+      int port_id;
+      string node_name = ParseNodeName(out_tensor, &port_id);
+
+      const NodeDef* retnode = gv.GetNode(node_name);
+      if (retnode == nullptr) {
+        return errors::FailedPrecondition("Unable to find return node ",
+                                          node_name, " for ",
+                                          grappler_function_item.id);
+      }
+
+      auto output_properties = gp.GetOutputProperties(retnode->name());
+      if (port_id >= output_properties.size()) {
+        return errors::InvalidArgument(
+            out_tensor, " has invalid position ", port_id,
+            " (output_properties.size() = ", output_properties.size(), ").");
+      }
+      output_shapes->push_back(output_properties[port_id].shape());
+    }
+    return Status::OK();
+  }
+
   // Return the one ShapeHandle used to denote a fully unknown shape for a node
   // output.
   ShapeHandle GetUnknownOutputShape(const NodeDef* node, int index) {
@@ -1060,6 +1277,8 @@ class SymbolicShapeRefiner {
   std::unordered_map<DimId, DimensionHandle, HashDimId> unknown_dims_;
   std::unordered_map<string, GrapplerFunctionItem>
       fun_to_grappler_function_item_;
+  // Output shapes of the function calls, keyed by function and input shapes.
+  std::unordered_map<string, FunctionOutputs> function_outputs_;
   FunctionLibraryDefinition function_library_;
   const std::unordered_map<string, std::unordered_set<int>>& fed_ports_;
 };
@@ -1242,7 +1461,7 @@ Status GraphProperties::UpdateShapes(
 Status GraphProperties::PropagateShapes(
     SymbolicShapeRefiner* shape_refiner, TopoQueue* new_shapes,
     const std::unordered_map<const NodeDef*, const NodeDef*>& resource_handles,
-    int num_loops) const {
+    int num_loops, thread::ThreadPool* thread_pool) const {
   // Limit the number of iterations to prevent infinite loops in the presence of
   // incorrect shape functions. The algorithm should converge in at most
   // num_nested_loops^2 * max_rank. We approximate max_rank with the constant 4.
@@ -1263,6 +1482,29 @@ Status GraphProperties::PropagateShapes(
     int64 num_loop_iterations = 0;
     while (!new_shapes->empty() &&
            num_loop_iterations++ < max_loop_iterations) {
+      if (thread_pool != nullptr &&
+          shape_refiner->FunctionBodyPending(new_shapes->front())) {
+        // Infer the bodies of the enqueued function calls that don't depend
+        // on other enqueued nodes together, since their inputs are known.
+        std::vector<const NodeDef*> calls;
+        for (const NodeDef* node : new_shapes->nodes()) {
+          if (!shape_refiner->IsFunctionCall(node)) {
+            continue;
+          }
+          bool ready = true;
+          for (const GraphView::OutputPort& fanin :
+               shape_refiner->graph().GetFanins(*node, false)) {
+            if (new_shapes->contains(fanin.node)) {
+              ready = false;
+              break;
+            }
+          }
+          if (ready) {
+            calls.push_back(node);
+          }
+        }
+        shape_refiner->InferFunctionsInParallel(calls, thread_pool);
+      }
       const NodeDef* n = new_shapes->pop();
       bool updated = false;
       TF_RETURN_IF_ERROR(
@@ -1386,6 +1628,334 @@ Status GraphProperties::UpdateEnqueue(
 }
 
 Status GraphProperties::InferStatically(bool assume_valid_feeds) {
+  return InferStatically(
+      assume_valid_feeds,
+      item_.graph.node_size() >= kMinNodesForParallelInference
+          ? InferenceThreadPool()
+          : nullptr);
+}
+
+Status GraphProperties::InferStatically(bool assume_valid_feeds,
+                                        thread::ThreadPool* thread_pool) {
+  input_properties_.clear();
+  output_properties_.clear();
+  assume_valid_feeds_ = assume_valid_feeds;
+  bool inferred = false;
+  if (thread_pool != nullptr) {
+    TF_RETURN_IF_ERROR(
+        InferComponentsInParallel(assume_valid_feeds, thread_pool, &inferred));
+  }
+  if (!inferred) {
+    TF_RETURN_IF_ERROR(InferSerially(assume_valid_feeds, thread_pool));
+  }
+  inferred_statically_ = true;
+  return Status::OK();
+}
+
+Status GraphProperties::InferComponentsInParallel(
+    bool assume_valid_feeds, thread::ThreadPool* thread_pool, bool* inferred) {
+  *inferred = false;
+  const GraphDef& graph = item_.graph;
+  const int num_nodes = graph.node_size();
+  std::unordered_map<string, int> node_index;
+  node_index.reserve(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    node_index[graph.node(i).name()] = i;
+  }
+
+  // Find the weakly connected components of the graph, control dependencies
+  // included.
+  std::vector<int> parent(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    parent[i] = i;
+  }
+  auto find_root = [&parent](int i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  };
+  for (int i = 0; i < num_nodes; ++i) {
+    for (const string& input : graph.node(i).input()) {
+      auto it = node_index.find(NodeName(input));
+      if (it == node_index.end()) {
+        // Let the serial inference report the error.
+        return Status::OK();
+      }
+      parent[find_root(i)] = find_root(it->second);
+    }
+  }
+  std::unordered_map<int, std::vector<int>> components;
+  for (int i = 0; i < num_nodes; ++i) {
+    components[find_root(i)].push_back(i);
+  }
+  if (components.size() < 2) {
+    return Status::OK();
+  }
+
+  // Spread the components over a few subgraphs of similar sizes, largest
+  // components first.
+  std::vector<const std::vector<int>*> sorted_components;
+  sorted_components.reserve(components.size());
+  for (const auto& component : components) {
+    sorted_components.push_back(&component.second);
+  }
+  std::sort(sorted_components.begin(), sorted_components.end(),
+            [](const std::vector<int>* a, const std::vector<int>* b) {
+              return a->size() > b->size();
+            });
+  const int num_subgraphs = std::min<int>(sorted_components.size(),
+                                          4 * thread_pool->NumThreads());
+  std::vector<std::vector<int>> subgraphs(num_subgraphs);
+  for (const std::vector<int>* component : sorted_components) {
+    auto smallest = std::min_element(
+        subgraphs.begin(), subgraphs.end(),
+        [](const std::vector<int>& a, const std::vector<int>& b) {
+          return a.size() < b.size();
+        });
+    smallest->insert(smallest->end(), component->begin(), component->end());
+  }
+
+  std::vector<int> subgraph_of_node(num_nodes);
+  std::vector<GrapplerItem> items(num_subgraphs);
+  for (int i = 0; i < num_subgraphs; ++i) {
+    // Keep the nodes in the order of the graph, which is often topological.
+    std::sort(subgraphs[i].begin(), subgraphs[i].end());
+    GrapplerItem& subgraph_item = items[i];
+    subgraph_item.id = item_.id;
+    *subgraph_item.graph.mutable_versions() = graph.versions();
+    // Only copy the functions the subgraph calls, since the library may be
+    // large and every subgraph would otherwise get a copy of all of it.
+    AddReachableFunctions(graph, subgraphs[i],
+                          subgraph_item.graph.mutable_library());
+    for (int node : subgraphs[i]) {
+      *subgraph_item.graph.add_node() = graph.node(node);
+      subgraph_of_node[node] = i;
+    }
+  }
+  for (const auto& feed : item_.feed) {
+    auto it = node_index.find(NodeName(feed.first));
+    if (it != node_index.end()) {
+      items[subgraph_of_node[it->second]].feed.push_back(feed);
+    }
+  }
+
+  std::vector<std::unique_ptr<GraphProperties>> properties(num_subgraphs);
+  std::vector<Status> statuses(num_subgraphs);
+  BlockingCounter counter(num_subgraphs);
+  for (int i = 0; i < num_subgraphs; ++i) {
+    thread_pool->Schedule([&, i]() {
+      properties[i].reset(new GraphProperties(items[i]));
+      statuses[i] = properties[i]->InferStatically(assume_valid_feeds, nullptr);
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  for (const Status& status : statuses) {
+    TF_RETURN_IF_ERROR(status);
+  }
+
+  VLOG(1) << "Inferred " << components.size() << " independent subgraphs of "
+          << item_.id << " on " << num_subgraphs << " threads";
+  int64 min_symbolic_dim = -1;
+  for (int i = 0; i < num_subgraphs; ++i) {
+    std::vector<string> nodes;
+    nodes.reserve(subgraphs[i].size());
+    for (int node : subgraphs[i]) {
+      nodes.push_back(graph.node(node).name());
+    }
+    MergeProperties(*properties[i], nodes, &min_symbolic_dim);
+  }
+  *inferred = true;
+  return Status::OK();
+}
+
+void GraphProperties::MergeProperties(const GraphProperties& properties,
+                                      const std::vector<string>& nodes,
+                                      int64* min_symbolic_dim) {
+  // Symbolic dimensions are numbered from -2 downwards.
+  const int64 offset = -*min_symbolic_dim - 1;
+  auto merge = [offset, min_symbolic_dim](
+                   const std::vector<OpInfo::TensorProperties>& from,
+                   std::vector<OpInfo::TensorProperties>* to) {
+    *to = from;
+    for (auto& property : *to) {
+      for (auto& dim : *property.mutable_shape()->mutable_dim()) {
+        if (dim.size() < -1) {
+          dim.set_size(dim.size() - offset);
+          *min_symbolic_dim = std::min(*min_symbolic_dim, dim.size());
+        }
+      }
+    }
+  };
+  for (const string& node : nodes) {
+    if (properties.HasInputProperties(node)) {
+      merge(properties.GetInputProperties(node), &input_properties_[node]);
+    } else {
+      input_properties_.erase(node);
+    }
+    if (properties.HasOutputProperties(node)) {
+      merge(properties.GetOutputProperties(node), &output_properties_[node]);
+    } else {
+      output_properties_.erase(node);
+    }
+  }
+}
+
+Status GraphProperties::UpdateStatically(
+    const std::unordered_set<string>& modified_nodes) {
+  if (!inferred_statically_) {
+    return errors::FailedPrecondition(
+        "Properties must be inferred statically before being updated");
+  }
+  const GraphDef& graph = item_.graph;
+  for (const string& node : modified_nodes) {
+    ClearInputProperties(node);
+    ClearOutputProperties(node);
+  }
+
+  std::unordered_map<string, const NodeDef*> nodes;
+  std::unordered_map<string, std::vector<const NodeDef*>> fanouts;
+  nodes.reserve(graph.node_size());
+  for (const NodeDef& node : graph.node()) {
+    nodes[node.name()] = &node;
+    for (const string& input : node.input()) {
+      fanouts[NodeName(input)].push_back(&node);
+    }
+  }
+
+  // The modified nodes and their transitive fanout need to be inferred again.
+  std::unordered_set<const NodeDef*> affected;
+  std::vector<const NodeDef*> stack;
+  for (const string& node : modified_nodes) {
+    auto it = nodes.find(node);
+    if (it != nodes.end() && affected.insert(it->second).second) {
+      stack.push_back(it->second);
+    }
+  }
+  bool infer_whole_graph = false;
+  while (!stack.empty() && !infer_whole_graph) {
+    const NodeDef* node = stack.back();
+    stack.pop_back();
+    // Loops and queues propagate shapes back to their fanin.
+    if (IsMerge(*node) || IsSwitch(*node) || IsEnter(*node) || IsExit(*node) ||
+        IsNextIteration(*node) || IsQueue(*node) || IsEnqueue(*node) ||
+        IsDequeue(*node)) {
+      infer_whole_graph = true;
+    }
+    for (const NodeDef* fanout : fanouts[node->name()]) {
+      if (affected.insert(fanout).second) {
+        stack.push_back(fanout);
+      }
+    }
+  }
+  if (affected.size() > kMaxIncrementalUpdateFraction * graph.node_size()) {
+    infer_whole_graph = true;
+  }
+
+  // Build a graph made of the affected nodes, in which their other fanins are
+  // constants or placeholders with the known shapes.
+  GrapplerItem subgraph_item;
+  subgraph_item.id = item_.id;
+  *subgraph_item.graph.mutable_versions() = graph.versions();
+  std::unordered_set<string> boundary_nodes;
+  std::vector<string> affected_nodes;
+  std::vector<int> affected_indices;
+  for (int i = 0; i < graph.node_size(); ++i) {
+    if (infer_whole_graph) {
+      break;
+    }
+    const NodeDef& node = graph.node(i);
+    if (affected.find(&node) == affected.end()) {
+      continue;
+    }
+    affected_nodes.push_back(node.name());
+    affected_indices.push_back(i);
+    NodeDef* new_node = subgraph_item.graph.add_node();
+    *new_node = node;
+    new_node->clear_input();
+    for (const string& input : node.input()) {
+      int port;
+      const string fanin_name = ParseNodeName(input, &port);
+      auto it = nodes.find(fanin_name);
+      if (it == nodes.end()) {
+        // Let the full inference report the error.
+        infer_whole_graph = true;
+        break;
+      }
+      const NodeDef* fanin = it->second;
+      if (affected.find(fanin) != affected.end()) {
+        new_node->add_input(input);
+        continue;
+      }
+      if (port < 0) {
+        // Control dependencies don't carry shapes.
+        continue;
+      }
+      if (IsConstant(*fanin)) {
+        // Preserve the values of the constants.
+        if (boundary_nodes.insert(fanin_name).second) {
+          NodeDef* constant = subgraph_item.graph.add_node();
+          *constant = *fanin;
+          constant->clear_input();
+        }
+        new_node->add_input(input);
+        continue;
+      }
+      const auto& outputs = GetOutputProperties(fanin_name);
+      if (port >= outputs.size() || outputs[port].dtype() == DT_RESOURCE ||
+          outputs[port].dtype() == DT_VARIANT) {
+        // Placeholders can't carry the shapes of handles.
+        infer_whole_graph = true;
+        break;
+      }
+      const string placeholder_name =
+          strings::StrCat(kBoundaryNodePrefix, fanin_name, "_", port);
+      if (boundary_nodes.insert(placeholder_name).second) {
+        NodeDef* placeholder = subgraph_item.graph.add_node();
+        placeholder->set_name(placeholder_name);
+        placeholder->set_op("Placeholder");
+        placeholder->set_device(fanin->device());
+        (*placeholder->mutable_attr())["dtype"].set_type(outputs[port].dtype());
+        TensorShapeProto* shape =
+            (*placeholder->mutable_attr())["shape"].mutable_shape();
+        *shape = outputs[port].shape();
+        for (auto& dim : *shape->mutable_dim()) {
+          dim.set_size(std::max<int64>(dim.size(), -1));
+        }
+      }
+      new_node->add_input(placeholder_name);
+    }
+  }
+  if (infer_whole_graph) {
+    VLOG(1) << "Inferring all the shapes of " << item_.id << " again";
+    return InferStatically(assume_valid_feeds_);
+  }
+  if (affected_nodes.empty()) {
+    return Status::OK();
+  }
+
+  for (const auto& feed : item_.feed) {
+    auto it = nodes.find(NodeName(feed.first));
+    if (it != nodes.end() && affected.find(it->second) != affected.end()) {
+      subgraph_item.feed.push_back(feed);
+    }
+  }
+  AddReachableFunctions(graph, affected_indices,
+                        subgraph_item.graph.mutable_library());
+  GraphProperties properties(subgraph_item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(assume_valid_feeds_, nullptr));
+  int64 min_symbolic_dim = std::min(MinSymbolicDim(input_properties_),
+                                    MinSymbolicDim(output_properties_));
+  MergeProperties(properties, affected_nodes, &min_symbolic_dim);
+  VLOG(2) << "Inferred the shapes of " << affected_nodes.size() << " nodes of "
+          << item_.id << " again";
+  return Status::OK();
+}
+
+Status GraphProperties::InferSerially(bool assume_valid_feeds,
+                                      thread::ThreadPool* thread_pool) {
   FunctionLibraryDefinition function_library(OpRegistry::Global(),
                                              item_.graph.library());
   std::unordered_map<string, std::unordered_set<int>> fed_ports;
@@ -1484,8 +2054,8 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds) {
     new_shapes.push(node);
   }
   // Propagate shapes normally.
-  TF_RETURN_IF_ERROR(
-      PropagateShapes(&refiner, &new_shapes, resource_handles, num_loops));
+  TF_RETURN_IF_ERROR(PropagateShapes(&refiner, &new_shapes, resource_handles,
+                                     num_loops, thread_pool));
 
   // Track shapes globally across the graph.
   SymbolicShapeManager shape_manager;
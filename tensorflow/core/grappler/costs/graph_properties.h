@@ -17,11 +17,13 @@ limitations under the License.
 #define TENSORFLOW_CORE_GRAPPLER_COSTS_GRAPH_PROPERTIES_H_
 
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "tensorflow/core/framework/shape_inference.h"
 #include "tensorflow/core/grappler/clusters/cluster.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
 #include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 
 namespace tensorflow {
 
@@ -46,7 +48,26 @@ class GraphProperties {
   // However, it can help infer shapes in the fanout of fed nodes (even though
   // the correctness of these shapes can't be guaranteed), so in some cases
   // (such as simulation or scheduling) it makes sense of keep these shapes.
+  //
+  // Large graphs made of several independent subgraphs are inferred in
+  // parallel on a process-wide thread pool.
   Status InferStatically(bool assume_valid_feeds);
+  // Same as above, but infers the independent subgraphs of the graph in
+  // parallel on 'thread_pool', regardless of the size of the graph. A graph
+  // made of a single component infers the bodies of its independent function
+  // calls in parallel on 'thread_pool' instead. If 'thread_pool' is null, the
+  // whole graph is inferred on the calling thread.
+  Status InferStatically(bool assume_valid_feeds,
+                         thread::ThreadPool* thread_pool);
+  // Updates the properties after a local rewrite of the graph of the item,
+  // which must have been inferred statically before. 'modified_nodes' lists the
+  // nodes that were added, removed, or whose inputs or attributes changed: only
+  // these nodes and their transitive fanout are inferred again, using the
+  // known properties of their other fanins. This is less precise than a full
+  // inference, since symbolic dimensions shared with the rest of the graph
+  // are forgotten. Falls back to a full inference when the rewrite touches
+  // control flow or queues, or a large part of the graph.
+  Status UpdateStatically(const std::unordered_set<string>& modified_nodes);
   // Infer the shape by running the graph on the specified cluster and recording
   // the shapes of the processed tensors.
   Status InferDynamically(Cluster* cluster);
@@ -109,19 +130,39 @@ class GraphProperties {
                       const std::unordered_map<const NodeDef*, const NodeDef*>&
                           resource_handles,
                       const NodeDef* n, bool* new_shapes) const;
+  // Infers the shapes of the whole graph on the calling thread. The bodies of
+  // independent function calls are inferred on 'thread_pool' if it isn't null.
+  Status InferSerially(bool assume_valid_feeds,
+                       thread::ThreadPool* thread_pool);
+  // Infers the shapes of the weakly connected components of the graph in
+  // parallel on 'thread_pool'. Sets 'inferred' to false if the graph doesn't
+  // have independent subgraphs.
+  Status InferComponentsInParallel(bool assume_valid_feeds,
+                                   thread::ThreadPool* thread_pool,
+                                   bool* inferred);
+  // Adds the properties inferred for 'nodes' by 'properties', renumbering
+  // their symbolic dimensions so that they don't alias the symbolic
+  // dimensions already known, the smallest of which is 'min_symbolic_dim'.
+  void MergeProperties(const GraphProperties& properties,
+                       const std::vector<string>& nodes,
+                       int64* min_symbolic_dim);
+
   // Propagate the shapes for the nodes enqueued in new_shapes and their
-  // transitive fanout until a fixed point is reached.
+  // transitive fanout until a fixed point is reached. Function calls whose
+  // inputs are ready are inferred together on 'thread_pool' if it isn't null.
   Status PropagateShapes(
       SymbolicShapeRefiner* shape_refiner, TopoQueue* new_shapes,
       const std::unordered_map<const NodeDef*, const NodeDef*>&
           resource_handles,
-      int num_loops) const;
+      int num_loops, thread::ThreadPool* thread_pool) const;
 
   // Data members
   const GrapplerItem& item_;
   std::map<string, std::vector<OpInfo::TensorProperties>> input_properties_;
   std::map<string, std::vector<OpInfo::TensorProperties>> output_properties_;
   const std::vector<OpInfo::TensorProperties> missing_properties_;
+  bool assume_valid_feeds_ = false;
+  bool inferred_statically_ = false;
 };
 
 }  // end namespace grappler
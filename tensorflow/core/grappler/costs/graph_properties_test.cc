@@ -1202,6 +1202,191 @@ TEST_F(GraphPropertiesTest, SymbolicShapes) {
   EXPECT_EQ(shape_h.dim(1).size(), shape_c.dim(1).size());
 }
 
+TEST_F(GraphPropertiesTest, ParallelInference) {
+  // Two independent subgraphs with symbolic dimensions.
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output a =
+      ops::Placeholder(s.WithOpName("a"), DT_FLOAT,
+                       ops::Placeholder::Shape(PartialTensorShape({-1, 10})));
+  Output b = ops::Identity(s.WithOpName("b"), a);
+  Output c =
+      ops::Placeholder(s.WithOpName("c"), DT_FLOAT,
+                       ops::Placeholder::Shape(PartialTensorShape({-1, 10})));
+  Output d = ops::Identity(s.WithOpName("d"), c);
+  Output e = ops::Const(s.WithOpName("e"), 1.0f, {2, 3});
+  Output f = ops::Square(s.WithOpName("f"), e);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  GraphProperties serial_properties(item);
+  TF_CHECK_OK(serial_properties.InferStatically(false, nullptr));
+  thread::ThreadPool thread_pool(Env::Default(), "test", 2);
+  GraphProperties properties(item);
+  TF_CHECK_OK(properties.InferStatically(false, &thread_pool));
+
+  for (const NodeDef& node : item.graph.node()) {
+    const auto& serial_outputs =
+        serial_properties.GetOutputProperties(node.name());
+    const auto& outputs = properties.GetOutputProperties(node.name());
+    ASSERT_EQ(serial_outputs.size(), outputs.size()) << node.name();
+    for (int i = 0; i < outputs.size(); ++i) {
+      EXPECT_EQ(PropToString(serial_outputs[i]), PropToString(outputs[i]));
+    }
+    EXPECT_EQ(serial_properties.GetInputProperties(node.name()).size(),
+              properties.GetInputProperties(node.name()).size());
+  }
+  EXPECT_EQ("float: [2,3]",
+            PropToString(properties.GetOutputProperties("f").at(0)));
+
+  // Symbolic dimensions of different subgraphs don't alias.
+  const auto shape_a = properties.GetOutputProperties("a").at(0).shape();
+  const auto shape_b = properties.GetOutputProperties("b").at(0).shape();
+  const auto shape_c = properties.GetOutputProperties("c").at(0).shape();
+  const auto shape_d = properties.GetOutputProperties("d").at(0).shape();
+  EXPECT_GE(-2, shape_a.dim(0).size());
+  EXPECT_EQ(shape_a.dim(0).size(), shape_b.dim(0).size());
+  EXPECT_GE(-2, shape_c.dim(0).size());
+  EXPECT_EQ(shape_c.dim(0).size(), shape_d.dim(0).size());
+  EXPECT_NE(shape_a.dim(0).size(), shape_c.dim(0).size());
+}
+
+TEST_F(GraphPropertiesTest, ParallelFunctionInference) {
+  // MyFunc is only called from one of the two independent subgraphs.
+  FunctionDefLibrary library;
+  *library.add_function() = FunctionDefHelper::Create(
+      "MyFunc",                                                 // Name
+      {"x: float"},                                             // Inputs
+      {"out: float"},                                           // Outputs
+      {},                                                       // Attrs
+      {{{"a"}, "Square", {"x"}, {{"T", DataType::DT_FLOAT}}}},  // Nodes
+      {{"out", "a:y:0"}});                                      // Returns
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  TF_CHECK_OK(s.graph()->AddFunctionLibrary(library));
+  Output placeholder =
+      ops::Placeholder(s.WithOpName("Placeholder"), DataType::DT_FLOAT,
+                       ops::Placeholder::Shape(TensorShape({2, 3})));
+  auto _placeholder = tensorflow::ops::AsNodeOut(s, placeholder);
+  auto builder =
+      tensorflow::NodeBuilder("MyFunc", "MyFunc", s.graph()->op_registry());
+  tensorflow::Node* func_op;
+  TF_CHECK_OK(builder.Input(_placeholder).Finalize(s.graph(), &func_op));
+  Output e = ops::Const(s.WithOpName("e"), 1.0f, {4, 5});
+  Output f = ops::Square(s.WithOpName("f"), e);
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  thread::ThreadPool thread_pool(Env::Default(), "test", 2);
+  GraphProperties properties(item);
+  TF_CHECK_OK(properties.InferStatically(false, &thread_pool));
+  EXPECT_EQ("float: [2,3]",
+            PropToString(properties.GetOutputProperties("MyFunc").at(0)));
+  EXPECT_EQ("float: [4,5]",
+            PropToString(properties.GetOutputProperties("f").at(0)));
+}
+
+TEST_F(GraphPropertiesTest, IncrementalUpdate) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output a =
+      ops::Placeholder(s.WithOpName("a"), DT_FLOAT,
+                       ops::Placeholder::Shape(PartialTensorShape({2, 3})));
+  Output b =
+      ops::Placeholder(s.WithOpName("b"), DT_FLOAT,
+                       ops::Placeholder::Shape(PartialTensorShape({-1, 7})));
+  Output c = ops::Identity(s.WithOpName("c"), a);
+  Output d = ops::Square(s.WithOpName("d"), c);
+  Output shape = ops::Const(s.WithOpName("shape"), {-1}, {1});
+  Output e = ops::Reshape(s.WithOpName("e"), d, shape);
+  Output f = ops::Identity(s.WithOpName("f"), b);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  GraphProperties properties(item);
+  EXPECT_FALSE(properties.UpdateStatically({"c"}).ok());
+  TF_CHECK_OK(properties.InferStatically(false));
+  EXPECT_EQ("float: [2,3]",
+            PropToString(properties.GetOutputProperties("d").at(0)));
+  EXPECT_EQ("float: [6]",
+            PropToString(properties.GetOutputProperties("e").at(0)));
+  const int64 symbolic_dim =
+      properties.GetOutputProperties("f").at(0).shape().dim(0).size();
+  EXPECT_GE(-2, symbolic_dim);
+
+  // Rewrite c to read b instead of a: only c and its fanout change.
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    if (node.name() == "c") {
+      node.set_input(0, "b");
+    }
+  }
+  TF_CHECK_OK(properties.UpdateStatically({"c"}));
+  EXPECT_EQ("float: [2,3]",
+            PropToString(properties.GetOutputProperties("a").at(0)));
+  EXPECT_EQ("float: [-1,7]",
+            PropToString(properties.GetInputProperties("c").at(0)));
+  EXPECT_EQ("float: [-1,7]",
+            PropToString(properties.GetOutputProperties("d").at(0)));
+  EXPECT_EQ("float: [-1]",
+            PropToString(properties.GetOutputProperties("e").at(0)));
+  // The value of the shape is still known.
+  EXPECT_TRUE(properties.GetInputProperties("e").at(1).has_value());
+  EXPECT_EQ(symbolic_dim,
+            properties.GetOutputProperties("f").at(0).shape().dim(0).size());
+  // The new symbolic dimensions don't alias the ones of the rest of the graph.
+  const int64 new_symbolic_dim =
+      properties.GetOutputProperties("d").at(0).shape().dim(0).size();
+  EXPECT_GE(-2, new_symbolic_dim);
+  EXPECT_NE(symbolic_dim, new_symbolic_dim);
+  EXPECT_FALSE(properties.HasOutputProperties("GraphPropertiesBoundary/b_0"));
+}
+
+TEST_F(GraphPropertiesTest, SingleComponentParallelFunctionInference) {
+  // Both calls of MyFunc depend on the same placeholder, so the graph has a
+  // single component and the function bodies are inferred in parallel.
+  FunctionDefLibrary library;
+  *library.add_function() = FunctionDefHelper::Create(
+      "MyFunc",                                                 // Name
+      {"x: float"},                                             // Inputs
+      {"out: float"},                                           // Outputs
+      {},                                                       // Attrs
+      {{{"a"}, "Square", {"x"}, {{"T", DataType::DT_FLOAT}}}},  // Nodes
+      {{"out", "a:y:0"}});                                      // Returns
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  TF_CHECK_OK(s.graph()->AddFunctionLibrary(library));
+  Output placeholder =
+      ops::Placeholder(s.WithOpName("Placeholder"), DataType::DT_FLOAT,
+                       ops::Placeholder::Shape(TensorShape({2, 3})));
+  Output transpose = ops::Transpose(s.WithOpName("Transpose"), placeholder,
+                                    ops::Const(s.WithOpName("perm"), {1, 0}));
+  tensorflow::Node* func1;
+  TF_CHECK_OK(
+      tensorflow::NodeBuilder("MyFunc1", "MyFunc", s.graph()->op_registry())
+          .Input(tensorflow::ops::AsNodeOut(s, placeholder))
+          .Finalize(s.graph(), &func1));
+  tensorflow::Node* func2;
+  TF_CHECK_OK(
+      tensorflow::NodeBuilder("MyFunc2", "MyFunc", s.graph()->op_registry())
+          .Input(tensorflow::ops::AsNodeOut(s, transpose))
+          .Finalize(s.graph(), &func2));
+  tensorflow::Node* func3;
+  TF_CHECK_OK(
+      tensorflow::NodeBuilder("MyFunc3", "MyFunc", s.graph()->op_registry())
+          .Input(tensorflow::ops::AsNodeOut(s, placeholder))
+          .Finalize(s.graph(), &func3));
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  thread::ThreadPool thread_pool(Env::Default(), "test", 2);
+  GraphProperties properties(item);
+  TF_CHECK_OK(properties.InferStatically(false, &thread_pool));
+  EXPECT_EQ("float: [2,3]",
+            PropToString(properties.GetOutputProperties("MyFunc1").at(0)));
+  EXPECT_EQ("float: [3,2]",
+            PropToString(properties.GetOutputProperties("MyFunc2").at(0)));
+  EXPECT_EQ("float: [2,3]",
+            PropToString(properties.GetOutputProperties("MyFunc3").at(0)));
+}
+
 TEST_F(GraphPropertiesTest, DoNotValidateColocationConstraints) {
   tensorflow::Scope s = tensorflow::Scope::NewRootScope();
   Output a = ops::Const(s.WithOpName("a"), 1.0f, {1});
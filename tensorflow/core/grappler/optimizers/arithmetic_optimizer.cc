@@ -3189,51 +3189,90 @@ Status ArithmeticOptimizer::SimplifyArithmeticOps(bool can_use_shapes) {
   VLOG(1) << "Run " << pipeline.NumStages() << " arithmetic optimizer stages: "
           << str_util::Join(pipeline.StageNames(), ", ");
 
-  while (!nodes_to_simplify.Empty()) {
-    NodeDef* node = nodes_to_simplify.PopBack();
-
-    string simplified_tensor = "";
-    bool optimized = pipeline.PassThroughAllStages(node, &simplified_tensor);
-
-    // If the node was not optimized by any of the stages, go to the next one.
-    if (!optimized) continue;
-
-    // re-wire consumers of an old node to the new one
-    if (NodeName(simplified_tensor) != node->name()) {
-      // Always consider simplified_tensor for further optimizations.
-      NodeDef* simplified_node = node_map_->GetNode(simplified_tensor);
-      if (simplified_node != nullptr) {
-        nodes_to_simplify.PushBack(simplified_node);
+  // Passes the nodes to simplify through the pipeline until none is left,
+  // adding the nodes it changes to 'modified_nodes' if it isn't null.
+  const auto simplify = [this, &pipeline, &nodes_to_simplify](
+                            std::unordered_set<string>* modified_nodes) {
+    while (!nodes_to_simplify.Empty()) {
+      NodeDef* node = nodes_to_simplify.PopBack();
+
+      string simplified_tensor = "";
+      bool optimized = pipeline.PassThroughAllStages(node, &simplified_tensor);
+
+      // If the node was not optimized by any of the stages, go to the next one.
+      if (!optimized) continue;
+      if (modified_nodes != nullptr) {
+        modified_nodes->insert(node->name());
       }
-      // When `node` is simplified to another node rather than in-place, the
-      // consumers of `node` are already redirected to `simplified_tensor`.
-      // Re-push the consumers into `nodes_to_simplify` for further
-      // optimizations.
-      const std::set<NodeDef*> outputs = node_map_->GetOutputs(node->name());
-      std::vector<NodeDef*> consumers(outputs.begin(), outputs.end());
-      std::sort(consumers.begin(), consumers.end(),
-                [](const NodeDef* n1, const NodeDef* n2) {
-                  return n1->name() < n2->name();
-                });
-      for (NodeDef* consumer : consumers) {
-        // Update `consumer`'s use of `node` to `input`'s operand.
-        for (int i = 0; i < consumer->input_size(); ++i) {
-          int operand_pos;
-          string operand_node_name =
-              ParseNodeName(consumer->input(i), &operand_pos);
-          if (operand_node_name == node->name()) {
-            *consumer->mutable_input(i) =
-                (operand_pos < 0
-                     ? AsControlDependency(NodeName(simplified_tensor))
-                     : simplified_tensor);
+
+      // re-wire consumers of an old node to the new one
+      if (NodeName(simplified_tensor) != node->name()) {
+        // Always consider simplified_tensor for further optimizations.
+        NodeDef* simplified_node = node_map_->GetNode(simplified_tensor);
+        if (simplified_node != nullptr) {
+          nodes_to_simplify.PushBack(simplified_node);
+          if (modified_nodes != nullptr) {
+            modified_nodes->insert(simplified_node->name());
+          }
+        }
+        // When `node` is simplified to another node rather than in-place, the
+        // consumers of `node` are already redirected to `simplified_tensor`.
+        // Re-push the consumers into `nodes_to_simplify` for further
+        // optimizations.
+        const std::set<NodeDef*> outputs = node_map_->GetOutputs(node->name());
+        std::vector<NodeDef*> consumers(outputs.begin(), outputs.end());
+        std::sort(consumers.begin(), consumers.end(),
+                  [](const NodeDef* n1, const NodeDef* n2) {
+                    return n1->name() < n2->name();
+                  });
+        for (NodeDef* consumer : consumers) {
+          // Update `consumer`'s use of `node` to `input`'s operand.
+          for (int i = 0; i < consumer->input_size(); ++i) {
+            int operand_pos;
+            string operand_node_name =
+                ParseNodeName(consumer->input(i), &operand_pos);
+            if (operand_node_name == node->name()) {
+              *consumer->mutable_input(i) =
+                  (operand_pos < 0
+                       ? AsControlDependency(NodeName(simplified_tensor))
+                       : simplified_tensor);
+            }
+          }
+          node_map_->UpdateInput(consumer->name(), node->name(),
+                                 simplified_tensor);
+          nodes_to_simplify.PushBack(consumer);
+          if (modified_nodes != nullptr) {
+            modified_nodes->insert(consumer->name());
           }
         }
-        node_map_->UpdateInput(consumer->name(), node->name(),
-                               simplified_tensor);
-        nodes_to_simplify.PushBack(consumer);
       }
     }
+  };
+
+  // Nodes rewritten in place, created, or whose inputs were redirected. Their
+  // shapes are updated once the pipeline is done with the graph, and they go
+  // through the pipeline again with the new shapes.
+  std::unordered_set<string> modified_nodes;
+  const int num_original_nodes = optimized_graph_->node_size();
+  simplify(&modified_nodes);
+  if (!can_use_shapes || modified_nodes.empty()) {
+    return Status::OK();
+  }
+  for (int i = num_original_nodes; i < optimized_graph_->node_size(); ++i) {
+    modified_nodes.insert(optimized_graph_->node(i).name());
+  }
+  const Status status = graph_properties_->UpdateStatically(modified_nodes);
+  if (!status.ok()) {
+    VLOG(1) << "Shape update failed." << status.error_message();
+    return Status::OK();
+  }
+  for (int i = 0; i < optimized_graph_->node_size(); ++i) {
+    NodeDef* node = optimized_graph_->mutable_node(i);
+    if (modified_nodes.count(node->name()) > 0) {
+      nodes_to_simplify.PushBack(node);
+    }
   }
+  simplify(nullptr);
   return Status::OK();
 }
 
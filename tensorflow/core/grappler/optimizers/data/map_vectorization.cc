@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/op_types.h"
 #include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
 #include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization_utils.h"
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/platform/protobuf.h"
@@ -39,10 +40,25 @@ void CopyAttribute(const string& attr_name, const NodeDef& from, NodeDef* to) {
 
 FunctionDef* AddVectorizedFunction(const NodeDef& map_node,
                                    const FunctionDef& orig_func,
+                                   const NodeDef& input_node,
                                    FunctionDefLibrary* library) {
-  // If we decide to use a different method of vectorization, we can just
-  // swap out this part.
-  FunctionDef* vectorized_func = library->add_function();
+  // Convert the function op by op, into ops that process the whole batch.
+  std::vector<PartialTensorShape> arg_shapes;
+  for (const auto& shape :
+       input_node.attr().at("output_shapes").list().shape()) {
+    arg_shapes.emplace_back(shape);
+  }
+  FunctionDef* vectorized_func;
+  Status s = vectorization_utils::VectorizeFunction(orig_func, arg_shapes,
+                                                    library, &vectorized_func);
+  if (s.ok()) {
+    return vectorized_func;
+  }
+  VLOG(2) << "Running " << orig_func.signature().name()
+          << " on every element of the batch: " << s;
+
+  // Otherwise, run the whole function on every element of the batch.
+  vectorized_func = library->add_function();
   // Function inputs and outputs are the same as original, just
   // with different shapes.
   *vectorized_func->mutable_signature() = orig_func.signature();
@@ -228,7 +244,7 @@ Status MapVectorization::Optimize(Cluster* cluster, const GrapplerItem& item,
     }
 
     FunctionDef* vectorized_func =
-        AddVectorizedFunction(*map_node, *orig_func, library);
+        AddVectorizedFunction(*map_node, *orig_func, *input_node, library);
     CHECK_NOTNULL(vectorized_func);
 
     auto* new_batch_node = graph.AddNode(
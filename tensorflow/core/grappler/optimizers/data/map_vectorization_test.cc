@@ -162,6 +162,35 @@ TEST(MapVectorizationTest, VectorizeMapWithBatchV2) {
   EXPECT_EQ(batch_node.input(0), "range");
 }
 
+TEST(MapVectorizationTest, VectorizeMapFunctionOpByOp) {
+  GrapplerItem item;
+  item.graph = GDef(
+      {NDef("start", "Const", {}, {{"value", 0}, {"dtype", DT_INT32}}),
+       NDef("stop", "Const", {}, {{"value", 10}, {"dtype", DT_INT32}}),
+       NDef("step", "Const", {}, {{"value", 1}, {"dtype", DT_INT32}}),
+       NDef("batch_size", "Const", {}, {{"value", 1}, {"dtype", DT_INT32}}),
+       MakeRangeNode("range", {"start", "stop", "step"}),
+       MakeMapNode("map", "range", "XTimesTwoInt32", {{}}, {DT_INT32}),
+       MakeBatchNode("batch", "map", "batch_size", {{-1}}, {DT_INT32})},
+      // FunctionLib
+      {
+          test::function::XTimesTwoInt32(),
+      });
+  MapVectorization optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // The Mul of the map function runs on the whole batch at once.
+  const NodeDef& map_node =
+      output.node(graph_utils::FindGraphNodeWithOp("MapDataset", output));
+  const FunctionDef& vectorized_func =
+      output.library().function(graph_utils::FindGraphFunctionWithName(
+          map_node.attr().at("f").func().name(), output.library()));
+  EXPECT_TRUE(graph_utils::ContainsFunctionNodeWithOp("Mul", vectorized_func));
+  EXPECT_FALSE(
+      graph_utils::ContainsFunctionNodeWithOp("MapDefun", vectorized_func));
+}
+
 TEST(MapVectorizationTest, VectorizeWithUndefinedOutputShape) {
   GrapplerItem item;
   item.graph = GDef(
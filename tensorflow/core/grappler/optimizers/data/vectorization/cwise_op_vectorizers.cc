@@ -0,0 +1,200 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+namespace {
+
+// Adds a copy of the element-wise `node` to `outer_scope`, with the given
+// inputs, and returns the name of its output.
+Status AddElementwiseNode(const NodeDef& node,
+                          const std::vector<string>& inputs,
+                          FunctionDef* outer_scope, string* output) {
+  const OpDef* op_def;
+  TF_RETURN_IF_ERROR(OpRegistry::Global()->LookUpOpDef(node.op(), &op_def));
+  NodeDef* vectorized = AddNode(node.op(), outer_scope);
+  *vectorized->mutable_attr() = node.attr();
+  for (const string& input : inputs) {
+    vectorized->add_input(input);
+  }
+  *output = OutputName(*vectorized, op_def->output_arg(0).name(), 0);
+  return Status::OK();
+}
+
+// An operation applied to every scalar of its input, e.g. Exp or Cast, is
+// applied to the stacked input as is.
+class UnaryElementwiseVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const NodeDef& node,
+                   const std::vector<VectorizedTensor>& inputs,
+                   FunctionDef* outer_scope,
+                   std::vector<string>* outputs) override {
+    string output;
+    TF_RETURN_IF_ERROR(
+        AddElementwiseNode(node, {inputs[0].name}, outer_scope, &output));
+    outputs->push_back(std::move(output));
+    return Status::OK();
+  }
+};
+
+// A binary operation with broadcasting, e.g. Add. Broadcasting aligns the
+// trailing dimensions of the inputs, so the batch dimension of a stacked
+// input stays leading as long as the other input does not have more
+// dimensions. A stacked input with fewer dimensions than the other one gets
+// dimensions of size 1 after its batch dimension.
+class BinaryElementwiseVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const NodeDef& node,
+                   const std::vector<VectorizedTensor>& inputs,
+                   FunctionDef* outer_scope,
+                   std::vector<string>* outputs) override {
+    const VectorizedTensor& x = inputs[0];
+    const VectorizedTensor& y = inputs[1];
+    if (x.shape.unknown_rank() || y.shape.unknown_rank()) {
+      return errors::Unimplemented("Inputs of ", node.name(),
+                                   " have an unknown rank.");
+    }
+    // The type of the inputs. LogicalAnd and LogicalOr only take booleans.
+    AttrValue type;
+    type.set_type(DT_BOOL);
+    if (node.attr().count("T")) type = node.attr().at("T");
+    std::vector<string> vectorized_inputs;
+    for (const VectorizedTensor* input : {&x, &y}) {
+      const VectorizedTensor& other = input == &x ? y : x;
+      const int missing_dims = other.shape.dims() - input->shape.dims();
+      if (!input->stacked && other.stacked && missing_dims < 0) {
+        return errors::Unimplemented(
+            "Unstacked input of ", node.name(),
+            " has more dimensions than its stacked input.");
+      } else if (input->stacked && other.stacked && missing_dims > 0) {
+        vectorized_inputs.push_back(
+            ExpandDims(input->name, type, missing_dims, outer_scope));
+      } else {
+        vectorized_inputs.push_back(input->name);
+      }
+    }
+    string output;
+    TF_RETURN_IF_ERROR(
+        AddElementwiseNode(node, vectorized_inputs, outer_scope, &output));
+    outputs->push_back(std::move(output));
+    return Status::OK();
+  }
+
+ private:
+  // Inserts `num_dims` dimensions of size 1 after the batch dimension of the
+  // stacked `input`.
+  string ExpandDims(const string& input, const AttrValue& type, int num_dims,
+                    FunctionDef* outer_scope) {
+    Tensor axis(DT_INT32, TensorShape({}));
+    axis.scalar<int32>()() = 1;
+    const string axis_name = AddConstant(axis, outer_scope);
+    string expanded = input;
+    for (int i = 0; i < num_dims; ++i) {
+      NodeDef* expand_dims = AddNode("ExpandDims", outer_scope);
+      expand_dims->add_input(expanded);
+      expand_dims->add_input(axis_name);
+      (*expand_dims->mutable_attr())["Tdim"].set_type(DT_INT32);
+      (*expand_dims->mutable_attr())["T"] = type;
+      expanded = OutputName(*expand_dims, "output", 0);
+    }
+    return expanded;
+  }
+};
+
+}  // namespace
+
+// Cwise math.
+REGISTER_VECTORIZER("Abs", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Acos", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Acosh", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Asin", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Asinh", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Atan", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Atanh", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Ceil", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Cos", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Cosh", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Elu", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Erf", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Erfc", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Exp", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Expm1", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Floor", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Invert", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("IsFinite", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("IsInf", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("IsNan", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Log", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Log1p", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("LogicalNot", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Neg", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Reciprocal", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Relu", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Relu6", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Rint", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Round", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Rsqrt", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Selu", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Sigmoid", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Sign", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Sin", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Sinh", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Softplus", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Softsign", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Sqrt", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Square", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Tan", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Tanh", UnaryElementwiseVectorizer);
+
+REGISTER_VECTORIZER("Add", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("AddV2", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Atan2", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("BitwiseAnd", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("BitwiseOr", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("BitwiseXor", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Div", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Equal", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("FloorDiv", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("FloorMod", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Greater", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("GreaterEqual", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Less", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("LessEqual", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("LogicalAnd", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("LogicalOr", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Maximum", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Minimum", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Mul", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("NotEqual", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Pow", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("RealDiv", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("SquaredDifference", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Sub", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("TruncateDiv", BinaryElementwiseVectorizer);
+REGISTER_VECTORIZER("TruncateMod", BinaryElementwiseVectorizer);
+
+// Other element-wise operations.
+REGISTER_VECTORIZER("Cast", UnaryElementwiseVectorizer);
+REGISTER_VECTORIZER("Identity", UnaryElementwiseVectorizer);
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
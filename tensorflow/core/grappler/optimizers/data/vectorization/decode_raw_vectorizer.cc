@@ -0,0 +1,48 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+namespace {
+
+// DecodeRaw decodes every string of its input into the last dimension of its
+// output, so it decodes a stacked input as is. All the strings of the batch
+// must then have the same length, as they must for the decoded elements to
+// be batched.
+class DecodeRawVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const NodeDef& node,
+                   const std::vector<VectorizedTensor>& inputs,
+                   FunctionDef* outer_scope,
+                   std::vector<string>* outputs) override {
+    NodeDef* decode_raw = AddNode("DecodeRaw", outer_scope);
+    *decode_raw->mutable_attr() = node.attr();
+    decode_raw->add_input(inputs[0].name);
+    outputs->push_back(OutputName(*decode_raw, "output", 0));
+    return Status::OK();
+  }
+};
+
+}  // namespace
+
+REGISTER_VECTORIZER("DecodeRaw", DecodeRawVectorizer);
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
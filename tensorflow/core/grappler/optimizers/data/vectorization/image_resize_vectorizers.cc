@@ -0,0 +1,103 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+namespace {
+
+// Adds a node reshaping `input` of type `type` to `shape`, and returns the
+// name of its output.
+string AddReshape(const string& input, const AttrValue& type,
+                  const std::vector<int32>& shape, FunctionDef* outer_scope) {
+  Tensor shape_tensor(DT_INT32,
+                      TensorShape({static_cast<int64>(shape.size())}));
+  std::copy(shape.begin(), shape.end(), shape_tensor.vec<int32>().data());
+  NodeDef* reshape = AddNode("Reshape", outer_scope);
+  reshape->add_input(input);
+  reshape->add_input(AddConstant(shape_tensor, outer_scope));
+  (*reshape->mutable_attr())["T"] = type;
+  (*reshape->mutable_attr())["Tshape"].set_type(DT_INT32);
+  return OutputName(*reshape, "output", 0);
+}
+
+// The resize ops take a batch of images, so every element is a batch of
+// images too, usually of a single image. The stacked batches of the elements
+// are reshaped into one batch of images, resized at once to the constant
+// size, and reshaped back. This needs the shape of the images to be known.
+class ImageResizeVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const NodeDef& node,
+                   const std::vector<VectorizedTensor>& inputs,
+                   FunctionDef* outer_scope,
+                   std::vector<string>* outputs) override {
+    const VectorizedTensor& images = inputs[0];
+    if (!images.stacked) {
+      return errors::Unimplemented("The size of ", node.name(),
+                                   " differs between elements.");
+    }
+    if (!images.shape.IsFullyDefined() || images.shape.dims() != 4) {
+      return errors::Unimplemented("The shape of the images of ", node.name(),
+                                   " is not known.");
+    }
+    std::vector<int64> size;
+    TF_RETURN_IF_ERROR(GetIntConstant(inputs[1], &size));
+    if (size.size() != 2) {
+      return errors::InvalidArgument("Expected a height and a width in ",
+                                     node.name());
+    }
+
+    const int32 num_images = images.shape.dim_size(0);
+    const int32 height = images.shape.dim_size(1);
+    const int32 width = images.shape.dim_size(2);
+    const int32 channels = images.shape.dim_size(3);
+    const string batched_images =
+        AddReshape(images.name, node.attr().at("T"),
+                   {-1, height, width, channels}, outer_scope);
+
+    NodeDef* resize = AddNode(node.op(), outer_scope);
+    *resize->mutable_attr() = node.attr();
+    resize->add_input(batched_images);
+    resize->add_input(inputs[1].name);
+
+    // Only ResizeNearestNeighbor keeps the type of the images.
+    AttrValue output_type;
+    output_type.set_type(DT_FLOAT);
+    if (node.op() == "ResizeNearestNeighbor") {
+      output_type = node.attr().at("T");
+    }
+    outputs->push_back(AddReshape(
+        OutputName(*resize, "resized_images", 0), output_type,
+        {-1, num_images, static_cast<int32>(size[0]),
+         static_cast<int32>(size[1]), channels},
+        outer_scope));
+    return Status::OK();
+  }
+};
+
+}  // namespace
+
+REGISTER_VECTORIZER("ResizeArea", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeBicubic", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeBilinear", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeNearestNeighbor", ImageResizeVectorizer);
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
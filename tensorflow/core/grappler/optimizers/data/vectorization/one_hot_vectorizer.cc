@@ -0,0 +1,73 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+namespace {
+
+// Encodes the stacked indices at once, with the one-hot dimension moved past
+// the batch dimension if `axis` counts from the front. The depth, on_value
+// and off_value must not be stacked.
+class OneHotVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const NodeDef& node,
+                   const std::vector<VectorizedTensor>& inputs,
+                   FunctionDef* outer_scope,
+                   std::vector<string>* outputs) override {
+    if (inputs.size() != 4) {
+      return errors::InvalidArgument(
+          "Expected indices, depth, on_value and off_value in ", node.name());
+    }
+    if (!inputs[0].stacked) {
+      return errors::Unimplemented("The encoding of ", node.name(),
+                                   " differs between elements.");
+    }
+    // The depth and the values must be the same for the whole batch.
+    for (int i = 1; i < 4; ++i) {
+      if (inputs[i].stacked) {
+        return errors::Unimplemented("The depth or values of ", node.name(),
+                                     " differ between elements.");
+      }
+    }
+    int64 axis;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node, "axis", &axis));
+    if (axis >= 0) {
+      ++axis;
+    }
+
+    NodeDef* one_hot = AddNode("OneHot", outer_scope);
+    *one_hot->mutable_attr() = node.attr();
+    (*one_hot->mutable_attr())["axis"].set_i(axis);
+    for (const VectorizedTensor& input : inputs) {
+      one_hot->add_input(input.name);
+    }
+    outputs->push_back(OutputName(*one_hot, "output", 0));
+    return Status::OK();
+  }
+};
+
+}  // namespace
+
+REGISTER_VECTORIZER("OneHot", OneHotVectorizer);
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,99 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+namespace {
+
+// Parses the stacked serialized examples of a batch with a single ParseExample
+// instead of a ParseSingleExample per example. The dense features of the
+// batch are the stacked dense features of the examples, as long as their
+// shapes are fully defined; variable-length features are padded across the
+// batch instead. The sparse features of the batch are a single SparseTensor,
+// which has no unbatched form, so examples with sparse features are parsed
+// one at a time.
+class ParseSingleExampleVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const NodeDef& node,
+                   const std::vector<VectorizedTensor>& inputs,
+                   FunctionDef* outer_scope,
+                   std::vector<string>* outputs) override {
+    const VectorizedTensor& serialized = inputs[0];
+    if (!serialized.stacked || serialized.shape.dims() != 0) {
+      return errors::Unimplemented("Expected a stacked scalar to parse in ",
+                                   node.name());
+    }
+    int64 num_sparse;
+    std::vector<string> dense_keys;
+    std::vector<PartialTensorShape> dense_shapes;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node, "num_sparse", &num_sparse));
+    TF_RETURN_IF_ERROR(GetNodeAttr(node, "dense_keys", &dense_keys));
+    TF_RETURN_IF_ERROR(GetNodeAttr(node, "dense_shapes", &dense_shapes));
+    if (num_sparse > 0) {
+      return errors::Unimplemented(node.name(), " parses sparse features.");
+    }
+    for (const PartialTensorShape& shape : dense_shapes) {
+      if (!shape.IsFullyDefined()) {
+        return errors::Unimplemented(node.name(),
+                                     " parses variable-length features.");
+      }
+    }
+    for (size_t i = 1; i < inputs.size(); ++i) {
+      if (inputs[i].stacked) {
+        return errors::Unimplemented("The defaults of ", node.name(),
+                                     " differ between elements.");
+      }
+    }
+
+    NodeDef* parse_example = AddNode("ParseExample", outer_scope);
+    parse_example->add_input(serialized.name);
+    // The names of the examples are optional.
+    parse_example->add_input(
+        AddConstant(Tensor(DT_STRING, TensorShape({0})), outer_scope));
+    for (const string& key : dense_keys) {
+      Tensor key_tensor(DT_STRING, TensorShape({}));
+      key_tensor.scalar<string>()() = key;
+      parse_example->add_input(AddConstant(key_tensor, outer_scope));
+    }
+    for (size_t i = 1; i < inputs.size(); ++i) {
+      parse_example->add_input(inputs[i].name);
+    }
+    auto* attr = parse_example->mutable_attr();
+    (*attr)["Nsparse"].set_i(0);
+    (*attr)["Ndense"].set_i(dense_keys.size());
+    (*attr)["sparse_types"].mutable_list();
+    (*attr)["Tdense"] = node.attr().at("Tdense");
+    (*attr)["dense_shapes"] = node.attr().at("dense_shapes");
+
+    for (size_t i = 0; i < dense_keys.size(); ++i) {
+      outputs->push_back(OutputName(*parse_example, "dense_values", i));
+    }
+    return Status::OK();
+  }
+};
+
+}  // namespace
+
+REGISTER_VECTORIZER("ParseSingleExample", ParseSingleExampleVectorizer);
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
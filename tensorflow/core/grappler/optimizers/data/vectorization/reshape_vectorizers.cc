@@ -0,0 +1,127 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+namespace {
+
+// Returns a tensor of type `dtype`, DT_INT32 or DT_INT64, holding `values`.
+Tensor MakeIntTensor(DataType dtype, const TensorShape& shape,
+                     const std::vector<int64>& values) {
+  Tensor tensor(dtype, shape);
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (dtype == DT_INT32) {
+      tensor.flat<int32>()(i) = static_cast<int32>(values[i]);
+    } else {
+      tensor.flat<int64>()(i) = values[i];
+    }
+  }
+  return tensor;
+}
+
+// Reshapes every element to the constant `shape`, by reshaping the stacked
+// tensor to `[-1] + shape`. A dimension of `shape` that is -1 is resolved
+// from the number of elements of an element, which must be known.
+class ReshapeVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const NodeDef& node,
+                   const std::vector<VectorizedTensor>& inputs,
+                   FunctionDef* outer_scope,
+                   std::vector<string>* outputs) override {
+    const VectorizedTensor& tensor = inputs[0];
+    if (!tensor.stacked) {
+      return errors::Unimplemented("The shape of ", node.name(),
+                                   " differs between elements.");
+    }
+    std::vector<int64> shape;
+    TF_RETURN_IF_ERROR(GetIntConstant(inputs[1], &shape));
+
+    int64 known_elements = 1;
+    int unknown_dim = -1;
+    for (size_t i = 0; i < shape.size(); ++i) {
+      if (shape[i] == -1) {
+        unknown_dim = i;
+      } else {
+        known_elements *= shape[i];
+      }
+    }
+    if (unknown_dim != -1) {
+      if (!tensor.shape.IsFullyDefined() || known_elements == 0) {
+        return errors::Unimplemented(
+            "Cannot infer the shape of the elements of ", node.name());
+      }
+      shape[unknown_dim] = tensor.shape.num_elements() / known_elements;
+    }
+    shape.insert(shape.begin(), -1);
+
+    NodeDef* reshape = AddNode("Reshape", outer_scope);
+    *reshape->mutable_attr() = node.attr();
+    reshape->add_input(tensor.name);
+    const TensorShape shape_shape({static_cast<int64>(shape.size())});
+    reshape->add_input(AddConstant(
+        MakeIntTensor(inputs[1].value.dtype(), shape_shape, shape),
+        outer_scope));
+    outputs->push_back(OutputName(*reshape, "output", 0));
+    return Status::OK();
+  }
+};
+
+// Inserts a dimension at the constant index `dim` of every element, i.e. at
+// `dim + 1` of the stacked tensor if `dim` counts from the front.
+class ExpandDimsVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const NodeDef& node,
+                   const std::vector<VectorizedTensor>& inputs,
+                   FunctionDef* outer_scope,
+                   std::vector<string>* outputs) override {
+    const VectorizedTensor& tensor = inputs[0];
+    if (!tensor.stacked) {
+      return errors::Unimplemented("The dimension expanded by ", node.name(),
+                                   " differs between elements.");
+    }
+    std::vector<int64> dim;
+    TF_RETURN_IF_ERROR(GetIntConstant(inputs[1], &dim));
+    if (dim.size() != 1) {
+      return errors::InvalidArgument("Expected a single dimension in ",
+                                     node.name());
+    }
+    if (dim[0] >= 0) {
+      ++dim[0];
+    }
+
+    NodeDef* expand_dims = AddNode("ExpandDims", outer_scope);
+    *expand_dims->mutable_attr() = node.attr();
+    expand_dims->add_input(tensor.name);
+    expand_dims->add_input(AddConstant(
+        MakeIntTensor(inputs[1].value.dtype(), TensorShape({}), dim),
+        outer_scope));
+    outputs->push_back(OutputName(*expand_dims, "output", 0));
+    return Status::OK();
+  }
+};
+
+}  // namespace
+
+REGISTER_VECTORIZER("ExpandDims", ExpandDimsVectorizer);
+REGISTER_VECTORIZER("Reshape", ReshapeVectorizer);
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
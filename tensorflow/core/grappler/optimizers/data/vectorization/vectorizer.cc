@@ -0,0 +1,71 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer.h"
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+
+NodeDef* AddNode(StringPiece op, FunctionDef* outer_scope) {
+  NodeDef* node = outer_scope->add_node_def();
+  graph_utils::SetUniqueFunctionNodeName(op, outer_scope, node);
+  node->set_op(string(op));
+  return node;
+}
+
+string OutputName(const NodeDef& node, StringPiece output, int index) {
+  return strings::StrCat(node.name(), ":", output, ":", index);
+}
+
+string AddConstant(const Tensor& value, FunctionDef* outer_scope) {
+  NodeDef* node = AddNode("Const", outer_scope);
+  (*node->mutable_attr())["dtype"].set_type(value.dtype());
+  value.AsProtoTensorContent(
+      (*node->mutable_attr())["value"].mutable_tensor());
+  return OutputName(*node, "output", 0);
+}
+
+Status GetIntConstant(const VectorizedTensor& tensor,
+                      std::vector<int64>* values) {
+  if (!tensor.is_constant) {
+    return errors::Unimplemented("Tensor ", tensor.name,
+                                 " is not a constant.");
+  }
+  const int64 num_elements = tensor.value.NumElements();
+  values->clear();
+  values->reserve(num_elements);
+  if (tensor.value.dtype() == DT_INT32) {
+    auto flat = tensor.value.flat<int32>();
+    for (int64 i = 0; i < num_elements; ++i) values->push_back(flat(i));
+  } else if (tensor.value.dtype() == DT_INT64) {
+    auto flat = tensor.value.flat<int64>();
+    for (int64 i = 0; i < num_elements; ++i) values->push_back(flat(i));
+  } else {
+    return errors::Unimplemented("Tensor ", tensor.name,
+                                 " is not an integer constant.");
+  }
+  return Status::OK();
+}
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
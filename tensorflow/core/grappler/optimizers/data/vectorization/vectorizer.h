@@ -0,0 +1,95 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_VECTORIZATION_VECTORIZER_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_VECTORIZATION_VECTORIZER_H_
+
+#include <vector>
+
+#include "tensorflow/core/framework/function.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+
+// A tensor of a vectorized function, i.e. of a function that computes a
+// function of a single element on a batch of elements at once.
+struct VectorizedTensor {
+  // Name of the tensor in the vectorized function, e.g. "x" for an argument
+  // or "add:z:0" for the output of a node.
+  string name;
+  // Whether the tensor is stacked, i.e. holds the values of all the elements
+  // of the batch along an extra leading dimension. An unstacked tensor holds
+  // a single value shared by all elements, e.g. a constant.
+  bool stacked = false;
+  // Shape of the value of a single element, i.e. without the batch dimension
+  // of stacked tensors.
+  PartialTensorShape shape;
+  // Whether the tensor is produced by a constant, whose value is `value`.
+  bool is_constant = false;
+  Tensor value;
+};
+
+// Converts an operation on a single element into operations on a batch of
+// elements. Vectorizers are registered per op type with
+// REGISTER_VECTORIZER.
+class Vectorizer {
+ public:
+  virtual ~Vectorizer() {}
+
+  // Adds nodes to `outer_scope` that compute the outputs of `node` for all
+  // the elements of a batch at once, and appends the names of the stacked
+  // outputs to `outputs`, one for every output tensor of `node`. `inputs`
+  // are the vectorized data inputs of `node`, at least one of which is
+  // stacked.
+  //
+  // Returns an error if `node` cannot be vectorized with these inputs, e.g.
+  // because it uses an attribute that has no batched form. The nodes added
+  // before the error are then discarded, and `node` runs element by element.
+  virtual Status Vectorize(const NodeDef& node,
+                           const std::vector<VectorizedTensor>& inputs,
+                           FunctionDef* outer_scope,
+                           std::vector<string>* outputs) = 0;
+};
+
+// Helpers for vectorizers.
+
+// Adds a node with a unique name prefixed with `op` to `outer_scope`. The
+// returned node has no inputs and no attributes.
+NodeDef* AddNode(StringPiece op, FunctionDef* outer_scope);
+
+// Returns the name of output `index` of the output argument `output` of
+// `node`, e.g. "add:z:0".
+string OutputName(const NodeDef& node, StringPiece output, int index);
+
+// Adds a constant with the given value to `outer_scope`, and returns the
+// name of its output.
+string AddConstant(const Tensor& value, FunctionDef* outer_scope);
+
+// Stores in `values` the elements of an integer constant, or returns an
+// error if `tensor` is not an unstacked DT_INT32 or DT_INT64 constant.
+Status GetIntConstant(const VectorizedTensor& tensor,
+                      std::vector<int64>* values);
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_VECTORIZATION_VECTORIZER_H_
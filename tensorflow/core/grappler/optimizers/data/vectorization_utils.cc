@@ -0,0 +1,388 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/vectorization_utils.h"
+
+#include <deque>
+#include <map>
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_def.pb.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+namespace {
+
+// Returns the nodes of `func` in topological order.
+Status SortNodes(const FunctionDef& func,
+                 std::vector<const NodeDef*>* sorted_nodes) {
+  std::map<string, int> node_index;
+  for (int i = 0; i < func.node_def_size(); ++i) {
+    node_index[func.node_def(i).name()] = i;
+  }
+  std::vector<int> num_pending(func.node_def_size(), 0);
+  std::vector<std::vector<int>> consumers(func.node_def_size());
+  for (int i = 0; i < func.node_def_size(); ++i) {
+    for (const string& input : func.node_def(i).input()) {
+      if (input[0] == '^') {
+        return errors::Unimplemented("Node ", func.node_def(i).name(),
+                                     " has a control input.");
+      }
+      // Inputs from arguments have no ':'.
+      const size_t colon = input.find(':');
+      if (colon == string::npos) continue;
+      auto it = node_index.find(input.substr(0, colon));
+      if (it == node_index.end()) {
+        return errors::InvalidArgument("Unknown input ", input, " of ",
+                                       func.node_def(i).name());
+      }
+      ++num_pending[i];
+      consumers[it->second].push_back(i);
+    }
+  }
+
+  std::deque<int> ready;
+  for (int i = 0; i < func.node_def_size(); ++i) {
+    if (num_pending[i] == 0) ready.push_back(i);
+  }
+  sorted_nodes->clear();
+  while (!ready.empty()) {
+    const int i = ready.front();
+    ready.pop_front();
+    sorted_nodes->push_back(&func.node_def(i));
+    for (int consumer : consumers[i]) {
+      if (--num_pending[consumer] == 0) ready.push_back(consumer);
+    }
+  }
+  if (sorted_nodes->size() != func.node_def_size()) {
+    return errors::InvalidArgument("Function ", func.signature().name(),
+                                   " has a cycle.");
+  }
+  return Status::OK();
+}
+
+// Returns the names of the output arguments of the outputs of `node`, and
+// the indices of the outputs within their argument, in order.
+Status GetOutputArgs(const NodeDef& node, const OpDef& op_def,
+                     std::vector<std::pair<string, int>>* output_args) {
+  NameRangeMap output_ranges;
+  TF_RETURN_IF_ERROR(
+      NameRangesForNode(node, op_def, nullptr, &output_ranges));
+  for (const auto& range : output_ranges) {
+    if (output_args->size() < range.second.second) {
+      output_args->resize(range.second.second);
+    }
+    for (int i = range.second.first; i < range.second.second; ++i) {
+      (*output_args)[i] = {string(range.first), i - range.second.first};
+    }
+  }
+  return Status::OK();
+}
+
+// Runs the shape function of `node` on the shapes of a single element.
+// Returns unknown shapes if it fails, e.g. because an attribute of `node` is
+// a placeholder for an attribute of the function.
+std::vector<PartialTensorShape> InferOutputShapes(
+    const NodeDef& node, const OpRegistrationData& op_reg_data,
+    const std::vector<VectorizedTensor>& inputs, int num_outputs) {
+  std::vector<PartialTensorShape> input_shapes;
+  std::vector<const Tensor*> input_tensors;
+  for (const VectorizedTensor& input : inputs) {
+    input_shapes.push_back(input.shape);
+    input_tensors.push_back(input.is_constant ? &input.value : nullptr);
+  }
+  shape_inference::InferenceContext context(
+      TF_GRAPH_DEF_VERSION, &node, op_reg_data.op_def, input_shapes,
+      input_tensors, {}, {});
+  Status s = context.construction_status();
+  if (s.ok() && op_reg_data.shape_inference_fn) {
+    s = context.Run(op_reg_data.shape_inference_fn);
+  }
+
+  std::vector<PartialTensorShape> output_shapes(num_outputs);
+  if (s.ok() && op_reg_data.shape_inference_fn &&
+      context.num_outputs() == num_outputs) {
+    for (int i = 0; i < num_outputs; ++i) {
+      TensorShapeProto shape;
+      context.ShapeHandleToProto(context.output(i), &shape);
+      output_shapes[i] = PartialTensorShape(shape);
+    }
+  }
+  return output_shapes;
+}
+
+class FunctionVectorizer {
+ public:
+  FunctionVectorizer(const FunctionDef& func, FunctionDefLibrary* library)
+      : func_(func), library_(library) {}
+
+  Status Vectorize(const std::vector<PartialTensorShape>& arg_shapes,
+                   FunctionDef* result) {
+    outer_scope_ = result;
+    *outer_scope_->mutable_signature() = func_.signature();
+    outer_scope_->mutable_signature()->clear_name();
+    graph_utils::SetUniqueGraphFunctionName("vectorized_function", library_,
+                                            outer_scope_);
+
+    const auto& args = func_.signature().input_arg();
+    if (args.size() != arg_shapes.size()) {
+      return errors::InvalidArgument("Expected ", args.size(),
+                                     " argument shapes, got ",
+                                     arg_shapes.size());
+    }
+    for (int i = 0; i < args.size(); ++i) {
+      VectorizedTensor& tensor = tensors_[args.Get(i).name()];
+      tensor.name = args.Get(i).name();
+      tensor.stacked = true;
+      tensor.shape = arg_shapes[i];
+    }
+
+    std::vector<const NodeDef*> nodes;
+    TF_RETURN_IF_ERROR(SortNodes(func_, &nodes));
+    for (const NodeDef* node : nodes) {
+      TF_RETURN_IF_ERROR(VectorizeNode(*node));
+    }
+    if (num_vectorized_ == 0) {
+      return errors::Unimplemented("No node of ", func_.signature().name(),
+                                   " has a vectorizer.");
+    }
+
+    for (const auto& output_arg : func_.signature().output_arg()) {
+      const VectorizedTensor* output;
+      TF_RETURN_IF_ERROR(
+          GetTensor(func_.ret().at(output_arg.name()), &output));
+      if (!output->stacked) {
+        return errors::Unimplemented("Output ", output_arg.name(), " of ",
+                                     func_.signature().name(),
+                                     " is the same for every element.");
+      }
+      (*outer_scope_->mutable_ret())[output_arg.name()] = output->name;
+    }
+    return Status::OK();
+  }
+
+ private:
+  Status GetTensor(const string& name, const VectorizedTensor** tensor) {
+    auto it = tensors_.find(name);
+    if (it == tensors_.end()) {
+      return errors::InvalidArgument("Unknown tensor ", name, " in ",
+                                     func_.signature().name());
+    }
+    *tensor = &it->second;
+    return Status::OK();
+  }
+
+  Status VectorizeNode(const NodeDef& node) {
+    const OpRegistrationData* op_reg_data;
+    TF_RETURN_IF_ERROR(OpRegistry::Global()->LookUp(node.op(), &op_reg_data));
+    std::vector<std::pair<string, int>> output_args;
+    TF_RETURN_IF_ERROR(GetOutputArgs(node, op_reg_data->op_def, &output_args));
+
+    std::vector<VectorizedTensor> inputs;
+    bool any_stacked = false;
+    for (const string& input_name : node.input()) {
+      const VectorizedTensor* input;
+      TF_RETURN_IF_ERROR(GetTensor(input_name, &input));
+      inputs.push_back(*input);
+      any_stacked |= input->stacked;
+    }
+    const std::vector<PartialTensorShape> output_shapes =
+        InferOutputShapes(node, *op_reg_data, inputs, output_args.size());
+
+    if (!any_stacked) {
+      // A stateful op, e.g. a random op, can produce a different value for
+      // every element from the same inputs, so it cannot be hoisted out of
+      // the map.
+      if (op_reg_data->op_def.is_stateful()) {
+        return errors::Unimplemented("Stateful node ", node.name(), " of ",
+                                     func_.signature().name(),
+                                     " has no input that varies by element.");
+      }
+      return CopyNode(node, inputs, output_args, output_shapes);
+    }
+
+    std::vector<string> outputs;
+    Vectorizer* vectorizer = VectorizerRegistry::Global()->Get(node.op());
+    if (vectorizer != nullptr) {
+      const int num_nodes = outer_scope_->node_def_size();
+      Status s = vectorizer->Vectorize(node, inputs, outer_scope_, &outputs);
+      if (s.ok() && outputs.size() == output_args.size()) {
+        ++num_vectorized_;
+        AddStackedOutputs(node, output_args, outputs, output_shapes);
+        return Status::OK();
+      }
+      VLOG(2) << "Could not vectorize " << node.name() << ": " << s;
+      outer_scope_->mutable_node_def()->DeleteSubrange(
+          num_nodes, outer_scope_->node_def_size() - num_nodes);
+      outputs.clear();
+    }
+
+    TF_RETURN_IF_ERROR(AddMapDefun(node, op_reg_data->op_def, inputs,
+                                   output_args, output_shapes, &outputs));
+    AddStackedOutputs(node, output_args, outputs, output_shapes);
+    return Status::OK();
+  }
+
+  // Copies `node`, whose inputs are all unstacked, to the outer scope.
+  Status CopyNode(const NodeDef& node,
+                  const std::vector<VectorizedTensor>& inputs,
+                  const std::vector<std::pair<string, int>>& output_args,
+                  const std::vector<PartialTensorShape>& output_shapes) {
+    NodeDef* copy = outer_scope_->add_node_def();
+    graph_utils::SetUniqueFunctionNodeName(node.name(), outer_scope_, copy);
+    copy->set_op(node.op());
+    *copy->mutable_attr() = node.attr();
+    for (const VectorizedTensor& input : inputs) {
+      copy->add_input(input.name);
+    }
+
+    Tensor value;
+    if (node.op() == "Const" &&
+        !value.FromProto(node.attr().at("value").tensor())) {
+      return errors::InvalidArgument("Invalid value of ", node.name());
+    }
+    for (size_t i = 0; i < output_args.size(); ++i) {
+      VectorizedTensor& output = tensors_[OutputName(
+          node, output_args[i].first, output_args[i].second)];
+      output.name =
+          OutputName(*copy, output_args[i].first, output_args[i].second);
+      output.stacked = false;
+      output.shape = output_shapes[i];
+      output.is_constant = node.op() == "Const";
+      output.value = value;
+    }
+    return Status::OK();
+  }
+
+  void AddStackedOutputs(const NodeDef& node,
+                         const std::vector<std::pair<string, int>>& output_args,
+                         const std::vector<string>& outputs,
+                         const std::vector<PartialTensorShape>& output_shapes) {
+    for (size_t i = 0; i < output_args.size(); ++i) {
+      VectorizedTensor& output = tensors_[OutputName(
+          node, output_args[i].first, output_args[i].second)];
+      output.name = outputs[i];
+      output.stacked = true;
+      output.shape = output_shapes[i];
+    }
+  }
+
+  // Adds a MapDefun that runs `node` on every element, with a function that
+  // holds `node` and copies of its constant inputs.
+  Status AddMapDefun(const NodeDef& node, const OpDef& op_def,
+                     const std::vector<VectorizedTensor>& inputs,
+                     const std::vector<std::pair<string, int>>& output_args,
+                     const std::vector<PartialTensorShape>& output_shapes,
+                     std::vector<string>* outputs) {
+    DataTypeVector input_types, output_types;
+    TF_RETURN_IF_ERROR(
+        InOutTypesForNode(node, op_def, &input_types, &output_types));
+    AttrValue output_shapes_attr;
+    for (const PartialTensorShape& shape : output_shapes) {
+      if (!shape.IsFullyDefined()) {
+        return errors::Unimplemented("The shape of the outputs of ",
+                                     node.name(), " is not known.");
+      }
+      shape.AsProto(output_shapes_attr.mutable_list()->add_shape());
+    }
+    for (const VectorizedTensor& input : inputs) {
+      if (!input.stacked && !input.is_constant) {
+        return errors::Unimplemented("Input ", input.name, " of ", node.name(),
+                                     " is not a constant.");
+      }
+    }
+
+    FunctionDef* per_element = library_->add_function();
+    graph_utils::SetUniqueGraphFunctionName(
+        strings::StrCat("per_element_", node.op()), library_, per_element);
+    NodeDef* copy = per_element->add_node_def();
+    copy->set_name(node.name());
+    copy->set_op(node.op());
+    *copy->mutable_attr() = node.attr();
+
+    NodeDef* map_defun = AddNode("MapDefun", outer_scope_);
+    AttrValue arg_types;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      if (inputs[i].stacked) {
+        auto* arg = per_element->mutable_signature()->add_input_arg();
+        arg->set_name(strings::StrCat("arg", i));
+        arg->set_type(input_types[i]);
+        copy->add_input(arg->name());
+        map_defun->add_input(inputs[i].name);
+        arg_types.mutable_list()->add_type(input_types[i]);
+      } else {
+        copy->add_input(AddConstant(inputs[i].value, per_element));
+      }
+    }
+    AttrValue output_types_attr;
+    for (size_t i = 0; i < output_types.size(); ++i) {
+      auto* ret = per_element->mutable_signature()->add_output_arg();
+      ret->set_name(strings::StrCat("output", i));
+      ret->set_type(output_types[i]);
+      (*per_element->mutable_ret())[ret->name()] =
+          OutputName(node, output_args[i].first, output_args[i].second);
+      output_types_attr.mutable_list()->add_type(output_types[i]);
+      outputs->push_back(OutputName(*map_defun, "output", i));
+    }
+
+    auto* attr = map_defun->mutable_attr();
+    (*attr)["Targuments"] = arg_types;
+    (*attr)["output_types"] = output_types_attr;
+    (*attr)["output_shapes"] = output_shapes_attr;
+    (*attr)["f"].mutable_func()->set_name(per_element->signature().name());
+    return Status::OK();
+  }
+
+  const FunctionDef& func_;
+  FunctionDefLibrary* const library_;
+  FunctionDef* outer_scope_ = nullptr;
+  // The vectorized tensors, keyed by their name in `func_`.
+  std::map<string, VectorizedTensor> tensors_;
+  int num_vectorized_ = 0;
+};
+
+}  // namespace
+
+Status VectorizeFunction(const FunctionDef& func,
+                         const std::vector<PartialTensorShape>& arg_shapes,
+                         FunctionDefLibrary* library, FunctionDef** result) {
+  const int num_functions = library->function_size();
+  FunctionDef* vectorized_func = library->add_function();
+  Status s = FunctionVectorizer(func, library)
+                 .Vectorize(arg_shapes, vectorized_func);
+  if (!s.ok()) {
+    library->mutable_function()->DeleteSubrange(
+        num_functions, library->function_size() - num_functions);
+    return s;
+  }
+  *result = vectorized_func;
+  return Status::OK();
+}
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
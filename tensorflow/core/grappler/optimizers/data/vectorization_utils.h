@@ -0,0 +1,53 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_VECTORIZATION_UTILS_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_VECTORIZATION_UTILS_H_
+
+#include <vector>
+
+#include "tensorflow/core/framework/function.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+
+// Adds to `library` a function that computes `func` on a batch of elements
+// at once, i.e. on its arguments stacked along a new leading dimension, and
+// returns it in `result`. `arg_shapes` are the shapes of the arguments of a
+// single element.
+//
+// The nodes of `func` are converted one at a time, in topological order:
+// * A node whose inputs are all the same for every element, e.g. a
+//   constant, is copied as is.
+// * A node whose op has a registered Vectorizer is converted by it.
+// * Any other node runs on every element with a MapDefun of its own. This
+//   needs the shapes of its outputs to be fully defined, and its inputs that
+//   are the same for every element to be constants.
+//
+// Returns an error, and leaves `library` unchanged, if a node cannot be
+// converted, or if no node has a Vectorizer, in which case running `func`
+// on every element with a single MapDefun is cheaper.
+Status VectorizeFunction(const FunctionDef& func,
+                         const std::vector<PartialTensorShape>& arg_shapes,
+                         FunctionDefLibrary* library, FunctionDef** result);
+
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_DATA_VECTORIZATION_UTILS_H_
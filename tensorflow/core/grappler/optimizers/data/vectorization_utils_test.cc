@@ -0,0 +1,363 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/data/vectorization_utils.h"
+
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace vectorization_utils {
+namespace {
+
+using FDH = FunctionDefHelper;
+
+// Returns the node of `func` with the given op, which must be unique.
+const NodeDef& NodeWithOp(StringPiece op, const FunctionDef& func) {
+  const int index = graph_utils::FindFunctionNodeWithOp(op, func);
+  CHECK_NE(index, -1) << op;
+  return func.node_def(index);
+}
+
+// Returns the node of `func` producing `tensor`, e.g. "add:z:0".
+const NodeDef& ProducerOf(const string& tensor, const FunctionDef& func) {
+  const int index = graph_utils::FindFunctionNodeWithName(
+      tensor.substr(0, tensor.find(':')), func);
+  CHECK_NE(index, -1) << tensor;
+  return func.node_def(index);
+}
+
+// Returns the values of the constant producing `tensor`.
+std::vector<int64> ConstantValues(const string& tensor,
+                                  const FunctionDef& func) {
+  const NodeDef& node = ProducerOf(tensor, func);
+  CHECK_EQ(node.op(), "Const");
+  Tensor value;
+  CHECK(value.FromProto(node.attr().at("value").tensor()));
+  std::vector<int64> values;
+  for (int64 i = 0; i < value.NumElements(); ++i) {
+    values.push_back(value.dtype() == DT_INT32 ? value.flat<int32>()(i)
+                                               : value.flat<int64>()(i));
+  }
+  return values;
+}
+
+TEST(VectorizationUtilsTest, CwiseOps) {
+  FunctionDef func = FDH::Create(
+      "f", {"x: float"}, {"y: float"}, {},
+      {{{"c"},
+        "Const",
+        {},
+        {{"value", test::AsScalar<float>(2)}, {"dtype", DT_FLOAT}}},
+       {{"exp"}, "Exp", {"x"}, {{"T", DT_FLOAT}}},
+       {{"add"}, "Add", {"exp:y:0", "c:output:0"}, {{"T", DT_FLOAT}}}},
+      {{"y", "add:z:0"}});
+  FunctionDefLibrary library;
+  FunctionDef* result;
+  TF_ASSERT_OK(VectorizeFunction(func, {PartialTensorShape({3})}, &library,
+                                 &result));
+
+  EXPECT_EQ(library.function_size(), 1);
+  EXPECT_FALSE(graph_utils::ContainsFunctionNodeWithOp("MapDefun", *result));
+  const NodeDef& add = ProducerOf(result->ret().at("y"), *result);
+  EXPECT_EQ(add.op(), "Add");
+  EXPECT_EQ(ProducerOf(add.input(0), *result).op(), "Exp");
+  EXPECT_EQ(ProducerOf(add.input(1), *result).op(), "Const");
+  EXPECT_EQ(NodeWithOp("Exp", *result).input(0), "x");
+}
+
+TEST(VectorizationUtilsTest, BroadcastStackedInputsOfDifferentRanks) {
+  FunctionDef func = FDH::Create(
+      "f", {"x: float", "y: float"}, {"z: float"}, {},
+      {{{"mul"}, "Mul", {"x", "y"}, {{"T", DT_FLOAT}}}}, {{"z", "mul:z:0"}});
+  FunctionDefLibrary library;
+  FunctionDef* result;
+  TF_ASSERT_OK(VectorizeFunction(
+      func, {PartialTensorShape({}), PartialTensorShape({4, 5})}, &library,
+      &result));
+
+  // The batch dimension of `x` must broadcast against the batch dimension of
+  // `y`, so `x` gets two dimensions of size 1 after it.
+  const NodeDef& mul = NodeWithOp("Mul", *result);
+  EXPECT_EQ(mul.input(1), "y");
+  const NodeDef& outer = ProducerOf(mul.input(0), *result);
+  EXPECT_EQ(outer.op(), "ExpandDims");
+  const NodeDef& inner = ProducerOf(outer.input(0), *result);
+  EXPECT_EQ(inner.op(), "ExpandDims");
+  EXPECT_EQ(inner.input(0), "x");
+  EXPECT_EQ(ConstantValues(inner.input(1), *result), std::vector<int64>({1}));
+}
+
+TEST(VectorizationUtilsTest, ReshapeAndExpandDims) {
+  FunctionDef func = FDH::Create(
+      "f", {"x: int32"}, {"y: int32"}, {},
+      {{{"shape"},
+        "Const",
+        {},
+        {{"value", test::AsTensor<int32>({-1, 2})}, {"dtype", DT_INT32}}},
+       {{"reshape"},
+        "Reshape",
+        {"x", "shape:output:0"},
+        {{"T", DT_INT32}, {"Tshape", DT_INT32}}},
+       {{"dim"},
+        "Const",
+        {},
+        {{"value", test::AsScalar<int32>(0)}, {"dtype", DT_INT32}}},
+       {{"expand_dims"},
+        "ExpandDims",
+        {"reshape:output:0", "dim:output:0"},
+        {{"T", DT_INT32}, {"Tdim", DT_INT32}}}},
+      {{"y", "expand_dims:output:0"}});
+  FunctionDefLibrary library;
+  FunctionDef* result;
+  TF_ASSERT_OK(VectorizeFunction(func, {PartialTensorShape({3, 4})},
+                                 &library, &result));
+
+  const NodeDef& expand_dims = ProducerOf(result->ret().at("y"), *result);
+  EXPECT_EQ(expand_dims.op(), "ExpandDims");
+  EXPECT_EQ(ConstantValues(expand_dims.input(1), *result),
+            std::vector<int64>({1}));
+  const NodeDef& reshape = ProducerOf(expand_dims.input(0), *result);
+  EXPECT_EQ(reshape.op(), "Reshape");
+  EXPECT_EQ(reshape.input(0), "x");
+  EXPECT_EQ(ConstantValues(reshape.input(1), *result),
+            std::vector<int64>({-1, 6, 2}));
+}
+
+TEST(VectorizationUtilsTest, ParseSingleExample) {
+  FunctionDef func = FDH::Create(
+      "f", {"serialized: string"}, {"a: int64", "b: float"}, {},
+      {{{"default_a"},
+        "Const",
+        {},
+        {{"value", test::AsTensor<int64>({0, 0})}, {"dtype", DT_INT64}}},
+       {{"default_b"},
+        "Const",
+        {},
+        {{"value", Tensor(DT_FLOAT, TensorShape({0}))}, {"dtype", DT_FLOAT}}},
+       {{"parse"},
+        "ParseSingleExample",
+        {"serialized", "default_a:output:0", "default_b:output:0"},
+        {{"num_sparse", 0},
+         {"sparse_keys", gtl::ArraySlice<string>({})},
+         {"dense_keys", gtl::ArraySlice<string>({"a", "b"})},
+         {"sparse_types", DataTypeSlice({})},
+         {"Tdense", DataTypeSlice({DT_INT64, DT_FLOAT})},
+         {"dense_shapes", gtl::ArraySlice<TensorShape>(
+                              {TensorShape({2}), TensorShape({})})}}}},
+      {{"a", "parse:dense_values:0"}, {"b", "parse:dense_values:1"}});
+  FunctionDefLibrary library;
+  FunctionDef* result;
+  TF_ASSERT_OK(VectorizeFunction(func, {PartialTensorShape({})}, &library,
+                                 &result));
+
+  EXPECT_FALSE(
+      graph_utils::ContainsFunctionNodeWithOp("ParseSingleExample", *result));
+  const NodeDef& parse = NodeWithOp("ParseExample", *result);
+  EXPECT_EQ(result->ret().at("a"), strings::StrCat(parse.name(),
+                                                   ":dense_values:0"));
+  EXPECT_EQ(result->ret().at("b"), strings::StrCat(parse.name(),
+                                                   ":dense_values:1"));
+  EXPECT_EQ(parse.input(0), "serialized");
+  EXPECT_EQ(parse.input_size(), 6);
+  EXPECT_EQ(parse.attr().at("Ndense").i(), 2);
+}
+
+TEST(VectorizationUtilsTest, ResizeAndOneHot) {
+  FunctionDef func = FDH::Create(
+      "f", {"image: uint8", "label: int64"}, {"image_out: float", "y: float"},
+      {},
+      {{{"size"},
+        "Const",
+        {},
+        {{"value", test::AsTensor<int32>({8, 6})}, {"dtype", DT_INT32}}},
+       {{"resize"},
+        "ResizeBilinear",
+        {"image", "size:output:0"},
+        {{"T", DT_UINT8}}},
+       {{"depth"},
+        "Const",
+        {},
+        {{"value", test::AsScalar<int32>(10)}, {"dtype", DT_INT32}}},
+       {{"on"},
+        "Const",
+        {},
+        {{"value", test::AsScalar<float>(1)}, {"dtype", DT_FLOAT}}},
+       {{"off"},
+        "Const",
+        {},
+        {{"value", test::AsScalar<float>(0)}, {"dtype", DT_FLOAT}}},
+       {{"one_hot"},
+        "OneHot",
+        {"label", "depth:output:0", "on:output:0", "off:output:0"},
+        {{"T", DT_FLOAT}, {"TI", DT_INT64}, {"axis", 0}}}},
+      {{"image_out", "resize:resized_images:0"}, {"y", "one_hot:output:0"}});
+  FunctionDefLibrary library;
+  FunctionDef* result;
+  TF_ASSERT_OK(VectorizeFunction(
+      func, {PartialTensorShape({1, 4, 3, 3}), PartialTensorShape({})},
+      &library, &result));
+
+  const NodeDef& one_hot = ProducerOf(result->ret().at("y"), *result);
+  EXPECT_EQ(one_hot.op(), "OneHot");
+  EXPECT_EQ(one_hot.attr().at("axis").i(), 1);
+
+  const NodeDef& unbatch = ProducerOf(result->ret().at("image_out"), *result);
+  EXPECT_EQ(unbatch.op(), "Reshape");
+  EXPECT_EQ(ConstantValues(unbatch.input(1), *result),
+            std::vector<int64>({-1, 1, 8, 6, 3}));
+  const NodeDef& resize = ProducerOf(unbatch.input(0), *result);
+  EXPECT_EQ(resize.op(), "ResizeBilinear");
+  const NodeDef& batch = ProducerOf(resize.input(0), *result);
+  EXPECT_EQ(batch.op(), "Reshape");
+  EXPECT_EQ(batch.input(0), "image");
+  EXPECT_EQ(ConstantValues(batch.input(1), *result),
+            std::vector<int64>({-1, 4, 3, 3}));
+}
+
+TEST(VectorizationUtilsTest, OneHotWithStackedValuesRunsOnEveryElement) {
+  FunctionDef func = FDH::Create(
+      "f", {"label: int64", "on: float"}, {"y: float"}, {},
+      {{{"depth"},
+        "Const",
+        {},
+        {{"value", test::AsScalar<int32>(10)}, {"dtype", DT_INT32}}},
+       {{"off"},
+        "Const",
+        {},
+        {{"value", test::AsScalar<float>(0)}, {"dtype", DT_FLOAT}}},
+       {{"one_hot"},
+        "OneHot",
+        {"label", "depth:output:0", "on", "off:output:0"},
+        {{"T", DT_FLOAT}, {"TI", DT_INT64}, {"axis", -1}}},
+       {{"neg"}, "Neg", {"one_hot:output:0"}, {{"T", DT_FLOAT}}}},
+      {{"y", "neg:y:0"}});
+  FunctionDefLibrary library;
+  FunctionDef* result;
+  TF_ASSERT_OK(VectorizeFunction(
+      func, {PartialTensorShape({}), PartialTensorShape({})}, &library,
+      &result));
+
+  // The on_value differs between elements, so a single OneHot cannot encode
+  // the batch.
+  const NodeDef& neg = ProducerOf(result->ret().at("y"), *result);
+  EXPECT_EQ(neg.op(), "Neg");
+  const NodeDef& map_defun = ProducerOf(neg.input(0), *result);
+  EXPECT_EQ(map_defun.op(), "MapDefun");
+  EXPECT_EQ(graph_utils::FindFunctionNodeWithOp("OneHot", *result), -1);
+}
+
+TEST(VectorizationUtilsTest, OpsWithoutVectorizerRunOnEveryElement) {
+  FunctionDef func = FDH::Create(
+      "f", {"x: float"}, {"y: float"}, {},
+      {{{"perm"},
+        "Const",
+        {},
+        {{"value", test::AsTensor<int32>({1, 0})}, {"dtype", DT_INT32}}},
+       {{"transpose"},
+        "Transpose",
+        {"x", "perm:output:0"},
+        {{"T", DT_FLOAT}, {"Tperm", DT_INT32}}},
+       {{"neg"}, "Neg", {"transpose:y:0"}, {{"T", DT_FLOAT}}}},
+      {{"y", "neg:y:0"}});
+  FunctionDefLibrary library;
+  FunctionDef* result;
+  TF_ASSERT_OK(VectorizeFunction(func, {PartialTensorShape({2, 3})},
+                                 &library, &result));
+
+  // The Transpose runs with a MapDefun, which feeds the vectorized Neg.
+  ASSERT_EQ(library.function_size(), 2);
+  const NodeDef& neg = ProducerOf(result->ret().at("y"), *result);
+  EXPECT_EQ(neg.op(), "Neg");
+  const NodeDef& map_defun = ProducerOf(neg.input(0), *result);
+  EXPECT_EQ(map_defun.op(), "MapDefun");
+  EXPECT_EQ(map_defun.input(0), "x");
+  EXPECT_EQ(map_defun.attr().at("output_shapes").list().shape(0).dim(0).size(),
+            3);
+
+  const int index = graph_utils::FindGraphFunctionWithName(
+      map_defun.attr().at("f").func().name(), library);
+  ASSERT_NE(index, -1);
+  const FunctionDef& per_element = library.function(index);
+  EXPECT_EQ(per_element.signature().input_arg_size(), 1);
+  const NodeDef& transpose = NodeWithOp("Transpose", per_element);
+  EXPECT_EQ(ProducerOf(transpose.input(1), per_element).op(), "Const");
+}
+
+TEST(VectorizationUtilsTest, FailuresLeaveTheLibraryUnchanged) {
+  FunctionDefLibrary library;
+  FunctionDef* result;
+
+  // Nothing to vectorize.
+  FunctionDef transpose = FDH::Create(
+      "transpose", {"x: float", "perm: int32"}, {"y: float"}, {},
+      {{{"transpose"},
+        "Transpose",
+        {"x", "perm"},
+        {{"T", DT_FLOAT}, {"Tperm", DT_INT32}}}},
+      {{"y", "transpose:y:0"}});
+  EXPECT_FALSE(VectorizeFunction(transpose,
+                                 {PartialTensorShape({2, 3}),
+                                  PartialTensorShape({2})},
+                                 &library, &result)
+                   .ok());
+  EXPECT_EQ(library.function_size(), 0);
+
+  // The shape of the output of the Transpose, which has no vectorizer, is
+  // unknown.
+  FunctionDef exp_transpose = FDH::Create(
+      "exp_transpose", {"x: float", "perm: int32"}, {"y: float"}, {},
+      {{{"exp"}, "Exp", {"x"}, {{"T", DT_FLOAT}}},
+       {{"transpose"},
+        "Transpose",
+        {"exp:y:0", "perm"},
+        {{"T", DT_FLOAT}, {"Tperm", DT_INT32}}}},
+      {{"y", "transpose:y:0"}});
+  EXPECT_FALSE(VectorizeFunction(exp_transpose,
+                                 {PartialTensorShape({2, 3}),
+                                  PartialTensorShape({2})},
+                                 &library, &result)
+                   .ok());
+  EXPECT_EQ(library.function_size(), 0);
+
+  // The RandomUniform only has inputs that are the same for every element,
+  // but must still produce a different value for every element.
+  FunctionDef add_random = FDH::Create(
+      "add_random", {"x: float"}, {"y: float"}, {},
+      {{{"shape"},
+        "Const",
+        {},
+        {{"value", test::AsTensor<int32>({3})}, {"dtype", DT_INT32}}},
+       {{"random"},
+        "RandomUniform",
+        {"shape:output:0"},
+        {{"T", DT_INT32}, {"dtype", DT_FLOAT}}},
+       {{"add"}, "Add", {"x", "random:output:0"}, {{"T", DT_FLOAT}}}},
+      {{"y", "add:z:0"}});
+  EXPECT_FALSE(
+      VectorizeFunction(add_random, {PartialTensorShape({3})}, &library,
+                        &result)
+          .ok());
+  EXPECT_EQ(library.function_size(), 0);
+}
+
+}  // namespace
+}  // namespace vectorization_utils
+}  // namespace grappler
+}  // namespace tensorflow
@@ -39,6 +39,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/tensor_coding.h"
 #include "tensorflow/core/public/version.h"
@@ -339,7 +340,9 @@ Status LoopInvariantNodeMotionOptimizer::FindInvariantNodes(
     auto consumers = node_map_->GetOutputs(node->name());
     invariant_nodes_.emplace(node, consumers.size());
     for (auto* consumer : consumers) {
-      if (invariant_nodes_.count(consumer) || ModifiesFrameInfo(*consumer)) {
+      // Stateful nodes must run once per iteration.
+      if (invariant_nodes_.count(consumer) || ModifiesFrameInfo(*consumer) ||
+          !IsFreeOfSideEffect(*consumer)) {
         continue;
       }
       bool is_invariant = true;
@@ -530,6 +533,144 @@ Status RemoveStackOps(const std::unordered_set<string>& nodes_to_preserve,
   return Status::OK();
 }
 
+// Loops whose iterations only depend on each other through induction variables
+// and TensorArray flows run this many iterations in parallel, unless their
+// number of parallel iterations was chosen by the user, i.e. differs from the
+// default of tf.while_loop.
+constexpr int kDefaultParallelIterations = 10;
+constexpr int kPipelinedParallelIterations = 32;
+
+bool IsLoopInvariant(const NodeDef& node) {
+  return IsConstant(node) ||
+         (IsEnter(node) && node.attr().at("is_constant").b());
+}
+
+bool IsTensorArrayWrite(const NodeDef& node) {
+  return node.op() == "TensorArrayWriteV3" ||
+         node.op() == "TensorArrayWriteV2" ||
+         node.op() == "TensorArrayScatterV3" ||
+         node.op() == "TensorArrayScatterV2";
+}
+
+// Returns true if the next value of the loop variable updated by
+// 'next_iteration' only depends on its current value, through Identity nodes,
+// additions of loop invariants (such as an iteration counter) and writes to a
+// TensorArray (such as the flow of the loop outputs). The values written to
+// the TensorArray may depend on anything: they don't feed the next iteration.
+bool IsCheapRecurrence(const NodeMap& node_map,
+                       const NodeDef& next_iteration) {
+  const NodeDef* node = node_map.GetNode(next_iteration.input(0));
+  while (node != nullptr) {
+    if (IsSwitch(*node)) {
+      const NodeDef* merge = node_map.GetNode(node->input(0));
+      if (merge == nullptr || !IsMerge(*merge)) {
+        return false;
+      }
+      for (const string& input : merge->input()) {
+        if (NodeName(input) == next_iteration.name()) {
+          return true;
+        }
+      }
+      return false;
+    }
+    if (IsIdentity(*node)) {
+      node = node_map.GetNode(node->input(0));
+    } else if (IsTensorArrayWrite(*node)) {
+      node = node_map.GetNode(node->input(3));
+    } else if (IsAdd(*node) || IsSub(*node)) {
+      const NodeDef* lhs = node_map.GetNode(node->input(0));
+      const NodeDef* rhs = node_map.GetNode(node->input(1));
+      if (lhs == nullptr || rhs == nullptr) {
+        return false;
+      }
+      if (IsLoopInvariant(*rhs)) {
+        node = lhs;
+      } else if (IsLoopInvariant(*lhs) && IsAdd(*node)) {
+        node = rhs;
+      } else {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return false;
+}
+
+// Raises the number of parallel iterations of the innermost loops whose
+// iterations don't depend on each other, so that the executor overlaps them.
+// Loops with stateful nodes are left alone, since running their iterations in
+// parallel may reorder the side effects, and so are loops whose number of
+// parallel iterations was set explicitly, e.g. to bound their memory usage.
+Status PipelineLoops(GraphDef* optimized_graph) {
+  NodeMap node_map(optimized_graph);
+  FrameMap frame_map;
+  int num_frames;
+  TF_RETURN_IF_ERROR(IdentifyFramesWithNodeMap(*optimized_graph, node_map,
+                                               &frame_map, &num_frames));
+  std::vector<bool> can_pipeline(num_frames, true);
+  std::vector<std::vector<NodeDef*>> enters(num_frames);
+  std::vector<std::vector<const NodeDef*>> next_iterations(num_frames);
+  for (NodeDef& node : *optimized_graph->mutable_node()) {
+    const std::vector<int>& frame_ids = frame_map[&node];
+    if (frame_ids.empty()) {
+      continue;
+    }
+    // Outer loops run their inner loops one iteration at a time.
+    for (int i = 0; i < frame_ids.size() - 1; ++i) {
+      can_pipeline[frame_ids[i]] = false;
+    }
+    const int frame_id = frame_ids.back();
+    if (IsEnter(node)) {
+      enters[frame_id].push_back(&node);
+    } else if (IsNextIteration(node)) {
+      next_iterations[frame_id].push_back(&node);
+    } else if (!str_util::StartsWith(node.op(), "TensorArray") &&
+               !IsFreeOfSideEffect(node)) {
+      // TensorArray ops are ordered by their flow, so they can run in
+      // parallel iterations.
+      can_pipeline[frame_id] = false;
+    }
+  }
+
+  for (int frame_id = 0; frame_id < num_frames; ++frame_id) {
+    if (!can_pipeline[frame_id] || enters[frame_id].empty()) {
+      continue;
+    }
+    bool independent_iterations = true;
+    for (const NodeDef* next_iteration : next_iterations[frame_id]) {
+      if (!IsCheapRecurrence(node_map, *next_iteration)) {
+        independent_iterations = false;
+        break;
+      }
+    }
+    if (!independent_iterations) {
+      continue;
+    }
+    bool default_parallel_iterations = true;
+    for (const NodeDef* enter : enters[frame_id]) {
+      auto it = enter->attr().find("parallel_iterations");
+      if (it == enter->attr().end() ||
+          it->second.i() != kDefaultParallelIterations) {
+        default_parallel_iterations = false;
+        break;
+      }
+    }
+    if (!default_parallel_iterations) {
+      continue;
+    }
+    VLOG(1) << "Running " << kPipelinedParallelIterations
+            << " iterations of frame "
+            << enters[frame_id][0]->attr().at("frame_name").s()
+            << " in parallel";
+    for (NodeDef* enter : enters[frame_id]) {
+      (*enter->mutable_attr())["parallel_iterations"].set_i(
+          kPipelinedParallelIterations);
+    }
+  }
+  return Status::OK();
+}
+
 bool IsSimpleBinaryOperator(const NodeDef& node) {
   return (IsLess(node) || IsLessEqual(node) || IsGreater(node) ||
           IsGreaterEqual(node) || IsEqual(node));
@@ -674,7 +815,7 @@ LoopOptimizer::LoopOptimizer(RewriterConfig::Toggle opt_level,
                              DeviceBase* cpu_device)
     : opt_level_(opt_level),
       cpu_device_(cpu_device),
-      options_(LoopOptimizerOptions::Default(RewriterConfig::ON)) {
+      options_(LoopOptimizerOptions::Default(opt_level)) {
   resource_mgr_.reset(new ResourceMgr());
 }
 
@@ -689,6 +830,9 @@ Status LoopOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
   if (options_.enable_stack_push_removal) {
     TF_RETURN_IF_ERROR(RemoveStackOps(item.NodesToPreserve(), optimized_graph));
   }
+  if (options_.enable_loop_pipelining) {
+    TF_RETURN_IF_ERROR(PipelineLoops(optimized_graph));
+  }
   if (options_.enable_dead_branch_removal) {
     // TODO(srjoglekar): Figure out if we can optimize NodeMap creations across
     // optimizer passes.
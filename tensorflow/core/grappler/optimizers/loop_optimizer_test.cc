@@ -62,6 +62,7 @@ class LoopOptimizerTest : public GrapplerTest {
     LoopOptimizer::LoopOptimizerOptions options;
     options.enable_loop_invariant_node_motion = false;
     options.enable_stack_push_removal = false;
+    options.enable_loop_pipelining = false;
     optimizer->options_ = options;
   }
 
@@ -74,6 +75,44 @@ class LoopOptimizerTest : public GrapplerTest {
     DisableAllStages(optimizer);
     optimizer->options_.enable_stack_push_removal = true;
   }
+
+  void EnableOnlyLoopPipelining(LoopOptimizer* optimizer) {
+    DisableAllStages(optimizer);
+    optimizer->options_.enable_loop_pipelining = true;
+  }
+
+  // Adds a loop counting its iterations in "Identity", and whose body computes
+  // "Body" from "Identity" and the loop invariant "InvariantEnter". The next
+  // value of the counter is "Next".
+  void AddCountingLoop(const string& next, GraphDef* graph,
+                       const int piterations = 10) const {
+    AddSimpleNode("In", "Identity", {}, graph);
+    AddEnterNode("InvariantEnter", "while/while_context", true, piterations,
+                 {"In"}, graph);
+    AddEnterNode("VariantEnter", "while/while_context", false, piterations,
+                 {"In"}, graph);
+    AddSimpleNode("Merge", "Merge", {"VariantEnter", "NextIteration"}, graph);
+    AddSimpleNode("Less/y", "Const", {"^Identity"}, graph);
+    AddSimpleNode("Less", "Less", {"Merge", "Less/y"}, graph);
+    AddSimpleNode("LoopCond", "LoopCond", {"Less"}, graph);
+    AddSimpleNode("Switch", "Switch", {"Merge", "LoopCond"}, graph);
+    AddSimpleNode("Identity", "Identity", {"Switch:1"}, graph);
+    AddSimpleNode("One", "Const", {"^Identity"}, graph);
+    AddSimpleNode("Increment", "Add", {"Identity", "One"}, graph);
+    AddSimpleNode("Body", "Mul", {"Identity", "InvariantEnter"}, graph);
+    AddSimpleNode("NextIteration", "NextIteration", {next}, graph);
+    AddSimpleNode("Exit", "Exit", {"Switch"}, graph);
+    AddSimpleNode("Out", "Identity", {"Exit"}, graph);
+  }
+
+  int ParallelIterations(const GraphDef& graph, const string& enter) const {
+    for (const NodeDef& node : graph.node()) {
+      if (node.name() == enter) {
+        return node.attr().at("parallel_iterations").i();
+      }
+    }
+    return -1;
+  }
 };
 
 TEST_F(LoopOptimizerTest, Basic) {
@@ -492,6 +531,98 @@ void VerifyGraphsEqual(const GraphDef& original_graph,
   }
 }
 
+TEST_F(LoopOptimizerTest, StatefulNodesStayInLoop) {
+  GraphDef graph;
+  AddSimpleNode("In", "Identity", {}, &graph);
+  AddEnterNode("InvariantEnter", "while/while_context", true, 1, {"In"},
+               &graph);
+  AddSimpleNode("InvariantAdd", "Add", {"InvariantEnter", "InvariantEnter"},
+                &graph);
+  AddSimpleNode("Stateful", "Print", {"InvariantAdd", "InvariantAdd"},
+                &graph);
+  AddSimpleNode("VariantAdd", "Add", {"Stateful", "Identity"}, &graph);
+  AddEnterNode("VariantEnter", "while/while_context", false, 1, {"In"}, &graph);
+  AddSimpleNode("Merge", "Merge", {"VariantEnter", "NextIteration"}, &graph);
+  AddSimpleNode("Less/y", "Const", {"^Identity"}, &graph);
+  AddSimpleNode("Less", "Less", {"VariantAdd", "Less/y"}, &graph);
+  AddSimpleNode("LoopCond", "LoopCond", {"Less"}, &graph);
+  AddSimpleNode("Switch", "Switch", {"Merge", "LoopCond"}, &graph);
+  AddSimpleNode("Identity", "Identity", {"Switch:1"}, &graph);
+  AddSimpleNode("NextIteration", "NextIteration", {"VariantAdd"}, &graph);
+  AddSimpleNode("Exit", "Exit", {"Switch"}, &graph);
+  AddSimpleNode("Out", "Identity", {"Exit"}, &graph);
+
+  GrapplerItem item;
+  item.graph = graph;
+
+  LoopOptimizer optimizer;
+  EnableOnlyLoopInvariantNodeMotion(&optimizer);
+  GraphDef output;
+  Status status = optimizer.Optimize(nullptr, item, &output);
+  TF_EXPECT_OK(status);
+
+  std::unordered_map<const NodeDef*, std::vector<int>> frames;
+  int num_frames;
+  NodeMap node_map(&output);
+  EXPECT_TRUE(IdentifyFrames(output, &frames, &num_frames).ok());
+  EXPECT_EQ(num_frames, 1);
+  EXPECT_EQ(frames.at(node_map.GetNode("InvariantAdd")).size(), 0);
+  EXPECT_EQ(frames.at(node_map.GetNode("Stateful")).size(), 1);
+  EXPECT_EQ(frames.at(node_map.GetNode("VariantAdd")).size(), 1);
+}
+
+TEST_F(LoopOptimizerTest, PipelineIndependentIterations) {
+  GrapplerItem item;
+  AddCountingLoop("Increment", &item.graph);
+
+  LoopOptimizer optimizer;
+  EnableOnlyLoopPipelining(&optimizer);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(32, ParallelIterations(output, "InvariantEnter"));
+  EXPECT_EQ(32, ParallelIterations(output, "VariantEnter"));
+}
+
+TEST_F(LoopOptimizerTest, DontPipelineExplicitParallelIterations) {
+  GrapplerItem item;
+  AddCountingLoop("Increment", &item.graph, 1);
+
+  LoopOptimizer optimizer;
+  EnableOnlyLoopPipelining(&optimizer);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(1, ParallelIterations(output, "InvariantEnter"));
+  EXPECT_EQ(1, ParallelIterations(output, "VariantEnter"));
+}
+
+TEST_F(LoopOptimizerTest, DontPipelineRecurrence) {
+  // The body computes the next value of the loop variable.
+  GrapplerItem item;
+  AddCountingLoop("Body", &item.graph);
+
+  LoopOptimizer optimizer;
+  EnableOnlyLoopPipelining(&optimizer);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  VerifyGraphsEqual(item.graph, output, __FUNCTION__);
+}
+
+TEST_F(LoopOptimizerTest, DontPipelineStatefulLoop) {
+  GrapplerItem item;
+  AddCountingLoop("Increment", &item.graph);
+  AddSimpleNode("Stateful", "Print", {"Body", "Body"}, &item.graph);
+
+  LoopOptimizer optimizer;
+  EnableOnlyLoopPipelining(&optimizer);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  VerifyGraphsEqual(item.graph, output, __FUNCTION__);
+}
+
 TEST_F(LoopOptimizerTest, NoOp) {
   // This trivial graph is so basic there's nothing to optimize.
   TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <queue>
+#include <set>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -29,12 +30,14 @@ limitations under the License.
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
 #include "tensorflow/core/grappler/costs/graph_memory.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/costs/virtual_placer.h"
 #include "tensorflow/core/grappler/graph_view.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/op_types.h"
 #include "tensorflow/core/grappler/optimizers/graph_rewriter.h"
 #include "tensorflow/core/grappler/optimizers/static_schedule.h"
 #include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/frame.h"
 #include "tensorflow/core/grappler/utils/topological_sort.h"
 #include "tensorflow/core/grappler/utils/traversal.h"
 #include "tensorflow/core/lib/math/math_util.h"
@@ -1223,6 +1226,433 @@ bool SwappingPass(RewriterConfig::MemOptType optimization_level,
   return updated_graph;
 }
 
+// Control dependencies added by the memory aware scheduling pass may not
+// increase the estimated critical path of the graph by more than this fraction.
+constexpr double kMaxSchedulingSlowdown = 0.05;
+
+// Nodes allocating less than this fraction of the peak memory usage of the
+// memory aware schedule are left for the executor to order.
+constexpr double kMinScheduledAllocation = 0.01;
+
+namespace {
+
+// A node of the graph, as seen by the memory aware scheduling pass. Loop back
+// edges are ignored, so that the nodes form a DAG.
+struct SchedulingNode {
+  // Fanins and fanouts of the node, including control dependencies.
+  std::vector<int> fanins;
+  std::vector<int> fanouts;
+  // Tensors read by the node, as (node, output port) pairs.
+  std::vector<std::pair<int, int>> inputs;
+  // Nodes that read each output of the node.
+  std::vector<std::vector<int>> consumers;
+  // Memory allocated for each output of the node. Outputs that are persistent,
+  // or that live on a device that isn't scheduled, don't count.
+  std::vector<int64> output_sizes;
+  // Outputs that are fetched, and stay live until the end of the step.
+  std::vector<bool> fetched;
+  // Estimated time it takes to run the node.
+  int64 run_time = 0;
+  string device;
+  // Whether the node can take part in new control dependencies.
+  bool schedulable = true;
+};
+
+// Tracks the memory used by the tensors of a graph whose nodes run one at a
+// time: an output is allocated when its node runs, and released once the last
+// of its consumers has run.
+class SequentialMemoryTracker {
+ public:
+  explicit SequentialMemoryTracker(const std::vector<SchedulingNode>& nodes)
+      : nodes_(nodes), pending_consumers_(nodes.size()) {
+    for (int i = 0; i < nodes.size(); ++i) {
+      const SchedulingNode& node = nodes[i];
+      for (int port = 0; port < node.consumers.size(); ++port) {
+        pending_consumers_[i].push_back(node.consumers[port].size() +
+                                        (node.fetched[port] ? 1 : 0));
+      }
+    }
+  }
+
+  // Returns how much the memory in use grows once `node` has run.
+  int64 Growth(int node) const {
+    int64 growth = 0;
+    for (int port = 0; port < pending_consumers_[node].size(); ++port) {
+      if (pending_consumers_[node][port] > 0) {
+        growth += nodes_[node].output_sizes[port];
+      }
+    }
+    for (const auto& input : nodes_[node].inputs) {
+      if (pending_consumers_[input.first][input.second] == 1) {
+        growth -= nodes_[input.first].output_sizes[input.second];
+      }
+    }
+    return growth;
+  }
+
+  // Runs `node`. Calls `on_last_consumer` with the consumer of each input that
+  // is now the last one to read it.
+  template <typename Callback>
+  void Run(int node, const Callback& on_last_consumer) {
+    const std::vector<int64>& output_sizes = nodes_[node].output_sizes;
+    for (int64 size : output_sizes) {
+      in_use_ += size;
+    }
+    peak_ = std::max(peak_, in_use_);
+    for (int port = 0; port < output_sizes.size(); ++port) {
+      if (pending_consumers_[node][port] == 0) {
+        in_use_ -= output_sizes[port];
+      }
+    }
+    for (const auto& input : nodes_[node].inputs) {
+      int& pending = pending_consumers_[input.first][input.second];
+      --pending;
+      if (pending == 0) {
+        in_use_ -= nodes_[input.first].output_sizes[input.second];
+      } else if (pending == 1) {
+        on_last_consumer(input.first, input.second);
+      }
+    }
+  }
+
+  void Run(int node) {
+    Run(node, [](int, int) {});
+  }
+
+  int64 peak() const { return peak_; }
+
+ private:
+  const std::vector<SchedulingNode>& nodes_;
+  std::vector<std::vector<int>> pending_consumers_;
+  int64 in_use_ = 0;
+  int64 peak_ = 0;
+};
+
+// Builds the DAG of `item` seen by the memory aware scheduling pass, with its
+// nodes numbered in topological order. `topo_order` receives the index in the
+// graph of each node.
+Status BuildSchedulingNodes(
+    Cluster* cluster, const GrapplerItem& item,
+    const std::unordered_set<string>& devices_to_schedule,
+    std::vector<SchedulingNode>* nodes, std::vector<int>* topo_order) {
+  const GraphDef& graph = item.graph;
+  std::unordered_map<const NodeDef*, int> topo_index;
+  TF_RETURN_IF_ERROR(ComputeTopologicalOrder(graph, &topo_index, nullptr));
+  SimpleGraphView graph_view;
+  TF_RETURN_IF_ERROR(graph_view.Initialize(graph));
+
+  GraphProperties properties(item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(false));
+  std::unordered_map<const NodeDef*, Costs::NanoSeconds> run_times;
+  TF_RETURN_IF_ERROR(EstimateRunTimes(item, cluster, properties, &run_times));
+  FrameMap frames;
+  int num_frames;
+  TF_RETURN_IF_ERROR(IdentifyFrames(graph, &frames, &num_frames));
+  std::unordered_set<string> fetch_nodes;
+  for (const string& fetch : item.fetch) {
+    fetch_nodes.insert(NodeName(fetch));
+  }
+  std::unordered_set<string> feed_nodes;
+  for (const auto& feed : item.feed) {
+    feed_nodes.insert(NodeName(feed.first));
+  }
+  VirtualPlacer placer(cluster);
+
+  const int num_nodes = graph.node_size();
+  std::vector<int> index(num_nodes);
+  topo_order->resize(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    index[i] = topo_index[&graph.node(i)];
+    (*topo_order)[index[i]] = i;
+  }
+  nodes->clear();
+  nodes->resize(num_nodes);
+  // Nodes that don't run on some steps, because they depend on the untaken
+  // branch of a conditional.
+  std::vector<bool> may_be_dead(num_nodes, false);
+  for (int i : *topo_order) {
+    const NodeDef& node_def = graph.node(i);
+    SchedulingNode& node = (*nodes)[index[i]];
+    for (int fanin : graph_view.inputs(i)) {
+      if (index[fanin] < index[i]) {
+        node.fanins.push_back(index[fanin]);
+        (*nodes)[index[fanin]].fanouts.push_back(index[i]);
+      }
+    }
+    for (const string& input : node_def.input()) {
+      if (IsControlInput(input)) {
+        continue;
+      }
+      const int fanin = index[graph_view.index(NodeName(input))];
+      const int port = NodePosition(input);
+      if (fanin < index[i] &&
+          std::find(node.inputs.begin(), node.inputs.end(),
+                    std::make_pair(fanin, port)) == node.inputs.end()) {
+        node.inputs.emplace_back(fanin, port);
+      }
+    }
+
+    node.device = placer.get_canonical_device_name(node_def);
+    const bool fetched = fetch_nodes.count(node_def.name()) > 0;
+    const std::vector<OpInfo::TensorProperties> outputs =
+        properties.GetOutputProperties(node_def.name());
+    for (const auto& output : outputs) {
+      // Sources, such as constants and variables, and reference outputs
+      // don't allocate memory that the schedule can release.
+      const bool persistent =
+          node_def.input_size() == 0 || IsRefType(output.dtype());
+      node.output_sizes.push_back(
+          persistent || devices_to_schedule.count(node.device) == 0
+              ? 0
+              : EstimateSize(output));
+      node.fetched.push_back(fetched);
+    }
+    node.consumers.resize(outputs.size());
+    node.run_time = run_times[&node_def].count();
+
+    // Control dependencies would change the semantics of loops and of
+    // conditionals: a node that may be dead would kill the nodes waiting on
+    // it.
+    node.schedulable =
+        frames[&node_def].empty() && !IsMerge(node_def) &&
+        !IsSwitch(node_def) && !ModifiesFrameInfo(node_def) &&
+        feed_nodes.count(node_def.name()) == 0;
+    if (!IsMerge(node_def)) {
+      for (int fanin : node.fanins) {
+        if (may_be_dead[fanin] || IsSwitch(graph.node((*topo_order)[fanin]))) {
+          may_be_dead[index[i]] = true;
+          node.schedulable = false;
+        }
+      }
+    }
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    for (const auto& input : (*nodes)[i].inputs) {
+      std::vector<std::vector<int>>& consumers =
+          (*nodes)[input.first].consumers;
+      // Outputs unknown to the shape inference are ignored.
+      if (input.second >= consumers.size()) {
+        continue;
+      }
+      consumers[input.second].push_back(i);
+    }
+  }
+  for (SchedulingNode& node : *nodes) {
+    node.inputs.erase(
+        std::remove_if(node.inputs.begin(), node.inputs.end(),
+                       [nodes](const std::pair<int, int>& input) {
+                         return input.second >=
+                                (*nodes)[input.first].consumers.size();
+                       }),
+        node.inputs.end());
+  }
+  return Status::OK();
+}
+
+// Orders the nodes greedily, running first the ready node that grows the
+// memory in use the least. Ties are broken in topological order.
+std::vector<int> MemoryAwareOrder(const std::vector<SchedulingNode>& nodes,
+                                  std::vector<int64>* growth) {
+  SequentialMemoryTracker tracker(nodes);
+  std::vector<int> num_pending_fanins(nodes.size());
+  std::vector<bool> done(nodes.size(), false);
+  std::set<std::pair<int64, int>> ready;
+  growth->assign(nodes.size(), 0);
+  for (int i = 0; i < nodes.size(); ++i) {
+    num_pending_fanins[i] = nodes[i].fanins.size();
+    if (num_pending_fanins[i] == 0) {
+      (*growth)[i] = tracker.Growth(i);
+      ready.emplace((*growth)[i], i);
+    }
+  }
+
+  std::vector<int> order;
+  order.reserve(nodes.size());
+  while (!ready.empty()) {
+    const int node = ready.begin()->second;
+    ready.erase(ready.begin());
+    done[node] = true;
+    order.push_back(node);
+    // Running the last consumer of a tensor now releases it.
+    tracker.Run(node, [&](int producer, int port) {
+      for (int consumer : nodes[producer].consumers[port]) {
+        if (done[consumer]) {
+          continue;
+        }
+        if (num_pending_fanins[consumer] == 0) {
+          ready.erase(std::make_pair((*growth)[consumer], consumer));
+          (*growth)[consumer] = tracker.Growth(consumer);
+          ready.emplace((*growth)[consumer], consumer);
+        }
+        break;
+      }
+    });
+    for (int fanout : nodes[node].fanouts) {
+      if (--num_pending_fanins[fanout] == 0) {
+        (*growth)[fanout] = tracker.Growth(fanout);
+        ready.emplace((*growth)[fanout], fanout);
+      }
+    }
+  }
+  return order;
+}
+
+int64 SequentialPeakMemory(const std::vector<SchedulingNode>& nodes,
+                           const std::vector<int>& order) {
+  SequentialMemoryTracker tracker(nodes);
+  for (int node : order) {
+    tracker.Run(node);
+  }
+  return tracker.peak();
+}
+
+}  // namespace
+
+// Computes a sequential order of the nodes of the graph that keeps the memory
+// in use on the devices short of memory low, and enforces it with control
+// dependencies: each node that allocates a large amount of memory waits for the
+// last node preceding it in that order that released memory on its device.
+// Control dependencies are only added as long as the estimated critical path
+// of the graph grows by less than kMaxSchedulingSlowdown.
+bool MemoryAwareSchedulingPass(Cluster* cluster, GrapplerItem* item) {
+  GraphMemory memory(*item);
+  const std::unordered_map<string, DeviceProperties>& devices =
+      cluster->GetDevices();
+  Status s = memory.InferStatically(devices);
+  if (!s.ok()) {
+    VLOG(1) << "Failed to infer memory usage: " << s.error_message();
+    return false;
+  }
+  std::unordered_set<string> devices_to_schedule;
+  for (const auto& device : devices) {
+    const DeviceProperties& prop = device.second;
+    if (prop.memory_size() > 0 &&
+        memory.GetPeakMemoryUsage(device.first).used_memory >
+            prop.memory_size() * 0.8) {
+      devices_to_schedule.insert(device.first);
+    }
+  }
+  if (devices_to_schedule.empty()) {
+    return false;
+  }
+
+  std::vector<SchedulingNode> nodes;
+  std::vector<int> topo_order;
+  s = BuildSchedulingNodes(cluster, *item, devices_to_schedule, &nodes,
+                           &topo_order);
+  if (!s.ok()) {
+    VLOG(1) << "Failed to build the schedule: " << s.error_message();
+    return false;
+  }
+  const int num_nodes = nodes.size();
+
+  // Earliest completion times, and latest completion times that keep the
+  // critical path within budget.
+  std::vector<int64> earliest(num_nodes, 0);
+  int64 critical_path = 0;
+  for (int i = 0; i < num_nodes; ++i) {
+    for (int fanin : nodes[i].fanins) {
+      earliest[i] = std::max(earliest[i], earliest[fanin]);
+    }
+    earliest[i] += nodes[i].run_time;
+    critical_path = std::max(critical_path, earliest[i]);
+  }
+  const int64 budget = critical_path * (1 + kMaxSchedulingSlowdown);
+  std::vector<int64> latest(num_nodes, budget);
+  for (int i = num_nodes - 1; i >= 0; --i) {
+    for (int fanout : nodes[i].fanouts) {
+      latest[i] =
+          std::min(latest[i], latest[fanout] - nodes[fanout].run_time);
+    }
+  }
+
+  // The executor runs nodes roughly as soon as they are ready.
+  std::vector<int> default_order(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    default_order[i] = i;
+  }
+  std::stable_sort(default_order.begin(), default_order.end(),
+                   [&earliest](int a, int b) {
+                     return earliest[a] < earliest[b];
+                   });
+  std::vector<int64> growth;
+  const std::vector<int> order = MemoryAwareOrder(nodes, &growth);
+  const int64 default_peak = SequentialPeakMemory(nodes, default_order);
+  const int64 peak = SequentialPeakMemory(nodes, order);
+  VLOG(1) << "Memory aware schedule peaks at " << peak << " bytes instead of "
+          << default_peak;
+  if (peak >= default_peak) {
+    return false;
+  }
+
+  bool updated_graph = false;
+  const int64 min_allocation = peak * kMinScheduledAllocation;
+  std::unordered_map<string, int> last_release;
+  for (int node : order) {
+    const SchedulingNode& scheduled = nodes[node];
+    if (growth[node] < 0) {
+      last_release[scheduled.device] = node;
+      continue;
+    }
+    if (growth[node] < min_allocation || !scheduled.schedulable) {
+      continue;
+    }
+    auto it = last_release.find(scheduled.device);
+    if (it == last_release.end()) {
+      continue;
+    }
+    const int release = it->second;
+    if (!nodes[release].schedulable ||
+        std::find(scheduled.fanins.begin(), scheduled.fanins.end(), release) !=
+            scheduled.fanins.end()) {
+      continue;
+    }
+    if (earliest[release] + scheduled.run_time > latest[node]) {
+      VLOG(2) << "Not scheduling " << item->graph.node(topo_order[node]).name()
+              << " after " << item->graph.node(topo_order[release]).name()
+              << ": the step would be too slow";
+      continue;
+    }
+
+    NodeDef* node_def = item->graph.mutable_node(topo_order[node]);
+    *node_def->add_input() =
+        AsControlDependency(item->graph.node(topo_order[release]));
+    nodes[node].fanins.push_back(release);
+    nodes[release].fanouts.push_back(node);
+    updated_graph = true;
+
+    // Propagate the new edge to the completion times.
+    std::vector<int> queue = {node};
+    earliest[node] = earliest[release] + scheduled.run_time;
+    while (!queue.empty()) {
+      const int delayed = queue.back();
+      queue.pop_back();
+      for (int fanout : nodes[delayed].fanouts) {
+        const int64 completion = earliest[delayed] + nodes[fanout].run_time;
+        if (completion > earliest[fanout]) {
+          earliest[fanout] = completion;
+          queue.push_back(fanout);
+        }
+      }
+    }
+    queue = {release};
+    latest[release] =
+        std::min(latest[release], latest[node] - scheduled.run_time);
+    while (!queue.empty()) {
+      const int hurried = queue.back();
+      queue.pop_back();
+      for (int fanin : nodes[hurried].fanins) {
+        const int64 required = latest[hurried] - nodes[hurried].run_time;
+        if (required < latest[fanin]) {
+          latest[fanin] = required;
+          queue.push_back(fanin);
+        }
+      }
+    }
+  }
+  return updated_graph;
+}
+
 // TODO(rmlarsen): Add distributed TF test.
 Status RelaxAllocatorConstraints(GraphDef* optimized_graph) {
   std::unordered_set<string> devices;
@@ -1329,6 +1759,13 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
     }
   }
 
+  if ((optimization_level_ == RewriterConfig::DEFAULT_MEM_OPT ||
+       optimization_level_ == RewriterConfig::SCHEDULING_HEURISTICS ||
+       optimization_level_ == RewriterConfig::HEURISTICS) &&
+      cluster != nullptr) {
+    MemoryAwareSchedulingPass(cluster, &optimized_item);
+  }
+
   TF_RETURN_IF_ERROR(RelaxAllocatorConstraints(&optimized_item.graph));
 
   optimized_graph->Swap(&optimized_item.graph);
@@ -440,6 +440,85 @@ TEST_F(MemoryOptimizerTest, AccumulationRewrites) {
   }
 }
 
+TEST_F(MemoryOptimizerTest, MemoryAwareScheduling) {
+  // Two branches produce large tensors that are reduced right away, next to a
+  // longer chain of small matmuls: running the branches one after the other
+  // halves the peak memory usage without slowing down the step.
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice("/cpu:0");
+  Output shape = ops::Const(s.WithOpName("shape"), {128, 128, 8});
+  Output axes = ops::Const(s.WithOpName("axes"), {0, 1, 2});
+  Output a = ops::RandomNormal(s.WithOpName("a"), shape, DT_FLOAT);
+  Output b = ops::Sum(s.WithOpName("b"), a, axes);
+  Output c = ops::RandomNormal(s.WithOpName("c"), shape, DT_FLOAT);
+  Output d = ops::Sum(s.WithOpName("d"), c, axes);
+  Output e = ops::Add(s.WithOpName("e"), b, d);
+  Output m = ops::Const(s.WithOpName("m"), 0.5f, {64, 64});
+  for (int i = 0; i < 8; ++i) {
+    m = ops::MatMul(s.WithOpName(strings::StrCat("m", i)), m, m);
+  }
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"e", "m7"};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  MemoryOptimizer optimizer(RewriterConfig::SCHEDULING_HEURISTICS);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  int num_control_dependencies = 0;
+  for (const auto& node : output.node()) {
+    for (const string& input : node.input()) {
+      if (!IsControlInput(input)) {
+        continue;
+      }
+      ++num_control_dependencies;
+      // One large allocation waits for the other branch to be reduced.
+      if (node.name() == "a") {
+        EXPECT_EQ("^d", input);
+      } else {
+        EXPECT_EQ("c", node.name());
+        EXPECT_EQ("^b", input);
+      }
+    }
+  }
+  EXPECT_EQ(1, num_control_dependencies);
+
+  // Running the optimizer a second time doesn't add more dependencies.
+  GrapplerItem item_copy(item, std::move(output));
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item_copy, &output));
+  num_control_dependencies = 0;
+  for (const auto& node : output.node()) {
+    for (const string& input : node.input()) {
+      num_control_dependencies += IsControlInput(input);
+    }
+  }
+  EXPECT_EQ(1, num_control_dependencies);
+}
+
+TEST_F(MemoryOptimizerTest, MemoryAwareSchedulingBoundsSlowdown) {
+  // Running the branches one after the other would double the length of the
+  // step.
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice("/cpu:0");
+  Output shape = ops::Const(s.WithOpName("shape"), {128, 128, 8});
+  Output axes = ops::Const(s.WithOpName("axes"), {0, 1, 2});
+  Output a = ops::RandomNormal(s.WithOpName("a"), shape, DT_FLOAT);
+  Output b = ops::Sum(s.WithOpName("b"), a, axes);
+  Output c = ops::RandomNormal(s.WithOpName("c"), shape, DT_FLOAT);
+  Output d = ops::Sum(s.WithOpName("d"), c, axes);
+  Output e = ops::Add(s.WithOpName("e"), b, d);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"e"};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  MemoryOptimizer optimizer(RewriterConfig::SCHEDULING_HEURISTICS);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+  CompareGraphs(item.graph, output);
+}
+
 class RelaxAllocatorConstraintsTest : public GrapplerTest {};
 
 TEST_F(RelaxAllocatorConstraintsTest, SameDevice) {
@@ -28,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/loop_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/memory_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/model_pruner.h"
+#include "tensorflow/core/grappler/optimizers/optimized_graph_cache.h"
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 #include "tensorflow/core/grappler/optimizers/scoped_allocator_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/shape_optimizer.h"
@@ -159,6 +160,14 @@ Status MetaOptimizer::InitializeOptimizers(
   return Status::OK();
 }
 
+bool MetaOptimizer::UsesCustomOptimizers() const {
+  if (!cfg_.custom_optimizers().empty()) return true;
+  for (const string& optimizer_name : cfg_.optimizers()) {
+    if (!MakeNewOptimizer(optimizer_name)) return true;
+  }
+  return false;
+}
+
 Status MetaOptimizer::InitializeOptimizersByName(
     std::vector<std::unique_ptr<GraphOptimizer>>* optimizers) const {
   for (const string& optimizer_name : cfg_.optimizers()) {
@@ -328,6 +337,28 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
                                GraphDef* optimized_graph) {
   optimization_results_.clear();
 
+  // 0. Reuse the result of a previous optimization of the same item. Custom
+  // optimizers are opaque, so their results are never cached.
+  std::unique_ptr<OptimizedGraphCache> cache;
+  Fprint128 cache_key;
+  if (!cfg_.optimized_graph_cache_dir().empty() && !UsesCustomOptimizers()) {
+    Status s =
+        OptimizedGraphCache::ComputeKey(item, cfg_, cluster, &cache_key);
+    if (s.ok()) {
+      cache.reset(new OptimizedGraphCache(cfg_.optimized_graph_cache_dir()));
+      if (cache->Lookup(cache_key, optimized_graph)) {
+        VLOG(1) << "Reusing cached optimized graph for item " << item.id;
+        GraphOptimizationResult optimization_result(item.id);
+        optimization_result.results.push_back(
+            {"optimized_graph_cache", "cache hit"});
+        optimization_results_.push_back(optimization_result);
+        return Status::OK();
+      }
+    } else {
+      VLOG(1) << "Can't compute the optimized graph cache key: " << s;
+    }
+  }
+
   // 1. Optimize main graph
   TF_RETURN_IF_ERROR(OptimizeGraph(cluster, item, optimized_graph));
 
@@ -396,6 +427,13 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
   VLOG(3) << "Optimized " << optimized_funcs.size()
           << " functions: " << str_util::Join(optimized_funcs, ", ");
 
+  if (cache) {
+    Status s = cache->Insert(cache_key, *optimized_graph);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to cache the optimized graph: " << s;
+    }
+  }
+
   return Status::OK();
 }
 
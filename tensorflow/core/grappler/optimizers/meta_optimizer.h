@@ -49,6 +49,9 @@ class MetaOptimizer : public GraphOptimizer {
   // Initialize active optimizers from RewriterConfig toggles.
   Status InitializeOptimizers(
       std::vector<std::unique_ptr<GraphOptimizer>>* optimizers) const;
+  // Returns true if the optimizers configured in RewriterConfig include custom
+  // graph optimizers.
+  bool UsesCustomOptimizers() const;
   // Initialize active optimizers from RewriterConfig optimizer names.
   Status InitializeOptimizersByName(
       std::vector<std::unique_ptr<GraphOptimizer>>* optimizers) const;
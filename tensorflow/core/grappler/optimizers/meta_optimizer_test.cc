@@ -22,9 +22,11 @@ limitations under the License.
 #include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
 #include "tensorflow/core/grappler/optimizers/custom_graph_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
+#include "tensorflow/core/grappler/optimizers/optimized_graph_cache.h"
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/grappler/utils/grappler_test.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/platform/test.h"
 
 namespace tensorflow {
@@ -98,6 +100,43 @@ TEST_F(MetaOptimizerTest, RunOptimizersTwice) {
   TF_EXPECT_OK(status);
 }
 
+TEST_F(MetaOptimizerTest, ReusesCachedOptimizedGraph) {
+  TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+  GrapplerItem item;
+  CHECK(fake_input.NextItem(&item));
+
+  RewriterConfig rewriter_config;
+  rewriter_config.set_min_graph_nodes(-1);
+  rewriter_config.set_optimized_graph_cache_dir(
+      io::JoinPath(testing::TmpDir(), "meta_optimizer_cache"));
+
+  MetaOptimizer optimizer(nullptr, rewriter_config);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // Tamper with the cached graph: the second optimization must return it
+  // as is instead of running the optimizers again.
+  Fprint128 key;
+  TF_ASSERT_OK(
+      OptimizedGraphCache::ComputeKey(item, rewriter_config, nullptr, &key));
+  OptimizedGraphCache cache(rewriter_config.optimized_graph_cache_dir());
+  GraphDef cached;
+  ASSERT_TRUE(cache.Lookup(key, &cached));
+  EXPECT_EQ(output.DebugString(), cached.DebugString());
+  cached.mutable_node(0)->set_name("cached");
+  TF_ASSERT_OK(cache.Insert(key, cached));
+
+  MetaOptimizer other_optimizer(nullptr, rewriter_config);
+  TF_EXPECT_OK(other_optimizer.Optimize(nullptr, item, &output));
+  EXPECT_EQ("cached", output.node(0).name());
+
+  // Another config misses the cache.
+  rewriter_config.set_constant_folding(RewriterConfig::OFF);
+  MetaOptimizer uncached_optimizer(nullptr, rewriter_config);
+  TF_EXPECT_OK(uncached_optimizer.Optimize(nullptr, item, &output));
+  EXPECT_NE("cached", output.node(0).name());
+}
+
 TEST_F(MetaOptimizerTest, OptimizeFunctionLibrary) {
   using test::function::NDef;
 
@@ -0,0 +1,184 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/optimized_graph_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/optimizers/optimized_graph_cache.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+// Identifies the binary that optimized a graph.
+string BuildVersion() {
+  return strings::StrCat(TF_VERSION_STRING, "-", tf_git_version());
+}
+
+// Appends 'data' to 'key_data', prefixed with its length so that the
+// concatenation of several fields is unambiguous.
+void AppendField(StringPiece data, string* key_data) {
+  strings::StrAppend(key_data, data.size(), ":", data);
+}
+
+Status AppendProto(const protobuf::MessageLite& proto, string* key_data) {
+  string serialized;
+  if (!SerializeToStringDeterministic(proto, &serialized)) {
+    return errors::Internal("Failed to serialize ", proto.GetTypeName());
+  }
+  AppendField(serialized, key_data);
+  return Status::OK();
+}
+
+void AppendNames(StringPiece section, const std::vector<string>& names,
+                 string* key_data) {
+  AppendField(section, key_data);
+  strings::StrAppend(key_data, names.size(), ";");
+  for (const string& name : names) {
+    AppendField(name, key_data);
+  }
+}
+
+}  // namespace
+
+Status OptimizedGraphCache::ComputeKey(const GrapplerItem& item,
+                                       const RewriterConfig& cfg,
+                                       const Cluster* cluster, Fprint128* key) {
+  string key_data;
+  TF_RETURN_IF_ERROR(AppendProto(item.graph, &key_data));
+
+  AppendField("feed", &key_data);
+  strings::StrAppend(&key_data, item.feed.size(), ";");
+  for (const auto& feed : item.feed) {
+    AppendField(feed.first, &key_data);
+    AppendField(DataTypeString(feed.second.dtype()), &key_data);
+    AppendField(feed.second.shape().DebugString(), &key_data);
+  }
+  AppendNames("fetch", item.fetch, &key_data);
+  AppendNames("init_ops", item.init_ops, &key_data);
+  AppendNames("keep_ops", item.keep_ops, &key_data);
+  AppendField(item.save_op, &key_data);
+  AppendField("queue_runners", &key_data);
+  strings::StrAppend(&key_data, item.queue_runners.size(), ";");
+  for (const QueueRunnerDef& queue_runner : item.queue_runners) {
+    TF_RETURN_IF_ERROR(AppendProto(queue_runner, &key_data));
+  }
+
+  RewriterConfig key_cfg = cfg;
+  key_cfg.clear_optimized_graph_cache_dir();
+  TF_RETURN_IF_ERROR(AppendProto(key_cfg, &key_data));
+
+  AppendField("devices", &key_data);
+  if (cluster != nullptr) {
+    const auto& devices = cluster->GetDevices();
+    std::vector<string> device_names;
+    device_names.reserve(devices.size());
+    for (const auto& device : devices) {
+      device_names.push_back(device.first);
+    }
+    std::sort(device_names.begin(), device_names.end());
+    strings::StrAppend(&key_data, device_names.size(), ";");
+    for (const string& device_name : device_names) {
+      AppendField(device_name, &key_data);
+      TF_RETURN_IF_ERROR(AppendProto(devices.at(device_name), &key_data));
+    }
+  }
+
+  *key = Fingerprint128(key_data);
+  return Status::OK();
+}
+
+bool OptimizedGraphCache::Lookup(const Fprint128& key,
+                                 GraphDef* optimized_graph) const {
+  const string path = EntryPath(key);
+  if (!env_->FileExists(path).ok()) {
+    VLOG(2) << "No optimized graph cached in " << path;
+    return false;
+  }
+  OptimizedGraphCacheEntry entry;
+  Status s = ReadBinaryProto(env_, path, &entry);
+  if (!s.ok()) {
+    LOG(WARNING) << "Ignoring unreadable optimized graph cache entry " << path
+                 << ": " << s;
+    return false;
+  }
+  if (entry.key_low64() != key.low64 || entry.key_high64() != key.high64) {
+    LOG(WARNING) << "Ignoring optimized graph cache entry " << path
+                 << " with a mismatched key";
+    return false;
+  }
+  if (entry.tf_version() != BuildVersion()) {
+    VLOG(1) << "Ignoring optimized graph cache entry " << path
+            << " written by version " << entry.tf_version();
+    return false;
+  }
+  string serialized;
+  if (!SerializeToStringDeterministic(entry.optimized_graph(), &serialized) ||
+      Fingerprint64(serialized) != entry.graph_fingerprint()) {
+    LOG(WARNING) << "Ignoring corrupt optimized graph cache entry " << path;
+    return false;
+  }
+  optimized_graph->Swap(entry.mutable_optimized_graph());
+  return true;
+}
+
+Status OptimizedGraphCache::Insert(const Fprint128& key,
+                                   const GraphDef& optimized_graph) const {
+  OptimizedGraphCacheEntry entry;
+  entry.set_key_low64(key.low64);
+  entry.set_key_high64(key.high64);
+  entry.set_tf_version(BuildVersion());
+  *entry.mutable_optimized_graph() = optimized_graph;
+  string serialized;
+  if (!SerializeToStringDeterministic(optimized_graph, &serialized)) {
+    return errors::Internal("Failed to serialize the optimized graph");
+  }
+  entry.set_graph_fingerprint(Fingerprint64(serialized));
+
+  TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(directory_));
+  // Several processes may insert the same entry at once: each of them writes
+  // its own temporary file, and the last rename wins.
+  const string path = EntryPath(key);
+  const string tmp_path = strings::StrCat(
+      path, ".tmp", strings::Hex(random::New64(), strings::kZeroPad16));
+  Status s = WriteBinaryProto(env_, tmp_path, entry);
+  if (s.ok()) {
+    s = env_->RenameFile(tmp_path, path);
+  }
+  if (!s.ok()) {
+    env_->DeleteFile(tmp_path).IgnoreError();
+  }
+  return s;
+}
+
+string OptimizedGraphCache::EntryPath(const Fprint128& key) const {
+  return io::JoinPath(
+      directory_, strings::StrCat(strings::Hex(key.high64, strings::kZeroPad16),
+                                  strings::Hex(key.low64, strings::kZeroPad16),
+                                  ".graph"));
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
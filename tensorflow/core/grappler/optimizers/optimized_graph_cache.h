@@ -0,0 +1,71 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_OPTIMIZED_GRAPH_CACHE_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_OPTIMIZED_GRAPH_CACHE_H_
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// A content addressed cache of optimized graphs, stored in a directory that
+// may be shared by several processes. Each entry holds the result of running
+// the meta optimizer on a graph, and is keyed by a fingerprint of everything
+// the result depends on: the graph and its function library, the nodes to
+// feed, fetch and keep, the rewriter config and the devices of the cluster.
+//
+// Entries are written to a temporary file first and then renamed, so readers
+// never see partially written entries. Entries that can't be read, that were
+// written by another version of TensorFlow or whose contents don't match their
+// fingerprint are ignored.
+class OptimizedGraphCache {
+ public:
+  explicit OptimizedGraphCache(const string& directory)
+      : OptimizedGraphCache(Env::Default(), directory) {}
+  OptimizedGraphCache(Env* env, const string& directory)
+      : env_(env), directory_(directory) {}
+
+  // Computes the key of the entry that holds the result of optimizing 'item'
+  // with 'cfg' for the devices of 'cluster', which may be null. The
+  // optimized_graph_cache_dir field of 'cfg' doesn't contribute to the key.
+  static Status ComputeKey(const GrapplerItem& item, const RewriterConfig& cfg,
+                           const Cluster* cluster, Fprint128* key);
+
+  // Returns true and fills 'optimized_graph' if the cache holds a valid entry
+  // for 'key'.
+  bool Lookup(const Fprint128& key, GraphDef* optimized_graph) const;
+
+  // Stores 'optimized_graph' as the entry for 'key', replacing any existing
+  // entry.
+  Status Insert(const Fprint128& key, const GraphDef& optimized_graph) const;
+
+ private:
+  string EntryPath(const Fprint128& key) const;
+
+  Env* const env_;
+  const string directory_;
+};
+
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_OPTIMIZED_GRAPH_CACHE_H_
@@ -0,0 +1,142 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/optimized_graph_cache.h"
+
+#include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+class OptimizedGraphCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+    CHECK(fake_input.NextItem(&item_));
+    directory_ = io::JoinPath(testing::TmpDir(), "optimized_graph_cache",
+                              strings::StrCat(num_directories_++));
+  }
+
+  Fprint128 Key(const GrapplerItem& item, const RewriterConfig& cfg,
+                const Cluster* cluster) {
+    Fprint128 key;
+    TF_CHECK_OK(OptimizedGraphCache::ComputeKey(item, cfg, cluster, &key));
+    return key;
+  }
+
+  GrapplerItem item_;
+  string directory_;
+  static int num_directories_;
+};
+
+int OptimizedGraphCacheTest::num_directories_ = 0;
+
+TEST_F(OptimizedGraphCacheTest, KeyDependsOnInputs) {
+  RewriterConfig cfg;
+  const Fprint128 key = Key(item_, cfg, nullptr);
+  EXPECT_EQ(key, Key(item_, cfg, nullptr));
+
+  // The cache directory doesn't matter.
+  RewriterConfig cfg_with_dir = cfg;
+  cfg_with_dir.set_optimized_graph_cache_dir(directory_);
+  EXPECT_EQ(key, Key(item_, cfg_with_dir, nullptr));
+
+  RewriterConfig other_cfg = cfg;
+  other_cfg.set_constant_folding(RewriterConfig::OFF);
+  EXPECT_FALSE(key == Key(item_, other_cfg, nullptr));
+
+  GrapplerItem other_item = item_;
+  other_item.fetch.push_back(other_item.graph.node(0).name());
+  EXPECT_FALSE(key == Key(other_item, cfg, nullptr));
+
+  other_item = item_;
+  other_item.graph.mutable_node(0)->set_device("/cpu:1");
+  EXPECT_FALSE(key == Key(other_item, cfg, nullptr));
+
+  DeviceProperties cpu_device;
+  cpu_device.set_type("CPU");
+  VirtualCluster cluster({{"/CPU:0", cpu_device}});
+  const Fprint128 cluster_key = Key(item_, cfg, &cluster);
+  EXPECT_FALSE(key == cluster_key);
+  cpu_device.set_num_cores(4);
+  VirtualCluster other_cluster({{"/CPU:0", cpu_device}});
+  EXPECT_FALSE(cluster_key == Key(item_, cfg, &other_cluster));
+}
+
+TEST_F(OptimizedGraphCacheTest, InsertAndLookup) {
+  OptimizedGraphCache cache(directory_);
+  const Fprint128 key = Key(item_, RewriterConfig(), nullptr);
+  GraphDef optimized_graph;
+  EXPECT_FALSE(cache.Lookup(key, &optimized_graph));
+
+  GraphDef expected = item_.graph;
+  expected.mutable_node()->RemoveLast();
+  TF_EXPECT_OK(cache.Insert(key, expected));
+  ASSERT_TRUE(cache.Lookup(key, &optimized_graph));
+  EXPECT_EQ(expected.DebugString(), optimized_graph.DebugString());
+
+  // Another cache backed by the same directory sees the entry.
+  OptimizedGraphCache other_cache(directory_);
+  optimized_graph.Clear();
+  ASSERT_TRUE(other_cache.Lookup(key, &optimized_graph));
+  EXPECT_EQ(expected.DebugString(), optimized_graph.DebugString());
+
+  const Fprint128 other_key = {key.low64 + 1, key.high64};
+  EXPECT_FALSE(cache.Lookup(other_key, &optimized_graph));
+}
+
+TEST_F(OptimizedGraphCacheTest, IgnoresCorruptEntries) {
+  OptimizedGraphCache cache(directory_);
+  const Fprint128 key = Key(item_, RewriterConfig(), nullptr);
+  TF_EXPECT_OK(cache.Insert(key, item_.graph));
+
+  std::vector<string> entries;
+  TF_ASSERT_OK(Env::Default()->GetChildren(directory_, &entries));
+  ASSERT_EQ(1, entries.size());
+  const string path = io::JoinPath(directory_, entries[0]);
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), path, &contents));
+
+  // Truncated entry.
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path,
+                                 contents.substr(0, contents.size() / 2)));
+  GraphDef optimized_graph;
+  EXPECT_FALSE(cache.Lookup(key, &optimized_graph));
+
+  // Entry whose graph doesn't match its fingerprint.
+  const string node_name = item_.graph.node(0).name();
+  string renamed = node_name;
+  renamed[0] = renamed[0] == 'x' ? 'y' : 'x';
+  const size_t pos = contents.find(node_name);
+  ASSERT_NE(string::npos, pos);
+  contents.replace(pos, node_name.size(), renamed);
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path, contents));
+  EXPECT_FALSE(cache.Lookup(key, &optimized_graph));
+
+  // Inserting the entry again repairs it.
+  TF_EXPECT_OK(cache.Insert(key, item_.graph));
+  EXPECT_TRUE(cache.Lookup(key, &optimized_graph));
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
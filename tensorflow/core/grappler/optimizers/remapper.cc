@@ -15,17 +15,371 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/versions.pb.h"
+#include "tensorflow/core/grappler/clusters/utils.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/costs/op_context.h"
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
 #include "tensorflow/core/grappler/graph_view.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/op_types.h"
 #include "tensorflow/core/grappler/optimizers/constant_folding.h"
 #include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/topological_sort.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/device_name_utils.h"
 
 namespace tensorflow {
 namespace grappler {
+namespace {
+
+// Elementwise ops that _FusedElementwise runs, and their number of inputs.
+// WARN: This should be consistent with fused_elementwise_op.cc.
+const std::unordered_map<string, int>& FusibleCwiseOps() {
+  // clang-format off
+  static const auto* ops = new std::unordered_map<string, int>({
+      {"Add",               2},
+      {"AddV2",             2},
+      {"BiasAdd",           2},
+      {"Sub",               2},
+      {"Mul",               2},
+      {"Div",               2},
+      {"RealDiv",           2},
+      {"Maximum",           2},
+      {"Minimum",           2},
+      {"SquaredDifference", 2},
+      {"Abs",               1},
+      {"Elu",               1},
+      {"Exp",               1},
+      {"Inv",               1},
+      {"Log",               1},
+      {"Neg",               1},
+      {"Reciprocal",        1},
+      {"Relu",              1},
+      {"Relu6",             1},
+      {"Rsqrt",             1},
+      {"Sigmoid",           1},
+      {"Sqrt",              1},
+      {"Square",            1},
+      {"Tanh",              1},
+  });
+  // clang-format on
+  return *ops;
+}
+
+// Maximum number of ops fused into a single _FusedElementwise node.
+constexpr int kMaxFusedCwiseOps = 32;
+
+bool IsFullyDefined(const TensorShapeProto& shape) {
+  if (shape.unknown_rank()) return false;
+  for (const auto& dim : shape.dim()) {
+    if (dim.size() < 0) return false;
+  }
+  return true;
+}
+
+bool IsSameShape(const TensorShapeProto& shape1,
+                 const TensorShapeProto& shape2) {
+  if (shape1.dim_size() != shape2.dim_size()) return false;
+  for (int i = 0; i < shape1.dim_size(); ++i) {
+    if (shape1.dim(i).size() != shape2.dim(i).size()) return false;
+  }
+  return true;
+}
+
+// Returns whether `shape` is broadcast along all but the last dimension of
+// `output_shape`, i.e. is [n] or [1, ..., 1, n] where n is the last
+// dimension of `output_shape`, or is a scalar. This is how _FusedElementwise
+// broadcasts its inputs.
+bool IsBroadcastRow(const TensorShapeProto& shape,
+                    const TensorShapeProto& output_shape) {
+  if (shape.dim_size() > output_shape.dim_size()) return false;
+  int64 num_elements = 1;
+  for (const auto& dim : shape.dim()) num_elements *= dim.size();
+  if (num_elements == 1) return true;
+  if (shape.dim_size() == 0) return false;
+  for (int i = 0; i < shape.dim_size() - 1; ++i) {
+    if (shape.dim(i).size() != 1) return false;
+  }
+  return shape.dim(shape.dim_size() - 1).size() ==
+         output_shape.dim(output_shape.dim_size() - 1).size();
+}
+
+// _FusedElementwise is defined only for CPU.
+bool IsOnCpu(const NodeDef& node) {
+  string task;
+  string device;
+  return DeviceNameUtils::SplitDeviceName(node.device(), &task, &device) &&
+         str_util::StartsWith(device, DEVICE_CPU);
+}
+
+// Fuses chains of elementwise ops on the CPU into _FusedElementwise nodes,
+// which compute them in a single pass over memory. A group of fused ops is a
+// tree of ops with the shape of its root, whose other ops are only consumed
+// by ops of the group, and whose inputs either have the shape of the root, or
+// are broadcast rows (e.g. the bias of a BiasAdd) or scalars. A group is
+// fused if the cost model predicts that the fused op is faster, which it
+// usually is for memory bound ops, since only the inputs and output of the
+// group go through memory.
+class CwiseOpFusion {
+ public:
+  CwiseOpFusion(const GrapplerItem& item, const GraphProperties& properties,
+                GraphDef* graph)
+      : properties_(properties),
+        graph_(graph),
+        graph_view_(graph),
+        nodes_to_preserve_(item.NodesToPreserve()),
+        cpu_device_(GetLocalCPUInfo()) {}
+
+  Status Optimize() {
+    std::unordered_map<const NodeDef*, int> topo_order;
+    if (!ComputeTopologicalOrder(*graph_, &topo_order, nullptr).ok()) {
+      // Nothing is fused in graphs that cannot be sorted.
+      return Status::OK();
+    }
+    std::vector<NodeDef*> nodes;
+    for (NodeDef& node : *graph_->mutable_node()) nodes.push_back(&node);
+    // Consumers are visited before their producers, so the group of a node
+    // extends as far up its inputs as possible.
+    std::sort(nodes.begin(), nodes.end(),
+              [&topo_order](const NodeDef* node1, const NodeDef* node2) {
+                return topo_order[node1] > topo_order[node2];
+              });
+
+    std::set<string> nodes_to_delete;
+    for (NodeDef* root : nodes) {
+      if (fused_.count(root) > 0 || !IsFusible(*root)) continue;
+      std::vector<const NodeDef*> group = GrowGroup(*root);
+      if (group.size() < 2) continue;
+      std::sort(group.begin(), group.end(),
+                [&topo_order](const NodeDef* node1, const NodeDef* node2) {
+                  return topo_order[node1] < topo_order[node2];
+                });
+      if (!FuseGroup(group, root)) continue;
+      for (const NodeDef* node : group) {
+        fused_.insert(node);
+        if (node != root) nodes_to_delete.insert(node->name());
+      }
+    }
+    EraseNodesFromGraph(nodes_to_delete, graph_);
+    return Status::OK();
+  }
+
+ private:
+  const TensorShapeProto& OutputShape(const NodeDef& node) const {
+    return properties_.GetOutputProperties(node.name())[0].shape();
+  }
+
+  bool IsFusible(const NodeDef& node) const {
+    const auto it = FusibleCwiseOps().find(node.op());
+    if (it == FusibleCwiseOps().end()) return false;
+    if (IsBiasAdd(node) && node.attr().count("data_format") > 0 &&
+        node.attr().at("data_format").s() != "NHWC") {
+      return false;
+    }
+    const DataType dtype = GetDataTypeFromAttr(node, "T");
+    if (dtype != DT_FLOAT && dtype != DT_DOUBLE) return false;
+    if (!IsOnCpu(node)) return false;
+    if (!properties_.HasInputProperties(node.name()) ||
+        !properties_.HasOutputProperties(node.name())) {
+      return false;
+    }
+    const auto& inputs = properties_.GetInputProperties(node.name());
+    const auto& outputs = properties_.GetOutputProperties(node.name());
+    if (inputs.size() != it->second || outputs.size() != 1) return false;
+    for (const auto& input : inputs) {
+      if (!IsFullyDefined(input.shape())) return false;
+    }
+    return IsFullyDefined(outputs[0].shape());
+  }
+
+  // Returns whether `node` can be fused into `group`, whose root is `root`.
+  bool CanJoinGroup(const NodeDef& node, const NodeDef& root,
+                    const std::unordered_set<const NodeDef*>& group) const {
+    if (fused_.count(&node) > 0 || !IsFusible(node) ||
+        nodes_to_preserve_.count(node.name()) > 0 ||
+        node.device() != root.device() ||
+        GetDataTypeFromAttr(node, "T") != GetDataTypeFromAttr(root, "T") ||
+        HasControlInputs(node) ||
+        !IsSameShape(OutputShape(node), OutputShape(root))) {
+      return false;
+    }
+    // The result of the node is only used inside the fused op.
+    for (const auto& fanout : graph_view_.GetFanouts(node, true)) {
+      if (fanout.port_id < 0 || group.count(fanout.node) == 0) return false;
+    }
+    return true;
+  }
+
+  // Returns the ops that can be fused with `root`, starting with `root`.
+  std::vector<const NodeDef*> GrowGroup(const NodeDef& root) const {
+    std::vector<const NodeDef*> group = {&root};
+    std::unordered_set<const NodeDef*> in_group = {&root};
+    // An input that feeds several ops of the group can only join once all
+    // of them are in the group, so inputs are visited until none joins.
+    bool grown = true;
+    while (grown && group.size() < kMaxFusedCwiseOps) {
+      grown = false;
+      for (int i = 0; i < group.size() && group.size() < kMaxFusedCwiseOps;
+           ++i) {
+        for (const string& input : group[i]->input()) {
+          if (IsControlInput(input)) continue;
+          int port;
+          const NodeDef* producer =
+              graph_view_.GetNode(ParseNodeName(input, &port));
+          if (producer == nullptr || port != 0 ||
+              in_group.count(producer) > 0 ||
+              !CanJoinGroup(*producer, root, in_group)) {
+            continue;
+          }
+          group.push_back(producer);
+          in_group.insert(producer);
+          grown = true;
+        }
+      }
+    }
+    return group;
+  }
+
+  // Replaces `root` with a _FusedElementwise node that computes `group`,
+  // whose ops are sorted in topological order, if the fused node is
+  // predicted to be faster. Returns whether `root` was replaced.
+  bool FuseGroup(const std::vector<const NodeDef*>& group, NodeDef* root) {
+    const TensorShapeProto& shape = OutputShape(*root);
+    std::unordered_map<string, int> steps;
+    for (int i = 0; i < group.size(); ++i) steps[group[i]->name()] = i;
+
+    // The inputs of the group, the first of which has the shape of the
+    // output.
+    std::vector<string> inputs;
+    std::vector<const OpInfo::TensorProperties*> input_properties;
+    std::unordered_map<string, int> input_index;
+    for (const NodeDef* node : group) {
+      const auto& properties = properties_.GetInputProperties(node->name());
+      for (int i = 0; i < properties.size(); ++i) {
+        const string& input = node->input(i);
+        if (steps.count(NodeName(input)) > 0) continue;
+        if (input_index.count(input) > 0) continue;
+        if (!IsSameShape(properties[i].shape(), shape) &&
+            !IsBroadcastRow(properties[i].shape(), shape)) {
+          return false;
+        }
+        input_index[input] = inputs.size();
+        inputs.push_back(input);
+        input_properties.push_back(&properties[i]);
+      }
+    }
+    int first = 0;
+    while (first < inputs.size() &&
+           !IsSameShape(input_properties[first]->shape(), shape)) {
+      ++first;
+    }
+    if (first == inputs.size()) return false;
+    std::swap(inputs[0], inputs[first]);
+    std::swap(input_properties[0], input_properties[first]);
+    input_index[inputs[0]] = 0;
+    input_index[inputs[first]] = first;
+
+    if (!IsFasterFused(group, input_properties)) return false;
+
+    std::vector<string> op_names;
+    std::vector<int> operands;
+    for (const NodeDef* node : group) {
+      op_names.push_back(node->op());
+      for (int i = 0; i < 2; ++i) {
+        if (i >= FusibleCwiseOps().at(node->op())) {
+          operands.push_back(-1);
+          continue;
+        }
+        const string& input = node->input(i);
+        const auto it = steps.find(NodeName(input));
+        operands.push_back(it != steps.end() ? inputs.size() + it->second
+                                             : input_index.at(input));
+      }
+    }
+
+    VLOG(2) << "Fuse elementwise ops: root=" << root->name() << " op_names=["
+            << str_util::Join(op_names, ", ") << "]";
+
+    const DataType dtype = GetDataTypeFromAttr(*root, "T");
+    std::vector<string> control_inputs;
+    for (const string& input : root->input()) {
+      if (IsControlInput(input)) control_inputs.push_back(input);
+    }
+    root->set_op("_FusedElementwise");
+    root->clear_input();
+    for (const string& input : inputs) root->add_input(input);
+    for (const string& input : control_inputs) root->add_input(input);
+    root->clear_attr();
+    auto* attr = root->mutable_attr();
+    SetAttrValue(dtype, &(*attr)["T"]);
+    SetAttrValue(static_cast<int64>(inputs.size()), &(*attr)["N"]);
+    SetAttrValue(op_names, &(*attr)["op_names"]);
+    SetAttrValue(operands, &(*attr)["operands"]);
+    return true;
+  }
+
+  // Returns whether the cost model predicts that running `group` as a single
+  // op, which only reads `inputs` and writes the output of the group, is
+  // faster than running its ops one by one.
+  bool IsFasterFused(
+      const std::vector<const NodeDef*>& group,
+      const std::vector<const OpInfo::TensorProperties*>& inputs) const {
+    Costs::Duration unfused_time;
+    Costs::Duration compute_time;
+    for (const NodeDef* node : group) {
+      OpContext op_context;
+      op_context.name = node->name();
+      op_context.device_name = node->device();
+      OpInfo* op_info = &op_context.op_info;
+      op_info->set_op(node->op());
+      *op_info->mutable_attr() = node->attr();
+      *op_info->mutable_device() = cpu_device_;
+      for (const auto& input : properties_.GetInputProperties(node->name())) {
+        *op_info->add_inputs() = input;
+      }
+      *op_info->add_outputs() =
+          properties_.GetOutputProperties(node->name())[0];
+      const Costs costs = cost_estimator_.PredictCosts(op_context);
+      unfused_time += costs.execution_time;
+      compute_time += costs.compute_time;
+    }
+
+    double bytes = 0;
+    auto add_bytes = [&bytes](const OpInfo::TensorProperties& tensor) {
+      double num_elements = 1;
+      for (const auto& dim : tensor.shape().dim()) num_elements *= dim.size();
+      bytes += num_elements * DataTypeSize(tensor.dtype());
+    };
+    for (const auto* input : inputs) add_bytes(*input);
+    add_bytes(properties_.GetOutputProperties(group.back()->name())[0]);
+    const Costs::NanoSeconds memory_time(std::ceil(
+        bytes / cost_estimator_.GetDeviceInfo(cpu_device_).gb_per_sec));
+    return compute_time + memory_time < unfused_time;
+  }
+
+  const GraphProperties& properties_;
+  GraphDef* graph_;
+  GraphView graph_view_;
+  const std::unordered_set<string> nodes_to_preserve_;
+  const DeviceProperties cpu_device_;
+  OpLevelCostEstimator cost_estimator_;
+  // Nodes that are already in a fused group.
+  std::unordered_set<const NodeDef*> fused_;
+};
+
+}  // namespace
 
 void AddBatchNormNodes(GraphDef* optimized_graph, const NodeDef& fused_node) {
   const string& x = fused_node.input(0);
@@ -169,11 +523,16 @@ Status Remapper::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
                           GraphDef* optimized_graph) {
   GraphProperties properties(item);
   TF_RETURN_IF_ERROR(properties.InferStatically(false));
-  GraphView graph(const_cast<GraphDef*>(&item.graph));
+
+  // Fused nodes keep the name of the last op they compute, so the properties
+  // of the nodes of the original graph still describe the fused graph.
+  GraphDef fused_graph = item.graph;
+  TF_RETURN_IF_ERROR(CwiseOpFusion(item, properties, &fused_graph).Optimize());
+  GraphView graph(&fused_graph);
 
   // During inference, most of the inputs to FusedBatchNorm are constant, and we
   // can therefore replace the op with a much cheaper set of primitives.
-  for (const NodeDef& node : item.graph.node()) {
+  for (const NodeDef& node : fused_graph.node()) {
     if (node.op() == "FusedBatchNorm" || node.op() == "FusedBatchNormV2") {
       bool optimizable = (node.attr().count("T") == 0 ||
                           node.attr().at("T").type() == DT_FLOAT);
@@ -209,8 +568,8 @@ Status Remapper::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
     *optimized_graph->add_node() = node;
   }
 
-  *optimized_graph->mutable_library() = item.graph.library();
-  *optimized_graph->mutable_versions() = item.graph.versions();
+  *optimized_graph->mutable_library() = fused_graph.library();
+  *optimized_graph->mutable_versions() = fused_graph.versions();
 
   return Status::OK();
 }
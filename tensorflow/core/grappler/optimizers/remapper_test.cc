@@ -91,5 +91,115 @@ TEST_F(RemapperTest, FusedBatchNormNCHW) {
   }
 }
 
+TEST_F(RemapperTest, FuseCwiseOps) {
+  tensorflow::Scope s =
+      tensorflow::Scope::NewRootScope().WithDevice("/device:CPU:0");
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({1024, 64}));
+  Output scale = ops::Const(s.WithOpName("scale"), 0.5f, {64});
+  Output bias = ops::Const(s.WithOpName("bias"), -3.0f, {64});
+  Output mul = ops::Mul(s.WithOpName("mul"), x, scale);
+  Output bias_add = ops::BiasAdd(s.WithOpName("bias_add"), mul, bias);
+  Output relu = ops::Relu(s.WithOpName("relu"), bias_add);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"relu"};
+  auto x_t = GenerateRandomTensor<DT_FLOAT>(TensorShape({1024, 64}));
+  item.feed = {{"x", x_t}};
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(4, output.node_size());
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("mul", node.name());
+    EXPECT_NE("bias_add", node.name());
+    if (node.name() == "relu") {
+      ++found;
+      EXPECT_EQ("_FusedElementwise", node.op());
+      EXPECT_EQ("/device:CPU:0", node.device());
+      ASSERT_EQ(3, node.input_size());
+      EXPECT_EQ("x", node.input(0));
+      EXPECT_EQ("scale", node.input(1));
+      EXPECT_EQ("bias", node.input(2));
+      EXPECT_EQ(3, node.attr().at("N").i());
+      const auto& op_names = node.attr().at("op_names").list();
+      ASSERT_EQ(3, op_names.s_size());
+      EXPECT_EQ("Mul", op_names.s(0));
+      EXPECT_EQ("BiasAdd", op_names.s(1));
+      EXPECT_EQ("Relu", op_names.s(2));
+      const auto& operands = node.attr().at("operands").list();
+      ASSERT_EQ(6, operands.i_size());
+      const std::vector<int> expected_operands = {0, 1, 3, 2, 4, -1};
+      for (int i = 0; i < 6; ++i) {
+        EXPECT_EQ(expected_operands[i], operands.i(i));
+      }
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  EXPECT_EQ(1, tensors_expected.size());
+  EXPECT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+}
+
+TEST_F(RemapperTest, FuseCwiseOpsKeepsSharedResults) {
+  tensorflow::Scope s =
+      tensorflow::Scope::NewRootScope().WithDevice("/device:CPU:0");
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({256, 32}));
+  // `square` is also used outside of the ops fused into `add`, so it is not
+  // fused.
+  Output square = ops::Mul(s.WithOpName("square"), x, x);
+  Output exp = ops::Exp(s.WithOpName("exp"), square);
+  Output add = ops::Add(s.WithOpName("add"), exp, square);
+  Output neg = ops::Neg(s.WithOpName("neg"), square);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"add", "neg"};
+  auto x_t = GenerateRandomTensor<DT_FLOAT>(TensorShape({256, 32}));
+  // Keeps exp(x * x) finite.
+  x_t.flat<float>() = x_t.flat<float>() * 1e-3f;
+  item.feed = {{"x", x_t}};
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(4, output.node_size());
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("exp", node.name());
+    if (node.name() == "square") {
+      EXPECT_EQ("Mul", node.op());
+    } else if (node.name() == "neg") {
+      EXPECT_EQ("Neg", node.op());
+    } else if (node.name() == "add") {
+      EXPECT_EQ("_FusedElementwise", node.op());
+      ASSERT_EQ(1, node.input_size());
+      EXPECT_EQ("square", node.input(0));
+      const auto& operands = node.attr().at("operands").list();
+      ASSERT_EQ(4, operands.i_size());
+      const std::vector<int> expected_operands = {0, -1, 1, 0};
+      for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(expected_operands[i], operands.i(i));
+      }
+    }
+  }
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  EXPECT_EQ(2, tensors_expected.size());
+  EXPECT_EQ(2, tensors.size());
+  for (int i = 0; i < 2; ++i) {
+    test::ExpectTensorNear<float>(tensors_expected[i], tensors[i], 1e-6);
+  }
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
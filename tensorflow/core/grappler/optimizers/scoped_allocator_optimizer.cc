@@ -651,7 +651,9 @@ class UnaryElementwiseRewriter : public ScopedAllocatorOptimizer::Rewriter {
 
 ScopedAllocatorOptimizer::ScopedAllocatorOptimizer(
     RewriterConfig::Toggle opt_level, const ScopedAllocatorOptions& opts)
-    : opt_level_(opt_level) {
+    : opt_level_(opt_level),
+      max_fused_tensor_bytes_(opts.max_fused_tensor_bytes()),
+      max_bucket_bytes_(opts.max_bucket_bytes()) {
   VLOG(1) << "ScopedAllocatorOptimizer::ScopedAllocatorOptimizer";
   Rewriter* r = new UnaryElementwiseRewriter();
   to_delete_.push_back(r);
@@ -842,7 +844,8 @@ Status ScopedAllocatorOptimizer::ProcessGraphDef(
         // in the same Tree struct.  Split those groups into subgroups that
         // share identical loop nesting.
         status = ApplyToAll(
-            root.get(), [this, rewriter, graph, &frame_map, &op_name](Tree* t) {
+            root.get(), [this, rewriter, graph, &graph_properties, &frame_map,
+                         &op_name](Tree* t) {
               VLOG(2) << "applied to tree node " << t->edge_ << " at depth "
                       << t->depth_ << " of size " << t->nodes_.size();
               if (t->nodes_.size() > 1) {
@@ -850,12 +853,19 @@ Status ScopedAllocatorOptimizer::ProcessGraphDef(
                 PartitionByLoopStructure(frame_map, t->nodes_, &loop_groups);
                 for (auto& lg : loop_groups) {
                   if (lg.size() > 1) {
-                    bool applied = false;
                     Status s = OrderNodeSet(&lg);
                     TF_RETURN_IF_ERROR(s);
-                    VLOG(1) << "Applying Rewriter for " << op_name;
-                    s = rewriter->Rewrite(this, graph, op_name, lg, &applied);
-                    LOG_WARNING_AND_RETURN_IF_ERROR(s);
+                    std::vector<std::vector<NodeDef*>> buckets;
+                    PartitionIntoBuckets(graph_properties, lg, &buckets);
+                    for (auto& bucket : buckets) {
+                      if (bucket.size() <= 1) continue;
+                      bool applied = false;
+                      VLOG(1) << "Applying Rewriter for " << op_name
+                              << " to bucket of size " << bucket.size();
+                      s = rewriter->Rewrite(this, graph, op_name, bucket,
+                                            &applied);
+                      LOG_WARNING_AND_RETURN_IF_ERROR(s);
+                    }
                   }
                 }
               }
@@ -924,6 +934,40 @@ Status ScopedAllocatorOptimizer::OrderNodeSet(
   return Status::OK();
 }
 
+void ScopedAllocatorOptimizer::PartitionIntoBuckets(
+    const GraphProperties& graph_properties, const std::vector<NodeDef*>& nodes,
+    std::vector<std::vector<NodeDef*>>* buckets) const {
+  DataType bucket_type = DT_INVALID;
+  int64 bucket_bytes = 0;
+  for (NodeDef* n : nodes) {
+    if (!graph_properties.HasOutputProperties(n->name())) continue;
+    const std::vector<OpInfo::TensorProperties>& prop_list =
+        graph_properties.GetOutputProperties(n->name());
+    if (prop_list.size() != 1 ||
+        !TensorShape::IsValid(prop_list[0].shape())) {
+      VLOG(2) << "Not bucketing " << n->name() << ": no complete shape";
+      continue;
+    }
+    const DataType dtype = prop_list[0].dtype();
+    const int64 num_bytes =
+        TensorShape(prop_list[0].shape()).num_elements() * DataTypeSize(dtype);
+    if (max_fused_tensor_bytes_ > 0 && num_bytes > max_fused_tensor_bytes_) {
+      VLOG(2) << "Not bucketing " << n->name() << ": " << num_bytes
+              << " bytes";
+      continue;
+    }
+    if (buckets->empty() || dtype != bucket_type ||
+        (max_bucket_bytes_ > 0 &&
+         bucket_bytes + num_bytes > max_bucket_bytes_)) {
+      buckets->emplace_back();
+      bucket_type = dtype;
+      bucket_bytes = 0;
+    }
+    buckets->back().push_back(n);
+    bucket_bytes += num_bytes;
+  }
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
 
@@ -29,7 +29,9 @@ class NodeMap;
 class ScopedAllocatorOptimizer;
 
 // An Optimizer that introduces ScopedAllocators in order to reduce data
-// movement and consolidate some kinds of Ops.
+// movement and consolidate some kinds of Ops.  The ops are grouped into
+// buckets statically, when the graph is optimized; _Send/_Recv transfers
+// are never fused.
 class ScopedAllocatorOptimizer : public GraphOptimizer {
  public:
   ScopedAllocatorOptimizer(RewriterConfig::Toggle opt_level,
@@ -94,7 +96,19 @@ class ScopedAllocatorOptimizer : public GraphOptimizer {
 
   Status OrderNodeSet(std::vector<NodeDef*>* nodes) const;
 
+  // Splits the ordered node set "nodes" into runs of consecutive nodes of
+  // the same type whose outputs fit within max_bucket_bytes_.  Nodes that
+  // lack a complete output shape or exceed max_fused_tensor_bytes_ are
+  // left out of every bucket.  Since the buckets are fixed in the graph, a
+  // fused op waits for all its producers: max_bucket_bytes_ takes the place
+  // of a flush timeout.
+  void PartitionIntoBuckets(const GraphProperties& graph_properties,
+                            const std::vector<NodeDef*>& nodes,
+                            std::vector<std::vector<NodeDef*>>* buckets) const;
+
   RewriterConfig::Toggle opt_level_;
+  int64 max_fused_tensor_bytes_;
+  int64 max_bucket_bytes_;
   std::unordered_set<string> nodes_to_preserve_;
   OpNameSet op_name_set_;
   std::unordered_map<string, Rewriter*> rewriters_;
@@ -217,6 +217,37 @@ TEST_F(ScopedAllocatorOptimizerTest, UnaryExecute) {
   }
 }
 
+TEST_F(ScopedAllocatorOptimizerTest, BucketLimits) {
+  // Each Abs output is 16 bytes, so the pair fits in a 32 byte bucket but
+  // not in a 16 byte one.
+  struct {
+    int64 max_fused_tensor_bytes;
+    int64 max_bucket_bytes;
+    bool expect_rewrite;
+  } cases[] = {
+      {0, 0, true}, {0, 32, true}, {0, 16, false}, {16, 0, true}, {8, 0, false},
+  };
+  for (const auto& c : cases) {
+    GrapplerItem item;
+    BuildAbsGraph(&item.graph);
+    SetShapes(&item.graph);
+
+    ScopedAllocatorOptions opts;
+    opts.add_enable_op("Abs");
+    opts.set_max_fused_tensor_bytes(c.max_fused_tensor_bytes);
+    opts.set_max_bucket_bytes(c.max_bucket_bytes);
+    ScopedAllocatorOptimizer sao(RewriterConfig::ON, opts);
+
+    GraphDef optimized_graph;
+    TF_ASSERT_OK(sao.Optimize(nullptr /*cluster*/, item, &optimized_graph));
+    NodeMap node_map(&optimized_graph);
+    EXPECT_EQ(c.expect_rewrite,
+              node_map.GetNode("scoped_allocator_1") != nullptr)
+        << "max_fused_tensor_bytes=" << c.max_fused_tensor_bytes
+        << " max_bucket_bytes=" << c.max_bucket_bytes;
+  }
+}
+
 // Tests static ScopedAllocatorOptimizer::ExtendNodeAttr.
 // Maybe this should be moved elsewhere?
 TEST_F(ScopedAllocatorOptimizerTest, Extend) {
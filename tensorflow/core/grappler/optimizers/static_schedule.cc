@@ -191,5 +191,18 @@ Status EstimateRequiredTimes(
   return Status::OK();
 }
 
+Status EstimateRunTimes(
+    const GrapplerItem& item, const Cluster* cluster,
+    const GraphProperties& properties,
+    std::unordered_map<const NodeDef*, Costs::NanoSeconds>* run_times) {
+  OpLevelCostEstimator estimator;
+  VirtualPlacer placer(cluster);
+  for (const NodeDef& node : item.graph.node()) {
+    (*run_times)[&node] =
+        PredictExecutionTime(properties, estimator, placer, node);
+  }
+  return Status::OK();
+}
+
 }  // end namespace grappler
 }  // end namespace tensorflow
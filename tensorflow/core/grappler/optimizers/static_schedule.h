@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/grappler/clusters/cluster.h"
 #include "tensorflow/core/grappler/costs/cost_estimator.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 
 namespace tensorflow {
@@ -44,6 +45,14 @@ Status EstimateRequiredTimes(
         execution_times,
     std::unordered_map<const NodeDef*, Costs::NanoSeconds>* required_times);
 
+// Predict the time it takes to execute each node in the graph once its inputs
+// are available, based on the shapes inferred in 'properties'. As above, each
+// node takes at least one nanosecond to execute.
+Status EstimateRunTimes(
+    const GrapplerItem& item, const Cluster* cluster,
+    const GraphProperties& properties,
+    std::unordered_map<const NodeDef*, Costs::NanoSeconds>* run_times);
+
 }  // namespace grappler
 }  // end namespace tensorflow
 
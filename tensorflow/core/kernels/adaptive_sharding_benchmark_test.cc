@@ -0,0 +1,161 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks of kernels that split their work with Shard(), run with and
+// without adaptive sharding. The last argument of each benchmark is 1 to
+// enable adaptive sharding.
+//
+// Element-wise ops and reductions that are evaluated by Eigen use Eigen's
+// own cost model, so the element-wise and reduction-like kernels here are
+// the ones that call Shard() directly.
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace {
+
+void RunBenchmark(int iters, bool adaptive, int64 items, Graph* g) {
+  testing::ItemsProcessed(static_cast<int64>(iters) * items);
+  testing::UseRealTime();
+  const bool previous = AdaptiveShardingEnabled();
+  SetAdaptiveShardingEnabled(adaptive);
+  ClearMeasuredCostsForTest();
+  test::Benchmark("cpu", g).Run(iters);
+  SetAdaptiveShardingEnabled(previous);
+}
+
+// Element-wise: PopulationCount over "n" int32 values.
+Graph* PopulationCount(int n) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor x(DT_INT32, TensorShape({n}));
+  x.flat<int32>().setRandom();
+  test::graph::Unary(g, "PopulationCount", test::graph::Constant(g, x));
+  return g;
+}
+
+void BM_PopulationCount(int iters, int n, int adaptive) {
+  testing::StopTiming();
+  Graph* g = PopulationCount(n);
+  testing::StartTiming();
+  RunBenchmark(iters, adaptive, n, g);
+}
+BENCHMARK(BM_PopulationCount)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 1)
+    ->ArgPair(4 << 10, 0)
+    ->ArgPair(4 << 10, 1)
+    ->ArgPair(1 << 20, 0)
+    ->ArgPair(1 << 20, 1);
+
+// Row reduction: the top 4 values of each of "rows" rows of 128 floats.
+Graph* TopK(int rows) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor x(DT_FLOAT, TensorShape({rows, 128}));
+  x.flat<float>().setRandom();
+  Tensor k(DT_INT32, TensorShape({}));
+  k.scalar<int32>()() = 4;
+  test::graph::Binary(g, "TopKV2", test::graph::Constant(g, x),
+                      test::graph::HostConstant(g, k));
+  return g;
+}
+
+void BM_TopK(int iters, int rows, int adaptive) {
+  testing::StopTiming();
+  Graph* g = TopK(rows);
+  testing::StartTiming();
+  RunBenchmark(iters, adaptive, rows * 128, g);
+}
+BENCHMARK(BM_TopK)
+    ->ArgPair(8, 0)
+    ->ArgPair(8, 1)
+    ->ArgPair(512, 0)
+    ->ArgPair(512, 1)
+    ->ArgPair(16 << 10, 0)
+    ->ArgPair(16 << 10, 1);
+
+// Gather: "n" random rows of 16 floats out of 64K rows.
+Graph* Gather(int n) {
+  Graph* g = new Graph(OpRegistry::Global());
+  const int kRows = 64 << 10;
+  Tensor params(DT_FLOAT, TensorShape({kRows, 16}));
+  params.flat<float>().setRandom();
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor indices(DT_INT32, TensorShape({n}));
+  for (int i = 0; i < n; ++i) {
+    indices.flat<int32>()(i) = rnd.Uniform(kRows);
+  }
+  Tensor axis(DT_INT32, TensorShape({}));
+  axis.scalar<int32>()() = 0;
+  test::graph::Gather(g, test::graph::Constant(g, params),
+                      test::graph::Constant(g, indices),
+                      test::graph::HostConstant(g, axis));
+  return g;
+}
+
+void BM_Gather(int iters, int n, int adaptive) {
+  testing::StopTiming();
+  Graph* g = Gather(n);
+  testing::StartTiming();
+  RunBenchmark(iters, adaptive, n * 16, g);
+}
+BENCHMARK(BM_Gather)
+    ->ArgPair(16, 0)
+    ->ArgPair(16, 1)
+    ->ArgPair(1 << 10, 0)
+    ->ArgPair(1 << 10, 1)
+    ->ArgPair(64 << 10, 0)
+    ->ArgPair(64 << 10, 1);
+
+// Concat: 8 inputs of "n" floats each, along the last dimension.
+Graph* Concat(int n) {
+  Graph* g = new Graph(OpRegistry::Global());
+  std::vector<Node*> inputs;
+  for (int i = 0; i < 8; ++i) {
+    Tensor x(DT_FLOAT, TensorShape({16, n / 16}));
+    x.flat<float>().setRandom();
+    inputs.push_back(test::graph::Constant(g, x));
+  }
+  Tensor concat_dim(DT_INT32, TensorShape({}));
+  concat_dim.scalar<int32>()() = 1;
+  test::graph::ConcatV2(g, inputs, test::graph::HostConstant(g, concat_dim));
+  return g;
+}
+
+void BM_Concat(int iters, int n, int adaptive) {
+  testing::StopTiming();
+  Graph* g = Concat(n);
+  testing::StartTiming();
+  RunBenchmark(iters, adaptive, 8 * n, g);
+}
+BENCHMARK(BM_Concat)
+    ->ArgPair(256, 0)
+    ->ArgPair(256, 1)
+    ->ArgPair(16 << 10, 0)
+    ->ArgPair(16 << 10, 1)
+    ->ArgPair(1 << 20, 0)
+    ->ArgPair(1 << 20, 1);
+
+}  // namespace
+}  // namespace tensorflow
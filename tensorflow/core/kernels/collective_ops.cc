@@ -59,6 +59,27 @@ class CollectiveOpKernel : public AsyncOpKernel {
     return true;
   }
 
+  // Builds the kernel of a merge_op or final_op, by name, for the data type
+  // and device of this op.  Returns nullptr for "Id".
+  std::unique_ptr<OpKernel> BuildOpKernel(OpKernelConstruction* c,
+                                          const string& name,
+                                          NodeDef* sub_node) {
+    std::unique_ptr<OpKernel> k;
+    if (name.empty() || name == "Id") return k;
+    sub_node->set_name(name);
+    sub_node->set_op(name);
+    Status status;
+    k = CreateOpKernel(c->device_type(), c->device(),
+                       c->device()->GetAllocator(AllocatorAttributes()),
+                       *sub_node, c->graph_def_version(), &status);
+    if (!status.ok()) {
+      c->CtxFailureWithWarning(errors::Internal("Failed to build OpKernel for ",
+                                                name, " : ",
+                                                status.error_message()));
+    }
+    return k;
+  }
+
   CollectiveParams col_params_;
 };
 
@@ -105,25 +126,6 @@ class CollectiveReduceOpKernel : public CollectiveOpKernel {
     col_params_.final_op = BuildOpKernel(c, final_op_name, &sub_node);
   }
 
-  std::unique_ptr<OpKernel> BuildOpKernel(OpKernelConstruction* c,
-                                          const string& name,
-                                          NodeDef* sub_node) {
-    std::unique_ptr<OpKernel> k;
-    if (name.empty() || name == "Id") return k;
-    sub_node->set_name(name);
-    sub_node->set_op(name);
-    Status status;
-    k = CreateOpKernel(c->device_type(), c->device(),
-                       c->device()->GetAllocator(AllocatorAttributes()),
-                       *sub_node, c->graph_def_version(), &status);
-    if (!status.ok()) {
-      c->CtxFailureWithWarning(errors::Internal("Failed to build OpKernel for ",
-                                                name, " : ",
-                                                status.error_message()));
-    }
-    return k;
-  }
-
   void ComputeAsync(OpKernelContext* c, DoneCallback done) override {
     CollectiveExecutor* col_exec = c->collective_executor();
     OP_REQUIRES_ASYNC(
@@ -144,6 +146,11 @@ class CollectiveReduceOpKernel : public CollectiveOpKernel {
                                {0}, 0, c->input(0).shape(), &output),
                            done);
     }
+    if (col_params_.instance.device_names.empty()) {
+      // The shape guides the choice of reduction implementation while the
+      // params are completed.
+      col_params_.instance.shape = c->input(0).shape();
+    }
     if (!CanProceedWithCompute(c, col_exec, done)) return;
     auto actual_done = [c, col_exec, done](const Status& s) {
       OP_REQUIRES_OK_ASYNC(c, s, done);
@@ -161,6 +168,158 @@ REGISTER_KERNEL_BUILDER(Name("CollectiveReduce").Device(DEVICE_CPU),
 REGISTER_KERNEL_BUILDER(Name("CollectiveReduce").Device(DEVICE_GPU),
                         CollectiveReduceOpKernel);
 
+class CollectiveAllGatherOpKernel : public CollectiveOpKernel {
+ public:
+  explicit CollectiveAllGatherOpKernel(OpKernelConstruction* c)
+      : CollectiveOpKernel(c) {
+    col_params_.instance.type = GATHER_COLLECTIVE;
+    OP_REQUIRES_OK(c, c->GetAttr("group_size", &col_params_.group.group_size));
+    OP_REQUIRES_OK(c, c->GetAttr("group_key", &col_params_.group.group_key));
+    OP_REQUIRES_OK(
+        c, c->GetAttr("instance_key", &col_params_.instance.instance_key));
+    OP_REQUIRES_OK(c, c->GetAttr("T", &col_params_.instance.data_type));
+    col_params_.instance.impl_details.subdiv_offsets = {0};
+
+    col_params_.name = strings::StrCat(name(), ": AllGather");
+    col_params_.group.device_type = c->device_type();
+  }
+
+  void ComputeAsync(OpKernelContext* c, DoneCallback done) override {
+    CollectiveExecutor* col_exec = c->collective_executor();
+    OP_REQUIRES_ASYNC(
+        c, col_exec,
+        errors::Internal(
+            "Failed to get CollectiveExecutor from OpKernelContext for Op ",
+            col_params_.name),
+        done);
+    // Allocate output on the first pass through this function.  This must be
+    // done immediately, while we're still in the executor thread.  Otherwise
+    // the memory is not guaranteed to be unused by any concurrently executing
+    // GPU kernel.
+    if (c->mutable_output(0) == nullptr) {
+      const TensorShape& input_shape = c->input(0).shape();
+      OP_REQUIRES_ASYNC(c, input_shape.dims() >= 1,
+                        errors::InvalidArgument(
+                            "Input of ", col_params_.name,
+                            " must have rank at least 1 but has shape ",
+                            input_shape.DebugString()),
+                        done);
+      // The output is larger than the input, so must allocate.
+      TensorShape output_shape = input_shape;
+      output_shape.set_dim(
+          0, input_shape.dim_size(0) * col_params_.group.group_size);
+      Tensor* output = nullptr;
+      OP_REQUIRES_OK_ASYNC(c, c->allocate_output(0, output_shape, &output),
+                           done);
+    }
+    if (!CanProceedWithCompute(c, col_exec, done)) return;
+
+    auto actual_done = [c, col_exec, done](const Status& s) {
+      OP_REQUIRES_OK_ASYNC(c, s, done);
+      done();
+    };
+    col_exec->ExecuteAsync(c, col_params_, GetCollectiveKey(c), actual_done);
+  }
+
+ private:
+  TF_DISALLOW_COPY_AND_ASSIGN(CollectiveAllGatherOpKernel);
+};
+
+REGISTER_KERNEL_BUILDER(Name("CollectiveAllGather").Device(DEVICE_CPU),
+                        CollectiveAllGatherOpKernel);
+REGISTER_KERNEL_BUILDER(Name("CollectiveAllGather").Device(DEVICE_GPU),
+                        CollectiveAllGatherOpKernel);
+
+class CollectiveReduceScatterOpKernel : public CollectiveOpKernel {
+ public:
+  explicit CollectiveReduceScatterOpKernel(OpKernelConstruction* c)
+      : CollectiveOpKernel(c) {
+    col_params_.instance.type = REDUCE_SCATTER_COLLECTIVE;
+    OP_REQUIRES_OK(c, c->GetAttr("group_size", &col_params_.group.group_size));
+    OP_REQUIRES_OK(c, c->GetAttr("group_key", &col_params_.group.group_key));
+    OP_REQUIRES_OK(
+        c, c->GetAttr("instance_key", &col_params_.instance.instance_key));
+    col_params_.instance.impl_details.subdiv_offsets = {0};
+    string merge_op_name;
+    OP_REQUIRES_OK(c, c->GetAttr("merge_op", &merge_op_name));
+    OP_REQUIRES(c, merge_op_name == "Add" || merge_op_name == "Mul",
+                errors::InvalidArgument(
+                    "merge_op must be one of {\"Add\", \"Mul\"} but got ",
+                    merge_op_name));
+    string final_op_name;
+    OP_REQUIRES_OK(c, c->GetAttr("final_op", &final_op_name));
+    OP_REQUIRES(c, final_op_name == "Id" || final_op_name == "Div",
+                errors::InvalidArgument(
+                    "final_op must be one of {\"Id\", \"Div\"} but got ",
+                    final_op_name));
+    OP_REQUIRES_OK(c, c->GetAttr("T", &col_params_.instance.data_type));
+
+    const NodeDef& real_node = c->def();
+    col_params_.name =
+        strings::StrCat(real_node.name(), ": ReduceScatter(", merge_op_name,
+                        ",", final_op_name, ")");
+    col_params_.group.device_type = c->device_type();
+
+    // Find the OpKernels by name, type and device type.
+    NodeDef sub_node;
+    // The merge_op takes two inputs
+    sub_node.add_input(real_node.input(0));
+    sub_node.add_input(real_node.input(0));
+    sub_node.set_device(real_node.device());
+    SetAttrValue(col_params_.instance.data_type,
+                 &(*sub_node.mutable_attr())["T"]);
+    col_params_.merge_op = BuildOpKernel(c, merge_op_name, &sub_node);
+    col_params_.final_op = BuildOpKernel(c, final_op_name, &sub_node);
+  }
+
+  void ComputeAsync(OpKernelContext* c, DoneCallback done) override {
+    CollectiveExecutor* col_exec = c->collective_executor();
+    OP_REQUIRES_ASYNC(
+        c, col_exec,
+        errors::Internal(
+            "Failed to get CollectiveExecutor from OpKernelContext for Op ",
+            col_params_.name),
+        done);
+    // Allocate output on the first pass through this function.  This must be
+    // done immediately, while we're still in the executor thread.  Otherwise
+    // the memory is not guaranteed to be unused by any concurrently executing
+    // GPU kernel.
+    if (c->mutable_output(0) == nullptr) {
+      const TensorShape& input_shape = c->input(0).shape();
+      const int group_size = col_params_.group.group_size;
+      OP_REQUIRES_ASYNC(
+          c,
+          input_shape.dims() >= 1 && input_shape.dim_size(0) % group_size == 0,
+          errors::InvalidArgument(
+              "First dimension of the input of ", col_params_.name,
+              " must be divisible by group_size ", group_size,
+              " but input has shape ", input_shape.DebugString()),
+          done);
+      // The output is a shard of the input, so must allocate.
+      TensorShape output_shape = input_shape;
+      output_shape.set_dim(0, input_shape.dim_size(0) / group_size);
+      Tensor* output = nullptr;
+      OP_REQUIRES_OK_ASYNC(c, c->allocate_output(0, output_shape, &output),
+                           done);
+    }
+    if (!CanProceedWithCompute(c, col_exec, done)) return;
+
+    auto actual_done = [c, col_exec, done](const Status& s) {
+      OP_REQUIRES_OK_ASYNC(c, s, done);
+      done();
+    };
+    col_exec->ExecuteAsync(c, col_params_, GetCollectiveKey(c), actual_done);
+  }
+
+ private:
+  TF_DISALLOW_COPY_AND_ASSIGN(CollectiveReduceScatterOpKernel);
+};
+
+REGISTER_KERNEL_BUILDER(Name("CollectiveReduceScatter").Device(DEVICE_CPU),
+                        CollectiveReduceScatterOpKernel);
+REGISTER_KERNEL_BUILDER(Name("CollectiveReduceScatter").Device(DEVICE_GPU),
+                        CollectiveReduceScatterOpKernel);
+
 class CollectiveBcastSendOpKernel : public CollectiveOpKernel {
  public:
   explicit CollectiveBcastSendOpKernel(OpKernelConstruction* c)
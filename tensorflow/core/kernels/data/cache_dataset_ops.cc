@@ -12,24 +12,276 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
+#include <deque>
+
+#include "zlib.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/kernels/data/dataset.h"
-#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/env.h"
-#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+#include "tensorflow/core/platform/snappy.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
 namespace {
 
+// A file cache is a sequence of TFRecords, one for each block of consecutive
+// elements. A block stores the components of its elements column by column,
+// i.e. the first component of every element, then the second one, and so on,
+// each as a length-prefixed serialized `TensorProto`. Its record is
+//
+//   compression (1 byte) | number of elements (varint64) |
+//   size of the uncompressed columns (varint64) | (compressed) columns
+//
+// so that readers can skip a block without decompressing it.
+
+constexpr char kCacheFileSuffix[] = ".cache";
+
+// Size of the buffered elements above which the writer flushes a block.
+constexpr size_t kTargetBlockBytes = 4 << 20;
+
+// Number of decoded blocks that the reader keeps ahead of `GetNext`.
+constexpr size_t kReadAheadBlocks = 2;
+
+// Size of the read buffers for cache files.
+constexpr size_t kReadBufferBytes = 256 << 10;
+
+// Upper bound of the ratio between the uncompressed and compressed sizes of
+// the columns of a block (that of deflate; snappy's is lower).
+constexpr uint64 kMaxCompressionRatio = 1032;
+
+enum class BlockCompression : uint8 { kNone = 0, kSnappy = 1, kZlib = 2 };
+
+// A decoded block. `columns[i][j]` is component `i` of element `j`.
+struct Block {
+  uint64 num_elements = 0;
+  std::vector<std::vector<Tensor>> columns;
+};
+
+string CacheFilename(const string& prefix) {
+  return strings::StrCat(prefix, kCacheFileSuffix);
+}
+
+// Parses the compression of the blocks of new caches: "NONE", "SNAPPY" or
+// "ZLIB", in any case. An empty `name` defers to the
+// TF_DATA_CACHE_COMPRESSION environment variable, which defaults to "NONE".
+Status ParseCompression(const string& name, BlockCompression* compression) {
+  string value = name;
+  if (value.empty()) {
+    TF_RETURN_IF_ERROR(
+        ReadStringFromEnvVar("TF_DATA_CACHE_COMPRESSION", "NONE", &value));
+  }
+  value = str_util::Uppercase(value);
+  if (value == "NONE" || value.empty()) {
+    *compression = BlockCompression::kNone;
+  } else if (value == "ZLIB") {
+    *compression = BlockCompression::kZlib;
+  } else if (value == "SNAPPY") {
+    string unused;
+    if (port::Snappy_Compress("", 0, &unused)) {
+      *compression = BlockCompression::kSnappy;
+    } else {
+      LOG(WARNING) << "Snappy is not available in this build; cache blocks "
+                      "will not be compressed.";
+      *compression = BlockCompression::kNone;
+    }
+  } else {
+    return errors::InvalidArgument("Invalid cache compression: ", value,
+                                   "; expected NONE, SNAPPY or ZLIB.");
+  }
+  return Status::OK();
+}
+
+string CompressionName(BlockCompression compression) {
+  switch (compression) {
+    case BlockCompression::kSnappy:
+      return "SNAPPY";
+    case BlockCompression::kZlib:
+      return "ZLIB";
+    default:
+      return "NONE";
+  }
+}
+
+// Encodes `elements`, which have `num_components` components each, as the
+// record of a block.
+Status EncodeBlock(const std::vector<std::vector<Tensor>>& elements,
+                   size_t num_components, BlockCompression compression,
+                   string* record) {
+  string columns;
+  TensorProto proto;
+  for (size_t i = 0; i < num_components; ++i) {
+    for (const std::vector<Tensor>& element : elements) {
+      proto.Clear();
+      element[i].AsProtoTensorContent(&proto);
+      core::PutVarint64(&columns, proto.ByteSizeLong());
+      proto.AppendToString(&columns);
+    }
+  }
+
+  record->clear();
+  record->push_back(static_cast<char>(compression));
+  core::PutVarint64(record, elements.size());
+  core::PutVarint64(record, columns.size());
+  switch (compression) {
+    case BlockCompression::kNone:
+      record->append(columns);
+      break;
+    case BlockCompression::kSnappy: {
+      string compressed;
+      if (!port::Snappy_Compress(columns.data(), columns.size(),
+                                 &compressed)) {
+        return errors::Internal("Failed to compress a cache block.");
+      }
+      record->append(compressed);
+      break;
+    }
+    case BlockCompression::kZlib: {
+      string compressed(compressBound(columns.size()), '\0');
+      uLongf compressed_size = compressed.size();
+      if (compress(reinterpret_cast<Bytef*>(&compressed[0]), &compressed_size,
+                   reinterpret_cast<const Bytef*>(columns.data()),
+                   columns.size()) != Z_OK) {
+        return errors::Internal("Failed to compress a cache block.");
+      }
+      record->append(compressed.data(), compressed_size);
+      break;
+    }
+  }
+  return Status::OK();
+}
+
+// Reads the header of the block `record`, and leaves `record` pointing at
+// its (compressed) columns.
+Status DecodeBlockHeader(StringPiece* record, BlockCompression* compression,
+                         uint64* num_elements, uint64* columns_size) {
+  if (record->empty()) {
+    return errors::DataLoss("Empty cache block.");
+  }
+  *compression = static_cast<BlockCompression>((*record)[0]);
+  record->remove_prefix(1);
+  if (!core::GetVarint64(record, num_elements) ||
+      !core::GetVarint64(record, columns_size)) {
+    return errors::DataLoss("Corrupted cache block header.");
+  }
+  return Status::OK();
+}
+
+// Decodes the block `record`, whose elements have `num_components`
+// components each, into `block`.
+Status DecodeBlock(StringPiece record, size_t num_components,
+                   Allocator* allocator, Block* block) {
+  BlockCompression compression;
+  uint64 columns_size;
+  TF_RETURN_IF_ERROR(DecodeBlockHeader(&record, &compression,
+                                       &block->num_elements, &columns_size));
+  // The header is not trusted: bound the size of the columns before
+  // allocating them.
+  if (compression != BlockCompression::kNone &&
+      columns_size / kMaxCompressionRatio > record.size()) {
+    return errors::DataLoss("Corrupted cache block header.");
+  }
+  string uncompressed;
+  StringPiece columns;
+  switch (compression) {
+    case BlockCompression::kNone:
+      columns = record;
+      break;
+    case BlockCompression::kSnappy: {
+      size_t size;
+      if (!port::Snappy_GetUncompressedLength(record.data(), record.size(),
+                                              &size) ||
+          size != columns_size) {
+        return errors::DataLoss("Corrupted snappy-compressed cache block.");
+      }
+      uncompressed.resize(size);
+      if (!port::Snappy_Uncompress(record.data(), record.size(),
+                                   &uncompressed[0])) {
+        return errors::DataLoss("Corrupted snappy-compressed cache block.");
+      }
+      columns = uncompressed;
+      break;
+    }
+    case BlockCompression::kZlib: {
+      uncompressed.resize(columns_size);
+      uLongf size = columns_size;
+      if (uncompress(reinterpret_cast<Bytef*>(&uncompressed[0]), &size,
+                     reinterpret_cast<const Bytef*>(record.data()),
+                     record.size()) != Z_OK ||
+          size != columns_size) {
+        return errors::DataLoss("Corrupted zlib-compressed cache block.");
+      }
+      columns = uncompressed;
+      break;
+    }
+    default:
+      return errors::DataLoss("Unknown compression of cache block: ",
+                              static_cast<int>(compression));
+  }
+  // Every tensor takes at least one byte, for its length.
+  if (columns.size() != columns_size ||
+      block->num_elements * num_components > columns_size) {
+    return errors::DataLoss("Corrupted cache block.");
+  }
+
+  block->columns.assign(num_components, {});
+  TensorProto proto;
+  for (std::vector<Tensor>& column : block->columns) {
+    column.reserve(block->num_elements);
+    for (uint64 i = 0; i < block->num_elements; ++i) {
+      uint64 size;
+      if (!core::GetVarint64(&columns, &size) || size > columns.size() ||
+          !proto.ParseFromArray(columns.data(), size)) {
+        return errors::DataLoss("Corrupted cache block.");
+      }
+      columns.remove_prefix(size);
+      column.emplace_back();
+      if (!column.back().FromProto(allocator, proto)) {
+        return errors::DataLoss("Invalid tensor in cache block.");
+      }
+    }
+  }
+  return Status::OK();
+}
+
+// Appends the contents of the file `filename` to `dest`.
+Status AppendFileContents(Env* env, const string& filename,
+                          WritableFile* dest) {
+  std::unique_ptr<RandomAccessFile> file;
+  TF_RETURN_IF_ERROR(env->NewRandomAccessFile(filename, &file));
+  std::unique_ptr<char[]> scratch(new char[kReadBufferBytes]);
+  uint64 offset = 0;
+  while (true) {
+    StringPiece data;
+    Status s = file->Read(offset, kReadBufferBytes, &data, scratch.get());
+    if (!s.ok() && !errors::IsOutOfRange(s)) {
+      return s;
+    }
+    TF_RETURN_IF_ERROR(dest->Append(data));
+    offset += data.size();
+    if (!s.ok()) {
+      return Status::OK();
+    }
+  }
+}
+
 // See documentation in ../ops/dataset_ops.cc for a high-level description of
 // the following op.
 
 class CacheDatasetOp : public UnaryDatasetOpKernel {
  public:
   explicit CacheDatasetOp(OpKernelConstruction* ctx)
-      : UnaryDatasetOpKernel(ctx) {}
+      : UnaryDatasetOpKernel(ctx) {
+    string compression;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("compression", &compression));
+    OP_REQUIRES_OK(ctx, ParseCompression(compression, &compression_));
+  }
 
   void MakeDataset(OpKernelContext* ctx, DatasetBase* input,
                    DatasetBase** output) override {
@@ -41,7 +293,8 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
     if (filename.empty()) {
       *output = new MemoryDataset(ctx, input);
     } else {
-      *output = new FileDataset(ctx, input, filename, ctx->env());
+      *output = new FileDataset(ctx, input, filename, compression_,
+                                ctx->env());
     }
   }
 
@@ -49,19 +302,15 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
   class FileDataset : public DatasetBase {
    public:
     explicit FileDataset(OpKernelContext* ctx, const DatasetBase* input,
-                         string filename, Env* env)
+                         string filename, BlockCompression compression,
+                         Env* env)
         : DatasetBase(DatasetContext(ctx)),
           input_(input),
           filename_(std::move(filename)),
+          compression_(compression),
           env_(env),
-          num_tensors_(input->output_dtypes().size()),
-          tensor_index_padding_size_(StringPaddingSize(num_tensors_)),
-          item_index_padding_size_(StringPaddingSize(kMaxItems)),
-          tensor_format_string_(strings::Printf("%%%zuzu_%%%zuzu",
-                                                item_index_padding_size_,
-                                                tensor_index_padding_size_)) {
+          num_tensors_(input->output_dtypes().size()) {
       input_->Ref();
-      DCHECK_EQ(item_index_padding_size_, 7);
     }
 
     ~FileDataset() override { input_->Unref(); }
@@ -92,26 +341,21 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
       TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_graph));
       Node* filename = nullptr;
       TF_RETURN_IF_ERROR(b->AddScalar(filename_, &filename));
-      TF_RETURN_IF_ERROR(b->AddDataset(this, {input_graph, filename}, output));
+      AttrValue compression;
+      b->BuildAttrValue(CompressionName(compression_), &compression);
+      TF_RETURN_IF_ERROR(b->AddDataset(
+          this, {std::make_pair(0, input_graph), std::make_pair(1, filename)},
+          {}, {std::make_pair("compression", compression)}, output));
       return Status::OK();
     }
 
    private:
-    static size_t StringPaddingSize(size_t num_tensors) {
-      return strings::Printf("%zu", num_tensors - 1).size();
-    }
-
-    string FormatName(size_t item_index, size_t tensor_index) const {
-      return strings::Printf(tensor_format_string_.c_str(), item_index,
-                             tensor_index);
-    }
-
     class FileIterator : public DatasetIterator<FileDataset> {
      public:
       explicit FileIterator(const Params& params)
           : DatasetIterator<FileDataset>(params) {
         if (params.dataset->env_
-                ->FileExists(MetaFilename(params.dataset->filename_))
+                ->FileExists(CacheFilename(params.dataset->filename_))
                 .ok()) {
           mode_ = Mode::read;
         } else {
@@ -148,13 +392,13 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
         }
         if (mode_ == Mode::write &&
             dataset()
-                ->env_->FileExists(MetaFilename(dataset()->filename_))
+                ->env_->FileExists(CacheFilename(dataset()->filename_))
                 .ok()) {
           // This could happen if the cache was completely written after the
           // checkpoint was saved.
           LOG(WARNING)
               << "It looks like the cache was already completely written("
-              << MetaFilename(dataset()->filename_)
+              << CacheFilename(dataset()->filename_)
               << ") after the last checkpoint was saved. "
               << "Attempting to read the cache instead of continuing to "
               << "write. If this is a mistake, please remove the above file "
@@ -174,15 +418,16 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
       // creates the cache directory, and passes on the underlying iterator's
       // elements.
       //
-      // Caching is performed by writing the input tensors to disk using the
-      // `BundleWriter`. Note that the cache gets fully flushed to disk only
-      // after the input iterator has been fully exhausted. If the program
-      // exits, before completion of an epoch, the cached state would be lost.
-      // To ensure that the partial cache persists across sessions, one should
-      // checkpoint the input pipeline. On each call to `SaveInternal` the
-      // partial cache gets flushed to disk in files with prefix
-      // <filename>_<shard_id> where shard_id is unique for each checkpoint.
-      // When all elements have been produced, these shards get coalesced.
+      // Caching is performed by writing the input elements to disk in blocks
+      // of consecutive elements (see `EncodeBlock`). Note that the cache gets
+      // fully flushed to disk only after the input iterator has been fully
+      // exhausted. If the program exits, before completion of an epoch, the
+      // cached state would be lost. To ensure that the partial cache persists
+      // across sessions, one should checkpoint the input pipeline. On each
+      // call to `SaveInternal` the partial cache gets flushed to disk in a
+      // file <filename>_<shard_id>.cache where shard_id is unique for each
+      // checkpoint. When all elements have been produced, these shards get
+      // concatenated into <filename>.cache.
       class FileWriterIterator : public DatasetIterator<FileDataset> {
        public:
         explicit FileWriterIterator(const Params& params)
@@ -193,7 +438,9 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
                   strings::StrCat(params.dataset->filename_, "_", shard_id_)),
               lockfile_(strings::StrCat(filename_, ".lockfile")),
               lockfile_created_(false),
-              iteration_completed_(false) {}
+              iteration_completed_(false),
+              compression_(params.dataset->compression_),
+              block_bytes_(0) {}
 
         Status Initialize(IteratorContext* ctx) override {
           return dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_);
@@ -204,18 +451,6 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
                                bool* end_of_sequence) override {
           mutex_lock l(mu_);
           TF_RETURN_IF_ERROR(EnsureLockFileExists());
-          TF_RETURN_IF_ERROR(writer_->status());
-          if (cur_index_ >= kMaxItems) {
-            // As a courtesy, close the [truncated] cache file.
-            Status s = Finish();
-            if (!s.ok()) {
-              LOG(ERROR) << s;
-            }
-            return errors::InvalidArgument(
-                "Upstream iterator is producing more than ", kMaxItems,
-                " items, which is more than the cache limit.");
-          }
-
           TF_RETURN_IF_ERROR(
               input_impl_->GetNext(ctx, out_tensors, end_of_sequence));
           if (*end_of_sequence && out_tensors->empty()) {
@@ -229,11 +464,12 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
                 "Expected ",
                 dataset()->num_tensors_, " got: ", out_tensors->size());
           }
-          size_t tensor_index = 0;
+          block_.push_back(*out_tensors);
           for (const Tensor& t : *out_tensors) {
-            DCHECK_LT(tensor_index, dataset()->num_tensors_);
-            string key = dataset()->FormatName(cur_index_, tensor_index++);
-            TF_RETURN_IF_ERROR(writer_->Add(key, t));
+            block_bytes_ += t.TotalBytes();
+          }
+          if (block_bytes_ >= kTargetBlockBytes) {
+            TF_RETURN_IF_ERROR(FlushBlock());
           }
           if (*end_of_sequence) {
             TF_RETURN_IF_ERROR(Finish());
@@ -257,8 +493,8 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
           // about flushing the current shard. This ensures that we never write
           // empty shards.
           if (lockfile_created_) {
-            // Flush the current bundle.
-            TF_RETURN_IF_ERROR(writer_->Finish());
+            // Flush the current shard.
+            TF_RETURN_IF_ERROR(FinishShard());
 
             // Note: We do not delete the lockfile here. We keep lockfiles of
             // all shards around until the entire cache has been written to
@@ -310,7 +546,6 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
           }
           filename_ = strings::StrCat(dataset()->filename_, "_", shard_id_);
           lockfile_ = strings::StrCat(filename_, ".lockfile");
-          writer_.reset(new BundleWriter(dataset()->env_, filename_));
           return Status::OK();
         }
 
@@ -325,12 +560,10 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
           // Perform rudimentary locking to help catch concurrent writes to the
           // same cache files.
 
-          // 1. Check that a checkpoint for the shard has not already been
-          // written.
-          if (dataset()->env_->FileExists(MetaFilename(filename_)).ok()) {
+          // 1. Check that the shard has not already been written.
+          if (dataset()->env_->FileExists(CacheFilename(filename_)).ok()) {
             return errors::AlreadyExists("Existing cache files found: \n",
-                                         MetaFilename(filename_), "\n",
-                                         DataFilename(filename_, 0, 1), "\n",
+                                         CacheFilename(filename_), "\n",
                                          "To continue delete the above files.");
           }
 
@@ -362,44 +595,75 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
                 "Created at: ", dataset()->env_->NowSeconds())));
 
             // At this point we know that
-            // 1. There is no conflicting checkpoint with prefix `filename_`.
-            // 2. There is no concurrent session that is trying to write a ckpt
-            //    to filename.
-            // So it is safe to create a BundleWriter here. Note that it is
-            // unsafe to initialize the BundleWriter anywhere the above
-            // conditions are not met since BundleWriter's constructor creates
-            // new temp files which can delete the temp files created by a
-            // BundleWriter in another Session.
-            writer_.reset(new BundleWriter(dataset()->env_, filename_));
+            // 1. There is no conflicting shard with prefix `filename_`.
+            // 2. There is no concurrent session that is trying to write a
+            //    shard with prefix `filename_`.
+            // So it is safe to create the shard file here.
+            TF_RETURN_IF_ERROR(dataset()->env_->NewWritableFile(
+                CacheFilename(filename_), &file_));
+            writer_.reset(new io::RecordWriter(file_.get()));
             lockfile_created_ = true;
             return Status::OK();
           }
         }
 
+        // Writes the buffered elements to the current shard as a block.
+        Status FlushBlock() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+          if (block_.empty()) return Status::OK();
+          string record;
+          TF_RETURN_IF_ERROR(EncodeBlock(block_, dataset()->num_tensors_,
+                                         compression_, &record));
+          block_.clear();
+          block_bytes_ = 0;
+          return writer_->WriteRecord(record);
+        }
+
+        Status FinishShard() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+          TF_RETURN_IF_ERROR(FlushBlock());
+          TF_RETURN_IF_ERROR(writer_->Close());
+          writer_.reset();
+          Status s = file_->Close();
+          file_.reset();
+          return s;
+        }
+
         Status Finish() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
           iteration_completed_ = true;
-          // Flush the current bundle.
-          TF_RETURN_IF_ERROR(writer_->Finish());
-          // Merge all the bundles.
-          // Currently there are `shard_id_ + 1` bundles, one for each
-          // checkpoint. Each bundle has prefix <filename>_<id> where `id` is an
-          // integer starting at 0 an incremented by 1 for each new checkpoint.
-          // We merge all these bundles into a bundle with prefix <filename> so
-          // that the next call to `MakeIterator` can build a
-          // `FileReaderIterator`.
-          {
-            std::vector<string> prefixes;
-            prefixes.reserve(shard_id_ + 1);
+          TF_RETURN_IF_ERROR(FinishShard());
+          // Merge all the shards.
+          // Currently there are `shard_id_ + 1` shards, one for each
+          // checkpoint. Each shard is a file <filename>_<id>.cache where `id`
+          // is an integer starting at 0 an incremented by 1 for each new
+          // checkpoint. Since shards are sequences of records, we concatenate
+          // them into <filename>.cache so that the next call to
+          // `MakeIterator` can build a `FileReaderIterator`. The merged file
+          // is renamed into place last, so that readers never see a partial
+          // cache.
+          Env* env = dataset()->env_;
+          string merged = CacheFilename(
+              strings::StrCat(dataset()->filename_, "_", 0));
+          if (shard_id_ > 0) {
+            merged = strings::StrCat(CacheFilename(dataset()->filename_),
+                                     ".tmp");
+            std::unique_ptr<WritableFile> file;
+            TF_RETURN_IF_ERROR(env->NewWritableFile(merged, &file));
             for (size_t i = 0; i <= shard_id_; ++i) {
-              prefixes.emplace_back(
-                  strings::StrCat(dataset()->filename_, "_", i));
+              TF_RETURN_IF_ERROR(AppendFileContents(
+                  env,
+                  CacheFilename(strings::StrCat(dataset()->filename_, "_", i)),
+                  file.get()));
+            }
+            TF_RETURN_IF_ERROR(file->Close());
+            for (size_t i = 0; i <= shard_id_; ++i) {
+              TF_RETURN_IF_ERROR(env->DeleteFile(CacheFilename(
+                  strings::StrCat(dataset()->filename_, "_", i))));
             }
-            TF_RETURN_IF_ERROR(
-                MergeBundles(dataset()->env_, prefixes, dataset()->filename_));
           }
+          TF_RETURN_IF_ERROR(
+              env->RenameFile(merged, CacheFilename(dataset()->filename_)));
           // Delete all lockfiles.
           for (size_t i = 0; i <= shard_id_; ++i) {
-            TF_RETURN_IF_ERROR(dataset()->env_->DeleteFile(
+            TF_RETURN_IF_ERROR(env->DeleteFile(
                 strings::StrCat(dataset()->filename_, "_", i, ".lockfile")));
           }
           return Status::OK();
@@ -414,56 +678,62 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
         // The current prefix for the cache file. This is equal to
         // `StrCat(dataset()->filename_, "_", shard_id_)`.
         string filename_;
-        std::unique_ptr<BundleWriter> writer_ GUARDED_BY(mu_);
+        std::unique_ptr<WritableFile> file_ GUARDED_BY(mu_);
+        std::unique_ptr<io::RecordWriter> writer_ GUARDED_BY(mu_);
         string lockfile_ GUARDED_BY(mu_);
         bool lockfile_created_ GUARDED_BY(mu_);
         bool iteration_completed_ GUARDED_BY(mu_);
+        const BlockCompression compression_;
+        // Elements that have not been written to the shard yet, and their
+        // total size.
+        std::vector<std::vector<Tensor>> block_ GUARDED_BY(mu_);
+        size_t block_bytes_ GUARDED_BY(mu_);
       };  // FileWriterIterator
 
+      // FileReaderIterator reads the elements of a complete cache. A
+      // background thread reads and decodes the blocks of the cache file up
+      // to `kReadAheadBlocks` blocks ahead of `GetNextInternal`.
       class FileReaderIterator : public DatasetIterator<FileDataset> {
        public:
         explicit FileReaderIterator(const Params& params)
-            : DatasetIterator<FileDataset>(params),
-              cur_index_(0),
-              reader_(dataset()->env_, dataset()->filename_),
-              iterator_restored_(false) {}
+            : DatasetIterator<FileDataset>(params), cur_index_(0) {}
+
+        ~FileReaderIterator() override {
+          {
+            mutex_lock l(mu_);
+            cancelled_ = true;
+            cond_var_.notify_all();
+          }
+          // Wait for the read-ahead thread to exit.
+          read_ahead_thread_.reset();
+        }
 
         Status GetNextInternal(IteratorContext* ctx,
                                std::vector<Tensor>* out_tensors,
                                bool* end_of_sequence) override {
           mutex_lock l(mu_);
-          *end_of_sequence = false;
-          TF_RETURN_IF_ERROR(reader_.status());
-          if (!reader_.Valid()) {
-            return errors::Internal(
-                "Cache iterator is in an invalid state. (Perhaps GetNext "
-                "called "
-                "after end_of_sequence?)");
-          }
-          out_tensors->clear();
-          out_tensors->resize(dataset()->num_tensors_);
-
-          for (size_t i = 0; i < dataset()->num_tensors_; ++i) {
-            // When the iterator is restored from the checkpoint, `reader_` is
-            // already pointing at `key` so we do not need to skip the header
-            // entry.
-            if (!iterator_restored_) {
-              reader_
-                  .Next();  // The first entry in the table is a header entry.
-            } else {
-              iterator_restored_ = false;
+          EnsureReadAheadThreadStarted(ctx);
+          while (block_index_ >= block_.num_elements) {
+            while (blocks_.empty() && !read_ahead_finished_) {
+              cond_var_.wait(l);
             }
-            if (!reader_.Valid()) {
-              out_tensors->clear();
-              *end_of_sequence = true;
-              return Status::OK();
+            if (blocks_.empty()) {
+              *end_of_sequence = read_ahead_status_.ok();
+              return read_ahead_status_;
             }
-            StringPiece key = reader_.key();
-            DCHECK_EQ(key, dataset()->FormatName(cur_index_, i));
-            TF_RETURN_IF_ERROR(reader_.ReadCurrent(&(*out_tensors)[i]));
-            TF_RETURN_IF_ERROR(reader_.status());
+            block_ = std::move(blocks_.front());
+            blocks_.pop_front();
+            block_index_ = 0;
+            cond_var_.notify_all();
           }
+          out_tensors->clear();
+          out_tensors->reserve(dataset()->num_tensors_);
+          for (std::vector<Tensor>& column : block_.columns) {
+            out_tensors->push_back(std::move(column[block_index_]));
+          }
+          block_index_++;
           cur_index_++;
+          *end_of_sequence = false;
           return Status::OK();
         }
 
@@ -479,6 +749,9 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
             IteratorContext* ctx,
             IteratorStateReader* iterator_state_reader) override {
           mutex_lock l(mu_);
+          // The iterator is restored right after it is created, so the
+          // read-ahead thread starts from the restored `cur_index_`.
+          DCHECK(!read_ahead_thread_);
           {
             // TODO(b/78048575): Update this when saving size_t tensors directly
             // is supported.
@@ -490,19 +763,90 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
               return errors::Internal("Invalid value for cur_index ", temp);
             }
           }
-          if (!reader_.Valid()) {
-            return errors::Internal("Error initializing BundleReader.");
-          }
-          reader_.Seek(dataset()->FormatName(cur_index_, 0));
-          iterator_restored_ = true;
           return Status::OK();
         }
 
        private:
+        void EnsureReadAheadThreadStarted(IteratorContext* ctx)
+            EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+          if (!read_ahead_thread_) {
+            read_ahead_thread_.reset(ctx->env()->StartThread(
+                {}, "cache_read_ahead_thread",
+                std::bind(&FileReaderIterator::ReadAheadThread, this,
+                          ctx->allocator({}), cur_index_)));
+          }
+        }
+
+        void ReadAheadThread(Allocator* allocator, size_t skip) {
+          Status s = ReadBlocks(allocator, skip);
+          mutex_lock l(mu_);
+          read_ahead_status_ = s;
+          read_ahead_finished_ = true;
+          cond_var_.notify_all();
+        }
+
+        // Reads the blocks of the cache file into `blocks_`, leaving out its
+        // first `skip` elements.
+        Status ReadBlocks(Allocator* allocator, size_t skip) {
+          std::unique_ptr<RandomAccessFile> file;
+          TF_RETURN_IF_ERROR(dataset()->env_->NewRandomAccessFile(
+              CacheFilename(dataset()->filename_), &file));
+          io::RecordReaderOptions options;
+          options.buffer_size = kReadBufferBytes;
+          io::SequentialRecordReader reader(file.get(), options);
+          string record;
+          while (true) {
+            {
+              mutex_lock l(mu_);
+              while (!cancelled_ && blocks_.size() >= kReadAheadBlocks) {
+                cond_var_.wait(l);
+              }
+              if (cancelled_) return Status::OK();
+            }
+            Status s = reader.ReadRecord(&record);
+            if (errors::IsOutOfRange(s)) return Status::OK();
+            TF_RETURN_IF_ERROR(s);
+
+            if (skip > 0) {
+              StringPiece header = record;
+              BlockCompression compression;
+              uint64 num_elements, columns_size;
+              TF_RETURN_IF_ERROR(DecodeBlockHeader(
+                  &header, &compression, &num_elements, &columns_size));
+              if (skip >= num_elements) {
+                skip -= num_elements;
+                continue;
+              }
+            }
+            Block block;
+            TF_RETURN_IF_ERROR(DecodeBlock(record, dataset()->num_tensors_,
+                                           allocator, &block));
+            if (skip > 0) {
+              for (std::vector<Tensor>& column : block.columns) {
+                column.erase(column.begin(), column.begin() + skip);
+              }
+              block.num_elements -= skip;
+              skip = 0;
+            }
+            mutex_lock l(mu_);
+            blocks_.push_back(std::move(block));
+            cond_var_.notify_all();
+          }
+        }
+
         mutex mu_;
+        condition_variable cond_var_;
         size_t cur_index_ GUARDED_BY(mu_);
-        BundleReader reader_ GUARDED_BY(mu_);
-        bool iterator_restored_ GUARDED_BY(mu_);
+        // The block that `GetNextInternal` reads from, and the index of its
+        // next element.
+        Block block_ GUARDED_BY(mu_);
+        uint64 block_index_ GUARDED_BY(mu_) = 0;
+        // Blocks decoded by the read-ahead thread.
+        std::deque<Block> blocks_ GUARDED_BY(mu_);
+        std::unique_ptr<Thread> read_ahead_thread_ GUARDED_BY(mu_);
+        bool read_ahead_finished_ GUARDED_BY(mu_) = false;
+        Status read_ahead_status_ GUARDED_BY(mu_);
+        bool cancelled_ GUARDED_BY(mu_) = false;
       };  // FileReaderIterator
 
       void InitializeIterator() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
@@ -513,7 +857,7 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
         // in the corner case when this iterator is restored from an old
         // checkpoint in `write` mode and the cache has been completely
         // flushed to disk since then. In that case we simply build a
-        // `FileReaderIterator` and seek to the `cur_index`.
+        // `FileReaderIterator` and skip the first `cur_index` elements.
         switch (mode_) {
           case Mode::read:
             iterator_.reset(new FileReaderIterator({dataset(), prefix()}));
@@ -531,12 +875,9 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
 
     const DatasetBase* const input_;
     const string filename_;
+    const BlockCompression compression_;
     Env* const env_;
     const size_t num_tensors_;
-    const size_t tensor_index_padding_size_;
-    static const size_t kMaxItems = 10000000;  // 10 million
-    const size_t item_index_padding_size_;
-    const string tensor_format_string_;
   };  // FileDataset
 
   class MemoryDataset : public DatasetBase {
@@ -885,6 +1226,8 @@ class CacheDatasetOp : public UnaryDatasetOpKernel {
     const DatasetBase* const input_;
     const std::shared_ptr<MemoryCache> cache_;
   };  // MemoryDataset
+
+  BlockCompression compression_;
 };    // CacheDatasetOp
 
 REGISTER_KERNEL_BUILDER(Name("CacheDataset").Device(DEVICE_CPU),
@@ -26,6 +26,8 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env_time.h"
 #include "tensorflow/core/platform/tracing.h"
 
 namespace tensorflow {
@@ -77,9 +79,12 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
       case 2:
         OP_REQUIRES_OK(ctx, ParseScalarArgument(ctx, "num_parallel_calls",
                                                 &num_parallel_calls));
-        OP_REQUIRES(ctx, num_parallel_calls > 0,
+        OP_REQUIRES(ctx,
+                    num_parallel_calls > 0 ||
+                        num_parallel_calls == model::kAutoTune,
                     errors::InvalidArgument(
-                        "num_parallel_calls must be greater than zero."));
+                        "num_parallel_calls must be greater than zero, or -1 "
+                        "to autotune it."));
         break;
       default:
         OP_REQUIRES(ctx, false,
@@ -193,6 +198,9 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
           : DatasetIterator<Dataset>(params) {}
 
       ~Iterator() override {
+        if (parallelism_) {
+          parallelism_->Detach();
+        }
         mutex_lock l(mu_);
         // Cancel the runner thread.
         cancelled_ = true;
@@ -204,6 +212,20 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
       }
 
       Status Initialize(IteratorContext* ctx) override {
+        if (model::Node* node = model_node()) {
+          node->set_type(model::Node::Type::kAsync);
+          if (dataset()->num_parallel_calls_ == model::kAutoTune) {
+            parallelism_ = std::make_shared<model::SharedState>(1, [this]() {
+              mutex_lock l(mu_);
+              cond_var_.notify_all();
+            });
+            node->AddTunableParameter(model::kParallelism, parallelism_, 1,
+                                      port::NumSchedulableCPUs());
+          } else {
+            node->AddParameter(model::kParallelism,
+                               dataset()->num_parallel_calls_);
+          }
+        }
         TF_RETURN_IF_ERROR(
             dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_));
         return dataset()->captured_func_->Instantiate(ctx);
@@ -289,7 +311,8 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
       void Callback(const std::shared_ptr<IteratorContext>& ctx,
                     const std::shared_ptr<BatchResult>& result,
                     const std::shared_ptr<std::vector<Tensor>>& return_values,
-                    int64 offset, const Status& status) LOCKS_EXCLUDED(mu_) {
+                    int64 offset, uint64 start_nanos, const Status& status)
+          LOCKS_EXCLUDED(mu_) {
         result->UpdateStatus(status);
         if (status.ok()) {
           EnsureOutputAllocated(ctx, result, return_values);
@@ -321,6 +344,9 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
             result->num_elements++;
           }
         }
+        if (model::Node* node = model_node()) {
+          node->AddProcessingTime(EnvTime::Default()->NowNanos() - start_nanos);
+        }
         CallCompleted(result);
       }
 
@@ -361,10 +387,14 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
                                    std::vector<Tensor> input_element) {
               std::shared_ptr<std::vector<Tensor>> return_values(
                   new std::vector<Tensor>());
+              const uint64 start_nanos =
+                  model_node() ? EnvTime::Default()->NowNanos() : 0;
               dataset()->captured_func_->RunAsync(
                   ctx.get(), std::move(input_element), return_values.get(),
-                  [this, ctx, result, return_values, offset](Status status) {
-                    Callback(ctx, result, return_values, offset, status);
+                  [this, ctx, result, return_values, offset,
+                   start_nanos](Status status) {
+                    Callback(ctx, result, return_values, offset, start_nanos,
+                             status);
                   });
             },
             ctx, std::move(input_element)));
@@ -422,8 +452,20 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
         result->output_allocated = true;
       }
 
+      // The number of calls in flight. If autotuning was requested and the
+      // pipeline is not modeled, it is the number of CPUs.
+      int64 NumParallelCalls() {
+        if (parallelism_) {
+          return parallelism_->value();
+        }
+        if (dataset()->num_parallel_calls_ == model::kAutoTune) {
+          return port::NumSchedulableCPUs();
+        }
+        return dataset()->num_parallel_calls_;
+      }
+
       int MaxBatchResults() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-        return (dataset()->num_parallel_calls_ + dataset()->batch_size_ - 1) /
+        return (NumParallelCalls() + dataset()->batch_size_ - 1) /
                dataset()->batch_size_;
       }
 
@@ -475,12 +517,12 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
       void RunnerThread(const std::shared_ptr<IteratorContext>& ctx)
           LOCKS_EXCLUDED(mu_) {
         std::vector<std::pair<std::shared_ptr<BatchResult>, int64>> new_calls;
-        new_calls.reserve(dataset()->num_parallel_calls_);
+        new_calls.reserve(NumParallelCalls());
         while (true) {
           {
             mutex_lock l(mu_);
             while (!cancelled_ &&
-                   (num_calls_ >= dataset()->num_parallel_calls_ ||
+                   (num_calls_ >= NumParallelCalls() ||
                     batch_results_.size() > MaxBatchResults() ||
                     (batch_results_.size() == MaxBatchResults() &&
                      call_counter_ % dataset()->batch_size_ == 0))) {
@@ -491,7 +533,7 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
               return;
             }
 
-            while (num_calls_ < dataset()->num_parallel_calls_ &&
+            while (num_calls_ < NumParallelCalls() &&
                    (batch_results_.size() < MaxBatchResults() ||
                     (batch_results_.size() == MaxBatchResults() &&
                      call_counter_ % dataset()->batch_size_ != 0))) {
@@ -647,6 +689,8 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
       std::deque<std::shared_ptr<BatchResult>> batch_results_ GUARDED_BY(mu_);
       std::unique_ptr<Thread> runner_thread_ GUARDED_BY(mu_);
       bool cancelled_ GUARDED_BY(mu_) = false;
+      // Set by the performance model if the parallelism is autotuned.
+      std::shared_ptr<model::SharedState> parallelism_;
     };
 
     const DatasetBase* const input_;
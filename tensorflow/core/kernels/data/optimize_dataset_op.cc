@@ -157,6 +157,7 @@ class OptimizeDatasetOp : public UnaryDatasetOpKernel {
         params.stats_aggregator_getter = ctx->stats_aggregator_getter();
         params.lib = dataset()->lib_;
         params.allocator_getter = ctx->allocator_getter();
+        params.model = ctx->model();
         return dataset()->optimized_input_->MakeIterator(
             IteratorContext(params), prefix(), &input_impl_);
       }
@@ -170,6 +171,7 @@ class OptimizeDatasetOp : public UnaryDatasetOpKernel {
         params.stats_aggregator_getter = ctx->stats_aggregator_getter();
         params.lib = dataset()->lib_;
         params.allocator_getter = ctx->allocator_getter();
+        params.model = ctx->model();
         IteratorContext iter_ctx(params);
         return input_impl_->GetNext(&iter_ctx, out_tensors, end_of_sequence);
       }
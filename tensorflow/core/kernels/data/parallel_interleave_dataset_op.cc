@@ -28,6 +28,10 @@ namespace tensorflow {
 
 namespace {
 
+// The largest number of elements per worker that the performance model
+// buffers.
+constexpr int64 kMaxAutotunedBufferOutputElements = 1024;
+
 // See documentation in ../ops/dataset_ops.cc for a high-level
 // description of the following op.
 
@@ -70,8 +74,11 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
     OP_REQUIRES_OK(ctx, ParseScalarArgument(ctx, "buffer_output_elements",
                                             &buffer_output_elements));
     OP_REQUIRES(
-        ctx, buffer_output_elements > 0,
-        errors::InvalidArgument("`buffer_output_elements` must be > 0"));
+        ctx,
+        buffer_output_elements > 0 ||
+            buffer_output_elements == model::kAutoTune,
+        errors::InvalidArgument(
+            "`buffer_output_elements` must be > 0, or -1 to autotune it"));
 
     int64 prefetch_input_elements = 0;
     OP_REQUIRES_OK(ctx, ParseScalarArgument(ctx, "prefetch_input_elements",
@@ -241,6 +248,9 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
             worker_thread_states_(dataset()->num_threads()) {}
 
       ~Iterator() override {
+        if (buffer_size_) {
+          buffer_size_->Detach();
+        }
         mutex_lock l(mu_);
         cancelled_ = true;
         // Notify all workers in case they are blocked.
@@ -250,6 +260,25 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
       }
 
       Status Initialize(IteratorContext* ctx) override {
+        if (model::Node* node = model_node()) {
+          // The workers read their inputs concurrently. The parallelism is
+          // fixed, because it determines the order of the elements.
+          node->set_type(model::Node::Type::kAsyncParallelInputs);
+          node->AddParameter(model::kParallelism, dataset()->cycle_length_);
+          if (dataset()->buffer_output_elements_ == model::kAutoTune) {
+            buffer_size_ = std::make_shared<model::SharedState>(1, [this]() {
+              mutex_lock l(mu_);
+              for (auto& worker : workers_) {
+                worker.cond_var.notify_all();
+              }
+            });
+            node->AddTunableParameter(model::kBufferSize, buffer_size_, 1,
+                                      kMaxAutotunedBufferOutputElements);
+          } else {
+            node->AddParameter(model::kBufferSize,
+                               dataset()->buffer_output_elements_);
+          }
+        }
         TF_RETURN_IF_ERROR(
             dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_));
         return dataset()->captured_func_->Instantiate(ctx);
@@ -568,6 +597,19 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
         WorkerThreadState() : output_elem(Status::OK()) {}
       };
 
+      // The number of elements each worker buffers. If autotuning was
+      // requested and the pipeline is not modeled, it is twice the block
+      // length.
+      int64 BufferOutputElements() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (buffer_size_) {
+          return buffer_size_->value();
+        }
+        if (dataset()->buffer_output_elements_ == model::kAutoTune) {
+          return 2 * dataset()->block_length_;
+        }
+        return dataset()->buffer_output_elements_;
+      }
+
       Status EnsureWorkerThreadsStarted(IteratorContext* ctx)
           EXCLUSIVE_LOCKS_REQUIRED(mu_) {
         if (worker_threads_.empty()) {
@@ -711,8 +753,8 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
           if (!iterator_creation_status.ok()) {
             mutex_lock l(mu_);
             // Wait for space in the prefetch queue.
-            while (!cancelled_ && workers_[thread_index].outputs.size() ==
-                                      dataset()->buffer_output_elements_) {
+            while (!cancelled_ && workers_[thread_index].outputs.size() >=
+                                      BufferOutputElements()) {
               workers_[thread_index].cond_var.wait(l);
             }
             if (cancelled_) return;
@@ -760,8 +802,8 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
                 mutex_lock l(mu_);
 
                 // Wait for space in the prefetch queue.
-                while (!cancelled_ && workers_[thread_index].outputs.size() ==
-                                          dataset()->buffer_output_elements_) {
+                while (!cancelled_ && workers_[thread_index].outputs.size() >=
+                                          BufferOutputElements()) {
                   workers_[thread_index].cond_var.wait(l);
                 }
                 if (cancelled_) return;
@@ -1044,6 +1086,8 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
       // threads have exited before any other members are deallocated.
       // TODO(b/65178177): Avoid allocating additional threads.
       std::vector<std::unique_ptr<Thread>> worker_threads_ GUARDED_BY(mu_);
+      // Set by the performance model if the buffer size is autotuned.
+      std::shared_ptr<model::SharedState> buffer_size_;
     };
 
     const DatasetBase* const input_;
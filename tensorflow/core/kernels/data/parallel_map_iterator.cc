@@ -19,6 +19,9 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/env_time.h"
+
 namespace tensorflow {
 namespace {
 
@@ -33,9 +36,14 @@ class ParallelMapIterator : public DatasetBaseIterator {
         input_dataset_(input_dataset),
         init_func_(std::move(init_func)),
         map_func_(std::move(map_func)),
-        num_parallel_calls_(num_parallel_calls) {}
+        autotune_(num_parallel_calls == model::kAutoTune),
+        num_parallel_calls_(autotune_ ? port::NumSchedulableCPUs()
+                                      : num_parallel_calls) {}
 
   ~ParallelMapIterator() override {
+    if (parallelism_) {
+      parallelism_->Detach();
+    }
     // TODO(mrry): Replace this cancellation logic with a
     // CancellationManager. The syntax would be more heavyweight,
     // but it would be possible to thread a cancellation manager
@@ -52,6 +60,19 @@ class ParallelMapIterator : public DatasetBaseIterator {
   }
 
   Status Initialize(IteratorContext* ctx) override {
+    if (model::Node* node = model_node()) {
+      node->set_type(model::Node::Type::kAsync);
+      if (autotune_) {
+        parallelism_ = std::make_shared<model::SharedState>(1, [this]() {
+          mutex_lock l(mu_);
+          cond_var_.notify_all();
+        });
+        node->AddTunableParameter(model::kParallelism, parallelism_, 1,
+                                  port::NumSchedulableCPUs());
+      } else {
+        node->AddParameter(model::kParallelism, num_parallel_calls_);
+      }
+    }
     TF_RETURN_IF_ERROR(
         input_dataset_->MakeIterator(ctx, prefix(), &input_impl_));
     if (init_func_) {
@@ -195,7 +216,12 @@ class ParallelMapIterator : public DatasetBaseIterator {
     // Call `func_(input_element)`, store the result in
     // `result->return_values`, and notify `result->notification` to unblock
     // a consumer.
-    auto done = [this, result](Status status) {
+    model::Node* node = model_node();
+    const uint64 start_nanos = node ? EnvTime::Default()->NowNanos() : 0;
+    auto done = [this, result, node, start_nanos](Status status) {
+      if (node) {
+        node->AddProcessingTime(EnvTime::Default()->NowNanos() - start_nanos);
+      }
       result->status.Update(status);
       CallCompleted(result);
     };
@@ -204,7 +230,13 @@ class ParallelMapIterator : public DatasetBaseIterator {
               std::move(done));
   }
 
-  int64 MaxInvocationResults() { return num_parallel_calls_; }
+  // The number of calls in flight, which is also the number of results
+  // that are buffered.
+  int64 NumParallelCalls() {
+    return parallelism_ ? parallelism_->value() : num_parallel_calls_;
+  }
+
+  int64 MaxInvocationResults() { return NumParallelCalls(); }
 
   Status ProcessResult(const std::shared_ptr<InvocationResult>& result,
                        std::vector<Tensor>* out_tensors,
@@ -231,14 +263,14 @@ class ParallelMapIterator : public DatasetBaseIterator {
       {
         mutex_lock l(mu_);
         while (!cancelled_ &&
-               (num_calls_ >= num_parallel_calls_ ||
+               (num_calls_ >= NumParallelCalls() ||
                 invocation_results_.size() >= MaxInvocationResults())) {
           cond_var_.wait(l);
         }
         if (cancelled_) {
           return;
         }
-        while (num_calls_ < num_parallel_calls_ &&
+        while (num_calls_ < NumParallelCalls() &&
                invocation_results_.size() < MaxInvocationResults()) {
           invocation_results_.emplace_back(new InvocationResult());
           new_calls.push_back(invocation_results_.back());
@@ -294,7 +326,12 @@ class ParallelMapIterator : public DatasetBaseIterator {
   const DatasetBase* const input_dataset_;  // Not owned.
   const std::function<Status(IteratorContext*)> init_func_;
   const ParallelMapIteratorFunction map_func_;
+  // If the parallelism is autotuned and the pipeline is modeled, the model
+  // sets it through `parallelism_`. Otherwise it is `num_parallel_calls_`,
+  // which is the number of CPUs if autotuning was requested.
+  const bool autotune_;
   const int32 num_parallel_calls_;
+  std::shared_ptr<model::SharedState> parallelism_;
   // Used for coordination between the main thread and the runner thread.
   mutex mu_;
   // Used for coordination between the main thread and the runner thread. In
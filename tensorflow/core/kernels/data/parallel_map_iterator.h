@@ -36,7 +36,8 @@ using ParallelMapIteratorFunction =
 // `input_dataset` using the given degree of parallelism. `init_func` (if
 // specified) will be executed when the iterator is initialized (see
 // `IteratorBase::Initialize()`) and enables the user to specify error checking
-// logic that can fail early.
+// logic that can fail early. If `num_parallel_calls` is `model::kAutoTune`, the
+// parallelism is chosen by the performance model of the pipeline.
 std::unique_ptr<IteratorBase> NewParallelMapIterator(
     const DatasetBaseIterator::BaseParams& params,
     const DatasetBase* input_dataset,
@@ -74,9 +74,10 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
     int64 num_parallel_calls;
     OP_REQUIRES_OK(ctx, ParseScalarArgument(ctx, "num_parallel_calls",
                                             &num_parallel_calls));
-    OP_REQUIRES(ctx, num_parallel_calls > 0,
-                errors::InvalidArgument(
-                    "num_parallel_calls must be greater than zero."));
+    OP_REQUIRES(
+        ctx, num_parallel_calls > 0 || num_parallel_calls == model::kAutoTune,
+        errors::InvalidArgument("num_parallel_calls must be greater than zero, "
+                                "or -1 to autotune it."));
 
     OpInputList dense_default_tensors;
     OP_REQUIRES_OK(ctx,
@@ -139,6 +140,8 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
                   errors::InvalidArgument("Duplicate key not allowed: ",
                                           sparse_keys_[d]));
     }
+    std::unique_ptr<example::FastParseExampleIndex> index;
+    OP_REQUIRES_OK(ctx, example::FastParseExampleIndex::Create(config, &index));
     int i = 0;
     for (auto it = key_to_output_index.begin(); it != key_to_output_index.end();
          it++) {
@@ -148,8 +151,9 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
     *output = new Dataset(ctx, input, std::move(dense_defaults),
                           std::move(sparse_keys_), std::move(dense_keys_),
                           std::move(key_to_output_index), std::move(config),
-                          num_parallel_calls, sparse_types_, dense_types_,
-                          dense_shapes_, output_types_, output_shapes_);
+                          std::move(index), num_parallel_calls, sparse_types_,
+                          dense_types_, dense_shapes_, output_types_,
+                          output_shapes_);
   }
 
  private:
@@ -159,7 +163,9 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
             std::vector<Tensor> dense_defaults, std::vector<string> sparse_keys,
             std::vector<string> dense_keys,
             std::map<string, int> key_to_output_index,
-            example::FastParseExampleConfig config, int32 num_parallel_calls,
+            example::FastParseExampleConfig config,
+            std::unique_ptr<example::FastParseExampleIndex> index,
+            int32 num_parallel_calls,
             const DataTypeVector& sparse_types,
             const DataTypeVector& dense_types,
             const std::vector<PartialTensorShape>& dense_shapes,
@@ -172,6 +178,7 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
           dense_keys_(std::move(dense_keys)),
           key_to_output_index_(std::move(key_to_output_index)),
           config_(std::move(config)),
+          index_(std::move(index)),
           num_parallel_calls_(num_parallel_calls),
           sparse_types_(sparse_types),
           dense_types_(dense_types),
@@ -206,8 +213,8 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
             config.collect_feature_stats = true;
           }
           example::Result example_result;
-          Status s = FastParseExample(config, slice_vec, {}, device_threadpool,
-                                      &example_result);
+          Status s = FastParseExample(config, *index_, slice_vec, {},
+                                      device_threadpool, &example_result);
           if (s.ok()) {
             (*result).resize(key_to_output_index_.size());
             for (int d = 0; d < dense_keys_.size(); ++d) {
@@ -344,6 +351,8 @@ class ParseExampleDatasetOp : public UnaryDatasetOpKernel {
     const std::vector<string> dense_keys_;
     const std::map<string, int> key_to_output_index_;
     const example::FastParseExampleConfig config_;
+    // The feature names of `config_`, compiled once for all the elements.
+    const std::unique_ptr<const example::FastParseExampleIndex> index_;
     const int64 num_parallel_calls_;
     const DataTypeVector sparse_types_;
     const DataTypeVector dense_types_;
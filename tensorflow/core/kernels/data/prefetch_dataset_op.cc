@@ -22,6 +22,13 @@ limitations under the License.
 
 namespace tensorflow {
 
+namespace {
+
+// The largest buffer size that the performance model picks.
+constexpr int64 kMaxAutotunedBufferSize = 1024;
+
+}  // namespace
+
 // See documentation in ../ops/dataset_ops.cc for a high-level
 // description of the following op.
 
@@ -81,6 +88,9 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
       // but it would be possible to thread a cancellation manager
       // through the IteratorContext to upstream,
       // potentially-blocking iterators, when we add these.
+      if (buffer_size_) {
+        buffer_size_->Detach();
+      }
       {
         mutex_lock l(mu_);
         cancelled_ = true;
@@ -89,6 +99,21 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
     }
 
     Status Initialize(IteratorContext* ctx) override {
+      model::Node* node = model_node();
+      if (node != nullptr && dataset()->buffer_size_ != 0) {
+        node->set_type(model::Node::Type::kAsync);
+        if (dataset()->buffer_size_ == model::kAutoTune) {
+          // The performance model replaces the `PrefetchAutotuner`.
+          buffer_size_ = std::make_shared<model::SharedState>(1, [this]() {
+            mutex_lock l(mu_);
+            cond_var_.notify_all();
+          });
+          node->AddTunableParameter(model::kBufferSize, buffer_size_, 1,
+                                    kMaxAutotunedBufferSize);
+        } else {
+          node->AddParameter(model::kBufferSize, dataset()->buffer_size_);
+        }
+      }
       return dataset()->input_->MakeIterator(ctx, prefix(), &input_impl_);
     }
 
@@ -101,7 +126,7 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
         // Wait until the next element in the buffer has been
         // produced, or we are shutting down.
         while (!cancelled_ && buffer_.empty() && !prefetch_thread_finished_ &&
-               auto_tuner_.buffer_limit() != 0) {
+               BufferLimit() != 0) {
           auto_tuner_.RecordEmpty();
           cond_var_.wait(l);
         }
@@ -120,7 +145,7 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
           return Status::OK();
         }
 
-        DCHECK_EQ(auto_tuner_.buffer_limit(), 0);
+        DCHECK_EQ(BufferLimit(), 0);
       }
 
       mutex_lock parent_l(parent_mu_);
@@ -220,6 +245,10 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
       return s;
     }
 
+    int64 BufferLimit() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      return buffer_size_ ? buffer_size_->value() : auto_tuner_.buffer_limit();
+    }
+
     Status EnsurePrefetchThreadStarted(IteratorContext* ctx)
         EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       if (!prefetch_thread_) {
@@ -243,7 +272,7 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
         // 1. Wait for a slot in the buffer.
         {
           mutex_lock l(mu_);
-          while (!cancelled_ && buffer_.size() >= auto_tuner_.buffer_limit()) {
+          while (!cancelled_ && buffer_.size() >= BufferLimit()) {
             cond_var_.wait(l);
           }
 
@@ -325,6 +354,8 @@ class PrefetchDatasetOp::Dataset : public DatasetBase {
     std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(parent_mu_);
     condition_variable cond_var_;
     PrefetchAutotuner auto_tuner_ GUARDED_BY(mu_);
+    // Set by the performance model if the buffer size is autotuned.
+    std::shared_ptr<model::SharedState> buffer_size_;
     std::deque<BufferElement> buffer_ GUARDED_BY(mu_);
     std::unique_ptr<Thread> prefetch_thread_ GUARDED_BY(mu_);
     bool cancelled_ GUARDED_BY(mu_) = false;
@@ -17,10 +17,12 @@ limitations under the License.
 #include "tensorflow/core/kernels/data/dataset.h"
 #include "tensorflow/core/lib/io/buffered_inputstream.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
+#include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/zlib_compression_options.h"
 #include "tensorflow/core/lib/io/zlib_inputstream.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
@@ -498,6 +500,30 @@ class FixedLengthRecordDatasetOp : public DatasetOpKernel {
 REGISTER_KERNEL_BUILDER(Name("FixedLengthRecordDataset").Device(DEVICE_CPU),
                         FixedLengthRecordDatasetOp);
 
+// Returns true if memory-mapping TFRecord files is enabled with
+// TF_DATA_MMAP_TFRECORD_FILES=1. It is off by default: a mapped file that is
+// truncated while it is read, e.g. by another process or on a network file
+// system mounted as a local path, raises SIGBUS instead of a DataLoss error.
+bool MemoryMapTFRecordFiles() {
+  static bool enabled = [] {
+    bool enabled = false;
+    Status s =
+        ReadBoolFromEnvVar("TF_DATA_MMAP_TFRECORD_FILES", false, &enabled);
+    if (!s.ok()) {
+      LOG(ERROR) << "MemoryMapTFRecordFiles: " << s.error_message();
+    }
+    return enabled;
+  }();
+  return enabled;
+}
+
+// Returns true if `filename` is on the local file system.
+bool IsLocalFile(const string& filename) {
+  StringPiece scheme, host, path;
+  io::ParseURI(filename, &scheme, &host, &path);
+  return scheme.empty() || scheme == "file";
+}
+
 class TFRecordDatasetOp : public DatasetOpKernel {
  public:
   using DatasetOpKernel::DatasetOpKernel;
@@ -539,7 +565,10 @@ class TFRecordDatasetOp : public DatasetOpKernel {
           filenames_(std::move(filenames)),
           compression_type_(compression_type),
           options_(io::RecordReaderOptions::CreateRecordReaderOptions(
-              compression_type)) {
+              compression_type)),
+          use_mmap_(options_.compression_type ==
+                        io::RecordReaderOptions::NONE &&
+                    MemoryMapTFRecordFiles()) {
       if (buffer_size > 0) {
         options_.buffer_size = buffer_size;
       }
@@ -591,9 +620,9 @@ class TFRecordDatasetOp : public DatasetOpKernel {
         mutex_lock l(mu_);
         do {
           // We are currently processing a file, so try to read the next record.
-          if (reader_) {
+          if (reader_ || mapped_reader_) {
             Tensor result_tensor(ctx->allocator({}), DT_STRING, {});
-            Status s = reader_->ReadRecord(&result_tensor.scalar<string>()());
+            Status s = ReadRecordLocked(&result_tensor.scalar<string>()());
             if (s.ok()) {
               out_tensors->emplace_back(std::move(result_tensor));
               *end_of_sequence = false;
@@ -627,6 +656,9 @@ class TFRecordDatasetOp : public DatasetOpKernel {
         if (reader_) {
           TF_RETURN_IF_ERROR(
               writer->WriteScalar(full_name("offset"), reader_->TellOffset()));
+        } else if (mapped_reader_) {
+          TF_RETURN_IF_ERROR(writer->WriteScalar(
+              full_name("offset"), mapped_reader_->TellOffset()));
         }
         return Status::OK();
       }
@@ -643,7 +675,11 @@ class TFRecordDatasetOp : public DatasetOpKernel {
           int64 offset;
           TF_RETURN_IF_ERROR(reader->ReadScalar(full_name("offset"), &offset));
           TF_RETURN_IF_ERROR(SetupStreamsLocked(ctx->env()));
-          TF_RETURN_IF_ERROR(reader_->SeekOffset(offset));
+          if (mapped_reader_) {
+            TF_RETURN_IF_ERROR(mapped_reader_->SeekOffset(offset));
+          } else {
+            TF_RETURN_IF_ERROR(reader_->SeekOffset(offset));
+          }
         }
         return Status::OK();
       }
@@ -660,16 +696,41 @@ class TFRecordDatasetOp : public DatasetOpKernel {
         // Actually move on to next file.
         const string& next_filename =
             dataset()->filenames_[current_file_index_];
+        if (dataset()->use_mmap_ && IsLocalFile(next_filename)) {
+          // Reading the records from a mapping of the file saves a system
+          // call and a copy per record. Files that cannot be mapped, e.g.
+          // empty ones, are read from the file instead.
+          std::unique_ptr<ReadOnlyMemoryRegion> region;
+          if (env->NewReadOnlyMemoryRegionFromFile(next_filename, &region)
+                  .ok()) {
+            mapped_reader_.reset(
+                new io::MemoryMappedRecordReader(std::move(region)));
+            return Status::OK();
+          }
+        }
         TF_RETURN_IF_ERROR(env->NewRandomAccessFile(next_filename, &file_));
         reader_.reset(
             new io::SequentialRecordReader(file_.get(), dataset()->options_));
         return Status::OK();
       }
 
+      // Reads the next record of the current file into `*record`.
+      Status ReadRecordLocked(string* record) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (mapped_reader_) {
+          // The record is only copied into the output tensor.
+          StringPiece piece;
+          TF_RETURN_IF_ERROR(mapped_reader_->ReadRecord(&piece));
+          record->assign(piece.data(), piece.size());
+          return Status::OK();
+        }
+        return reader_->ReadRecord(record);
+      }
+
       // Resets all reader streams.
       void ResetStreamsLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
         reader_.reset();
         file_.reset();
+        mapped_reader_.reset();
       }
 
       mutex mu_;
@@ -679,11 +740,15 @@ class TFRecordDatasetOp : public DatasetOpKernel {
       // we must destroy `reader_` before `file_`.
       std::unique_ptr<RandomAccessFile> file_ GUARDED_BY(mu_);
       std::unique_ptr<io::SequentialRecordReader> reader_ GUARDED_BY(mu_);
+      // Set instead of `reader_` if the file is memory-mapped.
+      std::unique_ptr<io::MemoryMappedRecordReader> mapped_reader_
+          GUARDED_BY(mu_);
     };
 
     const std::vector<string> filenames_;
     const string compression_type_;
     io::RecordReaderOptions options_;
+    const bool use_mmap_;
   };
 };
 
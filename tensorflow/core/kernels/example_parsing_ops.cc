@@ -15,6 +15,7 @@ limitations under the License.
 
 // See docs in ../ops/parsing_ops.cc.
 
+#include <memory>
 #include <numeric>
 #include <unordered_set>
 #include <vector>
@@ -26,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 #include "tensorflow/core/util/example_proto_helper.h"
@@ -137,10 +139,13 @@ class ParseExampleOp : public OpKernel {
     gtl::ArraySlice<string> slice(serialized_t.data(), serialized_t.size());
     gtl::ArraySlice<string> names_slice(names_t.data(), names_t.size());
 
+    std::shared_ptr<const example::FastParseExampleIndex> index;
+    OP_REQUIRES_OK(ctx, GetIndex(config, &index));
+
     OP_REQUIRES_OK(
         ctx,
         FastParseExample(
-            config, slice, names_slice,
+            config, *index, slice, names_slice,
             ctx->device()->tensorflow_cpu_worker_threads()->workers, &result));
 
     OpOutputList dense_values;
@@ -163,6 +168,31 @@ class ParseExampleOp : public OpKernel {
 
  protected:
   ParseExampleAttrs attrs_;
+
+ private:
+  // The keys are inputs of the op, but they are almost always constants, so
+  // the index of the last config is kept until the keys change.
+  Status GetIndex(const example::FastParseExampleConfig& config,
+                  std::shared_ptr<const example::FastParseExampleIndex>* index)
+      LOCKS_EXCLUDED(mu_) {
+    {
+      mutex_lock l(mu_);
+      if (index_ != nullptr && index_->Matches(config)) {
+        *index = index_;
+        return Status::OK();
+      }
+    }
+    std::unique_ptr<example::FastParseExampleIndex> new_index;
+    TF_RETURN_IF_ERROR(
+        example::FastParseExampleIndex::Create(config, &new_index));
+    index->reset(new_index.release());
+    mutex_lock l(mu_);
+    index_ = *index;
+    return Status::OK();
+  }
+
+  mutex mu_;
+  std::shared_ptr<const example::FastParseExampleIndex> index_ GUARDED_BY(mu_);
 };
 
 REGISTER_KERNEL_BUILDER(Name("ParseExample").Device(DEVICE_CPU),
@@ -172,6 +202,17 @@ class ParseSingleExampleOp : public OpKernel {
  public:
   explicit ParseSingleExampleOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, attrs_.Init(ctx));
+    // The keys are attributes, so the index of their names is built once.
+    example::FastParseExampleConfig names;
+    for (const string& key : attrs_.dense_keys) {
+      names.dense.emplace_back();
+      names.dense.back().feature_name = key;
+    }
+    for (const string& key : attrs_.sparse_keys) {
+      names.sparse.emplace_back();
+      names.sparse.back().feature_name = key;
+    }
+    OP_REQUIRES_OK(ctx, example::FastParseExampleIndex::Create(names, &index_));
   }
 
   void Compute(OpKernelContext* ctx) override {
@@ -222,7 +263,6 @@ class ParseSingleExampleOp : public OpKernel {
 
     example::Result result;
 
-    // TODO(mrry): Build the configuration once and cache it.
     example::FastParseExampleConfig config;
     for (int d = 0; d < attrs_.dense_keys.size(); ++d) {
       config.dense.push_back({attrs_.dense_keys[d], attrs_.dense_types[d],
@@ -237,7 +277,8 @@ class ParseSingleExampleOp : public OpKernel {
     const string& serialized_proto = serialized->scalar<string>()();
 
     OP_REQUIRES_OK(ctx,
-                   FastParseSingleExample(config, serialized_proto, &result));
+                   FastParseSingleExample(config, *index_, serialized_proto,
+                                          &result));
 
     OpOutputList dense_values;
     OpOutputList sparse_indices;
@@ -259,6 +300,9 @@ class ParseSingleExampleOp : public OpKernel {
 
  protected:
   ParseSingleExampleAttrs attrs_;
+
+ private:
+  std::unique_ptr<example::FastParseExampleIndex> index_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("ParseSingleExample").Device(DEVICE_CPU),
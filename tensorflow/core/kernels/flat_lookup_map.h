@@ -0,0 +1,511 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_FLAT_LOOKUP_MAP_H_
+#define TENSORFLOW_CORE_KERNELS_FLAT_LOOKUP_MAP_H_
+
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/prefetch.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace lookup {
+
+// Storage of the keys of a FlatLookupMap, in insertion order. Integral keys
+// are stored in an array.
+template <class K>
+class FlatLookupMapKeys {
+ public:
+  // Type of the keys passed to and returned by the map.
+  typedef K KeyArg;
+
+  static uint64 Hash(KeyArg key) {
+    // Finalizer of MurmurHash3, which mixes all the bits of the key into both
+    // the bucket index (low bits) and the marker (high bits) of the hash.
+    uint64 h = static_cast<uint64>(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  size_t size() const { return keys_.size(); }
+  KeyArg Get(size_t i) const { return keys_[i]; }
+  bool Equals(size_t i, KeyArg key) const { return keys_[i] == key; }
+  void Add(KeyArg key) { keys_.push_back(key); }
+  void Reserve(size_t n) { keys_.reserve(n); }
+  void Clear() { keys_.clear(); }
+  int64 MemoryUsed() const { return keys_.capacity() * sizeof(K); }
+
+ private:
+  std::vector<K> keys_;
+};
+
+// String keys are stored back to back in a single arena, so the map does not
+// allocate per key, and looking them up reads a contiguous block of memory
+// instead of chasing one pointer per key.
+template <>
+class FlatLookupMapKeys<string> {
+ public:
+  typedef StringPiece KeyArg;
+
+  static uint64 Hash(KeyArg key) { return Hash64(key.data(), key.size()); }
+
+  size_t size() const { return ends_.size(); }
+  KeyArg Get(size_t i) const {
+    const size_t begin = i == 0 ? 0 : ends_[i - 1];
+    return StringPiece(arena_.data() + begin, ends_[i] - begin);
+  }
+  bool Equals(size_t i, KeyArg key) const {
+    const size_t begin = i == 0 ? 0 : ends_[i - 1];
+    return ends_[i] - begin == key.size() &&
+           memcmp(arena_.data() + begin, key.data(), key.size()) == 0;
+  }
+  void Add(KeyArg key) {
+    arena_.append(key.data(), key.size());
+    ends_.push_back(arena_.size());
+  }
+  void Reserve(size_t n) { ends_.reserve(n); }
+  void Clear() {
+    arena_.clear();
+    ends_.clear();
+  }
+  int64 MemoryUsed() const {
+    return arena_.capacity() + ends_.capacity() * sizeof(size_t);
+  }
+
+ private:
+  string arena_;
+  // ends_[i] is the offset in `arena_` of the end of key i.
+  std::vector<size_t> ends_;
+};
+
+// An insert-only hash map for lookup tables, which are mostly read, often
+// from many threads at once.
+//
+// The map is an open-addressed table of 64-byte buckets, each of which holds
+// the markers and entry numbers of kWidth entries. The marker of an entry is
+// 7 bits of its hash, so most lookups only compare the key of the entry they
+// are looking for, and read a single cache line of the table. The keys and
+// values are stored in insertion order in separate arrays, which keeps the
+// table small and makes iterating over the map a linear scan.
+//
+// Entries cannot be removed one by one, only all at once with Clear().
+//
+// The map is not thread-safe: concurrent calls to const methods are safe, but
+// other calls must be serialized with all calls.
+template <class K, class V>
+class FlatLookupMap {
+ public:
+  typedef typename FlatLookupMapKeys<K>::KeyArg KeyArg;
+
+  // Number of entries per bucket.
+  static constexpr int kWidth = 12;
+
+  FlatLookupMap() { Init(1); }
+  ~FlatLookupMap() { port::AlignedFree(buckets_); }
+
+  size_t size() const { return keys_.size(); }
+
+  // Returns the key and value of entry `i`, where 0 <= i < size() and entries
+  // are numbered in insertion order.
+  KeyArg key(size_t i) const { return keys_.Get(i); }
+  const V& value(size_t i) const { return values_[i].value; }
+
+  // Makes room for `n` entries, so inserting them does not grow the table.
+  void Reserve(size_t n) {
+    if (n > capacity_) Rehash(n);
+    keys_.Reserve(n);
+    values_.reserve(n);
+  }
+
+  // Removes all the entries of the map.
+  void Clear() {
+    memset(buckets_, 0, sizeof(Bucket) * (mask_ + 1));
+    keys_.Clear();
+    values_.clear();
+  }
+
+  // Returns the hash of `key` used by the map.
+  static uint64 Hash(KeyArg key) { return FlatLookupMapKeys<K>::Hash(key); }
+
+  // Returns the value of `key`, or nullptr if `key` is not in the map.
+  const V* Find(KeyArg key) const { return Find(key, Hash(key)); }
+
+  // Same as above, where `hash` is Hash(key).
+  const V* Find(KeyArg key, uint64 hash) const {
+    const int64 i = FindEntry(key, hash);
+    return i < 0 ? nullptr : &values_[i].value;
+  }
+
+  // Prefetches the first bucket that a lookup of a key with the given hash
+  // reads.
+  void Prefetch(uint64 hash) const {
+    port::prefetch<port::PREFETCH_HINT_T0>(&buckets_[hash & mask_]);
+  }
+
+  // Looks up the `n` keys of `keys`, and stores their values in `values`, or
+  // `default_value` for the keys that are not in the map.
+  //
+  // The buckets of the keys are prefetched kBatchSize keys at a time, so the
+  // cache misses of the lookups of a batch overlap.
+  template <class KeyType>
+  void FindBatch(const KeyType* keys, int64 n, const V& default_value,
+                 V* values) const {
+    constexpr int kBatchSize = 16;
+    KeyArg batch_keys[kBatchSize];
+    uint64 hashes[kBatchSize];
+    for (int64 start = 0; start < n; start += kBatchSize) {
+      const int batch_size =
+          static_cast<int>(std::min<int64>(kBatchSize, n - start));
+      for (int i = 0; i < batch_size; ++i) {
+        // Integral keys are copied, so the key that is hashed is the key that
+        // is compared even if `keys` is modified concurrently.
+        batch_keys[i] = keys[start + i];
+        hashes[i] = Hash(batch_keys[i]);
+        Prefetch(hashes[i]);
+      }
+      for (int i = 0; i < batch_size; ++i) {
+        const int64 entry = FindEntry(batch_keys[i], hashes[i]);
+        values[start + i] = entry < 0 ? default_value : values_[entry].value;
+      }
+    }
+  }
+
+  // Inserts `key` with `value`, unless `key` is already in the map. Returns
+  // the value of `key`, which stays valid until the next insertion, and
+  // whether it was inserted.
+  std::pair<V*, bool> Insert(KeyArg key, const V& value) {
+    return Insert(key, Hash(key), value);
+  }
+
+  // Same as above, where `hash` is Hash(key).
+  std::pair<V*, bool> Insert(KeyArg key, uint64 hash, const V& value) {
+    const int64 i = FindEntry(key, hash);
+    if (i >= 0) return {&values_[i].value, false};
+    if (size() >= capacity_) Rehash(size() + 1);
+    const size_t entry = size();
+    CHECK_LT(entry, kuint32max);
+    keys_.Add(key);
+    values_.push_back({value});
+    Place(hash, static_cast<uint32>(entry));
+    return {&values_.back().value, true};
+  }
+
+  // Returns the number of bytes allocated by the map.
+  int64 MemoryUsed() const {
+    return sizeof(Bucket) * (mask_ + 1) + keys_.MemoryUsed() +
+           values_.capacity() * sizeof(ValueHolder);
+  }
+
+ private:
+  struct Bucket {
+    // 0 for an empty entry, or 0x80 | the top 7 bits of the hash of the key.
+    uint8 marker[kWidth];
+    // Index into `keys_` and `values_`.
+    uint32 entry[kWidth];
+  };
+  static constexpr size_t kBucketAlignment = 64;
+  static_assert(sizeof(Bucket) <= kBucketAlignment,
+                "A bucket must fit in a cache line");
+
+  // Wraps the values so that V = bool is not stored in a std::vector<bool>.
+  struct ValueHolder {
+    V value;
+  };
+
+  static uint8 Marker(uint64 hash) { return 0x80 | (hash >> 57); }
+
+  // Allocates an empty table of `num_buckets` buckets.
+  void Init(size_t num_buckets) {
+    buckets_ = static_cast<Bucket*>(port::AlignedMalloc(
+        sizeof(Bucket) * num_buckets, kBucketAlignment));
+    CHECK(buckets_ != nullptr);
+    memset(buckets_, 0, sizeof(Bucket) * num_buckets);
+    mask_ = num_buckets - 1;
+    // Keeps the table at most 7/8 full, so probe sequences stay short.
+    capacity_ = num_buckets * kWidth * 7 / 8;
+  }
+
+  // Grows the table to hold at least `n` entries.
+  void Rehash(size_t n) {
+    size_t num_buckets = mask_ + 1;
+    while (num_buckets * kWidth * 7 / 8 < n) num_buckets *= 2;
+    port::AlignedFree(buckets_);
+    Init(num_buckets);
+    for (size_t i = 0; i < size(); ++i) {
+      Place(Hash(keys_.Get(i)), static_cast<uint32>(i));
+    }
+  }
+
+  // Stores `entry` in the first empty slot of the probe sequence of `hash`.
+  void Place(uint64 hash, uint32 entry) {
+    const uint8 marker = Marker(hash);
+    for (size_t b = hash & mask_;; b = (b + 1) & mask_) {
+      Bucket* bucket = &buckets_[b];
+      for (int i = 0; i < kWidth; ++i) {
+        if (bucket->marker[i] == 0) {
+          bucket->marker[i] = marker;
+          bucket->entry[i] = entry;
+          return;
+        }
+      }
+    }
+  }
+
+  // Returns the index of the entry of `key`, or -1 if there is none. Since
+  // entries are never removed on their own, the first empty slot of the probe
+  // sequence ends the search.
+  int64 FindEntry(KeyArg key, uint64 hash) const {
+    const uint8 marker = Marker(hash);
+    for (size_t b = hash & mask_;; b = (b + 1) & mask_) {
+      const Bucket* bucket = &buckets_[b];
+      for (int i = 0; i < kWidth; ++i) {
+        if (bucket->marker[i] == marker &&
+            keys_.Equals(bucket->entry[i], key)) {
+          return bucket->entry[i];
+        }
+        if (bucket->marker[i] == 0) return -1;
+      }
+    }
+  }
+
+  Bucket* buckets_ = nullptr;
+  // Number of buckets - 1. The number of buckets is a power of 2.
+  size_t mask_ = 0;
+  // Number of entries the table holds before it grows.
+  size_t capacity_ = 0;
+  FlatLookupMapKeys<K> keys_;
+  std::vector<ValueHolder> values_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FlatLookupMap);
+};
+
+// A FlatLookupMap split into shards by the hash of the keys, each of which is
+// guarded by its own reader-writer lock. Lookups only take shared locks, and
+// inserts into different shards do not contend, so the map scales with the
+// number of threads that update it, e.g. the workers that push sparse updates
+// into an embedding table. Each shard grows on its own, so an insert never
+// waits for the whole map to be rehashed.
+//
+// Batch operations group their keys by shard, and take the lock of each shard
+// once per batch.
+template <class K, class V>
+class ShardedLookupMap {
+ public:
+  typedef typename FlatLookupMap<K, V>::KeyArg KeyArg;
+
+  static constexpr int kDefaultNumShards = 16;
+
+  // `num_shards` must be a power of 2.
+  explicit ShardedLookupMap(int num_shards = kDefaultNumShards)
+      : num_shards_(num_shards), shards_(new Shard[num_shards]) {
+    CHECK_GT(num_shards, 0);
+    CHECK_EQ(num_shards & (num_shards - 1), 0);
+  }
+
+  size_t size() const {
+    size_t size = 0;
+    for (int s = 0; s < num_shards_; ++s) {
+      tf_shared_lock l(shards_[s].mu);
+      size += shards_[s].map.size();
+    }
+    return size;
+  }
+
+  // Calls `found(i, value)` for each of the `n` keys of `keys`, where `value`
+  // is the value of keys[i], or nullptr if keys[i] is not in the map. `found`
+  // runs under the shared lock of the shard of keys[i], and must not call the
+  // map.
+  template <class KeyType, class FoundFn>
+  void FindBatch(const KeyType* keys, int64 n, FoundFn found) const {
+    Batch<KeyType> batch;
+    GroupByShard(keys, n, &batch);
+    for (int s = 0; s < num_shards_; ++s) {
+      const int64 begin = batch.shard_begin[s];
+      const int64 end = batch.shard_begin[s + 1];
+      if (begin == end) continue;
+      tf_shared_lock l(shards_[s].mu);
+      const FlatLookupMap<K, V>& map = shards_[s].map;
+      for (int64 j = begin; j < end; ++j) {
+        if (j + kPrefetchDistance < end) {
+          map.Prefetch(batch.hashes[batch.order[j + kPrefetchDistance]]);
+        }
+        const int64 i = batch.order[j];
+        found(i, map.Find(batch.keys[i], batch.hashes[i]));
+      }
+    }
+  }
+
+  // Inserts each of the `n` keys of `keys` with the value `value(i)`, or sets
+  // its value to `value(i)` if it is already in the map.
+  template <class KeyType, class ValueFn>
+  void InsertBatch(const KeyType* keys, int64 n, ValueFn value) {
+    Batch<KeyType> batch;
+    GroupByShard(keys, n, &batch);
+    for (int s = 0; s < num_shards_; ++s) {
+      if (batch.shard_begin[s] == batch.shard_begin[s + 1]) continue;
+      mutex_lock l(shards_[s].mu);
+      InsertLocked(batch, s, value, &shards_[s].map);
+    }
+  }
+
+  // Replaces all the entries of the map with the `n` keys of `keys` and the
+  // values `value(i)`. Other calls see the map either before or after.
+  template <class KeyType, class ValueFn>
+  void Assign(const KeyType* keys, int64 n, ValueFn value)
+      NO_THREAD_SAFETY_ANALYSIS {
+    Batch<KeyType> batch;
+    GroupByShard(keys, n, &batch);
+    // The locks are always taken in the same order, so concurrent calls do
+    // not deadlock.
+    for (int s = 0; s < num_shards_; ++s) shards_[s].mu.lock();
+    for (int s = 0; s < num_shards_; ++s) {
+      shards_[s].map.Clear();
+      InsertLocked(batch, s, value, &shards_[s].map);
+    }
+    for (int s = num_shards_ - 1; s >= 0; --s) shards_[s].mu.unlock();
+  }
+
+  // Appends the keys and values of all the entries of the map to `entries`.
+  // The entries of each shard are copied under its shared lock, so they are a
+  // consistent snapshot of the shard, but other shards may be updated in the
+  // meantime.
+  void Snapshot(std::vector<std::pair<K, V>>* entries) const {
+    for (int s = 0; s < num_shards_; ++s) {
+      tf_shared_lock l(shards_[s].mu);
+      const FlatLookupMap<K, V>& map = shards_[s].map;
+      entries->reserve(entries->size() + map.size());
+      for (size_t i = 0; i < map.size(); ++i) {
+        entries->emplace_back(K(map.key(i)), map.value(i));
+      }
+    }
+  }
+
+  // Returns the number of bytes allocated by the map.
+  int64 MemoryUsed() const {
+    int64 bytes = sizeof(Shard) * num_shards_;
+    for (int s = 0; s < num_shards_; ++s) {
+      tf_shared_lock l(shards_[s].mu);
+      bytes += shards_[s].map.MemoryUsed();
+    }
+    return bytes;
+  }
+
+ private:
+  struct Shard {
+    mutable mutex mu;
+    FlatLookupMap<K, V> map GUARDED_BY(mu);
+  };
+
+  // The keys of a batch, grouped by shard.
+  template <class KeyType>
+  struct Batch {
+    // The keys of the batch. Integral keys may be read from a tensor that
+    // other ops update concurrently, so they are copied once into
+    // `copied_keys`, and the hash and the lookup of a key both see the same
+    // value. Other keys are used in place.
+    const KeyType* keys = nullptr;
+    std::vector<KeyType> copied_keys;
+    // hashes[i] is the hash of keys[i].
+    std::vector<uint64> hashes;
+    // The indices of the keys of shard s are
+    // order[shard_begin[s], shard_begin[s + 1]).
+    std::vector<int64> order;
+    std::vector<int64> shard_begin;
+  };
+
+  // Number of keys ahead of the current one whose buckets are prefetched.
+  static constexpr int kPrefetchDistance = 4;
+
+  // The bits of the hash that pick the shard are neither the low bits, which
+  // pick the bucket, nor the high bits, which are the marker of the entry.
+  int ShardOf(uint64 hash) const { return (hash >> 32) & (num_shards_ - 1); }
+
+  template <class KeyType>
+  static void CopyKeys(const KeyType* keys, int64 n, Batch<KeyType>* batch,
+                       std::true_type /* is_integral */) {
+    batch->copied_keys.resize(n);
+    for (int64 i = 0; i < n; ++i) {
+      batch->copied_keys[i] = internal::SubtleMustCopy(keys[i]);
+    }
+    batch->keys = batch->copied_keys.data();
+  }
+
+  template <class KeyType>
+  static void CopyKeys(const KeyType* keys, int64 n, Batch<KeyType>* batch,
+                       std::false_type /* is_integral */) {
+    batch->keys = keys;
+  }
+
+  template <class KeyType>
+  void GroupByShard(const KeyType* keys, int64 n,
+                    Batch<KeyType>* batch) const {
+    CopyKeys(keys, n, batch, std::is_integral<KeyType>());
+    batch->hashes.resize(n);
+    batch->shard_begin.assign(num_shards_ + 1, 0);
+    for (int64 i = 0; i < n; ++i) {
+      batch->hashes[i] = FlatLookupMap<K, V>::Hash(batch->keys[i]);
+      ++batch->shard_begin[ShardOf(batch->hashes[i]) + 1];
+    }
+    for (int s = 0; s < num_shards_; ++s) {
+      batch->shard_begin[s + 1] += batch->shard_begin[s];
+    }
+    std::vector<int64> next(batch->shard_begin.begin(),
+                            batch->shard_begin.end() - 1);
+    batch->order.resize(n);
+    for (int64 i = 0; i < n; ++i) {
+      batch->order[next[ShardOf(batch->hashes[i])]++] = i;
+    }
+  }
+
+  template <class KeyType, class ValueFn>
+  static void InsertLocked(const Batch<KeyType>& batch, int shard,
+                           ValueFn value, FlatLookupMap<K, V>* map) {
+    for (int64 j = batch.shard_begin[shard]; j < batch.shard_begin[shard + 1];
+         ++j) {
+      const int64 i = batch.order[j];
+      const V v = value(i);
+      auto result = map->Insert(batch.keys[i], batch.hashes[i], v);
+      if (!result.second) *result.first = v;
+    }
+  }
+
+  const int num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ShardedLookupMap);
+};
+
+}  // namespace lookup
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_FLAT_LOOKUP_MAP_H_
@@ -0,0 +1,249 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/flat_lookup_map.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace lookup {
+namespace {
+
+TEST(FlatLookupMapTest, InsertAndFind) {
+  FlatLookupMap<int64, int64> map;
+  EXPECT_EQ(0, map.size());
+  EXPECT_EQ(nullptr, map.Find(1));
+
+  // Enough keys to grow the table several times.
+  for (int64 i = 0; i < 10000; ++i) {
+    auto result = map.Insert(i * 7 - 5000, i);
+    EXPECT_TRUE(result.second);
+    EXPECT_EQ(i, *result.first);
+  }
+  EXPECT_EQ(10000, map.size());
+
+  auto result = map.Insert(5, 100);
+  EXPECT_FALSE(result.second);
+  EXPECT_EQ(715, *result.first);
+
+  for (int64 i = 0; i < 10000; ++i) {
+    const int64* value = map.Find(i * 7 - 5000);
+    ASSERT_NE(nullptr, value);
+    EXPECT_EQ(i, *value);
+    EXPECT_EQ(nullptr, map.Find(i * 7 - 4999));
+  }
+
+  // Entries are numbered in insertion order.
+  for (int64 i = 0; i < 10000; ++i) {
+    EXPECT_EQ(i * 7 - 5000, map.key(i));
+    EXPECT_EQ(i, map.value(i));
+  }
+
+  map.Clear();
+  EXPECT_EQ(0, map.size());
+  EXPECT_EQ(nullptr, map.Find(2));
+  EXPECT_TRUE(map.Insert(2, 3).second);
+  EXPECT_EQ(3, *map.Find(2));
+}
+
+TEST(FlatLookupMapTest, StringKeys) {
+  FlatLookupMap<string, bool> map;
+  map.Reserve(1000);
+  EXPECT_TRUE(map.Insert("", true).second);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(map.Insert(strings::StrCat("key", i), i % 2 == 0).second);
+  }
+  EXPECT_FALSE(map.Insert("key10", false).second);
+  EXPECT_EQ(1001, map.size());
+
+  EXPECT_TRUE(*map.Find(""));
+  EXPECT_TRUE(*map.Find("key10"));
+  EXPECT_FALSE(*map.Find("key11"));
+  EXPECT_EQ(nullptr, map.Find("key1000"));
+  EXPECT_EQ(nullptr, map.Find("key"));
+  EXPECT_EQ("", map.key(0));
+  EXPECT_EQ("key999", map.key(1000));
+}
+
+TEST(FlatLookupMapTest, FindBatch) {
+  FlatLookupMap<string, int64> map;
+  for (int64 i = 0; i < 100; ++i) {
+    map.Insert(strings::StrCat("key", i), i);
+  }
+  // Covers full batches, a partial batch, and missing keys.
+  std::vector<string> keys;
+  for (int i = 0; i < 50; ++i) {
+    keys.push_back(strings::StrCat("key", i * 3));
+  }
+  std::vector<int64> values(keys.size());
+  map.FindBatch(keys.data(), keys.size(), -1, values.data());
+  for (int i = 0; i < 50; ++i) {
+    EXPECT_EQ(i * 3 < 100 ? i * 3 : -1, values[i]);
+  }
+}
+
+TEST(FlatLookupMapTest, MatchesUnorderedMap) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  FlatLookupMap<int32, int32> map;
+  std::unordered_map<int32, int32> expected;
+  for (int i = 0; i < 20000; ++i) {
+    // Keys collide often, so both new and existing keys are inserted.
+    const int32 key = static_cast<int32>(rnd.Uniform(30000)) - 15000;
+    const bool inserted = map.Insert(key, i).second;
+    EXPECT_EQ(expected.insert({key, i}).second, inserted);
+  }
+  EXPECT_EQ(expected.size(), map.size());
+  for (const auto& entry : expected) {
+    EXPECT_EQ(entry.second, *map.Find(entry.first));
+  }
+}
+
+TEST(ShardedLookupMapTest, InsertFindAndAssign) {
+  ShardedLookupMap<int64, int64> map;
+  std::vector<int64> keys;
+  for (int64 i = 0; i < 1000; ++i) keys.push_back(i * 3);
+  map.InsertBatch(keys.data(), keys.size(),
+                  [](int64 i) { return i; });
+  EXPECT_EQ(1000, map.size());
+  // Existing keys are updated.
+  map.InsertBatch(keys.data(), 10, [](int64 i) { return -i; });
+  EXPECT_EQ(1000, map.size());
+
+  std::vector<int64> queries;
+  for (int64 i = 0; i < 3000; ++i) queries.push_back(i);
+  std::vector<int64> values(queries.size());
+  map.FindBatch(queries.data(), queries.size(),
+                [&values](int64 i, const int64* value) {
+                  values[i] = value == nullptr ? 12345 : *value;
+                });
+  for (int64 i = 0; i < 3000; ++i) {
+    if (i % 3 != 0) {
+      EXPECT_EQ(12345, values[i]);
+    } else if (i < 30) {
+      EXPECT_EQ(-i / 3, values[i]);
+    } else {
+      EXPECT_EQ(i / 3, values[i]);
+    }
+  }
+
+  std::vector<std::pair<int64, int64>> entries;
+  map.Snapshot(&entries);
+  EXPECT_EQ(1000, entries.size());
+
+  map.Assign(keys.data(), 2, [](int64) { return 7; });
+  EXPECT_EQ(2, map.size());
+  entries.clear();
+  map.Snapshot(&entries);
+  std::sort(entries.begin(), entries.end());
+  EXPECT_EQ((std::vector<std::pair<int64, int64>>({{0, 7}, {3, 7}})), entries);
+}
+
+TEST(ShardedLookupMapTest, ConcurrentInserts) {
+  ShardedLookupMap<string, int64> map;
+  constexpr int kNumThreads = 8;
+  constexpr int kKeysPerThread = 1000;
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&map, t]() {
+        for (int i = 0; i < kKeysPerThread; ++i) {
+          const string key = strings::StrCat(t, "_", i);
+          map.InsertBatch(&key, 1, [i](int64) { return i; });
+          int64 value = -1;
+          map.FindBatch(&key, 1, [&value](int64, const int64* found) {
+            value = *found;
+          });
+          CHECK_EQ(i, value);
+        }
+      });
+    }
+  }
+  EXPECT_EQ(kNumThreads * kKeysPerThread, map.size());
+}
+
+void BM_FlatLookupMapFindBatch(int iters, int num_keys) {
+  testing::StopTiming();
+  FlatLookupMap<string, int64> map;
+  std::vector<string> keys;
+  for (int i = 0; i < num_keys; ++i) {
+    keys.push_back(strings::StrCat("vocabulary_word_", i));
+    map.Insert(keys.back(), i);
+  }
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<string> queries;
+  for (int i = 0; i < 1024; ++i) {
+    // One query in 8 misses.
+    const int key = rnd.Uniform(num_keys + num_keys / 7);
+    queries.push_back(strings::StrCat("vocabulary_word_", key));
+  }
+  std::vector<int64> values(queries.size());
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    map.FindBatch(queries.data(), queries.size(), -1, values.data());
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * queries.size());
+}
+BENCHMARK(BM_FlatLookupMapFindBatch)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+// Threads that insert batches of keys and look them up, as workers pushing
+// sparse updates to a table do.
+void BM_ShardedLookupMapInsertFind(int iters, int num_threads, int num_shards) {
+  testing::StopTiming();
+  constexpr int kBatchSize = 256;
+  ShardedLookupMap<int64, int64> map(num_shards);
+  thread::ThreadPool pool(Env::Default(), "bench", num_threads);
+  testing::StartTiming();
+  BlockingCounter counter(num_threads);
+  for (int t = 0; t < num_threads; ++t) {
+    pool.Schedule([&map, &counter, iters, num_threads, t]() {
+      std::vector<int64> keys(kBatchSize);
+      std::vector<int64> values(kBatchSize);
+      for (int i = t; i < iters; i += num_threads) {
+        for (int j = 0; j < kBatchSize; ++j) {
+          keys[j] = (static_cast<int64>(i) * kBatchSize + j) % (1 << 20);
+        }
+        map.InsertBatch(keys.data(), kBatchSize,
+                        [](int64 j) { return j; });
+        map.FindBatch(keys.data(), kBatchSize,
+                      [&values](int64 j, const int64* value) {
+                        values[j] = *value;
+                      });
+      }
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  testing::ItemsProcessed(static_cast<int64>(iters) * kBatchSize);
+}
+BENCHMARK(BM_ShardedLookupMapInsertFind)
+    ->ArgPair(1, 1)
+    ->ArgPair(8, 1)
+    ->ArgPair(8, 16);
+
+}  // namespace
+}  // namespace lookup
+}  // namespace tensorflow
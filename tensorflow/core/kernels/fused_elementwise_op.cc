@@ -0,0 +1,374 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+namespace {
+
+enum class FusedOp {
+  // Binary ops.
+  kAdd,
+  kSub,
+  kMul,
+  kDiv,
+  kMaximum,
+  kMinimum,
+  kSquaredDifference,
+  // Unary ops.
+  kAbs,
+  kElu,
+  kExp,
+  kLog,
+  kNeg,
+  kReciprocal,
+  kRelu,
+  kRelu6,
+  kRsqrt,
+  kSigmoid,
+  kSqrt,
+  kSquare,
+  kTanh,
+};
+
+// WARN: This should be consistent with the ops fused by the remapper.
+struct FusedOpInfo {
+  const char* name;
+  FusedOp op;
+  int num_operands;
+};
+
+// clang-format off
+constexpr FusedOpInfo kFusedOps[] = {
+    {"Add",               FusedOp::kAdd,               2},
+    {"AddV2",             FusedOp::kAdd,               2},
+    {"BiasAdd",           FusedOp::kAdd,               2},
+    {"Sub",               FusedOp::kSub,               2},
+    {"Mul",               FusedOp::kMul,               2},
+    {"Div",               FusedOp::kDiv,               2},
+    {"RealDiv",           FusedOp::kDiv,               2},
+    {"Maximum",           FusedOp::kMaximum,           2},
+    {"Minimum",           FusedOp::kMinimum,           2},
+    {"SquaredDifference", FusedOp::kSquaredDifference, 2},
+    {"Abs",               FusedOp::kAbs,               1},
+    {"Elu",               FusedOp::kElu,               1},
+    {"Exp",               FusedOp::kExp,               1},
+    {"Inv",               FusedOp::kReciprocal,        1},
+    {"Log",               FusedOp::kLog,               1},
+    {"Neg",               FusedOp::kNeg,               1},
+    {"Reciprocal",        FusedOp::kReciprocal,        1},
+    {"Relu",              FusedOp::kRelu,              1},
+    {"Relu6",             FusedOp::kRelu6,             1},
+    {"Rsqrt",             FusedOp::kRsqrt,             1},
+    {"Sigmoid",           FusedOp::kSigmoid,           1},
+    {"Sqrt",              FusedOp::kSqrt,              1},
+    {"Square",            FusedOp::kSquare,            1},
+    {"Tanh",              FusedOp::kTanh,              1},
+};
+// clang-format on
+
+const FusedOpInfo* FindFusedOp(const string& name) {
+  for (const FusedOpInfo& info : kFusedOps) {
+    if (name == info.name) return &info;
+  }
+  return nullptr;
+}
+
+// Returns the number of cycles per element of `op`.
+template <typename T>
+int Cost(FusedOp op) {
+  using Eigen::internal::functor_traits;
+  switch (op) {
+    case FusedOp::kDiv:
+    case FusedOp::kReciprocal:
+      return functor_traits<Eigen::internal::scalar_quotient_op<T>>::Cost;
+    case FusedOp::kElu:
+    case FusedOp::kExp:
+      return functor_traits<Eigen::internal::scalar_exp_op<T>>::Cost;
+    case FusedOp::kLog:
+      return functor_traits<Eigen::internal::scalar_log_op<T>>::Cost;
+    case FusedOp::kRsqrt:
+      return functor_traits<Eigen::internal::scalar_rsqrt_op<T>>::Cost;
+    case FusedOp::kSigmoid:
+      return functor_traits<Eigen::internal::scalar_logistic_op<T>>::Cost;
+    case FusedOp::kSqrt:
+      return functor_traits<Eigen::internal::scalar_sqrt_op<T>>::Cost;
+    case FusedOp::kTanh:
+      return functor_traits<Eigen::internal::scalar_tanh_op<T>>::Cost;
+    default:
+      return Eigen::NumTraits<T>::AddCost;
+  }
+}
+
+// Computes out[i] = op(x[i], y[i]) for 0 <= i < n, where `y` is nullptr for
+// unary ops.
+template <typename T>
+void RunOp(FusedOp op, const T* x, const T* y, T* out, int64 n) {
+  typename TTypes<T>::UnalignedConstFlat a(x, n);
+  typename TTypes<T>::UnalignedConstFlat b(y, y == nullptr ? 0 : n);
+  typename TTypes<T>::UnalignedFlat z(out, n);
+  switch (op) {
+    case FusedOp::kAdd:
+      z = a + b;
+      break;
+    case FusedOp::kSub:
+      z = a - b;
+      break;
+    case FusedOp::kMul:
+      z = a * b;
+      break;
+    case FusedOp::kDiv:
+      z = a / b;
+      break;
+    case FusedOp::kMaximum:
+      z = a.cwiseMax(b);
+      break;
+    case FusedOp::kMinimum:
+      z = a.cwiseMin(b);
+      break;
+    case FusedOp::kSquaredDifference:
+      z = (a - b).square();
+      break;
+    case FusedOp::kAbs:
+      z = a.abs();
+      break;
+    case FusedOp::kElu:
+      z = (a < static_cast<T>(0))
+              .select(a.exp() - a.constant(static_cast<T>(1)), a);
+      break;
+    case FusedOp::kExp:
+      z = a.exp();
+      break;
+    case FusedOp::kLog:
+      z = a.log();
+      break;
+    case FusedOp::kNeg:
+      z = -a;
+      break;
+    case FusedOp::kReciprocal:
+      z = a.inverse();
+      break;
+    case FusedOp::kRelu:
+      z = a.cwiseMax(static_cast<T>(0));
+      break;
+    case FusedOp::kRelu6:
+      z = a.cwiseMax(static_cast<T>(0)).cwiseMin(static_cast<T>(6));
+      break;
+    case FusedOp::kRsqrt:
+      z = a.rsqrt();
+      break;
+    case FusedOp::kSigmoid:
+      z = a.sigmoid();
+      break;
+    case FusedOp::kSqrt:
+      z = a.sqrt();
+      break;
+    case FusedOp::kSquare:
+      z = a.square();
+      break;
+    case FusedOp::kTanh:
+      z = a.tanh();
+      break;
+  }
+}
+
+// Returns whether `shape` is broadcast along all but the last dimension of
+// `output_shape`, i.e. is [n] or [1, ..., 1, n] where n is the last
+// dimension of `output_shape`, or is a scalar.
+bool IsBroadcastRow(const TensorShape& shape, const TensorShape& output_shape) {
+  if (shape.dims() > output_shape.dims()) return false;
+  if (shape.num_elements() == 1) return true;
+  if (shape.dims() == 0) return false;
+  for (int d = 0; d < shape.dims() - 1; ++d) {
+    if (shape.dim_size(d) != 1) return false;
+  }
+  return shape.dim_size(shape.dims() - 1) ==
+         output_shape.dim_size(output_shape.dims() - 1);
+}
+
+}  // namespace
+
+// Runs a fused chain of elementwise ops in a single pass over its inputs:
+// the output is computed kBlockSize elements at a time, and the intermediate
+// results of a block stay in the cache until the next op of the chain reads
+// them, instead of being written to and read back from memory.
+template <typename T>
+class FusedElementwiseOp : public OpKernel {
+ public:
+  explicit FusedElementwiseOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    int num_inputs;
+    OP_REQUIRES_OK(context, context->GetAttr("N", &num_inputs));
+    std::vector<string> op_names;
+    OP_REQUIRES_OK(context, context->GetAttr("op_names", &op_names));
+    std::vector<int> operands;
+    OP_REQUIRES_OK(context, context->GetAttr("operands", &operands));
+    OP_REQUIRES(context, !op_names.empty(),
+                errors::InvalidArgument("Fused op must have at least one op"));
+    OP_REQUIRES(
+        context, operands.size() == 2 * op_names.size(),
+        errors::InvalidArgument("Expected ", 2 * op_names.size(),
+                                " operands, got: ", operands.size()));
+
+    for (int i = 0; i < op_names.size(); ++i) {
+      const FusedOpInfo* info = FindFusedOp(op_names[i]);
+      OP_REQUIRES(context, info != nullptr,
+                  errors::InvalidArgument("Unsupported fused op: ",
+                                          op_names[i]));
+      Step step;
+      step.op = info->op;
+      for (int j = 0; j < 2; ++j) {
+        step.operands[j] = operands[2 * i + j];
+        if (j >= info->num_operands) {
+          OP_REQUIRES(context, step.operands[j] == -1,
+                      errors::InvalidArgument("Op ", i, " (", op_names[i],
+                                              ") has too many operands"));
+          continue;
+        }
+        // An op reads inputs, or the results of the previous ops.
+        OP_REQUIRES(context,
+                    step.operands[j] >= 0 &&
+                        step.operands[j] < num_inputs + i,
+                    errors::InvalidArgument("Operand ", j, " of op ", i, " (",
+                                            op_names[i], ") is invalid: ",
+                                            step.operands[j]));
+      }
+      cost_per_element_ += Cost<T>(step.op);
+      steps_.push_back(step);
+    }
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    OpInputList inputs;
+    OP_REQUIRES_OK(ctx, ctx->input_list("inputs", &inputs));
+    const TensorShape& shape = inputs[0].shape();
+    const int64 num_elements = shape.num_elements();
+
+    // Broadcast inputs are tiled into buffers of kBlockSize + period
+    // elements, where period is their number of elements, so that the
+    // elements of any block of the output are contiguous in them.
+    std::vector<Tensor> tiled(inputs.size());
+    std::vector<const T*> data(inputs.size());
+    std::vector<int64> periods(inputs.size(), 0);
+    int64 bytes_loaded = 0;
+    for (int i = 0; i < inputs.size(); ++i) {
+      const Tensor& input = inputs[i];
+      if (input.shape() == shape) {
+        data[i] = input.flat<T>().data();
+        bytes_loaded += sizeof(T);
+        continue;
+      }
+      OP_REQUIRES(ctx, IsBroadcastRow(input.shape(), shape),
+                  errors::InvalidArgument(
+                      "Input ", i, " of shape ", input.shape().DebugString(),
+                      " does not broadcast to ", shape.DebugString()));
+      const int64 period = input.NumElements();
+      OP_REQUIRES_OK(ctx,
+                     ctx->allocate_temp(DataTypeToEnum<T>::value,
+                                        TensorShape({kBlockSize + period}),
+                                        &tiled[i]));
+      const T* src = input.flat<T>().data();
+      T* dst = tiled[i].flat<T>().data();
+      for (int64 j = 0; j < kBlockSize + period; j += period) {
+        std::copy_n(src, std::min(period, kBlockSize + period - j), dst + j);
+      }
+      data[i] = dst;
+      periods[i] = period;
+    }
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(
+        ctx, ctx->forward_input_or_allocate_output({0}, 0, shape, &output));
+    T* out = output->flat<T>().data();
+    if (num_elements == 0) return;
+
+    const int num_inputs = inputs.size();
+    const int num_steps = steps_.size();
+    auto compute_fn = [this, &data, &periods, out, num_inputs, num_steps](
+                          int64 begin, int64 end) {
+      // The results of all the ops but the last one, for one block.
+      std::vector<T> scratch(kBlockSize * (num_steps - 1));
+      for (int64 block = begin; block < end; block += kBlockSize) {
+        const int64 n = std::min(kBlockSize, end - block);
+        auto operand = [&](int j) -> const T* {
+          if (j < 0) return nullptr;
+          if (j >= num_inputs) return &scratch[kBlockSize * (j - num_inputs)];
+          if (periods[j] == 0) return data[j] + block;
+          return data[j] + block % periods[j];
+        };
+        for (int s = 0; s < num_steps; ++s) {
+          const Step& step = steps_[s];
+          T* result =
+              s == num_steps - 1 ? out + block : &scratch[kBlockSize * s];
+          RunOp<T>(step.op, operand(step.operands[0]),
+                   operand(step.operands[1]), result, n);
+        }
+      }
+    };
+
+    const CPUDevice& device = ctx->eigen_device<CPUDevice>();
+    const Eigen::TensorOpCost cost(bytes_loaded, /*bytes_stored=*/sizeof(T),
+                                   cost_per_element_);
+    device.parallelFor(num_elements, cost, AlignBlockSize,
+                       std::move(compute_fn));
+  }
+
+ private:
+  // Number of elements of the output computed at a time. The intermediate
+  // results of a block fit in the L1 cache for short chains of ops, and in
+  // the L2 cache for long ones.
+  static constexpr int64 kBlockSize = 1024;
+
+  static int64 AlignBlockSize(int64 block_size) {
+    return (block_size + kBlockSize - 1) / kBlockSize * kBlockSize;
+  }
+
+  struct Step {
+    FusedOp op;
+    int operands[2];
+  };
+
+  std::vector<Step> steps_;
+  int cost_per_element_ = 0;
+};
+
+template <typename T>
+constexpr int64 FusedElementwiseOp<T>::kBlockSize;
+
+#define REGISTER_CPU(T)                                                    \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("_FusedElementwise").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      FusedElementwiseOp<T>);
+
+REGISTER_CPU(float);
+REGISTER_CPU(double);
+
+#undef REGISTER_CPU
+
+}  // namespace tensorflow
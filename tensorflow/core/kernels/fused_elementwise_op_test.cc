@@ -0,0 +1,144 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedElementwiseOpTest : public OpsTestBase {
+ protected:
+  Status MakeOp(int num_inputs, const std::vector<string>& op_names,
+                const std::vector<int>& operands) {
+    TF_RETURN_IF_ERROR(NodeDefBuilder("fused", "_FusedElementwise")
+                           .Input(FakeInput(num_inputs, DT_FLOAT))
+                           .Attr("op_names", op_names)
+                           .Attr("operands", operands)
+                           .Finalize(node_def()));
+    return InitOp();
+  }
+};
+
+TEST_F(FusedElementwiseOpTest, MulBiasAddRelu) {
+  // relu(x * scale + bias), where scale and bias are broadcast rows.
+  TF_ASSERT_OK(MakeOp(3, {"Mul", "BiasAdd", "Relu"}, {0, 1, 3, 2, 4, -1}));
+  AddInputFromArray<float>(TensorShape({2, 3}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({3}), {1, -1, 2});
+  AddInputFromArray<float>(TensorShape({1, 3}), {0.5, 1, -7});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 3}));
+  test::FillValues<float>(&expected, {1.5, 0, 0, 4.5, 0, 5});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-6);
+}
+
+TEST_F(FusedElementwiseOpTest, ManyBlocks) {
+  // sigmoid((2 * x - x)^2 + row) over more elements than a block, with rows
+  // that do not divide the block size.
+  TF_ASSERT_OK(MakeOp(
+      3, {"Mul", "SquaredDifference", "Add", "Sigmoid"},
+      {0, 1, 3, 0, 4, 2, 5, -1}));
+  constexpr int kRows = 500;
+  constexpr int kCols = 7;
+  std::vector<float> x(kRows * kCols);
+  for (int i = 0; i < x.size(); ++i) x[i] = (i % 13) * 0.25f - 1;
+  const std::vector<float> row = {-3, -2, -1, 0, 1, 2, 3};
+  AddInputFromArray<float>(TensorShape({kRows, kCols}), x);
+  AddInputFromArray<float>(TensorShape({}), {2});
+  AddInputFromArray<float>(TensorShape({kCols}), row);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({kRows, kCols}));
+  auto expected_flat = expected.flat<float>();
+  for (int i = 0; i < x.size(); ++i) {
+    const float diff = 2 * x[i] - x[i];
+    expected_flat(i) = 1 / (1 + std::exp(-(diff * diff + row[i % kCols])));
+  }
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedElementwiseOpTest, InvalidOperands) {
+  // Ops only read inputs and the results of previous ops.
+  EXPECT_TRUE(
+      errors::IsInvalidArgument(MakeOp(1, {"Neg", "Exp"}, {0, -1, 2, -1})));
+  EXPECT_TRUE(errors::IsInvalidArgument(MakeOp(1, {"Neg"}, {0, 0})));
+  EXPECT_TRUE(errors::IsInvalidArgument(MakeOp(1, {"Add"}, {0, -1})));
+  EXPECT_TRUE(errors::IsInvalidArgument(MakeOp(1, {"Cumsum"}, {0, -1})));
+}
+
+TEST_F(FusedElementwiseOpTest, InputDoesNotBroadcast) {
+  TF_ASSERT_OK(MakeOp(2, {"Add"}, {0, 1}));
+  AddInputFromArray<float>(TensorShape({2, 3}), {1, 2, 3, 4, 5, 6});
+  // A column does not broadcast along the rows.
+  AddInputFromArray<float>(TensorShape({3, 1}), {1, 2, 3});
+  EXPECT_TRUE(errors::IsInvalidArgument(RunOpKernel()));
+}
+
+// relu(x * scale + bias), as separate ops or as a single fused op.
+static Graph* ScaleBiasRelu(int rows, int cols, bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor x(DT_FLOAT, TensorShape({rows, cols}));
+  x.flat<float>().setRandom();
+  Tensor scale(DT_FLOAT, TensorShape({cols}));
+  scale.flat<float>().setRandom();
+  Tensor bias(DT_FLOAT, TensorShape({cols}));
+  bias.flat<float>().setRandom();
+  Node* x_node = test::graph::Constant(g, x);
+  Node* scale_node = test::graph::Constant(g, scale);
+  Node* bias_node = test::graph::Constant(g, bias);
+  if (fused) {
+    TF_CHECK_OK(
+        NodeBuilder(g->NewName("n"), "_FusedElementwise")
+            .Input(std::vector<NodeBuilder::NodeOut>(
+                {x_node, scale_node, bias_node}))
+            .Attr("op_names", std::vector<string>({"Mul", "BiasAdd", "Relu"}))
+            .Attr("operands", std::vector<int>({0, 1, 3, 2, 4, -1}))
+            .Finalize(g, nullptr));
+  } else {
+    Node* mul = test::graph::Binary(g, "Mul", x_node, scale_node);
+    Node* bias_add = test::graph::Binary(g, "BiasAdd", mul, bias_node);
+    test::graph::Unary(g, "Relu", bias_add);
+  }
+  return g;
+}
+
+#define BM_ScaleBiasRelu(R, C, FUSED)                                     \
+  static void BM_ScaleBiasRelu_##R##_##C##_##FUSED(int iters) {           \
+    testing::ItemsProcessed(static_cast<int64>(iters) * R * C);           \
+    testing::BytesProcessed(static_cast<int64>(iters) * R * C * 2 *       \
+                            sizeof(float));                               \
+    test::Benchmark("cpu", ScaleBiasRelu(R, C, FUSED)).Run(iters);        \
+  }                                                                       \
+  BENCHMARK(BM_ScaleBiasRelu_##R##_##C##_##FUSED);
+
+BM_ScaleBiasRelu(1024, 64, false);
+BM_ScaleBiasRelu(1024, 64, true);
+BM_ScaleBiasRelu(16384, 256, false);
+BM_ScaleBiasRelu(16384, 256, true);
+
+}  // namespace
+}  // namespace tensorflow
@@ -50,7 +50,13 @@ Status InitializableLookupTable::Initialize(InitTableIterator& iter) {
     return errors::FailedPrecondition("Table already initialized.");
   }
 
-  TF_RETURN_IF_ERROR(DoLazyPrepare([&iter]() { return iter.total_size(); }));
+  const int64 known_total_size = iter.known_total_size();
+  if (known_total_size >= 0) {
+    TF_RETURN_IF_ERROR(DoPrepare(known_total_size));
+  } else {
+    TF_RETURN_IF_ERROR(
+        DoLazyPrepare([&iter]() { return iter.total_size(); }));
+  }
   while (iter.Valid()) {
     TF_RETURN_IF_ERROR(DoInsert(iter.keys(), iter.values()));
     iter.Next();
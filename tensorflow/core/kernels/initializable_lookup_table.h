@@ -115,6 +115,10 @@ class InitializableLookupTable : public LookupInterface {
     // It might return -1 in case of error.
     virtual int64 total_size() const = 0;
 
+    // Returns total_size() if it is known without reading the data, e.g.
+    // without counting the lines of a file, or -1.
+    virtual int64 known_total_size() const { return -1; }
+
    private:
     TF_DISALLOW_COPY_AND_ASSIGN(InitTableIterator);
   };
@@ -130,6 +134,8 @@ class InitializableLookupTable : public LookupInterface {
 
   // Same as DoPrepare() but derived implementations might choose to skip
   // calling get_expected_num_elements if size is not needed for DoPrepare.
+  // Only called if the iterator does not know its size upfront; otherwise
+  // DoPrepare() is called with it.
   virtual Status DoLazyPrepare(
       std::function<int64(void)> get_expected_num_elements) {
     int64 expected_num_elements = get_expected_num_elements();
@@ -193,6 +199,8 @@ class KeyValueTensorIterator
     return keys_ == nullptr ? -1 : keys_->NumElements();
   }
 
+  int64 known_total_size() const override { return total_size(); }
+
  private:
   TF_DISALLOW_COPY_AND_ASSIGN(KeyValueTensorIterator);
 
@@ -16,6 +16,8 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <type_traits>
 #include <utility>
@@ -30,11 +32,13 @@ limitations under the License.
 namespace tensorflow {
 namespace lookup {
 
-// Lookup table that wraps an unordered_map, where the key and value data type
-// is specified. Each individual value must be a scalar. If vector values are
-// required, use MutableHashTableOfTensors.
+// Lookup table that wraps a ShardedLookupMap, where the key and value data
+// type is specified. Each individual value must be a scalar. If vector values
+// are required, use MutableHashTableOfTensors.
 //
 // This table is mutable and thread safe - Insert can be called at any time.
+// Lookups only take shared locks, and inserts only lock the shards of their
+// keys, so concurrent lookups and inserts scale with the number of threads.
 //
 // Sample use case:
 //
@@ -49,10 +53,7 @@ class MutableHashTableOfScalars final : public LookupInterface {
  public:
   MutableHashTableOfScalars(OpKernelContext* ctx, OpKernel* kernel) {}
 
-  size_t size() const override {
-    mutex_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -60,26 +61,24 @@ class MutableHashTableOfScalars final : public LookupInterface {
     const auto key_values = key.flat<K>();
     auto value_values = value->flat<V>();
 
-    mutex_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      value_values(i) = gtl::FindWithDefault(
-          table_, SubtleMustCopyIfIntegral(key_values(i)), default_val);
-    }
-
+    table_.FindBatch(key_values.data(), key_values.size(),
+                     [&value_values, &default_val](int64 i, const V* value) {
+                       value_values(i) =
+                           value != nullptr ? *value : default_val;
+                     });
     return Status::OK();
   }
 
   Status DoInsert(bool clear, const Tensor& keys, const Tensor& values) {
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat<V>();
-
-    mutex_lock l(mu_);
+    auto value = [&value_values](int64 i) {
+      return SubtleMustCopyIfIntegral(value_values(i));
+    };
     if (clear) {
-      table_.clear();
-    }
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
-                          SubtleMustCopyIfIntegral(value_values(i)));
+      table_.Assign(key_values.data(), key_values.size(), value);
+    } else {
+      table_.InsertBatch(key_values.data(), key_values.size(), value);
     }
     return Status::OK();
   }
@@ -95,8 +94,9 @@ class MutableHashTableOfScalars final : public LookupInterface {
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    mutex_lock l(mu_);
-    int64 size = table_.size();
+    std::vector<std::pair<K, V>> entries;
+    table_.Snapshot(&entries);
+    const int64 size = entries.size();
 
     Tensor* keys;
     Tensor* values;
@@ -107,10 +107,9 @@ class MutableHashTableOfScalars final : public LookupInterface {
 
     auto keys_data = keys->flat<K>();
     auto values_data = values->flat<V>();
-    int64 i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      keys_data(i) = it->first;
-      values_data(i) = it->second;
+    for (int64 i = 0; i < size; ++i) {
+      keys_data(i) = entries[i].first;
+      values_data(i) = entries[i].second;
     }
     return Status::OK();
   }
@@ -124,26 +123,14 @@ class MutableHashTableOfScalars final : public LookupInterface {
   TensorShape value_shape() const override { return TensorShape(); }
 
   int64 MemoryUsed() const override {
-    int64 ret = 0;
-    mutex_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
-    }
-    return sizeof(MutableHashTableOfScalars) + ret;
+    return sizeof(MutableHashTableOfScalars) + table_.MemoryUsed();
   }
 
  private:
-  // TODO(andreasst): consider using a read/write lock or a concurrent map
-  mutable mutex mu_;
-  std::unordered_map<K, V> table_ GUARDED_BY(mu_);
+  ShardedLookupMap<K, V> table_;
 };
 
-// Lookup table that wraps an unordered_map. Behaves identical to
+// Lookup table that wraps a ShardedLookupMap. Behaves identical to
 // MutableHashTableOfScalars except that each value must be a vector.
 template <class K, class V>
 class MutableHashTableOfTensors final : public LookupInterface {
@@ -157,10 +144,7 @@ class MutableHashTableOfTensors final : public LookupInterface {
                                 value_shape_.DebugString()));
   }
 
-  size_t size() const override {
-    mutex_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -169,21 +153,20 @@ class MutableHashTableOfTensors final : public LookupInterface {
     auto value_values = value->flat_inner_dims<V, 2>();
     int64 value_dim = value_shape_.dim_size(0);
 
-    mutex_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      ValueArray* value_vec =
-          gtl::FindOrNull(table_, SubtleMustCopyIfIntegral(key_values(i)));
-      if (value_vec != nullptr) {
-        for (int64 j = 0; j < value_dim; j++) {
-          value_values(i, j) = value_vec->at(j);
-        }
-      } else {
-        for (int64 j = 0; j < value_dim; j++) {
-          value_values(i, j) = default_flat(j);
-        }
-      }
-    }
-
+    table_.FindBatch(
+        key_values.data(), key_values.size(),
+        [&value_values, &default_flat, value_dim](int64 i,
+                                                  const ValueArray* value_vec) {
+          if (value_vec != nullptr) {
+            for (int64 j = 0; j < value_dim; j++) {
+              value_values(i, j) = value_vec->at(j);
+            }
+          } else {
+            for (int64 j = 0; j < value_dim; j++) {
+              value_values(i, j) = default_flat(j);
+            }
+          }
+        });
     return Status::OK();
   }
 
@@ -192,18 +175,18 @@ class MutableHashTableOfTensors final : public LookupInterface {
     const auto value_values = values.flat_inner_dims<V, 2>();
     int64 value_dim = value_shape_.dim_size(0);
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
-    }
-    for (int64 i = 0; i < key_values.size(); ++i) {
+    auto value = [&value_values, value_dim](int64 i) {
       ValueArray value_vec;
       for (int64 j = 0; j < value_dim; j++) {
         V value = value_values(i, j);
         value_vec.push_back(value);
       }
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
-                          value_vec);
+      return value_vec;
+    };
+    if (clear) {
+      table_.Assign(key_values.data(), key_values.size(), value);
+    } else {
+      table_.InsertBatch(key_values.data(), key_values.size(), value);
     }
     return Status::OK();
   }
@@ -219,8 +202,9 @@ class MutableHashTableOfTensors final : public LookupInterface {
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    mutex_lock l(mu_);
-    int64 size = table_.size();
+    std::vector<std::pair<K, ValueArray>> entries;
+    table_.Snapshot(&entries);
+    int64 size = entries.size();
     int64 value_dim = value_shape_.dim_size(0);
 
     Tensor* keys;
@@ -232,11 +216,9 @@ class MutableHashTableOfTensors final : public LookupInterface {
 
     auto keys_data = keys->flat<K>();
     auto values_data = values->matrix<V>();
-    int64 i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      K key = it->first;
-      ValueArray value = it->second;
-      keys_data(i) = key;
+    for (int64 i = 0; i < size; ++i) {
+      keys_data(i) = entries[i].first;
+      const ValueArray& value = entries[i].second;
       for (int64 j = 0; j < value_dim; j++) {
         values_data(i, j) = value[j];
       }
@@ -253,25 +235,13 @@ class MutableHashTableOfTensors final : public LookupInterface {
   TensorShape value_shape() const override { return value_shape_; }
 
   int64 MemoryUsed() const override {
-    int64 ret = 0;
-    mutex_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
-    }
-    return sizeof(MutableHashTableOfTensors) + ret;
+    return sizeof(MutableHashTableOfTensors) + table_.MemoryUsed();
   }
 
  private:
   TensorShape value_shape_;
-  // TODO(andreasst): consider using a read/write lock or a concurrent map
-  mutable mutex mu_;
   typedef gtl::InlinedVector<V, 4> ValueArray;
-  std::unordered_map<K, ValueArray> table_ GUARDED_BY(mu_);
+  ShardedLookupMap<K, ValueArray> table_;
 };
 
 namespace {
@@ -294,6 +264,16 @@ TensorShape MaybeVectorizeShape(const TensorShape& shape) {
 }  // namespace
 
 // Modeled after densehashtable in https://github.com/sparsehash/sparsehash
+//
+// The keys are split into shards by their hash, and each shard has its own
+// buckets, guarded by its own reader-writer lock, so lookups and inserts into
+// different shards run concurrently. A shard that runs out of buckets does not
+// rehash all its entries at once: it allocates larger buckets, moves a few of
+// the old buckets into them on every later insert, and looks keys up in both
+// until the old buckets are empty.
+//
+// The table is exported as a single array of buckets, laid out as if the table
+// were not sharded, so checkpoints do not depend on the sharding.
 template <class K, class V>
 class MutableDenseHashTable final : public LookupInterface {
  public:
@@ -323,78 +303,65 @@ class MutableDenseHashTable final : public LookupInterface {
                 errors::InvalidArgument(
                     "Empty key must be a scalar or a vector, got shape ",
                     key_shape_.DebugString()));
-    empty_key_ = PersistentTensor(*empty_key_input);
-    empty_key_hash_ = HashKey(
-        empty_key_input->template shaped<K, 2>({1, key_shape_.num_elements()}),
-        0);
+    key_size_ = key_shape_.num_elements();
+    value_size_ = value_shape_.num_elements();
+    empty_key_ = *empty_key_input;
+    empty_key_data_ = empty_key_.flat<K>().data();
+    empty_key_hash_ = HashKey(empty_key_data_);
 
     int64 initial_num_buckets;
     OP_REQUIRES_OK(ctx, GetNodeAttr(kernel->def(), "initial_num_buckets",
                                     &initial_num_buckets));
-    OP_REQUIRES_OK(ctx, AllocateBuckets(ctx, initial_num_buckets));
+    OP_REQUIRES(ctx,
+                initial_num_buckets >= 4 &&
+                    (initial_num_buckets & (initial_num_buckets - 1)) == 0,
+                errors::InvalidArgument(
+                    "Number of buckets must be at least 4 and a power of 2, "
+                    "got: ",
+                    initial_num_buckets));
+    num_buckets_ = initial_num_buckets;
+    for (Shard& shard : shards_) {
+      mutex_lock l(shard.mu);
+      shard.table = NewTable(std::max<int64>(
+          kMinShardBuckets, initial_num_buckets / kNumShards));
+    }
   }
 
-  size_t size() const override LOCKS_EXCLUDED(mu_) {
-    mutex_lock l(mu_);
-    return num_entries_;
-  }
+  size_t size() const override { return num_entries_; }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
-              const Tensor& default_value) override LOCKS_EXCLUDED(mu_) {
+              const Tensor& default_value) override {
     const int64 num_elements = (key.dims() == 0) ? 1 : key.dim_size(0);
-    const int64 key_size = key_shape_.num_elements();
-    const int64 value_size = value_shape_.num_elements();
-    if (key.NumElements() != num_elements * key_size) {
+    if (key.NumElements() != num_elements * key_size_) {
       TensorShape expected_shape({num_elements});
       expected_shape.AppendShape(key_shape_);
       return errors::InvalidArgument("Expected key shape ",
                                      expected_shape.DebugString(), " got ",
                                      key.shape().DebugString());
     }
-    const auto key_matrix = key.shaped<K, 2>({num_elements, key_size});
-    auto value_matrix = value->shaped<V, 2>({num_elements, value_size});
-    const auto default_flat = default_value.flat<V>();
+    const K* keys = key.flat<K>().data();
+    V* values = value->flat<V>().data();
+    const V* default_values = default_value.flat<V>().data();
 
-    mutex_lock l(mu_);
-    const auto key_buckets_matrix =
-        key_buckets_.AccessTensor(ctx)->template matrix<K>();
-    const auto value_buckets_matrix =
-        value_buckets_.AccessTensor(ctx)->template matrix<V>();
-    const auto empty_key_matrix =
-        empty_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
-    const int64 bit_mask = num_buckets_ - 1;
+    Batch batch;
+    TF_RETURN_IF_ERROR(GroupByShard(keys, num_elements,
+                                    /*ignore_empty_key=*/false, &batch));
     // TODO(andreasst): parallelize using work_sharder
-    for (int64 i = 0; i < num_elements; ++i) {
-      const uint64 key_hash = HashKey(key_matrix, i);
-      if (empty_key_hash_ == key_hash &&
-          IsEqualKey(empty_key_matrix, 0, key_matrix, i)) {
-        return errors::InvalidArgument(
-            "Using the empty_key as a table key is not allowed");
-      }
-      int64 bucket_index = key_hash & bit_mask;
-      int64 num_probes = 0;
-      while (true) {
-        if (IsEqualKey(key_buckets_matrix, bucket_index, key_matrix, i)) {
-          for (int64 j = 0; j < value_size; ++j) {
-            // TODO(andreasst): check if we can get rid of SubtleMustCopy
-            // here and elsewhere in this file.
-            value_matrix(i, j) =
-                SubtleMustCopyIfIntegral(value_buckets_matrix(bucket_index, j));
-          }
-          break;
-        }
-        if (IsEqualKey(key_buckets_matrix, bucket_index, empty_key_matrix, 0)) {
-          for (int64 j = 0; j < value_size; ++j) {
-            value_matrix(i, j) = SubtleMustCopyIfIntegral(default_flat(j));
-          }
-          break;
-        }
-        ++num_probes;
-        bucket_index =
-            (bucket_index + num_probes) & bit_mask;  // quadratic probing
-        if (num_probes >= num_buckets_) {
-          return errors::Internal(
-              "Internal error in MutableDenseHashTable lookup");
+    for (int s = 0; s < kNumShards; ++s) {
+      if (batch.shard_begin[s] == batch.shard_begin[s + 1]) continue;
+      const Shard& shard = shards_[s];
+      tf_shared_lock l(shard.mu);
+      for (int64 j = batch.shard_begin[s]; j < batch.shard_begin[s + 1]; ++j) {
+        const int64 i = batch.order[j];
+        const V* found;
+        TF_RETURN_IF_ERROR(
+            FindLocked(shard, keys + i * key_size_, batch.hashes[i], &found));
+        const V* source = found != nullptr ? found : default_values;
+        V* target = values + i * value_size_;
+        for (int64 k = 0; k < value_size_; ++k) {
+          // TODO(andreasst): check if we can get rid of SubtleMustCopy
+          // here and elsewhere in this file.
+          target[k] = SubtleMustCopyIfIntegral(source[k]);
         }
       }
     }
@@ -402,60 +369,107 @@ class MutableDenseHashTable final : public LookupInterface {
   }
 
   Status Insert(OpKernelContext* ctx, const Tensor& key,
-                const Tensor& value) override LOCKS_EXCLUDED(mu_) {
+                const Tensor& value) override {
     const int64 batch_size = (key.dims() == 0) ? 1 : key.dim_size(0);
-    if (key.NumElements() != batch_size * key_shape_.num_elements()) {
+    if (key.NumElements() != batch_size * key_size_) {
       TensorShape expected_shape({batch_size});
       expected_shape.AppendShape(key_shape_);
       return errors::InvalidArgument("Expected key shape ",
                                      expected_shape.DebugString(), " got ",
                                      key.shape().DebugString());
     }
-    mutex_lock l(mu_);
+    const K* keys = key.flat<K>().data();
+    const V* values = value.flat<V>().data();
+
+    Batch batch;
+    TF_RETURN_IF_ERROR(GroupByShard(keys, batch_size,
+                                    /*ignore_empty_key=*/false, &batch));
     // For simplicity we assume that all keys in the input result in inserts
     // rather than updates. That means we may grow the table even though we
     // don't need to. As long as the number of keys inserted in one call is
     // small compared to the size of the map, the impact of this is minimal.
     const int64 pending_num_entries = num_entries_ + batch_size;
-    if (pending_num_entries > num_buckets_ * max_load_factor_) {
-      int64 new_num_buckets = num_buckets_;
+    int64 num_buckets = num_buckets_;
+    while (pending_num_entries > num_buckets * max_load_factor_) {
+      int64 new_num_buckets = num_buckets;
       do {
         new_num_buckets <<= 1;
       } while (pending_num_entries > new_num_buckets * max_load_factor_);
-      TF_RETURN_IF_ERROR(Rebucket(ctx, new_num_buckets));
+      if (num_buckets_.compare_exchange_weak(num_buckets, new_num_buckets)) {
+        break;
+      }
+    }
+    for (int s = 0; s < kNumShards; ++s) {
+      if (batch.shard_begin[s] == batch.shard_begin[s + 1]) continue;
+      Shard* shard = &shards_[s];
+      mutex_lock l(shard->mu);
+      TF_RETURN_IF_ERROR(InsertLocked(keys, values, batch, s, shard));
     }
-    return DoInsert(ctx, key, value, false);
+    return Status::OK();
   }
 
   Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
-                      const Tensor& values) override LOCKS_EXCLUDED(mu_) {
-    mutex_lock l(mu_);
-    num_buckets_ = keys.dim_size(0);
-    key_buckets_ = PersistentTensor(keys);
-    value_buckets_ = PersistentTensor(values);
-    // Count the number of keys that are not the empty_key. This requires
-    // iterating through the whole table but that is OK as we only execute it
-    // during checkpoint restore.
+                      const Tensor& values) override NO_THREAD_SAFETY_ANALYSIS {
+    const int64 num_buckets = keys.dim_size(0);
+    const K* key_data = keys.flat<K>().data();
+    const V* value_data = values.flat<V>().data();
+    Batch batch;
+    TF_RETURN_IF_ERROR(GroupByShard(key_data, num_buckets,
+                                    /*ignore_empty_key=*/true, &batch));
+
+    // The shards are replaced all at once, and their locks are always taken
+    // in the same order.
+    for (Shard& shard : shards_) shard.mu.lock();
+    Status status;
     num_entries_ = 0;
-    const auto empty_key_tensor =
-        empty_key_.AccessTensor(ctx)->template shaped<K, 2>(
-            {1, key_shape_.num_elements()});
-    const auto key_buckets_tensor =
-        key_buckets_.AccessTensor(ctx)->template matrix<K>();
-    for (int64 i = 0; i < num_buckets_; ++i) {
-      if (!IsEqualKey(key_buckets_tensor, i, empty_key_tensor, 0)) {
-        ++num_entries_;
+    num_buckets_ = num_buckets;
+    for (int s = 0; s < kNumShards && status.ok(); ++s) {
+      Shard* shard = &shards_[s];
+      const int64 num_entries = batch.shard_begin[s + 1] - batch.shard_begin[s];
+      int64 shard_buckets = kMinShardBuckets;
+      while (num_entries > shard_buckets * max_load_factor_) {
+        shard_buckets <<= 1;
       }
+      shard->table = NewTable(shard_buckets);
+      shard->old_table = Table();
+      shard->num_migrated = 0;
+      shard->num_entries = 0;
+      status = InsertLocked(key_data, value_data, batch, s, shard);
     }
-    return Status::OK();
+    for (int s = kNumShards - 1; s >= 0; --s) shards_[s].mu.unlock();
+    return status;
   }
 
-  Status ExportValues(OpKernelContext* ctx) override LOCKS_EXCLUDED(mu_) {
-    mutex_lock l(mu_);
-    Tensor key_buckets_tensor = *key_buckets_.AccessTensor(ctx);
-    Tensor value_buckets_tensor = *value_buckets_.AccessTensor(ctx);
-    TF_RETURN_IF_ERROR(ctx->set_output("keys", key_buckets_tensor));
-    TF_RETURN_IF_ERROR(ctx->set_output("values", value_buckets_tensor));
+  Status ExportValues(OpKernelContext* ctx) override {
+    // Copies the entries of each shard under its lock, so they are a
+    // consistent snapshot of the shard.
+    std::vector<Table> snapshots(kNumShards);
+    int64 num_entries = 0;
+    for (int s = 0; s < kNumShards; ++s) {
+      const Shard& shard = shards_[s];
+      tf_shared_lock l(shard.mu);
+      TF_RETURN_IF_ERROR(SnapshotLocked(shard, &snapshots[s]));
+      num_entries += snapshots[s].num_buckets;
+    }
+
+    // Lays the entries out in the buckets of an unsharded table.
+    int64 num_buckets = 4;
+    while (num_buckets < num_buckets_ ||
+           num_entries > num_buckets * max_load_factor_) {
+      num_buckets <<= 1;
+    }
+    Tensor* keys;
+    Tensor* values;
+    TF_RETURN_IF_ERROR(ctx->allocate_output(
+        "keys", TensorShape({num_buckets, key_size_}), &keys));
+    TF_RETURN_IF_ERROR(ctx->allocate_output(
+        "values", TensorShape({num_buckets, value_size_}), &values));
+    Table exported = MakeTable(*keys, *values);
+    for (const Table& snapshot : snapshots) {
+      for (int64 i = 0; i < snapshot.num_buckets; ++i) {
+        TF_RETURN_IF_ERROR(Place(snapshot, i, &exported));
+      }
+    }
     return Status::OK();
   }
 
@@ -493,154 +507,355 @@ class MutableDenseHashTable final : public LookupInterface {
   TensorShape value_shape() const override { return value_shape_; }
 
   int64 MemoryUsed() const override {
-    mutex_lock l(mu_);
-    return sizeof(MutableDenseHashTable) + key_buckets_.AllocatedBytes() +
-           value_buckets_.AllocatedBytes() + empty_key_.AllocatedBytes();
+    int64 ret = sizeof(MutableDenseHashTable) + empty_key_.AllocatedBytes();
+    for (const Shard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      ret += shard.table.keys.AllocatedBytes() +
+             shard.table.values.AllocatedBytes() +
+             shard.old_table.keys.AllocatedBytes() +
+             shard.old_table.values.AllocatedBytes();
+    }
+    return ret;
   }
 
  private:
-  Status DoInsert(OpKernelContext* ctx, const Tensor& key, const Tensor& value,
-                  bool ignore_empty_key) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-    const int64 num_elements = (key.dims() == 0) ? 1 : key.dim_size(0);
-    const int64 value_size = value_shape_.num_elements();
-    const int64 key_size = key_shape_.num_elements();
-    const auto key_matrix = key.shaped<K, 2>({num_elements, key_size});
-    auto value_matrix = value.shaped<V, 2>({num_elements, value_size});
-
-    auto key_buckets_matrix =
-        key_buckets_.AccessTensor(ctx)->template matrix<K>();
-    auto value_buckets_matrix =
-        value_buckets_.AccessTensor(ctx)->template matrix<V>();
-    const auto empty_key_tensor =
-        empty_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
-    const int64 bit_mask = num_buckets_ - 1;
-    for (int64 i = 0; i < num_elements; ++i) {
-      const uint64 key_hash = HashKey(key_matrix, i);
-      if (empty_key_hash_ == key_hash &&
-          IsEqualKey(empty_key_tensor, 0, key_matrix, i)) {
-        if (ignore_empty_key) {
-          continue;
-        }
-        return errors::InvalidArgument(
-            "Using the empty_key as a table key is not allowed");
+  // The buckets of a shard, in the layout of the exported table: bucket i
+  // holds row i of `keys` and of `values`, and empty buckets hold the empty
+  // key.
+  struct Table {
+    int64 num_buckets = 0;
+    Tensor keys;
+    Tensor values;
+    // The buffers of `keys` and `values`.
+    K* key_data = nullptr;
+    V* value_data = nullptr;
+  };
+
+  struct Shard {
+    mutable mutex mu;
+    Table table GUARDED_BY(mu);
+    // While the shard grows, the buckets it grows from. Buckets below
+    // `num_migrated` have been moved into `table`. A key that is in both
+    // tables has its current value in `table`.
+    Table old_table GUARDED_BY(mu);
+    int64 num_migrated GUARDED_BY(mu) = 0;
+    // Number of distinct keys in `table` and `old_table`.
+    int64 num_entries GUARDED_BY(mu) = 0;
+  };
+
+  // The keys of a batch, grouped by shard.
+  struct Batch {
+    // hashes[i] is the hash of key i.
+    std::vector<uint64> hashes;
+    // The indices of the keys of shard s are
+    // order[shard_begin[s], shard_begin[s + 1]).
+    std::vector<int64> order;
+    std::vector<int64> shard_begin;
+  };
+
+  static constexpr int kNumShardBits = 4;
+  static constexpr int kNumShards = 1 << kNumShardBits;
+  static constexpr int64 kMinShardBuckets = 4;
+  // Number of old buckets moved into the new buckets of a growing shard for
+  // every key inserted into the shard.
+  static constexpr int64 kMigrationStep = 8;
+
+  // HashScalar() of an integral key is the key itself, so the hash is mixed
+  // before its top bits pick the shard, while its low bits pick the bucket.
+  static int ShardOf(uint64 hash) {
+    return (hash * 0x9E3779B97F4A7C15ULL) >> (64 - kNumShardBits);
+  }
+
+  uint64 HashKey(const K* key) const {
+    if (key_size_ == 1) {
+      return HashScalar(key[0]);
+    }
+    uint64 result = 0;
+    for (int64 i = 0; i < key_size_; ++i) {
+      result = Hash64Combine(result, HashScalar(key[i]));
+    }
+    return result;
+  }
+
+  bool IsEqualKey(const K* key1, const K* key2) const {
+    for (int64 i = 0; i < key_size_; ++i) {
+      if (key1[i] != key2[i]) {
+        return false;
       }
-      int64 bucket_index = key_hash & bit_mask;
-      int64 num_probes = 0;
-      while (true) {
-        if (IsEqualKey(key_buckets_matrix, bucket_index, key_matrix, i)) {
-          for (int64 j = 0; j < value_size; ++j) {
-            value_buckets_matrix(bucket_index, j) =
-                SubtleMustCopyIfIntegral(value_matrix(i, j));
-          }
-          break;
-        }
-        if (IsEqualKey(key_buckets_matrix, bucket_index, empty_key_tensor, 0)) {
-          ++num_entries_;
-          for (int64 j = 0; j < key_size; ++j) {
-            key_buckets_matrix(bucket_index, j) =
-                SubtleMustCopyIfIntegral(key_matrix(i, j));
-          }
-          for (int64 j = 0; j < value_size; ++j) {
-            value_buckets_matrix(bucket_index, j) =
-                SubtleMustCopyIfIntegral(value_matrix(i, j));
-          }
-          break;
-        }
-        ++num_probes;
-        bucket_index =
-            (bucket_index + num_probes) & bit_mask;  // quadratic probing
-        if (num_probes >= num_buckets_) {
-          return errors::Internal(
-              "Internal error in MutableDenseHashTable insert");
+    }
+    return true;
+  }
+
+  Table MakeTable(const Tensor& keys, const Tensor& values) const {
+    Table table;
+    table.num_buckets = keys.dim_size(0);
+    table.keys = keys;
+    table.values = values;
+    table.key_data = table.keys.template flat<K>().data();
+    table.value_data = table.values.template flat<V>().data();
+    for (int64 i = 0; i < table.num_buckets; ++i) {
+      for (int64 j = 0; j < key_size_; ++j) {
+        table.key_data[i * key_size_ + j] = empty_key_data_[j];
+      }
+      for (int64 j = 0; j < value_size_; ++j) {
+        // Initialize values to the default value for the type to avoid
+        // exposing uninitialized memory in ExportValues().
+        table.value_data[i * value_size_ + j] = V();
+      }
+    }
+    return table;
+  }
+
+  Table NewTable(int64 num_buckets) const {
+    return MakeTable(
+        Tensor(key_dtype(), TensorShape({num_buckets, key_size_})),
+        Tensor(value_dtype(), TensorShape({num_buckets, value_size_})));
+  }
+
+  // Hashes the `n` keys of `keys` and groups them by shard. Returns an error
+  // if one of them is the empty key, unless `ignore_empty_key`, in which case
+  // it is left out of the batch.
+  Status GroupByShard(const K* keys, int64 n, bool ignore_empty_key,
+                      Batch* batch) const {
+    batch->hashes.resize(n);
+    batch->shard_begin.assign(kNumShards + 1, 0);
+    std::vector<int> shards(n);
+    for (int64 i = 0; i < n; ++i) {
+      const K* key = keys + i * key_size_;
+      batch->hashes[i] = HashKey(key);
+      if (batch->hashes[i] == empty_key_hash_ &&
+          IsEqualKey(key, empty_key_data_)) {
+        if (!ignore_empty_key) {
+          return errors::InvalidArgument(
+              "Using the empty_key as a table key is not allowed");
         }
+        shards[i] = -1;
+        continue;
+      }
+      shards[i] = ShardOf(batch->hashes[i]);
+      ++batch->shard_begin[shards[i] + 1];
+    }
+    for (int s = 0; s < kNumShards; ++s) {
+      batch->shard_begin[s + 1] += batch->shard_begin[s];
+    }
+    std::vector<int64> next(batch->shard_begin.begin(),
+                            batch->shard_begin.end() - 1);
+    batch->order.resize(batch->shard_begin[kNumShards]);
+    for (int64 i = 0; i < n; ++i) {
+      if (shards[i] >= 0) {
+        batch->order[next[shards[i]]++] = i;
       }
     }
     return Status::OK();
   }
 
-  Status AllocateBuckets(OpKernelContext* ctx, int64 new_num_buckets)
-      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-    if (new_num_buckets < 4 ||
-        ((new_num_buckets & (new_num_buckets - 1)) != 0)) {
-      return errors::InvalidArgument(
-          "Number of buckets must be at least 4 and a power of 2, got: ",
-          new_num_buckets);
+  // Looks for `key`, whose hash is `hash`, in `table`. Sets `*found` to
+  // whether it is there, and `*bucket` to its bucket if it is, or otherwise
+  // to the empty bucket that ends its probe sequence.
+  Status Probe(const Table& table, const K* key, uint64 hash, bool* found,
+               int64* bucket) const {
+    const int64 bit_mask = table.num_buckets - 1;
+    int64 bucket_index = hash & bit_mask;
+    int64 num_probes = 0;
+    while (true) {
+      const K* bucket_key = table.key_data + bucket_index * key_size_;
+      if (IsEqualKey(bucket_key, key)) {
+        *found = true;
+        *bucket = bucket_index;
+        return Status::OK();
+      }
+      if (IsEqualKey(bucket_key, empty_key_data_)) {
+        *found = false;
+        *bucket = bucket_index;
+        return Status::OK();
+      }
+      ++num_probes;
+      bucket_index =
+          (bucket_index + num_probes) & bit_mask;  // quadratic probing
+      if (num_probes >= table.num_buckets) {
+        return errors::Internal("Internal error in MutableDenseHashTable");
+      }
     }
-    num_buckets_ = new_num_buckets;
-    num_entries_ = 0;
+  }
 
-    const int64 key_size = key_shape_.num_elements();
-    Tensor* key_buckets_tensor;
-    TF_RETURN_IF_ERROR(ctx->allocate_persistent(
-        key_dtype(), TensorShape({num_buckets_, key_size}), &key_buckets_,
-        &key_buckets_tensor));
-    auto key_buckets_matrix = key_buckets_tensor->matrix<K>();
-    const auto empty_key_flat =
-        empty_key_.AccessTensor(ctx)->template flat<K>();
-    for (int64 i = 0; i < num_buckets_; ++i) {
-      for (int64 j = 0; j < key_size; ++j) {
-        key_buckets_matrix(i, j) = empty_key_flat(j);
+  // Sets `*value` to the value of `key` in `shard`, or nullptr if `key` is
+  // not in `shard`.
+  Status FindLocked(const Shard& shard, const K* key, uint64 hash,
+                    const V** value) const SHARED_LOCKS_REQUIRED(shard.mu) {
+    bool found;
+    int64 bucket;
+    TF_RETURN_IF_ERROR(Probe(shard.table, key, hash, &found, &bucket));
+    if (found) {
+      *value = shard.table.value_data + bucket * value_size_;
+      return Status::OK();
+    }
+    if (shard.old_table.num_buckets > 0) {
+      TF_RETURN_IF_ERROR(Probe(shard.old_table, key, hash, &found, &bucket));
+      if (found) {
+        *value = shard.old_table.value_data + bucket * value_size_;
+        return Status::OK();
       }
     }
+    *value = nullptr;
+    return Status::OK();
+  }
 
-    const int64 value_size = value_shape_.num_elements();
-    Tensor* value_buckets_tensor;
-    TF_RETURN_IF_ERROR(ctx->allocate_persistent(
-        value_dtype(), TensorShape({num_buckets_, value_size}), &value_buckets_,
-        &value_buckets_tensor));
-    auto value_buckets_matrix = value_buckets_tensor->matrix<V>();
-    for (int64 i = 0; i < num_buckets_; ++i) {
-      for (int64 j = 0; j < value_size; ++j) {
-        // Initialize values to the default value for the type to avoid
-        // exposing uninitialized memory in ExportValues().
-        value_buckets_matrix(i, j) = V();
+  // Inserts the keys of shard `s` of `batch` into `shard`.
+  Status InsertLocked(const K* keys, const V* values, const Batch& batch,
+                      int s, Shard* shard) EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    const int64 begin = batch.shard_begin[s];
+    const int64 end = batch.shard_begin[s + 1];
+    TF_RETURN_IF_ERROR(ReserveLocked(shard->num_entries + end - begin, shard));
+    for (int64 j = begin; j < end; ++j) {
+      const int64 i = batch.order[j];
+      const K* key = keys + i * key_size_;
+      const uint64 hash = batch.hashes[i];
+      bool found;
+      int64 bucket;
+      TF_RETURN_IF_ERROR(Probe(shard->table, key, hash, &found, &bucket));
+      if (!found) {
+        bool in_old_table = false;
+        if (shard->old_table.num_buckets > 0) {
+          int64 old_bucket;
+          TF_RETURN_IF_ERROR(Probe(shard->old_table, key, hash, &in_old_table,
+                                   &old_bucket));
+        }
+        if (!in_old_table) {
+          ++shard->num_entries;
+          ++num_entries_;
+        }
+        K* bucket_key = shard->table.key_data + bucket * key_size_;
+        for (int64 k = 0; k < key_size_; ++k) {
+          bucket_key[k] = SubtleMustCopyIfIntegral(key[k]);
+        }
       }
+      const V* value = values + i * value_size_;
+      V* bucket_value = shard->table.value_data + bucket * value_size_;
+      for (int64 k = 0; k < value_size_; ++k) {
+        bucket_value[k] = SubtleMustCopyIfIntegral(value[k]);
+      }
+    }
+    return MigrateLocked(kMigrationStep * (end - begin), shard);
+  }
+
+  // Makes room for `num_entries` entries in `shard`. If the shard has to
+  // grow, it gets new buckets, and its current buckets become its old
+  // buckets.
+  Status ReserveLocked(int64 num_entries, Shard* shard)
+      EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    if (num_entries <= shard->table.num_buckets * max_load_factor_) {
+      return Status::OK();
     }
+    // Only one set of old buckets is kept, so a shard that grows again
+    // before it has moved all of them finishes moving them first.
+    TF_RETURN_IF_ERROR(MigrateLocked(kint64max, shard));
+    int64 num_buckets = shard->table.num_buckets;
+    do {
+      num_buckets <<= 1;
+    } while (num_entries > num_buckets * max_load_factor_);
+    shard->old_table = std::move(shard->table);
+    shard->num_migrated = 0;
+    shard->table = NewTable(num_buckets);
     return Status::OK();
   }
 
-  Status Rebucket(OpKernelContext* ctx, int64 num_new_buckets)
-      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-    Tensor old_key_buckets = *key_buckets_.AccessTensor(ctx);
-    Tensor old_value_buckets = *value_buckets_.AccessTensor(ctx);
-    TF_RETURN_IF_ERROR(AllocateBuckets(ctx, num_new_buckets));
-    return DoInsert(ctx, old_key_buckets, old_value_buckets, true);
+  // Moves up to `num_buckets` old buckets of `shard` into its buckets.
+  Status MigrateLocked(int64 num_buckets, Shard* shard)
+      EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    const Table& old_table = shard->old_table;
+    if (old_table.num_buckets == 0) {
+      return Status::OK();
+    }
+    const int64 end =
+        num_buckets >= old_table.num_buckets - shard->num_migrated
+            ? old_table.num_buckets
+            : shard->num_migrated + num_buckets;
+    for (int64 i = shard->num_migrated; i < end; ++i) {
+      TF_RETURN_IF_ERROR(Place(old_table, i, &shard->table));
+    }
+    shard->num_migrated = end;
+    if (end == old_table.num_buckets) {
+      shard->old_table = Table();
+    }
+    return Status::OK();
   }
 
-  uint64 HashKey(typename TTypes<K>::ConstMatrix key, int64 index) const {
-    if (key_shape_.num_elements() == 1) {
-      return HashScalar(key(index, 0));
+  // Copies bucket `i` of `source` into `target`, unless it is empty or its
+  // key is already in `target`.
+  Status Place(const Table& source, int64 i, Table* target) const {
+    const K* key = source.key_data + i * key_size_;
+    if (IsEqualKey(key, empty_key_data_)) {
+      return Status::OK();
     }
-    uint64 result = 0;
-    for (int64 i = 0; i < key_shape_.num_elements(); ++i) {
-      result = Hash64Combine(result, HashScalar(key(index, i)));
+    bool found;
+    int64 bucket;
+    TF_RETURN_IF_ERROR(Probe(*target, key, HashKey(key), &found, &bucket));
+    if (found) {
+      return Status::OK();
     }
-    return result;
+    std::copy(key, key + key_size_, target->key_data + bucket * key_size_);
+    const V* value = source.value_data + i * value_size_;
+    std::copy(value, value + value_size_,
+              target->value_data + bucket * value_size_);
+    return Status::OK();
   }
 
-  // Use a template to allow this function to be used both with Matrix and
-  // ConstMatrix types.
-  template <typename MT2>
-  bool IsEqualKey(typename TTypes<K>::Matrix tensor1, int64 index1, MT2 tensor2,
-                  int64 index2) const {
-    for (int64 i = 0; i < key_shape_.num_elements(); ++i) {
-      if (tensor1(index1, i) != tensor2(index2, i)) {
-        return false;
+  // Copies the entries of `shard` into the first shard.num_entries buckets
+  // of `snapshot`.
+  Status SnapshotLocked(const Shard& shard, Table* snapshot) const
+      SHARED_LOCKS_REQUIRED(shard.mu) {
+    *snapshot = NewTable(shard.num_entries);
+    int64 n = 0;
+    auto copy = [this, &n, snapshot](const Table& table, int64 i) {
+      const K* key = table.key_data + i * key_size_;
+      std::copy(key, key + key_size_, snapshot->key_data + n * key_size_);
+      const V* value = table.value_data + i * value_size_;
+      std::copy(value, value + value_size_,
+                snapshot->value_data + n * value_size_);
+      ++n;
+    };
+    for (int64 i = 0; i < shard.table.num_buckets; ++i) {
+      if (!IsEqualKey(shard.table.key_data + i * key_size_, empty_key_data_)) {
+        if (n == shard.num_entries) break;
+        copy(shard.table, i);
       }
     }
-    return true;
+    // The old buckets that have not been moved yet, unless their key has
+    // been inserted again since.
+    for (int64 i = shard.num_migrated; i < shard.old_table.num_buckets; ++i) {
+      const K* key = shard.old_table.key_data + i * key_size_;
+      if (IsEqualKey(key, empty_key_data_)) continue;
+      bool found;
+      int64 bucket;
+      TF_RETURN_IF_ERROR(
+          Probe(shard.table, key, HashKey(key), &found, &bucket));
+      if (!found) {
+        if (n == shard.num_entries) break;
+        copy(shard.old_table, i);
+      }
+    }
+    if (n != shard.num_entries) {
+      return errors::Internal("MutableDenseHashTable has ", n,
+                              " entries in a shard instead of ",
+                              shard.num_entries);
+    }
+    return Status::OK();
   }
 
   TensorShape key_shape_;
   TensorShape value_shape_;
+  int64 key_size_;
+  int64 value_size_;
   float max_load_factor_;
-  mutable mutex mu_;
-  int64 num_entries_ GUARDED_BY(mu_);
-  int64 num_buckets_ GUARDED_BY(mu_);
-  PersistentTensor key_buckets_ GUARDED_BY(mu_);
-  PersistentTensor value_buckets_ GUARDED_BY(mu_);
-  PersistentTensor empty_key_;
+  Tensor empty_key_;
+  const K* empty_key_data_;
   uint64 empty_key_hash_;
+  // Number of entries of all the shards.
+  std::atomic<int64> num_entries_{0};
+  // Number of buckets of the exported table, which grows as the buckets of an
+  // unsharded table would.
+  std::atomic<int64> num_buckets_{0};
+  Shard shards_[kNumShards];
 };
 
 }  // namespace lookup
@@ -16,12 +16,15 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_LOOKUP_TABLE_OP_H_
 #define TENSORFLOW_CORE_KERNELS_LOOKUP_TABLE_OP_H_
 
+#include <algorithm>
+
 #include "tensorflow/core/framework/lookup_interface.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/kernels/flat_lookup_map.h"
 #include "tensorflow/core/kernels/lookup_util.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
@@ -146,7 +149,7 @@ inline const Variant& SubtleMustCopyIfIntegral(const Variant& value) {
   return value;
 }
 
-// Lookup table that wraps an unordered_map, where the key and value data type
+// Lookup table that wraps a FlatLookupMap, where the key and value data type
 // is specified.
 //
 // This table is recommended for any variations to key values.
@@ -157,8 +160,8 @@ inline const Variant& SubtleMustCopyIfIntegral(const Variant& value) {
 // Sample use case:
 //
 // HashTable<int64, int64> table;  // int64 -> int64.
-// table.Prepare(10); // Prepare the underlying data structure, the number of
-//                    // elements is required by interface, but not used.
+// table.Prepare(10); // Prepare the underlying data structure for the given
+//                    // number of elements.
 // // Populate the table, elements could be added in one or multiple calls.
 // table.Insert(key_tensor, value_tensor); // Populate the table.
 // ...
@@ -196,10 +199,9 @@ class HashTable : public InitializableLookupTable {
 
     auto keys_data = keys->flat<K>();
     auto values_data = values->flat<V>();
-    int64 i = 0;
-    for (auto it = table_->begin(); it != table_->end(); ++it, ++i) {
-      keys_data(i) = it->first;
-      values_data(i) = it->second;
+    for (int64 i = 0; i < size; ++i) {
+      keys_data(i) = K(table_->key(i));
+      values_data(i) = table_->value(i);
     }
     return Status::OK();
   }
@@ -209,17 +211,20 @@ class HashTable : public InitializableLookupTable {
   DataType value_dtype() const override { return DataTypeToEnum<V>::v(); }
 
  protected:
-  Status DoPrepare(size_t unused) override {
+  Status DoPrepare(size_t expected_num_elements) override {
     if (is_initialized_) {
       return errors::Aborted("HashTable already initialized.");
     }
     if (!table_) {
-      table_ = std::unique_ptr<std::unordered_map<K, V>>(
-          new std::unordered_map<K, V>());
+      table_.reset(new FlatLookupMap<K, V>());
     }
+    table_->Reserve(expected_num_elements);
     return Status::OK();
   };
 
+  // The size is only a hint for Reserve(), which is not worth reading a
+  // whole text file of unknown vocab_size to count its lines, so the table
+  // grows as it is filled instead.
   Status DoLazyPrepare(std::function<int64(void)> unused) override {
     constexpr size_t kUnusedSize = 0;
     return DoPrepare(kUnusedSize);
@@ -233,9 +238,9 @@ class HashTable : public InitializableLookupTable {
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat<V>();
     for (int64 i = 0; i < key_values.size(); ++i) {
-      const K key = SubtleMustCopyIfIntegral(key_values(i));
+      const K& key = SubtleMustCopyIfIntegral(key_values(i));
       const V value = SubtleMustCopyIfIntegral(value_values(i));
-      const V& previous_value = gtl::LookupOrInsert(table_.get(), key, value);
+      const V& previous_value = *table_->Insert(key, value).first;
       if (previous_value != value) {
         return errors::FailedPrecondition(
             "HashTable has different value for same key. Key ", key, " has ",
@@ -251,24 +256,23 @@ class HashTable : public InitializableLookupTable {
     const auto key_values = key.flat<K>();
     auto value_values = value->flat<V>();
 
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      value_values(i) = gtl::FindWithDefault(
-          *table_, SubtleMustCopyIfIntegral(key_values(i)), default_val);
-    }
+    // The table is not modified once it is initialized, so lookups from many
+    // threads run without any lock.
+    table_->FindBatch(key_values.data(), key_values.size(), default_val,
+                      value_values.data());
     return Status::OK();
   }
 
   int64 MemoryUsed() const override {
     if (table_) {
-      const int64 num_elements = table_->size();
-      return num_elements * (sizeof(K) + sizeof(V));
+      return table_->MemoryUsed();
     } else {
       return 0;
     }
   }
 
  private:
-  std::unique_ptr<std::unordered_map<K, V>> table_;
+  std::unique_ptr<FlatLookupMap<K, V>> table_;
 };
 
 }  // namespace lookup
@@ -0,0 +1,215 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/lookup_interface.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/resource_handle.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class MutableDenseHashTableOpTest : public OpsTestBase {
+ protected:
+  ~MutableDenseHashTableOpTest() override {
+    for (lookup::LookupInterface* table : tables_) table->Unref();
+  }
+
+  // Creates an int64 -> int64 table with the empty key 0. The table is
+  // shared, so it outlives the kernel that creates it.
+  lookup::LookupInterface* MakeTable(int64 initial_num_buckets) {
+    const string shared_name = strings::StrCat("table", tables_.size());
+    TF_CHECK_OK(NodeDefBuilder("table", "MutableDenseHashTableV2")
+                    .Input(FakeInput(DT_INT64))
+                    .Attr("shared_name", shared_name)
+                    .Attr("key_dtype", DT_INT64)
+                    .Attr("value_dtype", DT_INT64)
+                    .Attr("initial_num_buckets", initial_num_buckets)
+                    .Finalize(node_def()));
+    inputs_.clear();
+    TF_CHECK_OK(InitOp());
+    AddInputFromArray<int64>(TensorShape({}), {0});
+    TF_CHECK_OK(RunOpKernel());
+    const ResourceHandle handle = GetOutput(0)->scalar<ResourceHandle>()();
+    lookup::LookupInterface* table;
+    TF_CHECK_OK(device_->resource_manager()->Lookup(handle.container(),
+                                                     handle.name(), &table));
+    tables_.push_back(table);
+    handles_.push_back(handle);
+    return table;
+  }
+
+  Status Insert(lookup::LookupInterface* table, const std::vector<int64>& keys,
+                const std::vector<int64>& values) {
+    return table->Insert(context_.get(), test::AsTensor<int64>(keys),
+                         test::AsTensor<int64>(values));
+  }
+
+  std::vector<int64> Find(lookup::LookupInterface* table,
+                          const std::vector<int64>& keys) {
+    Tensor values(DT_INT64, TensorShape({static_cast<int64>(keys.size())}));
+    TF_CHECK_OK(table->Find(context_.get(), test::AsTensor<int64>(keys),
+                            &values, test::AsScalar<int64>(-1)));
+    const auto flat = values.flat<int64>();
+    return std::vector<int64>(flat.data(), flat.data() + flat.size());
+  }
+
+  // Exports the table with the given handle with the LookupTableExportV2
+  // kernel.
+  void Export(const ResourceHandle& handle, Tensor* keys, Tensor* values) {
+    TF_CHECK_OK(NodeDefBuilder("export", "LookupTableExportV2")
+                    .Input(FakeInput(DT_RESOURCE))
+                    .Attr("Tkeys", DT_INT64)
+                    .Attr("Tvalues", DT_INT64)
+                    .Finalize(node_def()));
+    inputs_.clear();
+    TF_CHECK_OK(InitOp());
+    AddInputFromArray<ResourceHandle>(TensorShape({}), {handle});
+    TF_CHECK_OK(RunOpKernel());
+    *keys = *GetOutput(0);
+    *values = *GetOutput(1);
+  }
+
+  std::vector<lookup::LookupInterface*> tables_;
+  std::vector<ResourceHandle> handles_;
+};
+
+TEST_F(MutableDenseHashTableOpTest, GrowsWhileInserting) {
+  lookup::LookupInterface* table = MakeTable(4);
+  // Small batches make the shards grow many times, and insert keys while
+  // their old buckets are being moved.
+  for (int64 start = 1; start <= 5000; start += 25) {
+    std::vector<int64> keys;
+    std::vector<int64> values;
+    for (int64 key = start; key < start + 25; ++key) {
+      keys.push_back(key);
+      values.push_back(key * 10);
+    }
+    TF_ASSERT_OK(Insert(table, keys, values));
+    // Updates keys inserted by previous batches.
+    if (start > 100) {
+      TF_ASSERT_OK(Insert(table, {start - 100}, {-(start - 100)}));
+    }
+    ASSERT_EQ(start + 24, table->size());
+  }
+
+  std::vector<int64> keys;
+  std::vector<int64> expected;
+  for (int64 key = 1; key <= 5010; ++key) {
+    keys.push_back(key);
+    if (key > 5000) {
+      expected.push_back(-1);
+    } else if (key <= 4876 && (key - 1) % 25 == 0) {
+      expected.push_back(-key);
+    } else {
+      expected.push_back(key * 10);
+    }
+  }
+  EXPECT_EQ(expected, Find(table, keys));
+
+  // Inserting or looking up the empty key fails.
+  EXPECT_TRUE(errors::IsInvalidArgument(Insert(table, {7, 0}, {1, 2})));
+  Tensor values(DT_INT64, TensorShape({1}));
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      table->Find(context_.get(), test::AsTensor<int64>({0}), &values,
+                  test::AsScalar<int64>(-1))));
+}
+
+TEST_F(MutableDenseHashTableOpTest, ExportsUnshardedLayout) {
+  lookup::LookupInterface* table = MakeTable(8);
+  std::vector<int64> keys;
+  for (int64 key = 1; key <= 1000; ++key) keys.push_back(key * 7919);
+  TF_ASSERT_OK(Insert(table, keys, keys));
+
+  Tensor exported_keys;
+  Tensor exported_values;
+  Export(handles_[0], &exported_keys, &exported_values);
+  // The table grows as an unsharded table would: 1000 entries need 2048
+  // buckets with a load factor of 0.8.
+  ASSERT_EQ(2048, exported_keys.dim_size(0));
+  ASSERT_EQ(1, exported_keys.dim_size(1));
+  const auto key_buckets = exported_keys.flat<int64>();
+  const auto value_buckets = exported_values.flat<int64>();
+  int num_entries = 0;
+  for (int64 i = 0; i < key_buckets.size(); ++i) {
+    if (key_buckets(i) != 0) {
+      ++num_entries;
+      EXPECT_EQ(key_buckets(i), value_buckets(i));
+      // Keys are in their bucket, or further along its probe sequence.
+      int64 bucket = key_buckets(i) & 2047;
+      for (int64 probe = 1; bucket != i; ++probe) {
+        ASSERT_NE(0, key_buckets(bucket));
+        ASSERT_LT(probe, 2048);
+        bucket = (bucket + probe) & 2047;
+      }
+    } else {
+      EXPECT_EQ(0, value_buckets(i));
+    }
+  }
+  EXPECT_EQ(1000, num_entries);
+
+  // The exported buckets restore the table into any table.
+  lookup::LookupInterface* restored = MakeTable(64);
+  TF_ASSERT_OK(Insert(restored, {1, 2}, {3, 4}));
+  TF_ASSERT_OK(
+      restored->ImportValues(context_.get(), exported_keys, exported_values));
+  EXPECT_EQ(1000, restored->size());
+  EXPECT_EQ(keys, Find(restored, keys));
+  EXPECT_EQ(std::vector<int64>({-1, -1}), Find(restored, {1, 2}));
+  Tensor restored_keys;
+  Tensor restored_values;
+  Export(handles_[1], &restored_keys, &restored_values);
+  EXPECT_EQ(2048, restored_keys.dim_size(0));
+}
+
+TEST_F(MutableDenseHashTableOpTest, ConcurrentInsertsAndLookups) {
+  lookup::LookupInterface* table = MakeTable(4);
+  constexpr int kNumThreads = 8;
+  constexpr int kKeysPerThread = 2000;
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([this, table, t]() {
+        for (int64 i = 0; i < kKeysPerThread; i += 10) {
+          std::vector<int64> keys;
+          for (int64 j = i; j < i + 10; ++j) {
+            keys.push_back(t * kKeysPerThread + j + 1);
+          }
+          TF_CHECK_OK(Insert(table, keys, keys));
+          CHECK(Find(table, keys) == keys);
+        }
+      });
+    }
+  }
+  EXPECT_EQ(kNumThreads * kKeysPerThread, table->size());
+  std::vector<int64> keys;
+  for (int64 key = 1; key <= kNumThreads * kKeysPerThread; ++key) {
+    keys.push_back(key);
+  }
+  EXPECT_EQ(keys, Find(table, keys));
+}
+
+}  // namespace
+}  // namespace tensorflow
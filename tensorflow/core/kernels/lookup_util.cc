@@ -174,6 +174,8 @@ class TextFileLineIterator
     return vocab_size_;
   }
 
+  int64 known_total_size() const override { return vocab_size_; }
+
  private:
   Tensor key_;
   Tensor value_;
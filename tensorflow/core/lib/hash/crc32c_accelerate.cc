@@ -57,7 +57,107 @@ uint32_t AcceleratedExtend(uint32_t crc, const char *buf, size_t size) {
 // SSE4.2 optimized crc32c computation.
 bool CanAccelerate() { return __builtin_cpu_supports("sse4.2"); }
 
+namespace {
+
+// The crc32 instruction has a latency of three cycles, but a throughput of
+// one per cycle. Long buffers are therefore split into three streams whose
+// CRCs are computed concurrently and then combined. Combining requires
+// shifting a CRC past the bytes of the streams that follow it, which is a
+// linear operator over GF(2); it is applied with one lookup per byte of the
+// CRC.
+static const size_t kLongStream = 8192;
+static const size_t kShortStream = 256;
+
+// The reversed CRC-32C polynomial.
+static const uint32_t kPolynomial = 0x82f63b78;
+
+// Returns mat * vec over GF(2), where the columns of mat are mat[0..31].
+uint32_t MatrixTimes(const uint32_t *mat, uint32_t vec) {
+  uint32_t sum = 0;
+  while (vec) {
+    if (vec & 1) sum ^= *mat;
+    vec >>= 1;
+    mat++;
+  }
+  return sum;
+}
+
+void MatrixSquare(uint32_t *square, const uint32_t *mat) {
+  for (int n = 0; n < 32; n++) square[n] = MatrixTimes(mat, mat[n]);
+}
+
+// Tables that shift a CRC past `len` zero bytes, where `len` is a power of
+// two.
+struct ShiftTable {
+  explicit ShiftTable(size_t len) {
+    uint32_t even[32];
+    uint32_t odd[32];
+    // The operator for one zero bit.
+    odd[0] = kPolynomial;
+    uint32_t row = 1;
+    for (int n = 1; n < 32; n++) {
+      odd[n] = row;
+      row <<= 1;
+    }
+    MatrixSquare(even, odd);  // Two zero bits.
+    MatrixSquare(odd, even);  // Four zero bits.
+    // Square until the operator covers `len` bytes.
+    const uint32_t *op = odd;
+    do {
+      MatrixSquare(even, odd);
+      op = even;
+      len >>= 1;
+      if (len == 0) break;
+      MatrixSquare(odd, even);
+      op = odd;
+      len >>= 1;
+    } while (len);
+    for (uint32_t n = 0; n < 256; n++) {
+      table[0][n] = MatrixTimes(op, n);
+      table[1][n] = MatrixTimes(op, n << 8);
+      table[2][n] = MatrixTimes(op, n << 16);
+      table[3][n] = MatrixTimes(op, n << 24);
+    }
+  }
+
+  uint32_t Shift(uint32_t crc) const {
+    return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^
+           table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+  }
+
+  uint32_t table[4][256];
+};
+
+// Computes the CRC of as many groups of three streams of `stream` bytes as
+// fit in [*p, e), starting from `crc`.
+inline uint64_t ExtendStreams(uint64_t crc, const uint8_t **p,
+                              const uint8_t *e, size_t stream,
+                              const ShiftTable &shift) {
+  while (static_cast<size_t>(e - *p) >= 3 * stream) {
+    uint64_t crc1 = 0;
+    uint64_t crc2 = 0;
+    const uint8_t *end = *p + stream;
+    do {
+      crc = _mm_crc32_u64(crc, *reinterpret_cast<const uint64_t *>(*p));
+      crc1 = _mm_crc32_u64(
+          crc1, *reinterpret_cast<const uint64_t *>(*p + stream));
+      crc2 = _mm_crc32_u64(
+          crc2, *reinterpret_cast<const uint64_t *>(*p + 2 * stream));
+      *p += 8;
+    } while (*p < end);
+    crc = shift.Shift(static_cast<uint32_t>(crc)) ^ crc1;
+    crc = shift.Shift(static_cast<uint32_t>(crc)) ^ crc2;
+    *p += 2 * stream;
+  }
+  return crc;
+}
+
+}  // namespace
+
 uint32_t AcceleratedExtend(uint32_t crc, const char *buf, size_t size) {
+  static const ShiftTable *long_shift = new ShiftTable(kLongStream);
+  static const ShiftTable *short_shift = new ShiftTable(kShortStream);
+
   const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
   const uint8_t *e = p + size;
   uint32_t l = crc ^ 0xffffffffu;
@@ -75,8 +175,12 @@ uint32_t AcceleratedExtend(uint32_t crc, const char *buf, size_t size) {
     }
   }
 
-  // Process bytes 16 at a time
+  // Process three streams at a time, first long ones, then short ones.
   uint64_t l64 = l;
+  l64 = ExtendStreams(l64, &p, e, kLongStream, *long_shift);
+  l64 = ExtendStreams(l64, &p, e, kShortStream, *short_shift);
+
+  // Process bytes 16 at a time
   while ((e - p) >= 16) {
     l64 = _mm_crc32_u64(l64, *reinterpret_cast<const uint64_t *>(p));
     l64 = _mm_crc32_u64(l64, *reinterpret_cast<const uint64_t *>(p + 8));
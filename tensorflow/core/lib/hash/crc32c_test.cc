@@ -14,6 +14,10 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/lib/hash/crc32c.h"
+
+#include <algorithm>
+#include <string>
+
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
@@ -62,6 +66,28 @@ TEST(CRC, Extend) {
   ASSERT_EQ(Value("hello world", 11), Extend(Value("hello ", 6), "world", 5));
 }
 
+TEST(CRC, LongBuffers) {
+  // Long buffers are split into streams whose CRCs are combined; they must
+  // match the CRC computed a few bytes at a time.
+  std::string input(3 * 8192 * 2 + 3 * 256 + 100, '\0');
+  for (size_t i = 0; i < input.size(); i++) {
+    input[i] = static_cast<char>(i * 37 + (i >> 8));
+  }
+  for (size_t offset : {0, 1, 7}) {
+    for (size_t len : {size_t{3 * 256}, size_t{3 * 256 + 13},
+                       size_t{3 * 8192}, size_t{3 * 8192 + 3 * 256 + 5},
+                       input.size() - offset}) {
+      uint32 expected = 0;
+      for (size_t i = 0; i < len; i += 7) {
+        expected = Extend(expected, input.data() + offset + i,
+                          std::min<size_t>(7, len - i));
+      }
+      EXPECT_EQ(expected, Value(input.data() + offset, len))
+          << "offset: " << offset << " len: " << len;
+    }
+  }
+}
+
 TEST(CRC, Mask) {
   uint32 crc = Value("foo", 3);
   ASSERT_NE(crc, Mask(crc));
@@ -152,5 +152,47 @@ SequentialRecordReader::SequentialRecordReader(
     RandomAccessFile* file, const RecordReaderOptions& options)
     : underlying_(file, options), offset_(0) {}
 
+MemoryMappedRecordReader::MemoryMappedRecordReader(
+    std::unique_ptr<ReadOnlyMemoryRegion> region)
+    : region_(std::move(region)),
+      data_(static_cast<const char*>(region_->data())),
+      size_(region_->length()) {}
+
+MemoryMappedRecordReader::~MemoryMappedRecordReader() = default;
+
+Status MemoryMappedRecordReader::VerifyChecksummed(uint64 offset,
+                                                   size_t n) const {
+  const char* data = data_ + offset;
+  const uint32 masked_crc = core::DecodeFixed32(data + n);
+  if (crc32c::Unmask(masked_crc) != crc32c::Value(data, n)) {
+    return errors::DataLoss("corrupted record at ", offset);
+  }
+  return Status::OK();
+}
+
+Status MemoryMappedRecordReader::ReadRecord(StringPiece* record) {
+  static const size_t kHeaderSize = sizeof(uint64) + sizeof(uint32);
+  static const size_t kFooterSize = sizeof(uint32);
+
+  if (offset_ >= size_) {
+    return errors::OutOfRange("eof");
+  }
+  if (size_ - offset_ < kHeaderSize) {
+    return errors::DataLoss("truncated record at ", offset_);
+  }
+  TF_RETURN_IF_ERROR(VerifyChecksummed(offset_, sizeof(uint64)));
+  const uint64 length = core::DecodeFixed64(data_ + offset_);
+
+  if (size_ - offset_ - kHeaderSize < kFooterSize ||
+      size_ - offset_ - kHeaderSize - kFooterSize < length) {
+    return errors::DataLoss("truncated record at ", offset_);
+  }
+  TF_RETURN_IF_ERROR(VerifyChecksummed(offset_ + kHeaderSize, length));
+
+  *record = StringPiece(data_ + offset_ + kHeaderSize, length);
+  offset_ += kHeaderSize + length + kFooterSize;
+  return Status::OK();
+}
+
 }  // namespace io
 }  // namespace tensorflow
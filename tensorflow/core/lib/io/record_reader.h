@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_LIB_IO_RECORD_READER_H_
 #define TENSORFLOW_CORE_LIB_IO_RECORD_READER_H_
 
+#include <memory>
+
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/io/inputstream_interface.h"
@@ -29,6 +31,7 @@ limitations under the License.
 namespace tensorflow {
 
 class RandomAccessFile;
+class ReadOnlyMemoryRegion;
 
 namespace io {
 
@@ -119,6 +122,53 @@ class SequentialRecordReader {
   uint64 offset_ = 0;
 };
 
+// Interface to read uncompressed TFRecord files from a read-only memory
+// mapping of the file, e.g. one returned by
+// Env::NewReadOnlyMemoryRegionFromFile(). The records are not copied: they
+// point into the mapping.
+//
+// The file must not be truncated while it is mapped.
+//
+// Note: this class is not thread safe; external synchronization required.
+class MemoryMappedRecordReader {
+ public:
+  explicit MemoryMappedRecordReader(
+      std::unique_ptr<ReadOnlyMemoryRegion> region);
+
+  ~MemoryMappedRecordReader();
+
+  // Points *record at the next record in the file. The record remains valid
+  // as long as this reader. Returns OK on success, OUT_OF_RANGE for end of
+  // file, or something else for an error.
+  Status ReadRecord(StringPiece* record);
+
+  // Returns the current offset in the file.
+  uint64 TellOffset() { return offset_; }
+
+  // Seek to this offset within the file and set this offset as the current
+  // offset. Trying to seek backward will throw error.
+  Status SeekOffset(uint64 offset) {
+    if (offset < offset_)
+      return errors::InvalidArgument(
+          "Trying to seek offset: ", offset,
+          " which is less than the current offset: ", offset_);
+    offset_ = offset;
+    return Status::OK();
+  }
+
+ private:
+  // Verifies that the checksum of the n bytes at `offset` is stored in the
+  // 4 bytes that follow them.
+  Status VerifyChecksummed(uint64 offset, size_t n) const;
+
+  std::unique_ptr<ReadOnlyMemoryRegion> region_;
+  const char* data_;
+  uint64 size_;
+  uint64 offset_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MemoryMappedRecordReader);
+};
+
 }  // namespace io
 }  // namespace tensorflow
 
@@ -189,6 +189,73 @@ TEST(RecordReaderWriterTest, TestZlib) {
   }
 }
 
+TEST(RecordReaderWriterTest, TestMemoryMapped) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/record_reader_writer_mmap_test";
+  const string long_record(100000, 'x');
+  {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    io::RecordWriter writer(file.get());
+    TF_EXPECT_OK(writer.WriteRecord("abc"));
+    TF_EXPECT_OK(writer.WriteRecord(""));
+    TF_EXPECT_OK(writer.WriteRecord(long_record));
+    TF_CHECK_OK(writer.Close());
+  }
+
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  TF_CHECK_OK(env->NewReadOnlyMemoryRegionFromFile(fname, &region));
+  io::MemoryMappedRecordReader reader(std::move(region));
+  StringPiece record;
+  TF_CHECK_OK(reader.ReadRecord(&record));
+  EXPECT_EQ("abc", record);
+  const uint64 second_offset = reader.TellOffset();
+  TF_CHECK_OK(reader.ReadRecord(&record));
+  EXPECT_EQ("", record);
+  TF_CHECK_OK(reader.ReadRecord(&record));
+  EXPECT_EQ(long_record, record);
+  EXPECT_EQ(GetFileSize(fname), reader.TellOffset());
+  EXPECT_EQ(error::OUT_OF_RANGE, reader.ReadRecord(&record).code());
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            reader.SeekOffset(second_offset).code());
+}
+
+TEST(RecordReaderWriterTest, TestMemoryMappedDataLoss) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/record_reader_writer_mmap_loss_test";
+  string contents;
+  {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    io::RecordWriter writer(file.get());
+    TF_EXPECT_OK(writer.WriteRecord("abcdefgh"));
+    TF_CHECK_OK(writer.Close());
+  }
+  TF_CHECK_OK(ReadFileToString(env, fname, &contents));
+
+  auto read = [env, &fname](const string& data) {
+    TF_CHECK_OK(WriteStringToFile(env, fname, data));
+    std::unique_ptr<ReadOnlyMemoryRegion> region;
+    TF_CHECK_OK(env->NewReadOnlyMemoryRegionFromFile(fname, &region));
+    io::MemoryMappedRecordReader reader(std::move(region));
+    StringPiece record;
+    return reader.ReadRecord(&record);
+  };
+
+  // Corrupted header and data.
+  string corrupted = contents;
+  corrupted[0] ^= 1;
+  EXPECT_EQ(error::DATA_LOSS, read(corrupted).code());
+  corrupted = contents;
+  corrupted[13] ^= 1;
+  EXPECT_EQ(error::DATA_LOSS, read(corrupted).code());
+  // Truncated header and data.
+  EXPECT_EQ(error::DATA_LOSS, read(contents.substr(0, 5)).code());
+  EXPECT_EQ(error::DATA_LOSS,
+            read(contents.substr(0, contents.size() - 1)).code());
+  TF_EXPECT_OK(read(contents));
+}
+
 TEST(RecordReaderWriterTest, TestUseAfterClose) {
   Env* env = Env::Default();
   string fname = testing::TmpDir() + "/record_reader_writer_flush_close_test";
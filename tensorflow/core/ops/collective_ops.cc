@@ -31,6 +31,53 @@ REGISTER_OP("CollectiveReduce")
     .SetIsStateful()
     .SetShapeFn(shape_inference::UnchangedShape);
 
+REGISTER_OP("CollectiveAllGather")
+    .Input("input: T")
+    .Output("data: T")
+    .Attr("T: {float, float16, float64, int32, int64}")
+    .Attr("group_size: int")
+    .Attr("group_key: int")
+    .Attr("instance_key: int")
+    .SetIsStateful()
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      // The inputs are concatenated along the first dimension.
+      shape_inference::ShapeHandle in;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &in));
+      int64 group_size;
+      TF_RETURN_IF_ERROR(c->GetAttr("group_size", &group_size));
+      shape_inference::DimensionHandle dim0;
+      TF_RETURN_IF_ERROR(c->Multiply(c->Dim(in, 0), group_size, &dim0));
+      shape_inference::ShapeHandle out;
+      TF_RETURN_IF_ERROR(c->ReplaceDim(in, 0, dim0, &out));
+      c->set_output(0, out);
+      return Status::OK();
+    });
+
+REGISTER_OP("CollectiveReduceScatter")
+    .Input("input: T")
+    .Output("data: T")
+    .Attr("T: {float, float16, float64, int32, int64}")
+    .Attr("group_size: int")
+    .Attr("group_key: int")
+    .Attr("instance_key: int")
+    .Attr("merge_op: {'Min', 'Max', 'Mul', 'Add'}")
+    .Attr("final_op: {'Id', 'Div'}")
+    .SetIsStateful()
+    .SetShapeFn([](shape_inference::InferenceContext* c) {
+      // Each device gets one shard of the first dimension.
+      shape_inference::ShapeHandle in;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &in));
+      int64 group_size;
+      TF_RETURN_IF_ERROR(c->GetAttr("group_size", &group_size));
+      shape_inference::DimensionHandle dim0;
+      TF_RETURN_IF_ERROR(c->Divide(c->Dim(in, 0), group_size,
+                                   true /*evenly_divisible*/, &dim0));
+      shape_inference::ShapeHandle out;
+      TF_RETURN_IF_ERROR(c->ReplaceDim(in, 0, dim0, &out));
+      c->set_output(0, out);
+      return Status::OK();
+    });
+
 REGISTER_OP("CollectiveBcastSend")
     .Input("input: T")
     .Output("data: T")
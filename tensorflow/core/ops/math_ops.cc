@@ -256,6 +256,25 @@ REGISTER_OP("_UnaryOpsComposition")
 expected to create these operators.
 )doc");
 
+// A fused chain of elementwise ops, which runs op_names[i] for i = 0, 1, ...
+// on operands[2 * i] and operands[2 * i + 1], and outputs the result of the
+// last op. An operand j < N is inputs[j], an operand j >= N is the result of
+// op j - N, and unary ops have -1 as their second operand. inputs[0] has the
+// shape of the output, and the other inputs either have the same shape, or
+// are broadcast along all but the last dimension, or are scalars.
+REGISTER_OP("_FusedElementwise")
+    .Input("inputs: N * T")
+    .Output("y: T")
+    .Attr("T: {float, double}")
+    .Attr("N: int >= 1")
+    .Attr("op_names: list(string)")
+    .Attr("operands: list(int)")
+    .SetShapeFn(shape_inference::UnchangedShape)
+    .Doc(R"doc(
+*NOTE*: Do not invoke this operator directly in Python. Graph rewrite pass is
+expected to create these operators.
+)doc");
+
 #undef UNARY
 #undef UNARY_REAL
 #undef UNARY_COMPLEX
@@ -14,6 +14,10 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
+#include <algorithm>
+#include <bitset>
+#include <numeric>
+#include <unordered_set>
 #include <vector>
 
 #include "tensorflow/core/example/example.pb.h"
@@ -21,15 +25,17 @@ limitations under the License.
 #include "tensorflow/core/framework/numeric_op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/casts.h"
+#include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
-#include "tensorflow/core/util/presized_cuckoo_map.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
 
 namespace tensorflow {
@@ -60,6 +66,164 @@ constexpr uint8 kVarintTag(uint32 tag) { return (tag << 3) | 0; }
 constexpr uint8 kDelimitedTag(uint32 tag) { return (tag << 3) | 2; }
 constexpr uint8 kFixed32Tag(uint32 tag) { return (tag << 3) | 5; }
 
+template <typename T>
+class LimitedArraySlice {
+ public:
+  LimitedArraySlice(T* begin, size_t num_elements)
+      : current_(begin), end_(begin + num_elements) {}
+
+  // May return negative if there were push_back calls after slice was filled.
+  int64 EndDistance() const { return end_ - current_; }
+
+  // Attempts to push value to the back of this. If the slice has
+  // already been filled, this method has no effect on the underlying data, but
+  // it changes the number returned by EndDistance into negative values.
+  void push_back(T&& value) {
+    if (EndDistance() > 0) *current_ = std::move(value);
+    ++current_;
+  }
+
+  // Returns room for `n` values at the back of this, or nullptr if they do
+  // not fit. In both cases, EndDistance changes as after `n` push_back calls.
+  T* Extend(size_t n) {
+    T* begin = current_;
+    current_ += n;
+    return EndDistance() >= 0 ? begin : nullptr;
+  }
+
+ private:
+  T* current_;
+  T* end_;
+};
+
+// Returns room for `n` more values at the back of `list`, or nullptr if they
+// do not fit in it. The values are then written in place, without going
+// through push_back.
+template <typename T>
+T* ExtendBy(SmallVector<T>* list, size_t n) {
+  const size_t size = list->size();
+  list->resize(size + n);
+  return list->data() + size;
+}
+
+template <typename T>
+T* ExtendBy(LimitedArraySlice<T>* list, size_t n) {
+  return list->Extend(n);
+}
+
+// Copies the `n` little-endian floats at `data` to `out`.
+void CopyLittleEndianFloats(const char* data, size_t n, float* out) {
+  if (port::kLittleEndian) {
+    memcpy(out, data, n * sizeof(float));
+  } else {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = bit_cast<float>(core::DecodeFixed32(data + i * sizeof(float)));
+    }
+  }
+}
+
+constexpr uint64 kContinuationBits = 0x8080808080808080ULL;
+
+// Returns the number of varints in the packed buffer [begin, end), i.e. the
+// number of its bytes without a continuation bit.
+size_t CountPackedVarints(const uint8* begin, const uint8* end) {
+  size_t count = 0;
+  const uint8* p = begin;
+  for (; end - p >= 8; p += 8) {
+    uint64 word;
+    memcpy(&word, p, sizeof(word));
+    count += 8 - std::bitset<64>(word & kContinuationBits).count();
+  }
+  for (; p < end; ++p) {
+    count += (*p & 0x80) == 0;
+  }
+  return count;
+}
+
+// Decodes the packed varints in [begin, end) into `out`, which has room for
+// CountPackedVarints(begin, end) values. Returns false if a varint is longer
+// than 10 bytes or is cut off by `end`.
+bool DecodePackedVarints(const uint8* begin, const uint8* end, int64* out) {
+  const uint8* p = begin;
+  while (p < end) {
+    if (port::kLittleEndian && end - p >= 8) {
+      uint64 word;
+      memcpy(&word, p, sizeof(word));
+      const uint64 last_bytes = ~word & kContinuationBits;
+      if (last_bytes == kContinuationBits) {
+        // Small values, e.g. lengths, booleans and small ids, often come in
+        // runs of 1-byte varints, which are widened 8 at a time.
+        for (int i = 0; i < 8; ++i) {
+          out[i] = p[i];
+        }
+        out += 8;
+        p += 8;
+        continue;
+      }
+      if (last_bytes != 0) {
+        // The next varint has at most 8 bytes: gather its 7-bit groups
+        // within `word`, pairwise, then 4 by 4, then 8 by 8.
+        const int length = (Log2Floor64(last_bytes & -last_bytes) >> 3) + 1;
+        uint64 x = word & 0x7f7f7f7f7f7f7f7fULL;
+        if (length < 8) x &= (uint64{1} << (8 * length)) - 1;
+        x = ((x & 0x7f007f007f007f00ULL) >> 1) | (x & 0x007f007f007f007fULL);
+        x = ((x & 0x3fff00003fff0000ULL) >> 2) | (x & 0x00003fff00003fffULL);
+        x = ((x & 0x0fffffff00000000ULL) >> 4) | (x & 0x000000000fffffffULL);
+        *out++ = static_cast<int64>(x);
+        p += length;
+        continue;
+      }
+    }
+    uint64 value = 0;
+    for (int shift = 0;; shift += 7) {
+      if (p == end || shift >= 64) return false;
+      const uint8 byte = *p++;
+      value |= static_cast<uint64>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) break;
+    }
+    *out++ = static_cast<int64>(value);
+  }
+  return true;
+}
+
+bool ParseString(protobuf::io::CodedInputStream* stream, StringPiece* result) {
+  DCHECK(stream != nullptr);
+  DCHECK(result != nullptr);
+  uint32 length;
+  if (!stream->ReadVarint32(&length)) return false;
+  if (length == 0) {
+    *result = StringPiece(nullptr, 0);
+    return true;
+  }
+  const void* stream_alias;
+  int stream_size;
+  if (!stream->GetDirectBufferPointer(&stream_alias, &stream_size)) {
+    return false;
+  }
+  if (static_cast<uint32>(stream_size) < length) return false;
+  *result = StringPiece(static_cast<const char*>(stream_alias), length);
+  stream->Skip(length);
+  return true;
+}
+
+// Reads the `length` bytes of a packed repeated field into `result`, which
+// aliases the buffer of `stream`.
+bool ReadPacked(protobuf::io::CodedInputStream* stream, uint32 length,
+                StringPiece* result) {
+  if (length == 0) {
+    *result = StringPiece();
+    return true;
+  }
+  const void* data;
+  int size;
+  if (!stream->GetDirectBufferPointer(&data, &size) ||
+      static_cast<uint32>(size) < length) {
+    return false;
+  }
+  *result = StringPiece(static_cast<const char*>(data), length);
+  return stream->Skip(length);
+}
+
 namespace parsed {
 
 // ParseDataType has to be called first, then appropriate ParseZzzzList.
@@ -129,11 +293,10 @@ class Feature {
     while (!stream.ExpectAtEnd()) {
       if (!stream.ExpectTag(kDelimitedTag(1))) return false;
       // parse string
-      uint32 bytes_length;
-      if (!stream.ReadVarint32(&bytes_length)) return false;
-      string bytes;
-      if (!stream.ReadString(&bytes, bytes_length)) return false;
-      bytes_list->push_back(std::move(bytes));
+      StringPiece bytes;
+      if (!ParseString(&stream, &bytes)) return false;
+      string* out = ExtendBy(bytes_list, 1);
+      if (out != nullptr) out->assign(bytes.data(), bytes.size());
     }
     stream.PopLimit(limit);
     return true;
@@ -159,15 +322,16 @@ class Feature {
         if (!stream.ExpectTag(kDelimitedTag(1))) return false;  // packed tag
         uint32 packed_length;
         if (!stream.ReadVarint32(&packed_length)) return false;
-        auto packed_limit = stream.PushLimit(packed_length);
-
-        while (!stream.ExpectAtEnd()) {
-          uint32 buffer32;
-          if (!stream.ReadLittleEndian32(&buffer32)) return false;
-          float_list->push_back(bit_cast<float>(buffer32));
+        StringPiece packed;
+        if (!ReadPacked(&stream, packed_length, &packed) ||
+            packed.size() % sizeof(float) != 0) {
+          return false;
+        }
+        const size_t num_values = packed.size() / sizeof(float);
+        float* out = ExtendBy(float_list, num_values);
+        if (out != nullptr) {
+          CopyLittleEndianFloats(packed.data(), num_values, out);
         }
-
-        stream.PopLimit(packed_limit);
       } else {  // non-packed
         while (!stream.ExpectAtEnd()) {
           if (!stream.ExpectTag(kFixed32Tag(1))) return false;
@@ -201,15 +365,14 @@ class Feature {
         if (!stream.ExpectTag(kDelimitedTag(1))) return false;  // packed tag
         uint32 packed_length;
         if (!stream.ReadVarint32(&packed_length)) return false;
-        auto packed_limit = stream.PushLimit(packed_length);
-
-        while (!stream.ExpectAtEnd()) {
-          protobuf_uint64 n;  // There is no API for int64
-          if (!stream.ReadVarint64(&n)) return false;
-          int64_list->push_back(static_cast<int64>(n));
+        StringPiece packed;
+        if (!ReadPacked(&stream, packed_length, &packed)) return false;
+        const uint8* begin = reinterpret_cast<const uint8*>(packed.data());
+        const uint8* end = begin + packed.size();
+        int64* out = ExtendBy(int64_list, CountPackedVarints(begin, end));
+        if (out != nullptr && !DecodePackedVarints(begin, end, out)) {
+          return false;
         }
-
-        stream.PopLimit(packed_limit);
       } else {  // non-packed
         while (!stream.ExpectAtEnd()) {
           if (!stream.ExpectTag(kVarintTag(1))) return false;
@@ -260,26 +423,6 @@ inline bool SkipExtraneousTag(protobuf::io::CodedInputStream* stream) {
   return false;  // unrecognized tag type
 }
 
-bool ParseString(protobuf::io::CodedInputStream* stream, StringPiece* result) {
-  DCHECK(stream != nullptr);
-  DCHECK(result != nullptr);
-  uint32 length;
-  if (!stream->ReadVarint32(&length)) return false;
-  if (length == 0) {
-    *result = StringPiece(nullptr, 0);
-    return true;
-  }
-  const void* stream_alias;
-  int stream_size;
-  if (!stream->GetDirectBufferPointer(&stream_alias, &stream_size)) {
-    return false;
-  }
-  if (static_cast<uint32>(stream_size) < length) return false;
-  *result = StringPiece(static_cast<const char*>(stream_alias), length);
-  stream->Skip(length);
-  return true;
-}
-
 bool ParseFeatureMapEntry(protobuf::io::CodedInputStream* stream,
                           parsed::FeatureMapEntry* feature_map_entry) {
   DCHECK(stream != nullptr);
@@ -401,6 +544,154 @@ bool TestFastParse(const string& serialized, Example* example) {
 
 namespace {
 
+uint64 DisplacedSlotHash(uint64 hash, uint64 displacement) {
+  return (hash ^ (displacement * 0x9E3779B97F4A7C15ULL)) *
+         0xC2B2AE3D27D4EB4FULL;
+}
+
+}  // namespace
+
+Status FastParseExampleIndex::Create(
+    const FastParseExampleConfig& config,
+    std::unique_ptr<FastParseExampleIndex>* result) {
+  std::unique_ptr<FastParseExampleIndex> index(new FastParseExampleIndex);
+  std::vector<Feature>& features = index->features_;
+  for (size_t d = 0; d < config.dense.size(); ++d) {
+    features.push_back({config.dense[d].feature_name, d, true});
+  }
+  for (size_t d = 0; d < config.sparse.size(); ++d) {
+    features.push_back({config.sparse[d].feature_name, d, false});
+  }
+  const size_t num_features = features.size();
+  {
+    std::unordered_set<StringPiece, StringPieceHasher> names;
+    for (const Feature& feature : features) {
+      if (!names.insert(feature.name).second) {
+        return errors::InvalidArgument("Duplicate feature name: ",
+                                       feature.name);
+      }
+    }
+  }
+
+  // The short hash only reads the length and the first and last 8 bytes of
+  // the names, so it is used unless it maps two names to the same value.
+  std::vector<uint64> hashes(num_features);
+  for (bool full_hash : {false, true}) {
+    index->full_hash_ = full_hash;
+    for (size_t i = 0; i < num_features; ++i) {
+      hashes[i] = index->Hash(features[i].name);
+    }
+    std::vector<uint64> sorted_hashes = hashes;
+    std::sort(sorted_hashes.begin(), sorted_hashes.end());
+    if (std::adjacent_find(sorted_hashes.begin(), sorted_hashes.end()) ==
+        sorted_hashes.end()) {
+      break;
+    }
+    if (full_hash) {
+      return errors::Internal("Feature names with the same 64-bit hash.");
+    }
+  }
+
+  // Hash and displace: the names are hashed into about num_features / 2
+  // buckets, and the buckets, largest first, get the first displacement that
+  // maps their names to free slots of a table with about 2 * num_features
+  // slots.
+  int log2_slots = 1;
+  while ((size_t{1} << log2_slots) < 2 * num_features) ++log2_slots;
+  index->slot_shift_ = 64 - log2_slots;
+  index->slots_.assign(size_t{1} << log2_slots, -1);
+  size_t num_buckets = 1;
+  while (2 * num_buckets < num_features) num_buckets *= 2;
+  index->displacements_.assign(num_buckets, 0);
+
+  std::vector<std::vector<int32>> buckets(num_buckets);
+  for (size_t i = 0; i < num_features; ++i) {
+    buckets[hashes[i] & (num_buckets - 1)].push_back(i);
+  }
+  std::vector<size_t> bucket_order(num_buckets);
+  std::iota(bucket_order.begin(), bucket_order.end(), 0);
+  std::stable_sort(bucket_order.begin(), bucket_order.end(),
+                   [&buckets](size_t a, size_t b) {
+                     return buckets[a].size() > buckets[b].size();
+                   });
+  std::vector<size_t> bucket_slots;
+  for (size_t b : bucket_order) {
+    if (buckets[b].empty()) break;
+    uint64 displacement = 0;
+    for (;; ++displacement) {
+      if (displacement == (1 << 20)) {
+        return errors::Internal("Could not build a perfect hash table of ",
+                                num_features, " feature names.");
+      }
+      bucket_slots.clear();
+      for (int32 i : buckets[b]) {
+        const size_t slot =
+            DisplacedSlotHash(hashes[i], displacement) >> index->slot_shift_;
+        if (index->slots_[slot] != -1 ||
+            std::find(bucket_slots.begin(), bucket_slots.end(), slot) !=
+                bucket_slots.end()) {
+          break;
+        }
+        bucket_slots.push_back(slot);
+      }
+      if (bucket_slots.size() == buckets[b].size()) break;
+    }
+    index->displacements_[b] = displacement;
+    for (size_t j = 0; j < bucket_slots.size(); ++j) {
+      index->slots_[bucket_slots[j]] = buckets[b][j];
+    }
+  }
+  *result = std::move(index);
+  return Status::OK();
+}
+
+uint64 FastParseExampleIndex::Hash(StringPiece name) const {
+  if (full_hash_) {
+    return Hash64(name.data(), name.size());
+  }
+  const size_t size = name.size();
+  uint64 head = 0;
+  uint64 tail = 0;
+  if (size >= 8) {
+    memcpy(&head, name.data(), 8);
+    memcpy(&tail, name.data() + size - 8, 8);
+  } else if (size > 0) {
+    memcpy(&head, name.data(), size);
+  }
+  uint64 hash = (head + size) * 0x9E3779B97F4A7C15ULL;
+  hash ^= tail * 0xC2B2AE3D27D4EB4FULL;
+  return hash ^ (hash >> 29);
+}
+
+size_t FastParseExampleIndex::Slot(uint64 hash) const {
+  const uint64 displacement =
+      displacements_[hash & (displacements_.size() - 1)];
+  return DisplacedSlotHash(hash, displacement) >> slot_shift_;
+}
+
+const FastParseExampleIndex::Feature* FastParseExampleIndex::Find(
+    StringPiece name) const {
+  const int32 i = slots_[Slot(Hash(name))];
+  if (i == -1 || features_[i].name != name) return nullptr;
+  return &features_[i];
+}
+
+bool FastParseExampleIndex::Matches(
+    const FastParseExampleConfig& config) const {
+  if (features_.size() != config.dense.size() + config.sparse.size()) {
+    return false;
+  }
+  for (const Feature& feature : features_) {
+    const string& name = feature.is_dense
+                             ? config.dense[feature.index].feature_name
+                             : config.sparse[feature.index].feature_name;
+    if (feature.name != name) return false;
+  }
+  return true;
+}
+
+namespace {
+
 using Config = FastParseExampleConfig;
 
 void ParallelFor(const std::function<void(size_t)>& f, size_t n,
@@ -423,8 +714,6 @@ void ParallelFor(const std::function<void(size_t)>& f, size_t n,
   }
 }
 
-enum class Type { Sparse, Dense };
-
 struct SparseBuffer {
   // Features are in one of the 3 vectors below depending on config's dtype.
   // Other 2 vectors remain empty.
@@ -438,35 +727,6 @@ struct SparseBuffer {
   std::vector<size_t> example_end_indices;
 };
 
-struct SeededHasher {
-  uint64 operator()(StringPiece s) const {
-    return Hash64(s.data(), s.size(), seed);
-  }
-  uint64 seed{0xDECAFCAFFE};
-};
-
-template <typename T>
-class LimitedArraySlice {
- public:
-  LimitedArraySlice(T* begin, size_t num_elements)
-      : current_(begin), end_(begin + num_elements) {}
-
-  // May return negative if there were push_back calls after slice was filled.
-  int64 EndDistance() const { return end_ - current_; }
-
-  // Attempts to push value to the back of this. If the slice has
-  // already been filled, this method has no effect on the underlying data, but
-  // it changes the number returned by EndDistance into negative values.
-  void push_back(T&& value) {
-    if (EndDistance() > 0) *current_ = std::move(value);
-    ++current_;
-  }
-
- private:
-  T* current_;
-  T* end_;
-};
-
 void LogDenseFeatureDataLoss(StringPiece feature_name) {
   LOG(WARNING) << "Data loss! Feature '" << feature_name
                << "' is present in multiple concatenated "
@@ -492,8 +752,7 @@ void LogSparseFeatureDataLoss(StringPiece feature_name) {
 Status FastParseSerializedExample(
     const string& serialized_example, const string& example_name,
     const size_t example_index, const Config& config,
-    const PresizedCuckooMap<std::pair<size_t, Type>>& config_index,
-    SeededHasher hasher, std::vector<Tensor>* output_dense,
+    const FastParseExampleIndex& index, std::vector<Tensor>* output_dense,
     std::vector<SparseBuffer>* output_varlen_dense,
     std::vector<SparseBuffer>* output_sparse,
     PerExampleFeatureStats* output_stats) {
@@ -526,21 +785,12 @@ Status FastParseSerializedExample(
     const StringPiece feature_name = name_and_feature.first;
     parsed::Feature& feature = name_and_feature.second;
 
-    std::pair<size_t, Type> d_and_type;
-    uint64 h = hasher(feature_name);
-    if (!config_index.Find(h, &d_and_type)) continue;
+    const FastParseExampleIndex::Feature* config_feature =
+        index.Find(feature_name);
+    if (config_feature == nullptr) continue;
 
-    size_t d = d_and_type.first;
-    bool is_dense = d_and_type.second == Type::Dense;
-
-    {
-      // Testing for PresizedCuckooMap collision.
-      // TODO(lew): Use dense_hash_map and avoid this and hasher creation.
-      const string& config_feature_name = is_dense
-                                              ? config.dense[d].feature_name
-                                              : config.sparse[d].feature_name;
-      if (feature_name != config_feature_name) continue;
-    }
+    size_t d = config_feature->index;
+    bool is_dense = config_feature->is_dense;
 
     auto example_error = [&](StringPiece suffix) {
       return errors::InvalidArgument("Name: ", example_name,
@@ -918,7 +1168,19 @@ Status FastParseExample(const Config& config,
                         gtl::ArraySlice<string> serialized,
                         gtl::ArraySlice<string> example_names,
                         thread::ThreadPool* thread_pool, Result* result) {
+  std::unique_ptr<FastParseExampleIndex> index;
+  TF_RETURN_IF_ERROR(FastParseExampleIndex::Create(config, &index));
+  return FastParseExample(config, *index, serialized, example_names,
+                          thread_pool, result);
+}
+
+Status FastParseExample(const Config& config,
+                        const FastParseExampleIndex& index,
+                        gtl::ArraySlice<string> serialized,
+                        gtl::ArraySlice<string> example_names,
+                        thread::ThreadPool* thread_pool, Result* result) {
   DCHECK(result != nullptr);
+  DCHECK(index.Matches(config));
   // Check config so we can safely CHECK(false) in switches on config.*.dtype
   for (auto& c : config.sparse) {
     TF_RETURN_IF_ERROR(CheckConfigDataType(c.dtype));
@@ -931,31 +1193,6 @@ Status FastParseExample(const Config& config,
     result->feature_stats.resize(serialized.size());
   }
 
-  size_t config_size = config.dense.size() + config.sparse.size();
-  SeededHasher hasher;
-  // Build config index.
-  PresizedCuckooMap<std::pair<size_t, Type>> config_index(config_size);
-  bool ok = true;
-  for (size_t i = 0; i < 1000; ++i) {
-    for (size_t d = 0; d < config.dense.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.dense[d].feature_name),
-                                      {d, Type::Dense});
-    }
-    for (size_t d = 0; d < config.sparse.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.sparse[d].feature_name),
-                                      {d, Type::Sparse});
-    }
-    if (ok) break;
-    LOG(WARNING) << "Collision found. This should happen only if you have "
-                    "around 2^32 entries in your config.";
-    hasher.seed++;
-    config_index.Clear(config_size);
-  }
-  if (!ok) {
-    return errors::Internal(
-        "Could not avoid collision. This should not happen.");
-  }
-
   // Allocate dense output for fixed length dense values
   // (variable-length dense and sparse have to be buffered).
   std::vector<Tensor> fixed_dense_values(config.dense.size());
@@ -1023,8 +1260,8 @@ Status FastParseExample(const Config& config,
       status_of_minibatch[minibatch] = FastParseSerializedExample(
           serialized[e],
           (!example_names.empty() ? example_names[e] : "<unknown>"), e, config,
-          config_index, hasher, &fixed_dense_values,
-          &varlen_dense_buffers[minibatch], &sparse_buffers[minibatch], stats);
+          index, &fixed_dense_values, &varlen_dense_buffers[minibatch],
+          &sparse_buffers[minibatch], stats);
       if (!status_of_minibatch[minibatch].ok()) break;
     }
   };
@@ -1187,7 +1424,16 @@ Status FastParseExample(const Config& config,
 
 Status FastParseSingleExample(const Config& config, const string& serialized,
                               Result* result) {
+  std::unique_ptr<FastParseExampleIndex> index;
+  TF_RETURN_IF_ERROR(FastParseExampleIndex::Create(config, &index));
+  return FastParseSingleExample(config, *index, serialized, result);
+}
+
+Status FastParseSingleExample(const Config& config,
+                              const FastParseExampleIndex& index,
+                              const string& serialized, Result* result) {
   DCHECK(result != nullptr);
+  DCHECK(index.Matches(config));
   // Check config so we can safely CHECK(false) in switches on config.*.dtype
   for (auto& c : config.sparse) {
     TF_RETURN_IF_ERROR(CheckConfigDataType(c.dtype));
@@ -1202,32 +1448,6 @@ Status FastParseSingleExample(const Config& config, const string& serialized,
     stats = &result->feature_stats.back();
   }
 
-  // TODO(mrry): Cache the construction of this map at Op construction time.
-  size_t config_size = config.dense.size() + config.sparse.size();
-  SeededHasher hasher;
-  // Build config index.
-  PresizedCuckooMap<std::pair<size_t, Type>> config_index(config_size);
-  bool ok = true;
-  for (size_t i = 0; i < 1000; ++i) {
-    for (size_t d = 0; d < config.dense.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.dense[d].feature_name),
-                                      {d, Type::Dense});
-    }
-    for (size_t d = 0; d < config.sparse.size(); ++d) {
-      ok &= config_index.InsertUnique(hasher(config.sparse[d].feature_name),
-                                      {d, Type::Sparse});
-    }
-    if (ok) break;
-    LOG(WARNING) << "Collision found. This should happen only if you have "
-                    "around 2^32 entries in your config.";
-    hasher.seed++;
-    config_index.Clear(config_size);
-  }
-  if (!ok) {
-    return errors::Internal(
-        "Could not avoid collision. This should not happen.");
-  }
-
   // Allocate dense output tensors.
   for (size_t d = 0; d < config.dense.size(); ++d) {
     if (!config.dense[d].variable_length) {
@@ -1278,21 +1498,12 @@ Status FastParseSingleExample(const Config& config, const string& serialized,
     const StringPiece feature_name = name_and_feature.first;
     parsed::Feature& feature = name_and_feature.second;
 
-    std::pair<size_t, Type> d_and_type;
-    uint64 h = hasher(feature_name);
-    if (!config_index.Find(h, &d_and_type)) continue;
-
-    size_t d = d_and_type.first;
-    bool is_dense = d_and_type.second == Type::Dense;
+    const FastParseExampleIndex::Feature* config_feature =
+        index.Find(feature_name);
+    if (config_feature == nullptr) continue;
 
-    {
-      // Testing for PresizedCuckooMap collision.
-      // TODO(lew): Use dense_hash_map and avoid this and hasher creation.
-      const string& config_feature_name = is_dense
-                                              ? config.dense[d].feature_name
-                                              : config.sparse[d].feature_name;
-      if (feature_name != config_feature_name) continue;
-    }
+    size_t d = config_feature->index;
+    bool is_dense = config_feature->is_dense;
 
     auto example_error = [feature_name](StringPiece suffix) {
       return errors::InvalidArgument("Key: ", feature_name, ".  ", suffix);
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
 #define TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -65,6 +66,51 @@ struct FastParseExampleConfig {
   bool collect_feature_stats = false;
 };
 
+// The feature names of a FastParseExampleConfig, compiled into a perfect hash
+// table: looking up a name hashes at most 16 of its bytes and compares it
+// with a single feature of the config.
+//
+// The index only depends on the feature names of the config, so kernels whose
+// names do not change build it once and reuse it for every call.
+class FastParseExampleIndex {
+ public:
+  struct Feature {
+    string name;
+    // Index of the feature in `config.dense` or `config.sparse`.
+    size_t index;
+    bool is_dense;
+  };
+
+  // Builds the index of the features of `config`, whose names must be
+  // distinct.
+  static Status Create(const FastParseExampleConfig& config,
+                       std::unique_ptr<FastParseExampleIndex>* result);
+
+  // Returns the feature of the config named `name`, or nullptr if there is
+  // none.
+  const Feature* Find(StringPiece name) const;
+
+  // Returns true if `config` has the same dense and sparse feature names as
+  // the config the index was built from.
+  bool Matches(const FastParseExampleConfig& config) const;
+
+ private:
+  FastParseExampleIndex() {}
+
+  uint64 Hash(StringPiece name) const;
+  size_t Slot(uint64 hash) const;
+
+  std::vector<Feature> features_;
+  // Whether names are hashed entirely, because the length and the first and
+  // last 8 bytes of some names of the config are the same.
+  bool full_hash_ = false;
+  // The names are hashed into buckets, whose displacements map them to
+  // distinct slots of `slots_`, which hold indices into `features_` (or -1).
+  std::vector<uint64> displacements_;
+  std::vector<int32> slots_;
+  int slot_shift_ = 0;
+};
+
 // Statistics about the features in each example passed to
 // `FastParse[Single]Example()`.
 //
@@ -103,12 +149,23 @@ Status FastParseExample(const FastParseExampleConfig& config,
                         gtl::ArraySlice<string> example_names,
                         thread::ThreadPool* thread_pool, Result* result);
 
-// TODO(mrry): Move the hash table construction into the config object.
+// Same as above, with the index of `config`, which must match it.
+Status FastParseExample(const FastParseExampleConfig& config,
+                        const FastParseExampleIndex& index,
+                        gtl::ArraySlice<string> serialized,
+                        gtl::ArraySlice<string> example_names,
+                        thread::ThreadPool* thread_pool, Result* result);
+
 typedef FastParseExampleConfig FastParseSingleExampleConfig;
 
 Status FastParseSingleExample(const FastParseSingleExampleConfig& config,
                               const string& serialized, Result* result);
 
+// Same as above, with the index of `config`, which must match it.
+Status FastParseSingleExample(const FastParseSingleExampleConfig& config,
+                              const FastParseExampleIndex& index,
+                              const string& serialized, Result* result);
+
 // Parses a batch of serialized SequenceExample protos and converts them into
 // result according to given config.
 // Given example names have to either be empty or the same size as serialized.
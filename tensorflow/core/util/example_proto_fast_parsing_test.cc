@@ -19,6 +19,7 @@ limitations under the License.
 
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/protobuf.h"
@@ -321,6 +322,90 @@ TEST(FastParse, StatsCollection) {
   }
 }
 
+TEST(FastParse, PackedInt64Runs) {
+  // Mixes runs of 1-byte varints, which are decoded 8 at a time, with longer
+  // ones, including negative values, which take 10 bytes.
+  Example example;
+  Int64List* int64_list =
+      (*example.mutable_features()->mutable_feature())["int64_list"]
+          .mutable_int64_list();
+  for (int i = 0; i < 20; ++i) int64_list->add_value(i);
+  int64_list->add_value(300);
+  int64_list->add_value(-1);
+  int64_list->add_value(kint64max);
+  int64_list->add_value(kint64min);
+  for (int i = 0; i < 9; ++i) int64_list->add_value(127 - i);
+  TestCorrectness(Serialize(example));
+
+  FastParseExampleConfig config;
+  AddDenseFeature("int64_list", DT_INT64, {int64_list->value_size()}, false,
+                  int64_list->value_size(), &config);
+  Result result;
+  TF_ASSERT_OK(FastParseExample(config, {Serialize(example)}, {}, nullptr,
+                                &result));
+  auto values = result.dense_values[0].flat<int64>();
+  ASSERT_EQ(values.size(), int64_list->value_size());
+  for (int i = 0; i < int64_list->value_size(); ++i) {
+    EXPECT_EQ(values(i), int64_list->value(i));
+  }
+
+  // Too few values for the dense shape.
+  config.dense[0].shape = PartialTensorShape({int64_list->value_size() + 1});
+  config.dense[0].elements_per_stride = int64_list->value_size() + 1;
+  EXPECT_FALSE(
+      FastParseExample(config, {Serialize(example)}, {}, nullptr, &result)
+          .ok());
+}
+
+TEST(FastParse, TruncatedPackedInt64) {
+  // The packed varint 0x8d has a continuation bit but no next byte.
+  Example example;
+  EXPECT_FALSE(TestFastParse(
+      "\x0a\x0e\x0a\x0c\x0a\x03\x61\x67\x65\x12\x05\x1a\x03\x0a\x01\x8d",
+      &example));
+}
+
+TEST(FastParseExampleIndex, FindsFeatures) {
+  FastParseExampleConfig config;
+  std::vector<string> names;
+  for (int i = 0; i < 100; ++i) {
+    names.push_back(strings::StrCat("feature_", i));
+  }
+  for (int i = 0; i < 100; ++i) {
+    // Names with the same length and the same first and last 8 bytes.
+    names.push_back(strings::StrCat("features/", 100 + i, "/all_values"));
+  }
+  names.push_back("");
+  for (int i = 0; i < names.size(); ++i) {
+    if (i % 2 == 0) {
+      AddDenseFeature(names[i].c_str(), DT_FLOAT, {1}, false, 1, &config);
+    } else {
+      AddSparseFeature(names[i].c_str(), DT_FLOAT, &config);
+    }
+  }
+  std::unique_ptr<FastParseExampleIndex> index;
+  TF_ASSERT_OK(FastParseExampleIndex::Create(config, &index));
+  EXPECT_TRUE(index->Matches(config));
+  for (int i = 0; i < names.size(); ++i) {
+    const FastParseExampleIndex::Feature* feature = index->Find(names[i]);
+    ASSERT_NE(feature, nullptr) << names[i];
+    EXPECT_EQ(feature->name, names[i]);
+    EXPECT_EQ(feature->is_dense, i % 2 == 0);
+    EXPECT_EQ(feature->index, i / 2);
+  }
+  EXPECT_EQ(index->Find("feature_100"), nullptr);
+  EXPECT_EQ(index->Find("features/300/all_values"), nullptr);
+
+  config.sparse[0].feature_name = "other";
+  EXPECT_FALSE(index->Matches(config));
+  config.sparse[0].feature_name = config.dense[0].feature_name;
+  EXPECT_FALSE(FastParseExampleIndex::Create(config, &index).ok());
+
+  TF_ASSERT_OK(
+      FastParseExampleIndex::Create(FastParseExampleConfig(), &index));
+  EXPECT_EQ(index->Find(""), nullptr);
+}
+
 string RandStr(random::SimplePhilox* rng) {
   static const char key_char_lookup[] =
       "0123456789{}~`!@#$%^&*()"
@@ -422,6 +507,65 @@ TEST(TestFastParseExample, Empty) {
   EXPECT_TRUE(status.ok()) << status;
 }
 
+// Parses batches of examples with a schema like that of ranking models: a
+// few dense scalars and embeddings, sparse ids and variable-length lists of
+// small integers.
+static void BM_FastParseExample(int iters, int batch_size) {
+  testing::StopTiming();
+  random::PhiloxRandom philox(42);
+  random::SimplePhilox rng(&philox);
+  FastParseExampleConfig config;
+  Example example;
+  auto& features = *example.mutable_features()->mutable_feature();
+  for (int i = 0; i < 10; ++i) {
+    const string name = strings::StrCat("context/dense_float_", i);
+    AddDenseFeature(name.c_str(), DT_FLOAT, {1}, false, 1, &config);
+    features[name].mutable_float_list()->add_value(rng.RandFloat());
+  }
+  for (int i = 0; i < 2; ++i) {
+    const string name = strings::StrCat("context/embedding_", i);
+    AddDenseFeature(name.c_str(), DT_FLOAT, {64}, false, 64, &config);
+    for (int j = 0; j < 64; ++j) {
+      features[name].mutable_float_list()->add_value(rng.RandFloat());
+    }
+  }
+  for (int i = 0; i < 10; ++i) {
+    const string name = strings::StrCat("user/sparse_ids_", i);
+    AddSparseFeature(name.c_str(), DT_INT64, &config);
+    for (int j = rng.Uniform(10); j >= 0; --j) {
+      features[name].mutable_int64_list()->add_value(rng.Rand32());
+    }
+  }
+  for (int i = 0; i < 5; ++i) {
+    const string name = strings::StrCat("item/varlen_counts_", i);
+    AddDenseFeature(name.c_str(), DT_INT64, {-1}, true, 1, &config);
+    for (int j = 0; j < 20; ++j) {
+      features[name].mutable_int64_list()->add_value(rng.Uniform(100));
+    }
+  }
+  for (int i = 0; i < 3; ++i) {
+    const string name = strings::StrCat("item/category_", i);
+    AddDenseFeature(name.c_str(), DT_STRING, {1}, false, 1, &config);
+    features[name].mutable_bytes_list()->add_value(RandStr(&rng).substr(0, 10));
+  }
+  for (int i = 0; i < 10; ++i) {
+    // Features that the model does not use.
+    features[strings::StrCat("unused_", i)].mutable_int64_list()->add_value(i);
+  }
+  std::vector<string> serialized(batch_size, Serialize(example));
+  std::unique_ptr<FastParseExampleIndex> index;
+  TF_CHECK_OK(FastParseExampleIndex::Create(config, &index));
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    Result result;
+    TF_CHECK_OK(
+        FastParseExample(config, *index, serialized, {}, nullptr, &result));
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * batch_size *
+                          serialized[0].size());
+}
+BENCHMARK(BM_FastParseExample)->Arg(1)->Arg(128)->Arg(1024);
+
 }  // namespace
 }  // namespace example
 }  // namespace tensorflow
@@ -15,13 +15,139 @@ limitations under the License.
 
 #include "tensorflow/core/util/work_sharder.h"
 
+#include <atomic>
+#include <cmath>
+#include <unordered_map>
+
+#include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/env_time.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
 /* ABSL_CONST_INIT */ thread_local int per_thread_max_parallism = 1000000;
 
+/* ABSL_CONST_INIT */ thread_local ShardingContext* per_thread_sharding_context =
+    nullptr;
+
+namespace {
+
+std::atomic<bool>* AdaptiveShardingFlag() {
+  static std::atomic<bool>* flag = [] {
+    bool enabled = false;
+    Status s = ReadBoolFromEnvVar("TF_ADAPTIVE_SHARDING", false, &enabled);
+    if (!s.ok()) {
+      LOG(ERROR) << "AdaptiveShardingEnabled: " << s.error_message();
+    }
+    return new std::atomic<bool>(enabled);
+  }();
+  return flag;
+}
+
+// Shard() and ThreadPool::ParallelFor() take costs in CPU cycles, but the
+// cost model measures wall time. Converts assuming a 3 GHz clock.
+constexpr double kCyclesPerNanosecond = 3.0;
+
+// Per-unit costs measured by Shard(), keyed by label and the magnitude of
+// the total.
+class ShardingCostModel {
+ public:
+  static ShardingCostModel* Global() {
+    static ShardingCostModel* model = new ShardingCostModel;
+    return model;
+  }
+
+  static uint64 Key(const string& label, int64 total) {
+    return Hash64Combine(Hash64(label), Log2Floor64(total));
+  }
+
+  // Returns the measured cost per unit in cycles, or -1 if there is none.
+  int64 CostPerUnit(uint64 key) {
+    Stripe& stripe = stripes_[key % kNumStripes];
+    mutex_lock l(stripe.mu);
+    auto it = stripe.nanos_per_unit.find(key);
+    if (it == stripe.nanos_per_unit.end()) return -1;
+    return std::max<int64>(1,
+                           std::llround(it->second * kCyclesPerNanosecond));
+  }
+
+  // Adds a measurement, giving recent ones a larger weight so that the
+  // cost follows changes of the load.
+  void Record(uint64 key, double nanos_per_unit) {
+    Stripe& stripe = stripes_[key % kNumStripes];
+    mutex_lock l(stripe.mu);
+    auto it = stripe.nanos_per_unit.find(key);
+    if (it == stripe.nanos_per_unit.end()) {
+      stripe.nanos_per_unit.emplace(key, nanos_per_unit);
+    } else {
+      it->second += (nanos_per_unit - it->second) / 8;
+    }
+  }
+
+  void Clear() {
+    for (Stripe& stripe : stripes_) {
+      mutex_lock l(stripe.mu);
+      stripe.nanos_per_unit.clear();
+    }
+  }
+
+ private:
+  static constexpr int kNumStripes = 16;
+
+  struct Stripe {
+    mutex mu;
+    std::unordered_map<uint64, double> nanos_per_unit GUARDED_BY(mu);
+  };
+  Stripe stripes_[kNumStripes];
+};
+
+void ShardUnmeasured(int max_parallelism, thread::ThreadPool* workers,
+                     int64 total, int64 cost_per_unit,
+                     const std::function<void(int64, int64)>& work) {
+  if (max_parallelism <= 1) {
+    // Just inline the whole work since we only have 1 thread (core).
+    work(0, total);
+    return;
+  }
+  if (max_parallelism >= workers->NumThreads()) {
+    workers->ParallelFor(total, cost_per_unit, work);
+    return;
+  }
+  Sharder::Do(total, cost_per_unit, work,
+              [&workers](Sharder::Closure c) { workers->Schedule(c); },
+              max_parallelism);
+}
+
+}  // namespace
+
+ScopedShardingContext::ScopedShardingContext(ShardingContext* context)
+    : previous_(per_thread_sharding_context) {
+  per_thread_sharding_context = context;
+}
+
+ScopedShardingContext::~ScopedShardingContext() {
+  per_thread_sharding_context = previous_;
+}
+
+void SetAdaptiveShardingEnabled(bool enabled) {
+  AdaptiveShardingFlag()->store(enabled, std::memory_order_relaxed);
+}
+
+bool AdaptiveShardingEnabled() {
+  return AdaptiveShardingFlag()->load(std::memory_order_relaxed);
+}
+
+int64 MeasuredCostPerUnit(const string& label, int64 total) {
+  return ShardingCostModel::Global()->CostPerUnit(
+      ShardingCostModel::Key(label, total));
+}
+
+void ClearMeasuredCostsForTest() { ShardingCostModel::Global()->Clear(); }
+
 void SetPerThreadMaxParallelism(int max_parallelism) {
   CHECK_LE(0, max_parallelism);
   per_thread_max_parallism = max_parallelism;
@@ -36,18 +162,46 @@ void Shard(int max_parallelism, thread::ThreadPool* workers, int64 total,
     return;
   }
   max_parallelism = std::min(max_parallelism, GetPerThreadMaxParallelism());
-  if (max_parallelism <= 1) {
-    // Just inline the whole work since we only have 1 thread (core).
-    work(0, total);
+  ShardingContext* context = per_thread_sharding_context;
+  if (context == nullptr) {
+    ShardUnmeasured(max_parallelism, workers, total, cost_per_unit, work);
     return;
   }
-  if (max_parallelism >= workers->NumThreads()) {
-    workers->ParallelFor(total, cost_per_unit, work);
-    return;
+
+  const bool adaptive = context->label != nullptr && AdaptiveShardingEnabled();
+  uint64 key = 0;
+  if (adaptive) {
+    key = ShardingCostModel::Key(*context->label, total);
+    const int64 measured = ShardingCostModel::Global()->CostPerUnit(key);
+    if (measured > 0) cost_per_unit = measured;
+  }
+
+  std::atomic<int64> num_shards(0);
+  std::atomic<int64> work_nanos(0);
+  auto measured_work = [&work, &num_shards, &work_nanos](int64 start,
+                                                        int64 limit) {
+    const uint64 start_nanos = EnvTime::Default()->NowNanos();
+    work(start, limit);
+    work_nanos.fetch_add(EnvTime::Default()->NowNanos() - start_nanos,
+                         std::memory_order_relaxed);
+    num_shards.fetch_add(1, std::memory_order_relaxed);
+  };
+  {
+    // Shard() calls nested in the work are not attributed to this context.
+    ScopedShardingContext nested(nullptr);
+    ShardUnmeasured(max_parallelism, workers, total, cost_per_unit,
+                    measured_work);
+  }
+
+  ++context->num_calls;
+  context->num_units += total;
+  context->num_shards += num_shards.load(std::memory_order_relaxed);
+  context->work_nanos += work_nanos.load(std::memory_order_relaxed);
+  if (adaptive) {
+    ShardingCostModel::Global()->Record(
+        key, static_cast<double>(work_nanos.load(std::memory_order_relaxed)) /
+                 total);
   }
-  Sharder::Do(total, cost_per_unit, work,
-              [&workers](Sharder::Closure c) { workers->Schedule(c); },
-              max_parallelism);
 }
 
 void Sharder::Do(int64 total, int64 cost_per_unit, const Work& work,
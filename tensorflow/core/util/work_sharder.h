@@ -19,6 +19,7 @@ limitations under the License.
 #include <functional>
 
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
@@ -79,6 +80,54 @@ class ScopedPerThreadMaxParallelism {
   int previous_ = -1;
 };
 
+// Describes the Shard() calls that a thread makes on behalf of one unit of
+// work, typically an OpKernel::Compute() call, and collects what they did.
+struct ShardingContext {
+  // Identifies the kind of work, e.g. the op type. Shard() calls with the
+  // same label share their cost measurements. Not owned; may be nullptr.
+  const string* label = nullptr;
+
+  // Filled in by the Shard() calls made in this context.
+  int64 num_calls = 0;
+  int64 num_units = 0;
+  int64 num_shards = 0;
+  // The time spent in the shards, summed over the threads that ran them.
+  int64 work_nanos = 0;
+};
+
+// Makes "context" the ShardingContext of the calling thread while this object
+// is alive. "context" may be nullptr, in which case Shard() calls are not
+// measured. Not owned.
+class ScopedShardingContext {
+ public:
+  explicit ScopedShardingContext(ShardingContext* context);
+  ~ScopedShardingContext();
+
+ private:
+  ShardingContext* const previous_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ScopedShardingContext);
+};
+
+// Adaptive sharding. When enabled, a Shard() call made in a ShardingContext
+// with a label ignores its "cost_per_unit" once earlier calls with the same
+// label and a "total" of the same magnitude (i.e. with the same floor(log2))
+// have measured the cost per unit of work. The shard count then follows the
+// measured cost. Costs are measured in nanoseconds of wall time and
+// converted to cycles assuming a 3 GHz clock, like "cost_per_unit".
+//
+// Disabled by default, unless the environment variable TF_ADAPTIVE_SHARDING
+// is set to true.
+void SetAdaptiveShardingEnabled(bool enabled);
+bool AdaptiveShardingEnabled();
+
+// Returns the cost per unit of work, in cycles, measured for "label" and
+// totals of the magnitude of "total", or -1 if none has been measured yet.
+int64 MeasuredCostPerUnit(const string& label, int64 total);
+
+// Forgets all measured costs. For tests.
+void ClearMeasuredCostsForTest();
+
 // Implementation details for Shard().
 class Sharder {
  public:
@@ -89,6 +89,76 @@ TEST(Shard, OverflowTest) {
   }
 }
 
+TEST(Shard, ContextCollectsStats) {
+  thread::ThreadPool threads(Env::Default(), "test", 4);
+  ShardingContext context;
+  {
+    ScopedShardingContext scoped(&context);
+    for (int i = 0; i < 3; ++i) {
+      std::atomic<int64> num_elements(0);
+      Shard(4, &threads, 1000, 1000, [&num_elements](int64 start, int64 limit) {
+        num_elements += limit - start;
+      });
+      EXPECT_EQ(1000, num_elements.load());
+    }
+  }
+  EXPECT_EQ(3, context.num_calls);
+  EXPECT_EQ(3000, context.num_units);
+  EXPECT_GE(context.num_shards, 3);
+  EXPECT_GE(context.work_nanos, 0);
+
+  // Calls outside of the context are not recorded.
+  Shard(4, &threads, 1000, 1000, [](int64 start, int64 limit) {});
+  EXPECT_EQ(3, context.num_calls);
+}
+
+TEST(Shard, AdaptiveShardingUsesMeasuredCost) {
+  thread::ThreadPool threads(Env::Default(), "test", 8);
+  const bool adaptive = AdaptiveShardingEnabled();
+  SetAdaptiveShardingEnabled(true);
+  ClearMeasuredCostsForTest();
+
+  const string label = "Cheap";
+  const int64 total = 64;
+  // A gross overestimate of the cost of the work below.
+  const int64 cost_per_unit = 1000000000;
+  auto run = [&threads, total, cost_per_unit]() {
+    mutex mu;
+    int num_shards = 0;
+    Shard(4, &threads, total, cost_per_unit,
+          [&mu, &num_shards](int64 start, int64 limit) {
+            mutex_lock l(mu);
+            ++num_shards;
+          });
+    return num_shards;
+  };
+
+  ShardingContext context;
+  context.label = &label;
+  {
+    ScopedShardingContext scoped(&context);
+    EXPECT_EQ(-1, MeasuredCostPerUnit(label, total));
+    // The estimate splits the work into as many shards as allowed.
+    EXPECT_EQ(4, run());
+    const int64 measured = MeasuredCostPerUnit(label, total);
+    EXPECT_GT(measured, 0);
+    EXPECT_LT(measured, cost_per_unit);
+    // Once measured, the work is cheap enough to run in a single shard.
+    EXPECT_EQ(1, run());
+  }
+  // Costs are measured per label and magnitude of the total.
+  EXPECT_EQ(-1, MeasuredCostPerUnit("Other", total));
+  EXPECT_EQ(-1, MeasuredCostPerUnit(label, 4 * total));
+
+  SetAdaptiveShardingEnabled(false);
+  {
+    ScopedShardingContext scoped(&context);
+    EXPECT_EQ(4, run());
+  }
+  SetAdaptiveShardingEnabled(adaptive);
+  ClearMeasuredCostsForTest();
+}
+
 void BM_Sharding(int iters, int arg) {
   thread::ThreadPool threads(Env::Default(), "test", 16);
   const int64 total = 1LL << 30;
@@ -199,6 +199,34 @@ class FileCacheDatasetTest(test.TestCase):
       self.assertAllEqual(elements, elements_itr1)
       self.assertAllEqual(elements, elements_itr2)
 
+  def testCacheSpansMultipleBlocks(self):
+    # Each element is about 1MB, so the cache holds several blocks.
+    components = (np.arange(12 * 256 * 1024, dtype=np.float32).reshape(
+        [12, 256, 1024]), np.array([b"x" * i for i in range(12)]))
+    dataset = dataset_ops.Dataset.from_tensor_slices(components)
+
+    for compression in ["NONE", "ZLIB", "SNAPPY"]:
+      cache_dataset = dataset.cache(
+          self.cache_prefix + compression, compression=compression)
+      with self.test_session() as sess:
+        # The first pass writes the cache and the second one reads it.
+        for _ in range(2):
+          get_next = cache_dataset.make_one_shot_iterator().get_next()
+          for i in range(12):
+            value, label = sess.run(get_next)
+            self.assertAllEqual(components[0][i], value)
+            self.assertEqual(components[1][i], label)
+          with self.assertRaises(errors.OutOfRangeError):
+            sess.run(get_next)
+
+  def testInvalidCompression(self):
+    dataset = dataset_ops.Dataset.range(3).cache(
+        self.cache_prefix, compression="LZ4")
+    with self.test_session() as sess:
+      with self.assertRaisesRegexp(errors.InvalidArgumentError,
+                                   "Invalid cache compression"):
+        sess.run(dataset.make_one_shot_iterator().get_next())
+
 
 class MemoryCacheDatasetTest(test.TestCase):
 
@@ -58,6 +58,73 @@ def all_reduce(t, group_size, group_key, instance_key, merge_op, final_op,
                                               subdiv_offsets=subdiv_offsets)
 
 
+def all_gather(t, group_size, group_key, instance_key):
+  """Gathers tensors collectively, across devices.
+
+  Args:
+    t: the tensor to be gathered.  Must have rank at least 1.
+    group_size: the total number of tensors to be collectively gathered.
+      Each must reside on a different device.
+    group_key: an integer identifying the group of devices.
+    instance_key: an integer identifying the participating group of Ops.
+
+  Returns:
+    An Op implementing the distributed gather.  Its value is the
+    concatenation along the first dimension of the tensors of all devices,
+    in the sorted order of their device names.
+
+  Raises:
+    ValueError: if any of the input parameter constraints are not met.
+  """
+  if not device.canonical_name(t.device):
+    raise ValueError('Device assignment required for collective ops')
+  if group_size <= 1:
+    raise ValueError('Parameter group_size to all_gather must be at least 2.')
+  return gen_collective_ops.collective_all_gather(t,
+                                                  group_size=group_size,
+                                                  group_key=group_key,
+                                                  instance_key=instance_key)
+
+
+def reduce_scatter(t, group_size, group_key, instance_key, merge_op,
+                   final_op):
+  """Reduces tensors collectively, leaving one shard on each device.
+
+  Args:
+    t: the tensor to be reduced.  Its first dimension must be divisible by
+      group_size.
+    group_size: the total number of tensors to be collectively reduced.
+      Each must reside on a different device.
+    group_key: an integer identifying the group of devices.
+    instance_key: an integer identifying the participating group of Ops.
+    merge_op: string naming the binary Op to be applied to compute each
+      partial reduction.
+    final_op: string naming the unary Op to be applied to each fully
+      reduced value.  Can be 'Id' for no operation.
+
+  Returns:
+    An Op implementing the distributed reduce-scatter.  The result is split
+    into group_size shards along the first dimension, and the value on each
+    device is the shard whose index is the position of the device in the
+    sorted order of device names.
+
+  Raises:
+    ValueError: if any of the input parameter constraints are not met.
+  """
+  if not device.canonical_name(t.device):
+    raise ValueError('Device assignment required for collective ops')
+  if group_size <= 1:
+    raise ValueError(
+        'Parameter group_size to reduce_scatter must be at least 2.')
+  return gen_collective_ops.collective_reduce_scatter(
+      t,
+      group_size=group_size,
+      group_key=group_key,
+      instance_key=instance_key,
+      merge_op=merge_op,
+      final_op=final_op)
+
+
 def broadcast_send(t, shape, dtype, group_size, group_key, instance_key):
   """Broadcasts one tensor to a group of others, across devices.
 
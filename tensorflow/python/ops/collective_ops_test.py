@@ -85,5 +85,45 @@ class CollectiveOpTest(test.TestCase):
     self._testCollectiveBroadcast([0.1, 1.1, 2.1, 3.1, 4.1, 5.1, 6.1, 7.1])
 
 
+  def testCollectiveAllGather(self):
+    group_key = 1
+    instance_key = 1
+    t0 = [[0.1, 1.1], [2.1, 3.1]]
+    t1 = [[0.3, 1.3], [2.3, 3.3]]
+    with self.test_session(
+        config=config_pb2.ConfigProto(device_count={'CPU': 2})) as sess:
+      with ops.device('/CPU:0'):
+        in0 = constant_op.constant(t0)
+        out0 = collective_ops.all_gather(in0, 2, group_key, instance_key)
+      with ops.device('/CPU:1'):
+        in1 = constant_op.constant(t1)
+        out1 = collective_ops.all_gather(in1, 2, group_key, instance_key)
+      run_options = config_pb2.RunOptions()
+      run_options.experimental.collective_graph_key = 1
+      results = sess.run([out0, out1], options=run_options)
+    self.assertAllClose(results[0], t0 + t1, rtol=1e-5, atol=1e-5)
+    self.assertAllClose(results[1], t0 + t1, rtol=1e-5, atol=1e-5)
+
+  def testCollectiveReduceScatter(self):
+    group_key = 1
+    instance_key = 1
+    t0 = [0.1, 1.1, 2.1, 3.1, 4.1, 5.1]
+    t1 = [0.3, 1.3, 2.3, 3.3, 4.3, 5.3]
+    with self.test_session(
+        config=config_pb2.ConfigProto(device_count={'CPU': 2})) as sess:
+      with ops.device('/CPU:0'):
+        in0 = constant_op.constant(t0)
+        out0 = collective_ops.reduce_scatter(in0, 2, group_key, instance_key,
+                                             'Add', 'Div')
+      with ops.device('/CPU:1'):
+        in1 = constant_op.constant(t1)
+        out1 = collective_ops.reduce_scatter(in1, 2, group_key, instance_key,
+                                             'Add', 'Div')
+      run_options = config_pb2.RunOptions()
+      run_options.experimental.collective_graph_key = 1
+      results = sess.run([out0, out1], options=run_options)
+    self.assertAllClose(results[0], [0.2, 1.2, 2.2], rtol=1e-5, atol=1e-5)
+    self.assertAllClose(results[1], [3.2, 4.2, 5.2], rtol=1e-5, atol=1e-5)
+
 if __name__ == '__main__':
   test.main()
@@ -26,6 +26,7 @@ limitations under the License.
 #include <unordered_set>
 #include <vector>
 
+#include "tensorflow/core/framework/device_attributes.pb.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/step_stats.pb.h"
@@ -38,6 +39,7 @@ limitations under the License.
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/init_main.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/platform.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/public/session.h"
@@ -248,6 +250,14 @@ void SleepSeconds(double sleep_seconds) {
 Status InitializeSession(int num_threads, const string& graph,
                          std::unique_ptr<Session>* session,
                          std::unique_ptr<GraphDef>* graph_def) {
+  return InitializeSession(num_threads, false /*use_numa_affinity*/,
+                           -1 /*numa_node*/, graph, session, graph_def);
+}
+
+Status InitializeSession(int num_threads, bool use_numa_affinity,
+                         int numa_node, const string& graph,
+                         std::unique_ptr<Session>* session,
+                         std::unique_ptr<GraphDef>* graph_def) {
   LOG(INFO) << "Loading TensorFlow.";
 
   tensorflow::SessionOptions options;
@@ -255,6 +265,9 @@ Status InitializeSession(int num_threads, const string& graph,
   if (num_threads > 0) {
     config.set_intra_op_parallelism_threads(num_threads);
   }
+  if (use_numa_affinity) {
+    config.mutable_experimental()->set_use_numa_affinity(true);
+  }
   LOG(INFO) << "Got config, " << config.device_count_size() << " devices";
 
   session->reset(tensorflow::NewSession(options));
@@ -270,12 +283,36 @@ Status InitializeSession(int num_threads, const string& graph,
     return s;
   }
 
+  if (numa_node >= 0) {
+    if (!use_numa_affinity || numa_node >= port::NUMANumNodes()) {
+      return errors::InvalidArgument(
+          "numa_node must be less than the number of NUMA nodes (",
+          port::NUMANumNodes(), ") and requires use_numa_affinity");
+    }
+    // CPU:0 is not bound to a node and is followed by one device per node.
+    const string device = strings::StrCat("/device:CPU:", 1 + numa_node);
+    for (NodeDef& node : *(*graph_def)->mutable_node()) {
+      if (node.device().empty()) node.set_device(device);
+    }
+    LOG(INFO) << "Placed the ops without a device on " << device;
+  }
+
   s = (*session)->Create(*(graph_def->get()));
   if (!s.ok()) {
     LOG(ERROR) << "Could not create TensorFlow Session: " << s;
     return s;
   }
 
+  if (use_numa_affinity) {
+    // Ops are bound to a node only by their device, e.g. "/device:CPU:1".
+    std::vector<DeviceAttributes> devices;
+    TF_RETURN_IF_ERROR((*session)->ListDevices(&devices));
+    for (const DeviceAttributes& device : devices) {
+      LOG(INFO) << "Device " << device.name() << " on NUMA node "
+                << device.locality().numa_node();
+    }
+  }
+
   return Status::OK();
 }
 
@@ -390,6 +427,8 @@ int Main(int argc, char** argv) {
   bool show_summary = true;
   bool show_flops = false;
   int warmup_runs = 1;
+  bool use_numa_affinity = false;
+  int numa_node = -1;
 
   std::vector<Flag> flag_list = {
       Flag("graph", &graph, "graph file name"),
@@ -425,6 +464,11 @@ int Main(int argc, char** argv) {
            "whether to show a summary of the stats"),
       Flag("show_flops", &show_flops, "whether to estimate the model's FLOPs"),
       Flag("warmup_runs", &warmup_runs, "how many runs to initialize model"),
+      Flag("use_numa_affinity", &use_numa_affinity,
+           "whether to add one CPU device per NUMA node"),
+      Flag("numa_node", &numa_node,
+           "with use_numa_affinity, the NUMA node to place the ops without "
+           "a device on, or -1 to leave them on /device:CPU:0"),
   };
   string usage = Flags::Usage(argv[0], flag_list);
   const bool parse_result = Flags::Parse(&argc, argv, flag_list);
@@ -482,6 +526,8 @@ int Main(int argc, char** argv) {
   LOG(INFO) << "Output prefix: [" << output_prefix << "]";
   LOG(INFO) << "Show sizes: [" << show_sizes << "]";
   LOG(INFO) << "Warmup runs: [" << warmup_runs << "]";
+  LOG(INFO) << "Use NUMA affinity: [" << use_numa_affinity << "]";
+  LOG(INFO) << "NUMA node: [" << numa_node << "]";
 
   std::unique_ptr<Session> session;
   std::unique_ptr<StatSummarizer> stats;
@@ -489,7 +535,8 @@ int Main(int argc, char** argv) {
 
   int64 initialization_start_us = Env::Default()->NowMicros();
   Status initialize_status =
-      InitializeSession(num_threads, graph, &session, &graph_def);
+      InitializeSession(num_threads, use_numa_affinity, numa_node, graph,
+                        &session, &graph_def);
   int64 initialization_end_us = Env::Default()->NowMicros();
   double initialization_time_s =
       (initialization_end_us - initialization_start_us) / 1000000.0;
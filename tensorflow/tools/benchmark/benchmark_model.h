@@ -35,6 +35,15 @@ Status InitializeSession(int num_threads, const string& graph,
                          std::unique_ptr<Session>* session,
                          std::unique_ptr<GraphDef>* graph_def);
 
+// Like above. If use_numa_affinity is true, the session gets one CPU device
+// per NUMA node, with threads and memory bound to the node. If numa_node is
+// not negative, the ops of the graph that have no device are placed on the
+// device of that node.
+Status InitializeSession(int num_threads, bool use_numa_affinity,
+                         int numa_node, const string& graph,
+                         std::unique_ptr<Session>* session,
+                         std::unique_ptr<GraphDef>* graph_def);
+
 // Does a single run of the model that's been loaded into the given session.
 Status RunBenchmark(const std::vector<InputLayerInfo>& inputs,
                     const std::vector<string>& outputs,